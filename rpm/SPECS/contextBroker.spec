@@ -35,7 +35,7 @@ Packager:   Fermín Galán <fermin.galanmarquez@telefonica.com>
 URL:        http://catalogue.fiware.org/enablers/publishsubscribe-context-broker-orion-context-broker
 Source:     %{name}-%{broker_version}.tar.gz
 BuildRoot: /var/tmp/%{name}-buildroot
-Requires:  libstdc++, boost-thread, boost-filesystem, gnutls, libgcrypt, libcurl, openssl, logrotate, libuuid
+Requires:  libstdc++, boost-thread, boost-filesystem, gnutls, libgcrypt, libcurl, openssl, logrotate, libuuid, zlib
 Buildrequires: gcc, cmake, gcc-c++, gnutls-devel, libgcrypt-devel, libcurl-devel, openssl-devel, boost-devel, libuuid-devel
 Requires(pre): shadow-utils
 
@@ -120,6 +120,7 @@ cp scripts/accumulator-server.py $RPM_BUILD_ROOT/usr/share/contextBroker/tests
 cp test/functionalTest/httpsPrepare.sh $RPM_BUILD_ROOT/usr/share/contextBroker/tests
 cp scripts/managedb/garbage-collector.py $RPM_BUILD_ROOT/usr/share/contextBroker
 cp scripts/managedb/latest-updates.py $RPM_BUILD_ROOT/usr/share/contextBroker
+cp scripts/managedb/service_path_scopes.py $RPM_BUILD_ROOT/usr/share/contextBroker
 cp scripts/monit_log_processing.py $RPM_BUILD_ROOT/usr/share/contextBroker
 cp etc/init.d/contextBroker.centos $RPM_BUILD_ROOT/etc/init.d/%{name}
 chmod 755 $RPM_BUILD_ROOT/etc/init.d/%{name}
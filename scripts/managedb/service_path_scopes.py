@@ -0,0 +1,151 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+# Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+#
+# This file is part of Orion Context Broker.
+#
+# Orion Context Broker is free software: you can redistribute it and/or
+# modify it under the terms of the GNU Affero General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# Orion Context Broker is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+# General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+#
+# For those usages not covered by this license please contact with
+# iot_support at tid dot es
+
+# Prepares a database to be used with the -servicePathIndex CLI option:
+#
+# 1. Sets the 'spScopes' field in the entities that don't have it (i.e. entities created
+#    without -servicePathIndex)
+# 2. Creates the index on entities 'spScopes' and the index on csubs 'servicePath'
+#
+# It has to be run in every Orion database (see do_in_all_orion_dbs.sh in the case of
+# multitenancy) before starting the broker with -servicePathIndex. Running it again is
+# harmless: entities already having 'spScopes' are skipped.
+
+from pymongo import MongoClient, ASCENDING
+import json
+import sys
+
+SP_SCOPES = 'spScopes'
+
+
+def flatten(_id):
+    """
+    The way in which Python manage dictionaries doesn't make easy to be sure
+    of field ordering, which is important for MongoDB in the case of using an
+    embedded document for _id. This function helps.
+
+    :param _id: JSON document containing id, type and servicePath
+    :return: a "flatten" version of the _id
+    """
+
+    r = {'_id.id': _id['id']}
+
+    if 'type' in _id:
+       r['_id.type'] = _id['type']
+    else:
+       r['_id.type'] = {'$exists': False}
+
+    if 'servicePath' in _id:
+       r['_id.servicePath'] = _id['servicePath']
+    else:
+       r['_id.servicePath'] = {'$exists': False}
+
+    return r
+
+
+def sp_scopes(sp):
+    """
+    Scopes of a servicePath, as calculated by servicePathScopes() in the broker. For instance,
+    for '/a/b' they are ['/#', '/a/#', '/a/b/#', '/a/b']. Entities without servicePath
+    (legacy) are in '/'.
+
+    :param sp: the servicePath of the entity
+    :return: list of scopes
+    """
+
+    if sp is None or sp == '':
+        sp = '/'
+
+    scopes = ['/#']
+
+    if sp != '/':
+        for ix in range(1, len(sp)):
+            if sp[ix] == '/':
+                scopes.append(sp[:ix] + '/#')
+        scopes.append(sp + '/#')
+
+    scopes.append(sp)
+
+    return scopes
+
+
+##########################
+# Main program starts here
+
+if len(sys.argv) != 2:
+    print "invalid number of arguments, please check https://fiware-orion.readthedocs.io/en/master/admin/perf_tuning/index.html#service-path-index"
+    sys.exit()
+
+DB = sys.argv[1]
+
+# Warn user
+print "WARNING!!!! This script modifies your '%s' database. It is STRONGLY RECOMMENDED that you" % DB
+print "do a backup of your database before using it as described in https://fiware-orion.readthedocs.io/en/master/admin/database_admin/index.html#backup. Use this script at your own risk."
+print "If you are sure you want to continue type 'yes' and press Enter"
+
+confirm = raw_input()
+
+if (confirm != 'yes'):
+    sys.exit()
+
+client = MongoClient('localhost', 27017)
+db = client[DB]
+
+changed     = 0
+error       = 0
+processed   = 0
+
+total = db['entities'].count({SP_SCOPES: {'$exists': False}})
+
+print "- processing entities collection (%d entities without scopes), this may take a while... " % total
+
+# The sort() is a way of ensuring that a modified document doesn't enters again at the end of the cursor and
+# batch_size avoids the cursor expiring at server (see upgrade-1.5.0/change_attr_id_separator.py)
+for doc in db['entities'].find({SP_SCOPES: {'$exists': False}}, {'_id': 1}).sort([('_id.id', 1), ('_id.type', -1), ('_id.servicePath', 1)]).batch_size(100):
+
+    processed += 1
+
+    sys.stdout.write('- processing entity: %d/%d   \r' % (processed, total) )
+    sys.stdout.flush()
+
+    scopes = sp_scopes(doc['_id'].get('servicePath'))
+    result = db['entities'].update(flatten(doc['_id']), {'$set': {SP_SCOPES: scopes}})
+
+    if result['n'] == 1:
+        changed += 1
+    else:
+        print "- %d: ERROR: document <%s> change attempt failed!" % (processed, json.dumps(doc['_id']))
+        error += 1
+
+print '- processing entity: %d/%d' % (processed, total)
+print '- documents processed:   %d' % processed
+print '  * changed:             %d' % changed
+print '  * error:               %d' % error
+
+print "- creating indexes, this may take a while... "
+db['entities'].create_index([(SP_SCOPES, ASCENDING)])
+db['csubs'].create_index([('servicePath', ASCENDING)])
+print "- done"
+
+if error > 0:
+    print "------------------------------------------------------"
+    print "WARNING: some entities were not changed. Please run the script again before using -servicePathIndex"
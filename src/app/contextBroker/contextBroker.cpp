@@ -66,7 +66,15 @@
 #include <limits.h>
 
 #include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/initialNotification.h"
+#include "mongoBackend/MongoCommonUpdate.h"
 #include "cache/subCache.h"
+#include "cache/subCacheSnapshot.h"
+#include "cache/entityCache.h"
+#include "cache/countCache.h"
+#include "common/reqTrace.h"
+#include "cache/regCache.h"
+#include "cache/casubCache.h"
 
 #include "parseArgs/parseArgs.h"
 #include "parseArgs/paConfig.h"
@@ -82,6 +90,8 @@
 #include "rest/restReply.h"
 #include "rest/rest.h"
 #include "rest/httpRequestSend.h"
+#include "rest/requestWorkers.h"
+#include "rest/compression.h"
 
 #include "common/sem.h"
 #include "common/globals.h"
@@ -94,9 +104,13 @@
 #include "ngsiNotify/QueueNotifier.h"
 #include "ngsiNotify/QueueWorkers.h"
 #include "ngsiNotify/senderThread.h"
+#include "ngsiNotify/destinationHealth.h"
+#include "ngsiNotify/notificationSpool.h"
 
 #include "contextBroker/version.h"
 #include "common/string.h"
+#include "common/charScan.h"
+#include "common/codec.h"
 #include "alarmMgr/alarmMgr.h"
 #include "metricsMgr/metricsMgr.h"
 #include "logSummary/logSummary.h"
@@ -174,6 +188,28 @@ bool            disableMetrics;
 int             reqTimeout;
 bool            insecureNotif;
 bool            ngsiv1Autocast;
+unsigned int    entityCacheSize;
+unsigned int    countCacheTtl;
+unsigned int    slowRequestThreshold;
+bool            latencyHistograms;
+unsigned int    notifBreakerThreshold;
+unsigned int    notifMaxInFlight;
+unsigned int    reqWorkers;
+unsigned int    reqQueueSize;
+unsigned int    compressionMinSize;
+bool            notifCompression;
+bool            servicePathIndex;
+bool            shortestNumbers;
+unsigned int    initialNotifChunkSize;
+unsigned int    subCacheLoaders;
+char            subCacheSnapshotPath[256];
+int             subCacheSnapshotIval;
+char            notifQueueFairness[64];
+char            notifQueueTenants[1024];
+char            notifSpoolDir[256];
+int             notifSpoolSize;
+bool            notifThrottlingDeferred;
+unsigned int    notifBatchMaxSize;
 
 
 
@@ -215,7 +251,7 @@ bool            ngsiv1Autocast;
 #define CPR_FORWARD_LIMIT_DESC "maximum number of forwarded requests to Context Providers for a single client request"
 #define SUB_CACHE_IVAL_DESC    "interval in seconds between calls to Subscription Cache refresh (0: no refresh)"
 #define NOTIFICATION_MODE_DESC "notification mode (persistent|transient|threadpool:q:n)"
-#define NO_CACHE               "disable subscription cache for lookups"
+#define NO_CACHE               "disable subscription and registration caches for lookups"
 #define CONN_MEMORY_DESC       "maximum memory size per connection (in kilobytes)"
 #define MAX_CONN_DESC          "maximum number of simultaneous connections"
 #define REQ_POOL_SIZE          "size of thread pool for incoming connections"
@@ -234,6 +270,28 @@ bool            ngsiv1Autocast;
 #define REQ_TMO_DESC           "connection timeout for REST requests (in seconds)"
 #define INSECURE_NOTIF         "allow HTTPS notifications to peers which certificate cannot be authenticated with known CA certificates"
 #define NGSIV1_AUTOCAST        "automatic cast for number, booleans and dates in NGSIv1 update/create attribute operations"
+#define ENTITY_CACHE_SIZE_DESC "maximum number of entities in the entity cache (0: entity cache disabled)"
+#define COUNT_CACHE_TTL_DESC   "time (in seconds) Fiware-Total-Count values are reused for the same query (0: count cache disabled)"
+#define SLOW_REQ_DESC          "requests taking longer (in milliseconds) are logged with their time breakdown (0: disabled)"
+#define LATENCY_HIST_DESC      "keep per-route latency histograms, available at /admin/latency"
+#define NOTIF_BREAKER_DESC     "consecutive notification failures that open the circuit of a destination (0: disabled)"
+#define NOTIF_INFLIGHT_DESC    "max number of concurrent notifications to the same destination, adapted to its latency (0: no limit)"
+#define REQ_WORKERS_DESC       "number of threads serving the requests read by the connection threads (0: served by the connection threads)"
+#define REQ_QUEUE_SIZE_DESC    "max number of requests waiting for a request worker (beyond it, 503 responses)"
+#define COMPRESSION_DESC       "minimum size (in bytes) of the responses compressed for clients accepting it (0: no compression)"
+#define NOTIF_COMPRESSION_DESC "compress the notifications of the subscriptions with a Content-Encoding custom header (gzip or deflate)"
+#define SP_INDEX_DESC          "store indexed servicePath scopes in the entities and use them in servicePath filters"
+#define SHORTEST_NUMBERS_DESC  "render decimal numbers with the shortest representation that parses back to the same value, instead of rounding them to 9 decimals"
+#define INITIAL_NOTIF_DESC     "send initial notifications in background, in notifications of this number of entities (0 means synchronous initial notification)"
+#define SUB_CACHE_LOADERS_DESC "number of tenant databases loaded in parallel into the subscription cache"
+#define SUB_CACHE_SNAPSHOT_DESC "file where the subscription cache is saved to (and loaded from at startup), empty for no snapshot"
+#define SUB_CACHE_SNAPSHOT_IVAL_DESC "interval in seconds between subscription cache snapshots (0: only after each refresh)"
+#define NOTIF_QUEUE_FAIRNESS_DESC "sub-queues of the threadpool notification queue, served in round robin: none, tenant or subscription"
+#define NOTIF_QUEUE_TENANTS_DESC "weight and limit of the tenants in the notification queue, as tenant:weight[:limit],..."
+#define NOTIF_SPOOL_DIR_DESC     "directory where the notifications not fitting in the threadpool queue are spooled to, empty for no spool"
+#define NOTIF_SPOOL_SIZE_DESC    "maximum disk space of the notification spool, in megabytes"
+#define NOTIF_THROTTLING_DEFERRED_DESC "send the notifications discarded by throttling at the end of the throttling window, with the current entities"
+#define NOTIF_BATCH_MAX_SIZE_DESC "maximum size (in kilobytes) of the notifications grouping the entities of a batch update (0: a notification per entity)"
 
 
 
@@ -307,6 +365,42 @@ PaArgument paArgs[] =
 
   { "-ngsiv1Autocast", &ngsiv1Autocast, "NGSIV1_AUTOCAST", PaBool, PaOpt, false, false, true, NGSIV1_AUTOCAST },
 
+  { "-entityCacheSize", &entityCacheSize, "ENTITY_CACHE_SIZE", PaUInt, PaOpt, 0, 0, UINT_MAX, ENTITY_CACHE_SIZE_DESC },
+  { "-countCacheTtl",   &countCacheTtl,   "COUNT_CACHE_TTL",   PaUInt, PaOpt, 0, 0, UINT_MAX, COUNT_CACHE_TTL_DESC   },
+
+  { "-slowRequestThreshold", &slowRequestThreshold, "SLOW_REQUEST_THRESHOLD", PaUInt, PaOpt, 0,     0,     UINT_MAX, SLOW_REQ_DESC     },
+  { "-latencyHistograms",    &latencyHistograms,    "LATENCY_HISTOGRAMS",     PaBool, PaOpt, false, false, true,     LATENCY_HIST_DESC },
+
+  { "-notifBreakerThreshold", &notifBreakerThreshold, "NOTIF_BREAKER_THRESHOLD", PaUInt, PaOpt, 0, 0, UINT_MAX, NOTIF_BREAKER_DESC  },
+  { "-notifMaxInFlight",      &notifMaxInFlight,      "NOTIF_MAX_INFLIGHT",      PaUInt, PaOpt, 0, 0, UINT_MAX, NOTIF_INFLIGHT_DESC },
+
+  { "-reqWorkers",   &reqWorkers,   "REQ_WORKERS",    PaUInt, PaOpt, 0,    0, UINT_MAX, REQ_WORKERS_DESC    },
+  { "-reqQueueSize", &reqQueueSize, "REQ_QUEUE_SIZE", PaUInt, PaOpt, 1000, 1, UINT_MAX, REQ_QUEUE_SIZE_DESC },
+
+  { "-compressionMinSize", &compressionMinSize, "COMPRESSION_MIN_SIZE", PaUInt, PaOpt, 0, 0, UINT_MAX, COMPRESSION_DESC },
+  { "-notifCompression",   &notifCompression,   "NOTIF_COMPRESSION",    PaBool, PaOpt, false, false, true, NOTIF_COMPRESSION_DESC },
+
+  { "-servicePathIndex", &servicePathIndex, "SERVICE_PATH_INDEX", PaBool, PaOpt, false, false, true, SP_INDEX_DESC },
+
+  { "-shortestNumbers", &shortestNumbers, "SHORTEST_NUMBERS", PaBool, PaOpt, false, false, true, SHORTEST_NUMBERS_DESC },
+
+  { "-initialNotifChunkSize", &initialNotifChunkSize, "INITIAL_NOTIF_CHUNK_SIZE", PaUInt, PaOpt, 0, 0, UINT_MAX, INITIAL_NOTIF_DESC },
+
+  { "-subCacheLoaders", &subCacheLoaders, "SUB_CACHE_LOADERS", PaUInt, PaOpt, 1, 1, UINT_MAX, SUB_CACHE_LOADERS_DESC },
+
+  { "-subCacheSnapshot", subCacheSnapshotPath, "SUB_CACHE_SNAPSHOT", PaString, PaOpt, _i "", PaNL, PaNL, SUB_CACHE_SNAPSHOT_DESC },
+  { "-subCacheSnapshotIval", &subCacheSnapshotIval, "SUB_CACHE_SNAPSHOT_IVAL", PaInt, PaOpt, 0,  0, 3600, SUB_CACHE_SNAPSHOT_IVAL_DESC },
+
+  { "-notifQueueFairness", notifQueueFairness, "NOTIF_QUEUE_FAIRNESS", PaString, PaOpt, _i "none", PaNL, PaNL, NOTIF_QUEUE_FAIRNESS_DESC },
+  { "-notifQueueTenants", notifQueueTenants, "NOTIF_QUEUE_TENANTS", PaString, PaOpt, _i "", PaNL, PaNL, NOTIF_QUEUE_TENANTS_DESC },
+
+  { "-notifSpoolDir", notifSpoolDir, "NOTIF_SPOOL_DIR", PaString, PaOpt, _i "", PaNL, PaNL, NOTIF_SPOOL_DIR_DESC },
+  { "-notifSpoolSize", &notifSpoolSize, "NOTIF_SPOOL_SIZE", PaInt, PaOpt, 1024, 32, 1048576, NOTIF_SPOOL_SIZE_DESC },
+
+  { "-notifThrottlingDeferred", &notifThrottlingDeferred, "NOTIF_THROTTLING_DEFERRED", PaBool, PaOpt, false, false, true, NOTIF_THROTTLING_DEFERRED_DESC },
+
+  { "-notifBatchMaxSize", &notifBatchMaxSize, "NOTIF_BATCH_MAX_SIZE", PaUInt, PaOpt, 0, 0, 8192, NOTIF_BATCH_MAX_SIZE_DESC },
+
   PA_END_OF_ARGS
 };
 
@@ -555,6 +649,31 @@ const char* description =
 
 
 
+/* ****************************************************************************
+*
+* notifQueueFairnessParse -
+*/
+static NotifQueueFairness notifQueueFairnessParse(const char* fairness)
+{
+  if (strcmp(fairness, "none") == 0)
+  {
+    return NqfNone;
+  }
+  else if (strcmp(fairness, "tenant") == 0)
+  {
+    return NqfTenant;
+  }
+  else if (strcmp(fairness, "subscription") == 0)
+  {
+    return NqfSubscription;
+  }
+
+  LM_X(1, ("Fatal Error (invalid -notifQueueFairness: %s)", fairness));
+  return NqfNone;
+}
+
+
+
 /* ****************************************************************************
 *
 * contextBrokerInit -
@@ -566,8 +685,29 @@ static void contextBrokerInit(std::string dbPrefix, bool multitenant)
   /* If we use a queue for notifications, start worker threads */
   if (strcmp(notificationMode, "threadpool") == 0)
   {
-    QueueNotifier*  pQNotifier = new QueueNotifier(notificationQueueSize, notificationThreadNum);
-    int             rc         = pQNotifier->start();
+    NotifQueueFairness  fairness   = notifQueueFairnessParse(notifQueueFairness);
+    QueueNotifier*      pQNotifier = new QueueNotifier(notificationQueueSize, notificationThreadNum, fairness);
+    std::string         error;
+
+    if ((fairness != NqfNone) && (pQNotifier->tenantsConfigure(notifQueueTenants, &error) == false))
+    {
+      LM_X(1, ("Fatal Error (invalid -notifQueueTenants: %s)", error.c_str()));
+    }
+
+    if (notifSpoolDir[0] != 0)
+    {
+      if (notifSpoolInit(notifSpoolDir, (unsigned long long) notifSpoolSize * 1024 * 1024, &error) == false)
+      {
+        LM_X(1, ("Fatal Error (invalid -notifSpoolDir: %s)", error.c_str()));
+      }
+
+      if (notifSpoolStart() != 0)
+      {
+        LM_X(1, ("Fatal Error (error starting the notification spool flusher)"));
+      }
+    }
+
+    int rc = pQNotifier->start();
 
     if (rc != 0)
     {
@@ -578,6 +718,11 @@ static void contextBrokerInit(std::string dbPrefix, bool multitenant)
   }
   else
   {
+    if (notifSpoolDir[0] != 0)
+    {
+      LM_W(("-notifSpoolDir is only used with -notificationMode threadpool, ignored"));
+    }
+
     pNotifier = new Notifier();
   }
 
@@ -936,8 +1081,12 @@ int main(int argC, char* argV[])
     ipVersion = IPV6;
   }
 
+  charScanInit();
+  codecInit(shortestNumbers);
+
   SemOpType policy = policyGet(reqMutexPolicy);
   orionInit(orionExit, ORION_VERSION, policy, statCounters, statSemWait, statTiming, statNotifQueue, strictIdv1);
+  setServicePathIndex(servicePathIndex);
   mongoInit(dbHost, rplSet, dbName, user, pwd, mtenant, dbTimeout, writeConcern, dbPoolSize, statSemWait);
   alarmMgr.init(relogAlarms);
   metricsMgr.init(!disableMetrics, statSemWait);
@@ -961,16 +1110,25 @@ int main(int argC, char* argV[])
 
   if (noCache == false)
   {
-    subCacheInit(mtenant);
+    regCacheInit();
+    casubCacheInit();
+    subCacheInit(mtenant, subCacheLoaders, notifThrottlingDeferred);
 
     if (subCacheInterval == 0)
     {
-      // Populate subscription cache from database
+      if (subCacheSnapshotPath[0] != 0)
+      {
+        LM_W(("-subCacheSnapshot is ignored, as it needs a -subCacheIval other than 0"));
+      }
+
+      // Populate subscription cache from database (the timers are needed even without refresh thread)
       subCacheRefresh();
+      subCacheTimersStart();
     }
     else
     {
-      // Populate subscription cache AND start sub-cache-refresh-thread
+      // Populate subscription cache (from snapshot, if any) AND start sub-cache-refresh-thread
+      subCacheSnapshotInit(subCacheSnapshotPath, subCacheSnapshotIval);
       subCacheStart();
     }
   }
@@ -979,6 +1137,15 @@ int main(int argC, char* argV[])
     LM_T(LmtSubCache, ("noCache == false"));
   }
 
+  entityCacheInit(entityCacheSize);
+  countCacheInit(countCacheTtl);
+  reqTraceInit(slowRequestThreshold, latencyHistograms);
+  destinationHealthInit(notifBreakerThreshold, notifMaxInFlight);
+  requestWorkersInit(reqWorkers, reqQueueSize);
+  compressionInit(compressionMinSize, notifCompression);
+  initialNotificationInit(initialNotifChunkSize);
+  notificationBatchInit(notifBatchMaxSize * 1024);
+
   // Given that contextBrokerInit() may create thread (in the threadpool notification mode,
   // it has to be done before curl_global_init(), see https://curl.haxx.se/libcurl/c/threaded-ssl.html
   // Otherwise, we have empirically checked that CB may randomly crash
@@ -131,6 +131,9 @@
 #include "serviceRoutinesV2/semStateTreat.h"
 #include "serviceRoutinesV2/getMetrics.h"
 #include "serviceRoutinesV2/deleteMetrics.h"
+#include "serviceRoutinesV2/getLatency.h"
+#include "serviceRoutinesV2/deleteLatency.h"
+#include "serviceRoutinesV2/rateLimitTreat.h"
 #include "serviceRoutinesV2/optionsGetOnly.h"
 #include "serviceRoutinesV2/optionsGetPostOnly.h"
 #include "serviceRoutinesV2/optionsGetDeleteOnly.h"
@@ -216,6 +219,8 @@ static RestService getServiceV[] =
   { LogLevelRequest,                               2, { "admin", "log"                                                                 },  getLogLevel                                      },
   { SemStateRequest,                               2, { "admin", "sem"                                                                 },  semStateTreat                                    },
   { MetricsRequest,                                2, { "admin", "metrics"                                                             },  getMetrics                                       },
+  { StatisticsRequest,                             2, { "admin", "latency"                                                             },  getLatency                                       },
+  { StatisticsRequest,                             2, { "admin", "rateLimits"                                                          },  getRateLimits                                    },
 
 #ifdef DEBUG
   { ExitRequest,                                   2, { "exit", "*"                                                                    },  exitTreat                                        },
@@ -335,6 +340,7 @@ static RestService putServiceV[] =
   { LogTraceRequest,                               5, { "v1", "admin", "log", "trace",      "*"                                      }, logTraceTreat                                    },
   { LogTraceRequest,                               5, { "v1", "admin", "log", "traceLevel", "*"                                      }, logTraceTreat                                    },
   { LogLevelRequest,                               2, { "admin", "log"                                                               }, changeLogLevel                                   },
+  { StatisticsRequest,                             2, { "admin", "rateLimits"                                                        }, putRateLimit                                     },
 
   ORION_REST_SERVICE_END
 };
@@ -393,6 +399,8 @@ static RestService deleteServiceV[] =
   { StatisticsRequest,                             2, { "cache", "statistics"                                                        }, statisticsCacheTreat                                },
   { StatisticsRequest,                             4, { "v1", "admin", "cache", "statistics"                                         }, statisticsCacheTreat                                },
   { MetricsRequest,                                2, { "admin", "metrics"                                                           }, deleteMetrics                                       },
+  { StatisticsRequest,                             2, { "admin", "latency"                                                           }, deleteLatency                                       },
+  { StatisticsRequest,                             2, { "admin", "rateLimits"                                                        }, deleteRateLimit                                     },
 
   ORION_REST_SERVICE_END
 };
@@ -501,6 +509,8 @@ static RestService badVerbV[] =
   { LogLevelRequest,                               2, { "admin", "log"                                                                 }, badVerbPutOnly            },
   { SemStateRequest,                               2, { "admin", "sem"                                                                 }, badVerbGetOnly            },
   { MetricsRequest,                                2, { "admin", "metrics"                                                             }, badVerbGetDeleteOnly      },
+  { StatisticsRequest,                             2, { "admin", "latency"                                                             }, badVerbGetDeleteOnly      },
+  { StatisticsRequest,                             2, { "admin", "rateLimits"                                                          }, badVerbGetPutDeleteOnly   },
   { UpdateContext,                                 2, { "ngsi10",  "updateContext"                                                     }, badVerbPostOnly           },
   { QueryContext,                                  2, { "ngsi10",  "queryContext"                                                      }, badVerbPostOnly           },
   { SubscribeContext,                              2, { "ngsi10",  "subscribeContext"                                                  }, badVerbPostOnly           },
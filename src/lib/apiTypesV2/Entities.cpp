@@ -154,6 +154,8 @@ void Entities::fill(QueryContextResponse* qcrsP)
       eP->creDate   = ceP->entityId.creDate;
       eP->modDate   = ceP->entityId.modDate;
 
+      eP->renderedJson = qcrsP->contextElementResponseVector[ix]->renderedJson;
+
       eP->attributeVector.fill(&ceP->contextAttributeVector);
       vec.push_back(eP);
     }
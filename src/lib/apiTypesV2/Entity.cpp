@@ -207,6 +207,11 @@ std::string Entity::render
     return oe.toJson();
   }
 
+  if (renderedJson != "")
+  {
+    return renderedJson;
+  }
+
   RenderFormat  renderFormat = NGSI_V2_NORMALIZED;
 
   if      (uriParamOptions[OPT_KEY_VALUES]    == true)  { renderFormat = NGSI_V2_KEYVALUES;     }
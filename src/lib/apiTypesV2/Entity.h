@@ -63,6 +63,8 @@ class Entity
   double                  creDate;          // used by dateCreated functionality in NGSIv2
   double                  modDate;          // used by dateModified functionality in NGSIv2
 
+  std::string             renderedJson;     // Already rendered entity (from mongoBackend), used as is by render()
+
   Entity();
   ~Entity();
 
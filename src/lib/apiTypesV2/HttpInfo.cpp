@@ -50,7 +50,7 @@ namespace ngsiv2
 *
 * HttpInfo::HttpInfo - 
 */
-HttpInfo::HttpInfo() : verb(NOVERB), custom(false)
+HttpInfo::HttpInfo() : verb(NOVERB), custom(false), templatesParsed(false)
 {
 }
 
@@ -60,7 +60,7 @@ HttpInfo::HttpInfo() : verb(NOVERB), custom(false)
 *
 * HttpInfo::HttpInfo - 
 */
-HttpInfo::HttpInfo(const std::string& _url) : url(_url), verb(NOVERB), custom(false)
+HttpInfo::HttpInfo(const std::string& _url) : url(_url), verb(NOVERB), custom(false), templatesParsed(false)
 {
 }
 
@@ -113,6 +113,8 @@ void HttpInfo::fill(const BSONObj& bo)
   this->url    = bo.hasField(CSUB_REFERENCE)? getStringFieldF(bo, CSUB_REFERENCE) : "";
   this->custom = bo.hasField(CSUB_CUSTOM)?    getBoolFieldF(bo,   CSUB_CUSTOM)    : false;
 
+  this->templatesParsed = false;
+
   if (this->custom)
   {
     this->payload  = bo.hasField(CSUB_PAYLOAD)? getStringFieldF(bo, CSUB_PAYLOAD) : "";
@@ -149,4 +151,34 @@ void HttpInfo::fill(const BSONObj& bo)
     }
   }
 }
+
+
+
+/* ****************************************************************************
+*
+* HttpInfo::templatesParse -
+*
+* Parses url, payload, qs and headers once, so the notifications of the subscription
+* don't need to scan them for macros each time. Used for the subscriptions in the
+* subscription cache, as they are notified many times with the same HttpInfo.
+*/
+void HttpInfo::templatesParse(void)
+{
+  urlTemplate.parse(url);
+  payloadTemplate.parse(payload);
+
+  qsTemplates.clear();
+  for (std::map<std::string, std::string>::const_iterator it = qs.begin(); it != qs.end(); ++it)
+  {
+    qsTemplates.push_back(std::make_pair(MacroTemplate(it->first), MacroTemplate(it->second)));
+  }
+
+  headersTemplates.clear();
+  for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it)
+  {
+    headersTemplates.push_back(std::make_pair(MacroTemplate(it->first), MacroTemplate(it->second)));
+  }
+
+  templatesParsed = true;
+}
 }
@@ -27,9 +27,12 @@
 */
 #include <string>
 #include <map>
+#include <vector>
+#include <utility>
 
 #include "mongo/client/dbclient.h"
 #include "rest/Verb.h"
+#include "common/macroSubstitute.h"
 
 
 
@@ -48,11 +51,19 @@ struct HttpInfo
   std::string                         payload;
   bool                                custom;
 
+  // Parsed templates of the custom notification (see templatesParse())
+  bool                                                      templatesParsed;
+  MacroTemplate                                             urlTemplate;
+  MacroTemplate                                             payloadTemplate;
+  std::vector<std::pair<MacroTemplate, MacroTemplate> >     qsTemplates;
+  std::vector<std::pair<MacroTemplate, MacroTemplate> >     headersTemplates;
+
   HttpInfo();
   explicit HttpInfo(const std::string& _url);
 
   std::string  toJson();
   void         fill(const mongo::BSONObj& bo);
+  void         templatesParse(void);
 };
 }
 
@@ -158,6 +158,17 @@ std::string Notification::toJson(const std::string& attrsFormat)
     jh.addDate("lastSuccess", this->lastSuccess);
   }
 
+  if (this->initialStatus != "")
+  {
+    JsonHelper jhi;
+
+    jhi.addString("status", this->initialStatus);
+    jhi.addNumber("entities", this->initialEntities);
+    jhi.addNumber("notifications", this->initialNotifications);
+
+    jh.addRaw("initialNotification", jhi.str());
+  }
+
   return jh.str();
 }
 
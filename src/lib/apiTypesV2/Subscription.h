@@ -53,6 +53,9 @@ struct Notification
   std::string              toJson(const std::string& attrsFormat);
   int                      lastFailure;  // FIXME P4: should be long long, like lastNotification
   int                      lastSuccess;  // FIXME P4: should be long long, like lastNotification
+  std::string              initialStatus;         // Only for background initial notifications
+  long long                initialEntities;
+  long long                initialNotifications;
   Notification():
     attributes(),
     blacklist(false),
@@ -60,7 +63,10 @@ struct Notification
     lastNotification(-1),
     httpInfo(),
     lastFailure(-1),
-    lastSuccess(-1)
+    lastSuccess(-1),
+    initialStatus(""),
+    initialEntities(0),
+    initialNotifications(0)
   {}
 };
 
@@ -0,0 +1,606 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <semaphore.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "mongo/client/dbclient.h"
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+#include "common/globals.h"
+#include "common/statistics.h"
+#include "common/regexCache.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/safeMongo.h"
+#include "mongoBackend/dbConstants.h"
+#include "cache/casubCache.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* CasubCacheEntity -
+*/
+typedef struct CasubCacheEntity
+{
+  std::string  id;
+  std::string  type;
+  bool         hasType;
+  bool         isPattern;      // isPattern is "true"
+  bool         exactNoPattern; // The entity element is exactly {id, type, isPattern: "false"}
+} CasubCacheEntity;
+
+
+
+/* ****************************************************************************
+*
+* CasubCacheItem -
+*/
+typedef struct CasubCacheItem
+{
+  BSONObj                        sub;
+  long long                      expiration;
+  std::vector<CasubCacheEntity>  entities;
+  std::set<std::string>          attrs;
+  bool                           noAttrs;   // The attrs array is empty
+} CasubCacheItem;
+
+
+
+/* ****************************************************************************
+*
+* CasubCacheTenant -
+*
+* The index maps entity ids to the items with that (non pattern) entity id. The items
+* with some pattern entity are also kept apart, as they are candidates for any lookup.
+*/
+typedef struct CasubCacheTenant
+{
+  std::vector<CasubCacheItem>                        items;
+  std::map<std::string, std::vector<unsigned int> >  byEntityId;
+  std::vector<unsigned int>                          withPattern;
+  unsigned long long                                 seq;
+} CasubCacheTenant;
+
+
+
+/* ****************************************************************************
+*
+* CasubCache -
+*/
+typedef struct CasubCache
+{
+  std::map<std::string, CasubCacheTenant*>  tenants;
+  unsigned long long                        loadSeq;
+} CasubCache;
+
+static CasubCache*  casubCache = NULL;
+static sem_t        casubCacheSem;
+
+
+
+/* ****************************************************************************
+*
+* casubCacheInit -
+*/
+void casubCacheInit(void)
+{
+  if (sem_init(&casubCacheSem, 0, 1) == -1)
+  {
+    LM_X(1, ("Fatal Error (error initializing availability subscription cache semaphore: %s)", strerror(errno)));
+  }
+
+  casubCache = new CasubCache();
+
+  casubCache->loadSeq = 0;
+}
+
+
+
+#ifdef UNIT_TEST
+/* ****************************************************************************
+*
+* casubCacheRelease -
+*/
+void casubCacheRelease(void)
+{
+  if (casubCache == NULL)
+  {
+    return;
+  }
+
+  for (std::map<std::string, CasubCacheTenant*>::iterator iter = casubCache->tenants.begin(); iter != casubCache->tenants.end(); ++iter)
+  {
+    delete iter->second;
+  }
+
+  delete casubCache;
+  casubCache = NULL;
+}
+#endif
+
+
+
+/* ****************************************************************************
+*
+* stringField - value of a string field, false if it is missing or it is not a string
+*/
+static bool stringField(const BSONObj& b, const char* field, std::string* valueP)
+{
+  if (!b.hasField(field) || (b.getField(field).type() != mongo::String))
+  {
+    return false;
+  }
+
+  *valueP = b.getField(field).String();
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* itemFill -
+*/
+static bool itemFill(const BSONObj& sub, CasubCacheItem* itemP)
+{
+  itemP->sub        = sub.getOwned();
+  itemP->expiration = sub.hasField(CASUB_EXPIRATION)? getIntOrLongFieldAsLongF(sub, CASUB_EXPIRATION) : 0;
+  itemP->noAttrs    = false;
+
+  if (!sub.hasField(CASUB_ENTITIES) || (getFieldF(sub, CASUB_ENTITIES).type() != mongo::Array))
+  {
+    return false;
+  }
+
+  std::vector<BSONElement> enV = getFieldF(sub, CASUB_ENTITIES).Array();
+
+  for (unsigned int ix = 0; ix < enV.size(); ++ix)
+  {
+    if (enV[ix].type() != mongo::Object)
+    {
+      continue;
+    }
+
+    BSONObj           en = enV[ix].embeddedObject();
+    CasubCacheEntity  entity;
+    std::string       isPattern;
+    bool              hasId;
+
+    hasId            = stringField(en, CASUB_ENTITY_ID, &entity.id);
+    entity.hasType   = stringField(en, CASUB_ENTITY_TYPE, &entity.type);
+    entity.isPattern = stringField(en, CASUB_ENTITY_ISPATTERN, &isPattern) && (isPattern == "true");
+
+    // The DB query looks for non pattern entities as whole elements of the array
+    entity.exactNoPattern = hasId && entity.hasType && (isPattern == "false") &&
+      (en.woCompare(BSON(CASUB_ENTITY_ID << entity.id << CASUB_ENTITY_TYPE << entity.type << CASUB_ENTITY_ISPATTERN << "false")) == 0);
+
+    if (entity.exactNoPattern || (hasId && entity.isPattern))
+    {
+      itemP->entities.push_back(entity);
+    }
+  }
+
+  if (sub.hasField(CASUB_ATTRS) && (getFieldF(sub, CASUB_ATTRS).type() == mongo::Array))
+  {
+    std::vector<BSONElement> attrV = getFieldF(sub, CASUB_ATTRS).Array();
+
+    itemP->noAttrs = (attrV.size() == 0);
+
+    for (unsigned int ix = 0; ix < attrV.size(); ++ix)
+    {
+      if (attrV[ix].type() == mongo::String)
+      {
+        itemP->attrs.insert(attrV[ix].String());
+      }
+    }
+  }
+
+  return itemP->entities.size() > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantLoad -
+*
+* Returns NULL if the casubs collection of the tenant cannot be read
+*/
+static CasubCacheTenant* tenantLoad(const std::string& tenant)
+{
+  std::auto_ptr<DBClientCursor>  cursor;
+  std::string                    err;
+  CasubCacheTenant*              tenantP = new CasubCacheTenant();
+
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+
+  if (!collectionQuery(connection, getSubscribeContextAvailabilityCollectionName(tenant), BSONObj(), &cursor, &err))
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    delete tenantP;
+    return NULL;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  while (moreSafe(cursor))
+  {
+    BSONObj         sub;
+    CasubCacheItem  item;
+
+    if (!nextSafeOrErrorF(cursor, &sub, &err))
+    {
+      LM_E(("Runtime Error (exception in nextSafe(): %s - tenant: '%s')", err.c_str(), tenant.c_str()));
+      continue;
+    }
+
+    if (!sub.hasField("_id") || !itemFill(sub, &item))
+    {
+      continue;
+    }
+
+    unsigned int           itemIx     = tenantP->items.size();
+    bool                   hasPattern = false;
+    std::set<std::string>  ids;
+
+    tenantP->items.push_back(item);
+
+    for (unsigned int ix = 0; ix < item.entities.size(); ++ix)
+    {
+      if (item.entities[ix].isPattern)
+      {
+        hasPattern = true;
+      }
+      else if (ids.insert(item.entities[ix].id).second == true)
+      {
+        tenantP->byEntityId[item.entities[ix].id].push_back(itemIx);
+      }
+    }
+
+    if (hasPattern)
+    {
+      tenantP->withPattern.push_back(itemIx);
+    }
+  }
+  releaseMongoConnection(connection);
+
+  LM_T(LmtCasubCache, ("Loaded %d availability subscriptions for tenant '%s'", tenantP->items.size(), tenant.c_str()));
+
+  return tenantP;
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantInstall -
+*
+* Semaphore must be taken before calling this function.
+* A snapshot older than the one already installed (a slower concurrent load) is discarded.
+*/
+static void tenantInstall(const std::string& tenant, CasubCacheTenant* tenantP)
+{
+  std::map<std::string, CasubCacheTenant*>::iterator iter = casubCache->tenants.find(tenant);
+
+  if (iter == casubCache->tenants.end())
+  {
+    casubCache->tenants[tenant] = tenantP;
+  }
+  else if (iter->second->seq < tenantP->seq)
+  {
+    delete iter->second;
+    iter->second = tenantP;
+  }
+  else
+  {
+    delete tenantP;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* casubCacheTenantRefresh -
+*/
+void casubCacheTenantRefresh(const std::string& tenant)
+{
+  if (casubCache == NULL)
+  {
+    return;
+  }
+
+  unsigned long long seq;
+
+  sem_wait(&casubCacheSem);
+  seq = ++casubCache->loadSeq;
+  sem_post(&casubCacheSem);
+
+  CasubCacheTenant* tenantP = tenantLoad(tenant);
+
+  sem_wait(&casubCacheSem);
+
+  if (tenantP == NULL)
+  {
+    // The cache can no longer be trusted for this tenant. It will be loaded again on next lookup
+    std::map<std::string, CasubCacheTenant*>::iterator iter = casubCache->tenants.find(tenant);
+
+    if (iter != casubCache->tenants.end())
+    {
+      delete iter->second;
+      casubCache->tenants.erase(iter);
+    }
+  }
+  else
+  {
+    tenantP->seq = seq;
+    tenantInstall(tenant, tenantP);
+  }
+
+  sem_post(&casubCacheSem);
+}
+
+
+
+/* ****************************************************************************
+*
+* casubCacheRefresh -
+*/
+void casubCacheRefresh(void)
+{
+  if (casubCache == NULL)
+  {
+    return;
+  }
+
+  std::vector<std::string> tenants;
+
+  sem_wait(&casubCacheSem);
+  for (std::map<std::string, CasubCacheTenant*>::iterator iter = casubCache->tenants.begin(); iter != casubCache->tenants.end(); ++iter)
+  {
+    tenants.push_back(iter->first);
+  }
+  sem_post(&casubCacheSem);
+
+  for (unsigned int ix = 0; ix < tenants.size(); ++ix)
+  {
+    casubCacheTenantRefresh(tenants[ix]);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* noPatternMatch -
+*
+* Same semantics than the non pattern part of the query built by addTriggeredSubscriptions():
+* some entity of the subscription equal to a registered one and, if attributes are
+* registered, no attributes in the subscription or some of them registered.
+*/
+static bool noPatternMatch
+(
+  const CasubCacheItem&                item,
+  const std::vector<const EntityId*>&  enV,
+  const std::vector<std::string>&      attrV
+)
+{
+  bool entityFound = false;
+
+  for (unsigned int ix = 0; (ix < item.entities.size()) && !entityFound; ++ix)
+  {
+    const CasubCacheEntity& entity = item.entities[ix];
+
+    if (!entity.exactNoPattern)
+    {
+      continue;
+    }
+
+    for (unsigned int jx = 0; jx < enV.size(); ++jx)
+    {
+      if ((entity.id == enV[jx]->id) && (entity.type == enV[jx]->type))
+      {
+        entityFound = true;
+        break;
+      }
+    }
+  }
+
+  if (!entityFound)
+  {
+    return false;
+  }
+
+  if (item.noAttrs)
+  {
+    return true;
+  }
+
+  for (unsigned int ix = 0; ix < attrV.size(); ++ix)
+  {
+    if (item.attrs.find(attrV[ix]) != item.attrs.end())
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* patternMatch -
+*
+* Same semantics than the JavaScript function in the pattern part of the query built by
+* addTriggeredSubscriptions() (note that attributes are not taken into account there).
+* Returns false in *okP if some pattern cannot be compiled.
+*/
+static bool patternMatch(const CasubCacheItem& item, const std::vector<const EntityId*>& enV, bool* okP)
+{
+  for (unsigned int ix = 0; ix < item.entities.size(); ++ix)
+  {
+    const CasubCacheEntity& entity = item.entities[ix];
+
+    if (!entity.isPattern || !entity.hasType)
+    {
+      continue;
+    }
+
+    CachedRegex* regexP = regexCacheGet(entity.id);
+
+    if (regexP == NULL)
+    {
+      *okP = false;
+      return false;
+    }
+
+    bool match = false;
+
+    for (unsigned int jx = 0; (jx < enV.size()) && !match; ++jx)
+    {
+      match = (entity.type == enV[jx]->type) && regexCacheMatch(regexP, enV[jx]->id.c_str());
+    }
+
+    regexCacheRelease(regexP);
+
+    if (match)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* casubCacheMatch -
+*/
+bool casubCacheMatch
+(
+  const std::string&               tenant,
+  const EntityIdVector&            crEnV,
+  const std::vector<std::string>&  attrV,
+  std::vector<BSONObj>*            subV
+)
+{
+  if (casubCache == NULL)
+  {
+    return false;
+  }
+
+  sem_wait(&casubCacheSem);
+  bool loaded = (casubCache->tenants.find(tenant) != casubCache->tenants.end());
+  sem_post(&casubCacheSem);
+
+  // First usage of the tenant: load it
+  if (!loaded)
+  {
+    casubCacheTenantRefresh(tenant);
+  }
+
+  // The registration of isPattern=true entities is not supported, so they are not taken into account
+  std::vector<const EntityId*> enV;
+
+  for (unsigned int ix = 0; ix < crEnV.size(); ++ix)
+  {
+    if (crEnV[ix]->isPattern == "false")
+    {
+      enV.push_back(crEnV[ix]);
+    }
+  }
+
+  bool ok = true;
+
+  sem_wait(&casubCacheSem);
+
+  std::map<std::string, CasubCacheTenant*>::iterator iter = casubCache->tenants.find(tenant);
+
+  if (iter == casubCache->tenants.end())
+  {
+    ok = false;
+  }
+  else
+  {
+    CasubCacheTenant*       tenantP = iter->second;
+    long long               now     = getCurrentTime();
+    std::set<unsigned int>  candidates;
+
+    for (unsigned int ix = 0; ix < enV.size(); ++ix)
+    {
+      std::map<std::string, std::vector<unsigned int> >::iterator idIter = tenantP->byEntityId.find(enV[ix]->id);
+
+      if (idIter != tenantP->byEntityId.end())
+      {
+        candidates.insert(idIter->second.begin(), idIter->second.end());
+      }
+    }
+
+    if (enV.size() > 0)
+    {
+      candidates.insert(tenantP->withPattern.begin(), tenantP->withPattern.end());
+    }
+
+    for (std::set<unsigned int>::iterator cIter = candidates.begin(); ok && (cIter != candidates.end()); ++cIter)
+    {
+      const CasubCacheItem& item = tenantP->items[*cIter];
+
+      if (item.expiration <= now)
+      {
+        continue;
+      }
+
+      if (noPatternMatch(item, enV, attrV) || patternMatch(item, enV, &ok))
+      {
+        subV->push_back(item.sub);
+      }
+    }
+  }
+
+  sem_post(&casubCacheSem);
+
+  if (!ok)
+  {
+    subV->clear();
+  }
+
+  LM_T(LmtCasubCache, ("%d availability subscriptions matched in tenant '%s' (from cache: %s)", subV->size(), tenant.c_str(), ok? "yes" : "no"));
+
+  return ok;
+}
@@ -0,0 +1,92 @@
+#ifndef SRC_LIB_CACHE_CASUBCACHE_H_
+#define SRC_LIB_CACHE_CASUBCACHE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+
+#include "ngsi/EntityIdVector.h"
+
+
+
+/* ****************************************************************************
+*
+* casubCacheInit -
+*/
+extern void casubCacheInit(void);
+
+
+
+#ifdef UNIT_TEST
+extern void casubCacheRelease(void);
+#endif
+
+
+
+/* ****************************************************************************
+*
+* casubCacheMatch -
+*
+* Looks for the context availability subscriptions of a tenant triggered by a context
+* registration (given by its entities and the names of its attributes), with the same
+* conditions used by the DB query in addTriggeredSubscriptions(). The casub documents
+* are returned in subV.
+*
+* Returns false if the cache cannot solve the lookup (cache disabled or tenant not
+* loaded due to DB error), so the DB has to be queried.
+*/
+extern bool casubCacheMatch
+(
+  const std::string&               tenant,
+  const EntityIdVector&            enV,
+  const std::vector<std::string>&  attrV,
+  std::vector<mongo::BSONObj>*     subV
+);
+
+
+
+/* ****************************************************************************
+*
+* casubCacheTenantRefresh -
+*
+* To be called after any modification of the casubs collection of a tenant
+*/
+extern void casubCacheTenantRefresh(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* casubCacheRefresh -
+*
+* Reloads all the tenants in the cache (availability subscriptions could have been
+* modified by other CB nodes)
+*/
+extern void casubCacheRefresh(void);
+
+#endif  // SRC_LIB_CACHE_CASUBCACHE_H_
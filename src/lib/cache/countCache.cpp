@@ -0,0 +1,161 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <semaphore.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+#include "common/globals.h"
+#include "cache/countCache.h"
+
+
+
+/* ****************************************************************************
+*
+* COUNT_CACHE_MAX_ITEMS -
+*
+* Bound for the number of different filters kept. Once reached, the expired items are
+* purged and, if that is not enough, the whole cache is flushed.
+*/
+#define COUNT_CACHE_MAX_ITEMS  1000
+
+
+
+/* ****************************************************************************
+*
+* CountCacheItem -
+*/
+typedef struct CountCacheItem
+{
+  long long  count;
+  int        timestamp;
+} CountCacheItem;
+
+
+
+static std::map<std::string, CountCacheItem>  countCache;
+static unsigned int                           countCacheTtl = 0;
+static sem_t                                  countCacheSem;
+
+
+
+/* ****************************************************************************
+*
+* countCacheInit -
+*/
+void countCacheInit(unsigned int ttl)
+{
+  if (sem_init(&countCacheSem, 0, 1) == -1)
+  {
+    LM_X(1, ("Fatal Error (error initializing count cache semaphore: %s)", strerror(errno)));
+  }
+
+  countCacheTtl = ttl;
+}
+
+
+
+/* ****************************************************************************
+*
+* countCacheLookup -
+*/
+bool countCacheLookup(const std::string& key, long long* countP)
+{
+  if (countCacheTtl == 0)
+  {
+    return false;
+  }
+
+  bool found = false;
+  int  now   = getCurrentTime();
+
+  sem_wait(&countCacheSem);
+
+  std::map<std::string, CountCacheItem>::iterator it = countCache.find(key);
+
+  if ((it != countCache.end()) && (now - it->second.timestamp < (int) countCacheTtl))
+  {
+    *countP = it->second.count;
+    found   = true;
+  }
+
+  sem_post(&countCacheSem);
+
+  LM_T(LmtPagination, ("count cache %s for '%s'", found? "hit" : "miss", key.c_str()));
+
+  return found;
+}
+
+
+
+/* ****************************************************************************
+*
+* countCacheStore -
+*/
+void countCacheStore(const std::string& key, long long count)
+{
+  if (countCacheTtl == 0)
+  {
+    return;
+  }
+
+  int now = getCurrentTime();
+
+  sem_wait(&countCacheSem);
+
+  if ((countCache.size() >= COUNT_CACHE_MAX_ITEMS) && (countCache.find(key) == countCache.end()))
+  {
+    std::map<std::string, CountCacheItem>::iterator it = countCache.begin();
+
+    while (it != countCache.end())
+    {
+      if (now - it->second.timestamp >= (int) countCacheTtl)
+      {
+        countCache.erase(it++);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    if (countCache.size() >= COUNT_CACHE_MAX_ITEMS)
+    {
+      countCache.clear();
+    }
+  }
+
+  CountCacheItem item;
+
+  item.count     = count;
+  item.timestamp = now;
+
+  countCache[key] = item;
+
+  sem_post(&countCacheSem);
+}
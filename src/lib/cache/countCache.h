@@ -0,0 +1,59 @@
+#ifndef SRC_LIB_CACHE_COUNTCACHE_H_
+#define SRC_LIB_CACHE_COUNTCACHE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* countCacheInit -
+*
+* A TTL of zero disables the cache (counts are always taken from the database)
+*/
+extern void countCacheInit(unsigned int ttl);
+
+
+
+/* ****************************************************************************
+*
+* countCacheLookup -
+*
+* The key identifies the collection and the query filter the count belongs to.
+* Returns false if there is no count for the key or it is older than the TTL.
+*/
+extern bool countCacheLookup(const std::string& key, long long* countP);
+
+
+
+/* ****************************************************************************
+*
+* countCacheStore -
+*/
+extern void countCacheStore(const std::string& key, long long count);
+
+#endif  // SRC_LIB_CACHE_COUNTCACHE_H_
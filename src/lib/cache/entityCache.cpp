@@ -0,0 +1,945 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <semaphore.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "mongo/client/dbclient.h"
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+#include "common/globals.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/safeMongo.h"
+#include "cache/entityCache.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* EC_EPOCH_STRIPES -
+*
+* Number of invalidation epochs. Each entity key is hashed to one of them, so a fill
+* only gets discarded by writes to entities sharing its stripe.
+*/
+#define EC_EPOCH_STRIPES  1024
+
+
+
+/* ****************************************************************************
+*
+* EntityCacheItem -
+*/
+typedef struct EntityCacheItem
+{
+  std::string  key;
+  BSONObj      doc;
+  int          expiration;   // 0: the entity has no dateExpiration
+  bool         referenced;   // CLOCK reference bit
+  bool         inUse;
+} EntityCacheItem;
+
+
+
+/* ****************************************************************************
+*
+* EntityCache -
+*
+* The items live in a fixed-size vector of slots, scanned by the 'hand' of the CLOCK
+* eviction algorithm. The map works as index from the entity key to the slot.
+*/
+typedef struct EntityCache
+{
+  std::vector<EntityCacheItem>          slots;
+  std::vector<unsigned int>             freeSlots;
+  std::map<std::string, unsigned int>   index;
+  unsigned int                          hand;
+  unsigned long long                    epoch[EC_EPOCH_STRIPES];
+  EntityCacheStatistics                 stats;
+} EntityCache;
+
+static EntityCache*  entityCache = NULL;
+static sem_t         entityCacheSem;
+
+
+
+/* ****************************************************************************
+*
+* ecSemTake -
+*/
+static void ecSemTake(void)
+{
+  sem_wait(&entityCacheSem);
+}
+
+
+
+/* ****************************************************************************
+*
+* ecSemGive -
+*/
+static void ecSemGive(void)
+{
+  sem_post(&entityCacheSem);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInit -
+*/
+void entityCacheInit(unsigned int size)
+{
+  if (size == 0)
+  {
+    return;
+  }
+
+  if (sem_init(&entityCacheSem, 0, 1) == -1)
+  {
+    LM_X(1, ("Fatal Error (error initializing entity cache semaphore: %s)", strerror(errno)));
+  }
+
+  entityCache = new EntityCache();
+
+  entityCache->slots.resize(size);
+  entityCache->freeSlots.reserve(size);
+  entityCache->hand = 0;
+
+  for (unsigned int ix = 0; ix < size; ++ix)
+  {
+    entityCache->slots[ix].inUse      = false;
+    entityCache->slots[ix].referenced = false;
+    entityCache->slots[ix].expiration = 0;
+
+    // Reverse order, so slots are taken from the beginning of the vector
+    entityCache->freeSlots.push_back(size - ix - 1);
+  }
+
+  for (unsigned int ix = 0; ix < EC_EPOCH_STRIPES; ++ix)
+  {
+    entityCache->epoch[ix] = 0;
+  }
+
+  memset(&entityCache->stats, 0, sizeof(entityCache->stats));
+  entityCache->stats.size = size;
+
+  LM_T(LmtEntityCache, ("entity cache initialized with %d slots", size));
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheActive -
+*/
+bool entityCacheActive(void)
+{
+  return (entityCache != NULL);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheKeyUsable -
+*/
+bool entityCacheKeyUsable
+(
+  const std::string&               id,
+  bool                             idIsPattern,
+  const std::string&               type,
+  bool                             typeIsPattern,
+  const std::vector<std::string>&  servicePathV
+)
+{
+  if ((entityCache == NULL) || idIsPattern || typeIsPattern || (id == "") || (type == ""))
+  {
+    return false;
+  }
+
+  if (servicePathV.size() != 1)
+  {
+    return false;
+  }
+
+  const std::string& servicePath = servicePathV[0];
+
+  // Empty service path means "all service paths" and a trailing '#' is a recursive service path
+  if ((servicePath == "") || (servicePath[servicePath.size() - 1] == '#'))
+  {
+    return false;
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* keyCompose -
+*/
+static std::string keyCompose
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type
+)
+{
+  std::string key;
+
+  key.reserve(tenant.size() + servicePath.size() + id.size() + type.size() + 3);
+
+  key += tenant;
+  key += '\0';
+  key += servicePath;
+  key += '\0';
+  key += id;
+  key += '\0';
+  key += type;
+
+  return key;
+}
+
+
+
+/* ****************************************************************************
+*
+* keyFromDoc -
+*
+* Documents without type or without service path (created by very old versions of the
+* broker) are never cached.
+*/
+static bool keyFromDoc(const std::string& tenant, const BSONObj& doc, std::string* keyP)
+{
+  BSONElement idElement = doc.getField("_id");
+
+  if (idElement.eoo() || (idElement.type() != Object))
+  {
+    return false;
+  }
+
+  BSONObj idField = idElement.embeddedObject();
+
+  if (!idField.hasField(ENT_ENTITY_TYPE) || !idField.hasField(ENT_SERVICE_PATH))
+  {
+    return false;
+  }
+
+  *keyP = keyCompose(tenant,
+                     getStringFieldF(idField, ENT_SERVICE_PATH),
+                     getStringFieldF(idField, ENT_ENTITY_ID),
+                     getStringFieldF(idField, ENT_ENTITY_TYPE));
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* stripeOf - FNV-1a hash of the key, reduced to an epoch stripe
+*/
+static unsigned int stripeOf(const std::string& key)
+{
+  unsigned int hash = 2166136261U;
+
+  for (unsigned int ix = 0; ix < key.size(); ++ix)
+  {
+    hash ^= (unsigned char) key[ix];
+    hash *= 16777619U;
+  }
+
+  return hash % EC_EPOCH_STRIPES;
+}
+
+
+
+/* ****************************************************************************
+*
+* expirationOf -
+*/
+static int expirationOf(const BSONObj& doc)
+{
+  BSONElement expDate = doc.getField(ENT_EXPIRATION);
+
+  if (expDate.eoo() || (expDate.type() != mongo::Date))
+  {
+    return 0;
+  }
+
+  return (int) (expDate.date().millis / 1000);
+}
+
+
+
+/* ****************************************************************************
+*
+* itemRemove -
+*
+* Semaphore must be taken before calling this function
+*/
+static void itemRemove(std::map<std::string, unsigned int>::iterator iter)
+{
+  unsigned int      slot  = iter->second;
+  EntityCacheItem*  itemP = &entityCache->slots[slot];
+
+  entityCache->epoch[stripeOf(itemP->key)] += 1;
+
+  itemP->inUse      = false;
+  itemP->referenced = false;
+  itemP->doc        = BSONObj();
+  itemP->key        = "";
+
+  entityCache->freeSlots.push_back(slot);
+  entityCache->index.erase(iter);
+  entityCache->stats.items -= 1;
+}
+
+
+
+/* ****************************************************************************
+*
+* slotGet -
+*
+* Returns a free slot, evicting the first non-referenced item found by the CLOCK hand
+* if the cache is full.
+*
+* Semaphore must be taken before calling this function
+*/
+static unsigned int slotGet(void)
+{
+  if (entityCache->freeSlots.size() == 0)
+  {
+    unsigned int size = entityCache->slots.size();
+
+    while (entityCache->slots[entityCache->hand].referenced)
+    {
+      entityCache->slots[entityCache->hand].referenced = false;
+      entityCache->hand = (entityCache->hand + 1) % size;
+    }
+
+    EntityCacheItem* victimP = &entityCache->slots[entityCache->hand];
+
+    LM_T(LmtEntityCache, ("evicting slot %d", entityCache->hand));
+
+    itemRemove(entityCache->index.find(victimP->key));
+    entityCache->stats.evictions += 1;
+    entityCache->hand = (entityCache->hand + 1) % size;
+  }
+
+  unsigned int slot = entityCache->freeSlots.back();
+
+  entityCache->freeSlots.pop_back();
+
+  return slot;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheEpoch -
+*/
+unsigned long long entityCacheEpoch
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type
+)
+{
+  if (entityCache == NULL)
+  {
+    return 0;
+  }
+
+  unsigned int        stripe = stripeOf(keyCompose(tenant, servicePath, id, type));
+  unsigned long long  epoch;
+
+  ecSemTake();
+  epoch = entityCache->epoch[stripe];
+  ecSemGive();
+
+  return epoch;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheLookup -
+*/
+bool entityCacheLookup
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type,
+  BSONObj*            docP
+)
+{
+  if (entityCache == NULL)
+  {
+    return false;
+  }
+
+  std::string key = keyCompose(tenant, servicePath, id, type);
+
+  ecSemTake();
+
+  std::map<std::string, unsigned int>::iterator iter = entityCache->index.find(key);
+
+  if (iter == entityCache->index.end())
+  {
+    entityCache->stats.misses += 1;
+    ecSemGive();
+    return false;
+  }
+
+  EntityCacheItem* itemP = &entityCache->slots[iter->second];
+
+  //
+  // Expired entities may still be in the database until the TTL monitor of MongoDB removes
+  // them, so they are not served from the cache but looked up in the database
+  //
+  if ((itemP->expiration != 0) && (itemP->expiration <= getCurrentTime()))
+  {
+    itemRemove(iter);
+    entityCache->stats.expirations += 1;
+    entityCache->stats.misses      += 1;
+    ecSemGive();
+    return false;
+  }
+
+  itemP->referenced = true;
+  *docP             = itemP->doc;
+  entityCache->stats.hits += 1;
+
+  ecSemGive();
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheFill -
+*/
+void entityCacheFill
+(
+  const std::string&  tenant,
+  const BSONObj&      doc,
+  unsigned long long  epoch
+)
+{
+  std::string key;
+
+  if ((entityCache == NULL) || !keyFromDoc(tenant, doc, &key))
+  {
+    return;
+  }
+
+  int expiration = expirationOf(doc);
+
+  if ((expiration != 0) && (expiration <= getCurrentTime()))
+  {
+    return;
+  }
+
+  BSONObj owned = doc.getOwned();
+
+  ecSemTake();
+
+  //
+  // If the entity was written or removed since the document was read, the document
+  // may be stale, so it is not cached. If it is already in the cache, that copy
+  // is at least as recent as this one.
+  //
+  if ((entityCache->epoch[stripeOf(key)] != epoch) || (entityCache->index.find(key) != entityCache->index.end()))
+  {
+    ecSemGive();
+    return;
+  }
+
+  unsigned int      slot  = slotGet();
+  EntityCacheItem*  itemP = &entityCache->slots[slot];
+
+  itemP->key        = key;
+  itemP->doc        = owned;
+  itemP->expiration = expiration;
+  itemP->referenced = false;
+  itemP->inUse      = true;
+
+  entityCache->index[key]      = slot;
+  entityCache->stats.items   += 1;
+  entityCache->stats.inserts += 1;
+
+  ecSemGive();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheWrite -
+*
+* The update is applied only if the cached document is the same one the update was
+* computed from. Otherwise some other request has modified the entity in the meanwhile
+* and the cached copy is dropped.
+*/
+void entityCacheWrite
+(
+  const std::string&  tenant,
+  const BSONObj&      base,
+  const BSONObj&      update
+)
+{
+  std::string key;
+
+  if ((entityCache == NULL) || !keyFromDoc(tenant, base, &key))
+  {
+    return;
+  }
+
+  BSONObj  newDoc;
+  bool     applied = entityCacheApplyUpdate(base, update, &newDoc);
+
+  ecSemTake();
+
+  std::map<std::string, unsigned int>::iterator iter = entityCache->index.find(key);
+
+  if (iter == entityCache->index.end())
+  {
+    // Not cached, but a fill in progress for this entity has to be discarded
+    entityCache->epoch[stripeOf(key)] += 1;
+    ecSemGive();
+    return;
+  }
+
+  EntityCacheItem* itemP = &entityCache->slots[iter->second];
+
+  if (!applied || !itemP->doc.binaryEqual(base))
+  {
+    LM_T(LmtEntityCache, ("invalidating cached entity (%s)", applied ? "concurrent modification" : "unsupported update"));
+    itemRemove(iter);
+    entityCache->stats.invalidations += 1;
+    ecSemGive();
+    return;
+  }
+
+  itemP->doc        = newDoc;
+  itemP->expiration = expirationOf(newDoc);
+  itemP->referenced = true;
+  entityCache->stats.updates += 1;
+
+  ecSemGive();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheRemove -
+*/
+void entityCacheRemove
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type
+)
+{
+  if (entityCache == NULL)
+  {
+    return;
+  }
+
+  std::string key = keyCompose(tenant, servicePath, id, type);
+
+  ecSemTake();
+
+  std::map<std::string, unsigned int>::iterator iter = entityCache->index.find(key);
+
+  if (iter == entityCache->index.end())
+  {
+    entityCache->epoch[stripeOf(key)] += 1;
+  }
+  else
+  {
+    itemRemove(iter);
+    entityCache->stats.invalidations += 1;
+  }
+
+  ecSemGive();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheStatisticsGet -
+*/
+void entityCacheStatisticsGet(EntityCacheStatistics* statsP)
+{
+  if (entityCache == NULL)
+  {
+    memset(statsP, 0, sizeof(EntityCacheStatistics));
+    return;
+  }
+
+  ecSemTake();
+  *statsP = entityCache->stats;
+  ecSemGive();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheStatisticsReset -
+*
+* The fields that come from the state of the cache (items and size) are not reset
+*/
+void entityCacheStatisticsReset(void)
+{
+  if (entityCache == NULL)
+  {
+    return;
+  }
+
+  ecSemTake();
+
+  entityCache->stats.hits          = 0;
+  entityCache->stats.misses        = 0;
+  entityCache->stats.inserts       = 0;
+  entityCache->stats.updates       = 0;
+  entityCache->stats.invalidations = 0;
+  entityCache->stats.evictions     = 0;
+  entityCache->stats.expirations   = 0;
+
+  ecSemGive();
+}
+
+
+
+/* ****************************************************************************
+*
+* elementIn -
+*/
+static bool elementIn(const BSONElement& e, const std::vector<BSONElement>& v)
+{
+  for (unsigned int ix = 0; ix < v.size(); ++ix)
+  {
+    if (e.woCompare(v[ix], false) == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* attrsApply - rebuild the attrs object with the 'attrs.X' pieces of $set and $unset
+*/
+static BSONObj attrsApply
+(
+  const BSONObj&                             attrs,
+  const std::map<std::string, BSONElement>&  attrsSet,
+  const std::set<std::string>&               attrsUnset
+)
+{
+  BSONObjBuilder         bob;
+  std::set<std::string>  done;
+
+  for (BSONObj::iterator i = attrs.begin(); i.more();)
+  {
+    BSONElement  e    = i.next();
+    std::string  name = e.fieldName();
+
+    std::map<std::string, BSONElement>::const_iterator iter = attrsSet.find(name);
+
+    if (iter != attrsSet.end())
+    {
+      bob.appendAs(iter->second, name);
+      done.insert(name);
+    }
+    else if (attrsUnset.find(name) == attrsUnset.end())
+    {
+      bob.append(e);
+    }
+  }
+
+  // New attributes are added at the end, as MongoDB does
+  for (std::map<std::string, BSONElement>::const_iterator iter = attrsSet.begin(); iter != attrsSet.end(); ++iter)
+  {
+    if (done.find(iter->first) == done.end())
+    {
+      bob.appendAs(iter->second, iter->first);
+    }
+  }
+
+  return bob.obj();
+}
+
+
+
+/* ****************************************************************************
+*
+* attrNamesApply - rebuild the attrNames array with $addToSet/$each and $pullAll
+*/
+static BSONArray attrNamesApply
+(
+  const BSONObj&                   attrNames,
+  const std::vector<BSONElement>&  toPush,
+  const std::vector<BSONElement>&  toPull
+)
+{
+  BSONArrayBuilder          bab;
+  std::vector<BSONElement>  current;
+
+  for (BSONObj::iterator i = attrNames.begin(); i.more();)
+  {
+    BSONElement e = i.next();
+
+    if (!elementIn(e, toPull))
+    {
+      bab.append(e);
+      current.push_back(e);
+    }
+  }
+
+  for (unsigned int ix = 0; ix < toPush.size(); ++ix)
+  {
+    if (!elementIn(toPush[ix], current))
+    {
+      bab.append(toPush[ix]);
+      current.push_back(toPush[ix]);
+    }
+  }
+
+  return bab.arr();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheApplyUpdate -
+*
+* Only the update shapes generated by updateEntity() are supported:
+*
+*   $set:      top level fields or 'attrs.<attrName>' fields
+*   $unset:    top level fields or 'attrs.<attrName>' fields
+*   $addToSet: { attrNames: { $each: [ ... ] } }
+*   $pullAll:  { attrNames: [ ... ] }
+*/
+bool entityCacheApplyUpdate
+(
+  const BSONObj&  doc,
+  const BSONObj&  update,
+  BSONObj*        resultP
+)
+{
+  const std::string                   attrsPrefix = ENT_ATTRS ".";
+  std::map<std::string, BSONElement>  topSet;
+  std::set<std::string>               topUnset;
+  std::map<std::string, BSONElement>  attrsSet;
+  std::set<std::string>               attrsUnset;
+  std::vector<BSONElement>            toPush;
+  std::vector<BSONElement>            toPull;
+
+  for (BSONObj::iterator i = update.begin(); i.more();)
+  {
+    BSONElement  op     = i.next();
+    std::string  opName = op.fieldName();
+
+    if (op.type() != Object)
+    {
+      return false;
+    }
+
+    BSONObj opObj = op.embeddedObject();
+
+    if ((opName == "$set") || (opName == "$unset"))
+    {
+      bool isSet = (opName == "$set");
+
+      for (BSONObj::iterator j = opObj.begin(); j.more();)
+      {
+        BSONElement  e    = j.next();
+        std::string  path = e.fieldName();
+
+        if (path.compare(0, attrsPrefix.size(), attrsPrefix) == 0)
+        {
+          std::string attrName = path.substr(attrsPrefix.size());
+
+          if ((attrName == "") || (attrName.find('.') != std::string::npos))
+          {
+            return false;
+          }
+
+          if (isSet)
+          {
+            attrsSet[attrName] = e;
+          }
+          else
+          {
+            attrsUnset.insert(attrName);
+          }
+        }
+        else if (path.find('.') != std::string::npos)
+        {
+          return false;
+        }
+        else if (isSet)
+        {
+          topSet[path] = e;
+        }
+        else
+        {
+          topUnset.insert(path);
+        }
+      }
+    }
+    else if (opName == "$addToSet")
+    {
+      BSONElement each = opObj.getFieldDotted(ENT_ATTRNAMES ".$each");
+
+      if ((opObj.nFields() != 1) || each.eoo() || (each.type() != Array))
+      {
+        return false;
+      }
+
+      toPush = each.Array();
+    }
+    else if (opName == "$pullAll")
+    {
+      BSONElement pull = opObj.getField(ENT_ATTRNAMES);
+
+      if ((opObj.nFields() != 1) || pull.eoo() || (pull.type() != Array))
+      {
+        return false;
+      }
+
+      toPull = pull.Array();
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  // Setting a whole top level field and pieces of it in the same update is a conflict for MongoDB
+  if ((topSet.find(ENT_ATTRS) != topSet.end()) && ((attrsSet.size() > 0) || (attrsUnset.size() > 0)))
+  {
+    return false;
+  }
+
+  if ((topSet.find(ENT_ATTRNAMES) != topSet.end()) && ((toPush.size() > 0) || (toPull.size() > 0)))
+  {
+    return false;
+  }
+
+  BSONObjBuilder  bob;
+  bool            attrsDone     = false;
+  bool            attrNamesDone = false;
+
+  for (BSONObj::iterator i = doc.begin(); i.more();)
+  {
+    BSONElement  e    = i.next();
+    std::string  name = e.fieldName();
+
+    std::map<std::string, BSONElement>::iterator iter = topSet.find(name);
+
+    if (iter != topSet.end())
+    {
+      bob.appendAs(iter->second, name);
+      topSet.erase(iter);
+    }
+    else if (topUnset.find(name) != topUnset.end())
+    {
+      continue;
+    }
+    else if ((name == ENT_ATTRS) && ((attrsSet.size() > 0) || (attrsUnset.size() > 0)))
+    {
+      if (e.type() != Object)
+      {
+        return false;
+      }
+
+      bob.append(ENT_ATTRS, attrsApply(e.embeddedObject(), attrsSet, attrsUnset));
+      attrsDone = true;
+    }
+    else if ((name == ENT_ATTRNAMES) && ((toPush.size() > 0) || (toPull.size() > 0)))
+    {
+      if (e.type() != Array)
+      {
+        return false;
+      }
+
+      bob.append(ENT_ATTRNAMES, attrNamesApply(e.embeddedObject(), toPush, toPull));
+      attrNamesDone = true;
+    }
+    else
+    {
+      bob.append(e);
+    }
+  }
+
+  // Fields not existing in the original document are added at the end
+  for (std::map<std::string, BSONElement>::iterator iter = topSet.begin(); iter != topSet.end(); ++iter)
+  {
+    bob.appendAs(iter->second, iter->first);
+  }
+
+  if (!attrsDone && (attrsSet.size() > 0))
+  {
+    bob.append(ENT_ATTRS, attrsApply(BSONObj(), attrsSet, attrsUnset));
+  }
+
+  if (!attrNamesDone && (toPush.size() > 0))
+  {
+    bob.append(ENT_ATTRNAMES, attrNamesApply(BSONObj(), toPush, toPull));
+  }
+
+  *resultP = bob.obj();
+
+  return true;
+}
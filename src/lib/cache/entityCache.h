@@ -0,0 +1,198 @@
+#ifndef SRC_LIB_CACHE_ENTITYCACHE_H_
+#define SRC_LIB_CACHE_ENTITYCACHE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+
+
+
+/* ****************************************************************************
+*
+* EntityCacheStatistics -
+*/
+typedef struct EntityCacheStatistics
+{
+  unsigned long long  hits;
+  unsigned long long  misses;
+  unsigned long long  inserts;
+  unsigned long long  updates;
+  unsigned long long  invalidations;
+  unsigned long long  evictions;
+  unsigned long long  expirations;
+  unsigned int        items;
+  unsigned int        size;
+} EntityCacheStatistics;
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInit -
+*
+* A size of zero disables the cache (all the other functions become no-ops)
+*/
+extern void entityCacheInit(unsigned int size);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheActive -
+*/
+extern bool entityCacheActive(void);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheKeyUsable -
+*
+* Only requests that identify exactly one entity document can be served by the cache:
+* no id/type patterns, a non-empty type and a single, non-recursive service path.
+*/
+extern bool entityCacheKeyUsable
+(
+  const std::string&               id,
+  bool                             idIsPattern,
+  const std::string&               type,
+  bool                             typeIsPattern,
+  const std::vector<std::string>&  servicePathV
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheEpoch -
+*
+* To be called before reading an entity from the database. The value returned is to be
+* passed to entityCacheFill() once the document has been read, so a fill racing with a
+* concurrent write or removal of the same entity is discarded.
+*/
+extern unsigned long long entityCacheEpoch
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheLookup -
+*/
+extern bool entityCacheLookup
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type,
+  mongo::BSONObj*     docP
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheFill -
+*/
+extern void entityCacheFill
+(
+  const std::string&     tenant,
+  const mongo::BSONObj&  doc,
+  unsigned long long     epoch
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheWrite -
+*
+* Write-through of an update already applied in the database. 'base' is the document the
+* update was computed from and 'update' the update document sent to the database
+* ($set, $unset, $addToSet and $pullAll operators, as composed by updateEntity()).
+*/
+extern void entityCacheWrite
+(
+  const std::string&     tenant,
+  const mongo::BSONObj&  base,
+  const mongo::BSONObj&  update
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheRemove -
+*/
+extern void entityCacheRemove
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  id,
+  const std::string&  type
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheStatisticsGet -
+*/
+extern void entityCacheStatisticsGet(EntityCacheStatistics* statsP);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheStatisticsReset -
+*/
+extern void entityCacheStatisticsReset(void);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheApplyUpdate -
+*
+* Applies an update document to an entity document, the way MongoDB would do it.
+* Returns false if the update uses some construct not supported.
+* Exported for unit testing.
+*/
+extern bool entityCacheApplyUpdate
+(
+  const mongo::BSONObj&  doc,
+  const mongo::BSONObj&  update,
+  mongo::BSONObj*        resultP
+);
+
+#endif  // SRC_LIB_CACHE_ENTITYCACHE_H_
@@ -0,0 +1,977 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <semaphore.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "mongo/client/dbclient.h"
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+#include "common/globals.h"
+#include "common/statistics.h"
+#include "common/regexCache.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/safeMongo.h"
+#include "mongoBackend/dbConstants.h"
+#include "cache/regCache.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* RegCacheEntity -
+*/
+typedef struct RegCacheEntity
+{
+  std::string  id;
+  std::string  type;
+  bool         hasType;
+  bool         idAndTypeOnly;   // The entity element has no other fields than id and type
+} RegCacheEntity;
+
+
+
+/* ****************************************************************************
+*
+* RegCacheItem -
+*
+* Note that the entities and attributes of all the contextRegistration elements of the
+* registration are flattened, the same way MongoDB does it for the
+* 'contextRegistration.entities' and 'contextRegistration.attrs.name' paths.
+*/
+typedef struct RegCacheItem
+{
+  BSONObj                      id;   // { _id: ... }, the key of the item
+  BSONObj                      reg;
+  long long                    expiration;
+  bool                         hasServicePath;
+  std::string                  servicePath;
+  std::vector<RegCacheEntity>  entities;
+  std::set<std::string>        attrs;
+} RegCacheItem;
+
+
+
+/* ****************************************************************************
+*
+* RegIdLess - same order than sort({_id: 1}) in DB
+*/
+struct RegIdLess
+{
+  bool operator()(const BSONObj& a, const BSONObj& b) const
+  {
+    return a.woCompare(b) < 0;
+  }
+};
+
+
+
+/* ****************************************************************************
+*
+* RegItemLess -
+*/
+struct RegItemLess
+{
+  bool operator()(const RegCacheItem* aP, const RegCacheItem* bP) const
+  {
+    return aP->id.woCompare(bP->id) < 0;
+  }
+};
+
+
+
+/* ****************************************************************************
+*
+* RegItemSet, RegIndex and RegCandidates -
+*/
+typedef std::set<RegCacheItem*>            RegItemSet;
+typedef std::map<std::string, RegItemSet>  RegIndex;
+typedef std::vector<const RegItemSet*>     RegCandidates;
+
+
+
+/* ****************************************************************************
+*
+* RegCacheTenant -
+*
+* Items are sorted by _id. The indexes map entity ids, attribute names and service paths
+* to the items with them (in any of their contextRegistration elements, for entities and
+* attributes). Items without service path are kept apart, in noServicePath.
+*/
+typedef struct RegCacheTenant
+{
+  std::map<BSONObj, RegCacheItem, RegIdLess>  items;
+  RegIndex                                    byEntityId;
+  RegIndex                                    byAttr;
+  RegIndex                                    byServicePath;
+  RegItemSet                                  noServicePath;
+  unsigned long long                          seq;
+} RegCacheTenant;
+
+
+
+/* ****************************************************************************
+*
+* RegCache -
+*
+* writeSeq keeps, for each tenant, the sequence number of the last write done in the cache,
+* so that a load started before it (and missing it) is never installed.
+*/
+typedef struct RegCache
+{
+  std::map<std::string, RegCacheTenant*>      tenants;
+  std::map<std::string, unsigned long long>   writeSeq;
+  unsigned long long                          loadSeq;
+} RegCache;
+
+static RegCache*  regCache = NULL;
+static sem_t      regCacheSem;
+
+
+
+/* ****************************************************************************
+*
+* regCacheInit -
+*/
+void regCacheInit(void)
+{
+  if (sem_init(&regCacheSem, 0, 1) == -1)
+  {
+    LM_X(1, ("Fatal Error (error initializing registration cache semaphore: %s)", strerror(errno)));
+  }
+
+  regCache = new RegCache();
+
+  regCache->loadSeq = 0;
+}
+
+
+
+#ifdef UNIT_TEST
+/* ****************************************************************************
+*
+* regCacheRelease -
+*/
+void regCacheRelease(void)
+{
+  if (regCache == NULL)
+  {
+    return;
+  }
+
+  for (std::map<std::string, RegCacheTenant*>::iterator iter = regCache->tenants.begin(); iter != regCache->tenants.end(); ++iter)
+  {
+    delete iter->second;
+  }
+
+  delete regCache;
+  regCache = NULL;
+}
+#endif
+
+
+
+/* ****************************************************************************
+*
+* itemFill -
+*/
+static bool itemFill(const BSONObj& reg, RegCacheItem* itemP)
+{
+  itemP->id             = BSON("_id" << getFieldF(reg, "_id"));
+  itemP->reg            = reg.getOwned();
+  itemP->expiration     = reg.hasField(REG_EXPIRATION)? getIntOrLongFieldAsLongF(reg, REG_EXPIRATION) : 0;
+  itemP->hasServicePath = reg.hasField(REG_SERVICE_PATH);
+  itemP->servicePath    = itemP->hasServicePath? getStringFieldF(reg, REG_SERVICE_PATH) : "";
+
+  if (!reg.hasField(REG_CONTEXT_REGISTRATION))
+  {
+    return false;
+  }
+
+  std::vector<BSONElement> crV = getFieldF(reg, REG_CONTEXT_REGISTRATION).Array();
+
+  for (unsigned int ix = 0; ix < crV.size(); ++ix)
+  {
+    BSONObj cr = crV[ix].embeddedObject();
+
+    if (cr.hasField(REG_ENTITIES))
+    {
+      std::vector<BSONElement> enV = getFieldF(cr, REG_ENTITIES).Array();
+
+      for (unsigned int jx = 0; jx < enV.size(); ++jx)
+      {
+        BSONObj         en = enV[jx].embeddedObject();
+        RegCacheEntity  entity;
+
+        entity.id            = en.hasField(REG_ENTITY_ID)? getStringFieldF(en, REG_ENTITY_ID) : "";
+        entity.hasType       = en.hasField(REG_ENTITY_TYPE);
+        entity.type          = entity.hasType? getStringFieldF(en, REG_ENTITY_TYPE) : "";
+        entity.idAndTypeOnly = entity.hasType && en.hasField(REG_ENTITY_ID) && (en.nFields() == 2);
+
+        itemP->entities.push_back(entity);
+      }
+    }
+
+    if (cr.hasField(REG_ATTRS))
+    {
+      std::vector<BSONElement> attrV = getFieldF(cr, REG_ATTRS).Array();
+
+      for (unsigned int jx = 0; jx < attrV.size(); ++jx)
+      {
+        itemP->attrs.insert(getStringFieldF(attrV[jx].embeddedObject(), REG_ATTRS_NAME));
+      }
+    }
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* indexErase -
+*/
+static void indexErase(RegIndex* indexP, const std::string& key, RegCacheItem* itemP)
+{
+  RegIndex::iterator iter = indexP->find(key);
+
+  if (iter == indexP->end())
+  {
+    return;
+  }
+
+  iter->second.erase(itemP);
+
+  if (iter->second.empty())
+  {
+    indexP->erase(iter);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantItemRemove -
+*/
+static void tenantItemRemove(RegCacheTenant* tenantP, const BSONObj& id)
+{
+  std::map<BSONObj, RegCacheItem, RegIdLess>::iterator iter = tenantP->items.find(id);
+
+  if (iter == tenantP->items.end())
+  {
+    return;
+  }
+
+  RegCacheItem* itemP = &iter->second;
+
+  for (unsigned int ix = 0; ix < itemP->entities.size(); ++ix)
+  {
+    indexErase(&tenantP->byEntityId, itemP->entities[ix].id, itemP);
+  }
+
+  for (std::set<std::string>::iterator aIter = itemP->attrs.begin(); aIter != itemP->attrs.end(); ++aIter)
+  {
+    indexErase(&tenantP->byAttr, *aIter, itemP);
+  }
+
+  if (itemP->hasServicePath)
+  {
+    indexErase(&tenantP->byServicePath, itemP->servicePath, itemP);
+  }
+  else
+  {
+    tenantP->noServicePath.erase(itemP);
+  }
+
+  tenantP->items.erase(iter);
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantItemInsert -
+*
+* Inserts (or replaces, if there is one with the same _id) a registration. Registrations
+* without contextRegistration are not kept, as they never match.
+*/
+static void tenantItemInsert(RegCacheTenant* tenantP, const BSONObj& reg)
+{
+  RegCacheItem item;
+
+  if (!itemFill(reg, &item))
+  {
+    tenantItemRemove(tenantP, item.id);
+    return;
+  }
+
+  tenantItemRemove(tenantP, item.id);
+
+  RegCacheItem* itemP = &tenantP->items[item.id];
+
+  *itemP = item;
+
+  for (unsigned int ix = 0; ix < itemP->entities.size(); ++ix)
+  {
+    tenantP->byEntityId[itemP->entities[ix].id].insert(itemP);
+  }
+
+  for (std::set<std::string>::iterator aIter = itemP->attrs.begin(); aIter != itemP->attrs.end(); ++aIter)
+  {
+    tenantP->byAttr[*aIter].insert(itemP);
+  }
+
+  if (itemP->hasServicePath)
+  {
+    tenantP->byServicePath[itemP->servicePath].insert(itemP);
+  }
+  else
+  {
+    tenantP->noServicePath.insert(itemP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantLoad -
+*
+* Returns NULL if the registrations collection of the tenant cannot be read
+*/
+static RegCacheTenant* tenantLoad(const std::string& tenant)
+{
+  std::auto_ptr<DBClientCursor>  cursor;
+  std::string                    err;
+  Query                          query;
+  RegCacheTenant*                tenantP = new RegCacheTenant();
+
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+
+  if (!collectionRangedQuery(connection, getRegistrationsCollectionName(tenant), query, 0, 0, &cursor, NULL, &err))
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    delete tenantP;
+    return NULL;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  while (moreSafe(cursor))
+  {
+    BSONObj reg;
+
+    if (!nextSafeOrErrorF(cursor, &reg, &err))
+    {
+      LM_E(("Runtime Error (exception in nextSafe(): %s - tenant: '%s')", err.c_str(), tenant.c_str()));
+      continue;
+    }
+
+    tenantItemInsert(tenantP, reg);
+  }
+  releaseMongoConnection(connection);
+
+  LM_T(LmtRegCache, ("Loaded %d registrations for tenant '%s'", tenantP->items.size(), tenant.c_str()));
+
+  return tenantP;
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantInstall -
+*
+* Semaphore must be taken before calling this function.
+* A snapshot older than the one already installed (a slower concurrent load) or than the
+* last write done in the cache for the tenant is discarded.
+*/
+static void tenantInstall(const std::string& tenant, RegCacheTenant* tenantP)
+{
+  std::map<std::string, RegCacheTenant*>::iterator     iter  = regCache->tenants.find(tenant);
+  std::map<std::string, unsigned long long>::iterator  wIter = regCache->writeSeq.find(tenant);
+
+  if ((wIter != regCache->writeSeq.end()) && (tenantP->seq < wIter->second))
+  {
+    delete tenantP;
+  }
+  else if (iter == regCache->tenants.end())
+  {
+    regCache->tenants[tenant] = tenantP;
+  }
+  else if (iter->second->seq < tenantP->seq)
+  {
+    delete iter->second;
+    iter->second = tenantP;
+  }
+  else
+  {
+    delete tenantP;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantWriteStart -
+*
+* Semaphore must be taken before calling this function.
+* Returns the tenant to apply a write to, NULL if the tenant is not loaded (it will be loaded,
+* with the write, on next lookup).
+*/
+static RegCacheTenant* tenantWriteStart(const std::string& tenant)
+{
+  unsigned long long seq = ++regCache->loadSeq;
+
+  regCache->writeSeq[tenant] = seq;
+
+  std::map<std::string, RegCacheTenant*>::iterator iter = regCache->tenants.find(tenant);
+
+  if (iter == regCache->tenants.end())
+  {
+    return NULL;
+  }
+
+  iter->second->seq = seq;
+
+  return iter->second;
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheItemUpsert -
+*/
+void regCacheItemUpsert(const std::string& tenant, const BSONObj& reg)
+{
+  if (regCache == NULL)
+  {
+    return;
+  }
+
+  sem_wait(&regCacheSem);
+
+  RegCacheTenant* tenantP = tenantWriteStart(tenant);
+
+  if (tenantP != NULL)
+  {
+    tenantItemInsert(tenantP, reg);
+  }
+
+  sem_post(&regCacheSem);
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheItemRemove -
+*/
+void regCacheItemRemove(const std::string& tenant, const OID& regId)
+{
+  if (regCache == NULL)
+  {
+    return;
+  }
+
+  sem_wait(&regCacheSem);
+
+  RegCacheTenant* tenantP = tenantWriteStart(tenant);
+
+  if (tenantP != NULL)
+  {
+    tenantItemRemove(tenantP, BSON("_id" << regId));
+  }
+
+  sem_post(&regCacheSem);
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheTenantRefresh -
+*/
+void regCacheTenantRefresh(const std::string& tenant)
+{
+  if (regCache == NULL)
+  {
+    return;
+  }
+
+  unsigned long long seq;
+
+  sem_wait(&regCacheSem);
+  seq = ++regCache->loadSeq;
+  sem_post(&regCacheSem);
+
+  RegCacheTenant* tenantP = tenantLoad(tenant);
+
+  sem_wait(&regCacheSem);
+
+  if (tenantP == NULL)
+  {
+    // The cache can no longer be trusted for this tenant. It will be loaded again on next lookup
+    std::map<std::string, RegCacheTenant*>::iterator iter = regCache->tenants.find(tenant);
+
+    if (iter != regCache->tenants.end())
+    {
+      delete iter->second;
+      regCache->tenants.erase(iter);
+    }
+  }
+  else
+  {
+    tenantP->seq = seq;
+    tenantInstall(tenant, tenantP);
+  }
+
+  sem_post(&regCacheSem);
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheRefresh -
+*/
+void regCacheRefresh(void)
+{
+  if (regCache == NULL)
+  {
+    return;
+  }
+
+  std::vector<std::string> tenants;
+
+  sem_wait(&regCacheSem);
+  for (std::map<std::string, RegCacheTenant*>::iterator iter = regCache->tenants.begin(); iter != regCache->tenants.end(); ++iter)
+  {
+    tenants.push_back(iter->first);
+  }
+  sem_post(&regCacheSem);
+
+  for (unsigned int ix = 0; ix < tenants.size(); ++ix)
+  {
+    regCacheTenantRefresh(tenants[ix]);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* servicePathMatch -
+*
+* Same semantics than fillQueryServicePath()
+*/
+static bool servicePathMatch(const RegCacheItem& item, const std::vector<std::string>& servicePathV)
+{
+  if (servicePathV[0] == "")
+  {
+    return !item.hasServicePath || (item.servicePath.compare(0, 1, "/") == 0);
+  }
+
+  for (unsigned int ix = 0; ix < servicePathV.size(); ++ix)
+  {
+    const std::string& sp = servicePathV[ix];
+
+    if (!item.hasServicePath)
+    {
+      if ((sp == "/") || (sp == "/#"))
+      {
+        return true;
+      }
+
+      continue;
+    }
+
+    if ((sp.size() >= 2) && (sp.compare(sp.size() - 2, 2, "/#") == 0))
+    {
+      std::string base = sp.substr(0, sp.size() - 2);
+
+      if ((item.servicePath == base) || (item.servicePath.compare(0, base.size() + 1, base + "/") == 0))
+      {
+        return true;
+      }
+    }
+    else if (item.servicePath == sp)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityMatch -
+*
+* Same semantics than the '$or' part of the query built by registrationsQuery(). Note that
+* the id regex and the type are checked independently on the entities array, as MongoDB does.
+*/
+static bool entityMatch(const RegCacheItem& item, const EntityIdVector& enV, const std::vector<CachedRegex*>& regexV)
+{
+  for (unsigned int ix = 0; ix < enV.size(); ++ix)
+  {
+    const EntityId* enP = enV[ix];
+
+    if (regexV[ix] != NULL)
+    {
+      bool idMatch   = false;
+      bool typeMatch = (enP->type == "");
+
+      for (unsigned int jx = 0; jx < item.entities.size(); ++jx)
+      {
+        if (!idMatch && regexCacheMatch(regexV[ix], item.entities[jx].id.c_str()))
+        {
+          idMatch = true;
+        }
+
+        if (!typeMatch && item.entities[jx].hasType && (item.entities[jx].type == enP->type))
+        {
+          typeMatch = true;
+        }
+      }
+
+      if (idMatch && typeMatch)
+      {
+        return true;
+      }
+    }
+    else
+    {
+      for (unsigned int jx = 0; jx < item.entities.size(); ++jx)
+      {
+        const RegCacheEntity& entity = item.entities[jx];
+
+        if (entity.id != enP->id)
+        {
+          continue;
+        }
+
+        if ((enP->type == "") || (entity.idAndTypeOnly && (entity.type == enP->type)))
+        {
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* attributeMatch -
+*/
+static bool attributeMatch(const RegCacheItem& item, const StringList& attrL)
+{
+  if (attrL.size() == 0)
+  {
+    return true;
+  }
+
+  for (unsigned int ix = 0; ix < attrL.size(); ++ix)
+  {
+    if (item.attrs.find(attrL[ix]) != item.attrs.end())
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* indexCandidates -
+*
+* Adds to candidatesVP the items of the index with any of the keys (and to sizeVP the
+* number of them, counting twice the items with several keys)
+*/
+static void indexCandidates
+(
+  const RegIndex&                  index,
+  const std::vector<std::string>&  keyV,
+  std::vector<RegCandidates>*      candidatesVP,
+  std::vector<size_t>*             sizeVP
+)
+{
+  RegCandidates  candidates;
+  size_t         size = 0;
+
+  for (unsigned int ix = 0; ix < keyV.size(); ++ix)
+  {
+    RegIndex::const_iterator iter = index.find(keyV[ix]);
+
+    if (iter != index.end())
+    {
+      candidates.push_back(&iter->second);
+      size += iter->second.size();
+    }
+  }
+
+  candidatesVP->push_back(candidates);
+  sizeVP->push_back(size);
+}
+
+
+
+/* ****************************************************************************
+*
+* servicePathCandidates -
+*
+* Same as indexCandidates() for the service path index, with the semantics of
+* servicePathMatch() (servicePathV[0] must not be empty)
+*/
+static void servicePathCandidates
+(
+  const RegCacheTenant*            tenantP,
+  const std::vector<std::string>&  servicePathV,
+  std::vector<RegCandidates>*      candidatesVP,
+  std::vector<size_t>*             sizeVP
+)
+{
+  const RegIndex&  index = tenantP->byServicePath;
+  RegCandidates    candidates;
+  size_t           size  = 0;
+  bool             root  = false;
+
+  for (unsigned int ix = 0; ix < servicePathV.size(); ++ix)
+  {
+    const std::string&        sp = servicePathV[ix];
+    RegIndex::const_iterator  iter;
+
+    if ((sp == "/") || (sp == "/#"))
+    {
+      root = true;
+    }
+
+    if ((sp.size() >= 2) && (sp.compare(sp.size() - 2, 2, "/#") == 0))
+    {
+      std::string base   = sp.substr(0, sp.size() - 2);
+      std::string prefix = base + "/";
+
+      if ((iter = index.find(base)) != index.end())
+      {
+        candidates.push_back(&iter->second);
+        size += iter->second.size();
+      }
+
+      for (iter = index.lower_bound(prefix); iter != index.end(); ++iter)
+      {
+        if (iter->first.compare(0, prefix.size(), prefix) != 0)
+        {
+          break;
+        }
+
+        candidates.push_back(&iter->second);
+        size += iter->second.size();
+      }
+    }
+    else if ((iter = index.find(sp)) != index.end())
+    {
+      candidates.push_back(&iter->second);
+      size += iter->second.size();
+    }
+  }
+
+  if (root)
+  {
+    candidates.push_back(&tenantP->noServicePath);
+    size += tenantP->noServicePath.size();
+  }
+
+  candidatesVP->push_back(candidates);
+  sizeVP->push_back(size);
+}
+
+
+
+/* ****************************************************************************
+*
+* regCacheMatch -
+*/
+bool regCacheMatch
+(
+  const std::string&               tenant,
+  const EntityIdVector&            enV,
+  const StringList&                attrL,
+  const std::vector<std::string>&  servicePathV,
+  std::vector<BSONObj>*            regV
+)
+{
+  if (regCache == NULL)
+  {
+    return false;
+  }
+
+  sem_wait(&regCacheSem);
+  bool loaded = (regCache->tenants.find(tenant) != regCache->tenants.end());
+  sem_post(&regCacheSem);
+
+  // First usage of the tenant: load it
+  if (!loaded)
+  {
+    regCacheTenantRefresh(tenant);
+  }
+
+  //
+  // Compile regex for patterned entities and check if the index can be used
+  //
+  std::vector<CachedRegex*>  regexV;
+  bool                       useIndex = true;
+  bool                       ok       = true;
+
+  for (unsigned int ix = 0; ix < enV.size(); ++ix)
+  {
+    CachedRegex* regexP = NULL;
+
+    if (isTrue(enV[ix]->isPattern))
+    {
+      useIndex = false;
+
+      if ((regexP = regexCacheGet(enV[ix]->id)) == NULL)
+      {
+        ok = false;  // Let the DB deal with it
+      }
+    }
+
+    regexV.push_back(regexP);
+  }
+
+  sem_wait(&regCacheSem);
+
+  std::map<std::string, RegCacheTenant*>::iterator iter = regCache->tenants.find(tenant);
+
+  if (!ok || (iter == regCache->tenants.end()))
+  {
+    ok = false;
+  }
+  else
+  {
+    RegCacheTenant*  tenantP = iter->second;
+    long long        now     = getCurrentTime();
+
+    //
+    // Candidates, from the most selective of the indexes that can be used. Sorted by _id
+    // as they are returned in that order
+    //
+    std::vector<RegCandidates>  candidatesV;
+    std::vector<size_t>         sizeV;
+
+    if (useIndex)
+    {
+      std::vector<std::string> idV;
+
+      for (unsigned int ix = 0; ix < enV.size(); ++ix)
+      {
+        idV.push_back(enV[ix]->id);
+      }
+
+      indexCandidates(tenantP->byEntityId, idV, &candidatesV, &sizeV);
+    }
+
+    if (attrL.size() != 0)
+    {
+      indexCandidates(tenantP->byAttr, attrL.stringV, &candidatesV, &sizeV);
+    }
+
+    if (servicePathV[0] != "")
+    {
+      servicePathCandidates(tenantP, servicePathV, &candidatesV, &sizeV);
+    }
+
+    std::set<const RegCacheItem*, RegItemLess> candidates;
+
+    if (candidatesV.empty())
+    {
+      for (std::map<BSONObj, RegCacheItem, RegIdLess>::iterator iIter = tenantP->items.begin(); iIter != tenantP->items.end(); ++iIter)
+      {
+        candidates.insert(&iIter->second);
+      }
+    }
+    else
+    {
+      unsigned int best = 0;
+
+      for (unsigned int ix = 1; ix < sizeV.size(); ++ix)
+      {
+        if (sizeV[ix] < sizeV[best])
+        {
+          best = ix;
+        }
+      }
+
+      for (unsigned int ix = 0; ix < candidatesV[best].size(); ++ix)
+      {
+        candidates.insert(candidatesV[best][ix]->begin(), candidatesV[best][ix]->end());
+      }
+    }
+
+    for (std::set<const RegCacheItem*, RegItemLess>::iterator cIter = candidates.begin(); cIter != candidates.end(); ++cIter)
+    {
+      const RegCacheItem& item = **cIter;
+
+      if ((item.expiration > now)              &&
+          servicePathMatch(item, servicePathV) &&
+          attributeMatch(item, attrL)          &&
+          entityMatch(item, enV, regexV))
+      {
+        regV->push_back(item.reg);
+      }
+    }
+  }
+
+  sem_post(&regCacheSem);
+
+  for (unsigned int ix = 0; ix < regexV.size(); ++ix)
+  {
+    regexCacheRelease(regexV[ix]);
+  }
+
+  return ok;
+}
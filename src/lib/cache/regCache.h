@@ -0,0 +1,114 @@
+#ifndef SRC_LIB_CACHE_REGCACHE_H_
+#define SRC_LIB_CACHE_REGCACHE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+
+#include "ngsi/EntityIdVector.h"
+#include "ngsi/StringList.h"
+
+
+
+/* ****************************************************************************
+*
+* regCacheInit -
+*/
+extern void regCacheInit(void);
+
+
+
+#ifdef UNIT_TEST
+extern void regCacheRelease(void);
+#endif
+
+
+
+/* ****************************************************************************
+*
+* regCacheMatch -
+*
+* Looks for the registrations of a tenant matching the same conditions used by
+* registrationsQuery() in the DB query. The registration documents are returned sorted
+* by _id, as in the DB query.
+*
+* Returns false if the cache cannot solve the lookup (cache disabled or tenant not
+* loaded due to DB error), so the DB has to be queried.
+*/
+extern bool regCacheMatch
+(
+  const std::string&               tenant,
+  const EntityIdVector&            enV,
+  const StringList&                attrL,
+  const std::vector<std::string>&  servicePathV,
+  std::vector<mongo::BSONObj>*     regV
+);
+
+
+
+/* ****************************************************************************
+*
+* regCacheItemUpsert -
+*
+* To be called after a registration (reg, with its _id) is written in DB
+*/
+extern void regCacheItemUpsert(const std::string& tenant, const mongo::BSONObj& reg);
+
+
+
+/* ****************************************************************************
+*
+* regCacheItemRemove -
+*
+* To be called after a registration is removed from DB
+*/
+extern void regCacheItemRemove(const std::string& tenant, const mongo::OID& regId);
+
+
+
+/* ****************************************************************************
+*
+* regCacheTenantRefresh -
+*
+* Reloads a tenant. To be called when a write in the registrations collection of the tenant
+* fails, as it is not known whether it has been done or not
+*/
+extern void regCacheTenantRefresh(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* regCacheRefresh -
+*
+* Reloads all the tenants in the cache (registrations could have been modified by
+* other CB nodes)
+*/
+extern void regCacheRefresh(void);
+
+#endif  // SRC_LIB_CACHE_REGCACHE_H_
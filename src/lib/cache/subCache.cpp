@@ -23,22 +23,33 @@
 * Author: Ken Zangelin
 */
 #include <sys/types.h>
-#include <regex.h>
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
 #include "common/sem.h"
 #include "common/string.h"
+#include "common/globals.h"
+#include "common/TimerWheel.h"
+#include "common/regexCache.h"
 #include "apiTypesV2/HttpInfo.h"
 #include "apiTypesV2/Subscription.h"
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/mongoSubCache.h"
+#include "cache/regCache.h"
+#include "cache/casubCache.h"
 #include "ngsi10/SubscribeContextRequest.h"
 #include "cache/subCache.h"
+#include "cache/subCacheSnapshot.h"
 #include "alarmMgr/alarmMgr.h"
 
 using std::map;
@@ -83,51 +94,30 @@ EntityInfo::EntityInfo
   bool                _isTypePattern
 )
 :
-entityId(_entityId), entityType(_entityType), isTypePattern(_isTypePattern)
+entityId(_entityId), entityIdPattern(NULL), entityType(_entityType), isTypePattern(_isTypePattern), entityTypePattern(NULL)
 {
   isPattern    = (_isPattern == "true") || (_isPattern == "TRUE") || (_isPattern == "True");
 
   if (isPattern)
   {
-    // FIXME P5: recomp error should be captured? have a look to other usages of regcomp()
-    // in order to see how it works
-    if (regcomp(&entityIdPattern, _entityId.c_str(), REG_EXTENDED) != 0)
+    // The compiled regex is shared with any other subscription (or request) using the same pattern
+    if ((entityIdPattern = regexCacheGet(_entityId)) == NULL)
     {
       alarmMgr.badInput(clientIp, "invalid regular expression for idPattern");
       isPattern = false;  // FIXME P6: this entity should not be let into the system. Must be stopped before.
                           //           Right here, best thing to do is simply to say it is not a regex
-      entityIdPatternToBeFreed = false;
-    }
-    else
-    {
-      entityIdPatternToBeFreed = true;
     }
   }
-  else
-  {
-    entityIdPatternToBeFreed = false;
-  }
 
   if (isTypePattern)
   {
-    // FIXME P5: recomp error should be captured? have a look to other usages of regcomp()
-    // in order to see how it works
-    if (regcomp(&entityTypePattern, _entityType.c_str(), REG_EXTENDED) != 0)
+    if ((entityTypePattern = regexCacheGet(_entityType)) == NULL)
     {
       alarmMgr.badInput(clientIp, "invalid regular expression for typePattern");
       isTypePattern = false;  // FIXME P6: this entity should not be let into the system. Must be stopped before.
                           //           Right here, best thing to do is simply to say it is not a regex
-      entityTypePatternToBeFreed = false;
-    }
-    else
-    {
-      entityTypePatternToBeFreed = true;
     }
   }
-  else
-  {
-    entityTypePatternToBeFreed = false;
-  }
 }
 
 
@@ -149,7 +139,7 @@ bool EntityInfo::match
   if (isPattern)
   {
     // REGEX-comparison this->entityIdPattern VS id
-    matchedId =  (regexec(&entityIdPattern, id.c_str(), 0, NULL, 0) == 0);
+    matchedId =  regexCacheMatch(entityIdPattern, id.c_str());
   }
   else if (id == entityId)
   {
@@ -167,7 +157,7 @@ bool EntityInfo::match
     if (isTypePattern)
     {
       // REGEX-comparison this->entityTypePattern VS type
-      matchedType = (regexec(&entityTypePattern, type.c_str(), 0, NULL, 0) == 0);
+      matchedType = regexCacheMatch(entityTypePattern, type.c_str());
     }
     else if ((type != "")  && (entityType != "") && (entityType != type))
     {
@@ -190,17 +180,11 @@ bool EntityInfo::match
 */
 void EntityInfo::release(void)
 {
-  if (entityIdPatternToBeFreed)
-  {
-    regfree(&entityIdPattern);  // If regcomp fails it frees up itself (see glibc sources for details)
-    entityIdPatternToBeFreed = false;
-  }
+  regexCacheRelease(entityIdPattern);
+  entityIdPattern = NULL;
 
-  if (entityTypePatternToBeFreed)
-  {
-    regfree(&entityTypePattern);  // If regcomp fails it frees up itself (see glibc sources for details)
-    entityTypePatternToBeFreed = false;
-  }
+  regexCacheRelease(entityTypePattern);
+  entityTypePattern = NULL;
 }
 
 
@@ -213,6 +197,7 @@ typedef struct SubCache
 {
   CachedSubscription* head;
   CachedSubscription* tail;
+  CachedSubscription* expiredHead;
 
   // Statistics counters
   int                 noOfRefreshes;
@@ -227,24 +212,70 @@ typedef struct SubCache
 *
 * subCache -
 */
-static SubCache  subCache            = { NULL, NULL, 0, 0, 0, 0 };
+static SubCache  subCache            = { NULL, NULL, NULL, 0, 0, 0, 0 };
 bool             subCacheActive      = false;
 bool             subCacheMultitenant = false;
 
 
 
+/* ****************************************************************************
+*
+* Synchronization -
+*
+* While subCacheSync() loads the DB (without the cache semaphore), the ids of the
+* subscriptions inserted or removed in the cache are recorded, as the cache has a newer
+* version of them than the one loaded. Protected by the cache semaphore.
+*/
+static bool                   syncLoading = false;
+static std::set<std::string>  syncChanged;
+
+
+
+/* ****************************************************************************
+*
+* Parallel load -
+*
+* The load statistics have their own mutex, as they are updated while the cache
+* semaphore is taken by the refresh.
+*/
+static unsigned int                                     subCacheLoaders = 1;
+static unsigned int                                     loadDatabases   = 0;
+static unsigned int                                     loadLoaded      = 0;
+static long long                                        loadDuration    = 0;
+static std::vector<std::pair<std::string, long long> >  loadTimes;
+static pthread_mutex_t                                  loadStatsMutex  = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* Timers -
+*
+* The expiry timer of each subscription (when it expires) and its throttling timer (when a
+* deferred notification is pending), in ticks of one second. The wheel is protected by the
+* cache semaphore. Its time is set in subCacheInit() and advanced by subCacheTimerThread().
+*/
+static TimerWheel  subCacheTimers;
+static bool        throttlingDeferred = false;
+
+
+
 /* ****************************************************************************
 *
 * subCacheInit -
 */
-void subCacheInit(bool multitenant)
+void subCacheInit(bool multitenant, unsigned int loaders, bool _throttlingDeferred)
 {
   LM_T(LmtSubCache, ("Initializing subscription cache"));
   subCacheMultitenant = multitenant;
+  subCacheLoaders     = (loaders == 0)? 1 : loaders;
+  throttlingDeferred  = _throttlingDeferred;
 
-  subCache.head   = NULL;
-  subCache.tail   = NULL;
+  subCache.head        = NULL;
+  subCache.tail        = NULL;
+  subCache.expiredHead = NULL;
 
+  subCacheTimers.reset(getCurrentTime());
   subCacheStatisticsReset("subCacheInit");
 
   subCacheActive = true;
@@ -272,13 +303,13 @@ void subCacheDisable(void)
 */
 int subCacheItems(void)
 {
-  CachedSubscription* cSubP = subCache.head;
+  CachedSubscription* cSubP = subCacheHead();
   int                 items = 0;
 
   while (cSubP != NULL)
   {
     ++items;
-    cSubP = cSubP->next;
+    cSubP = subCacheItemNext(cSubP);
   }
 
   return items;
@@ -569,7 +600,13 @@ void subCacheItemDestroy(CachedSubscription* cSubP)
 
   cSubP->notifyConditionV.clear();
 
+  subCacheTimers.cancel(&cSubP->expiryTimer);
+  subCacheTimers.cancel(&cSubP->throttlingTimer);
+  cSubP->deferredEntities.clear();
+  cSubP->deferredXauthToken.clear();
+
   cSubP->next = NULL;
+  cSubP->prev = NULL;
 }
 
 
@@ -582,29 +619,24 @@ void subCacheDestroy(void)
 {
   LM_T(LmtSubCache, ("destroying subscription cache"));
 
-  CachedSubscription* cSubP  = subCache.head;
+  CachedSubscription* cSubP = subCacheHead();
 
-  if (subCache.head == NULL)
-  {
-    return;
-  }
+  subCacheTimers.clear();
 
-  while (cSubP->next)
+  while (cSubP != NULL)
   {
-    CachedSubscription* prev = cSubP;
+    CachedSubscription* next = subCacheItemNext(cSubP);
 
-    cSubP = cSubP->next;
-    subCacheItemDestroy(prev);
-    LM_T(LmtSubCache,  ("removing CachedSubscription at %p", prev));
-    delete prev;
-  }
+    subCacheItemDestroy(cSubP);
+    LM_T(LmtSubCache,  ("removing CachedSubscription at %p", cSubP));
+    delete cSubP;
 
-  subCacheItemDestroy(cSubP);
-  LM_T(LmtSubCache,  ("removing CachedSubscription at %p", cSubP));
-  delete cSubP;
+    cSubP = next;
+  }
 
-  subCache.head  = NULL;
-  subCache.tail  = NULL;
+  subCache.head        = NULL;
+  subCache.tail        = NULL;
+  subCache.expiredHead = NULL;
 }
 
 
@@ -648,7 +680,7 @@ static bool tenantMatch(const char* tenant1, const char* tenant2)
 */
 CachedSubscription* subCacheItemLookup(const char* tenant, const char* subscriptionId)
 {
-  CachedSubscription* cSubP = subCache.head;
+  CachedSubscription* cSubP = subCacheHead();
 
   while (cSubP != NULL)
   {
@@ -657,7 +689,7 @@ CachedSubscription* subCacheItemLookup(const char* tenant, const char* subscript
       return cSubP;
     }
 
-    cSubP = cSubP->next;
+    cSubP = subCacheItemNext(cSubP);
   }
 
   return NULL;
@@ -665,6 +697,107 @@ CachedSubscription* subCacheItemLookup(const char* tenant, const char* subscript
 
 
 
+/* ****************************************************************************
+*
+* subCacheItemUnlink - take a subscription out of its list (active or expired)
+*/
+static void subCacheItemUnlink(CachedSubscription* cSubP)
+{
+  if (cSubP->prev != NULL)
+  {
+    cSubP->prev->next = cSubP->next;
+  }
+  else if (cSubP->expired)
+  {
+    subCache.expiredHead = cSubP->next;
+  }
+  else
+  {
+    subCache.head = cSubP->next;
+  }
+
+  if (cSubP->next != NULL)
+  {
+    cSubP->next->prev = cSubP->prev;
+  }
+  else if (!cSubP->expired)
+  {
+    subCache.tail = cSubP->prev;
+  }
+
+  cSubP->next = NULL;
+  cSubP->prev = NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheItemExpire - move a subscription (not in any list) to the expired list
+*/
+static void subCacheItemExpire(CachedSubscription* cSubP)
+{
+  subCacheTimers.cancel(&cSubP->throttlingTimer);
+  cSubP->deferredEntities.clear();
+  cSubP->deferredXauthToken.clear();
+
+  cSubP->expired = true;
+  cSubP->prev    = NULL;
+  cSubP->next    = subCache.expiredHead;
+
+  if (subCache.expiredHead != NULL)
+  {
+    subCache.expiredHead->prev = cSubP;
+  }
+
+  subCache.expiredHead = cSubP;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheItemArm - put a subscription (not in any list) in the list of its state
+*
+* An active subscription goes to the end of the active list, with its expiry timer scheduled
+* (as expired subscriptions are skipped when expirationTime < now, the timer is due the
+* second after).
+*/
+static void subCacheItemArm(CachedSubscription* cSubP, int64_t now)
+{
+  cSubP->expiryTimer.ownerP     = cSubP;
+  cSubP->throttlingTimer.ownerP = cSubP;
+
+  if (cSubP->expirationTime < now)
+  {
+    LM_T(LmtSubCache, ("sub '%s' is expired, not matched", cSubP->subscriptionId));
+    subCacheItemExpire(cSubP);
+    return;
+  }
+
+  cSubP->expired = false;
+  cSubP->next    = NULL;
+  cSubP->prev    = subCache.tail;
+
+  if (subCache.tail == NULL)
+  {
+    subCache.head = cSubP;
+  }
+  else
+  {
+    subCache.tail->next = cSubP;
+  }
+
+  subCache.tail = cSubP;
+
+  if (cSubP->expirationTime != PERMANENT_EXPIRES_DATETIME)
+  {
+    subCacheTimers.schedule(&cSubP->expiryTimer, cSubP->expirationTime + 1);
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * subCacheUpdateStatisticsIncrement -
@@ -690,29 +823,62 @@ void subCacheUpdateStatisticsIncrement(void)
 * calls this function.
 *
 * So, the subscription itself is untouched by this function, is it ONLY inserted
-* in the list (only the 'next' field is modified).
+* in the list (only the 'next' and 'prev' fields are modified) and its expiry timer
+* is scheduled. The only exception are the templates of custom notifications, parsed
+* here once for all the notifications the subscription will trigger while it stays in
+* the cache.
 *
+* A subscription already expired goes to the expired list, so it is not matched.
 */
 void subCacheItemInsert(CachedSubscription* cSubP)
 {
   cSubP->next = NULL;
 
+  if (cSubP->httpInfo.custom)
+  {
+    cSubP->httpInfo.templatesParse();
+  }
+
   LM_T(LmtSubCache, ("inserting sub '%s', lastNotificationTime: %lu",
                      cSubP->subscriptionId, cSubP->lastNotificationTime));
 
   ++subCache.noOfInserts;
 
-  // First insertion?
-  if ((subCache.head == NULL) && (subCache.tail == NULL))
+  if (syncLoading)
   {
-    subCache.head   = cSubP;
-    subCache.tail   = cSubP;
+    syncChanged.insert(cSubP->subscriptionId);
+  }
 
-    return;
+  subCacheItemArm(cSubP, getCurrentTime());
+}
+
+
+
+/* ****************************************************************************
+*
+* subCachePartitionInsert -
+*/
+void subCachePartitionInsert(SubCachePartition* partP, CachedSubscription* cSubP)
+{
+  cSubP->next = NULL;
+
+  if (cSubP->httpInfo.custom)
+  {
+    cSubP->httpInfo.templatesParse();
+  }
+
+  if (partP->tail == NULL)
+  {
+    partP->head = cSubP;
+  }
+  else
+  {
+    partP->tail->next = cSubP;
   }
 
-  subCache.tail->next  = cSubP;
-  subCache.tail        = cSubP;
+  cSubP->prev = partP->tail;
+  partP->tail = cSubP;
+  ++partP->items;
 }
 
 
@@ -860,7 +1026,7 @@ void subCacheStatisticsGet
   *updates   = subCache.noOfUpdates;
   *items     = subCacheItems();
 
-  CachedSubscription* cSubP = subCache.head;
+  CachedSubscription* cSubP = subCacheHead();
 
   //
   // NOTE
@@ -907,7 +1073,7 @@ void subCacheStatisticsGet
 
       strcat(list, msg);
 
-      cSubP = cSubP->next;
+      cSubP = subCacheItemNext(cSubP);
     }
   }
   else
@@ -941,193 +1107,527 @@ void subCacheStatisticsReset(const char* by)
 */
 int subCacheItemRemove(CachedSubscription* cSubP)
 {
-  CachedSubscription* current = subCache.head;
-  CachedSubscription* prev    = NULL;
+  LM_T(LmtSubCache, ("in subCacheItemRemove, REMOVING '%s'", cSubP->subscriptionId));
 
-  LM_T(LmtSubCache, ("in subCacheItemRemove, trying to remove '%s'", cSubP->subscriptionId));
-  while (current != NULL)
+  subCacheItemUnlink(cSubP);
+  ++subCache.noOfRemoves;
+
+  if (syncLoading)
   {
-    if (current == cSubP)
-    {
-      // Removing first item ?
-      if (cSubP == subCache.head)
-      {
-        subCache.head = cSubP->next;
-      }
+    syncChanged.insert(cSubP->subscriptionId);
+  }
 
-      // Removing last item?
-      if (cSubP == subCache.tail)
-      {
-        subCache.tail = prev;
-      }
+  subCacheItemDestroy(cSubP);
+  delete cSubP;
 
-      // Removing middle item?
-      if (prev != NULL)
-      {
-        prev->next = cSubP->next;
-      }
+  return 0;
+}
 
-      LM_T(LmtSubCache, ("in subCacheItemRemove, REMOVING '%s'", cSubP->subscriptionId));
-      ++subCache.noOfRemoves;
 
-      subCacheItemDestroy(cSubP);
-      delete cSubP;
 
-      return 0;
-    }
+/* ****************************************************************************
+*
+* subCacheAppend - move the subscriptions of a partition to the end of the cache
+*/
+static void subCacheAppend(SubCachePartition* partP)
+{
+  CachedSubscription*  cSubP = partP->head;
+  int64_t              now   = getCurrentTime();
+
+  while (cSubP != NULL)
+  {
+    CachedSubscription* next = cSubP->next;
 
-    prev    = current;
-    current = current->next;
+    subCacheItemArm(cSubP, now);
+    cSubP = next;
   }
 
-  LM_E(("Runtime Error (item to remove from sub-cache not found)"));
-  return -1;
+  subCache.noOfInserts += partP->items;
+
+  partP->head  = NULL;
+  partP->tail  = NULL;
+  partP->items = 0;
 }
 
 
 
 /* ****************************************************************************
 *
-* subCacheRefresh -
-*
-* WARNING
-*  The cache semaphore must be taken before this function is called:
-*    cacheSemTake(__FUNCTION__, "Reason");
-*  And released after subCacheRefresh finishes, of course.
+* subCacheReplace -
 */
-void subCacheRefresh(void)
+void subCacheReplace(SubCachePartition* partP)
 {
-  std::vector<std::string> databases;
+  subCacheDestroy();
+  subCacheAppend(partP);
+}
 
-  LM_T(LmtSubCache, ("Refreshing subscription cache"));
 
-  // Empty the cache
-  subCacheDestroy();
 
-  // Get list of database
-  if (mongoMultitenant())
-  {
-    getOrionDatabases(&databases);
-  }
+/* ****************************************************************************
+*
+* subCacheHead -
+*/
+CachedSubscription* subCacheHead(void)
+{
+  return (subCache.head != NULL)? subCache.head : subCache.expiredHead;
+}
 
-  // Add the 'default tenant'
-  databases.push_back(getDbPrefix());
 
 
-  // Now refresh the subCache for each and every tenant
-  for (unsigned int ix = 0; ix < databases.size(); ++ix)
+/* ****************************************************************************
+*
+* subCacheItemNext -
+*/
+CachedSubscription* subCacheItemNext(CachedSubscription* cSubP)
+{
+  if (cSubP->next != NULL)
   {
-    LM_T(LmtSubCache, ("DB %d: %s", ix, databases[ix].c_str()));
-    mongoSubCacheRefresh(databases[ix]);
+    return cSubP->next;
   }
 
-  ++subCache.noOfRefreshes;
-  LM_T(LmtSubCache, ("Refreshed subscription cache [%d]", subCache.noOfRefreshes));
+  return cSubP->expired? NULL : subCache.expiredHead;
 }
 
 
 
 /* ****************************************************************************
 *
-* CachedSubSaved -
+* msSince -
 */
-typedef struct CachedSubSaved
+static long long msSince(const struct timespec& start)
 {
-  int64_t  lastNotificationTime;
-  int64_t  count;
-  int64_t  lastFailure;
-  int64_t  lastSuccess;
-} CachedSubSaved;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+}
 
 
 
 /* ****************************************************************************
 *
-* subCacheSync -
+* SubCacheLoad - state shared by the loaders of a refresh
+*/
+typedef struct SubCacheLoad
+{
+  const std::vector<std::string>*   databasesP;
+  std::vector<SubCachePartition>*   partitionsP;
+  unsigned int                      next;        // next database to load
+} SubCacheLoad;
+
+
+
+/* ****************************************************************************
 *
-* 1. Save subscriptionId, lastNotificationTime, count, lastFailure, and lastSuccess for all items in cache (savedSubV)
-* 2. Refresh cache (count set to 0)
-* 3. Compare lastNotificationTime/lastFailure/lastSuccess in savedSubV with the new cache-contents and:
-*    3.1 Update cache-items where 'saved lastNotificationTime' > 'cached lastNotificationTime'
-*    3.2 Remember this more correct lastNotificationTime (must be flushed to mongo) -
-*        by clearing out (set to 0) those lastNotificationTimes that are newer in cache
-*    Same same with lastFailure and lastSuccess.
-* 4. Update 'count' for each item in savedSubV where non-zero
-* 5. Update 'lastNotificationTime/lastFailure/lastSuccess' for each item in savedSubV where non-zero
-* 6. Free the vector created in step 1 - savedSubV
+* subCacheLoader -
 *
-* NOTE
-*   This function runs in a separate thread and it allocates temporal objects (in savedSubV).
-*   If the broker dies when this function is executing, all these temporal objects will be reported
-*   as memory leaks.
-*   We see this in our valgrind tests, where we force the broker to die.
-*   This is of course not a real leak, we only see this as a leak as the function hasn't finished to
-*   execute until the point where the temporal objects are deleted (See '6. Free the vector savedSubV').
-*   To fix this little problem, we have created a variable 'subCacheState' that is set to ScsSynchronizing while
-*   the sub-cache synchronization is working.
-*   In serviceRoutines/exitTreat.cpp this variable is checked and if iot is set to ScsSynchronizing, then a
-*   sleep for a few seconds is performed before the broker exits (this is only for DEBUG compilations).
+* Loads databases (each one in its partition) until there is none left
 */
-void subCacheSync(void)
+static void* subCacheLoader(void* vP)
 {
-  std::map<std::string, CachedSubSaved*> savedSubV;
+  SubCacheLoad*  loadP = (SubCacheLoad*) vP;
+  unsigned int   ix;
 
-  cacheSemTake(__FUNCTION__, "Synchronizing subscription cache");
-  subCacheState = ScsSynchronizing;
+  while ((ix = __sync_fetch_and_add(&loadP->next, 1)) < loadP->databasesP->size())
+  {
+    const std::string&  database = (*loadP->databasesP)[ix];
+    SubCachePartition*  partP    = &(*loadP->partitionsP)[ix];
+    struct timespec     start;
 
+    LM_T(LmtSubCache, ("DB %d: %s", ix, database.c_str()));
 
-  //
-  // 1. Save subscriptionId, lastNotificationTime, count, lastFailure, and lastSuccess for all items in cache
-  //
-  CachedSubscription* cSubP = subCache.head;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    mongoSubCacheRefresh(database, partP);
+    partP->loadTime = msSince(start);
 
-  while (cSubP != NULL)
-  {
-    //
-    // FIXME P7: For some reason, sometimes the same subscription is found twice in the cache (Issue 2216)
-    //           Once the issue 2216 is fixed, this if-block must be removed.
-    //
-    if (savedSubV[cSubP->subscriptionId] != NULL)
+    unsigned int loaded = __sync_add_and_fetch(&loadLoaded, 1);
+
+    if ((subCacheLoaders > 1) && (loadP->databasesP->size() >= 10) && (loaded % (loadP->databasesP->size() / 10) == 0))
     {
-      cSubP = cSubP->next;
-      continue;
+      LM_I(("Subscription cache load: %d/%d databases", loaded, loadP->databasesP->size()));
     }
+  }
 
-    CachedSubSaved* cssP       = new CachedSubSaved();
+  return NULL;
+}
 
-    cssP->lastNotificationTime = cSubP->lastNotificationTime;
-    cssP->count                = cSubP->count;
-    cssP->lastFailure          = cSubP->lastFailure;
-    cssP->lastSuccess          = cSubP->lastSuccess;
 
-    savedSubV[cSubP->subscriptionId] = cssP;
-    cSubP = cSubP->next;
+
+/* ****************************************************************************
+*
+* subCacheLoad -
+*
+* The databases are loaded in partitions (in parallel, if several loaders have been
+* configured in subCacheInit()), one per database, in the order of the databases. The
+* cache semaphore is not needed, as the partitions are not part of the cache.
+*/
+static void subCacheLoad(std::vector<SubCachePartition>* partitionsP)
+{
+  std::vector<std::string> databases;
+
+  // Get list of database
+  if (mongoMultitenant())
+  {
+    getOrionDatabases(&databases);
   }
 
-  LM_T(LmtCacheSync, ("Pushed back %d items to savedSubV", savedSubV.size()));
+  // Add the 'default tenant'
+  databases.push_back(getDbPrefix());
 
 
-  //
-  // 2. Refresh cache (count set to 0)
-  //
-  subCacheRefresh();
+  // Now load the subscriptions of each and every tenant
+  std::vector<pthread_t>  tids;
+  SubCacheLoad            load;
+  struct timespec         start;
+  unsigned int            loaders = (subCacheLoaders < databases.size())? subCacheLoaders : databases.size();
 
+  partitionsP->resize(databases.size());
 
-  //
-  // 3. Compare lastNotificationTime/lastFailure/lastSuccess in savedSubV with the new cache-contents
-  //
-  cSubP = subCache.head;
-  while (cSubP != NULL)
-  {
-    CachedSubSaved* cssP = savedSubV[cSubP->subscriptionId];
+  load.databasesP  = &databases;
+  load.partitionsP = partitionsP;
+  load.next        = 0;
+
+  pthread_mutex_lock(&loadStatsMutex);
+  loadDatabases = databases.size();
+  loadLoaded    = 0;
+  pthread_mutex_unlock(&loadStatsMutex);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // The calling thread is one of the loaders
+  for (unsigned int ix = 1; ix < loaders; ++ix)
+  {
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, subCacheLoader, &load) != 0)
+    {
+      LM_E(("Runtime Error (error creating subscription cache loader thread: %s)", strerror(errno)));
+      break;
+    }
+
+    tids.push_back(tid);
+  }
+
+  subCacheLoader(&load);
+
+  for (unsigned int ix = 0; ix < tids.size(); ++ix)
+  {
+    pthread_join(tids[ix], NULL);
+  }
+
+  pthread_mutex_lock(&loadStatsMutex);
+
+  loadDuration = msSince(start);
+  loadTimes.clear();
+
+  for (unsigned int ix = 0; ix < databases.size(); ++ix)
+  {
+    loadTimes.push_back(std::make_pair(databases[ix], (*partitionsP)[ix].loadTime));
+  }
+
+  pthread_mutex_unlock(&loadStatsMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheRefresh -
+*
+* The cache contents are replaced by the partitions loaded by subCacheLoad() once all of
+* them are complete. The order of the subscriptions in the cache is the same whatever the
+* number of loaders is.
+*
+* WARNING
+*  The cache semaphore must be taken before this function is called:
+*    cacheSemTake(__FUNCTION__, "Reason");
+*  And released after subCacheRefresh finishes, of course.
+*/
+void subCacheRefresh(void)
+{
+  std::vector<SubCachePartition> partitions;
+
+  LM_T(LmtSubCache, ("Refreshing subscription cache"));
+
+  subCacheLoad(&partitions);
+
+  // Replace the cache contents with the partitions
+  subCacheDestroy();
+
+  for (unsigned int ix = 0; ix < partitions.size(); ++ix)
+  {
+    subCacheAppend(&partitions[ix]);
+  }
+
+  ++subCache.noOfRefreshes;
+  LM_T(LmtSubCache, ("Refreshed subscription cache [%d] in %lld ms", subCache.noOfRefreshes, loadDuration));
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheLoadStatisticsGet -
+*/
+void subCacheLoadStatisticsGet(SubCacheLoadStatistics* statsP)
+{
+  pthread_mutex_lock(&loadStatsMutex);
+
+  statsP->loaders   = subCacheLoaders;
+  statsP->databases = loadDatabases;
+  statsP->loaded    = __sync_fetch_and_add(&loadLoaded, 0);
+  statsP->duration  = loadDuration;
+  statsP->loadTimes = loadTimes;
+
+  pthread_mutex_unlock(&loadStatsMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* CachedSubSaved -
+*/
+typedef struct CachedSubSaved
+{
+  int64_t                     lastNotificationTime;
+  int64_t                     count;
+  int64_t                     lastFailure;
+  int64_t                     lastSuccess;
+  std::vector<ngsiv2::EntID>  deferredEntities;
+  std::string                 deferredXauthToken;
+} CachedSubSaved;
+
+
+
+/* ****************************************************************************
+*
+* CachedSubFlush - counters of a subscription to be written to DB
+*/
+typedef struct CachedSubFlush
+{
+  std::string      tenant;
+  std::string      subscriptionId;
+  CachedSubSaved*  cssP;
+} CachedSubFlush;
+
+
+
+/* ****************************************************************************
+*
+* subCachePartitionPrune - destroy the subscriptions of a partition whose id is in ids
+*/
+static void subCachePartitionPrune(SubCachePartition* partP, const std::set<std::string>& ids)
+{
+  CachedSubscription* cSubP = partP->head;
+
+  partP->head  = NULL;
+  partP->tail  = NULL;
+  partP->items = 0;
+
+  while (cSubP != NULL)
+  {
+    CachedSubscription* next = cSubP->next;
+
+    if (ids.count(cSubP->subscriptionId) != 0)
+    {
+      subCacheItemDestroy(cSubP);
+      delete cSubP;
+    }
+    else
+    {
+      cSubP->next = NULL;
+      cSubP->prev = partP->tail;
+
+      if (partP->tail == NULL)
+      {
+        partP->head = cSubP;
+      }
+      else
+      {
+        partP->tail->next = cSubP;
+      }
+
+      partP->tail = cSubP;
+      ++partP->items;
+    }
+
+    cSubP = next;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheSync -
+*
+* 1. Load the subscriptions of all the databases (subCacheLoad()), without the cache semaphore.
+*    The subscriptions inserted or removed in the cache in the meanwhile are recorded (syncChanged),
+*    as the version loaded from DB may be older than the one in the cache.
+* 2. With the cache semaphore taken:
+*    2.1 Save lastNotificationTime, count, lastFailure, lastSuccess and deferred entities for all items
+*        in cache (savedSubV), except the ones changed during the load, that are kept as they are
+*    2.2 Replace the cache contents with the loaded subscriptions (count set to 0), but the ones changed
+*        during the load, and put back the kept ones
+*    2.3 Compare lastNotificationTime/lastFailure/lastSuccess in savedSubV with the new cache-contents and:
+*        - Update cache-items where 'saved lastNotificationTime' > 'cached lastNotificationTime'
+*        - Remember this more correct lastNotificationTime (must be flushed to mongo) -
+*          by clearing out (set to 0) those lastNotificationTimes that are newer in cache
+*        Same same with lastFailure and lastSuccess.
+*        The deferred entities are restored (with their throttling timer).
+* 3. Without the cache semaphore, update 'count' and 'lastNotificationTime/lastFailure/lastSuccess'
+*    in DB for each item in savedSubV where non-zero
+* 4. Free the vector created in step 2.1 - savedSubV
+*
+* So the cache semaphore is not held while reading or writing the DB, only while the loaded
+* subscriptions are merged with the cache contents.
+*
+* NOTE
+*   This function runs in a separate thread and it allocates temporal objects (in savedSubV).
+*   If the broker dies when this function is executing, all these temporal objects will be reported
+*   as memory leaks.
+*   We see this in our valgrind tests, where we force the broker to die.
+*   This is of course not a real leak, we only see this as a leak as the function hasn't finished to
+*   execute until the point where the temporal objects are deleted (See '4. Free the vector savedSubV').
+*   To fix this little problem, we have created a variable 'subCacheState' that is set to ScsSynchronizing while
+*   the sub-cache synchronization is working.
+*   In serviceRoutines/exitTreat.cpp this variable is checked and if iot is set to ScsSynchronizing, then a
+*   sleep for a few seconds is performed before the broker exits (this is only for DEBUG compilations).
+*/
+void subCacheSync(void)
+{
+  std::map<std::string, CachedSubSaved*>  savedSubV;
+  std::vector<SubCachePartition>          partitions;
+  std::vector<CachedSubscription*>        keptV;
+  std::vector<CachedSubFlush>             flushV;
+
+  subCacheState = ScsSynchronizing;
+
+
+  //
+  // 1. Load the subscriptions from DB
+  //
+  cacheSemTake(__FUNCTION__, "Start of subscription cache synchronization");
+  syncLoading = true;
+  syncChanged.clear();
+  cacheSemGive(__FUNCTION__, "Start of subscription cache synchronization");
+
+  subCacheLoad(&partitions);
+
+  cacheSemTake(__FUNCTION__, "Synchronizing subscription cache");
+  syncLoading = false;
+
+
+  //
+  // 2.1 Save subscriptionId, lastNotificationTime, count, lastFailure, and lastSuccess for all items in cache
+  //     (the ones changed during the load are taken out of the cache, to be kept)
+  //
+  CachedSubscription* cSubP = subCacheHead();
+
+  while (cSubP != NULL)
+  {
+    CachedSubscription* next = subCacheItemNext(cSubP);
+
+    if (syncChanged.count(cSubP->subscriptionId) != 0)
+    {
+      subCacheItemUnlink(cSubP);
+      keptV.push_back(cSubP);
+
+      cSubP = next;
+      continue;
+    }
+
+    //
+    // FIXME P7: For some reason, sometimes the same subscription is found twice in the cache (Issue 2216)
+    //           Once the issue 2216 is fixed, this if-block must be removed.
+    //
+    if (savedSubV[cSubP->subscriptionId] != NULL)
+    {
+      cSubP = next;
+      continue;
+    }
+
+    CachedSubSaved* cssP       = new CachedSubSaved();
+
+    cssP->lastNotificationTime = cSubP->lastNotificationTime;
+    cssP->count                = cSubP->count;
+    cssP->lastFailure          = cSubP->lastFailure;
+    cssP->lastSuccess          = cSubP->lastSuccess;
+    cssP->deferredEntities     = cSubP->deferredEntities;
+    cssP->deferredXauthToken   = cSubP->deferredXauthToken;
+
+    savedSubV[cSubP->subscriptionId] = cssP;
+    cSubP = next;
+  }
+
+  LM_T(LmtCacheSync, ("Pushed back %d items to savedSubV, %d items kept", savedSubV.size(), keptV.size()));
+
+
+  //
+  // 2.2 Replace the cache contents (count set to 0)
+  //
+  subCacheDestroy();
+
+  for (unsigned int ix = 0; ix < partitions.size(); ++ix)
+  {
+    if (!syncChanged.empty())
+    {
+      subCachePartitionPrune(&partitions[ix], syncChanged);
+    }
+
+    subCacheAppend(&partitions[ix]);
+  }
+
+  int64_t now = getCurrentTime();
+
+  for (unsigned int ix = 0; ix < keptV.size(); ++ix)
+  {
+    cSubP = keptV[ix];
+
+    subCacheItemArm(cSubP, now);
+
+    if ((!cSubP->expired) && (!cSubP->deferredEntities.empty()))
+    {
+      subCacheTimers.schedule(&cSubP->throttlingTimer, cSubP->lastNotificationTime + cSubP->throttling);
+    }
+  }
+
+  syncChanged.clear();
+  ++subCache.noOfRefreshes;
+
+
+  //
+  // 2.3 Compare lastNotificationTime/lastFailure/lastSuccess in savedSubV with the new cache-contents
+  //
+  cSubP = subCacheHead();
+  while (cSubP != NULL)
+  {
+    std::map<std::string, CachedSubSaved*>::iterator  it   = savedSubV.find(cSubP->subscriptionId);
+    CachedSubSaved*                                   cssP = (it == savedSubV.end())? NULL : it->second;
 
     if (cssP != NULL)
     {
+      if ((!cssP->deferredEntities.empty()) && (!cSubP->expired))
+      {
+        int64_t last = (cssP->lastNotificationTime > cSubP->lastNotificationTime)? cssP->lastNotificationTime : cSubP->lastNotificationTime;
+
+        cSubP->deferredEntities   = cssP->deferredEntities;
+        cSubP->deferredXauthToken = cssP->deferredXauthToken;
+        subCacheTimers.schedule(&cSubP->throttlingTimer, last + cSubP->throttling);
+      }
+
       if (cssP->lastNotificationTime <= cSubP->lastNotificationTime)
       {
         // cssP->lastNotificationTime is older than what's currently in DB => throw away
         cssP->lastNotificationTime = 0;
       }
+      else
+      {
+        // Throttling goes on from the last notification sent by this node
+        cSubP->lastNotificationTime = cssP->lastNotificationTime;
+      }
 
       if (cssP->lastFailure < cSubP->lastFailure)
       {
@@ -1140,43 +1640,44 @@ void subCacheSync(void)
         // cssP->lastSuccess is older than what's currently in DB => throw away
         cssP->lastSuccess = 0;
       }
+
+      // Keeping lastFailure and lastSuccess in sub cache
+      cSubP->lastFailure = cssP->lastFailure;
+      cSubP->lastSuccess = cssP->lastSuccess;
+
+      CachedSubFlush flush;
+
+      flush.tenant         = (cSubP->tenant == NULL)? "" : cSubP->tenant;
+      flush.subscriptionId = cSubP->subscriptionId;
+      flush.cssP           = cssP;
+
+      flushV.push_back(flush);
     }
 
-    cSubP = cSubP->next;
+    cSubP = subCacheItemNext(cSubP);
   }
 
+  cacheSemGive(__FUNCTION__, "Synchronizing subscription cache");
+
 
   //
-  // 4. Update 'count' for each item in savedSubV where non-zero
-  // 5. Update 'lastNotificationTime/lastFailure/lastSuccess' for each item in savedSubV where non-zero
+  // 3. Update 'count' and 'lastNotificationTime/lastFailure/lastSuccess' in DB for each item in savedSubV where non-zero
   //
-  cSubP = subCache.head;
-  while (cSubP != NULL)
+  for (unsigned int ix = 0; ix < flushV.size(); ++ix)
   {
-    CachedSubSaved* cssP = savedSubV[cSubP->subscriptionId];
-
-    if (cssP != NULL)
-    {
-      std::string tenant = (cSubP->tenant == NULL)? "" : cSubP->tenant;
-
-      mongoSubCountersUpdate(tenant,
-                             cSubP->subscriptionId,
-                             cssP->count,
-                             cssP->lastNotificationTime,
-                             cssP->lastFailure,
-                             cssP->lastSuccess);
-
-      // Keeping lastFailure and lastSuccess in sub cache
-      cSubP->lastFailure = cssP->lastFailure;
-      cSubP->lastSuccess = cssP->lastSuccess;
-    }
-
-    cSubP = cSubP->next;
+    CachedSubSaved* cssP = flushV[ix].cssP;
+
+    mongoSubCountersUpdate(flushV[ix].tenant,
+                           flushV[ix].subscriptionId,
+                           cssP->count,
+                           cssP->lastNotificationTime,
+                           cssP->lastFailure,
+                           cssP->lastSuccess);
   }
 
 
   //
-  // 6. Free the vector savedSubV
+  // 4. Free the vector savedSubV
   //
   for (std::map<std::string, CachedSubSaved*>::iterator it = savedSubV.begin(); it != savedSubV.end(); ++it)
   {
@@ -1184,9 +1685,7 @@ void subCacheSync(void)
   }
   savedSubV.clear();
 
-
   subCacheState = ScsIdle;
-  cacheSemGive(__FUNCTION__, "Synchronizing subscription cache");
 }
 
 
@@ -1198,11 +1697,40 @@ void subCacheSync(void)
 static void* subCacheRefresherThread(void* vP)
 {
   extern int subCacheInterval;
+  bool       reconcile = (vP != NULL);
+  int        elapsed   = 0;
 
-  while (1)
+  //
+  // The cache has been loaded from the snapshot, so it has to be synchronized with the DB
+  // as soon as possible
+  //
+  if (reconcile)
   {
-    sleep(subCacheInterval);
     subCacheSync();
+    subCacheSnapshotWrite();
+  }
+
+  while (1)
+  {
+    int ival = subCacheSnapshotInterval();
+    int step = ((ival > 0) && (ival < subCacheInterval - elapsed))? ival : subCacheInterval - elapsed;
+
+    sleep(step);
+    elapsed += step;
+
+    if (elapsed >= subCacheInterval)
+    {
+      subCacheSync();
+
+      // Registrations and availability subscriptions could have been modified by other CB nodes
+      regCacheRefresh();
+      casubCacheRefresh();
+
+      elapsed = 0;
+    }
+
+    // Written by this very thread, so the snapshot counters never overlap the ones already synchronized
+    subCacheSnapshotWrite();
   }
 
   return NULL;
@@ -1210,6 +1738,289 @@ static void* subCacheRefresherThread(void* vP)
 
 
 
+/* ****************************************************************************
+*
+* subCacheItemDefer -
+*
+* Each entity is notified once at the end of the window, whatever the number of updates
+* discarded. Subscriptions with geo filters are not deferred, as the filter cannot be
+* checked against the state of the entity at the end of the window.
+*
+* The notification is sent with the x-auth-token of the last update discarded, as the one
+* of a regular notification is the token of the update triggering it.
+*/
+void subCacheItemDefer
+(
+  CachedSubscription*  cSubP,
+  const std::string&   entityId,
+  const std::string&   entityType,
+  const std::string&   xauthToken
+)
+{
+  if ((!throttlingDeferred) || (cSubP->expired) || (!cSubP->expression.georel.empty()))
+  {
+    return;
+  }
+
+  cSubP->deferredXauthToken = xauthToken;
+
+  for (unsigned int ix = 0; ix < cSubP->deferredEntities.size(); ++ix)
+  {
+    if ((cSubP->deferredEntities[ix].id == entityId) && (cSubP->deferredEntities[ix].type == entityType))
+    {
+      return;
+    }
+  }
+
+  if (cSubP->deferredEntities.size() >= SUB_CACHE_DEFERRED_ENTITIES_MAX)
+  {
+    LM_T(LmtSubCache, ("too many deferred entities for sub '%s', '%s' discarded", cSubP->subscriptionId, entityId.c_str()));
+    return;
+  }
+
+  cSubP->deferredEntities.push_back(ngsiv2::EntID(entityId, "", entityType, ""));
+
+  if (!subCacheTimers.scheduled(&cSubP->throttlingTimer))
+  {
+    subCacheTimers.schedule(&cSubP->throttlingTimer, cSubP->lastNotificationTime + cSubP->throttling);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* DeferredNotification - copy of the subscription data needed to send a deferred notification
+*/
+typedef struct DeferredNotification
+{
+  std::string                 tenant;
+  std::string                 subscriptionId;
+  std::string                 servicePath;
+  std::vector<ngsiv2::EntID>  entities;
+  std::string                 xauthToken;
+  std::vector<std::string>    attributes;
+  std::vector<std::string>    metadata;
+  ngsiv2::HttpInfo            httpInfo;
+  RenderFormat                renderFormat;
+  bool                        blacklist;
+  StringFilter*               stringFilterP;
+  StringFilter*               mdStringFilterP;
+} DeferredNotification;
+
+
+
+/* ****************************************************************************
+*
+* deferredNotificationNew -
+*/
+static DeferredNotification* deferredNotificationNew(CachedSubscription* cSubP)
+{
+  DeferredNotification*  dnP = new DeferredNotification();
+  std::string            errorString;
+
+  dnP->tenant          = (cSubP->tenant == NULL)? "" : cSubP->tenant;
+  dnP->subscriptionId  = cSubP->subscriptionId;
+  dnP->servicePath     = cSubP->servicePath;
+  dnP->entities        = cSubP->deferredEntities;
+  dnP->xauthToken      = cSubP->deferredXauthToken;
+  dnP->attributes      = cSubP->attributes;
+  dnP->metadata        = cSubP->metadata;
+  dnP->httpInfo        = cSubP->httpInfo;
+  dnP->renderFormat    = cSubP->renderFormat;
+  dnP->blacklist       = cSubP->blacklist;
+  dnP->stringFilterP   = NULL;
+  dnP->mdStringFilterP = NULL;
+
+  if (cSubP->expression.stringFilter.filters.size() > 0)
+  {
+    dnP->stringFilterP = cSubP->expression.stringFilter.clone(&errorString);
+  }
+
+  if (cSubP->expression.mdStringFilter.filters.size() > 0)
+  {
+    dnP->mdStringFilterP = cSubP->expression.mdStringFilter.clone(&errorString);
+  }
+
+  if (!errorString.empty())
+  {
+    LM_E(("Runtime Error (error copying filters of subscription '%s': %s)", cSubP->subscriptionId, errorString.c_str()));
+
+    delete dnP->stringFilterP;
+    delete dnP->mdStringFilterP;
+    delete dnP;
+
+    return NULL;
+  }
+
+  return dnP;
+}
+
+
+
+/* ****************************************************************************
+*
+* deferredNotificationSend -
+*/
+static void deferredNotificationSend(DeferredNotification* dnP)
+{
+  bool sent = processDeferredNotification(dnP->entities,
+                                          dnP->attributes,
+                                          dnP->metadata,
+                                          dnP->subscriptionId,
+                                          dnP->httpInfo,
+                                          dnP->renderFormat,
+                                          dnP->tenant,
+                                          dnP->xauthToken,
+                                          dnP->servicePath,
+                                          dnP->stringFilterP,
+                                          dnP->mdStringFilterP,
+                                          dnP->blacklist);
+
+  if (sent)
+  {
+    cacheSemTake(__FUNCTION__, "update lastNotificationTime for deferred notification");
+
+    CachedSubscription* cSubP = subCacheItemLookup(dnP->tenant.c_str(), dnP->subscriptionId.c_str());
+
+    if (cSubP != NULL)
+    {
+      cSubP->lastNotificationTime  = getCurrentTime();
+      cSubP->count                += 1;
+    }
+
+    cacheSemGive(__FUNCTION__, "update lastNotificationTime for deferred notification");
+  }
+
+  delete dnP->stringFilterP;
+  delete dnP->mdStringFilterP;
+  delete dnP;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheTimersRun - process the timers due
+*
+* Expired subscriptions are moved to the expired list. For the throttling timers, the
+* deferred notifications are taken from their subscriptions and sent once the cache
+* semaphore is released.
+*/
+static void subCacheTimersRun(void)
+{
+  std::vector<TimerWheelNode*>        due;
+  std::vector<DeferredNotification*>  deferred;
+
+  cacheSemTake(__FUNCTION__, "subscription cache timers");
+
+  int64_t now = getCurrentTime();
+
+  subCacheTimers.advance(now, &due);
+
+  for (unsigned int ix = 0; ix < due.size(); ++ix)
+  {
+    CachedSubscription* cSubP = (CachedSubscription*) due[ix]->ownerP;
+
+    if (due[ix] == &cSubP->expiryTimer)
+    {
+      if (!cSubP->expired)
+      {
+        LM_T(LmtSubCache, ("sub '%s' expired, no longer matched", cSubP->subscriptionId));
+        subCacheItemUnlink(cSubP);
+        subCacheItemExpire(cSubP);
+      }
+
+      continue;
+    }
+
+    if ((cSubP->expired) || (cSubP->deferredEntities.empty()))
+    {
+      continue;
+    }
+
+    // Notified in the meanwhile (e.g. by a later update): the window starts again
+    if (now - cSubP->lastNotificationTime < cSubP->throttling)
+    {
+      subCacheTimers.schedule(&cSubP->throttlingTimer, cSubP->lastNotificationTime + cSubP->throttling);
+      continue;
+    }
+
+    DeferredNotification* dnP = deferredNotificationNew(cSubP);
+
+    cSubP->deferredEntities.clear();
+    cSubP->deferredXauthToken.clear();
+
+    // The window of the next throttled updates starts now, even before the notification is sent
+    cSubP->lastNotificationTime = now;
+
+    if (dnP != NULL)
+    {
+      deferred.push_back(dnP);
+    }
+  }
+
+  cacheSemGive(__FUNCTION__, "subscription cache timers");
+
+  for (unsigned int ix = 0; ix < deferred.size(); ++ix)
+  {
+    deferredNotificationSend(deferred[ix]);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheTimersRunForUnitTest -
+*/
+#ifdef UNIT_TEST
+void subCacheTimersRunForUnitTest(void)
+{
+  subCacheTimersRun();
+}
+#endif
+
+
+
+/* ****************************************************************************
+*
+* subCacheTimerThread -
+*/
+static void* subCacheTimerThread(void* vP)
+{
+  while (1)
+  {
+    sleep(1);
+    subCacheTimersRun();
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheTimersStart -
+*/
+void subCacheTimersStart(void)
+{
+  pthread_t  tid;
+  int        ret;
+
+  ret = pthread_create(&tid, NULL, subCacheTimerThread, NULL);
+
+  if (ret != 0)
+  {
+    LM_E(("Runtime Error (error creating thread: %d)", ret));
+    return;
+  }
+  pthread_detach(tid);
+}
+
+
+
 /* ****************************************************************************
 *
 * subCacheStart -
@@ -1218,11 +2029,29 @@ void subCacheStart(void)
 {
   pthread_t  tid;
   int        ret;
+  bool       stale     = false;
+  void*      reconcile = NULL;
+
+  subCacheTimersStart();
 
-  // Populate subscription cache from database
-  subCacheRefresh();
+  //
+  // Populate subscription cache from the snapshot (if any) or from database.
+  // A stale snapshot is synchronized with the database before going on (only its counters are kept)
+  //
+  if (subCacheSnapshotLoad(&stale) == false)
+  {
+    subCacheRefresh();
+  }
+  else if (stale)
+  {
+    subCacheSync();
+  }
+  else
+  {
+    reconcile = (void*) 1;
+  }
 
-  ret = pthread_create(&tid, NULL, subCacheRefresherThread, NULL);
+  ret = pthread_create(&tid, NULL, subCacheRefresherThread, reconcile);
 
   if (ret != 0)
   {
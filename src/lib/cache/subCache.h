@@ -25,13 +25,15 @@
 *
 * Author: Ken Zangelin
 */
-#include <regex.h>
 #include <string>
 #include <vector>
+#include <utility>
 
 #include "mongo/client/dbclient.h"
 
 #include "common/RenderFormat.h"
+#include "common/regexCache.h"
+#include "common/TimerWheel.h"
 #include "ngsi/NotifyConditionVector.h"
 #include "ngsi/EntityIdVector.h"
 #include "ngsi/StringList.h"
@@ -67,16 +69,14 @@ struct EntityInfo
 {
   std::string   entityId;
   bool          isPattern;
-  regex_t       entityIdPattern;
-  bool          entityIdPatternToBeFreed;
+  CachedRegex*  entityIdPattern;
 
   std::string   entityType;
   bool          isTypePattern;
-  regex_t       entityTypePattern;
-  bool          entityTypePatternToBeFreed;
+  CachedRegex*  entityTypePattern;
 
 
-  EntityInfo() {}
+  EntityInfo(): isPattern(false), entityIdPattern(NULL), isTypePattern(false), entityTypePattern(NULL) {}
   EntityInfo(const std::string& _entityId, const std::string& _entityType, const std::string& _isPattern,
              bool _isTypePattern);
   ~EntityInfo() { release(); }
@@ -87,9 +87,22 @@ struct EntityInfo
 
 
 
+/* ****************************************************************************
+*
+* SUB_CACHE_DEFERRED_ENTITIES_MAX - entities of a deferred notification (see subCacheItemDefer())
+*/
+#define SUB_CACHE_DEFERRED_ENTITIES_MAX  100
+
+
+
 /* ****************************************************************************
 *
 * CachedSubscription - 
+*
+* The subscriptions of the cache are in one of two lists: the active one (used to match
+* updates) and the expired one. A subscription is moved to the expired list by its expiry
+* timer, and back to the active one when it is inserted again (e.g. after a PATCH extending
+* its expiration).
 */
 struct CachedSubscription
 {
@@ -112,10 +125,51 @@ struct CachedSubscription
   int64_t                     lastFailure;  // timestamp of last notification failure
   int64_t                     lastSuccess;  // timestamp of last successful notification
   struct CachedSubscription*  next;
+  struct CachedSubscription*  prev;
+  bool                        expired;      // in the expired list
+  TimerWheelNode              expiryTimer;
+  TimerWheelNode              throttlingTimer;
+  std::vector<ngsiv2::EntID>  deferredEntities;  // notifications discarded by throttling, to be sent at the end of the window
+  std::string                 deferredXauthToken;  // x-auth-token of the last update discarded
+};
+
+
+
+/* ****************************************************************************
+*
+* SubCachePartition - subscriptions of a database, loaded by subCacheRefresh()
+*/
+struct SubCachePartition
+{
+  CachedSubscription*  head;
+  CachedSubscription*  tail;
+  int                  items;
+  long long            loadTime;  // milliseconds
+
+  SubCachePartition(): head(NULL), tail(NULL), items(0), loadTime(0) {}
 };
 
 
 
+/* ****************************************************************************
+*
+* SubCacheLoadStatistics -
+*
+* databases and loaded are the ones of the refresh in progress (or the last one if
+* there is no refresh in progress), while duration and the load time of each database
+* are the ones of the last completed refresh.
+*/
+typedef struct SubCacheLoadStatistics
+{
+  unsigned int                                      loaders;
+  unsigned int                                      databases;
+  unsigned int                                      loaded;
+  long long                                         duration;  // milliseconds
+  std::vector<std::pair<std::string, long long> >   loadTimes;
+} SubCacheLoadStatistics;
+
+
+
 /* ****************************************************************************
 *
 * subCacheActive - 
@@ -128,8 +182,24 @@ extern volatile SubCacheState  subCacheState;
 /* ****************************************************************************
 *
 * subCacheInit - 
+*
+* loaders is the number of threads loading the tenant databases (each one with its own
+* DB connection) in subCacheRefresh(). With throttlingDeferred, the notifications discarded
+* by throttling are sent at the end of the throttling window (see subCacheItemDefer()).
+*/
+extern void subCacheInit(bool multitenant = false, unsigned int loaders = 1, bool throttlingDeferred = false);
+
+
+
+/* ****************************************************************************
+*
+* subCacheTimersStart -
+*
+* Starts the thread of the expiry and throttling timers (see subCacheItemDefer()).
+* subCacheStart() calls it, so it is only needed when the cache is not refreshed
+* periodically (i.e. populated just by subCacheRefresh()).
 */
-extern void subCacheInit(bool multitenant = false);
+extern void subCacheTimersStart(void);
 
 
 
@@ -156,6 +226,7 @@ extern void subCacheDestroy(void);
 */
 #ifdef UNIT_TEST
 void subCacheDisable(void);
+void subCacheTimersRunForUnitTest(void);
 #endif
 
 
@@ -281,6 +352,65 @@ extern void subCacheMatch
 
 
 
+/* ****************************************************************************
+*
+* subCachePartitionInsert -
+*/
+extern void subCachePartitionInsert(SubCachePartition* partP, CachedSubscription* cSubP);
+
+
+
+/* ****************************************************************************
+*
+* subCacheReplace - replace the cache contents with the subscriptions of a partition
+*/
+extern void subCacheReplace(SubCachePartition* partP);
+
+
+
+/* ****************************************************************************
+*
+* subCacheHead - first subscription of the cache (the cache semaphore must be taken)
+*/
+extern CachedSubscription* subCacheHead(void);
+
+
+
+/* ****************************************************************************
+*
+* subCacheItemNext - next subscription of the cache, expired ones included (the cache
+* semaphore must be taken)
+*/
+extern CachedSubscription* subCacheItemNext(CachedSubscription* cSubP);
+
+
+
+/* ****************************************************************************
+*
+* subCacheItemDefer - an update of the entity was not notified due to throttling
+*
+* If deferred notifications are enabled, the entity is notified (with its state at that
+* moment) at the end of the throttling window, with the x-auth-token of the last update
+* discarded. The cache semaphore must be taken.
+*/
+extern void subCacheItemDefer
+(
+  CachedSubscription*  cSubP,
+  const std::string&   entityId,
+  const std::string&   entityType,
+  const std::string&   xauthToken
+);
+
+
+
+/* ****************************************************************************
+*
+* subCacheLoadStatisticsGet -
+*/
+extern void subCacheLoadStatisticsGet(SubCacheLoadStatistics* statsP);
+
+
+
 /* ****************************************************************************
 *
 * subCacheStatisticsGet - 
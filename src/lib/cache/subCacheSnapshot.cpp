@@ -0,0 +1,463 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "mongo/client/dbclient.h"
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/sem.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/safeMongo.h"
+#include "mongoBackend/mongoSubCache.h"
+#include "cache/subCache.h"
+#include "cache/subCacheSnapshot.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::BSONObj;
+
+
+
+/* ****************************************************************************
+*
+* SUB_CACHE_SNAPSHOT_MAGIC and SUB_CACHE_SNAPSHOT_VERSION -
+*
+* The version must be increased whenever the format of the file (header or records)
+* changes, so that snapshots of older versions are not used.
+*/
+#define SUB_CACHE_SNAPSHOT_MAGIC    "ORIONSCS"
+#define SUB_CACHE_SNAPSHOT_VERSION  1
+
+
+
+/* ****************************************************************************
+*
+* SubCacheSnapshotHeader -
+*
+* The header is followed by the payload: a BSON object with the configuration the snapshot
+* was taken with (database name and multitenancy) and a BSON object per subscription:
+*
+*   { tenant: "...", count: <counter not yet synchronized>, sub: <csubs document> }
+*
+* The snapshot is a local file, so the header is written in the byte order of the host.
+*/
+typedef struct SubCacheSnapshotHeader
+{
+  char      magic[8];
+  uint32_t  version;
+  uint32_t  items;
+  int64_t   writeTime;
+  uint64_t  length;     // of the payload
+  uint32_t  checksum;   // CRC32 of the payload
+  uint32_t  reserved;
+} SubCacheSnapshotHeader;
+
+
+
+/* ****************************************************************************
+*
+* Snapshot configuration -
+*/
+static std::string  snapshotPath;
+static int          snapshotInterval = 0;
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotInit -
+*/
+void subCacheSnapshotInit(const char* path, int interval)
+{
+  snapshotPath     = (path == NULL)? "" : path;
+  snapshotInterval = interval;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotInterval -
+*/
+int subCacheSnapshotInterval(void)
+{
+  return snapshotPath.empty()? 0 : snapshotInterval;
+}
+
+
+
+/* ****************************************************************************
+*
+* configurationGet - the configuration the cache contents depend on
+*/
+static BSONObj configurationGet(void)
+{
+  return BSON("dbName" << getDbPrefix() << "multitenant" << mongoMultitenant());
+}
+
+
+
+/* ****************************************************************************
+*
+* isObjectId - the ids of the subscriptions are ObjectIds in DB
+*/
+static bool isObjectId(const char* s)
+{
+  int ix;
+
+  for (ix = 0; s[ix] != 0; ++ix)
+  {
+    if (!isxdigit(s[ix]))
+    {
+      return false;
+    }
+  }
+
+  return (ix == 24);
+}
+
+
+
+/* ****************************************************************************
+*
+* writeAll -
+*/
+static bool writeAll(int fd, const char* buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t nb = write(fd, buf, len);
+
+    if (nb == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      return false;
+    }
+
+    buf += nb;
+    len -= nb;
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotWrite -
+*
+* The snapshot is written to a temporary file that replaces the previous snapshot once
+* complete, so a crash while writing never leaves a truncated snapshot.
+*/
+void subCacheSnapshotWrite(void)
+{
+  if (snapshotPath.empty())
+  {
+    return;
+  }
+
+  std::string             payload;
+  SubCacheSnapshotHeader  header;
+  BSONObj                 configuration = configurationGet();
+
+  memset(&header, 0, sizeof(header));
+  payload.append(configuration.objdata(), configuration.objsize());
+
+  cacheSemTake(__FUNCTION__, "Writing subscription cache snapshot");
+
+  for (CachedSubscription* cSubP = subCacheHead(); cSubP != NULL; cSubP = subCacheItemNext(cSubP))
+  {
+    if ((cSubP->subscriptionId == NULL) || (!isObjectId(cSubP->subscriptionId)))
+    {
+      continue;
+    }
+
+    BSONObj record = BSON("tenant" << ((cSubP->tenant == NULL)? "" : cSubP->tenant) <<
+                          "count"  << (long long) cSubP->count                      <<
+                          "sub"    << mongoSubCacheItemToBson(cSubP));
+
+    payload.append(record.objdata(), record.objsize());
+    ++header.items;
+  }
+
+  cacheSemGive(__FUNCTION__, "Writing subscription cache snapshot");
+
+  memcpy(header.magic, SUB_CACHE_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version   = SUB_CACHE_SNAPSHOT_VERSION;
+  header.writeTime = time(NULL);
+  header.length    = payload.size();
+  header.checksum  = crc32(crc32(0L, Z_NULL, 0), (const Bytef*) payload.data(), payload.size());
+
+  std::string  tmpPath = snapshotPath + ".tmp";
+  int          fd      = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+  if (fd == -1)
+  {
+    LM_E(("Runtime Error (cannot open subscription cache snapshot '%s': %s)", tmpPath.c_str(), strerror(errno)));
+    return;
+  }
+
+  bool ok = writeAll(fd, (const char*) &header, sizeof(header)) && writeAll(fd, payload.data(), payload.size()) && (fsync(fd) == 0);
+
+  if (!ok)
+  {
+    LM_E(("Runtime Error (cannot write subscription cache snapshot '%s': %s)", tmpPath.c_str(), strerror(errno)));
+  }
+
+  close(fd);
+
+  if (ok && (rename(tmpPath.c_str(), snapshotPath.c_str()) != 0))
+  {
+    LM_E(("Runtime Error (cannot rename subscription cache snapshot '%s': %s)", tmpPath.c_str(), strerror(errno)));
+    ok = false;
+  }
+
+  if (!ok)
+  {
+    unlink(tmpPath.c_str());
+    return;
+  }
+
+  LM_T(LmtSubCache, ("Written subscription cache snapshot with %d subscriptions (%d bytes)", header.items, payload.size()));
+}
+
+
+
+/* ****************************************************************************
+*
+* partitionRelease -
+*/
+static void partitionRelease(SubCachePartition* partP)
+{
+  CachedSubscription* cSubP = partP->head;
+
+  while (cSubP != NULL)
+  {
+    CachedSubscription* next = cSubP->next;
+
+    subCacheItemDestroy(cSubP);
+    delete cSubP;
+
+    cSubP = next;
+  }
+
+  partP->head  = NULL;
+  partP->tail  = NULL;
+  partP->items = 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* bsonNext - the BSON object at the start of buf, checking its length
+*/
+static bool bsonNext(const char* buf, size_t len, BSONObj* objP)
+{
+  int32_t size;
+
+  if (len < sizeof(size))
+  {
+    return false;
+  }
+
+  memcpy(&size, buf, sizeof(size));
+
+  if ((size < 5) || ((size_t) size > len))
+  {
+    return false;
+  }
+
+  *objP = BSONObj(buf);
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* snapshotParse -
+*/
+static bool snapshotParse(const char* buf, size_t len, SubCachePartition* partP, bool* staleP, std::string* errorP)
+{
+  SubCacheSnapshotHeader header;
+
+  if (len < sizeof(header))
+  {
+    *errorP = "truncated header";
+    return false;
+  }
+
+  memcpy(&header, buf, sizeof(header));
+
+  if (memcmp(header.magic, SUB_CACHE_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+  {
+    *errorP = "not a subscription cache snapshot";
+    return false;
+  }
+
+  if (header.version != SUB_CACHE_SNAPSHOT_VERSION)
+  {
+    *errorP = "unsupported version";
+    return false;
+  }
+
+  buf += sizeof(header);
+  len -= sizeof(header);
+
+  if (header.length != len)
+  {
+    *errorP = "truncated payload";
+    return false;
+  }
+
+  if (crc32(crc32(0L, Z_NULL, 0), (const Bytef*) buf, len) != header.checksum)
+  {
+    *errorP = "checksum mismatch";
+    return false;
+  }
+
+  BSONObj configuration;
+
+  if (!bsonNext(buf, len, &configuration) || (configuration.woCompare(configurationGet()) != 0))
+  {
+    *errorP = "taken with a different database configuration";
+    return false;
+  }
+
+  buf += configuration.objsize();
+  len -= configuration.objsize();
+
+  for (unsigned int ix = 0; ix < header.items; ++ix)
+  {
+    BSONObj record;
+
+    if (!bsonNext(buf, len, &record))
+    {
+      *errorP = "corrupt record";
+      return false;
+    }
+
+    buf += record.objsize();
+    len -= record.objsize();
+
+    std::string tenant = getStringFieldF(record, "tenant");
+
+    // Same as in DB load, invalid subscriptions are skipped
+    if (mongoSubCacheItemInsert(tenant.c_str(), getObjectFieldF(record, "sub"), partP) == 0)
+    {
+      partP->tail->count = getIntOrLongFieldAsLongF(record, "count");
+    }
+  }
+
+  *staleP = (time(NULL) - header.writeTime > SUB_CACHE_SNAPSHOT_MAX_AGE);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotLoad -
+*/
+bool subCacheSnapshotLoad(bool* staleP)
+{
+  *staleP = false;
+
+  if (snapshotPath.empty())
+  {
+    return false;
+  }
+
+  int fd = open(snapshotPath.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    LM_I(("Subscription cache snapshot '%s' not loaded: %s", snapshotPath.c_str(), strerror(errno)));
+    return false;
+  }
+
+  struct stat  st;
+  void*        mapP = MAP_FAILED;
+
+  if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+  {
+    mapP = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  close(fd);
+
+  if (mapP == MAP_FAILED)
+  {
+    LM_W(("Subscription cache snapshot '%s' not loaded: cannot map it", snapshotPath.c_str()));
+    return false;
+  }
+
+  SubCachePartition  partition;
+  std::string        error;
+  bool               ok = snapshotParse((const char*) mapP, st.st_size, &partition, staleP, &error);
+
+  munmap(mapP, st.st_size);
+
+  if (!ok)
+  {
+    LM_W(("Subscription cache snapshot '%s' not loaded: %s", snapshotPath.c_str(), error.c_str()));
+    partitionRelease(&partition);
+    return false;
+  }
+
+  int items = partition.items;
+
+  cacheSemTake(__FUNCTION__, "Loading subscription cache snapshot");
+  subCacheReplace(&partition);
+  cacheSemGive(__FUNCTION__, "Loading subscription cache snapshot");
+
+  LM_I(("Subscription cache loaded from snapshot '%s' (%d subscriptions%s)", snapshotPath.c_str(), items, *staleP? ", stale" : ""));
+
+  return true;
+}
@@ -0,0 +1,79 @@
+#ifndef SRC_LIB_CACHE_SUBCACHESNAPSHOT_H_
+#define SRC_LIB_CACHE_SUBCACHESNAPSHOT_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+
+
+
+/* ****************************************************************************
+*
+* SUB_CACHE_SNAPSHOT_MAX_AGE -
+*
+* Snapshots older than this (in seconds) are considered stale: their subscriptions are not
+* used until the cache is synchronized with the database.
+*/
+#define SUB_CACHE_SNAPSHOT_MAX_AGE  3600
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotInit -
+*
+* path is the snapshot file (the snapshot is disabled if empty) and interval the number of
+* seconds between snapshots (0: only after each subscription cache synchronization).
+*/
+extern void subCacheSnapshotInit(const char* path, int interval);
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotInterval -
+*/
+extern int subCacheSnapshotInterval(void);
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotLoad - replace the cache contents with the ones in the snapshot file
+*
+* Returns false if the snapshot is disabled, missing, corrupt or from a different
+* configuration (database name or multitenancy). *staleP is set if the snapshot is
+* older than SUB_CACHE_SNAPSHOT_MAX_AGE.
+*/
+extern bool subCacheSnapshotLoad(bool* staleP);
+
+
+
+/* ****************************************************************************
+*
+* subCacheSnapshotWrite - write the cache contents (and counters) to the snapshot file
+*/
+extern void subCacheSnapshotWrite(void);
+
+#endif  // SRC_LIB_CACHE_SUBCACHESNAPSHOT_H_
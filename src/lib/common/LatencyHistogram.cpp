@@ -0,0 +1,222 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+#include <string>
+
+#include "common/JsonHelper.h"
+#include "common/LatencyHistogram.h"
+
+
+
+/* ****************************************************************************
+*
+* SUB_BUCKETS -
+*/
+#define SUB_BUCKETS       (1ULL << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+#define HALF_SUB_BUCKETS  (SUB_BUCKETS >> 1)
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::LatencyHistogram -
+*/
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::indexFor -
+*
+* For values over SUB_BUCKETS, the bucket is given by the position of the most significant
+* bit and the sub-bucket by the SUB_BUCKET_BITS bits starting at that position.
+*/
+unsigned int LatencyHistogram::indexFor(unsigned long long value)
+{
+  if (value < SUB_BUCKETS)
+  {
+    return (unsigned int) value;
+  }
+
+  unsigned int msb   = 63 - __builtin_clzll(value);
+  unsigned int shift = msb - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1;
+  unsigned int index = shift * HALF_SUB_BUCKETS + (unsigned int) (value >> shift);
+
+  return (index < LATENCY_HISTOGRAM_BUCKETS)? index : LATENCY_HISTOGRAM_BUCKETS - 1;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::highestEquivalentValue -
+*
+* Highest value that is recorded in the bucket with the given index
+*/
+unsigned long long LatencyHistogram::highestEquivalentValue(unsigned int index)
+{
+  if (index < SUB_BUCKETS)
+  {
+    return index;
+  }
+
+  unsigned int        shift    = index / HALF_SUB_BUCKETS - 1;
+  unsigned long long  subIndex = index - shift * HALF_SUB_BUCKETS;
+
+  return ((subIndex + 1) << shift) - 1;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::record -
+*/
+void LatencyHistogram::record(unsigned long long value)
+{
+  __sync_fetch_and_add(&counts[indexFor(value)], 1);
+  __sync_fetch_and_add(&totalCount, 1);
+  __sync_fetch_and_add(&totalSum, value);
+
+  unsigned long long currentMax = maxValue;
+
+  while ((value > currentMax) && !__sync_bool_compare_and_swap(&maxValue, currentMax, value))
+  {
+    currentMax = maxValue;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::reset -
+*/
+void LatencyHistogram::reset(void)
+{
+  memset(counts, 0, sizeof(counts));
+  totalCount = 0;
+  totalSum   = 0;
+  maxValue   = 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::count -
+*/
+unsigned long long LatencyHistogram::count(void) const
+{
+  return totalCount;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::max -
+*/
+unsigned long long LatencyHistogram::max(void) const
+{
+  return maxValue;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::mean -
+*/
+double LatencyHistogram::mean(void) const
+{
+  return (totalCount == 0)? 0 : (double) totalSum / totalCount;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::valueAtPercentile -
+*
+* The value returned is the highest one equivalent to the bucket where the percentile
+* falls (but never higher than the maximum recorded value)
+*/
+unsigned long long LatencyHistogram::valueAtPercentile(double percentile) const
+{
+  unsigned long long  total = totalCount;
+
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  unsigned long long  target = (unsigned long long) ((percentile / 100) * total + 0.5);
+  unsigned long long  acc    = 0;
+
+  if (target == 0)
+  {
+    target = 1;
+  }
+
+  for (unsigned int ix = 0; ix < LATENCY_HISTOGRAM_BUCKETS; ++ix)
+  {
+    acc += counts[ix];
+
+    if (acc >= target)
+    {
+      unsigned long long value = highestEquivalentValue(ix);
+
+      return (value < maxValue)? value : maxValue;
+    }
+  }
+
+  return maxValue;
+}
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram::toJson -
+*/
+std::string LatencyHistogram::toJson(void) const
+{
+  JsonHelper jh;
+
+  jh.addNumber("count", (long long) count());
+  jh.addNumber("mean",  mean());
+  jh.addNumber("p50",   (long long) valueAtPercentile(50));
+  jh.addNumber("p90",   (long long) valueAtPercentile(90));
+  jh.addNumber("p99",   (long long) valueAtPercentile(99));
+  jh.addNumber("p999",  (long long) valueAtPercentile(99.9));
+  jh.addNumber("max",   (long long) max());
+
+  return jh.str();
+}
@@ -0,0 +1,79 @@
+#ifndef SRC_LIB_COMMON_LATENCYHISTOGRAM_H_
+#define SRC_LIB_COMMON_LATENCYHISTOGRAM_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* LATENCY_HISTOGRAM_SUB_BUCKET_BITS -
+*
+* HDR (High Dynamic Range) histogram layout: values below 2^SUB_BUCKET_BITS have their own
+* bucket and above that each power of two is split in 2^(SUB_BUCKET_BITS-1) linear sub-buckets,
+* so the relative error of any recorded value is below 1/2^(SUB_BUCKET_BITS-1) (~3%).
+*
+* With 1024 buckets, values up to 2^36 (in microseconds, about 19 hours) can be recorded.
+* Larger values are recorded in the last bucket.
+*/
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS  6
+#define LATENCY_HISTOGRAM_BUCKETS          1024
+
+
+
+/* ****************************************************************************
+*
+* LatencyHistogram -
+*
+* Recording is lock-free, so a histogram can be shared by several threads.
+*/
+class LatencyHistogram
+{
+ public:
+  LatencyHistogram();
+
+  void                record(unsigned long long value);
+  void                reset(void);
+
+  unsigned long long  count(void) const;
+  unsigned long long  max(void) const;
+  double              mean(void) const;
+  unsigned long long  valueAtPercentile(double percentile) const;
+
+  std::string         toJson(void) const;
+
+  static unsigned int        indexFor(unsigned long long value);
+  static unsigned long long  highestEquivalentValue(unsigned int index);
+
+ private:
+  unsigned long long  counts[LATENCY_HISTOGRAM_BUCKETS];
+  unsigned long long  totalCount;
+  unsigned long long  totalSum;
+  unsigned long long  maxValue;
+};
+
+#endif  // SRC_LIB_COMMON_LATENCYHISTOGRAM_H_
@@ -0,0 +1,213 @@
+#ifndef SRC_LIB_COMMON_STRINGHASHTABLE_H_
+#define SRC_LIB_COMMON_STRINGHASHTABLE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+
+
+/* ****************************************************************************
+*
+* stringHash - FNV-1a
+*/
+inline unsigned int stringHash(const std::string& s)
+{
+  unsigned int h = 2166136261U;
+
+  for (unsigned int ix = 0; ix < s.size(); ++ix)
+  {
+    h ^= (unsigned char) s[ix];
+    h *= 16777619U;
+  }
+
+  return h;
+}
+
+
+
+/* ****************************************************************************
+*
+* template class StringHashTable<> -
+*
+* Table of long-lived items (never removed) indexed by one of their string fields, made
+* for lookups in the request path.
+*
+* Open addressing hash table of 'size' slots (a power of two). Slots go from NULL to an
+* item just once, always with the mutex of the user of the table taken, so readers can
+* probe it without any lock: an empty slot found while probing means the item is not in
+* the table. The table is filled up to 3/4 of its size. Items beyond that are kept in an
+* overflow map, only accessed with that mutex taken.
+*/
+template <typename T, std::string T::*key, unsigned int size>
+class StringHashTable
+{
+private:
+    T* volatile                table[size];
+    unsigned int               tableItems;
+    std::map<std::string, T*>  overflow;
+
+public:
+    StringHashTable();
+    T*            lookup(const std::string& k, unsigned int hash) const;
+    T*            find(const std::string& k, unsigned int hash) const;
+    void          insert(T* itemP, unsigned int hash);
+    unsigned int  items(void) const;
+    void          all(std::vector<T*>* itemV) const;
+};
+
+
+
+/* ****************************************************************************
+*
+* StringHashTable::StringHashTable -
+*/
+template <typename T, std::string T::*key, unsigned int size>
+StringHashTable<T, key, size>::StringHashTable(): tableItems(0)
+{
+  for (unsigned int slot = 0; slot < size; ++slot)
+  {
+    table[slot] = NULL;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* StringHashTable::lookup - lock-free lookup (overflow items are not found)
+*/
+template <typename T, std::string T::*key, unsigned int size>
+T* StringHashTable<T, key, size>::lookup(const std::string& k, unsigned int hash) const
+{
+  for (unsigned int probe = 0; probe < size; ++probe)
+  {
+    T* itemP = table[(hash + probe) & (size - 1)];
+
+    if (itemP == NULL)
+    {
+      return NULL;
+    }
+
+    if (itemP->*key == k)
+    {
+      return itemP;
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* StringHashTable::find - to be called with the mutex taken
+*/
+template <typename T, std::string T::*key, unsigned int size>
+T* StringHashTable<T, key, size>::find(const std::string& k, unsigned int hash) const
+{
+  T* itemP = lookup(k, hash);
+
+  if (itemP != NULL)
+  {
+    return itemP;
+  }
+
+  typename std::map<std::string, T*>::const_iterator it = overflow.find(k);
+
+  return (it != overflow.end())? it->second : NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* StringHashTable::insert - to be called with the mutex taken
+*/
+template <typename T, std::string T::*key, unsigned int size>
+void StringHashTable<T, key, size>::insert(T* itemP, unsigned int hash)
+{
+  if (tableItems < size / 4 * 3)
+  {
+    for (unsigned int probe = 0; probe < size; ++probe)
+    {
+      unsigned int slot = (hash + probe) & (size - 1);
+
+      if (table[slot] == NULL)
+      {
+        // The item has to be complete before it is visible to readers
+        __sync_synchronize();
+        table[slot] = itemP;
+        ++tableItems;
+
+        return;
+      }
+    }
+  }
+
+  overflow[itemP->*key] = itemP;
+}
+
+
+
+/* ****************************************************************************
+*
+* StringHashTable::items - to be called with the mutex taken
+*/
+template <typename T, std::string T::*key, unsigned int size>
+unsigned int StringHashTable<T, key, size>::items(void) const
+{
+  return tableItems + overflow.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* StringHashTable::all - to be called with the mutex taken
+*/
+template <typename T, std::string T::*key, unsigned int size>
+void StringHashTable<T, key, size>::all(std::vector<T*>* itemV) const
+{
+  for (unsigned int slot = 0; slot < size; ++slot)
+  {
+    T* itemP = table[slot];
+
+    if (itemP != NULL)
+    {
+      itemV->push_back(itemP);
+    }
+  }
+
+  for (typename std::map<std::string, T*>::const_iterator it = overflow.begin(); it != overflow.end(); ++it)
+  {
+    itemV->push_back(it->second);
+  }
+}
+
+#endif  // SRC_LIB_COMMON_STRINGHASHTABLE_H_
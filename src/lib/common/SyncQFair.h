@@ -0,0 +1,278 @@
+#ifndef SRC_LIB_COMMON_SYNCQFAIR_H_
+#define SRC_LIB_COMMON_SYNCQFAIR_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+
+#include <string>
+#include <queue>
+#include <deque>
+#include <map>
+#include <utility>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/* ****************************************************************************
+*
+* template class SyncQFair<> -
+*
+* Bounded queue made of sub-queues (one per key), served with deficit round robin.
+*
+* Each key belongs to a group, that sets the weight of its sub-queues (the cost served
+* per round) and the maximum number of elements of the group (all its sub-queues). The
+* elements of the whole queue are bounded by the size given to the constructor, as in
+* SyncQOverflow<>. Groups not configured use the default weight and limit (the "*" group
+* in configSet()). try_push() fails if the queue (or the group) is full.
+*
+* Empty sub-queues are removed, so the memory used is bounded by the size of the queue
+* whatever the number of keys. With a single key, it works as SyncQOverflow<>.
+*/
+template <typename Data>
+class SyncQFair
+{
+private:
+    struct SubQueue
+    {
+      std::queue<std::pair<Data, size_t> >  items;  // element and cost
+      std::string                           group;
+      unsigned int                          weight;
+      long                                  deficit;
+      bool                                  credited;  // got its quantum in the current round
+    };
+
+    std::map<std::string, SubQueue>                               subQueues;
+    std::deque<std::string>                                       active;      // round robin of keys
+    std::map<std::string, size_t>                                 groupItems;
+    std::map<std::string, std::pair<unsigned int, size_t> >       groupConfig; // weight and limit
+    mutable boost::mutex                                          mtx;
+    boost::condition_variable                                     addedElement;
+    size_t                                                        max_size;
+    size_t                                                        items;
+    unsigned int                                                  defaultWeight;
+    size_t                                                        defaultLimit;
+
+public:
+    explicit SyncQFair(size_t sz): max_size(sz), items(0), defaultWeight(1), defaultLimit(sz) {}
+    void   configSet(const std::string& group, unsigned int weight, size_t limit);
+    bool   try_push(const std::string& key, const std::string& group, Data element, size_t cost = 1);
+    Data   pop();
+    size_t size() const;
+    size_t keys() const;
+
+private:
+    bool   full(const std::string& group, unsigned int* weightP);
+    void   enqueue(const std::string& key, const std::string& group, unsigned int weight, Data element, size_t cost);
+};
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::configSet -
+*
+* A limit of 0 (or beyond the size of the queue) means the size of the queue.
+*/
+template <typename Data>
+void SyncQFair<Data>::configSet(const std::string& group, unsigned int weight, size_t limit)
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  if (weight == 0)
+  {
+    weight = 1;
+  }
+
+  if ((limit == 0) || (limit > max_size))
+  {
+    limit = max_size;
+  }
+
+  if (group == "*")
+  {
+    defaultWeight = weight;
+    defaultLimit  = limit;
+  }
+  else
+  {
+    groupConfig[group] = std::make_pair(weight, limit);
+  }
+}
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::full - whether the queue or the group has no room (mutex taken)
+*/
+template <typename Data>
+bool SyncQFair<Data>::full(const std::string& group, unsigned int* weightP)
+{
+  typename std::map<std::string, std::pair<unsigned int, size_t> >::const_iterator  config = groupConfig.find(group);
+  size_t                                                                             limit  = (config == groupConfig.end())? defaultLimit  : config->second.second;
+
+  *weightP = (config == groupConfig.end())? defaultWeight : config->second.first;
+
+  if (items >= max_size)
+  {
+    return true;
+  }
+
+  std::map<std::string, size_t>::const_iterator inGroup = groupItems.find(group);
+
+  return (inGroup != groupItems.end()) && (inGroup->second >= limit);
+}
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::enqueue - (mutex taken)
+*/
+template <typename Data>
+void SyncQFair<Data>::enqueue(const std::string& key, const std::string& group, unsigned int weight, Data element, size_t cost)
+{
+  typename std::map<std::string, SubQueue>::iterator it = subQueues.find(key);
+
+  if (it == subQueues.end())
+  {
+    SubQueue& sq = subQueues[key];
+
+    sq.group    = group;
+    sq.weight   = weight;
+    sq.deficit  = 0;
+    sq.credited = false;
+
+    active.push_back(key);
+    it = subQueues.find(key);
+  }
+
+  it->second.items.push(std::make_pair(element, cost));
+  ++groupItems[group];
+  ++items;
+}
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::try_push -
+*/
+template <typename Data>
+bool SyncQFair<Data>::try_push(const std::string& key, const std::string& group, Data element, size_t cost)
+{
+  boost::mutex::scoped_lock lock(mtx);
+  unsigned int              weight;
+
+  if (full(group, &weight))
+  {
+    return false;
+  }
+
+  enqueue(key, group, weight, element, cost);
+
+  lock.unlock();
+  addedElement.notify_one();
+
+  return true;
+}
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::pop -
+*
+* The sub-queue at the head of the round robin gets its quantum (its weight) once per
+* round and is served while its deficit covers the cost of its first element. Then it
+* goes to the tail of the round robin (or is removed, if empty).
+*/
+template <typename Data>
+Data SyncQFair<Data>::pop()
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  while (items == 0)
+  {
+    addedElement.wait(lock);
+  }
+
+  for (;;)
+  {
+    std::string  key = active.front();
+    SubQueue&    sq  = subQueues[key];
+
+    if (!sq.credited)
+    {
+      sq.deficit  += sq.weight;
+      sq.credited = true;
+    }
+
+    if ((long) sq.items.front().second <= sq.deficit)
+    {
+      Data element = sq.items.front().first;
+
+      sq.deficit -= sq.items.front().second;
+      sq.items.pop();
+      --items;
+
+      std::map<std::string, size_t>::iterator inGroup = groupItems.find(sq.group);
+
+      if (--inGroup->second == 0)
+      {
+        groupItems.erase(inGroup);
+      }
+
+      if (sq.items.empty())
+      {
+        active.pop_front();
+        subQueues.erase(key);
+      }
+
+      return element;
+    }
+
+    // Quantum exhausted: next sub-queue
+    sq.credited = false;
+    active.pop_front();
+    active.push_back(key);
+  }
+}
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::size -
+*/
+template <typename Data>
+size_t SyncQFair<Data>::size() const
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  return items;
+}
+
+/* ****************************************************************************
+*
+* SyncQFair<Data>::keys - number of non empty sub-queues
+*/
+template <typename Data>
+size_t SyncQFair<Data>::keys() const
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  return subQueues.size();
+}
+
+#endif  // SRC_LIB_COMMON_SYNCQFAIR_H_
@@ -0,0 +1,244 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/TimerWheel.h"
+
+
+
+/* ****************************************************************************
+*
+* listInit - empty circular list
+*/
+static void listInit(TimerWheelNode* headP)
+{
+  headP->prev = headP;
+  headP->next = headP;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::TimerWheel -
+*/
+TimerWheel::TimerWheel(int64_t now): current(now), items(0)
+{
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+  {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot)
+    {
+      listInit(&slots[level][slot]);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::place - link the node in the slot of its time
+*
+* The level is the one whose turn covers the time left to the timer, so the slot is
+* reached (at that level) before the timer is due. Timers due before earliest are placed
+* at earliest: the next tick when scheduled, the current one when cascaded (as the slot
+* of the current tick is processed after the cascade).
+*/
+void TimerWheel::place(TimerWheelNode* nodeP, int64_t earliest)
+{
+  int64_t  when  = (nodeP->when < earliest)? earliest : nodeP->when;
+  int64_t  delta = when - current;
+  int      level = 0;
+
+  while ((level < TIMER_WHEEL_LEVELS - 1) && (delta >= ((int64_t) 1 << (TIMER_WHEEL_BITS * (level + 1)))))
+  {
+    ++level;
+  }
+
+  // Beyond the last level: in its farthest slot, to be placed again once reached
+  int64_t maxDelta = ((int64_t) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+  if (delta > maxDelta)
+  {
+    when = current + maxDelta;
+  }
+
+  TimerWheelNode* headP = &slots[level][(when >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+
+  nodeP->prev       = headP->prev;
+  nodeP->next       = headP;
+  headP->prev->next = nodeP;
+  headP->prev       = nodeP;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::schedule - schedule (or re-schedule) a timer
+*/
+void TimerWheel::schedule(TimerWheelNode* nodeP, int64_t when)
+{
+  cancel(nodeP);
+
+  nodeP->when = when;
+  place(nodeP, current + 1);
+  ++items;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::cancel - no effect if the timer is not scheduled
+*/
+void TimerWheel::cancel(TimerWheelNode* nodeP)
+{
+  if (nodeP->next == NULL)
+  {
+    return;
+  }
+
+  nodeP->prev->next = nodeP->next;
+  nodeP->next->prev = nodeP->prev;
+  nodeP->prev       = NULL;
+  nodeP->next       = NULL;
+  --items;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::cascade - place again the timers of the current slot of a level
+*/
+void TimerWheel::cascade(int level)
+{
+  TimerWheelNode*  headP = &slots[level][(current >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)];
+  TimerWheelNode*  nodeP = headP->next;
+
+  listInit(headP);
+
+  while (nodeP != headP)
+  {
+    TimerWheelNode* next = nodeP->next;
+
+    place(nodeP, current);
+    nodeP = next;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::advance -
+*/
+void TimerWheel::advance(int64_t now, std::vector<TimerWheelNode*>* dueP)
+{
+  while (current < now)
+  {
+    if (items == 0)
+    {
+      current = now;
+      break;
+    }
+
+    ++current;
+
+    // At the end of a turn of a level, the next slot of the level above goes down
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+      if ((current & (((int64_t) 1 << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+      {
+        break;
+      }
+
+      cascade(level);
+    }
+
+    TimerWheelNode*  headP = &slots[0][current & (TIMER_WHEEL_SLOTS - 1)];
+    TimerWheelNode*  nodeP = headP->next;
+
+    listInit(headP);
+
+    while (nodeP != headP)
+    {
+      TimerWheelNode* next = nodeP->next;
+
+      nodeP->prev = NULL;
+      nodeP->next = NULL;
+      --items;
+
+      dueP->push_back(nodeP);
+      nodeP = next;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::clear - cancel all the timers
+*/
+void TimerWheel::clear(void)
+{
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+  {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot)
+    {
+      TimerWheelNode*  headP = &slots[level][slot];
+      TimerWheelNode*  nodeP = headP->next;
+
+      while (nodeP != headP)
+      {
+        TimerWheelNode* next = nodeP->next;
+
+        nodeP->prev = NULL;
+        nodeP->next = NULL;
+        nodeP       = next;
+      }
+
+      listInit(headP);
+    }
+  }
+
+  items = 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::reset - cancel all the timers and set the current tick
+*/
+void TimerWheel::reset(int64_t now)
+{
+  clear();
+  current = now;
+}
@@ -0,0 +1,99 @@
+#ifndef SRC_LIB_COMMON_TIMERWHEEL_H_
+#define SRC_LIB_COMMON_TIMERWHEEL_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+
+
+/* ****************************************************************************
+*
+* TIMER_WHEEL_LEVELS and TIMER_WHEEL_BITS -
+*
+* Each level has 2^TIMER_WHEEL_BITS slots, each slot of a level spanning a whole turn of
+* the level below. With 4 levels of 64 slots and ticks of one second, timers up to 194
+* days away are placed directly (farther ones are placed again when their slot is reached).
+*/
+#define TIMER_WHEEL_LEVELS  4
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SLOTS   (1 << TIMER_WHEEL_BITS)
+
+
+
+/* ****************************************************************************
+*
+* TimerWheelNode - a timer, to be embedded in the object it belongs to
+*
+* ownerP is not used by the wheel, it is meant to get the object back from the node.
+*/
+struct TimerWheelNode
+{
+  TimerWheelNode*  prev;
+  TimerWheelNode*  next;
+  int64_t          when;
+  void*            ownerP;
+
+  TimerWheelNode(): prev(NULL), next(NULL), when(0), ownerP(NULL) {}
+};
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel - hierarchical timing wheel
+*
+* Scheduling and cancelling a timer are O(1). advance() moves the time of the wheel up to
+* a given tick, returning the timers due (timers already due when scheduled are returned by
+* the next advance()). A timer is returned once (to be scheduled again if needed).
+*
+* The wheel is not thread safe: its users protect it with their own locks.
+*/
+class TimerWheel
+{
+ public:
+  explicit TimerWheel(int64_t now = 0);
+
+  void    schedule(TimerWheelNode* nodeP, int64_t when);
+  void    cancel(TimerWheelNode* nodeP);
+  bool    scheduled(const TimerWheelNode* nodeP) const { return nodeP->next != NULL; }
+  void    advance(int64_t now, std::vector<TimerWheelNode*>* dueP);
+  void    clear(void);
+  void    reset(int64_t now);
+  size_t  size(void) const { return items; }
+
+ private:
+  void    place(TimerWheelNode* nodeP, int64_t earliest);
+  void    cascade(int level);
+
+  TimerWheelNode  slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // list heads
+  int64_t         current;                                        // last tick processed
+  size_t          items;
+};
+
+#endif  // SRC_LIB_COMMON_TIMERWHEEL_H_
@@ -0,0 +1,509 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+
+#include <string>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/charScan.h"
+
+//
+// SSE2 is part of x86_64. The SSSE3 and AVX2 kernels are compiled with target attributes
+// (so no special compiler flags are needed) and used only if the CPU has them
+//
+#if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define CHARSCAN_X86
+#include <immintrin.h>
+#endif
+
+
+
+/* ****************************************************************************
+*
+* Kernel function types -
+*/
+typedef size_t (*ClassFindFunction)(const CharClass& cc, const char* s, size_t len);
+typedef size_t (*JsonFindFunction)(const char* s, size_t len);
+
+
+
+/* ****************************************************************************
+*
+* CharClass::CharClass -
+*/
+CharClass::CharClass(const char* chars)
+{
+  memset(member, 0, sizeof(member));
+
+  for (const unsigned char* cP = (const unsigned char*) chars; *cP != 0; ++cP)
+  {
+    member[*cP] = 1;
+  }
+
+  nibblesUpdate();
+}
+
+
+
+/* ****************************************************************************
+*
+* CharClass::addRange -
+*/
+void CharClass::addRange(unsigned char first, unsigned char last)
+{
+  for (unsigned int c = first; c <= last; ++c)
+  {
+    member[c] = 1;
+  }
+
+  nibblesUpdate();
+}
+
+
+
+/* ****************************************************************************
+*
+* CharClass::invert -
+*/
+void CharClass::invert(void)
+{
+  for (unsigned int c = 0; c < 256; ++c)
+  {
+    member[c] = !member[c];
+  }
+
+  nibblesUpdate();
+}
+
+
+
+/* ****************************************************************************
+*
+* CharClass::nibblesUpdate -
+*/
+void CharClass::nibblesUpdate(void)
+{
+  memset(lo, 0, sizeof(lo));
+  memset(hi, 0, sizeof(hi));
+
+  for (unsigned int c = 0; c < 256; ++c)
+  {
+    if (member[c])
+    {
+      unsigned int h = c >> 4;
+
+      if (h < 8)
+      {
+        lo[c & 0x0F] |= (1 << h);
+      }
+      else
+      {
+        hi[c & 0x0F] |= (1 << (h - 8));
+      }
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* jsonEscapeTable - 1 for the bytes needing escape in a JSON string
+*/
+static const unsigned char jsonEscapeTable[256] =
+{
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   // '"'
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0    // '\\'
+  // The rest (0x60-0xFF) is 0
+};
+
+
+
+/* ****************************************************************************
+*
+* classFindScalar -
+*/
+static size_t classFindScalar(const CharClass& cc, const char* s, size_t len)
+{
+  const unsigned char* uP = (const unsigned char*) s;
+
+  for (size_t ix = 0; ix < len; ++ix)
+  {
+    if (cc.member[uP[ix]])
+    {
+      return ix;
+    }
+  }
+
+  return len;
+}
+
+
+
+/* ****************************************************************************
+*
+* jsonFindScalar -
+*/
+static size_t jsonFindScalar(const char* s, size_t len)
+{
+  const unsigned char* uP = (const unsigned char*) s;
+
+  for (size_t ix = 0; ix < len; ++ix)
+  {
+    if (jsonEscapeTable[uP[ix]])
+    {
+      return ix;
+    }
+  }
+
+  return len;
+}
+
+
+
+#ifdef CHARSCAN_X86
+/* ****************************************************************************
+*
+* jsonFindSse2 -
+*
+* A byte needs escape if it is '"', '\\' or max(byte, 0x1F) == 0x1F (unsigned compare)
+*/
+static size_t jsonFindSse2(const char* s, size_t len)
+{
+  const __m128i  quote     = _mm_set1_epi8('"');
+  const __m128i  backslash = _mm_set1_epi8('\\');
+  const __m128i  ctrlMax   = _mm_set1_epi8(0x1F);
+  size_t         ix        = 0;
+
+  for (; ix + 16 <= len; ix += 16)
+  {
+    __m128i  v    = _mm_loadu_si128((const __m128i*) (s + ix));
+    __m128i  hit  = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                 _mm_cmpeq_epi8(_mm_max_epu8(v, ctrlMax), ctrlMax));
+    int      mask = _mm_movemask_epi8(hit);
+
+    if (mask != 0)
+    {
+      return ix + __builtin_ctz(mask);
+    }
+  }
+
+  return ix + jsonFindScalar(s + ix, len - ix);
+}
+
+
+
+/* ****************************************************************************
+*
+* classFindSsse3 -
+*
+* For each byte, the low nibble selects the entry of the lo/hi tables and the high nibble
+* selects the bit of the entry (from the lo table for 0-7, from the hi table for 8-15)
+*/
+__attribute__((target("ssse3")))
+static size_t classFindSsse3(const CharClass& cc, const char* s, size_t len)
+{
+  const __m128i  loTable = _mm_loadu_si128((const __m128i*) cc.lo);
+  const __m128i  hiTable = _mm_loadu_si128((const __m128i*) cc.hi);
+  const __m128i  loBits  = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i  hiBits  = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m128i  nibble  = _mm_set1_epi8(0x0F);
+  const __m128i  zero    = _mm_setzero_si128();
+  size_t         ix      = 0;
+
+  for (; ix + 16 <= len; ix += 16)
+  {
+    __m128i  v      = _mm_loadu_si128((const __m128i*) (s + ix));
+    __m128i  lowN   = _mm_and_si128(v, nibble);
+    __m128i  highN  = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i  loHit  = _mm_and_si128(_mm_shuffle_epi8(loTable, lowN), _mm_shuffle_epi8(loBits, highN));
+    __m128i  hiHit  = _mm_and_si128(_mm_shuffle_epi8(hiTable, lowN), _mm_shuffle_epi8(hiBits, highN));
+    int      mask   = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(loHit, hiHit), zero)) ^ 0xFFFF;
+
+    if (mask != 0)
+    {
+      return ix + __builtin_ctz(mask);
+    }
+  }
+
+  return ix + classFindScalar(cc, s + ix, len - ix);
+}
+
+
+
+/* ****************************************************************************
+*
+* jsonFindAvx2 -
+*/
+__attribute__((target("avx2")))
+static size_t jsonFindAvx2(const char* s, size_t len)
+{
+  const __m256i  quote     = _mm256_set1_epi8('"');
+  const __m256i  backslash = _mm256_set1_epi8('\\');
+  const __m256i  ctrlMax   = _mm256_set1_epi8(0x1F);
+  size_t         ix        = 0;
+
+  for (; ix + 32 <= len; ix += 32)
+  {
+    __m256i   v    = _mm256_loadu_si256((const __m256i*) (s + ix));
+    __m256i   hit  = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                                     _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctrlMax), ctrlMax));
+    unsigned  mask = (unsigned) _mm256_movemask_epi8(hit);
+
+    if (mask != 0)
+    {
+      return ix + __builtin_ctz(mask);
+    }
+  }
+
+  return ix + jsonFindSse2(s + ix, len - ix);
+}
+
+
+
+/* ****************************************************************************
+*
+* classFindAvx2 -
+*
+* Same as classFindSsse3(), the byte shuffle works on each 128 bits lane, so the tables
+* are repeated in both lanes
+*/
+__attribute__((target("avx2")))
+static size_t classFindAvx2(const CharClass& cc, const char* s, size_t len)
+{
+  const __m128i  lo128   = _mm_loadu_si128((const __m128i*) cc.lo);
+  const __m128i  hi128   = _mm_loadu_si128((const __m128i*) cc.hi);
+  const __m256i  loTable = _mm256_inserti128_si256(_mm256_castsi128_si256(lo128), lo128, 1);
+  const __m256i  hiTable = _mm256_inserti128_si256(_mm256_castsi128_si256(hi128), hi128, 1);
+  const __m256i  loBits  = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i  hiBits  = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i  nibble  = _mm256_set1_epi8(0x0F);
+  const __m256i  zero    = _mm256_setzero_si256();
+  size_t         ix      = 0;
+
+  for (; ix + 32 <= len; ix += 32)
+  {
+    __m256i   v      = _mm256_loadu_si256((const __m256i*) (s + ix));
+    __m256i   lowN   = _mm256_and_si256(v, nibble);
+    __m256i   highN  = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i   loHit  = _mm256_and_si256(_mm256_shuffle_epi8(loTable, lowN), _mm256_shuffle_epi8(loBits, highN));
+    __m256i   hiHit  = _mm256_and_si256(_mm256_shuffle_epi8(hiTable, lowN), _mm256_shuffle_epi8(hiBits, highN));
+    unsigned  mask   = ~((unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_or_si256(loHit, hiHit), zero)));
+
+    if (mask != 0)
+    {
+      return ix + __builtin_ctz(mask);
+    }
+  }
+
+  return ix + classFindSsse3(cc, s + ix, len - ix);
+}
+#endif
+
+
+
+/* ****************************************************************************
+*
+* Current kernels -
+*
+* Selected once at startup (charScanInit), before the threads using them are started
+*/
+#ifdef CHARSCAN_X86
+static CharScanLevel      level      = CslSse2;
+static ClassFindFunction  classFindF = classFindScalar;
+static JsonFindFunction   jsonFindF  = jsonFindSse2;
+#else
+static CharScanLevel      level      = CslScalar;
+static ClassFindFunction  classFindF = classFindScalar;
+static JsonFindFunction   jsonFindF  = jsonFindScalar;
+#endif
+
+
+
+/* ****************************************************************************
+*
+* charScanLevelSet -
+*/
+bool charScanLevelSet(CharScanLevel newLevel)
+{
+  switch (newLevel)
+  {
+  case CslScalar:
+    classFindF = classFindScalar;
+    jsonFindF  = jsonFindScalar;
+    break;
+
+#ifdef CHARSCAN_X86
+  case CslSse2:
+    classFindF = classFindScalar;
+    jsonFindF  = jsonFindSse2;
+    break;
+
+  case CslSsse3:
+    if (!__builtin_cpu_supports("ssse3"))
+    {
+      return false;
+    }
+    classFindF = classFindSsse3;
+    jsonFindF  = jsonFindSse2;
+    break;
+
+  case CslAvx2:
+    if (!__builtin_cpu_supports("avx2"))
+    {
+      return false;
+    }
+    classFindF = classFindAvx2;
+    jsonFindF  = jsonFindAvx2;
+    break;
+#endif
+
+  default:
+    return false;
+  }
+
+  level = newLevel;
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* charScanInit -
+*/
+void charScanInit(void)
+{
+#ifdef CHARSCAN_X86
+  __builtin_cpu_init();
+#endif
+
+  if (!charScanLevelSet(CslAvx2) && !charScanLevelSet(CslSsse3))
+  {
+    charScanLevelSet(CslSse2);
+  }
+
+  LM_T(LmtCharScan, ("character scanning kernels: %s", charScanLevelName()));
+}
+
+
+
+/* ****************************************************************************
+*
+* charScanLevelName -
+*/
+const char* charScanLevelName(void)
+{
+  switch (level)
+  {
+  case CslScalar:  return "scalar";
+  case CslSse2:    return "sse2";
+  case CslSsse3:   return "ssse3";
+  case CslAvx2:    return "avx2";
+  }
+
+  return "unknown";
+}
+
+
+
+/* ****************************************************************************
+*
+* charClassFind -
+*/
+size_t charClassFind(const CharClass& cc, const char* s, size_t len)
+{
+  return classFindF(cc, s, len);
+}
+
+
+
+/* ****************************************************************************
+*
+* jsonEscapeFind -
+*/
+size_t jsonEscapeFind(const char* s, size_t len)
+{
+  return jsonFindF(s, len);
+}
+
+
+
+/* ****************************************************************************
+*
+* jsonEscapeAppend -
+*
+* Note that 0x80-0xFF are copied untouched, as they correspond to UTF-8 multi-byte characters
+*/
+void jsonEscapeAppend(std::string* outP, const char* s, size_t len)
+{
+  static const char  intToHex[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+  size_t             ix           = 0;
+
+  while (ix < len)
+  {
+    size_t run = jsonFindF(s + ix, len - ix);
+
+    outP->append(s + ix, run);
+    ix += run;
+
+    if (ix == len)
+    {
+      break;
+    }
+
+    unsigned char ch = (unsigned char) s[ix];
+
+    switch (ch)
+    {
+    case '\\': outP->append("\\\\", 2); break;
+    case '"':  outP->append("\\\"", 2); break;
+    case '\b': outP->append("\\b",  2); break;
+    case '\f': outP->append("\\f",  2); break;
+    case '\n': outP->append("\\n",  2); break;
+    case '\r': outP->append("\\r",  2); break;
+    case '\t': outP->append("\\t",  2); break;
+    default:
+      {
+        // The rest of control chars (0x00-0x1F) as \u00XX
+        char u[6] = { '\\', 'u', '0', '0', intToHex[ch >> 4], intToHex[ch & 0x0F] };
+
+        outP->append(u, 6);
+      }
+      break;
+    }
+
+    ++ix;
+  }
+}
@@ -0,0 +1,133 @@
+#ifndef SRC_LIB_COMMON_CHARSCAN_H_
+#define SRC_LIB_COMMON_CHARSCAN_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stddef.h>
+
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* CharScanLevel - instruction set used by the scanning kernels
+*
+* CslSse2 vectorizes only the JSON escape scan (the character class lookup needs
+* the byte shuffle of SSSE3).
+*/
+typedef enum CharScanLevel
+{
+  CslScalar,
+  CslSse2,
+  CslSsse3,
+  CslAvx2
+} CharScanLevel;
+
+
+
+/* ****************************************************************************
+*
+* CharClass - set of bytes
+*
+* Besides the plain 256 entries table, the set is kept as two 16 entries tables indexed
+* by the low nibble of the byte, each bit of the entry standing for a high nibble (lo for
+* 0x00-0x7F, hi for 0x80-0xFF). This way the vectorized kernels resolve the membership
+* of 16 or 32 bytes with a couple of byte shuffles.
+*/
+class CharClass
+{
+ public:
+  explicit CharClass(const char* chars);
+
+  void  addRange(unsigned char first, unsigned char last);
+  void  invert(void);
+  bool  has(unsigned char c) const { return member[c] != 0; }
+
+  unsigned char  member[256];
+  unsigned char  lo[16];
+  unsigned char  hi[16];
+
+ private:
+  void  nibblesUpdate(void);
+};
+
+
+
+/* ****************************************************************************
+*
+* charScanInit - select the best kernels supported by the CPU
+*
+* Until it is called the portable kernels (SSE2 on x86_64) are used.
+*/
+extern void charScanInit(void);
+
+
+
+/* ****************************************************************************
+*
+* charScanLevelSet - force the kernels of a given level
+*
+* Returns false (and keeps the current kernels) if the CPU or the build doesn't support it.
+*/
+extern bool charScanLevelSet(CharScanLevel level);
+
+
+
+/* ****************************************************************************
+*
+* charScanLevelName -
+*/
+extern const char* charScanLevelName(void);
+
+
+
+/* ****************************************************************************
+*
+* charClassFind - index of the first byte of s in the class (len if none)
+*/
+extern size_t charClassFind(const CharClass& cc, const char* s, size_t len);
+
+
+
+/* ****************************************************************************
+*
+* jsonEscapeFind - index of the first byte of s needing escape in a JSON string (len if none)
+*
+* These are the double quote, the backslash and the control characters (0x00-0x1F).
+*/
+extern size_t jsonEscapeFind(const char* s, size_t len);
+
+
+
+/* ****************************************************************************
+*
+* jsonEscapeAppend - append s to *outP escaped as JSON string content (without quotes)
+*
+* The runs not needing escape are copied at once.
+*/
+extern void jsonEscapeAppend(std::string* outP, const char* s, size_t len);
+
+#endif  // SRC_LIB_COMMON_CHARSCAN_H_
@@ -0,0 +1,1405 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "common/limits.h"
+#include "common/codec.h"
+
+
+
+/* ****************************************************************************
+*
+* shortestNumbers -
+*/
+static bool shortestNumbers = false;
+
+
+
+/* ****************************************************************************
+*
+* digitPairs - "00" to "99", to render two digits at a time
+*/
+static const char digitPairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+
+
+/* ****************************************************************************
+*
+* pow10Exact - the powers of 10 exactly representable as double
+*/
+static const double pow10Exact[] =
+{
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+
+/* ****************************************************************************
+*
+* pow10Int -
+*/
+static const uint64_t pow10Int[] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+  10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+
+
+/* ****************************************************************************
+*
+* codecInit -
+*/
+void codecInit(bool _shortestNumbers)
+{
+  shortestNumbers = _shortestNumbers;
+}
+
+
+
+/* ****************************************************************************
+*
+* uintFormat - render n in buf, returning the length
+*/
+static int uintFormat(uint64_t n, char* buf)
+{
+  char  tmp[20];
+  char* p = &tmp[20];
+
+  while (n >= 100)
+  {
+    const char* pair = &digitPairs[(n % 100) * 2];
+
+    n   /= 100;
+    p   -= 2;
+    p[0] = pair[0];
+    p[1] = pair[1];
+  }
+
+  if (n >= 10)
+  {
+    p   -= 2;
+    p[0] = digitPairs[n * 2];
+    p[1] = digitPairs[n * 2 + 1];
+  }
+  else
+  {
+    *--p = '0' + n;
+  }
+
+  int len = &tmp[20] - p;
+
+  memcpy(buf, p, len);
+  buf[len] = 0;
+
+  return len;
+}
+
+
+
+/* ****************************************************************************
+*
+* integerFormat -
+*/
+int integerFormat(long long i, char* buf)
+{
+  if (i < 0)
+  {
+    buf[0] = '-';
+    // Unsigned negation, so LLONG_MIN is also fine
+    return 1 + uintFormat(0ULL - (uint64_t) i, &buf[1]);
+  }
+
+  return uintFormat((uint64_t) i, buf);
+}
+
+
+
+/* ****************************************************************************
+*
+* DiyFp - "do it yourself" floating point: f * 2^e, with 64 bits significand
+*
+* This and the functions below implement the Grisu3 algorithm (Florian Loitsch,
+* "Printing Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010),
+* the same way the double-conversion library does, falling back to a printf based
+* search for the values it rejects.
+*/
+struct DiyFp
+{
+  uint64_t  f;
+  int       e;
+
+  DiyFp(): f(0), e(0) {}
+  DiyFp(uint64_t _f, int _e): f(_f), e(_e) {}
+
+  explicit DiyFp(double d)
+  {
+    uint64_t u;
+
+    memcpy(&u, &d, sizeof(u));
+
+    int       biasedE     = (int) ((u >> 52) & 0x7FF);
+    uint64_t  significand = u & 0x000FFFFFFFFFFFFFULL;
+
+    if (biasedE != 0)
+    {
+      f = significand + 0x0010000000000000ULL;
+      e = biasedE - 1075;
+    }
+    else
+    {
+      f = significand;
+      e = -1074;
+    }
+  }
+};
+
+
+
+/* ****************************************************************************
+*
+* diyFpMultiply - the 64 most significant bits of the product, rounded
+*/
+static DiyFp diyFpMultiply(const DiyFp& x, const DiyFp& y)
+{
+  const uint64_t M32 = 0xFFFFFFFFULL;
+  uint64_t       a   = x.f >> 32;
+  uint64_t       b   = x.f & M32;
+  uint64_t       c   = y.f >> 32;
+  uint64_t       d   = y.f & M32;
+  uint64_t       ac  = a * c;
+  uint64_t       bc  = b * c;
+  uint64_t       ad  = a * d;
+  uint64_t       bd  = b * d;
+  uint64_t       tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+
+  tmp += 1ULL << 31;  // rounding
+
+  return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+
+
+/* ****************************************************************************
+*
+* diyFpNormalize - shift the significand so its highest bit is set
+*/
+static DiyFp diyFpNormalize(DiyFp x)
+{
+  while ((x.f & 0x8000000000000000ULL) == 0)
+  {
+    x.f <<= 1;
+    x.e--;
+  }
+
+  return x;
+}
+
+
+
+/* ****************************************************************************
+*
+* diyFpBoundaries - the normalized boundaries m- and m+ of the double v
+*
+* Any number between them (they excluded) rounds to v.
+*/
+static void diyFpBoundaries(const DiyFp& v, DiyFp* minusP, DiyFp* plusP)
+{
+  DiyFp plus = diyFpNormalize(DiyFp((v.f << 1) + 1, v.e - 1));
+  DiyFp minus;
+
+  // When v is a power of two its lower neighbour is closer
+  if (v.f == 0x0010000000000000ULL)
+  {
+    minus = DiyFp((v.f << 2) - 1, v.e - 2);
+  }
+  else
+  {
+    minus = DiyFp((v.f << 1) - 1, v.e - 1);
+  }
+
+  minus.f <<= minus.e - plus.e;
+  minus.e   = plus.e;
+
+  *plusP  = plus;
+  *minusP = minus;
+}
+
+
+
+/* ****************************************************************************
+*
+* cachedPowers - normalized 10^k, for k = -348, -340, ..., 340
+*/
+static const struct { uint64_t f; int e; } cachedPowers[] =
+{
+  { 0xfa8fd5a0081c0288ULL, -1220 }, { 0xbaaee17fa23ebf76ULL, -1193 }, { 0x8b16fb203055ac76ULL, -1166 },
+  { 0xcf42894a5dce35eaULL, -1140 }, { 0x9a6bb0aa55653b2dULL, -1113 }, { 0xe61acf033d1a45dfULL, -1087 },
+  { 0xab70fe17c79ac6caULL, -1060 }, { 0xff77b1fcbebcdc4fULL, -1034 }, { 0xbe5691ef416bd60cULL, -1007 },
+  { 0x8dd01fad907ffc3cULL,  -980 }, { 0xd3515c2831559a83ULL,  -954 }, { 0x9d71ac8fada6c9b5ULL,  -927 },
+  { 0xea9c227723ee8bcbULL,  -901 }, { 0xaecc49914078536dULL,  -874 }, { 0x823c12795db6ce57ULL,  -847 },
+  { 0xc21094364dfb5637ULL,  -821 }, { 0x9096ea6f3848984fULL,  -794 }, { 0xd77485cb25823ac7ULL,  -768 },
+  { 0xa086cfcd97bf97f4ULL,  -741 }, { 0xef340a98172aace5ULL,  -715 }, { 0xb23867fb2a35b28eULL,  -688 },
+  { 0x84c8d4dfd2c63f3bULL,  -661 }, { 0xc5dd44271ad3cdbaULL,  -635 }, { 0x936b9fcebb25c996ULL,  -608 },
+  { 0xdbac6c247d62a584ULL,  -582 }, { 0xa3ab66580d5fdaf6ULL,  -555 }, { 0xf3e2f893dec3f126ULL,  -529 },
+  { 0xb5b5ada8aaff80b8ULL,  -502 }, { 0x87625f056c7c4a8bULL,  -475 }, { 0xc9bcff6034c13053ULL,  -449 },
+  { 0x964e858c91ba2655ULL,  -422 }, { 0xdff9772470297ebdULL,  -396 }, { 0xa6dfbd9fb8e5b88fULL,  -369 },
+  { 0xf8a95fcf88747d94ULL,  -343 }, { 0xb94470938fa89bcfULL,  -316 }, { 0x8a08f0f8bf0f156bULL,  -289 },
+  { 0xcdb02555653131b6ULL,  -263 }, { 0x993fe2c6d07b7facULL,  -236 }, { 0xe45c10c42a2b3b06ULL,  -210 },
+  { 0xaa242499697392d3ULL,  -183 }, { 0xfd87b5f28300ca0eULL,  -157 }, { 0xbce5086492111aebULL,  -130 },
+  { 0x8cbccc096f5088ccULL,  -103 }, { 0xd1b71758e219652cULL,   -77 }, { 0x9c40000000000000ULL,   -50 },
+  { 0xe8d4a51000000000ULL,   -24 }, { 0xad78ebc5ac620000ULL,     3 }, { 0x813f3978f8940984ULL,    30 },
+  { 0xc097ce7bc90715b3ULL,    56 }, { 0x8f7e32ce7bea5c70ULL,    83 }, { 0xd5d238a4abe98068ULL,   109 },
+  { 0x9f4f2726179a2245ULL,   136 }, { 0xed63a231d4c4fb27ULL,   162 }, { 0xb0de65388cc8ada8ULL,   189 },
+  { 0x83c7088e1aab65dbULL,   216 }, { 0xc45d1df942711d9aULL,   242 }, { 0x924d692ca61be758ULL,   269 },
+  { 0xda01ee641a708deaULL,   295 }, { 0xa26da3999aef774aULL,   322 }, { 0xf209787bb47d6b85ULL,   348 },
+  { 0xb454e4a179dd1877ULL,   375 }, { 0x865b86925b9bc5c2ULL,   402 }, { 0xc83553c5c8965d3dULL,   428 },
+  { 0x952ab45cfa97a0b3ULL,   455 }, { 0xde469fbd99a05fe3ULL,   481 }, { 0xa59bc234db398c25ULL,   508 },
+  { 0xf6c69a72a3989f5cULL,   534 }, { 0xb7dcbf5354e9beceULL,   561 }, { 0x88fcf317f22241e2ULL,   588 },
+  { 0xcc20ce9bd35c78a5ULL,   614 }, { 0x98165af37b2153dfULL,   641 }, { 0xe2a0b5dc971f303aULL,   667 },
+  { 0xa8d9d1535ce3b396ULL,   694 }, { 0xfb9b7cd9a4a7443cULL,   720 }, { 0xbb764c4ca7a44410ULL,   747 },
+  { 0x8bab8eefb6409c1aULL,   774 }, { 0xd01fef10a657842cULL,   800 }, { 0x9b10a4e5e9913129ULL,   827 },
+  { 0xe7109bfba19c0c9dULL,   853 }, { 0xac2820d9623bf429ULL,   880 }, { 0x80444b5e7aa7cf85ULL,   907 },
+  { 0xbf21e44003acdd2dULL,   933 }, { 0x8e679c2f5e44ff8fULL,   960 }, { 0xd433179d9c8cb841ULL,   986 },
+  { 0x9e19db92b4e31ba9ULL,  1013 }, { 0xeb96bf6ebadf77d9ULL,  1039 }, { 0xaf87023b9bf0ee6bULL,  1066 }
+};
+
+
+
+/* ****************************************************************************
+*
+* cachedPowerGet - cached power c = 10^-k such that the exponent of w * c is in [-60, -32]
+*/
+static DiyFp cachedPowerGet(int e, int* kP)
+{
+  double    dk    = (-61 - e) * 0.30102999566398114 + 347;  // dk must be positive, so it can be ceiled
+  int       k     = (int) dk;
+
+  if (dk - k > 0.0)
+  {
+    k++;
+  }
+
+  unsigned  index = (unsigned) ((k >> 3) + 1);
+
+  *kP = -(-348 + (int) (index << 3));  // decimal exponent, no need for a table
+
+  return DiyFp(cachedPowers[index].f, cachedPowers[index].e);
+}
+
+
+
+/* ****************************************************************************
+*
+* decimalDigits - number of decimal digits of n
+*/
+static int decimalDigits(uint32_t n)
+{
+  if (n < 10)         return 1;
+  if (n < 100)        return 2;
+  if (n < 1000)       return 3;
+  if (n < 10000)      return 4;
+  if (n < 100000)     return 5;
+  if (n < 1000000)    return 6;
+  if (n < 10000000)   return 7;
+  if (n < 100000000)  return 8;
+  if (n < 1000000000) return 9;
+
+  return 10;
+}
+
+
+
+/* ****************************************************************************
+*
+* roundWeed - move the last digit towards W while it is safe, telling if the result is
+* for sure the closest shortest number to W
+*
+* The distances are taken from the upper end of the unsafe interval, in the unit of
+* 'rest', being 'unit' the imprecision of the scaled values (Grisu3).
+*/
+static bool roundWeed
+(
+  char*     buf,
+  int       len,
+  uint64_t  distanceTooHighW,
+  uint64_t  unsafeInterval,
+  uint64_t  rest,
+  uint64_t  tenKappa,
+  uint64_t  unit
+)
+{
+  uint64_t smallDistance = distanceTooHighW - unit;
+  uint64_t bigDistance   = distanceTooHighW + unit;
+
+  while ((rest < smallDistance) && (unsafeInterval - rest >= tenKappa) &&
+         ((rest + tenKappa < smallDistance) || (smallDistance - rest >= rest + tenKappa - smallDistance)))
+  {
+    buf[len - 1]--;
+    rest += tenKappa;
+  }
+
+  // Another decrement could get closer to W or not, it can't be told
+  if ((rest < bigDistance) && (unsafeInterval - rest >= tenKappa) &&
+      ((rest + tenKappa < bigDistance) || (bigDistance - rest > rest + tenKappa - bigDistance)))
+  {
+    return false;
+  }
+
+  // Within the safe interval, so between the boundaries for sure
+  return (2 * unit <= rest) && (rest <= unsafeInterval - 4 * unit);
+}
+
+
+
+/* ****************************************************************************
+*
+* digitGen - generate the shortest digits of W within the boundaries [Wm, Wp]
+*
+* The scaled boundaries are imprecise by one unit, so the digits are generated within
+* the unsafe interval (Wm - 1, Wp + 1) and then checked against the safe one. Returns
+* false when they can't be proven to be the shortest (a few values in a thousand).
+*/
+static bool digitGen(const DiyFp& Wm, const DiyFp& W, const DiyFp& Wp, char* buf, int* lenP, int* kP)
+{
+  const DiyFp  one(1ULL << -W.e, W.e);
+  uint64_t     unit           = 1;
+  uint64_t     tooHigh        = Wp.f + unit;
+  uint64_t     unsafeInterval = tooHigh - (Wm.f - unit);
+  uint32_t     integrals      = (uint32_t) (tooHigh >> -one.e);
+  uint64_t     fractionals    = tooHigh & (one.f - 1);
+  int          kappa          = decimalDigits(integrals);
+
+  *lenP = 0;
+
+  while (kappa > 0)
+  {
+    uint64_t divisor = pow10Int[kappa - 1];
+
+    buf[(*lenP)++] = '0' + integrals / (uint32_t) divisor;
+    integrals     %= (uint32_t) divisor;
+    kappa--;
+
+    uint64_t rest = ((uint64_t) integrals << -one.e) + fractionals;
+
+    if (rest < unsafeInterval)
+    {
+      *kP += kappa;
+      return roundWeed(buf, *lenP, tooHigh - W.f, unsafeInterval, rest, divisor << -one.e, unit);
+    }
+  }
+
+  // kappa == 0, the integral part is exhausted
+  for (;;)
+  {
+    fractionals    *= 10;
+    unit           *= 10;
+    unsafeInterval *= 10;
+
+    buf[(*lenP)++] = '0' + (char) (fractionals >> -one.e);
+    fractionals   &= one.f - 1;
+    kappa--;
+
+    if (fractionals < unsafeInterval)
+    {
+      *kP += kappa;
+      return roundWeed(buf, *lenP, (tooHigh - W.f) * unit, unsafeInterval, fractionals, one.f, unit);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* grisu3 - shortest digits of v (positive and finite), being v = digits * 10^k
+*
+* Returns false when the digits can't be proven to be the shortest ones.
+*/
+static bool grisu3(double value, char* buf, int* lenP, int* kP)
+{
+  DiyFp v(value);
+  DiyFp mMinus;
+  DiyFp mPlus;
+
+  diyFpBoundaries(v, &mMinus, &mPlus);
+
+  DiyFp c  = cachedPowerGet(mPlus.e, kP);
+  DiyFp W  = diyFpMultiply(diyFpNormalize(v), c);
+  DiyFp Wp = diyFpMultiply(mPlus, c);
+  DiyFp Wm = diyFpMultiply(mMinus, c);
+
+  return digitGen(Wm, W, Wp, buf, lenP, kP);
+}
+
+
+
+/* ****************************************************************************
+*
+* shortestSearch - shortest digits of v (positive and finite) the slow way
+*
+* Fallback for the values Grisu3 rejects: the first precision of '%.*e' parsing back
+* to v gives them (17 digits always do).
+*/
+static void shortestSearch(double value, char* buf, int* lenP, int* kP)
+{
+  char  tmp[32];
+  int   precision = 0;
+
+  snprintf(tmp, sizeof(tmp), "%.*e", precision, value);
+
+  while ((precision < 16) && (strtod(tmp, NULL) != value))
+  {
+    ++precision;
+    snprintf(tmp, sizeof(tmp), "%.*e", precision, value);
+  }
+
+  // tmp is "d.ddde+xx"
+  const char* eP = strchr(tmp, 'e');
+
+  *lenP = 0;
+
+  for (const char* p = tmp; p < eP; ++p)
+  {
+    if ((*p >= '0') && (*p <= '9'))
+    {
+      buf[(*lenP)++] = *p;
+    }
+  }
+
+  *kP = atoi(eP + 1) - (*lenP - 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* exponentFormat -
+*/
+static int exponentFormat(int k, char* buf)
+{
+  if (k < 0)
+  {
+    buf[0] = '-';
+    k      = -k;
+  }
+  else
+  {
+    buf[0] = '+';
+  }
+
+  return 1 + uintFormat((uint64_t) k, &buf[1]);
+}
+
+
+
+/* ****************************************************************************
+*
+* prettify - lay out the digits (value = digits * 10^k) as a JSON number
+*/
+static int prettify(char* buf, int len, int k)
+{
+  int kk = len + k;  // 10^(kk - 1) <= value < 10^kk
+
+  if ((k >= 0) && (kk <= 21))
+  {
+    // 1234e3 -> 1234000
+    for (int ix = len; ix < kk; ++ix)
+    {
+      buf[ix] = '0';
+    }
+
+    buf[kk] = 0;
+    return kk;
+  }
+  else if ((kk > 0) && (kk <= 21))
+  {
+    // 1234e-2 -> 12.34
+    memmove(&buf[kk + 1], &buf[kk], len - kk);
+    buf[kk]      = '.';
+    buf[len + 1] = 0;
+    return len + 1;
+  }
+  else if ((kk > -6) && (kk <= 0))
+  {
+    // 1234e-6 -> 0.001234
+    int offset = 2 - kk;
+
+    memmove(&buf[offset], &buf[0], len);
+    buf[0] = '0';
+    buf[1] = '.';
+
+    for (int ix = 2; ix < offset; ++ix)
+    {
+      buf[ix] = '0';
+    }
+
+    buf[len + offset] = 0;
+    return len + offset;
+  }
+  else if (len == 1)
+  {
+    // 1e30
+    buf[1] = 'e';
+    return 2 + exponentFormat(kk - 1, &buf[2]);
+  }
+
+  // 1234e30 -> 1.234e+33
+  memmove(&buf[2], &buf[1], len - 1);
+  buf[1]       = '.';
+  buf[len + 1] = 'e';
+
+  return len + 2 + exponentFormat(kk - 1, &buf[len + 2]);
+}
+
+
+
+/* ****************************************************************************
+*
+* nonFiniteFormat - as printf does
+*/
+static int nonFiniteFormat(double f, char* buf)
+{
+  const char* s = isnan(f)? "nan" : ((f < 0)? "-inf" : "inf");
+
+  strcpy(buf, s);
+  return strlen(s);
+}
+
+
+
+/* ****************************************************************************
+*
+* doubleFormatShortest -
+*/
+int doubleFormatShortest(double f, char* buf)
+{
+  if (!isfinite(f))
+  {
+    return nonFiniteFormat(f, buf);
+  }
+
+  if (f == 0)
+  {
+    buf[0] = '0';
+    buf[1] = 0;
+    return 1;
+  }
+
+  // Integral values (the usual case) don't need Grisu
+  if ((f > -9007199254740992.0) && (f < 9007199254740992.0) && (f == (double) (long long) f))
+  {
+    return integerFormat((long long) f, buf);
+  }
+
+  int  neg = 0;
+  int  len;
+  int  k;
+
+  if (f < 0)
+  {
+    buf[0] = '-';
+    neg    = 1;
+    f      = -f;
+  }
+
+  if (!grisu3(f, &buf[neg], &len, &k))
+  {
+    shortestSearch(f, &buf[neg], &len, &k);
+  }
+
+  return neg + prettify(&buf[neg], len, k);
+}
+
+
+
+/* ****************************************************************************
+*
+* doubleFormatDecimal9 -
+*
+* The fractional part is rounded to 9 decimals the way printf does, i.e. to nearest
+* taking into account the exact binary value (and ties to even). The product by 1e9 is
+* done with an error term (Dekker's algorithm) so the exact value is known.
+*/
+int doubleFormatDecimal9(double f, char* buf)
+{
+  if (!isfinite(f))
+  {
+    return nonFiniteFormat(f, buf);
+  }
+
+  // Out of the 'long long' range all doubles are integers
+  if ((f >= 9223372036854775808.0) || (f <= -9223372036854775808.0))
+  {
+    return doubleFormatShortest(f, buf);
+  }
+
+  double    a     = (f < 0)? -f : f;
+  double    ip    = floor(a);
+  double    fr    = a - ip;   // exact
+  double    p     = fr * 1e9;
+  double    split = 134217729.0 * fr;  // 2^27 + 1
+  double    frHi  = split - (split - fr);
+  double    frLo  = fr - frHi;
+  double    err   = (frHi * 1e9 - p) + frLo * 1e9;  // fr * 1e9 == p + err, exactly
+  double    r     = nearbyint(p);  // ties to even
+  double    tie   = p - r;
+  uint64_t  intPart;
+  uint64_t  decimals;
+  int       len   = 0;
+
+  // p being a tie, the error term decides
+  if ((tie == 0.5) && (err > 0))
+  {
+    r += 1;
+  }
+  else if ((tie == -0.5) && (err < 0))
+  {
+    r -= 1;
+  }
+
+  intPart  = (uint64_t) ip;
+  decimals = (uint64_t) r;
+
+  if (decimals == 1000000000)
+  {
+    intPart  += 1;
+    decimals  = 0;
+  }
+
+  if (f < 0)
+  {
+    buf[len++] = '-';
+  }
+
+  len += uintFormat(intPart, &buf[len]);
+
+  if (decimals != 0)
+  {
+    int width = 9;
+
+    // Trailing zeros are dropped
+    while (decimals % 10 == 0)
+    {
+      decimals /= 10;
+      width--;
+    }
+
+    buf[len++] = '.';
+
+    for (int ix = width - 1; ix >= 0; --ix)
+    {
+      buf[len + ix] = '0' + decimals % 10;
+      decimals     /= 10;
+    }
+
+    len += width;
+  }
+
+  buf[len] = 0;
+  return len;
+}
+
+
+
+/* ****************************************************************************
+*
+* doubleFormat -
+*/
+int doubleFormat(double f, char* buf)
+{
+  if (!isfinite(f))
+  {
+    return nonFiniteFormat(f, buf);
+  }
+
+  if (shortestNumbers)
+  {
+    return doubleFormatShortest(f, buf);
+  }
+
+  // Out of the 'long long' range all doubles are integers
+  if ((f >= 9223372036854775808.0) || (f <= -9223372036854775808.0))
+  {
+    return doubleFormatShortest(f, buf);
+  }
+
+  long long  intPart = (long long) f;
+  double     diff    = f - intPart;
+
+  // abs value for 'diff'
+  diff = (diff < 0)? -diff : diff;
+
+  if (diff > 0.9999999998)
+  {
+    return integerFormat((f < 0)? intPart - 1 : intPart + 1, buf);
+  }
+  else if (diff < 0.000000001)  // it is considered an integer
+  {
+    return integerFormat(intPart, buf);
+  }
+
+  return doubleFormatDecimal9(f, buf);
+}
+
+
+
+/* ****************************************************************************
+*
+* doubleParseFast - the conversion for plain decimal numbers with up to 15 significant digits
+*
+* Such a mantissa is exact as double and so is 10^e for e <= 22, so a single multiplication
+* or division gives the correctly rounded result (Clinger's fast path). Returns false if the
+* number is not in this case. The characters that could continue a number (as in hex numbers)
+* are not accepted after it, so any doubt is left to strtod.
+*/
+static bool doubleParseFast(const char* s, double* dP, char** endP)
+{
+#if defined(__FLT_EVAL_METHOD__) && (__FLT_EVAL_METHOD__ == 0)
+  const char*  p         = s;
+  bool         negative  = false;
+  uint64_t     mantissa  = 0;
+  int          sigDigits = 0;
+  int          digits    = 0;
+  int          exp10     = 0;
+
+  if ((*p == '-') || (*p == '+'))
+  {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  while ((*p >= '0') && (*p <= '9'))
+  {
+    if ((mantissa != 0) || (*p != '0'))
+    {
+      if (++sigDigits > 15)
+      {
+        return false;
+      }
+
+      mantissa = mantissa * 10 + (*p - '0');
+    }
+
+    ++digits;
+    ++p;
+  }
+
+  if (*p == '.')
+  {
+    ++p;
+
+    while ((*p >= '0') && (*p <= '9'))
+    {
+      if ((mantissa != 0) || (*p != '0'))
+      {
+        if (++sigDigits > 15)
+        {
+          return false;
+        }
+
+        mantissa = mantissa * 10 + (*p - '0');
+      }
+
+      --exp10;
+      ++digits;
+      ++p;
+    }
+  }
+
+  if (digits == 0)
+  {
+    return false;
+  }
+
+  if ((*p == 'e') || (*p == 'E'))
+  {
+    bool  expNegative = false;
+    int   expDigits   = 0;
+    int   e           = 0;
+
+    ++p;
+
+    if ((*p == '-') || (*p == '+'))
+    {
+      expNegative = (*p == '-');
+      ++p;
+    }
+
+    while ((*p >= '0') && (*p <= '9'))
+    {
+      if (++expDigits > 4)
+      {
+        return false;
+      }
+
+      e = e * 10 + (*p - '0');
+      ++p;
+    }
+
+    if (expDigits == 0)
+    {
+      return false;
+    }
+
+    exp10 += expNegative? -e : e;
+  }
+
+  if (((*p >= 'a') && (*p <= 'z')) || ((*p >= 'A') && (*p <= 'Z')) || ((*p >= '0') && (*p <= '9')) || (*p == '.'))
+  {
+    return false;
+  }
+
+  double d;
+
+  if (mantissa == 0)
+  {
+    d = 0.0;
+  }
+  else if ((exp10 >= 0) && (exp10 <= 22))
+  {
+    d = (double) mantissa * pow10Exact[exp10];
+  }
+  else if ((exp10 < 0) && (exp10 >= -22))
+  {
+    d = (double) mantissa / pow10Exact[-exp10];
+  }
+  else
+  {
+    return false;
+  }
+
+  *dP = negative? -d : d;
+
+  if (endP != NULL)
+  {
+    *endP = (char*) p;
+  }
+
+  return true;
+#else
+  // Extended precision intermediate results would round twice
+  return false;
+#endif
+}
+
+
+
+/* ****************************************************************************
+*
+* doubleParse -
+*/
+double doubleParse(const char* s, char** endP)
+{
+  double d;
+
+  if (doubleParseFast(s, &d, endP))
+  {
+    return d;
+  }
+
+  return strtod(s, endP);
+}
+
+
+
+/* ****************************************************************************
+*
+* civilFromDays - date of a number of days since 1970-01-01 (proleptic Gregorian calendar)
+*
+* From http://howardhinnant.github.io/date_algorithms.html
+*/
+static void civilFromDays(long long z, long long* yP, int* mP, int* dP)
+{
+  z += 719468;
+
+  long long  era = ((z >= 0)? z : z - 146096) / 146097;
+  unsigned   doe = (unsigned) (z - era * 146097);                             // [0, 146096]
+  unsigned   yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;   // [0, 399]
+  unsigned   doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                 // [0, 365]
+  unsigned   mp  = (5 * doy + 2) / 153;                                      // [0, 11]
+  int        m   = (mp < 10)? mp + 3 : mp - 9;
+
+  *yP = (long long) yoe + era * 400 + ((m <= 2)? 1 : 0);
+  *mP = m;
+  *dP = doy - (153 * mp + 2) / 5 + 1;
+}
+
+
+
+/* ****************************************************************************
+*
+* daysFromCivil - number of days since 1970-01-01 of a date (inverse of civilFromDays)
+*/
+static long long daysFromCivil(long long y, int m, int d)
+{
+  y -= (m <= 2)? 1 : 0;
+
+  long long  era = ((y >= 0)? y : y - 399) / 400;
+  unsigned   yoe = (unsigned) (y - era * 400);                                // [0, 399]
+  unsigned   doy = (153 * ((m > 2)? m - 3 : m + 9) + 2) / 5 + d - 1;          // [0, 365]
+  unsigned   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                    // [0, 146096]
+
+  return era * 146097 + (long long) doe - 719468;
+}
+
+
+
+/* ****************************************************************************
+*
+* isodateFormatTm - format with gmtime_r and strftime, for the years out of 1000-9999
+*
+* Note that strftime doesn't pad the year to 4 digits.
+*/
+static int isodateFormatTm(long long timestamp, char* buf)
+{
+  time_t     rawtime = (time_t) timestamp;
+  struct tm  tm;
+
+  if (gmtime_r(&rawtime, &tm) == NULL)
+  {
+    buf[0] = 0;
+    return 0;
+  }
+
+  return strftime(buf, CODEC_DATE_SIZE, "%Y-%m-%dT%H:%M:%S.00Z", &tm);
+}
+
+
+
+/* ****************************************************************************
+*
+* isodateFormat -
+*
+* Dates are usually rendered in bursts (several entities or attributes modified in the
+* same second), so the last rendered date and the prefix of its day are kept per thread.
+*/
+int isodateFormat(long long timestamp, char* buf)
+{
+  static __thread bool       lastValid = false;
+  static __thread long long  lastTimestamp;
+  static __thread char       last[24];
+  static __thread bool       dayValid  = false;
+  static __thread long long  dayDays;
+  static __thread char       day[11];
+
+  if (lastValid && (timestamp == lastTimestamp))
+  {
+    memcpy(buf, last, sizeof(last));
+    return sizeof(last) - 1;
+  }
+
+  long long  days = timestamp / 86400;
+  int        secs = (int) (timestamp % 86400);
+
+  if (secs < 0)
+  {
+    secs += 86400;
+    days -= 1;
+  }
+
+  if (!dayValid || (days != dayDays))
+  {
+    long long  y;
+    int        m;
+    int        d;
+
+    civilFromDays(days, &y, &m, &d);
+
+    if ((y < 1000) || (y > 9999))
+    {
+      return isodateFormatTm(timestamp, buf);
+    }
+
+    memcpy(&day[0], &digitPairs[(y / 100) * 2], 2);
+    memcpy(&day[2], &digitPairs[(y % 100) * 2], 2);
+    day[4] = '-';
+    memcpy(&day[5], &digitPairs[m * 2], 2);
+    day[7] = '-';
+    memcpy(&day[8], &digitPairs[d * 2], 2);
+    day[10] = 'T';
+
+    dayDays  = days;
+    dayValid = true;
+  }
+
+  memcpy(buf, day, 11);
+  memcpy(&buf[11], &digitPairs[(secs / 3600) * 2], 2);
+  buf[13] = ':';
+  memcpy(&buf[14], &digitPairs[((secs / 60) % 60) * 2], 2);
+  buf[16] = ':';
+  memcpy(&buf[17], &digitPairs[(secs % 60) * 2], 2);
+  memcpy(&buf[19], ".00Z", 5);
+
+  memcpy(last, buf, sizeof(last));
+  lastTimestamp = timestamp;
+  lastValid     = true;
+
+  return sizeof(last) - 1;
+}
+
+
+
+/*****************************************************************************
+*
+* timezoneOffset -
+*
+* Returns the time offset corresponding to a given timezone. Only the ISO8601 timezonoe
+* formats are supported (https://en.wikipedia.org/wiki/ISO_8601#Time_zone_designators):
+*
+* <time>Z
+* <time>±hh:mm
+* <time>±hhmm
+* <time>±hh
+*
+* The value -1 is used as "wrong timezone" (note that no timezone corresponds to an
+* offset of just one negative second)
+*
+*/
+static int timezoneOffset(const char* tz)
+{
+  // Trying the <time>Z format
+  if (strcmp(tz, "Z") == 0)
+  {
+    return 0;
+  }
+
+  // All other cases start by + or -
+  if ((tz[0] != '+') && (tz[0] != '-'))
+  {
+    return -1;
+  }
+
+  int sign   = (tz[0] == '+')? 1 : -1;
+  int offset = -1;
+  int h;
+  int m;
+
+  if (sscanf(tz + 1, "%2d:%2d", &h, &m) == 2)      // Trying the <time>±hh:mm format
+  {
+    offset = h * 60 * 60 + m * 60;
+  }
+  else if (sscanf(tz + 1, "%2d%2d", &h, &m) == 2)  // Trying the <time>±hhmm format
+  {
+    offset = h * 60 * 60 + m * 60;
+  }
+  else if (sscanf(tz + 1, "%2d", &h) == 1)         // Trying the <time>±hh format
+  {
+    offset = h * 60 * 60;
+  }
+
+  if (offset == -1)
+  {
+    // invalid timezone
+    return -1;
+  }
+
+  return sign * offset;
+}
+
+
+
+/*****************************************************************************
+*
+* isodateParseScanf - the general (and slow) parsing
+*
+* Based in http://stackoverflow.com/questions/26895428/how-do-i-parse-an-iso-8601-date-with-optional-milliseconds-to-a-struct-tm-in-c
+*/
+static int64_t isodateParseScanf(const char* ss)
+{
+  int    y = 0;
+  int    M = 0;
+  int    d = 0;
+  int    h = 0;
+  int    m = 0;
+  float  s = 0;
+  char   tz[10];
+
+  // According to https://en.wikipedia.org/wiki/ISO_8601#Times, the following formats have to be supported
+  //
+  // hh:mm:ss.sss or  hhmmss.sss
+  // hh:mm:ss     or  hhmmss
+  // hh:mm        or  hhmm
+  // hh
+  //
+  // With regards the first case (hh:mm:ss.sss or hhmmss.sss) note that by the way sscanf() works for the %f
+  // formater, this will work not only with .000, but also with .0, .00, .0000, etc. This is fine with ISO8601
+  // which states that "There is no limit on the number of decimal places for the decimal fraction".
+
+  // Default timezone is Z, sscanf will override it if an explicit timezone is provided
+  snprintf(tz, sizeof(tz), "%s", "Z");
+
+  bool validDate = ((sscanf(ss, "%4d-%2d-%2dT%2d:%2d:%f%s", &y, &M, &d, &h, &m, &s, tz) >= 6)  ||  // Trying hh:mm:ss.sss or hh:mm:ss
+                    (sscanf(ss, "%4d-%2d-%2dT%2d%2d%f%s", &y, &M, &d, &h, &m, &s, tz) >= 6)    ||  // Trying hhmmss.sss or hhmmss
+                    (sscanf(ss, "%4d-%2d-%2dT%2d:%2d%s", &y, &M, &d, &h, &m, tz) >= 5)         ||  // Trying hh:mm
+                    (sscanf(ss, "%4d-%2d-%2dT%2d%2d%s", &y, &M, &d, &h, &m, tz) >= 5)          ||  // Trying hhmm
+                    (sscanf(ss, "%4d-%2d-%2dT%2d%s", &y, &M, &d, &h, tz) >= 4)                 ||  // Trying hh
+                    (sscanf(ss, "%4d-%2d-%2d%s", &y, &M, &d, tz) == 3));                           // Trying just date (in this case tz is not allowed)
+
+  if (!validDate)
+  {
+    return -1;
+  }
+
+  int offset = timezoneOffset(tz);
+  if (offset == -1)
+  {
+    return -1;
+  }
+
+  // Note that at the present moment we are not doing anything with milliseconds, but
+  // in the future we could use that to increase time resolution (however, not as part
+  // of the tm struct)
+
+  struct tm time;
+  time.tm_year = y - 1900; // Year since 1900
+  time.tm_mon  = M - 1;    // 0-11
+  time.tm_mday = d;        // 1-31
+  time.tm_hour = h;        // 0-23
+  time.tm_min  = m;        // 0-59
+  time.tm_sec  = (int)s;   // 0-61 (0-60 in C++11)
+
+  return (int64_t) (timegm(&time) - offset);
+}
+
+
+
+/* ****************************************************************************
+*
+* digits2 - value of two decimal digits, -1 if they are not digits
+*/
+static inline int digits2(const char* p)
+{
+  if ((p[0] < '0') || (p[0] > '9') || (p[1] < '0') || (p[1] > '9'))
+  {
+    return -1;
+  }
+
+  return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+
+
+/* ****************************************************************************
+*
+* isodateParseFast - parsing of the usual dates, without sscanf
+*
+* The accepted grammar is strict:
+*
+*   YYYY-MM-DD[Thh[:mm[:ss[.s+]]]<tz>] or YYYY-MM-DD[Thh[mm[ss[.s+]]]<tz>]
+*
+* where <tz> is empty, Z, ±hh, ±hhmm or ±hh:mm. The rest of strings are left to
+* isodateParseScanf(), that is also the reference of the results, so it returns
+* false for the cases in which the sscanf formats don't read the string the
+* natural way: Thh±tz and Thhmm±tz (where the sign is read as part of the
+* minutes or the seconds) and months out of 1-12 (normalized by timegm).
+*/
+static bool isodateParseFast(const char* s, int64_t* tP)
+{
+  int  y0  = digits2(&s[0]);
+  int  y1  = digits2(&s[2]);
+  int  M   = digits2(&s[5]);
+  int  d   = digits2(&s[8]);
+  int  h   = 0;
+  int  m   = 0;
+  int  sec = 0;
+
+  if ((y0 == -1) || (y1 == -1) || (s[4] != '-') || (M < 1) || (M > 12) || (s[7] != '-') || (d == -1))
+  {
+    return false;
+  }
+
+  const char*  p      = &s[10];
+  int          offset = 0;
+
+  if (*p == 'T')
+  {
+    bool colons;
+    bool hasMinutes = false;
+    bool hasSeconds = false;
+
+    if ((h = digits2(&p[1])) == -1)
+    {
+      return false;
+    }
+
+    p     += 3;
+    colons = (*p == ':');
+
+    if ((m = digits2(colons? &p[1] : p)) != -1)
+    {
+      p += colons? 3 : 2;
+      hasMinutes = true;
+
+      if ((!colons || (*p == ':')) && ((sec = digits2(colons? &p[1] : p)) != -1))
+      {
+        p += colons? 3 : 2;
+        hasSeconds = true;
+      }
+      else if (colons && (*p == ':'))
+      {
+        return false;
+      }
+    }
+    else if (colons)
+    {
+      return false;
+    }
+    else
+    {
+      m = 0;
+    }
+
+    if (!hasSeconds)
+    {
+      sec = 0;
+    }
+
+    if (hasSeconds && (*p == '.'))
+    {
+      const char* secStart = p - 2;
+
+      if ((p[1] < '0') || (p[1] > '9'))
+      {
+        return false;
+      }
+
+      ++p;
+      while ((*p >= '0') && (*p <= '9'))
+      {
+        ++p;
+      }
+
+      // The same conversion of the %f sscanf format
+      sec = (int) strtof(secStart, NULL);
+    }
+
+    if ((*p == '+') || (*p == '-'))
+    {
+      if (!hasMinutes || (!colons && !hasSeconds))
+      {
+        return false;
+      }
+
+      int sign = (*p == '+')? 1 : -1;
+      int tzH  = digits2(&p[1]);
+      int tzM  = 0;
+
+      if (tzH == -1)
+      {
+        return false;
+      }
+
+      p += 3;
+
+      if (*p == ':')
+      {
+        if ((tzM = digits2(&p[1])) == -1)
+        {
+          return false;
+        }
+
+        p += 3;
+      }
+      else if (*p != 0)
+      {
+        if ((tzM = digits2(p)) == -1)
+        {
+          return false;
+        }
+
+        p += 2;
+      }
+
+      if (*p != 0)
+      {
+        return false;
+      }
+
+      offset = sign * (tzH * 60 * 60 + tzM * 60);
+    }
+    else if ((*p == 'Z') && (p[1] == 0))
+    {
+      ++p;
+    }
+  }
+
+  if (*p != 0)
+  {
+    return false;
+  }
+
+  long long days = daysFromCivil(y0 * 100 + y1, M, 1) + d - 1;
+
+  *tP = (int64_t) (days * 86400 + h * 60 * 60 + m * 60 + sec - offset);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* isodateParse -
+*/
+int64_t isodateParse(const char* s)
+{
+  // Length check, to avoid buffer overflow in tz[]. Calculation is as follows:
+  //
+  //  5 (year with "-") + 3 * 2 (day and month with "-" or "T")
+  //  3 * 3 (hour/minute/second with ":" or ".") + 3 (miliseconds) + 6 (worst case timezone: "+01:00" = 29
+  size_t len = strnlen(s, 30);
+
+  if (len > 29)
+  {
+    return -1;
+  }
+
+  int64_t t;
+
+  if ((len >= 10) && isodateParseFast(s, &t))
+  {
+    return t;
+  }
+
+  return isodateParseScanf(s);
+}
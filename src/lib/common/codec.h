@@ -0,0 +1,123 @@
+#ifndef SRC_LIB_COMMON_CODEC_H_
+#define SRC_LIB_COMMON_CODEC_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdint.h>
+#include <stddef.h>
+
+
+
+/* ****************************************************************************
+*
+* CODEC_DATE_SIZE - room for a date rendered by isodateFormat (including the zero)
+*/
+#define CODEC_DATE_SIZE  80
+
+
+
+/* ****************************************************************************
+*
+* codecInit -
+*
+* With shortestNumbers the non integer numbers are rendered with the shortest
+* representation that parses back to the same double. Otherwise (default) they
+* are rounded to 9 decimals, as '%.9f' does, stripping the trailing zeros.
+*/
+extern void codecInit(bool shortestNumbers);
+
+
+
+/* ****************************************************************************
+*
+* integerFormat - render i in buf, returning the length
+*
+* buf must have room for at least 21 chars.
+*/
+extern int integerFormat(long long i, char* buf);
+
+
+
+/* ****************************************************************************
+*
+* doubleFormat - render f in buf (STRING_SIZE_FOR_DOUBLE), returning the length
+*
+* By default numbers closer than 1e-9 to an integer are rendered as integers and the
+* rest with doubleFormatDecimal9(). In shortest numbers mode (see codecInit()) all of
+* them are rendered with doubleFormatShortest().
+*/
+extern int doubleFormat(double f, char* buf);
+
+
+
+/* ****************************************************************************
+*
+* doubleFormatShortest - shortest round-trip rendering of f (Grisu3)
+*
+* Fixed notation for 1e-6 <= |f| < 1e21, exponent notation (as in '1.5e-7') otherwise.
+*/
+extern int doubleFormatShortest(double f, char* buf);
+
+
+
+/* ****************************************************************************
+*
+* doubleFormatDecimal9 - rendering of f equal to '%.9f' without trailing zeros
+*/
+extern int doubleFormatDecimal9(double f, char* buf);
+
+
+
+/* ****************************************************************************
+*
+* doubleParse - strtod replacement
+*
+* Plain decimal numbers with up to 15 significant digits are converted without strtod.
+* The result (including *endP and errno) is the same as the one of strtod in all cases.
+*/
+extern double doubleParse(const char* s, char** endP);
+
+
+
+/* ****************************************************************************
+*
+* isodateFormat - render a timestamp as ISO8601 UTC date, returning the length
+*
+* The format is the one of "%Y-%m-%dT%H:%M:%S.00Z". buf must have room for
+* CODEC_DATE_SIZE chars. This function is thread safe.
+*/
+extern int isodateFormat(long long timestamp, char* buf);
+
+
+
+/* ****************************************************************************
+*
+* isodateParse - timestamp of an ISO8601 date, -1 if it is not a valid date
+*
+* See parse8601Time() for the accepted formats.
+*/
+extern int64_t isodateParse(const char* s);
+
+#endif  // SRC_LIB_COMMON_CODEC_H_
@@ -66,6 +66,8 @@
 #define ERROR_DESC_BAD_REQUEST_INVALID_RANGE          "ranges only valid for equal and not equal ops"
 #define ERROR_DESC_BAD_REQUEST_INVALID_LIST           "lists only valid for equal and not equal ops"
 #define ERROR_DESC_BAD_REQUEST_PARTIAL_GEOEXPRESSION  "partial geo expression: geometry, georel and coords have to be provided together"
+#define ERROR_DESC_BAD_REQUEST_INVALID_CURSOR        "invalid pagination cursor"
+#define ERROR_DESC_BAD_REQUEST_CURSOR_NOT_ALLOWED    "pagination cursor cannot be used along with offset or orderBy"
 
 #define ERROR_DESC_BAD_REQUEST_INVALID_JTYPE_ENTIDPATTERN     "Invalid JSON type for entity idPattern"
 #define ERROR_DESC_BAD_REQUEST_INVALID_JTYPE_ENTTYPEPATTERN   "Invalid JSON type for entity typePattern"
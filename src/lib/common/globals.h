@@ -130,6 +130,7 @@
 #define OPT_DATE_MODIFIED   DATE_MODIFIED
 #define OPT_NO_ATTR_DETAIL  "noAttrDetail"
 #define OPT_UPSERT          "upsert"
+#define OPT_CURSOR          "cursor"
 
 
 
@@ -23,6 +23,7 @@
 * Author: Ken Zangelin
 */
 #include <string>
+#include <vector>
 
 #include "logMsg/logMsg.h"
 #include "ngsi/ContextElement.h"
@@ -35,205 +36,288 @@
 /* ****************************************************************************
 *
 * attributeValue - return value of attribute as a string
+*
+* String values are returned by reference (no copy), the rest of the types are
+* converted to string in 'scratchP', which is the pointer returned in that case.
 */
-static void attributeValue(std::string* valueP, const std::vector<ContextAttribute*>& vec, const char* attrName)
+static const std::string* attributeValue
+(
+  const std::vector<ContextAttribute*>&  vec,
+  const std::string&                     text,
+  unsigned int                           start,
+  unsigned int                           length,
+  std::string*                           scratchP
+)
 {
   for (unsigned int ix = 0; ix < vec.size(); ++ix)
   {
-    if (vec[ix]->name != attrName)
+    if (vec[ix]->name.compare(0, std::string::npos, text, start, length) != 0)
     {
       continue;
     }
 
     if (vec[ix]->valueType == orion::ValueTypeString)
     {
-      *valueP = vec[ix]->stringValue;
+      return &vec[ix]->stringValue;
     }
     else if (vec[ix]->valueType == orion::ValueTypeNumber)
     {
-      *valueP = double2string(vec[ix]->numberValue);
+      *scratchP = double2string(vec[ix]->numberValue);
     }
     else if (vec[ix]->valueType == orion::ValueTypeBoolean)
     {
-      *valueP = (vec[ix]->boolValue == true)? "true" : "false";
+      *scratchP = (vec[ix]->boolValue == true)? "true" : "false";
     }
     else if (vec[ix]->valueType == orion::ValueTypeNull)
     {
-      *valueP = "null";
+      *scratchP = "null";
     }
     else if (vec[ix]->valueType == orion::ValueTypeNotGiven)
     {
       LM_E(("Runtime Error (value not given for attribute)"));
-      *valueP = "";
+      *scratchP = "";
     }
     else if ((vec[ix]->valueType == orion::ValueTypeObject) || (vec[ix]->valueType == orion::ValueTypeVector))
     {
       if (vec[ix]->compoundValueP)
       {
-        *valueP = vec[ix]->compoundValueP->toJson(true);
+        *scratchP = vec[ix]->compoundValueP->toJson(true);
       }
       else
       {
         LM_E(("Runtime Error (attribute is of object type but has no compound)"));
-        *valueP = "";
+        *scratchP = "";
       }
     }
     else
     {
       LM_E(("Runtime Error (unknown value type for attribute)"));
-      *valueP = "";
+      *scratchP = "";
     }
 
-    return;
+    return scratchP;
   }
 
-  *valueP = "";
+  *scratchP = "";
+  return scratchP;
 }
 
 
 
 /* ****************************************************************************
 *
-* macroSubstitute - 
+* MacroTemplate::MacroTemplate -
+*/
+MacroTemplate::MacroTemplate() : literalSize(0), valid(true), tooLarge(false)
+{
+}
+
+
+
+/* ****************************************************************************
 *
-* An old version of this function was based in char processing. However, we faced
-* weird crashing problems after fixing that implementation to support >1KB payloads.
+* MacroTemplate::MacroTemplate -
+*/
+MacroTemplate::MacroTemplate(const std::string& _text) : literalSize(0), valid(true), tooLarge(false)
+{
+  parse(_text);
+}
+
+
+
+/* ****************************************************************************
 *
-* We didn't know the actual cause of these problems but after changing the implementation
-* to the current one based on std::string, it seems stable. The most probable causes
-* of the problem were:
+* MacroTemplate::parse -
 *
-* 1) The old macroSubstitute() function had some bug managing memory which we weren't able
-*    to find.
-* 2) The old macroSubstitute() function was ok, but the way it managed the memory was in a way
-*    it makes more probable some memory corruption bug in other place, compared with the current
-*    implementation. If this theory is correct, we haven't been able to "raise" the memory corruption
-*    bug with the current implementation.
+* Initial size check: is the string to convert too big?
 *
-* However, the old version is still available at git repository, for the records.
-* It can be found checking out the following commit (the last one before chaning implementation):
-*
-*   commit f8c91bf16e192388824c3786a76b203b83354d13
-*   Date:   Mon Jun 19 16:33:29 2017 +0200
+* If the string to convert is bigger than the maximum allowed buffer size (MAX_DYN_MSG_SIZE),
+* then there is an important probability that the resulting string after substitution is also > MAX_DYN_MSG_SIZE.
+* Such a template is not parsed at all and rendering it always fails.
 *
+* The inconvenience is for buffers that are larger before substitution than they are after substitution.
+* Those buffers aren't let through this check, and end up in an error. We assume that this case is more than rare.
 */
-bool macroSubstitute(std::string* to, const std::string& from, const ContextElement& ce)
+void MacroTemplate::parse(const std::string& _text)
 {
-  // Initial size check: is the string to convert too big?
-  //
-  // If the string to convert is bigger than the maximum allowed buffer size (MAX_DYN_MSG_SIZE),
-  // then there is an important probability that the resulting string after substitution is also > MAX_DYN_MSG_SIZE.
-  //
-  // This check avoids to copy 8MB to later only throw it away and return an error
-  // That is the advantage.
-  //
-  // There is an inconvenience as well.
-  //
-  // The inconvenience is for buffers that are larger before substitution than they are after substitution.
-  // Those buffers aren't let through this check, and end up in an error.
-  //
-  // We assume that this second case is more than rare
-  //
-  if (from.size() > MAX_DYN_MSG_SIZE)
+  text        = _text;
+  literalSize = 0;
+  valid       = true;
+  tooLarge    = false;
+  segments.clear();
+
+  if (text.size() > MAX_DYN_MSG_SIZE)
   {
-    LM_W(("Runtime Error (too large initial string, before substitution)"));
-    *to = "";
-    return false;
+    valid    = false;
+    tooLarge = true;
+    return;
   }
 
-  // Look for macros (using a hash map to count how many times each macro appears)
-  std::map<std::string, unsigned int>  macroNames;  // holds all the positions that each sub occur inside 'from'
-  size_t                               macroStart = from.find("${", 0);
+  size_t  literalStart = 0;
+  size_t  macroStart   = text.find("${", 0);
 
   while (macroStart != std::string::npos)
   {
-    size_t macroEnd = from.find("}", macroStart);
+    size_t macroEnd = text.find("}", macroStart);
 
     if (macroEnd == std::string::npos)
     {
-      LM_W(("Runtime Error (macro end not found, syntax error, aborting substitution)"));
-      *to = "";
-      return false;
+      valid = false;
+      segments.clear();
+      return;
     }
 
-    std::string macroName = from.substr(macroStart + 2, macroEnd - (macroStart + 2));
-    if (macroNames.find(macroName) != macroNames.end())
+    if (macroStart > literalStart)
     {
-      macroNames[macroName]++;
+      MacroSegment literal = { MstLiteral, (unsigned int) literalStart, (unsigned int) (macroStart - literalStart) };
+
+      segments.push_back(literal);
+      literalSize += literal.length;
     }
-    else
+
+    MacroSegment  macro = { MstAttribute, (unsigned int) (macroStart + 2), (unsigned int) (macroEnd - (macroStart + 2)) };
+
+    if (text.compare(macro.start, macro.length, "id") == 0)
+    {
+      macro.type = MstId;
+    }
+    else if (text.compare(macro.start, macro.length, "type") == 0)
     {
-      macroNames[macroName] = 1;
+      macro.type = MstType;
     }
 
-    macroStart = from.find("${", macroEnd + 1);
-  }
+    segments.push_back(macro);
 
-  // Calculate resulting size (if > MAX_DYN_MSG_SIZE, then reject)
-  unsigned long  toReduce = 0;
-  unsigned long  toAdd    = 0;
+    literalStart = macroEnd + 1;
+    macroStart   = text.find("${", literalStart);
+  }
 
-  for (std::map<std::string, unsigned int>::iterator it = macroNames.begin(); it != macroNames.end(); ++it)
+  if (text.size() > literalStart)
   {
-    std::string   macroName = it->first;
-    unsigned int  times     = it->second;
+    MacroSegment literal = { MstLiteral, (unsigned int) literalStart, (unsigned int) (text.size() - literalStart) };
 
-    // The +3 is due to "${" and "}"
-    toReduce += (macroName.length() + 3) * times;
+    segments.push_back(literal);
+    literalSize += literal.length;
+  }
+}
 
-    if (macroName == "id")
-    {
-      toAdd += ce.entityId.id.length() * times;
-    }
-    else if (macroName == "type")
+
+
+/* ****************************************************************************
+*
+* MacroTemplate::render -
+*
+* Each referenced value is looked up once, the final size is calculated from the segment
+* lengths (if > MAX_DYN_MSG_SIZE, then reject) and the result is built in a single pass
+* over a buffer reserved with that size.
+*/
+bool MacroTemplate::render(const ContextElement& ce, std::string* to) const
+{
+  if (valid == false)
+  {
+    if (tooLarge)
     {
-      toAdd += ce.entityId.type.length() * times;
+      LM_W(("Runtime Error (too large initial string, before substitution)"));
     }
     else
     {
-      std::string value;
-
-      attributeValue(&value, ce.contextAttributeVector.vec, macroName.c_str());
-      toAdd += value.length() * times;
+      LM_W(("Runtime Error (macro end not found, syntax error, aborting substitution)"));
     }
-  }
 
-  if (from.length() + toAdd - toReduce > MAX_DYN_MSG_SIZE)
-  {
-    LM_W(("Runtime Error (too large final string, after substitution)"));
     *to = "";
     return false;
   }
 
-  // Macro replace
-  *to = from;
-  for (std::map<std::string, unsigned int>::iterator it = macroNames.begin(); it != macroNames.end(); ++it)
+  // Fast path: no macros at all
+  if ((segments.size() == 1) && (segments[0].type == MstLiteral))
   {
-    std::string macroName = it->first;
-    unsigned int times    = it->second;
+    *to = text;
+    return true;
+  }
 
-    std::string macro = "${" + it->first + "}";
-    std::string value;
+  std::vector<const std::string*>  values(segments.size(), (const std::string*) NULL);
+  std::vector<std::string>         scratch(segments.size());
+  unsigned long                    size = literalSize;
 
-    if (macroName == "id")
+  for (unsigned int ix = 0; ix < segments.size(); ++ix)
+  {
+    const MacroSegment& segment = segments[ix];
+
+    if (segment.type == MstId)
+    {
+      values[ix] = &ce.entityId.id;
+    }
+    else if (segment.type == MstType)
     {
-      value = ce.entityId.id;
+      values[ix] = &ce.entityId.type;
     }
-    else if (macroName == "type")
+    else if (segment.type == MstAttribute)
     {
-      value = ce.entityId.type;
+      values[ix] = attributeValue(ce.contextAttributeVector.vec, text, segment.start, segment.length, &scratch[ix]);
     }
     else
     {
-      attributeValue(&value, ce.contextAttributeVector.vec, macroName.c_str());
+      continue;
     }
 
-    // We have to do the replace operation as many times as macro occurrences
-    for (unsigned int ix = 0; ix < times; ix++)
+    size += values[ix]->length();
+  }
+
+  if (size > MAX_DYN_MSG_SIZE)
+  {
+    LM_W(("Runtime Error (too large final string, after substitution)"));
+    *to = "";
+    return false;
+  }
+
+  to->clear();
+  to->reserve(size);
+
+  for (unsigned int ix = 0; ix < segments.size(); ++ix)
+  {
+    if (segments[ix].type == MstLiteral)
+    {
+      to->append(text, segments[ix].start, segments[ix].length);
+    }
+    else
     {
-      to->replace(to->find(macro), macro.length(), value);
+      to->append(*values[ix]);
     }
   }
 
   return true;
 }
+
+
+
+/* ****************************************************************************
+*
+* macroSubstitute -
+*
+* An old version of this function was based in char processing. However, we faced
+* weird crashing problems after fixing that implementation to support >1KB payloads.
+*
+* We didn't know the actual cause of these problems but after changing the implementation
+* to the current one based on std::string, it seems stable. The most probable causes
+* of the problem were:
+*
+* 1) The old macroSubstitute() function had some bug managing memory which we weren't able
+*    to find.
+* 2) The old macroSubstitute() function was ok, but the way it managed the memory was in a way
+*    it makes more probable some memory corruption bug in other place, compared with the current
+*    implementation. If this theory is correct, we haven't been able to "raise" the memory corruption
+*    bug with the current implementation.
+*
+* However, the old version is still available at git repository, for the records.
+* It can be found checking out the following commit (the last one before chaning implementation):
+*
+*   commit f8c91bf16e192388824c3786a76b203b83354d13
+*   Date:   Mon Jun 19 16:33:29 2017 +0200
+*
+*/
+bool macroSubstitute(std::string* to, const std::string& from, const ContextElement& ce)
+{
+  MacroTemplate  macroTemplate(from);
+
+  return macroTemplate.render(ce, to);
+}
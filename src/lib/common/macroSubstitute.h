@@ -26,6 +26,7 @@
 * Author: Ken Zangelin
 */
 #include <string>
+#include <vector>
 
 #include "ngsi/ContextElement.h"
 
@@ -33,7 +34,69 @@
 
 /* ****************************************************************************
 *
-* macroSubstitute - 
+* MacroSegmentType -
+*/
+typedef enum MacroSegmentType
+{
+  MstLiteral,
+  MstId,
+  MstType,
+  MstAttribute
+} MacroSegmentType;
+
+
+
+/* ****************************************************************************
+*
+* MacroSegment -
+*
+* A piece of a template: either literal text or a ${...} reference. 'start' and
+* 'length' point into MacroTemplate::text (for references, the name between ${ and }).
+*/
+typedef struct MacroSegment
+{
+  MacroSegmentType  type;
+  unsigned int      start;
+  unsigned int      length;
+} MacroSegment;
+
+
+
+/* ****************************************************************************
+*
+* MacroTemplate -
+*
+* A string with ${id}, ${type} and ${attrName} references, parsed once in a list of
+* segments so it can be rendered for each notification in a single pass.
+*
+* A template that failed to parse (too large or with an unterminated macro) is kept
+* with valid == false and render() fails for it, logging the same warning that
+* macroSubstitute() would log.
+*/
+class MacroTemplate
+{
+ public:
+  std::string                text;
+  std::vector<MacroSegment>  segments;
+  unsigned long              literalSize;
+  bool                       valid;
+  bool                       tooLarge;
+
+  MacroTemplate();
+  explicit MacroTemplate(const std::string& _text);
+
+  void  parse(const std::string& _text);
+  bool  render(const ContextElement& ce, std::string* to) const;
+};
+
+
+
+/* ****************************************************************************
+*
+* macroSubstitute -
+*
+* Parses 'in' and renders it at once. For strings that are rendered many times
+* (e.g. custom notifications) use a MacroTemplate instead.
 */
 extern bool macroSubstitute(std::string* sP, const std::string& in, const ContextElement& ce);
 
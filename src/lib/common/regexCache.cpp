@@ -0,0 +1,580 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+#include <pthread.h>
+#include <regex.h>
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <utility>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/regexCache.h"
+
+
+
+/* ****************************************************************************
+*
+* RegexLiteral -
+*
+* Alternative of a pattern made only of literal characters, optionally anchored
+*/
+typedef struct RegexLiteral
+{
+  std::string  literal;
+  bool         anchoredStart;
+  bool         anchoredEnd;
+} RegexLiteral;
+
+
+
+/* ****************************************************************************
+*
+* CachedRegex -
+*
+* Matching uses, in this order:
+*
+*   1. literals:  when the pattern is an alternation of (optionally anchored) literals, e.g.
+*                 "^(E1|E2|E3)$" or "^room_|_old$", regexec() is not used at all. Fully
+*                 anchored alternatives are looked up in a set.
+*   2. prefix:    otherwise, if the pattern starts with "^" followed by some literal
+*                 characters, strings not starting with them are discarded before calling
+*                 regexec()
+*   3. regexec()
+*
+* The expression is always compiled with regcomp(), so the validity of the pattern is the
+* one of POSIX regcomp().
+*/
+struct CachedRegex
+{
+  std::string                pattern;
+  int                        cflags;
+  int                        refs;
+  regex_t                    re;
+
+  bool                       literalOnly;
+  std::vector<RegexLiteral>  literalV;
+  std::set<std::string>      exactS;
+  std::string                prefix;
+};
+
+
+
+typedef std::map<std::pair<std::string, int>, CachedRegex*>  RegexCacheMap;
+
+static RegexCacheMap    regexCache;
+static pthread_mutex_t  regexCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* isMeta -
+*
+* Characters with special meaning in POSIX ERE (plus '}' and ']', to be on the safe side)
+*/
+static bool isMeta(char c)
+{
+  return (strchr(".[]()*+?{}|^$\\", c) != NULL);
+}
+
+
+
+/* ****************************************************************************
+*
+* literalAt -
+*
+* If the character at 's[*ixP]' is a literal (or an escaped special character), it is
+* added to 'litP' and *ixP is advanced. Otherwise, false is returned.
+*/
+static bool literalAt(const std::string& s, unsigned int* ixP, std::string* litP)
+{
+  char c = s[*ixP];
+
+  if (c == '\\')
+  {
+    if ((*ixP + 1 < s.size()) && (isMeta(s[*ixP + 1])))
+    {
+      *litP += s[*ixP + 1];
+      *ixP  += 2;
+      return true;
+    }
+
+    // Other escapes (\w, back-references, ...) are not literals
+    return false;
+  }
+
+  if (isMeta(c))
+  {
+    return false;
+  }
+
+  *litP += c;
+  *ixP  += 1;
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* alternativeSplit -
+*
+* Splits a pattern by the '|' characters not escaped. Returns false if the pattern includes
+* brackets or parenthesis, as then a '|' may not be a top level alternation.
+*/
+static bool alternativeSplit(const std::string& s, std::vector<std::string>* altV)
+{
+  std::string alt;
+
+  for (unsigned int ix = 0; ix < s.size(); ++ix)
+  {
+    char c = s[ix];
+
+    if (c == '\\')
+    {
+      alt += c;
+
+      if (ix + 1 < s.size())
+      {
+        alt += s[++ix];
+      }
+    }
+    else if ((c == '[') || (c == '(') || (c == ')'))
+    {
+      return false;
+    }
+    else if (c == '|')
+    {
+      altV->push_back(alt);
+      alt = "";
+    }
+    else
+    {
+      alt += c;
+    }
+  }
+
+  altV->push_back(alt);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* alternativeParse -
+*
+* Returns false if the alternative is not a non-empty literal (optionally anchored)
+*/
+static bool alternativeParse(const std::string& alt, RegexLiteral* rlP)
+{
+  unsigned int ix = 0;
+
+  rlP->literal       = "";
+  rlP->anchoredStart = false;
+  rlP->anchoredEnd   = false;
+
+  if ((alt.size() > 0) && (alt[0] == '^'))
+  {
+    rlP->anchoredStart = true;
+    ix = 1;
+  }
+
+  while (ix < alt.size())
+  {
+    if ((alt[ix] == '$') && (ix == alt.size() - 1))
+    {
+      rlP->anchoredEnd = true;
+      break;
+    }
+
+    if (!literalAt(alt, &ix, &rlP->literal))
+    {
+      return false;
+    }
+  }
+
+  return !rlP->literal.empty();
+}
+
+
+
+/* ****************************************************************************
+*
+* literalsAnalyze -
+*
+* Supported forms: "^(lit1|lit2|...)$" and "alt1|alt2|..." where each alternative is
+* a literal optionally starting with '^' and/or ending with '$'.
+*/
+static bool literalsAnalyze(const std::string& pattern, std::vector<RegexLiteral>* literalV)
+{
+  std::vector<std::string>  altV;
+  bool                      grouped = false;
+  std::string               p       = pattern;
+
+  if ((p.size() > 4) && (p.compare(0, 2, "^(") == 0) && (p.compare(p.size() - 2, 2, ")$") == 0))
+  {
+    grouped = true;
+    p       = p.substr(2, p.size() - 4);
+  }
+
+  if (!alternativeSplit(p, &altV))
+  {
+    return false;
+  }
+
+  for (unsigned int ix = 0; ix < altV.size(); ++ix)
+  {
+    RegexLiteral rl;
+
+    if (!alternativeParse(altV[ix], &rl))
+    {
+      return false;
+    }
+
+    if (grouped)
+    {
+      if (rl.anchoredStart || rl.anchoredEnd)
+      {
+        return false;
+      }
+
+      rl.anchoredStart = true;
+      rl.anchoredEnd   = true;
+    }
+
+    literalV->push_back(rl);
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* prefixAnalyze -
+*
+* Literal prefix every matching string must start with (empty if none)
+*/
+static std::string prefixAnalyze(const std::string& pattern)
+{
+  std::string   prefix;
+  unsigned int  ix = 1;
+
+  if ((pattern.size() < 2) || (pattern[0] != '^'))
+  {
+    return "";
+  }
+
+  // With an alternation somewhere the prefix could belong just to one of the alternatives
+  for (unsigned int cx = 0; cx < pattern.size(); ++cx)
+  {
+    if (pattern[cx] == '\\')
+    {
+      ++cx;
+    }
+    else if (pattern[cx] == '|')
+    {
+      return "";
+    }
+  }
+
+  while ((ix < pattern.size()) && (literalAt(pattern, &ix, &prefix)))
+  {
+  }
+
+  // The last literal is not required if followed by a quantifier (as "a+*" is allowed,
+  // '+' is not trusted either)
+  if ((ix < pattern.size()) && (!prefix.empty()) && (strchr("*+?{", pattern[ix]) != NULL))
+  {
+    prefix.resize(prefix.size() - 1);
+  }
+
+  return prefix;
+}
+
+
+
+/* ****************************************************************************
+*
+* cachedRegexCreate -
+*/
+static CachedRegex* cachedRegexCreate(const std::string& pattern, int cflags)
+{
+  CachedRegex* crP = new CachedRegex();
+
+  if (regcomp(&crP->re, pattern.c_str(), cflags | REG_NOSUB) != 0)
+  {
+    // If regcomp fails it frees up itself (see glibc sources for details)
+    delete crP;
+    return NULL;
+  }
+
+  crP->pattern     = pattern;
+  crP->cflags      = cflags;
+  crP->refs        = 1;
+  crP->literalOnly = false;
+
+  // regcomp() stops at the first NUL, so does the analysis. Only plain ERE is analyzed,
+  // as flags like REG_ICASE or REG_NEWLINE change the meaning of the literals and anchors
+  if (cflags == REG_EXTENDED)
+  {
+    std::string p(pattern.c_str());
+
+    if (literalsAnalyze(p, &crP->literalV))
+    {
+      crP->literalOnly = true;
+
+      std::vector<RegexLiteral>::iterator it = crP->literalV.begin();
+      while (it != crP->literalV.end())
+      {
+        if (it->anchoredStart && it->anchoredEnd)
+        {
+          crP->exactS.insert(it->literal);
+          it = crP->literalV.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+    else
+    {
+      crP->literalV.clear();
+      crP->prefix = prefixAnalyze(p);
+    }
+  }
+
+  LM_T(LmtRegexCache, ("regex '%s' compiled (literal: %s, prefix: '%s')",
+                       pattern.c_str(),
+                       crP->literalOnly? "yes" : "no",
+                       crP->prefix.c_str()));
+
+  return crP;
+}
+
+
+
+/* ****************************************************************************
+*
+* cachedRegexUnref -
+*/
+static void cachedRegexUnref(CachedRegex* crP)
+{
+  if (__sync_sub_and_fetch(&crP->refs, 1) == 0)
+  {
+    regfree(&crP->re);
+    delete crP;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* regexCacheGet -
+*/
+CachedRegex* regexCacheGet(const std::string& pattern, int cflags)
+{
+  std::pair<std::string, int>  key(pattern, cflags);
+  CachedRegex*                 crP;
+
+  pthread_mutex_lock(&regexCacheMutex);
+
+  RegexCacheMap::iterator it = regexCache.find(key);
+
+  if (it != regexCache.end())
+  {
+    crP = it->second;
+    __sync_fetch_and_add(&crP->refs, 1);
+
+    pthread_mutex_unlock(&regexCacheMutex);
+    return crP;
+  }
+
+  pthread_mutex_unlock(&regexCacheMutex);
+
+  // Compiling outside the mutex, as it may take a while for big patterns
+  if ((crP = cachedRegexCreate(pattern, cflags)) == NULL)
+  {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&regexCacheMutex);
+
+  it = regexCache.find(key);
+  if (it != regexCache.end())
+  {
+    // Some other thread compiled the same pattern in the meanwhile
+    cachedRegexUnref(crP);
+
+    crP = it->second;
+    __sync_fetch_and_add(&crP->refs, 1);
+  }
+  else
+  {
+    if (regexCache.size() >= REGEX_CACHE_MAX_SIZE)
+    {
+      // Free the regular expressions only referenced by the cache. No new reference can
+      // be taken to them while the mutex is held
+      it = regexCache.begin();
+      while (it != regexCache.end())
+      {
+        if (it->second->refs == 1)
+        {
+          cachedRegexUnref(it->second);
+          regexCache.erase(it++);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+
+    if (regexCache.size() < REGEX_CACHE_MAX_SIZE)
+    {
+      __sync_fetch_and_add(&crP->refs, 1);  // the reference of the cache itself
+      regexCache[key] = crP;
+    }
+  }
+
+  pthread_mutex_unlock(&regexCacheMutex);
+
+  return crP;
+}
+
+
+
+/* ****************************************************************************
+*
+* regexCacheRelease -
+*/
+void regexCacheRelease(CachedRegex* crP)
+{
+  if (crP != NULL)
+  {
+    cachedRegexUnref(crP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* regexCacheMatch -
+*/
+bool regexCacheMatch(const CachedRegex* crP, const char* s)
+{
+  if (crP->literalOnly)
+  {
+    size_t len = strlen(s);
+
+    if ((!crP->exactS.empty()) && (crP->exactS.find(s) != crP->exactS.end()))
+    {
+      return true;
+    }
+
+    for (unsigned int ix = 0; ix < crP->literalV.size(); ++ix)
+    {
+      const RegexLiteral*  rlP    = &crP->literalV[ix];
+      size_t               litLen = rlP->literal.size();
+
+      if (rlP->anchoredStart)
+      {
+        if ((len >= litLen) && (strncmp(s, rlP->literal.c_str(), litLen) == 0))
+        {
+          return true;
+        }
+      }
+      else if (rlP->anchoredEnd)
+      {
+        if ((len >= litLen) && (strcmp(s + len - litLen, rlP->literal.c_str()) == 0))
+        {
+          return true;
+        }
+      }
+      else if (strstr(s, rlP->literal.c_str()) != NULL)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  if ((!crP->prefix.empty()) && (strncmp(s, crP->prefix.c_str(), crP->prefix.size()) != 0))
+  {
+    return false;
+  }
+
+  return (regexec(&crP->re, s, 0, NULL, 0) == 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* regexCacheValid -
+*/
+bool regexCacheValid(const std::string& pattern, int cflags)
+{
+  CachedRegex* crP = regexCacheGet(pattern, cflags);
+
+  if (crP == NULL)
+  {
+    return false;
+  }
+
+  regexCacheRelease(crP);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* regexCacheSize -
+*/
+unsigned int regexCacheSize(void)
+{
+  pthread_mutex_lock(&regexCacheMutex);
+
+  unsigned int size = regexCache.size();
+
+  pthread_mutex_unlock(&regexCacheMutex);
+
+  return size;
+}
@@ -0,0 +1,106 @@
+#ifndef SRC_LIB_COMMON_REGEXCACHE_H_
+#define SRC_LIB_COMMON_REGEXCACHE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <regex.h>
+
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* REGEX_CACHE_MAX_SIZE -
+*
+* Bound for the number of compiled regular expressions kept in the cache. Once reached,
+* the ones not in use are freed and, if that is not enough, new regular expressions are
+* handed out without being cached.
+*/
+#define REGEX_CACHE_MAX_SIZE  1000
+
+
+
+/* ****************************************************************************
+*
+* CachedRegex -
+*
+* Opaque reference-counted compiled regular expression
+*/
+struct CachedRegex;
+
+
+
+/* ****************************************************************************
+*
+* regexCacheGet -
+*
+* Returns the compiled regular expression for the given pattern and regcomp() flags,
+* compiling it only if it is not already in the cache. NULL is returned if the pattern
+* is not a valid regular expression.
+*
+* Each non-NULL value returned must be released with regexCacheRelease().
+*/
+extern CachedRegex* regexCacheGet(const std::string& pattern, int cflags = REG_EXTENDED);
+
+
+
+/* ****************************************************************************
+*
+* regexCacheRelease -
+*/
+extern void regexCacheRelease(CachedRegex* crP);
+
+
+
+/* ****************************************************************************
+*
+* regexCacheMatch -
+*
+* Equivalent to 'regexec(re, s, 0, NULL, 0) == 0' on the regular expression compiled
+* with regcomp().
+*/
+extern bool regexCacheMatch(const CachedRegex* crP, const char* s);
+
+
+
+/* ****************************************************************************
+*
+* regexCacheValid -
+*
+* Checks if a pattern is a valid regular expression (the compiled expression is kept in
+* the cache, as it is usually going to be used soon after being checked).
+*/
+extern bool regexCacheValid(const std::string& pattern, int cflags = REG_EXTENDED);
+
+
+
+/* ****************************************************************************
+*
+* regexCacheSize -
+*/
+extern unsigned int regexCacheSize(void);
+
+#endif  // SRC_LIB_COMMON_REGEXCACHE_H_
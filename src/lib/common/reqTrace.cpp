@@ -0,0 +1,377 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <semaphore.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "common/JsonHelper.h"
+#include "common/LatencyHistogram.h"
+#include "common/reqTrace.h"
+
+
+
+/* ****************************************************************************
+*
+* reqTrace -
+*/
+__thread ReqTrace  reqTrace;
+
+
+
+/* ****************************************************************************
+*
+* RouteLatency -
+*/
+typedef struct RouteLatency
+{
+  LatencyHistogram  phase[RtpPhases];
+  LatencyHistogram  total;
+} RouteLatency;
+
+
+
+/* ****************************************************************************
+*
+* phaseName -
+*/
+static const char* phaseName[RtpPhases] =
+{
+  "queueWait",
+  "reqSemWait",
+  "parse",
+  "mongo",
+  "subMatch",
+  "notifEnqueue",
+  "render"
+};
+
+
+
+static bool                                  tracing          = false;
+static bool                                  useHistograms    = false;
+static long long                             slowThresholdUs  = 0;
+static std::map<std::string, RouteLatency*>  routeLatency;
+static sem_t                                 routeLatencySem;
+
+
+
+/* ****************************************************************************
+*
+* usDiff -
+*/
+static long long usDiff(const struct timespec* end, const struct timespec* start)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000LL + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceInit -
+*/
+void reqTraceInit(unsigned int slowThreshold, bool histograms)
+{
+  if (sem_init(&routeLatencySem, 0, 1) == -1)
+  {
+    LM_X(1, ("Fatal Error (error initializing request trace semaphore: %s)", strerror(errno)));
+  }
+
+  slowThresholdUs = slowThreshold * 1000LL;
+  useHistograms   = histograms;
+  tracing         = (slowThreshold != 0) || histograms;
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceHistogramsActive -
+*/
+bool reqTraceHistogramsActive(void)
+{
+  return useHistograms;
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceStart -
+*/
+void reqTraceStart(void)
+{
+  reqTrace.active = tracing;
+
+  if (!tracing)
+  {
+    return;
+  }
+
+  clock_gettime(CLOCK_REALTIME, &reqTrace.start);
+
+  reqTrace.route[0]     = 0;
+  reqTrace.spans        = 0;
+  reqTrace.droppedSpans = 0;
+  memset(reqTrace.phaseUs, 0, sizeof(reqTrace.phaseUs));
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceRouteSet -
+*/
+void reqTraceRouteSet(const std::string& route)
+{
+  if (reqTrace.active)
+  {
+    snprintf(reqTrace.route, sizeof(reqTrace.route), "%s", route.c_str());
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceSpanAdd -
+*/
+void reqTraceSpanAdd
+(
+  ReqTracePhase           phase,
+  const char*             what,
+  const struct timespec*  start,
+  const struct timespec*  end
+)
+{
+  if (!reqTrace.active)
+  {
+    return;
+  }
+
+  struct timespec  now;
+
+  if (end == NULL)
+  {
+    clock_gettime(CLOCK_REALTIME, &now);
+    end = &now;
+  }
+
+  long long duration = usDiff(end, start);
+
+  reqTrace.phaseUs[phase] += duration;
+
+  if (reqTrace.spans < REQ_TRACE_MAX_SPANS)
+  {
+    ReqTraceSpan* spanP = &reqTrace.span[reqTrace.spans];
+
+    spanP->phase      = phase;
+    spanP->what       = what;
+    spanP->startUs    = usDiff(start, &reqTrace.start);
+    spanP->durationUs = duration;
+
+    ++reqTrace.spans;
+  }
+  else
+  {
+    ++reqTrace.droppedSpans;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* routeLatencyGet -
+*/
+static RouteLatency* routeLatencyGet(const char* route)
+{
+  RouteLatency* rlP;
+
+  sem_wait(&routeLatencySem);
+
+  std::map<std::string, RouteLatency*>::iterator it = routeLatency.find(route);
+
+  if (it != routeLatency.end())
+  {
+    rlP = it->second;
+  }
+  else
+  {
+    rlP = new RouteLatency();
+    routeLatency[route] = rlP;
+  }
+
+  sem_post(&routeLatencySem);
+
+  return rlP;
+}
+
+
+
+/* ****************************************************************************
+*
+* slowRequestLog -
+*/
+static void slowRequestLog(long long totalUs, int statusCode)
+{
+  std::string  breakdown;
+  char         buf[128];
+
+  for (int ix = 0; ix < RtpPhases; ++ix)
+  {
+    snprintf(buf, sizeof(buf), "%s%s=%lldus", (ix == 0)? "" : ", ", phaseName[ix], reqTrace.phaseUs[ix]);
+    breakdown += buf;
+  }
+
+  breakdown += " - spans:";
+
+  for (int ix = 0; ix < reqTrace.spans; ++ix)
+  {
+    const ReqTraceSpan* spanP = &reqTrace.span[ix];
+
+    snprintf(buf, sizeof(buf), " [%s/%s at %lldus: %lldus]", phaseName[spanP->phase], spanP->what, spanP->startUs, spanP->durationUs);
+    breakdown += buf;
+  }
+
+  if (reqTrace.droppedSpans != 0)
+  {
+    snprintf(buf, sizeof(buf), " (%d more spans not kept)", reqTrace.droppedSpans);
+    breakdown += buf;
+  }
+
+  LM_W(("Slow request (transaction: %s, route: '%s', status: %d, time: %lldus): %s",
+        transactionId,
+        (reqTrace.route[0] != 0)? reqTrace.route : "unknown",
+        statusCode,
+        totalUs,
+        breakdown.c_str()));
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceEnd -
+*/
+void reqTraceEnd(int statusCode)
+{
+  if (!reqTrace.active)
+  {
+    return;
+  }
+
+  struct timespec  now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  long long totalUs = usDiff(&now, &reqTrace.start);
+
+  if (useHistograms && (reqTrace.route[0] != 0))
+  {
+    RouteLatency* rlP = routeLatencyGet(reqTrace.route);
+
+    rlP->total.record(totalUs);
+
+    for (int ix = 0; ix < RtpPhases; ++ix)
+    {
+      if (reqTrace.phaseUs[ix] != 0)
+      {
+        rlP->phase[ix].record(reqTrace.phaseUs[ix]);
+      }
+    }
+  }
+
+  if ((slowThresholdUs != 0) && (totalUs >= slowThresholdUs))
+  {
+    slowRequestLog(totalUs, statusCode);
+  }
+
+  reqTrace.active = false;
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceHistogramsToJson -
+*
+* All the values are in microseconds
+*/
+std::string reqTraceHistogramsToJson(void)
+{
+  JsonHelper  top;
+
+  sem_wait(&routeLatencySem);
+
+  for (std::map<std::string, RouteLatency*>::iterator it = routeLatency.begin(); it != routeLatency.end(); ++it)
+  {
+    JsonHelper     jh;
+    RouteLatency*  rlP = it->second;
+
+    jh.addRaw("total", rlP->total.toJson());
+
+    for (int ix = 0; ix < RtpPhases; ++ix)
+    {
+      if (rlP->phase[ix].count() != 0)
+      {
+        jh.addRaw(phaseName[ix], rlP->phase[ix].toJson());
+      }
+    }
+
+    top.addRaw(it->first, jh.str());
+  }
+
+  sem_post(&routeLatencySem);
+
+  return top.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* reqTraceHistogramsReset -
+*/
+void reqTraceHistogramsReset(void)
+{
+  sem_wait(&routeLatencySem);
+
+  for (std::map<std::string, RouteLatency*>::iterator it = routeLatency.begin(); it != routeLatency.end(); ++it)
+  {
+    it->second->total.reset();
+
+    for (int ix = 0; ix < RtpPhases; ++ix)
+    {
+      it->second->phase[ix].reset();
+    }
+  }
+
+  sem_post(&routeLatencySem);
+}
@@ -0,0 +1,205 @@
+#ifndef SRC_LIB_COMMON_REQTRACE_H_
+#define SRC_LIB_COMMON_REQTRACE_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <time.h>
+
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* ReqTracePhase -
+*/
+typedef enum ReqTracePhase
+{
+  RtpQueueWait = 0,
+  RtpReqSemWait,
+  RtpParse,
+  RtpMongo,
+  RtpSubMatch,
+  RtpNotifEnqueue,
+  RtpRender,
+  RtpPhases
+} ReqTracePhase;
+
+
+
+/* ****************************************************************************
+*
+* REQ_TRACE_MAX_SPANS -
+*
+* Spans beyond this number are not kept (but their time is still accounted in the
+* phase totals)
+*/
+#define REQ_TRACE_MAX_SPANS  32
+
+
+
+/* ****************************************************************************
+*
+* ReqTraceSpan -
+*/
+typedef struct ReqTraceSpan
+{
+  ReqTracePhase  phase;
+  const char*    what;
+  long long      startUs;      // relative to the request start
+  long long      durationUs;
+} ReqTraceSpan;
+
+
+
+/* ****************************************************************************
+*
+* ReqTrace -
+*
+* Fixed-size per request structure, in a thread variable. When the MHD threads are shared by
+* many connections, it is kept in the ConnectionInfo of the request between the calls of MHD
+* (see rest/requestContext.h)
+*/
+typedef struct ReqTrace
+{
+  bool             active;
+  struct timespec  start;
+  char             route[128];
+  int              spans;
+  int              droppedSpans;
+  ReqTraceSpan     span[REQ_TRACE_MAX_SPANS];
+  long long        phaseUs[RtpPhases];
+} ReqTrace;
+
+extern __thread ReqTrace  reqTrace;
+
+
+
+/* ****************************************************************************
+*
+* REQ_TRACE_SPAN_START -
+*/
+#define REQ_TRACE_SPAN_START(name)                                     \
+  struct timespec name;                                                \
+                                                                       \
+  if (reqTrace.active)                                                 \
+  {                                                                    \
+    clock_gettime(CLOCK_REALTIME, &name);                              \
+  }
+
+
+
+/* ****************************************************************************
+*
+* REQ_TRACE_SPAN_STOP -
+*/
+#define REQ_TRACE_SPAN_STOP(name, phase, what)                         \
+  if (reqTrace.active)                                                 \
+  {                                                                    \
+    reqTraceSpanAdd(phase, what, &name, NULL);                         \
+  }
+
+
+
+/* ****************************************************************************
+*
+* reqTraceInit -
+*
+* Tracing is active if slowThreshold (in milliseconds) is not zero or histograms are used
+*/
+extern void reqTraceInit(unsigned int slowThreshold, bool histograms);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceHistogramsActive -
+*/
+extern bool reqTraceHistogramsActive(void);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceStart -
+*
+* To be called when a new request is received
+*/
+extern void reqTraceStart(void);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceRouteSet -
+*
+* Sets the route (method and URL path pattern) used to classify the request in the histograms
+*/
+extern void reqTraceRouteSet(const std::string& route);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceSpanAdd -
+*
+* If end is NULL, the current time is used
+*/
+extern void reqTraceSpanAdd
+(
+  ReqTracePhase           phase,
+  const char*             what,
+  const struct timespec*  start,
+  const struct timespec*  end
+);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceEnd -
+*
+* To be called when the request is completed. The phases feed the latency histograms of
+* the route and, if the request took longer than the threshold, the full breakdown is logged.
+*/
+extern void reqTraceEnd(int statusCode);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceHistogramsToJson -
+*/
+extern std::string reqTraceHistogramsToJson(void);
+
+
+
+/* ****************************************************************************
+*
+* reqTraceHistogramsReset -
+*/
+extern void reqTraceHistogramsReset(void);
+
+#endif  // SRC_LIB_COMMON_REQTRACE_H_
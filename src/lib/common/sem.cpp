@@ -32,6 +32,7 @@
 
 #include "common/sem.h"
 #include "common/clockFunctions.h"
+#include "common/reqTrace.h"
 
 
 
@@ -150,19 +151,24 @@ int reqSemTake(const char* who, const char* what, SemOpType reqType, bool* taken
   struct timespec endTime;
   struct timespec diffTime;
 
-  if (semWaitStatistics)
+  if (semWaitStatistics || reqTrace.active)
   {
     clock_gettime(CLOCK_REALTIME, &startTime);
   }
 
   r = sem_wait(&reqSem);
 
-  if (semWaitStatistics)
+  if (semWaitStatistics || reqTrace.active)
   {
     clock_gettime(CLOCK_REALTIME, &endTime);
 
-    clock_difftime(&endTime, &startTime, &diffTime);
-    clock_addtime(&accReqSemTime, &diffTime);
+    if (semWaitStatistics)
+    {
+      clock_difftime(&endTime, &startTime, &diffTime);
+      clock_addtime(&accReqSemTime, &diffTime);
+    }
+
+    reqTraceSpanAdd(RtpReqSemWait, "reqSem", &startTime, &endTime);
   }
 
   LM_T(LmtReqSem, ("%s has the 'req' semaphore", who));
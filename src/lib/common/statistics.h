@@ -28,6 +28,7 @@
 #include "ngsi/Request.h"
 #include "common/MimeType.h"
 #include "common/clockFunctions.h"
+#include "common/reqTrace.h"
 
 
 
@@ -39,7 +40,7 @@
   struct timespec renderStart;                                         \
   struct timespec renderEnd;                                           \
                                                                        \
-  if (timingStatistics)                                               \
+  if (timingStatistics || reqTrace.active)                             \
   {                                                                    \
     clock_gettime(CLOCK_REALTIME, &renderStart);                       \
   }
@@ -51,12 +52,18 @@
 * TIME_STAT_RENDER_STOP - 
 */
 #define TIME_STAT_RENDER_STOP()                                                   \
-  if (timingStatistics)                                                           \
+  if (timingStatistics || reqTrace.active)                                        \
   {                                                                               \
     struct timespec diff;                                                         \
     clock_gettime(CLOCK_REALTIME, &renderEnd);                                    \
-    clock_difftime(&renderEnd, &renderStart, &diff);                              \
-    clock_addtime(&threadLastTimeStat.renderTime, &diff);                         \
+                                                                                  \
+    if (timingStatistics)                                                         \
+    {                                                                             \
+      clock_difftime(&renderEnd, &renderStart, &diff);                            \
+      clock_addtime(&threadLastTimeStat.renderTime, &diff);                       \
+    }                                                                             \
+                                                                                  \
+    reqTraceSpanAdd(RtpRender, "render", &renderStart, &renderEnd);               \
   }
 
 
@@ -125,7 +132,7 @@
   struct timespec mongoReadWaitStart;                                         \
   struct timespec mongoReadWaitEnd;                                           \
                                                                               \
-  if (timingStatistics)                                                       \
+  if (timingStatistics || reqTrace.active)                                    \
   {                                                                           \
     clock_gettime(CLOCK_REALTIME, &mongoReadWaitStart);                       \
   }
@@ -136,13 +143,19 @@
 *
 * TIME_STAT_MONGO_READ_WAIT_STOP - 
 */
-#define TIME_STAT_MONGO_READ_WAIT_STOP()                                \
-  if (timingStatistics)                                                 \
-  {                                                                     \
-    struct timespec diff;                                               \
-    clock_gettime(CLOCK_REALTIME, &mongoReadWaitEnd);                   \
-    clock_difftime(&mongoReadWaitEnd, &mongoReadWaitStart, &diff);      \
-    clock_addtime(&threadLastTimeStat.mongoReadWaitTime, &diff);        \
+#define TIME_STAT_MONGO_READ_WAIT_STOP()                                        \
+  if (timingStatistics || reqTrace.active)                                      \
+  {                                                                             \
+    struct timespec diff;                                                       \
+    clock_gettime(CLOCK_REALTIME, &mongoReadWaitEnd);                           \
+                                                                                \
+    if (timingStatistics)                                                       \
+    {                                                                           \
+      clock_difftime(&mongoReadWaitEnd, &mongoReadWaitStart, &diff);            \
+      clock_addtime(&threadLastTimeStat.mongoReadWaitTime, &diff);              \
+    }                                                                           \
+                                                                                \
+    reqTraceSpanAdd(RtpMongo, "read", &mongoReadWaitStart, &mongoReadWaitEnd);  \
   }
 
 
@@ -155,7 +168,7 @@
   struct timespec mongoWriteWaitStart;                                         \
   struct timespec mongoWriteWaitEnd;                                           \
                                                                                \
-  if (timingStatistics)                                                        \
+  if (timingStatistics || reqTrace.active)                                     \
   {                                                                            \
     clock_gettime(CLOCK_REALTIME, &mongoWriteWaitStart);                       \
   }
@@ -166,13 +179,19 @@
 *
 * TIME_STAT_MONGO_WRITE_WAIT_STOP - 
 */
-#define TIME_STAT_MONGO_WRITE_WAIT_STOP()                             \
-  if (timingStatistics)                                               \
-  {                                                                   \
-    struct timespec diff;                                             \
-    clock_gettime(CLOCK_REALTIME, &mongoWriteWaitEnd);                \
-    clock_difftime(&mongoWriteWaitEnd, &mongoWriteWaitStart, &diff);  \
-    clock_addtime(&threadLastTimeStat.mongoWriteWaitTime, &diff);     \
+#define TIME_STAT_MONGO_WRITE_WAIT_STOP()                                          \
+  if (timingStatistics || reqTrace.active)                                         \
+  {                                                                                \
+    struct timespec diff;                                                          \
+    clock_gettime(CLOCK_REALTIME, &mongoWriteWaitEnd);                             \
+                                                                                   \
+    if (timingStatistics)                                                          \
+    {                                                                              \
+      clock_difftime(&mongoWriteWaitEnd, &mongoWriteWaitStart, &diff);             \
+      clock_addtime(&threadLastTimeStat.mongoWriteWaitTime, &diff);                \
+    }                                                                              \
+                                                                                   \
+    reqTraceSpanAdd(RtpMongo, "write", &mongoWriteWaitStart, &mongoWriteWaitEnd);  \
   }
 
 
@@ -185,7 +204,7 @@
   struct timespec mongoCommandWaitStart;                                         \
   struct timespec mongoCommandWaitEnd;                                           \
                                                                                  \
-  if (timingStatistics)                                                          \
+  if (timingStatistics || reqTrace.active)                                       \
   {                                                                              \
     clock_gettime(CLOCK_REALTIME, &mongoCommandWaitStart);                       \
   }
@@ -196,13 +215,19 @@
 *
 * TIME_STAT_MONGO_COMMAND_WAIT_STOP - 
 */
-#define TIME_STAT_MONGO_COMMAND_WAIT_STOP()                              \
-  if (timingStatistics)                                                  \
-  {                                                                      \
-    struct timespec diff;                                                \
-    clock_gettime(CLOCK_REALTIME, &mongoCommandWaitEnd);                 \
-    clock_difftime(&mongoCommandWaitEnd, &mongoCommandWaitStart, &diff); \
-    clock_addtime(&threadLastTimeStat.mongoCommandWaitTime, &diff);      \
+#define TIME_STAT_MONGO_COMMAND_WAIT_STOP()                                              \
+  if (timingStatistics || reqTrace.active)                                               \
+  {                                                                                      \
+    struct timespec diff;                                                                \
+    clock_gettime(CLOCK_REALTIME, &mongoCommandWaitEnd);                                 \
+                                                                                         \
+    if (timingStatistics)                                                                \
+    {                                                                                    \
+      clock_difftime(&mongoCommandWaitEnd, &mongoCommandWaitStart, &diff);               \
+      clock_addtime(&threadLastTimeStat.mongoCommandWaitTime, &diff);                    \
+    }                                                                                    \
+                                                                                         \
+    reqTraceSpanAdd(RtpMongo, "command", &mongoCommandWaitStart, &mongoCommandWaitEnd);  \
   }
 
 
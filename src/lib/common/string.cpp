@@ -35,6 +35,8 @@
 #include "common/string.h"
 #include "common/wsStrip.h"
 #include "common/limits.h"
+#include "common/charScan.h"
+#include "common/codec.h"
 #include "alarmMgr/alarmMgr.h"
 
 
@@ -49,6 +51,33 @@
 
 
 
+/* ****************************************************************************
+*
+* invertedClass - the class of the chars not in the given ones
+*/
+static CharClass invertedClass(const char* chars)
+{
+  CharClass cc(chars);
+
+  cc.invert();
+
+  return cc;
+}
+
+
+
+/* ****************************************************************************
+*
+* Character classes -
+*
+* notWsClass:           chars other than the whitespace accepted by onlyWs()
+* notServicePathClass:  chars not allowed in service paths
+*/
+static const CharClass  notWsClass          = invertedClass(" \t\n");
+static const CharClass  notServicePathClass = invertedClass("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_/");
+
+
+
 /* ****************************************************************************
 *
 * checkGroupIPv6 -
@@ -525,22 +554,9 @@ std::string parsedUptime(int uptime)
 */
 bool onlyWs(const char* s)
 {
-  if (*s == 0)
-  {
-    return true;
-  }
-
-  while (*s != 0)
-  {
-    if ((*s != ' ') && (*s != '\t') && (*s != '\n'))
-    {
-      return false;
-    }
+  size_t len = strlen(s);
 
-    ++s;
-  }
-
-  return true;
+  return charClassFind(notWsClass, s, len) == len;
 }
 
 
@@ -744,7 +760,7 @@ double atoF(const char* string, std::string* errorMsg)
     return 0.0;
   }
 
-  return atof(string);
+  return doubleParse(string, NULL);
 }
 
 
@@ -831,27 +847,15 @@ std::string servicePathCheck(const char* servicePath)
   //
   // A service-path contains only alphanumeric characters, plus underscore
   //
-  while (*servicePath != 0)
-  {
-    if ((*servicePath >= 'A') && (*servicePath <= 'Z'))
-      ;
-    else if ((*servicePath >= 'a') && (*servicePath <= 'z'))
-      ;
-    else if ((*servicePath >= '0') && (*servicePath <= '9'))
-      ;
-    else if (*servicePath == '_')
-      ;
-    else if (*servicePath == '/')
-      ;
-    else
-    {
-      std::string details = std::string("Invalid character '") + *servicePath + "' in Service-Path";
-      alarmMgr.badInput(clientIp, details);
+  size_t len = strlen(servicePath);
+  size_t ix  = charClassFind(notServicePathClass, servicePath, len);
 
-      return "Bad Character in Service-Path";
-    }
+  if (ix < len)
+  {
+    std::string details = std::string("Invalid character '") + servicePath[ix] + "' in Service-Path";
+    alarmMgr.badInput(clientIp, details);
 
-    ++servicePath;
+    return "Bad Character in Service-Path";
   }
 
   return "OK";
@@ -888,6 +892,9 @@ std::string servicePathCheck(const char* servicePath)
 * This in turn will make a 'HUGE_VAL double' 12e999999 (is that enough? :-)) be treated as an error.
 * It IS a double, but this function will say it is not, as it actually is not a valid double for
 * this computer as the computer cannot represent it as the C builtin type 'double' ... OK!
+*
+* doubleParse() is used instead of strtod, with the very same results (it is just faster
+* for the usual numbers).
 */
 bool str2double(const char* s, double* dP)
 {
@@ -895,7 +902,7 @@ bool str2double(const char* s, double* dP)
   double  d;
 
   errno = 0;
-  d = strtod(s, &rest);
+  d = doubleParse(s, &rest);
 
   if ((rest == NULL) || (errno == ERANGE))
   {
@@ -927,67 +934,30 @@ bool str2double(const char* s, double* dP)
 *
 * double2string
 *
+* See doubleFormat() for the details about the rendering.
 */
 std::string double2string(double f)
 {
   char  buf[STRING_SIZE_FOR_DOUBLE];
-  int bufSize = sizeof(buf);
-
-  long long  intPart   = (long long) f;
-  double     diff      = f - intPart;
-  bool       isInteger = false;
-
-  // abs value for 'diff'
-  diff = (diff < 0)? -diff : diff;
-
-  if (diff > 0.9999999998)
-  {
-    intPart += 1;
-    isInteger = true;
-  }
-  else if (diff < 0.000000001)  // it is considered an integer
-  {
-    isInteger = true;
-  }
-
-  if (isInteger)
-  {
-    snprintf(buf, bufSize, "%lld", intPart);
-  }
-  else
-  {
-    snprintf(buf, bufSize, "%.9f", f);
-
-    // Clear out any unwanted trailing zeroes
-    char* last = &buf[strlen(buf) - 1];
+  int   len = doubleFormat(f, buf);
 
-    while ((*last == '0') && (last != buf))
-    {
-      *last = 0;
-      --last;
-    }
-  }
-
-  return std::string(buf);
+  return std::string(buf, len);
 }
 
 
+
 /*****************************************************************************
 *
 * isodate2str -
 *
-* FIXME P6: change implementation to use gmtime_r
-*
+* Date pattern: 1970-04-26T17:46:40.00Z
 */
 std::string isodate2str(long long timestamp)
 {
-  // 80 bytes is enough to store any ISO8601 string safely
-  // We use gmtime() to get UTC strings, otherwise we would use localtime()
-  // Date pattern: 1970-04-26T17:46:40.00Z
-  char   buffer[80];
-  time_t rawtime = (time_t) timestamp;
-  strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S.00Z", gmtime(&rawtime));
-  return std::string(buffer);
+  char  buffer[CODEC_DATE_SIZE];
+  int   len = isodateFormat(timestamp, buffer);
+
+  return std::string(buffer, len);
 }
 
 
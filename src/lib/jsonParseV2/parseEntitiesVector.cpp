@@ -22,8 +22,6 @@
 *
 * Author: Orion dev team
 */
-#include <regex.h>
-
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -37,6 +35,7 @@
 #include "parse/forbiddenChars.h"
 #include "apiTypesV2/EntID.h"
 #include "common/errorMessages.h"
+#include "common/regexCache.h"
 #include "jsonParseV2/utilsParse.h"
 #include "jsonParseV2/parseEntitiesVector.h"
 
@@ -139,14 +138,12 @@ bool parseEntitiesVector
 
         idPattern = idPatOpt.value;
 
-        // FIXME P5: Keep the regex and propagate to sub-cache
-        regex_t re;
-        if (regcomp(&re, idPattern.c_str(), REG_EXTENDED) != 0)
+        // The compiled regex is kept in the regex cache, to be reused by the sub-cache
+        if (!regexCacheValid(idPattern))
         {
           *errorStringP = ERROR_DESC_BAD_REQUEST_INVALID_REGEX_ENTIDPATTERN;
           return false;
         }
-        regfree(&re);  // If regcomp fails it frees up itself
       }
     }
 
@@ -197,14 +194,12 @@ bool parseEntitiesVector
 
         typePattern = typePatOpt.value;
 
-        // FIXME P5: Keep the regex and propagate to sub-cache
-        regex_t re;
-        if (regcomp(&re, typePattern.c_str(), REG_EXTENDED) != 0)
+        // The compiled regex is kept in the regex cache, to be reused by the sub-cache
+        if (!regexCacheValid(typePattern))
         {
           *errorStringP = ERROR_DESC_BAD_REQUEST_INVALID_REGEX_ENTTYPEPATTERN;
           return false;
         }
-        regfree(&re);  // If regcomp fails it frees up itself
       }
     }
 
@@ -27,6 +27,7 @@
 #include "rapidjson/document.h"
 
 #include "common/errorMessages.h"
+#include "common/regexCache.h"
 #include "rest/ConnectionInfo.h"
 #include "ngsi/ParseData.h"
 #include "ngsi/Request.h"
@@ -93,12 +94,10 @@ std::string parseEntityObject
         return ERROR_DESC_BAD_REQUEST_INVALID_JTYPE_ENTIDPATTERN;
       }
 
-      regex_t re;
-      if (regcomp(&re, iter->value.GetString(), REG_EXTENDED) != 0)
+      if (!regexCacheValid(iter->value.GetString()))
       {
         return ERROR_DESC_BAD_REQUEST_INVALID_REGEX_ENTIDPATTERN;
       }
-      regfree(&re);  // If regcomp fails it frees up itself (see glibc sources for details)
 
       eP->id        = iter->value.GetString();
       eP->isPattern = "true";
@@ -130,12 +129,10 @@ std::string parseEntityObject
         return ERROR_DESC_BAD_REQUEST_INVALID_JTYPE_ENTTYPEPATTERN;
       }
 
-      regex_t re;
-      if (regcomp(&re, iter->value.GetString(), REG_EXTENDED) != 0)
+      if (!regexCacheValid(iter->value.GetString()))
       {
         return ERROR_DESC_BAD_REQUEST_INVALID_REGEX_ENTTYPEPATTERN;
       }
-      regfree(&re);  // If regcomp fails it frees up itself (see glibc sources for details)
 
       eP->type          = iter->value.GetString();
       eP->isTypePattern = true;
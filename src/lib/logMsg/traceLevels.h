@@ -120,6 +120,10 @@ typedef enum TraceLevels
   LmtSubCache = 210,
   LmtSubCacheMatch,
   LmtCacheSync,
+  LmtEntityCache,
+  LmtRegCache,
+  LmtRegexCache,
+  LmtCasubCache,
 
   /* Others (>=230) */
   LmtCm = 230,
@@ -127,6 +131,7 @@ typedef enum TraceLevels
   LmtSoftError,
   LmtNotImplemented,
   LmtCurlContext,
+  LmtCharScan,
 
   LmtBug = 250
 } TraceLevels;
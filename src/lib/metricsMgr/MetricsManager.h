@@ -54,6 +54,8 @@
 #define METRIC_TRANS_IN_ERRORS                     "incomingTransactionErrors"
 #define METRIC_SERVICE_TIME                        "serviceTime"
 #define _METRIC_TOTAL_SERVICE_TIME                 "_totalServiceTime"
+#define METRIC_RATE_LIMIT_ACCEPTED                 "rateLimitAccepted"
+#define METRIC_RATE_LIMIT_REJECTED                 "rateLimitRejected"
 
 #define METRIC_TRANS_OUT                           "outgoingTransactions"
 #define METRIC_TRANS_OUT_REQ_SIZE                  "outgoingTransactionRequestSize"
@@ -38,6 +38,8 @@
 #include "common/RenderFormat.h"
 #include "common/defaultValues.h"
 #include "alarmMgr/alarmMgr.h"
+#include "cache/regCache.h"
+#include "cache/casubCache.h"
 
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/TriggeredSubscription.h"
@@ -114,6 +116,40 @@ static bool processSubscriptions
 
 
 
+/* ****************************************************************************
+*
+* triggeredSubscriptionAdd - add a casub to the map (if not already there)
+*/
+static void triggeredSubscriptionAdd
+(
+  const BSONObj&                                  sub,
+  const std::string&                              subIdStr,
+  std::map<std::string, TriggeredSubscription*>&  subs
+)
+{
+  if (subs.count(subIdStr) != 0)
+  {
+    return;
+  }
+
+  ngsiv2::HttpInfo httpInfo;
+
+  httpInfo.url = getStringFieldF(sub, CASUB_REFERENCE);
+
+  LM_T(LmtMongo, ("adding subscription: '%s'", sub.toString().c_str()));
+
+  //
+  // FIXME P4: Once ctx availability notification formats get defined for NGSIv2,
+  //           the first parameter for TriggeredSubscription will have "normalized" as default value
+  //
+  RenderFormat           renderFormat = sub.hasField(CASUB_FORMAT)? stringToRenderFormat(getStringFieldF(sub, CASUB_FORMAT)) : NGSI_V1_LEGACY;
+  TriggeredSubscription* trigs        = new TriggeredSubscription(renderFormat, httpInfo, subToAttributeList(sub));
+
+  subs.insert(std::pair<std::string, TriggeredSubscription*>(subIdStr, trigs));
+}
+
+
+
 /* ****************************************************************************
 *
 * addTriggeredSubscriptions -
@@ -126,6 +162,27 @@ static bool addTriggeredSubscriptions
   std::string                                     tenant
 )
 {
+  //
+  // Availability subscriptions cache first. If it cannot solve the lookup, the DB is queried
+  //
+  std::vector<std::string>  attrNameV;
+  std::vector<BSONObj>      cachedSubV;
+
+  for (unsigned int ix = 0; ix < cr.contextRegistrationAttributeVector.size(); ++ix)
+  {
+    attrNameV.push_back(cr.contextRegistrationAttributeVector[ix]->name);
+  }
+
+  if (casubCacheMatch(tenant, cr.entityIdVector, attrNameV, &cachedSubV))
+  {
+    for (unsigned int ix = 0; ix < cachedSubV.size(); ++ix)
+    {
+      triggeredSubscriptionAdd(cachedSubV[ix], getFieldF(cachedSubV[ix], "_id").OID().toString(), subs);
+    }
+
+    return true;
+  }
+
   BSONArrayBuilder          entitiesNoPatternA;
   std::vector<std::string>  idJsV;
   std::vector<std::string>  typeJsV;
@@ -272,25 +329,7 @@ static bool addTriggeredSubscriptions
     }
     alarmMgr.dbErrorReset();
 
-    std::string subIdStr = idField.OID().toString();
-
-    if (subs.count(subIdStr) == 0)
-    {
-      ngsiv2::HttpInfo httpInfo;
-
-      httpInfo.url = getStringFieldF(sub, CASUB_REFERENCE);
-
-      LM_T(LmtMongo, ("adding subscription: '%s'", sub.toString().c_str()));
-
-      //
-      // FIXME P4: Once ctx availability notification formats get defined for NGSIv2,
-      //           the first parameter for TriggeredSubscription will have "normalized" as default value
-      //
-      RenderFormat           renderFormat = sub.hasField(CASUB_FORMAT)? stringToRenderFormat(getStringFieldF(sub, CASUB_FORMAT)) : NGSI_V1_LEGACY;
-      TriggeredSubscription* trigs        = new TriggeredSubscription(renderFormat, httpInfo, subToAttributeList(sub));
-
-      subs.insert(std::pair<std::string, TriggeredSubscription*>(subIdStr, trigs));
-    }
+    triggeredSubscriptionAdd(sub, idField.OID().toString(), subs);
   }
   releaseMongoConnection(connection);
 
@@ -430,13 +469,19 @@ HttpStatusCode processRegisterContext
    * exist in the collection, it is created. Thus, this way both uses of registerContext are OK
    * (either new registration or updating an existing one)
    */
-  if (!collectionUpdate(getRegistrationsCollectionName(tenant), BSON("_id" << oid), reg.obj(), true, &err))
+  BSONObj  regDoc = reg.obj();
+  bool     ok     = collectionUpdate(getRegistrationsCollectionName(tenant), BSON("_id" << oid), regDoc, true, &err);
+
+  if (!ok)
   {
+    regCacheTenantRefresh(tenant);
     responseP->errorCode.fill(SccReceiverInternalError, err);
     releaseTriggeredSubscriptions(&subsToNotify);
     return SccOk;
   }
 
+  regCacheItemUpsert(tenant, regDoc);
+
   //
   // Send notifications for each one of the subscriptions accumulated by
   // previous addTriggeredSubscriptions() invocations
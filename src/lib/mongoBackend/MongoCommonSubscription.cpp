@@ -389,6 +389,22 @@ void setLastSuccess(long long lastSuccess, BSONObjBuilder* b)
 
 
 
+/* ****************************************************************************
+*
+* setInitialNotification -
+*/
+void setInitialNotification(const std::string& status, long long entities, long long notifications, BSONObjBuilder* b)
+{
+  BSONObj initialNotification = BSON(CSUB_INITIALNOTIF_STATUS   << status   <<
+                                     CSUB_INITIALNOTIF_ENTITIES << entities <<
+                                     CSUB_INITIALNOTIF_SENT     << notifications);
+
+  b->append(CSUB_INITIALNOTIF, initialNotification);
+  LM_T(LmtMongo, ("Subscription initialNotification: %s", initialNotification.toString().c_str()));
+}
+
+
+
 /* ****************************************************************************
 *
 * setExpression -
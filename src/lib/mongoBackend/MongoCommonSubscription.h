@@ -161,6 +161,20 @@ extern void setLastSuccess(long long lastSuccess, mongo::BSONObjBuilder* b);
 
 
 
+/* ****************************************************************************
+*
+* setInitialNotification -
+*/
+extern void setInitialNotification
+(
+  const std::string&      status,
+  long long               entities,
+  long long               notifications,
+  mongo::BSONObjBuilder*  b
+);
+
+
+
 /* ****************************************************************************
 *
 * setExpression -
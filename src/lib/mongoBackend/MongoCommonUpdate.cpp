@@ -38,6 +38,7 @@
 #include "common/string.h"
 #include "common/sem.h"
 #include "common/statistics.h"
+#include "common/reqTrace.h"
 #include "common/errorMessages.h"
 #include "common/defaultValues.h"
 #include "common/RenderFormat.h"
@@ -46,6 +47,7 @@
 #include "orionTypes/OrionValueType.h"
 #include "orionTypes/UpdateActionType.h"
 #include "cache/subCache.h"
+#include "cache/entityCache.h"
 #include "rest/StringFilter.h"
 #include "ngsi/Scope.h"
 #include "rest/uriParamNames.h"
@@ -1002,68 +1004,34 @@ static bool deleteAttribute
 
 /* ****************************************************************************
 *
-* servicePathSubscriptionRegex -
+* servicePathSubscriptionQuery -
 *
 * 1. If the incoming request is without service path, then only subscriptions without
 *    service path is a match (without or with '/#', or '/')
-* 2. If the incoming request has a service path, then the REGEX must be created:
+* 2. If the incoming request has a service path, then the subscriptions on any of its
+*    scopes (see servicePathScopes()) or without service path are a match:
 *    - Incoming: /a1/a2/a3
-*    - REGEX: ^/#$ | ^/a1/#$ | | ^/a1/a2/#$ | ^/a1/a2/a3/#$ | ^/a1/a2/a3$
+*    - Match: '' | /# | /a1/# | /a1/a2/# | /a1/a2/a3/# | /a1/a2/a3
 *
+* As all the cases are exact matches, the query is an equality $in (instead of an $in of
+* anchored regular expressions), able to use an index on the servicePath of the csubs
+* collection.
 */
-static std::string servicePathSubscriptionRegex(const std::string& servicePath, std::vector<std::string>& spathV)
+static BSONObj servicePathSubscriptionQuery(const std::string& servicePath)
 {
-  std::string  spathRegex;
-  int          spathComponents = 0;
+  BSONArrayBuilder  ba;
+  BSONArray         scopes = servicePathScopes(servicePath);
 
-  //
-  // Split Service Path in 'path components'
-  //
-  if (servicePath != "")
-  {
-    spathComponents = stringSplit(servicePath, '/', spathV);
-  }
+  ba.append("");
 
-  if (spathComponents == 0)
+  for (BSONObj::iterator it = scopes.begin(); it.more();)
   {
-    spathRegex = "^$|^\\/#$|^\\/$";
+    ba.append(it.next());
   }
-  else
-  {
-    //
-    // 1. Empty or '/#'
-    //
-    spathRegex = std::string("^$|^\\/#$");
-
-
-    //
-    // 2. The whole list /a | /a/b | /a/b/c  etc
-    //
-    for (int ix = 0; ix < spathComponents; ++ix)
-    {
-      spathRegex += std::string("|^");
-
-      for (int cIx = 0; cIx <= ix; ++cIx)
-      {
-        spathRegex += std::string("\\/") + spathV[cIx];
-      }
 
-      spathRegex += std::string("\\/#$");
-    }
-
-
-    //
-    // 3. EXACT service path
-    //
-    spathRegex += std::string("|^");
-    for (int cIx = 0; cIx < spathComponents; ++cIx)
-    {
-      spathRegex += std::string("\\/") + spathV[cIx];
-    }
-    spathRegex += std::string("$");
-  }
+  ba.appendNull();
 
-  return spathRegex;
+  return BSON("$in" << ba.arr());
 }
 
 
@@ -1080,7 +1048,8 @@ static bool addTriggeredSubscriptions_withCache
   std::map<std::string, TriggeredSubscription*>& subs,
   std::string&                                   err,
   std::string                                    tenant,
-  const std::vector<std::string>&                servicePathV
+  const std::vector<std::string>&                servicePathV,
+  const std::string&                             xauthToken
 )
 {
   std::string                       servicePath = (servicePathV.size() > 0)? servicePathV[0] : "";
@@ -1095,7 +1064,7 @@ static bool addTriggeredSubscriptions_withCache
   {
     CachedSubscription* cSubP = subVec[ix];
 
-    // Outdated subscriptions are skipped
+    // Outdated subscriptions are skipped (the expiry timer takes them out of the matching within a second)
     if (cSubP->expirationTime < now)
     {
       LM_T(LmtSubCache, ("%s is EXPIRED (EXP:%lu, NOW:%lu, DIFF: %d)",
@@ -1138,6 +1107,9 @@ static bool addTriggeredSubscriptions_withCache
                            now,
                            now - cSubP->lastNotificationTime,
                            cSubP->throttling));
+
+        // With deferred notifications, the entity is notified at the end of the window
+        subCacheItemDefer(cSubP, entityId, entityType, xauthToken);
         continue;
       }
       else
@@ -1397,14 +1369,7 @@ static bool addTriggeredSubscriptions_noCache
 )
 {
   std::string               servicePath     = (servicePathV.size() > 0)? servicePathV[0] : "";
-  std::vector<std::string>  spathV;
-  std::string               spathRegex      = servicePathSubscriptionRegex(servicePath, spathV);
-
-
-  //
-  // Create the REGEX for the Service Path
-  //
-  spathRegex = std::string("/") + spathRegex + "/";
+  BSONObj                   spBson          = servicePathSubscriptionQuery(servicePath);
 
 
   /* Build query */
@@ -1412,8 +1377,6 @@ static bool addTriggeredSubscriptions_noCache
   std::string entTypeQ      = CSUB_ENTITIES   "." CSUB_ENTITY_TYPE;
   std::string entPatternQ   = CSUB_ENTITIES   "." CSUB_ENTITY_ISPATTERN;
   std::string typePatternQ  = CSUB_ENTITIES   "." CSUB_ENTITY_ISTYPEPATTERN;
-  std::string inRegex       = "{ $in: [ " + spathRegex + ", null ] }";
-  BSONObj     spBson        = mongo::fromjson(inRegex);
 
   /* Query is an $or of 4 sub-clauses:
    *
@@ -1653,19 +1616,176 @@ static bool addTriggeredSubscriptions
   std::map<std::string, TriggeredSubscription*>& subs,
   std::string&                                   err,
   std::string                                    tenant,
-  const std::vector<std::string>&                servicePathV
+  const std::vector<std::string>&                servicePathV,
+  const std::string&                             xauthToken
 )
 {
   extern bool noCache;
+  bool        r;
+
+  REQ_TRACE_SPAN_START(subMatchStart);
 
   if (noCache)
   {
-    return addTriggeredSubscriptions_noCache(entityId, entityType, modifiedAttrs, subs, err, tenant, servicePathV);
+    r = addTriggeredSubscriptions_noCache(entityId, entityType, modifiedAttrs, subs, err, tenant, servicePathV);
   }
   else
   {
-    return addTriggeredSubscriptions_withCache(entityId, entityType, modifiedAttrs, subs, err, tenant, servicePathV);
+    r = addTriggeredSubscriptions_withCache(entityId, entityType, modifiedAttrs, subs, err, tenant, servicePathV, xauthToken);
+  }
+
+  REQ_TRACE_SPAN_STOP(subMatchStart, RtpSubMatch, "subMatch");
+
+  return r;
+}
+
+
+
+/* ****************************************************************************
+*
+* NotificationPayload -
+*
+* NGSIv2 rendering of the notified entity. When an update triggers several subscriptions,
+* the ones notifying the same attributes with the same format and (normalized) metadata
+* filter share the same rendering, so it is done only once per update.
+*
+* The attributes are identified by pointer and number of metadata, given that the
+* notified CER is modified along processSubscriptions() (special attributes and
+* metadata are added), see notificationPayloadsInvalidate().
+*/
+typedef struct NotificationPayload
+{
+  RenderFormat                    renderFormat;
+  std::vector<std::string>        metadataFilter;
+  std::vector<ContextAttribute*>  attrV;
+  std::vector<unsigned int>       mdSizeV;
+  std::string                     data;
+} NotificationPayload;
+
+
+
+/* ****************************************************************************
+*
+* notificationPayloadsRelease -
+*/
+static void notificationPayloadsRelease(std::vector<NotificationPayload*>* payloadsP)
+{
+  for (unsigned int ix = 0; ix < payloadsP->size(); ++ix)
+  {
+    delete (*payloadsP)[ix];
+  }
+
+  payloadsP->clear();
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationPayloadsInvalidate -
+*
+* Attributes removed from the notified CER are freed, so their pointers could be reused
+* by new attributes. Thus, all the renderings are dropped if the attribute vector changed.
+*/
+static void notificationPayloadsInvalidate
+(
+  std::vector<NotificationPayload*>*     payloadsP,
+  const std::vector<ContextAttribute*>&  attrsBefore,
+  const ContextElementResponse*          notifyCerP
+)
+{
+  if (attrsBefore != notifyCerP->contextElement.contextAttributeVector.vec)
+  {
+    notificationPayloadsRelease(payloadsP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationPayloadGet -
+*
+* Returns NULL if the rendering cannot be shared: formats not rendered by
+* NotifyContextRequest::toJson() or dateCreated/dateModified metadata in the filter
+* (ContextAttribute::toJson() adds them to the attribute when rendering)
+*/
+static const std::string* notificationPayloadGet
+(
+  std::vector<NotificationPayload*>*  payloadsP,
+  ContextElementResponse*             cerP,
+  RenderFormat                        renderFormat,
+  const std::vector<std::string>&     metadataFilter
+)
+{
+  if ((renderFormat != NGSI_V2_NORMALIZED) && (renderFormat != NGSI_V2_KEYVALUES) && (renderFormat != NGSI_V2_VALUES))
+  {
+    return NULL;
+  }
+
+  if ((std::find(metadataFilter.begin(), metadataFilter.end(), NGSI_MD_DATECREATED)  != metadataFilter.end()) ||
+      (std::find(metadataFilter.begin(), metadataFilter.end(), NGSI_MD_DATEMODIFIED) != metadataFilter.end()))
+  {
+    return NULL;
+  }
+
+  //
+  // The metadata filter is a set of names, in which '*' (or no name at all) means all the metadata.
+  // It is not used at all by the keyValues and values formats
+  //
+  std::vector<std::string> mdFilter;
+
+  if ((renderFormat == NGSI_V2_NORMALIZED) &&
+      (std::find(metadataFilter.begin(), metadataFilter.end(), NGSI_MD_ALL) == metadataFilter.end()))
+  {
+    mdFilter = metadataFilter;
+    std::sort(mdFilter.begin(), mdFilter.end());
+    mdFilter.erase(std::unique(mdFilter.begin(), mdFilter.end()), mdFilter.end());
+  }
+
+  const std::vector<ContextAttribute*>& attrV = cerP->contextElement.contextAttributeVector.vec;
+
+  for (unsigned int ix = 0; ix < payloadsP->size(); ++ix)
+  {
+    NotificationPayload* payloadP = (*payloadsP)[ix];
+
+    if ((payloadP->renderFormat != renderFormat) || (payloadP->metadataFilter != mdFilter) || (payloadP->attrV != attrV))
+    {
+      continue;
+    }
+
+    bool match = true;
+
+    for (unsigned int jx = 0; jx < attrV.size(); ++jx)
+    {
+      if (payloadP->mdSizeV[jx] != attrV[jx]->metadataVector.size())
+      {
+        match = false;
+        break;
+      }
+    }
+
+    if (match)
+    {
+      return &payloadP->data;
+    }
+  }
+
+  NotificationPayload* payloadP = new NotificationPayload();
+
+  payloadP->renderFormat   = renderFormat;
+  payloadP->metadataFilter = mdFilter;
+  payloadP->attrV          = attrV;
+
+  for (unsigned int ix = 0; ix < attrV.size(); ++ix)
+  {
+    payloadP->mdSizeV.push_back(attrV[ix]->metadataVector.size());
   }
+
+  payloadP->data = cerP->toJson(renderFormat, metadataFilter);
+  payloadsP->push_back(payloadP);
+
+  return &payloadP->data;
 }
 
 
@@ -1680,16 +1800,18 @@ static bool addTriggeredSubscriptions
 */
 static bool processOnChangeConditionForUpdateContext
 (
-  ContextElementResponse*          notifyCerP,
-  const StringList&                attrL,
-  const std::vector<std::string>&  metadataV,
-  std::string                      subId,
-  RenderFormat                     renderFormat,
-  std::string                      tenant,
-  const std::string&               xauthToken,
-  const std::string&               fiwareCorrelator,
-  const ngsiv2::HttpInfo&          httpInfo,
-  bool                             blacklist = false
+  ContextElementResponse*             notifyCerP,
+  const StringList&                   attrL,
+  const std::vector<std::string>&     metadataV,
+  std::string                         subId,
+  RenderFormat                        renderFormat,
+  std::string                         tenant,
+  const std::string&                  xauthToken,
+  const std::string&                  fiwareCorrelator,
+  const ngsiv2::HttpInfo&             httpInfo,
+  bool                                blacklist  = false,
+  std::vector<NotificationPayload*>*  payloadsP  = NULL,
+  std::string*                        batchDataP = NULL
 )
 {
   NotifyContextRequest   ncr;
@@ -1741,6 +1863,27 @@ static bool processOnChangeConditionForUpdateContext
   ncr.originator.set("localhost");
 
   ncr.subscriptionId.set(subId);
+
+  /* Custom notifications don't use the default payload */
+  bool defaultPayload = (!httpInfo.custom || disableCusNotif);
+
+  if ((payloadsP != NULL) && defaultPayload)
+  {
+    ncr.renderedDataP = notificationPayloadGet(payloadsP, &cer, renderFormat, metadataV);
+  }
+
+  //
+  // In batch updates the rendered entity is given back to the caller, to be sent along with the
+  // other entities notified to the same subscription (see notificationBatchAdd())
+  //
+  if ((batchDataP != NULL) && defaultPayload &&
+      ((renderFormat == NGSI_V2_NORMALIZED) || (renderFormat == NGSI_V2_KEYVALUES) || (renderFormat == NGSI_V2_VALUES)))
+  {
+    *batchDataP = (ncr.renderedDataP != NULL)? *ncr.renderedDataP : cer.toJson(renderFormat, metadataV);
+    return false;
+  }
+
+  REQ_TRACE_SPAN_START(notifStart);
   getNotifier()->sendNotifyContextRequest(&ncr,
                                           httpInfo,
                                           tenant,
@@ -1748,6 +1891,8 @@ static bool processOnChangeConditionForUpdateContext
                                           fiwareCorrelator,
                                           renderFormat,
                                           metadataV);
+  REQ_TRACE_SPAN_STOP(notifStart, RtpNotifEnqueue, "notification");
+
   return true;
 }
 
@@ -1910,9 +2055,283 @@ static void setDateModifiedMetadata(ContextElementResponse* notifyCerP)
 
 
 
+/* ****************************************************************************
+*
+* subscriptionNotifiedUpdate - account notifications sent for a subscription
+*
+* Sets lastNotificationTime and increments count (by the number of notifications sent)
+* in the cached subscription or, if broker running without subscription cache, in DB.
+*/
+static bool subscriptionNotifiedUpdate
+(
+  const std::string&  subId,
+  const std::string&  cacheSubId,
+  const std::string&  cacheTenant,
+  const std::string&  tenant,
+  long long           notifications,
+  std::string*        err
+)
+{
+  bool       ret      = true;
+  long long  rightNow = getCurrentTime();
+
+  //
+  // If broker running without subscription cache, put lastNotificationTime and count in DB
+  //
+  if (subCacheActive == false)
+  {
+    BSONObj query  = BSON("_id" << OID(subId));
+    BSONObj update = BSON("$set" <<
+                          BSON(CSUB_LASTNOTIFICATION << rightNow) <<
+                          "$inc" << BSON(CSUB_COUNT << notifications));
+
+    ret = collectionUpdate(getSubscribeContextCollectionName(tenant), query, update, false, err);
+  }
+
+
+  //
+  // Saving lastNotificationTime and count for cached subscription
+  //
+  if (cacheSubId != "")
+  {
+    cacheSemTake(__FUNCTION__, "update lastNotificationTime for cached subscription");
+
+    CachedSubscription*  cSubP = subCacheItemLookup(cacheTenant.c_str(), cacheSubId.c_str());
+
+    if (cSubP != NULL)
+    {
+      cSubP->lastNotificationTime = rightNow;
+      cSubP->count               += notifications;
+
+      LM_T(LmtSubCache, ("set lastNotificationTime to %lu and count to %lu for '%s'",
+                         cSubP->lastNotificationTime, cSubP->count, cSubP->subscriptionId));
+    }
+    else
+    {
+      LM_E(("Runtime Error (cached subscription '%s' for tenant '%s' not found)",
+            cacheSubId.c_str(), cacheTenant.c_str()));
+    }
+
+    cacheSemGive(__FUNCTION__, "update lastNotificationTime for cached subscription");
+  }
+
+  return ret;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifBatchMaxSize - maximum size of the data of a batch notification (0: no batching)
+*/
+static unsigned int notifBatchMaxSize = 0;
+
+
+
+/* ****************************************************************************
+*
+* BatchedNotification - notification of a subscription in a NotificationBatch
+*
+* The entities are kept for the Fiware-ServicePath header of the notification, while
+* their rendering is in 'data'. 'sent' counts the notifications already sent for the
+* subscription (as 'data' exceeded notifBatchMaxSize).
+*/
+struct BatchedNotification
+{
+  std::string               subId;
+  std::string               cacheSubId;
+  std::string               cacheTenant;
+  ngsiv2::HttpInfo          httpInfo;
+  RenderFormat              renderFormat;
+  std::vector<std::string>  metadata;
+  long long                 throttling;
+  std::vector<EntityId>     entities;
+  std::string               data;
+  long long                 sent;
+};
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchInit -
+*/
+void notificationBatchInit(unsigned int maxSize)
+{
+  notifBatchMaxSize = maxSize;
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchEnabled -
+*/
+bool notificationBatchEnabled(void)
+{
+  return notifBatchMaxSize > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchSend - send the entities accumulated for a subscription
+*/
+static void notificationBatchSend
+(
+  BatchedNotification*  bnP,
+  const std::string&    tenant,
+  const std::string&    xauthToken,
+  const std::string&    fiwareCorrelator
+)
+{
+  NotifyContextRequest ncr;
+
+  for (unsigned int ix = 0; ix < bnP->entities.size(); ++ix)
+  {
+    ContextElementResponse* cerP = new ContextElementResponse();
+
+    cerP->contextElement.entityId.fill(&bnP->entities[ix]);
+    cerP->statusCode.fill(SccOk);
+    ncr.contextElementResponseVector.push_back(cerP);
+  }
+
+  ncr.subscriptionId.set(bnP->subId);
+  ncr.originator.set("localhost");
+  ncr.renderedDataP = &bnP->data;
+
+  REQ_TRACE_SPAN_START(notifStart);
+  getNotifier()->sendNotifyContextRequest(&ncr,
+                                          bnP->httpInfo,
+                                          tenant,
+                                          xauthToken,
+                                          fiwareCorrelator,
+                                          bnP->renderFormat,
+                                          bnP->metadata);
+  REQ_TRACE_SPAN_STOP(notifStart, RtpNotifEnqueue, "notification");
+
+  ncr.contextElementResponseVector.release();
+
+  bnP->entities.clear();
+  bnP->data.clear();
+  bnP->sent += 1;
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchAdd - add a rendered entity to the notification of a subscription
+*
+* If the entity doesn't fit in the notification, the entities accumulated so far are sent
+* first. Note that lastNotificationTime is not updated until notificationBatchFlush(), so
+* all the entities of the request pass (or not) the throttling check of the subscription.
+* A subscription with throttling gets a single notification per request, as any other one
+* would be within its throttling window: once a notification has been sent, the rest of
+* the entities are discarded.
+*/
+static void notificationBatchAdd
+(
+  NotificationBatch*      batchP,
+  const std::string&      subId,
+  TriggeredSubscription*  tSubP,
+  const EntityId&         entityId,
+  const std::string&      data,
+  const std::string&      tenant,
+  const std::string&      xauthToken,
+  const std::string&      fiwareCorrelator
+)
+{
+  BatchedNotification*                                   bnP;
+  std::map<std::string, BatchedNotification*>::iterator  it = batchP->subs.find(subId);
+
+  if (it == batchP->subs.end())
+  {
+    bnP = new BatchedNotification();
+
+    bnP->subId        = subId;
+    bnP->cacheSubId   = tSubP->cacheSubId;
+    bnP->cacheTenant  = tSubP->tenant;
+    bnP->httpInfo     = tSubP->httpInfo;
+    bnP->renderFormat = tSubP->renderFormat;
+    bnP->metadata     = tSubP->metadata;
+    bnP->throttling   = tSubP->throttling;
+    bnP->sent         = 0;
+
+    batchP->subs[subId] = bnP;
+  }
+  else
+  {
+    bnP = it->second;
+  }
+
+  if ((bnP->throttling > 0) && (bnP->sent > 0))
+  {
+    LM_T(LmtSubCache, ("ignored '%s' due to throttling, batch notification already sent", bnP->cacheSubId.c_str()));
+    return;
+  }
+
+  if ((bnP->data != "") && (bnP->data.size() + 1 + data.size() > notifBatchMaxSize))
+  {
+    notificationBatchSend(bnP, tenant, xauthToken, fiwareCorrelator);
+
+    if (bnP->throttling > 0)
+    {
+      LM_T(LmtSubCache, ("ignored '%s' due to throttling, batch notification already sent", bnP->cacheSubId.c_str()));
+      return;
+    }
+  }
+
+  if (bnP->data != "")
+  {
+    bnP->data += ",";
+  }
+
+  bnP->data += data;
+  bnP->entities.push_back(entityId);
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchFlush -
+*/
+void notificationBatchFlush
+(
+  NotificationBatch*  batchP,
+  const std::string&  tenant,
+  const std::string&  xauthToken,
+  const std::string&  fiwareCorrelator
+)
+{
+  for (std::map<std::string, BatchedNotification*>::iterator it = batchP->subs.begin(); it != batchP->subs.end(); ++it)
+  {
+    BatchedNotification* bnP = it->second;
+
+    if (bnP->data != "")
+    {
+      notificationBatchSend(bnP, tenant, xauthToken, fiwareCorrelator);
+    }
+
+    std::string err;
+    subscriptionNotifiedUpdate(bnP->subId, bnP->cacheSubId, bnP->cacheTenant, tenant, bnP->sent, &err);
+
+    delete bnP;
+  }
+
+  batchP->subs.clear();
+}
+
+
+
 /* ****************************************************************************
 *
 * processSubscriptions - send a notification for each subscription in the map
+*
+* In batch updates (batchP not NULL) the notifications are added to the batch instead,
+* to be sent by notificationBatchFlush() once all the entities have been processed.
 */
 static bool processSubscriptions
 (
@@ -1921,10 +2340,12 @@ static bool processSubscriptions
   std::string*                                   err,
   const std::string&                             tenant,
   const std::string&                             xauthToken,
-  const std::string&                             fiwareCorrelator
+  const std::string&                             fiwareCorrelator,
+  NotificationBatch*                             batchP = NULL
 )
 {
-  bool ret = true;
+  bool                               ret = true;
+  std::vector<NotificationPayload*>  payloads;
 
   *err = "";
 
@@ -2019,6 +2440,8 @@ static bool processSubscriptions
       }
     }
 
+    std::vector<ContextAttribute*> attrsBefore = notifyCerP->contextElement.contextAttributeVector.vec;
+
     /* Set special attributes */
     if (tSubP->attrL.lookup(DATE_CREATED))
     {
@@ -2053,11 +2476,13 @@ static bool processSubscriptions
 
     // Get the effective vector of attributes to render
     notifyCerP->contextElement.filterAttributes(tSubP->attrL.stringV, tSubP->blacklist);
+    notificationPayloadsInvalidate(&payloads, attrsBefore, notifyCerP);
 
     /* Send notification */
     LM_T(LmtSubCache, ("NOT ignored: %s", tSubP->cacheSubId.c_str()));
 
-    bool  notificationSent;
+    bool         notificationSent;
+    std::string  batchData;
 
     notificationSent = processOnChangeConditionForUpdateContext(notifyCerP,
                                                                 tSubP->attrL,
@@ -2068,54 +2493,29 @@ static bool processSubscriptions
                                                                 xauthToken,
                                                                 fiwareCorrelator,
                                                                 tSubP->httpInfo,
-                                                                tSubP->blacklist);
+                                                                tSubP->blacklist,
+                                                                &payloads,
+                                                                (batchP != NULL)? &batchData : NULL);
 
-    if (notificationSent)
+    if (batchData != "")
     {
-      long long rightNow = getCurrentTime();
-
-      //
-      // If broker running without subscription cache, put lastNotificationTime and count in DB
-      //
-      if (subCacheActive == false)
-      {
-        BSONObj query  = BSON("_id" << OID(mapSubId));
-        BSONObj update = BSON("$set" <<
-                              BSON(CSUB_LASTNOTIFICATION << rightNow) <<
-                              "$inc" << BSON(CSUB_COUNT << (long long) 1));
-
-        ret = collectionUpdate(getSubscribeContextCollectionName(tenant), query, update, false, err);
-      }
-
-
-      //
-      // Saving lastNotificationTime and count for cached subscription
-      //
-      if (tSubP->cacheSubId != "")
-      {
-        cacheSemTake(__FUNCTION__, "update lastNotificationTime for cached subscription");
-
-        CachedSubscription*  cSubP = subCacheItemLookup(tSubP->tenant.c_str(), tSubP->cacheSubId.c_str());
-
-        if (cSubP != NULL)
-        {
-          cSubP->lastNotificationTime = rightNow;
-          cSubP->count               += 1;
-
-          LM_T(LmtSubCache, ("set lastNotificationTime to %lu and count to %lu for '%s'",
-                             cSubP->lastNotificationTime, cSubP->count, cSubP->subscriptionId));
-        }
-        else
-        {
-          LM_E(("Runtime Error (cached subscription '%s' for tenant '%s' not found)",
-                tSubP->cacheSubId.c_str(), tSubP->tenant.c_str()));
-        }
+      notificationBatchAdd(batchP,
+                           mapSubId,
+                           tSubP,
+                           notifyCerP->contextElement.entityId,
+                           batchData,
+                           tenant,
+                           xauthToken,
+                           fiwareCorrelator);
+    }
 
-        cacheSemGive(__FUNCTION__, "update lastNotificationTime for cached subscription");
-      }
+    if (notificationSent)
+    {
+      ret = subscriptionNotifiedUpdate(mapSubId, tSubP->cacheSubId, tSubP->tenant, tenant, 1, err);
     }
   }
 
+  notificationPayloadsRelease(&payloads);
   releaseTriggeredSubscriptions(&subs);
 
   return ret;
@@ -2658,6 +3058,7 @@ static bool processContextAttributeVector
   bool*                                           dateExpirationInPayload,
   std::string                                     tenant,
   const std::vector<std::string>&                 servicePathV,
+  const std::string&                              xauthToken,
   ApiVersion                                      apiVersion,
   bool                                            loopDetected,
   OrionError*                                     oe
@@ -2801,7 +3202,7 @@ static bool processContextAttributeVector
   {
     LM_W(("Notification loop detected for entity id <%s> type <%s>, skipping subscription triggering", entityId.c_str(), entityType.c_str()));
   }
-  else if (!addTriggeredSubscriptions(entityId, entityType, modifiedAttrs, subsToNotify, err, tenant, servicePathV))
+  else if (!addTriggeredSubscriptions(entityId, entityType, modifiedAttrs, subsToNotify, err, tenant, servicePathV, xauthToken))
   {
     cerP->statusCode.fill(SccReceiverInternalError, err);
     oe->fill(SccReceiverInternalError, err, "InternalServerError");
@@ -2852,11 +3253,9 @@ static bool createEntity
 {
   LM_T(LmtMongo, ("Entity not found in '%s' collection, creating it", getEntitiesCollectionName(tenant).c_str()));
 
-  /* Actually we don't know if this is the first entity (thus, the collection is being created) or not. However, we can
-   * invoke ensureLocationIndex() in anycase, given that it is harmless in the case the collection and index already
-   * exits (see docs.mongodb.org/manual/reference/method/db.collection.ensureIndex/) */
-  ensureLocationIndex(tenant);
-  ensureDateExpirationIndex(tenant);
+  /* Actually we don't know if this is the first entity (thus, the collection is being created) or not. The indexes
+   * are created just the first time for each tenant (and again after an error in the entities collection) */
+  ensureEntityIndexes(tenant);
 
   if (!legalIdUsage(attrsV))
   {
@@ -2960,7 +3359,9 @@ static bool createEntity
     bsonId.append(ENT_ENTITY_TYPE, eP->type);
   }
 
-  bsonId.append(ENT_SERVICE_PATH, servicePathV[0] == ""? SERVICE_PATH_ROOT : servicePathV[0]);
+  std::string servicePath = (servicePathV[0] == "")? SERVICE_PATH_ROOT : servicePathV[0];
+
+  bsonId.append(ENT_SERVICE_PATH, servicePath);
 
   BSONObjBuilder insertedDoc;
 
@@ -2970,6 +3371,12 @@ static bool createEntity
   insertedDoc.append(ENT_CREATION_DATE, now);
   insertedDoc.append(ENT_MODIFICATION_DATE, now);
 
+  /* Add servicePath scopes in the case of using the servicePath index */
+  if (mongoServicePathIndex())
+  {
+    insertedDoc.append(ENT_SERVICE_PATH_SCOPES, servicePathScopes(servicePath));
+  }
+
   /* Add location information in the case it was found */
   if (locAttr.length() > 0)
   {
@@ -2986,12 +3393,22 @@ static bool createEntity
   // Correlator (for notification loop detection logic)
   insertedDoc.append(ENT_LAST_CORRELATOR, fiwareCorrelator);
 
-  if (!collectionInsert(getEntitiesCollectionName(tenant), insertedDoc.obj(), errDetail))
+  BSONObj             insertedObj = insertedDoc.obj();
+  unsigned long long  cacheEpoch  = entityCacheEpoch(tenant,
+                                                     servicePath,
+                                                     eP->id,
+                                                     ((eP->type == "") && (apiVersion == V2))? DEFAULT_ENTITY_TYPE : eP->type);
+
+  if (!collectionInsert(getEntitiesCollectionName(tenant), insertedObj, errDetail))
   {
+    entityIndexesInvalidate(tenant);
     oeP->fill(SccReceiverInternalError, *errDetail, "InternalError");
     return false;
   }
 
+  // Write-through: the entity is likely to be updated soon
+  entityCacheFill(tenant, insertedObj, cacheEpoch);
+
   return true;
 }
 
@@ -3036,7 +3453,12 @@ static bool removeEntity
   }
 
   std::string err;
-  if (!collectionRemove(getEntitiesCollectionName(tenant), bob.obj(), &err))
+  bool        ok = collectionRemove(getEntitiesCollectionName(tenant), bob.obj(), &err);
+
+  // Even if the operation failed, the entity could have been removed, so it is dropped from cache in any case
+  entityCacheRemove(tenant, servicePath, entityId, entityType);
+
+  if (!ok)
   {
     cerP->statusCode.fill(SccReceiverInternalError, err);
     oe->fill(SccReceiverInternalError, err, "InternalServerError");
@@ -3163,7 +3585,8 @@ static void updateEntity
   std::string*                    attributeAlreadyExistsList,
   ApiVersion                      apiVersion,
   const std::string&              fiwareCorrelator,
-  const std::string&              ngsiV2AttrsFormat
+  const std::string&              ngsiV2AttrsFormat,
+  NotificationBatch*              batchP
 )
 {
   // Used to accumulate error response information
@@ -3173,7 +3596,6 @@ static void updateEntity
   EntityId*          enP               = &ceP->entityId;
   const std::string  idString          = "_id." ENT_ENTITY_ID;
   const std::string  typeString        = "_id." ENT_ENTITY_TYPE;
-  const std::string  servicePathString = "_id." ENT_SERVICE_PATH;
 
   BSONObj            idField           = getObjectFieldF(r, "_id");
 
@@ -3304,6 +3726,7 @@ static void updateEntity
                                      &dateExpirationInPayload,
                                      tenant,
                                      servicePathV,
+                                     xauthToken,
                                      apiVersion,
                                      loopDetected,
                                      &(responseP->oe)))
@@ -3474,11 +3897,13 @@ static void updateEntity
   }
 
   // Service Path
-  query.append(servicePathString, fillQueryServicePath(servicePathV));
+  query.append(entityServicePathField(), fillQueryEntityServicePath(servicePathV));
 
   std::string err;
   if (!collectionUpdate(getEntitiesCollectionName(tenant), query.obj(), updatedEntityObj, false, &err))
   {
+    entityCacheRemove(tenant, entitySPath, entityId, entityType);
+
     cerP->statusCode.fill(SccReceiverInternalError, err);
     responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
 
@@ -3492,9 +3917,11 @@ static void updateEntity
     return;
   }
 
+  entityCacheWrite(tenant, r, updatedEntityObj);
+
   /* Send notifications for each one of the ONCHANGE subscriptions accumulated by
    * previous addTriggeredSubscriptions() invocations */
-  processSubscriptions(subsToNotify, notifyCerP, &err, tenant, xauthToken, fiwareCorrelator);
+  processSubscriptions(subsToNotify, notifyCerP, &err, tenant, xauthToken, fiwareCorrelator, batchP);
   notifyCerP->release();
   delete notifyCerP;
 
@@ -3527,6 +3954,257 @@ static void updateEntity
 
 
 
+/* ****************************************************************************
+*
+* fastPathUpdates, fastPathFallbacks - see updateFastPathCounters()
+*/
+static unsigned long long fastPathUpdates   = 0;
+static unsigned long long fastPathFallbacks = 0;
+
+
+
+/* ****************************************************************************
+*
+* updateFastPathCounters -
+*/
+void updateFastPathCounters(unsigned long long* updatesP, unsigned long long* fallbacksP)
+{
+  *updatesP   = __sync_fetch_and_add(&fastPathUpdates, 0);
+  *fallbacksP = __sync_fetch_and_add(&fastPathFallbacks, 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* updateEntityFastPathUsable -
+*
+* The single round-trip update (see updateEntityFastPath()) is only used for NGSIv2
+* updates of existing attributes that don't involve location, expiration or metadata
+* preserving semantics (in which the final attribute depends on what is in DB) and that
+* don't trigger any subscription, according to the subscriptions cache.
+*
+* In addition, the request has to identify exactly one entity document: id and type without
+* patterns, a single non recursive service path and no '!exist=entity::type' filter. Note this
+* doesn't depend on the entity cache being enabled.
+*/
+static bool updateEntityFastPathUsable
+(
+  ContextElement*                  ceP,
+  ActionType                       action,
+  const std::string&               tenant,
+  const std::vector<std::string>&  servicePathV,
+  const std::string&               xauthToken,
+  ApiVersion                       apiVersion,
+  bool                             notExistType
+)
+{
+  extern bool noCache;
+
+  if ((apiVersion != V2) || (action != ActionTypeUpdate) || (noCache) || (ceP->contextAttributeVector.size() == 0))
+  {
+    return false;
+  }
+
+  EntityId* enP = &ceP->entityId;
+
+  if (notExistType || (enP->id == "") || (enP->type == "") || enP->isPatternIsTrue() || enP->isTypePattern)
+  {
+    return false;
+  }
+
+  if ((servicePathV.size() != 1) || (servicePathV[0] == "") || (servicePathV[0][servicePathV[0].size() - 1] == '#'))
+  {
+    return false;
+  }
+
+  std::vector<std::string> attrNames;
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute* caP = ceP->contextAttributeVector[ix];
+
+    if ((caP->skip)                                  ||
+        (caP->onlyValue)                             ||
+        (caP->valueType == orion::ValueTypeNotGiven) ||
+        (caP->getId() != "")                         ||
+        (caP->name == DATE_EXPIRES)                  ||
+        (caP->getLocation(apiVersion) != ""))
+    {
+      return false;
+    }
+
+    attrNames.push_back(caP->name);
+  }
+
+  std::map<std::string, TriggeredSubscription*>  subs;
+  std::string                                    err;
+  bool                                           usable;
+
+  usable = addTriggeredSubscriptions_withCache(ceP->entityId.id,
+                                               ceP->entityId.type,
+                                               attrNames,
+                                               subs,
+                                               err,
+                                               tenant,
+                                               servicePathV,
+                                               xauthToken) && (subs.size() == 0);
+
+  releaseTriggeredSubscriptions(&subs);
+
+  return usable;
+}
+
+
+
+/* ****************************************************************************
+*
+* updateEntityFastPath -
+*
+* Updates the attributes of the entity in a single findAndModify, without reading the
+* entity document first. The update is conditioned to the same circumstances that make the
+* merge done by updateEntity() an actual update with no side effects:
+*
+* - All the attributes exist in the entity
+* - None of them is the entity location attribute
+* - The new (simple) value differs from the existing one (compound values are always
+*   considered an actual update by mergeAttrInfo())
+*
+* If the condition doesn't hold (including the case in which the entity doesn't exist)
+* nothing is modified and false is returned, so the caller has to go through the regular
+* read-merge-write path, which produces the corresponding error (NotFound, etc.) or
+* no-op response. Returns true if the update was done and responseP filled.
+*/
+static bool updateEntityFastPath
+(
+  ContextElement*                  ceP,
+  const std::string&               tenant,
+  const std::vector<std::string>&  servicePathV,
+  const std::string&               fiwareCorrelator,
+  UpdateContextResponse*           responseP
+)
+{
+  EntityId*         enP = &ceP->entityId;
+  BSONObjBuilder    query;
+  BSONObjBuilder    toSet;
+  BSONObjBuilder    toUnset;
+  BSONArrayBuilder  attrNames;
+  int               now = getCurrentTime();
+
+  query.append("_id." ENT_ENTITY_ID, enP->id);
+  query.append("_id." ENT_ENTITY_TYPE, enP->type);
+  query.append(entityServicePathField(), fillQueryEntityServicePath(servicePathV));
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute*  caP      = ceP->contextAttributeVector[ix];
+    const std::string  attrPath = std::string(ENT_ATTRS) + "." + dbDotEncode(caP->name);
+    BSONObjBuilder     valueBuilder;
+
+    // Note autocast is a NGSIv1 thing, so the type is not relevant here
+    caP->valueBson(valueBuilder, caP->type, false);
+
+    BSONObj     valueObj = valueBuilder.obj();
+    BSONElement value    = getFieldF(valueObj, ENT_ATTRS_VALUE);
+
+    if (caP->compoundValueP == NULL)
+    {
+      BSONObjBuilder cond;
+
+      cond.append("$exists", true);
+      cond.appendAs(value, "$ne");
+      query.append(attrPath + "." ENT_ATTRS_VALUE, cond.obj());
+    }
+    else
+    {
+      query.append(attrPath, BSON("$exists" << true));
+    }
+
+    toSet.appendAs(value, attrPath + "." ENT_ATTRS_VALUE);
+
+    if (caP->type != "")
+    {
+      toSet.append(attrPath + "." ENT_ATTRS_TYPE, caP->type);
+    }
+
+    BSONObj    md;
+    BSONArray  mdNames;
+
+    if (contextAttributeCustomMetadataToBson(&md, &mdNames, caP, true))
+    {
+      toSet.append(attrPath + "." ENT_ATTRS_MD, md);
+    }
+    else
+    {
+      toUnset.append(attrPath + "." ENT_ATTRS_MD, 1);
+    }
+    toSet.append(attrPath + "." ENT_ATTRS_MDNAMES, mdNames);
+    toSet.append(attrPath + "." ENT_ATTRS_MODIFICATION_DATE, now);
+
+    attrNames.append(caP->name);
+  }
+
+  query.append(ENT_LOCATION "." ENT_LOCATION_ATTRNAME, BSON("$nin" << attrNames.arr()));
+
+  toSet.append(ENT_MODIFICATION_DATE, now);
+  toSet.append(ENT_LAST_CORRELATOR, fiwareCorrelator);
+
+  BSONObjBuilder  update;
+  BSONObj         toUnsetObj = toUnset.obj();
+
+  update.append("$set", toSet.obj());
+  if (toUnsetObj.nFields() > 0)
+  {
+    update.append("$unset", toUnsetObj);
+  }
+
+  BSONObj      result;
+  std::string  err;
+  BSONObj      cmd = BSON("findAndModify" << COL_ENTITIES <<
+                          "query"         << query.obj()  <<
+                          "update"        << update.obj() <<
+                          "fields"        << BSON("_id" << 1));
+
+  if (!runCollectionCommand(getDatabaseName(tenant), cmd, &result, &err))
+  {
+    LM_T(LmtMongo, ("fast path update failed (%s), using regular update", err.c_str()));
+    __sync_fetch_and_add(&fastPathFallbacks, 1);
+    return false;
+  }
+
+  if (!result.hasField("value") || !getFieldF(result, "value").isABSONObj())
+  {
+    LM_T(LmtMongo, ("fast path update condition not met, using regular update"));
+    __sync_fetch_and_add(&fastPathFallbacks, 1);
+    return false;
+  }
+
+  __sync_fetch_and_add(&fastPathUpdates, 1);
+
+  // Whatever the entity cache had for this entity is outdated now
+  entityCacheRemove(tenant, servicePathV[0], enP->id, enP->type);
+
+  ContextElementResponse* cerP = new ContextElementResponse();
+
+  cerP->contextElement.entityId.fill(enP->id, enP->type, "false");
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute*  targetAttr = ceP->contextAttributeVector[ix];
+    ContextAttribute*  ca         = new ContextAttribute(targetAttr->name, targetAttr->type, "");
+
+    setResponseMetadata(targetAttr, ca);
+    cerP->contextElement.contextAttributeVector.push_back(ca);
+  }
+
+  cerP->statusCode.fill(SccOk);
+  responseP->contextElementResponseVector.push_back(cerP);
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * contextElementPreconditionsCheck -
@@ -3639,7 +4317,8 @@ void processContextElement
   const std::string&                   fiwareCorrelator,
   const std::string&                   ngsiV2AttrsFormat,
   ApiVersion                           apiVersion,
-  Ngsiv2Flavour                        ngsiv2Flavour
+  Ngsiv2Flavour                        ngsiv2Flavour,
+  NotificationBatch*                   batchP
 )
 {
   /* Check preconditions */
@@ -3651,7 +4330,6 @@ void processContextElement
   /* Find entities (could be several, in the case of no type or isPattern=true) */
   const std::string  idString          = "_id." ENT_ENTITY_ID;
   const std::string  typeString        = "_id." ENT_ENTITY_TYPE;
-  const std::string  servicePathString = "_id." ENT_SERVICE_PATH;
   EntityId*          enP               = &ceP->entityId;
   BSONObjBuilder     bob;
 
@@ -3663,7 +4341,7 @@ void processContextElement
   }
 
   // Service path
-  bob.append(servicePathString, fillQueryServicePath(servicePathV));
+  bob.append(entityServicePathField(), fillQueryEntityServicePath(servicePathV));
 
   // FIXME P7: we build the filter for '?!exist=entity::type' directly at mongoBackend layer given that
   // Restriction is not a valid field in updateContext according to the NGSI specification. In the
@@ -3681,13 +4359,34 @@ void processContextElement
   BSONObj                        query = bob.obj();
   std::auto_ptr<DBClientCursor>  cursor;
 
+  //
+  // If the request identifies exactly one entity document, the read-before-write may be
+  // served by the entity cache. Note that in that case the count is not needed either.
+  //
+  bool     notExistType = (uriParams[URI_PARAM_NOT_EXIST] == SCOPE_VALUE_ENTITY_TYPE);
+  bool     cacheable    = !notExistType &&
+                          entityCacheKeyUsable(enP->id, enP->isPatternIsTrue(), enP->type, enP->isTypePattern, servicePathV);
+  BSONObj  cachedDoc;
+  bool     cacheHit     = cacheable && entityCacheLookup(tenant, servicePathV[0], enP->id, enP->type, &cachedDoc);
+
+  //
+  // If the entity is not in the entity cache, an update that is safe to be done without knowing
+  // the current entity is solved in one round trip, without the read-before-write
+  //
+  if (!cacheHit && updateEntityFastPathUsable(ceP, action, tenant, servicePathV, xauthToken, apiVersion, notExistType) &&
+      updateEntityFastPath(ceP, tenant, servicePathV, fiwareCorrelator, responseP))
+  {
+    LM_T(LmtMongo, ("entity '%s' updated in one round trip", enP->id.c_str()));
+    return;
+  }
+
   // Several checks related to NGSIv2
   if (apiVersion == V2)
   {
-    unsigned long long entitiesNumber;
+    unsigned long long entitiesNumber = 1;
     std::string        err;
 
-    if (!collectionCount(getEntitiesCollectionName(tenant), query, &entitiesNumber, &err))
+    if (!cacheHit && !collectionCount(getEntitiesCollectionName(tenant), query, &entitiesNumber, &err))
     {
       buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
       responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
@@ -3721,69 +4420,82 @@ void processContextElement
     }
   }
 
-  std::string err;
-
-  TIME_STAT_MONGO_READ_WAIT_START();
-  DBClientBase* connection = getMongoConnection();
+  std::string           err;
+  std::vector<BSONObj>  results;
+  unsigned int          docs = 0;
 
-  if (!collectionQuery(connection, getEntitiesCollectionName(tenant), query, &cursor, &err))
+  if (cacheHit)
   {
-    releaseMongoConnection(connection);
-    TIME_STAT_MONGO_READ_WAIT_STOP();
-    buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
-    responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
-
-    return;
+    LM_T(LmtEntityCache, ("entity '%s' taken from entity cache", enP->id.c_str()));
+    results.push_back(cachedDoc);
   }
-  TIME_STAT_MONGO_READ_WAIT_STOP();
-
-  //
-  // Going through the list of found entities.
-  // As ServicePath cannot be modified, inside this loop nothing will be done
-  // about ServicePath (The ServicePath was present in the mongo query to obtain the list)
-  //
-  // FIXME P6: Once we allow for ServicePath to be modified, this loop must be looked at.
-  //
-
-  std::vector<BSONObj> results;
-  unsigned int         docs = 0;
-
-  while (moreSafe(cursor))
+  else
   {
-    BSONObj r;
+    unsigned long long cacheEpoch = cacheable? entityCacheEpoch(tenant, servicePathV[0], enP->id, enP->type) : 0;
 
-    if (!nextSafeOrErrorF(cursor, &r, &err))
-    {
-      LM_E(("Runtime Error (exception in nextSafe(): %s - query: %s)", err.c_str(), query.toString().c_str()));
-      continue;
-    }
+    TIME_STAT_MONGO_READ_WAIT_START();
+    DBClientBase* connection = getMongoConnection();
 
-    docs++;
-    LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
+    if (!collectionQuery(connection, getEntitiesCollectionName(tenant), query, &cursor, &err))
+    {
+      releaseMongoConnection(connection);
+      TIME_STAT_MONGO_READ_WAIT_STOP();
+      buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
+      responseP->oe.fill(SccReceiverInternalError, err, "InternalServerError");
 
-    BSONElement idField = getFieldF(r, "_id");
+      return;
+    }
+    TIME_STAT_MONGO_READ_WAIT_STOP();
 
     //
-    // BSONElement::eoo returns true if 'not found', i.e. the field "_id" doesn't exist in 'sub'
+    // Going through the list of found entities.
+    // As ServicePath cannot be modified, inside this loop nothing will be done
+    // about ServicePath (The ServicePath was present in the mongo query to obtain the list)
     //
-    // Now, if 'getFieldF(r, "_id")' is not found, if we continue, calling embeddedObject() on it, then we get
-    // an exception and the broker crashes.
+    // FIXME P6: Once we allow for ServicePath to be modified, this loop must be looked at.
     //
-    if (idField.eoo() == true)
+    while (moreSafe(cursor))
     {
-      std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
-      alarmMgr.dbError(details);
-      continue;
+      BSONObj r;
+
+      if (!nextSafeOrErrorF(cursor, &r, &err))
+      {
+        LM_E(("Runtime Error (exception in nextSafe(): %s - query: %s)", err.c_str(), query.toString().c_str()));
+        continue;
+      }
+
+      docs++;
+      LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
+
+      BSONElement idField = getFieldF(r, "_id");
+
+      //
+      // BSONElement::eoo returns true if 'not found', i.e. the field "_id" doesn't exist in 'sub'
+      //
+      // Now, if 'getFieldF(r, "_id")' is not found, if we continue, calling embeddedObject() on it, then we get
+      // an exception and the broker crashes.
+      //
+      if (idField.eoo() == true)
+      {
+        std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
+        alarmMgr.dbError(details);
+        continue;
+      }
+
+      //
+      // We need to use getOwned() here, otherwise we have empirically found that bad things may happen with long BSONObjs
+      // (see http://stackoverflow.com/questions/36917731/context-broker-crashing-with-certain-update-queries)
+      //
+      results.push_back(r.getOwned());
     }
 
-    //
-    // We need to use getOwned() here, otherwise we have empirically found that bad things may happen with long BSONObjs
-    // (see http://stackoverflow.com/questions/36917731/context-broker-crashing-with-certain-update-queries)
-    //
-    results.push_back(r.getOwned());
-  }
+    releaseMongoConnection(connection);
 
-  releaseMongoConnection(connection);
+    if (cacheable && (results.size() == 1))
+    {
+      entityCacheFill(tenant, results[0], cacheEpoch);
+    }
+  }
 
   LM_T(LmtServicePath, ("Docs found: %d", results.size()));
 
@@ -3806,7 +4518,8 @@ void processContextElement
                  &attributeAlreadyExistsList,
                  apiVersion,
                  fiwareCorrelator,
-                 ngsiV2AttrsFormat);
+                 ngsiV2AttrsFormat,
+                 batchP);
   }
 
   /*
@@ -3900,7 +4613,8 @@ void processContextElement
                                        subsToNotify,
                                        err,
                                        tenant,
-                                       servicePathV))
+                                       servicePathV,
+                                       xauthToken))
         {
           releaseTriggeredSubscriptions(&subsToNotify);
           cerP->statusCode.fill(SccReceiverInternalError, err);
@@ -3931,7 +4645,7 @@ void processContextElement
         }
 
         notifyCerP->contextElement.entityId.servicePath = servicePathV.size() > 0? servicePathV[0] : "";
-        processSubscriptions(subsToNotify, notifyCerP, &errReason, tenant, xauthToken, fiwareCorrelator);
+        processSubscriptions(subsToNotify, notifyCerP, &errReason, tenant, xauthToken, fiwareCorrelator, batchP);
 
         notifyCerP->release();
         delete notifyCerP;
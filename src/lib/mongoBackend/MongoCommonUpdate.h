@@ -36,6 +36,69 @@
 
 
 
+/* ****************************************************************************
+*
+* updateFastPathCounters - updates done in one round trip and fallbacks to the regular path
+*
+* A fallback is counted when the single round-trip update was tried but its condition
+* didn't hold (e.g. a value not changing or an attribute not existing).
+*/
+extern void updateFastPathCounters(unsigned long long* updatesP, unsigned long long* fallbacksP);
+
+
+
+/* ****************************************************************************
+*
+* NotificationBatch - notifications of a batch update, grouped by subscription
+*
+* Instead of one notification per updated entity, each subscription gets one notification
+* with all the entities of the request (split if exceeding -notifBatchMaxSize).
+*/
+struct BatchedNotification;
+
+typedef struct NotificationBatch
+{
+  std::map<std::string, BatchedNotification*>  subs;
+} NotificationBatch;
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchInit -
+*
+* maxSize is the maximum size (in bytes) of the entities of a batch notification. 0
+* disables batching.
+*/
+extern void notificationBatchInit(unsigned int maxSize);
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchEnabled -
+*/
+extern bool notificationBatchEnabled(void);
+
+
+
+/* ****************************************************************************
+*
+* notificationBatchFlush - send the pending notifications of a batch
+*
+* Each subscription gets its lastNotification and count updated, the latter by the number
+* of notifications sent.
+*/
+extern void notificationBatchFlush
+(
+  NotificationBatch*  batchP,
+  const std::string&  tenant,
+  const std::string&  xauthToken,
+  const std::string&  fiwareCorrelator
+);
+
+
+
 /* ****************************************************************************
 *
 * processContextElement -
@@ -52,7 +115,8 @@ extern void processContextElement
   const std::string&                   fiwareCorrelator,
   const std::string&                   ngsiV2AttrsFormat,
   ApiVersion                           apiVersion       = V1,
-  Ngsiv2Flavour                        ngsiV2Flavour    = NGSIV2_NO_FLAVOUR
+  Ngsiv2Flavour                        ngsiV2Flavour    = NGSIV2_NO_FLAVOUR,
+  NotificationBatch*                   batchP           = NULL
 );
 
 #endif  // SRC_LIB_MONGOBACKEND_MONGOCOMMONUPDATE_H_
@@ -24,7 +24,6 @@
 */
 #include <stdint.h>   // int64_t et al
 #include <semaphore.h>
-#include <regex.h>
 
 #include <string>
 #include <vector>
@@ -38,11 +37,13 @@
 
 #include "common/limits.h"
 #include "common/globals.h"
+#include "common/defaultValues.h"
 #include "common/sem.h"
 #include "common/string.h"
 #include "common/wsStrip.h"
 #include "common/statistics.h"
 #include "common/RenderFormat.h"
+#include "common/regexCache.h"
 #include "alarmMgr/alarmMgr.h"
 
 #include "orionTypes/OrionValueType.h"
@@ -55,6 +56,8 @@
 #include "ngsi/Restriction.h"
 #include "ngsiNotify/Notifier.h"
 #include "rest/StringFilter.h"
+#include "cache/entityCache.h"
+#include "cache/regCache.h"
 #include "apiTypesV2/Subscription.h"
 #include "apiTypesV2/ngsiWrappers.h"
 
@@ -64,6 +67,10 @@
 #include "mongoBackend/dbConstants.h"
 #include "mongoBackend/dbFieldEncoding.h"
 #include "mongoBackend/compoundResponses.h"
+#include "mongoBackend/pageCursor.h"
+#include "mongoBackend/tenantContext.h"
+#include "mongoBackend/entityJsonRender.h"
+#include "mongoBackend/initialNotification.h"
 #include "mongoBackend/MongoGlobal.h"
 
 
@@ -99,6 +106,7 @@ static std::string          subscribeContextCollectionName;
 static std::string          subscribeContextAvailabilityCollectionName;
 static Notifier*            notifier;
 static bool                 multitenant;
+static bool                 servicePathIndex = false;
 
 
 
@@ -197,6 +205,30 @@ bool mongoMultitenant(void)
 
 
 
+/* ****************************************************************************
+*
+* mongoServicePathIndex -
+*/
+bool mongoServicePathIndex(void)
+{
+  return servicePathIndex;
+}
+
+
+
+/* ****************************************************************************
+*
+* setServicePathIndex -
+*
+* To be called before mongoInit(), so the index is created for the existing tenants
+*/
+void setServicePathIndex(bool enabled)
+{
+  servicePathIndex = enabled;
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoInit -
@@ -243,8 +275,7 @@ void mongoInit
   // "If you call multiple ensureIndex() methods with the same index specification at the same time,
   // only the first operation will succeed, all other operations will have no effect."
   //
-  ensureLocationIndex("");
-  ensureDateExpirationIndex("");
+  ensureEntityIndexes("");
   if (mtenant)
   {
     /* We get tenant database names and apply ensure the location and date expiration indexes in each one */
@@ -256,8 +287,7 @@ void mongoInit
     {
       std::string orionDb = orionDbs[ix];
       std::string tenant = orionDb.substr(dbName.length() + 1);   // + 1 for the "_" in "orion_tenantA"
-      ensureLocationIndex(tenant);
-      ensureDateExpirationIndex(tenant);
+      ensureEntityIndexes(tenant);
     }
   }
 }
@@ -361,6 +391,17 @@ void setMongoConnectionForUnitTest(DBClientBase* _connection)
 
 
 
+/* ****************************************************************************
+*
+* setMultitenantForUnitTest -
+*/
+void setMultitenantForUnitTest(bool _multitenant)
+{
+  multitenant = _multitenant;
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoInitialConnectionGetForUnitTest -
@@ -445,6 +486,7 @@ void setNotifier(Notifier* n)
 void setDbPrefix(const std::string& _dbPrefix)
 {
   dbPrefix = _dbPrefix;
+  tenantContextNamesReset();
   LM_T(LmtBug, ("Set dbPrefix to '%s'", dbPrefix.c_str()));
 }
 
@@ -533,6 +575,7 @@ std::string tenantFromDb(const std::string& database)
 void setEntitiesCollectionName(const std::string& name)
 {
   entitiesCollectionName = name;
+  tenantContextNamesReset();
 }
 
 
@@ -544,6 +587,7 @@ void setEntitiesCollectionName(const std::string& name)
 void setRegistrationsCollectionName(const std::string& name)
 {
   registrationsCollectionName = name;
+  tenantContextNamesReset();
 }
 
 
@@ -555,6 +599,7 @@ void setRegistrationsCollectionName(const std::string& name)
 void setSubscribeContextCollectionName(const std::string& name)
 {
   subscribeContextCollectionName = name;
+  tenantContextNamesReset();
 }
 
 
@@ -566,20 +611,11 @@ void setSubscribeContextCollectionName(const std::string& name)
 void setSubscribeContextAvailabilityCollectionName(const std::string& name)
 {
   subscribeContextAvailabilityCollectionName = name;
+  tenantContextNamesReset();
 }
 
 
 
-/* ***************************************************************************
-*
-* composeCollectionName -
-*
-* Common helper function for composing collection names
-*/
-static std::string composeCollectionName(std::string tenant, std::string colName)
-{
-  return composeDatabaseName(tenant) + "." + colName;
-}
 
 
 
@@ -610,13 +646,61 @@ std::string composeDatabaseName(const std::string& tenant)
 
 
 
+/* ***************************************************************************
+*
+* composeCollectionName -
+*/
+std::string composeCollectionName(const std::string& tenant, TenantCollection collection)
+{
+  const std::string* colNameP;
+
+  switch (collection)
+  {
+  case ColEntities:       colNameP = &entitiesCollectionName;                      break;
+  case ColRegistrations:  colNameP = &registrationsCollectionName;                 break;
+  case ColCsubs:          colNameP = &subscribeContextCollectionName;              break;
+  default:                colNameP = &subscribeContextAvailabilityCollectionName;  break;
+  }
+
+  return composeDatabaseName(tenant) + "." + *colNameP;
+}
+
+
+
+/* ***************************************************************************
+*
+* tenantContext -
+*
+* Without multitenancy all the tenants use the same database, so the default tenant
+* context is used
+*/
+static TenantContext* tenantContext(const std::string& tenant)
+{
+  static const std::string noTenant = "";
+
+  return tenantContextGet(multitenant? tenant : noTenant);
+}
+
+
+
+/* ***************************************************************************
+*
+* getDatabaseName -
+*/
+const std::string& getDatabaseName(const std::string& tenant)
+{
+  return tenantContext(tenant)->dbName;
+}
+
+
+
 /* ***************************************************************************
 *
 * getEntitiesCollectionName -
 */
-std::string getEntitiesCollectionName(const std::string& tenant)
+const std::string& getEntitiesCollectionName(const std::string& tenant)
 {
-  return composeCollectionName(tenant, entitiesCollectionName);
+  return tenantContext(tenant)->entitiesCollection;
 }
 
 
@@ -625,9 +709,9 @@ std::string getEntitiesCollectionName(const std::string& tenant)
 *
 * getRegistrationsCollectionName -
 */
-std::string getRegistrationsCollectionName(const std::string& tenant)
+const std::string& getRegistrationsCollectionName(const std::string& tenant)
 {
-  return composeCollectionName(tenant, registrationsCollectionName);
+  return tenantContext(tenant)->registrationsCollection;
 }
 
 
@@ -636,9 +720,9 @@ std::string getRegistrationsCollectionName(const std::string& tenant)
 *
 * getSubscribeContextCollectionName -
 */
-std::string getSubscribeContextCollectionName(const std::string& tenant)
+const std::string& getSubscribeContextCollectionName(const std::string& tenant)
 {
-  return composeCollectionName(tenant, subscribeContextCollectionName);
+  return tenantContext(tenant)->csubsCollection;
 }
 
 
@@ -647,9 +731,9 @@ std::string getSubscribeContextCollectionName(const std::string& tenant)
 *
 * getSubscribeContextAvailabilityCollectionName -
 */
-std::string getSubscribeContextAvailabilityCollectionName(const std::string& tenant)
+const std::string& getSubscribeContextAvailabilityCollectionName(const std::string& tenant)
 {
-  return composeCollectionName(tenant, subscribeContextAvailabilityCollectionName);
+  return tenantContext(tenant)->casubsCollection;
 }
 
 
@@ -693,7 +777,7 @@ bool mongoExpirationCapable(void)
 *
 * ensureLocationIndex -
 */
-void ensureLocationIndex(const std::string& tenant)
+bool ensureLocationIndex(const std::string& tenant)
 {
   /* Ensure index for entity locations, in the case of using 2.4 */
   if (mongoLocationCapable())
@@ -701,9 +785,11 @@ void ensureLocationIndex(const std::string& tenant)
     std::string index = ENT_LOCATION "." ENT_LOCATION_COORDS;
     std::string err;
 
-    collectionCreateIndex(getEntitiesCollectionName(tenant), BSON(index << "2dsphere"), false, &err);
     LM_T(LmtMongo, ("ensuring 2dsphere index on %s (tenant %s)", index.c_str(), tenant.c_str()));
+    return collectionCreateIndex(getEntitiesCollectionName(tenant), BSON(index << "2dsphere"), false, &err);
   }
+
+  return true;
 }
 
 
@@ -712,7 +798,7 @@ void ensureLocationIndex(const std::string& tenant)
  *
  * ensureDateExpirationIndex -
  */
-void ensureDateExpirationIndex(const std::string& tenant)
+bool ensureDateExpirationIndex(const std::string& tenant)
 {
   /* Ensure index for entity expiration, in the case of using 2.4 */
   if (mongoExpirationCapable())
@@ -720,9 +806,77 @@ void ensureDateExpirationIndex(const std::string& tenant)
     std::string index = ENT_EXPIRATION;
     std::string err;
 
-    collectionCreateIndex(getEntitiesCollectionName(tenant), BSON(index << 1), true, &err);
     LM_T(LmtMongo, ("ensuring TTL date expiration index on %s (tenant %s)", index.c_str(), tenant.c_str()));
+    return collectionCreateIndex(getEntitiesCollectionName(tenant), BSON(index << 1), true, &err);
   }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* ensureServicePathIndex -
+*
+* Only with -servicePathIndex: the multikey index on the servicePath scopes of the
+* entities and the index on the servicePath of the subscriptions (the no-cache lookup
+* of triggered subscriptions matches it by equality)
+*/
+bool ensureServicePathIndex(const std::string& tenant)
+{
+  if (!servicePathIndex)
+  {
+    return true;
+  }
+
+  std::string err;
+
+  LM_T(LmtMongo, ("ensuring servicePath indexes (tenant %s)", tenant.c_str()));
+
+  bool entitiesOk = collectionCreateIndex(getEntitiesCollectionName(tenant), BSON(ENT_SERVICE_PATH_SCOPES << 1), false, &err);
+  bool csubsOk    = collectionCreateIndex(getSubscribeContextCollectionName(tenant), BSON(CSUB_SERVICE_PATH << 1), false, &err);
+
+  return entitiesOk && csubsOk;
+}
+
+
+
+/* ****************************************************************************
+*
+* ensureEntityIndexes -
+*
+* Index creation is idempotent, so two threads creating the first entities of a tenant
+* at the same time could both create the indexes without any problem
+*/
+void ensureEntityIndexes(const std::string& tenant)
+{
+  TenantContext* tcP = tenantContext(tenant);
+
+  if (tcP->entityIndexesEnsured)
+  {
+    return;
+  }
+
+  bool locationOk   = ensureLocationIndex(tenant);
+  bool expirationOk = ensureDateExpirationIndex(tenant);
+  bool spOk         = ensureServicePathIndex(tenant);
+
+  if (locationOk && expirationOk && spOk)
+  {
+    tcP->entityIndexesEnsured = true;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* entityIndexesInvalidate -
+*/
+void entityIndexesInvalidate(const std::string& tenant)
+{
+  tenantContext(tenant)->entityIndexesEnsured = false;
 }
 /* ****************************************************************************
 *
@@ -738,19 +892,19 @@ bool matchEntity(const EntityId* en1, const EntityId* en2)
 
   if (isTrue(en2->isPattern))
   {
-    regex_t regex;
+    CachedRegex* regexP = regexCacheGet(en2->id);
 
     idMatch = false;
-    if (regcomp(&regex, en2->id.c_str(), REG_EXTENDED) != 0)
+    if (regexP == NULL)
     {
       std::string details = std::string("error compiling regex for id: '") + en2->id + "'";
       alarmMgr.badInput(clientIp, details);
     }
     else
     {
-      idMatch = (regexec(&regex, en1->id.c_str(), 0, NULL, 0) == 0);
+      idMatch = regexCacheMatch(regexP, en1->id.c_str());
 
-      regfree(&regex);  // If regcomp fails it frees up itself (see glibc sources for details)
+      regexCacheRelease(regexP);
     }
   }
   else  /* isPattern == false */
@@ -929,6 +1083,96 @@ BSONObj fillQueryServicePath(const std::vector<std::string>& servicePath)
 
 
 
+/* ****************************************************************************
+*
+* servicePathScopes -
+*
+* The servicePath tokens an entity in the given servicePath matches: the recursive
+* form of every ancestor (itself included) plus the exact servicePath. For instance,
+* for "/a/b" the scopes are [ "/#", "/a/#", "/a/b/#", "/a/b" ].
+*
+* Stored in the entity document, any Fiware-ServicePath token (exact or recursive) is
+* resolved by equality on this array, so the multikey index on it is used instead of
+* scanning with regular expressions.
+*/
+BSONArray servicePathScopes(const std::string& servicePath)
+{
+  BSONArrayBuilder  ba;
+  std::string       sp = (servicePath == "")? SERVICE_PATH_ROOT : servicePath;
+
+  ba.append(std::string(SERVICE_PATH_ALL));
+
+  if (sp != SERVICE_PATH_ROOT)
+  {
+    for (unsigned int ix = 1; ix < sp.size(); ++ix)
+    {
+      if (sp[ix] == '/')
+      {
+        ba.append(sp.substr(0, ix) + "/#");
+      }
+    }
+
+    ba.append(sp + "/#");
+  }
+
+  ba.append(sp);
+
+  return ba.arr();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityServicePathField -
+*
+* The field of the entities collection the servicePath filter built by
+* fillQueryEntityServicePath() applies to
+*/
+const char* entityServicePathField(void)
+{
+  return servicePathIndex? ENT_SERVICE_PATH_SCOPES : "_id." ENT_SERVICE_PATH;
+}
+
+
+
+/* ****************************************************************************
+*
+* fillQueryEntityServicePath -
+*
+* Same as fillQueryServicePath(), but using the servicePath scopes of the entities
+* (see servicePathScopes()) when the -servicePathIndex option is used.
+*/
+BSONObj fillQueryEntityServicePath(const std::vector<std::string>& servicePath)
+{
+  if (!servicePathIndex)
+  {
+    return fillQueryServicePath(servicePath);
+  }
+
+  BSONArrayBuilder ba;
+
+  if (servicePath[0] == "")
+  {
+    ba.append(std::string(SERVICE_PATH_ALL));
+  }
+  else
+  {
+    for (unsigned int ix = 0; ix < servicePath.size(); ++ix)
+    {
+      ba.append(servicePath[ix]);
+    }
+  }
+
+  BSONObj spQuery = BSON("$in" << ba.arr());
+
+  LM_T(LmtServicePath, ("Service Path scopes query: '%s'", spQuery.toString().c_str()));
+
+  return spQuery;
+}
+
+
+
 /* *****************************************************************************
 *
 * processAreaScope -
@@ -1234,6 +1478,169 @@ static bool isCustomAttr(std::string attrName)
 
 
 
+/* ****************************************************************************
+*
+* entityDocToCer -
+*
+* Builds the CER corresponding to an entity document retrieved from DB (or from the entity cache)
+*/
+static ContextElementResponse* entityDocToCer
+(
+  const BSONObj&     r,
+  const StringList&  attrL,
+  const StringList&  metadataList,
+  bool               includeEmpty,
+  ApiVersion         apiVersion
+)
+{
+  ContextElementResponse*  cer = new ContextElementResponse(r, attrL, includeEmpty, apiVersion);
+
+  addDatesForAttrs(cer, metadataList.lookup(NGSI_MD_DATECREATED), metadataList.lookup(NGSI_MD_DATEMODIFIED));
+
+  /* All the attributes existing in the request but not found in the response are added with 'found' set to false */
+  for (unsigned int ix = 0; ix < attrL.size(); ++ix)
+  {
+    bool         found     = false;
+    std::string  attrName  = attrL[ix];
+
+    /* The special case "*" is not taken into account*/
+    if (attrName == ALL_ATTRS)
+    {
+      continue;
+    }
+
+    for (unsigned int jx = 0; jx < cer->contextElement.contextAttributeVector.size(); ++jx)
+    {
+      if (attrName == cer->contextElement.contextAttributeVector[jx]->name)
+      {
+        found = true;
+        break;
+      }
+    }
+
+    if (!found)
+    {
+      ContextAttribute* caP = new ContextAttribute(attrName, "", "", false);
+      cer->contextElement.contextAttributeVector.push_back(caP);
+    }
+  }
+
+  cer->statusCode.fill(SccOk);
+
+  return cer;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityDocToRenderedCer -
+*
+* CER holding the entity already rendered in JSON and no attributes at all. Returns NULL if the
+* document cannot be transcoded, so entityDocToCer() has to be used.
+*/
+static ContextElementResponse* entityDocToRenderedCer(const BSONObj& r, const EntityJsonRender& params)
+{
+  std::string json;
+
+  if (!entityDocToJson(r, params, &json))
+  {
+    return NULL;
+  }
+
+  ContextElementResponse*  cerP = new ContextElementResponse();
+  BSONObj                  id   = getFieldF(r, "_id").embeddedObject();
+
+  cerP->contextElement.entityId.fill(getStringFieldF(id, ENT_ENTITY_ID),
+                                     id.hasField(ENT_ENTITY_TYPE)? getStringFieldF(id, ENT_ENTITY_TYPE) : "",
+                                     "false");
+  cerP->contextElement.entityId.servicePath = id.hasField(ENT_SERVICE_PATH)? getStringFieldF(id, ENT_SERVICE_PATH) : "";
+  cerP->renderedJson = json;
+  cerP->statusCode.fill(SccOk);
+
+  return cerP;
+}
+
+
+
+/* ****************************************************************************
+*
+* entitiesQueryFromCache -
+*
+* Single entity queries (no patterns, type and non-recursive service path included, no scopes)
+* may be solved by the entity cache. Returns true if the query was solved this way.
+*/
+static bool entitiesQueryFromCache
+(
+  const EntityIdVector&            enV,
+  const StringList&                attrL,
+  const StringList&                metadataList,
+  ContextElementResponseVector*    cerV,
+  bool                             includeEmpty,
+  const std::string&               tenant,
+  const std::vector<std::string>&  servicePath,
+  int                              limit,
+  bool*                            limitReached,
+  long long*                       countP,
+  ApiVersion                       apiVersion
+)
+{
+  BSONObj doc;
+
+  if (!entityCacheLookup(tenant, servicePath[0], enV[0]->id, enV[0]->type, &doc))
+  {
+    return false;
+  }
+
+  /* Same semantics as the attrNames $in part of the DB query */
+  bool       attrsFilter = false;
+  bool       attrMatch   = false;
+  BSONObj    attrNames   = getObjectFieldF(doc, ENT_ATTRNAMES);
+
+  for (unsigned int ix = 0; (ix < attrL.size()) && !attrMatch; ++ix)
+  {
+    if (isCustomAttr(attrL[ix]))
+    {
+      continue;
+    }
+
+    attrsFilter = true;
+
+    for (BSONObj::iterator i = attrNames.begin(); i.more();)
+    {
+      BSONElement e = i.next();
+
+      if ((e.type() == mongo::String) && (e.String() == attrL[ix]))
+      {
+        attrMatch = true;
+        break;
+      }
+    }
+  }
+
+  if (attrsFilter && !attrMatch)
+  {
+    // Let the DB solve it, so not-found entities are processed in the usual way
+    return false;
+  }
+
+  if (countP != NULL)
+  {
+    *countP = 1;
+  }
+
+  cerV->push_back(entityDocToCer(doc, attrL, metadataList, includeEmpty, apiVersion));
+
+  if (limitReached != NULL)
+  {
+    *limitReached = (cerV->size() >= (unsigned int) limit);
+  }
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * entitiesQuery -
@@ -1264,7 +1671,10 @@ bool entitiesQuery
   bool*                            limitReached,
   long long*                       countP,
   const std::string&               sortOrderList,
-  ApiVersion                       apiVersion
+  ApiVersion                       apiVersion,
+  const std::string&               pageCursor,
+  std::string*                     nextPageCursor,
+  const EntityJsonRender*          jsonRenderP
 )
 {
   /* Query structure is as follows
@@ -1278,6 +1688,24 @@ bool entitiesQuery
    *
    */
 
+  bool                keyset     = (nextPageCursor != NULL);
+  bool                cacheable  = (keyset == false) && (enV.size() == 1) &&
+                                   (res.scopeVector.size() == 0) &&
+                                   (offset == 0) && (limit > 0) &&
+                                   entityCacheKeyUsable(enV[0]->id, enV[0]->isPatternIsTrue(), enV[0]->type, enV[0]->isTypePattern, servicePath);
+  unsigned long long  cacheEpoch = 0;
+  BSONObj             cacheCandidate;
+
+  if (cacheable)
+  {
+    if (entitiesQueryFromCache(enV, attrL, metadataList, cerV, includeEmpty, tenant, servicePath, limit, limitReached, countP, apiVersion))
+    {
+      return true;
+    }
+
+    cacheEpoch = entityCacheEpoch(tenant, servicePath[0], enV[0]->id, enV[0]->type);
+  }
+
   BSONObjBuilder    finalQuery;
   BSONArrayBuilder  orEnt;
 
@@ -1292,9 +1720,7 @@ bool entitiesQuery
   finalQuery.append("$or", orEnt.arr());
 
   /* Part 2: service path */
-  const std::string  servicePathString = "_id." ENT_SERVICE_PATH;
-
-  finalQuery.append(servicePathString, fillQueryServicePath(servicePath));
+  finalQuery.append(entityServicePathField(), fillQueryEntityServicePath(servicePath));
 
   /* Part 3: attributes */
   BSONArrayBuilder attrs;
@@ -1398,9 +1824,54 @@ bool entitiesQuery
 
   /* Do the query on MongoDB */
   std::auto_ptr<DBClientCursor>  cursor;
-  Query                          query(finalQuery.obj());
+  BSONObj                        filter = finalQuery.obj();
+  Query                          query(filter);
+
+  if (keyset)
+  {
+    //
+    // Keyset pagination: the page is the range after the last entity of the previous page,
+    // in {creDate, _id} order, so it can be solved with an index range scan whatever the
+    // page depth is. The entities filter already uses $or, so $and is needed to combine
+    // it with the range.
+    //
+    if (pageCursor != "")
+    {
+      BSONObj  key;
+
+      if (!pageCursorDecode(pageCursor, &key) || !key.hasField("c") || !key.hasField("i"))
+      {
+        *err = "invalid pagination cursor";
+        return false;
+      }
+
+      BSONObjBuilder  creDateGt;
+      BSONObjBuilder  idGt;
+      BSONObjBuilder  afterCreDate;
+      BSONObjBuilder  afterId;
+
+      // Entities without creDate (very old ones) come first, as null is lower than any number
+      if (key.getField("c").isNull())
+      {
+        creDateGt.appendNull("$ne");
+      }
+      else
+      {
+        creDateGt.appendAs(key.getField("c"), "$gt");
+      }
+      idGt.appendAs(key.getField("i"), "$gt");
+
+      afterCreDate.append(ENT_CREATION_DATE, creDateGt.obj());
+      afterId.appendAs(key.getField("c"), ENT_CREATION_DATE);
+      afterId.append("_id", idGt.obj());
 
-  if (sortOrderList == "")
+      query = Query(BSON("$and" << BSON_ARRAY(filter << BSON("$or" << BSON_ARRAY(afterCreDate.obj() << afterId.obj())))));
+    }
+
+    query.sort(BSON(ENT_CREATION_DATE << 1 << "_id" << 1));
+    offset = 0;
+  }
+  else if (sortOrderList == "")
   {
     query.sort(BSON(ENT_CREATION_DATE << 1));
   }
@@ -1442,16 +1913,26 @@ bool entitiesQuery
   TIME_STAT_MONGO_READ_WAIT_START();
   DBClientBase* connection = getMongoConnection();
 
-  if (!collectionRangedQuery(connection, getEntitiesCollectionName(tenant), query, limit, offset, &cursor, countP, err))
+  if (!collectionRangedQuery(connection,
+                             getEntitiesCollectionName(tenant),
+                             query,
+                             limit,
+                             offset,
+                             &cursor,
+                             countP,
+                             err,
+                             keyset? &filter : NULL))
   {
     releaseMongoConnection(connection);
     TIME_STAT_MONGO_READ_WAIT_STOP();
+    entityIndexesInvalidate(tenant);  // e.g. a geo-query failing due to the database being dropped
     return false;
   }
   TIME_STAT_MONGO_READ_WAIT_STOP();
 
   /* Process query result */
-  unsigned int docs = 0;
+  unsigned int  docs = 0;
+  BSONObj       lastKey;
 
   while (moreSafe(cursor))
   {
@@ -1532,43 +2013,50 @@ bool entitiesQuery
     // Build CER from BSON retrieved from DB
     docs++;
     LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
-    ContextElementResponse*  cer = new ContextElementResponse(r, attrL, includeEmpty, apiVersion);
+    ContextElementResponse* cerP = (jsonRenderP != NULL)? entityDocToRenderedCer(r, *jsonRenderP) : NULL;
 
-    addDatesForAttrs(cer, metadataList.lookup(NGSI_MD_DATECREATED), metadataList.lookup(NGSI_MD_DATEMODIFIED));
+    if (cerP == NULL)
+    {
+      cerP = entityDocToCer(r, attrL, metadataList, includeEmpty, apiVersion);
+    }
+    cerV->push_back(cerP);
 
-    /* All the attributes existing in the request but not found in the response are added with 'found' set to false */
-    for (unsigned int ix = 0; ix < attrL.size(); ++ix)
+    if (cacheable && (docs == 1))
     {
-      bool         found     = false;
-      std::string  attrName  = attrL[ix];
+      cacheCandidate = r.getOwned();
+    }
 
-      /* The special case "*" is not taken into account*/
-      if (attrName == ALL_ATTRS)
-      {
-        continue;
-      }
+    if (keyset)
+    {
+      BSONObjBuilder  keyBuilder;
+      BSONElement     creDate = r.getField(ENT_CREATION_DATE);
 
-      for (unsigned int jx = 0; jx < cer->contextElement.contextAttributeVector.size(); ++jx)
+      if (creDate.eoo())
       {
-        if (attrName == cer->contextElement.contextAttributeVector[jx]->name)
-        {
-          found = true;
-          break;
-        }
+        keyBuilder.appendNull("c");
       }
-
-      if (!found)
+      else
       {
-        ContextAttribute* caP = new ContextAttribute(attrName, "", "", false);
-        cer->contextElement.contextAttributeVector.push_back(caP);
+        keyBuilder.appendAs(creDate, "c");
       }
-    }
+      keyBuilder.appendAs(r.getField("_id"), "i");
 
-    cer->statusCode.fill(SccOk);
-    cerV->push_back(cer);
+      lastKey = keyBuilder.obj();
+    }
   }
   releaseMongoConnection(connection);
 
+  if (keyset)
+  {
+    // A full page means that there could be more entities after it
+    *nextPageCursor = ((limit > 0) && (docs == (unsigned int) limit))? pageCursorEncode(lastKey) : "";
+  }
+
+  if (cacheable && (docs == 1))
+  {
+    entityCacheFill(tenant, cacheCandidate, cacheEpoch);
+  }
+
   /* If we have already reached the pagination limit with local entities, we have ended: no more "potential"
    * entities are added. Only if limitReached is being used, i.e. not NULL
    * FIXME P10 (it is easy :) limit should be unsigned int */
@@ -1654,6 +2142,7 @@ void pruneContextElements(const ContextElementResponseVector& oldCerV, ContextEl
     // FIXME P10: not sure if this is the right way to do it, maybe we need a fill() method for this
     newCerP->contextElement.providingApplicationList = cerP->contextElement.providingApplicationList;
     newCerP->statusCode.fill(&cerP->statusCode);
+    newCerP->renderedJson = cerP->renderedJson;
 
     bool pruneEntity = cerP->prune;
 
@@ -1801,6 +2290,29 @@ static void processContextRegistrationElement
 
 
 
+/* ****************************************************************************
+*
+* processRegistration -
+*/
+static void processRegistration
+(
+  const BSONObj&                      r,
+  const EntityIdVector&               enV,
+  const StringList&                   attrL,
+  ContextRegistrationResponseVector*  crrV
+)
+{
+  MimeType                  mimeType = JSON;
+  std::vector<BSONElement>  queryContextRegistrationV = getFieldF(r, REG_CONTEXT_REGISTRATION).Array();
+
+  for (unsigned int ix = 0 ; ix < queryContextRegistrationV.size(); ++ix)
+  {
+    processContextRegistrationElement(queryContextRegistrationV[ix].embeddedObject(), enV, attrL, crrV, mimeType);
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * registrationsQuery -
@@ -1823,6 +2335,31 @@ bool registrationsQuery
   long long*                          countP
 )
 {
+  /* Registration cache first. Same result than the DB query (see below) but without DB round-trip */
+  std::vector<BSONObj> regV;
+
+  if (regCacheMatch(tenant, enV, attrL, servicePathV, &regV))
+  {
+    LM_T(LmtPagination, ("Offset: %d, Limit: %d, Details: %s", offset, limit, (details == true)? "true" : "false"));
+
+    if (countP != NULL)
+    {
+      *countP = regV.size();
+    }
+
+    for (unsigned int ix = offset; ix < regV.size(); ++ix)
+    {
+      if ((limit != 0) && (ix >= (unsigned int) (offset + limit)))
+      {
+        break;
+      }
+
+      processRegistration(regV[ix], enV, attrL, crrV);
+    }
+
+    return true;
+  }
+
   /* Build query based on arguments */
   // FIXME P2: this implementation needs to be refactored for cleanup
   std::string       contextRegistrationEntities     = REG_CONTEXT_REGISTRATION "." REG_ENTITIES;
@@ -1942,13 +2479,7 @@ bool registrationsQuery
     docs++;
     LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
 
-    MimeType                  mimeType = JSON;
-    std::vector<BSONElement>  queryContextRegistrationV = getFieldF(r, REG_CONTEXT_REGISTRATION).Array();
-
-    for (unsigned int ix = 0 ; ix < queryContextRegistrationV.size(); ++ix)
-    {
-      processContextRegistrationElement(queryContextRegistrationV[ix].embeddedObject(), enV, attrL, crrV, mimeType);
-    }
+    processRegistration(r, enV, attrL, crrV);
 
     /* FIXME: note that given the response doesn't distinguish from which registration ID the
      * response comes, it could have that we have same context registration elements, belong to different
@@ -2122,6 +2653,10 @@ static void setOnSubscriptionMetadata(ContextElementResponseVector* cerVP)
 * This method returns true if the notification was actually send. Otherwise, false
 * is returned. This is used in the caller to know if lastNotification field in the
 * subscription document in csubs collection has to be modified or not.
+*
+* With background initial notifications (see initialNotificationInit()) the notification
+* is not sent here but a job is created for it, so false is returned. The job updates
+* lastNotification and count by itself.
 */
 static bool processOnChangeConditionForSubscription
 (
@@ -2147,6 +2682,25 @@ static bool processOnChangeConditionForSubscription
   StringList                    emptyList;
   StringList                    metadataList;
 
+  if (initialNotificationBackground() &&
+      initialNotificationJobAdd(subId,
+                                enV,
+                                attrL,
+                                metadataV,
+                                *condValues,
+                                notifyHttpInfo,
+                                renderFormat,
+                                tenant,
+                                xauthToken,
+                                servicePathV,
+                                *resP,
+                                fiwareCorrelator,
+                                attrsOrder,
+                                blacklist))
+  {
+    return false;
+  }
+
   metadataList.fill(metadataV);
   if (!blacklist && !entitiesQuery(enV, attrL, metadataList, *resP, &rawCerV, &err, true, tenant, servicePathV))
   {
@@ -2395,6 +2949,114 @@ BSONArray processConditionVector
 
 
 
+/* ****************************************************************************
+*
+* processDeferredNotification -
+*
+* Notification of the current state of the given entities, for the updates discarded by
+* throttling (see subCacheItemDefer()). The entities not found, or no longer matching the
+* filters of the subscription, are not notified. xauthToken is the one of the last update
+* discarded (there is no correlator, as the notification is not triggered by a request).
+*
+* Returns true if the notification was sent.
+*/
+bool processDeferredNotification
+(
+  const std::vector<EntID>&        entities,
+  const std::vector<std::string>&  attributes,
+  const std::vector<std::string>&  metadataV,
+  const std::string&               subId,
+  const HttpInfo&                  notifyHttpInfo,
+  RenderFormat                     renderFormat,
+  const std::string&               tenant,
+  const std::string&               xauthToken,
+  const std::string&               servicePath,
+  StringFilter*                    stringFilterP,
+  StringFilter*                    mdStringFilterP,
+  bool                             blacklist
+)
+{
+  EntityIdVector                enV;
+  StringList                    attrL;
+  StringList                    metadataList;
+  Restriction                   res;
+  std::vector<std::string>      servicePathV;
+  ContextElementResponseVector  rawCerV;
+  ContextElementResponseVector  prunedCerV;
+  NotifyContextRequest          ncr;
+  std::string                   err;
+
+  for (unsigned int ix = 0; ix < entities.size(); ++ix)
+  {
+    enV.push_back(new EntityId(entities[ix].id, entities[ix].type, "false"));
+  }
+
+  if (!blacklist)
+  {
+    attrL.fill(attributes);
+  }
+
+  metadataList.fill(metadataV);
+  servicePathV.push_back(servicePath);
+
+  bool ok = entitiesQuery(enV, attrL, metadataList, res, &rawCerV, &err, true, tenant, servicePathV);
+
+  enV.release();
+
+  if (!ok)
+  {
+    rawCerV.release();
+    return false;
+  }
+
+  for (unsigned int ix = 0; ix < rawCerV.size() ; ix++)
+  {
+    rawCerV[ix]->contextElement.filterAttributes(attributes, blacklist);
+  }
+
+  /* Prune "not found" CERs */
+  pruneContextElements(rawCerV, &prunedCerV);
+
+#ifdef WORKAROUND_2994
+  delayedReleaseAdd(rawCerV);
+  rawCerV.vec.clear();
+#else
+  rawCerV.release();
+#endif
+
+  /* The filters are evaluated with the current state of the entities */
+  for (unsigned int ix = 0; ix < prunedCerV.size(); ++ix)
+  {
+    ContextElementResponse* cerP = prunedCerV[ix];
+
+    if (((stringFilterP != NULL) && (!stringFilterP->match(cerP))) || ((mdStringFilterP != NULL) && (!mdStringFilterP->match(cerP))))
+    {
+      cerP->release();
+      delete cerP;
+      continue;
+    }
+
+    ncr.contextElementResponseVector.push_back(cerP);
+  }
+
+  prunedCerV.vec.clear();
+
+  if (ncr.contextElementResponseVector.size() == 0)
+  {
+    return false;
+  }
+
+  ncr.subscriptionId.set(subId);
+  ncr.originator.set("localhost");
+
+  getNotifier()->sendNotifyContextRequest(&ncr, notifyHttpInfo, tenant, xauthToken, "", renderFormat, metadataV);
+  ncr.contextElementResponseVector.release();
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoUpdateCasubNewNotification -
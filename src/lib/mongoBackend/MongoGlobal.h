@@ -53,6 +53,7 @@
 #include "apiTypesV2/Subscription.h"
 #include "apiTypesV2/HttpInfo.h"
 #include "mongoBackend/TriggeredSubscription.h"
+#include "mongoBackend/entityJsonRender.h"
 
 
 
@@ -64,6 +65,22 @@ extern bool mongoMultitenant(void);
 
 
 
+/* ****************************************************************************
+*
+* mongoServicePathIndex -
+*/
+extern bool mongoServicePathIndex(void);
+
+
+
+/* ****************************************************************************
+*
+* setServicePathIndex -
+*/
+extern void setServicePathIndex(bool enabled);
+
+
+
 /* ****************************************************************************
 *
 * mongoInit -
@@ -106,6 +123,7 @@ extern bool mongoStart
 
 #ifdef UNIT_TEST
 extern void setMongoConnectionForUnitTest(mongo::DBClientBase* _connection);
+extern void setMultitenantForUnitTest(bool _multitenant);
 #endif
 
 
@@ -216,20 +234,58 @@ extern void setSubscribeContextAvailabilityCollectionName(const std::string& nam
 
 
 
+/* ****************************************************************************
+*
+* TenantCollection -
+*/
+typedef enum TenantCollection
+{
+  ColEntities,
+  ColRegistrations,
+  ColCsubs,
+  ColCasubs
+} TenantCollection;
+
+
+
 /* ****************************************************************************
 *
 * composeDatabaseName -
 *
+* Composes the name each time it is called. In the request path, getDatabaseName()
+* is to be used instead.
 */
 extern std::string composeDatabaseName(const std::string& tenant);
 
 
 
+/* ****************************************************************************
+*
+* composeCollectionName -
+*
+* Composes the name each time it is called. In the request path, the get*CollectionName()
+* functions are to be used instead.
+*/
+extern std::string composeCollectionName(const std::string& tenant, TenantCollection collection);
+
+
+
+/* ****************************************************************************
+*
+* getDatabaseName -
+*
+* This function and the get*CollectionName() functions below return the names kept in
+* the tenant context (see tenantContext.h), so no string is composed
+*/
+extern const std::string& getDatabaseName(const std::string& tenant);
+
+
+
 /* ****************************************************************************
 *
 * getEntitiesCollectionName -
 */
-extern std::string getEntitiesCollectionName(const std::string& tenant);
+extern const std::string& getEntitiesCollectionName(const std::string& tenant);
 
 
 
@@ -237,7 +293,7 @@ extern std::string getEntitiesCollectionName(const std::string& tenant);
 *
 * getRegistrationsCollectionName -
 */
-extern std::string getRegistrationsCollectionName(const std::string& tenant);
+extern const std::string& getRegistrationsCollectionName(const std::string& tenant);
 
 
 
@@ -245,7 +301,7 @@ extern std::string getRegistrationsCollectionName(const std::string& tenant);
 *
 * getSubscribeContextCollectionName -
 */
-extern std::string getSubscribeContextCollectionName(const std::string& tenant);
+extern const std::string& getSubscribeContextCollectionName(const std::string& tenant);
 
 
 
@@ -253,7 +309,7 @@ extern std::string getSubscribeContextCollectionName(const std::string& tenant);
 *
 * getSubscribeContextAvailabilityCollectionName -
 */
-extern std::string getSubscribeContextAvailabilityCollectionName(const std::string& tenant);
+extern const std::string& getSubscribeContextAvailabilityCollectionName(const std::string& tenant);
 
 
 
@@ -277,7 +333,7 @@ extern bool mongoExpirationCapable(void);
 *
 * ensureLocationIndex -
 */
-extern void ensureLocationIndex(const std::string& tenant);
+extern bool ensureLocationIndex(const std::string& tenant);
 
 
 
@@ -285,7 +341,38 @@ extern void ensureLocationIndex(const std::string& tenant);
 *
 * ensureDateExpirationIndex -
 */
-extern void ensureDateExpirationIndex(const std::string& tenant);
+extern bool ensureDateExpirationIndex(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* ensureServicePathIndex -
+*/
+extern bool ensureServicePathIndex(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* ensureEntityIndexes -
+*
+* Creates the location, date expiration and servicePath indexes of a tenant,
+* only the first time it is called for the tenant (or the first time after
+* entityIndexesInvalidate())
+*/
+extern void ensureEntityIndexes(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* entityIndexesInvalidate -
+*
+* To be called on errors in the entities collection of a tenant (e.g. the database has
+* been dropped), so the indexes are checked again by the next ensureEntityIndexes()
+*/
+extern void entityIndexesInvalidate(const std::string& tenant);
 
 
 
@@ -325,6 +412,15 @@ extern bool processAreaScopeV2(const Scope* scoP, mongo::BSONObj* areaQueryP);
 /* ****************************************************************************
 *
 * entitiesQuery -
+*
+* If nextPageCursor is not NULL, keyset pagination is used instead of offset: entities
+* are sorted by creation date and _id, the page starts after the one identified by
+* pageCursor (from the beginning if empty) and the cursor for the next page is returned
+* in nextPageCursor (empty if there are no more pages).
+*
+* If jsonRenderP is not NULL, the entities are rendered directly from the DB documents
+* (see entityDocToJson()) and the CERs hold just the entity id and the rendered JSON. Only
+* to be used when no attribute is requested (or "*") and no CPr can be involved.
 */
 extern bool entitiesQuery
 (
@@ -342,7 +438,10 @@ extern bool entitiesQuery
   bool*                            limitReached   = NULL,
   long long*                       countP         = NULL,
   const std::string&               sortOrderList  = "",
-  ApiVersion                       apiVersion     = V1
+  ApiVersion                       apiVersion     = V1,
+  const std::string&               pageCursor     = "",
+  std::string*                     nextPageCursor = NULL,
+  const EntityJsonRender*          jsonRenderP    = NULL
 );
 
 
@@ -355,6 +454,14 @@ extern void pruneContextElements(const ContextElementResponseVector& oldCerV, Co
 
 
 
+/* ****************************************************************************
+*
+* isCondValueInContextElementResponse -
+*/
+extern bool isCondValueInContextElementResponse(ConditionValueList* condValues, ContextElementResponseVector* cerV);
+
+
+
 /* ****************************************************************************
 *
 * registrationsQuery -
@@ -432,6 +539,28 @@ extern mongo::BSONArray processConditionVector
 
 
 
+/* ****************************************************************************
+*
+* processDeferredNotification -
+*/
+extern bool processDeferredNotification
+(
+  const std::vector<ngsiv2::EntID>&  entities,
+  const std::vector<std::string>&    attributes,
+  const std::vector<std::string>&    metadataV,
+  const std::string&                 subId,
+  const ngsiv2::HttpInfo&            notifyHttpInfo,
+  RenderFormat                       renderFormat,
+  const std::string&                 tenant,
+  const std::string&                 xauthToken,
+  const std::string&                 servicePath,
+  StringFilter*                      stringFilterP,
+  StringFilter*                      mdStringFilterP,
+  bool                               blacklist
+);
+
+
+
 /* ****************************************************************************
 *
 * processAvailabilitySubscriptions -
@@ -476,6 +605,30 @@ extern mongo::BSONObj fillQueryServicePath(const std::vector<std::string>& servi
 
 
 
+/* ****************************************************************************
+*
+* servicePathScopes -
+*/
+extern mongo::BSONArray servicePathScopes(const std::string& servicePath);
+
+
+
+/* ****************************************************************************
+*
+* entityServicePathField -
+*/
+extern const char* entityServicePathField(void);
+
+
+
+/* ****************************************************************************
+*
+* fillQueryEntityServicePath -
+*/
+extern mongo::BSONObj fillQueryEntityServicePath(const std::vector<std::string>& servicePath);
+
+
+
 /* ****************************************************************************
 *
 * fillContextProviders -
@@ -32,6 +32,7 @@
 #include "common/statistics.h"
 #include "common/clockFunctions.h"
 #include "alarmMgr/alarmMgr.h"
+#include "cache/countCache.h"
 
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
@@ -139,7 +140,8 @@ bool collectionRangedQuery
   int                             offset,
   std::auto_ptr<DBClientCursor>*  cursor,
   long long*                      count,
-  std::string*                    err
+  std::string*                    err,
+  const BSONObj*                  countFilterP
 )
 {
   if (connection == NULL)
@@ -160,7 +162,14 @@ bool collectionRangedQuery
   {
     if (count != NULL)
     {
-      *count = connection->count(col.c_str(), q);
+      Query        countQuery = (countFilterP != NULL)? Query(*countFilterP) : q;
+      std::string  countKey   = col + " " + countQuery.getFilter().toString();
+
+      if (!countCacheLookup(countKey, count))
+      {
+        *count = connection->count(col.c_str(), countQuery);
+        countCacheStore(countKey, *count);
+      }
     }
 
     *cursor = connection->query(col.c_str(), q, limit, offset);
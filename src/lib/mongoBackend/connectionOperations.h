@@ -49,6 +49,9 @@ extern bool collectionQuery
 /* ****************************************************************************
 *
 * collectionRangedQuery -
+*
+* If countFilterP is not NULL, the count is done using that filter instead of the one
+* in the query (used in keyset pagination, where the query includes the page range).
 */
 extern bool collectionRangedQuery
 (
@@ -59,7 +62,8 @@ extern bool collectionRangedQuery
   int                                    offset,
   std::auto_ptr<mongo::DBClientCursor>*  cursor,
   long long*                             count,
-  std::string*                           err
+  std::string*                           err,
+  const mongo::BSONObj*                  countFilterP = NULL
 );
 
 
@@ -66,6 +66,7 @@
 #define ENT_ENTITY_ID                "id"
 #define ENT_ENTITY_TYPE              "type"
 #define ENT_SERVICE_PATH             "servicePath"
+#define ENT_SERVICE_PATH_SCOPES      "spScopes"
 #define ENT_ATTRS_TYPE               "type"
 #define ENT_ATTRS_VALUE              "value"
 #define ENT_ATTRS_CREATION_DATE      "creDate"
@@ -114,6 +115,10 @@
 #define CSUB_BLACKLIST               "blacklist"
 #define CSUB_LASTFAILURE             "lastFailure"
 #define CSUB_LASTSUCCESS             "lastSuccess"
+#define CSUB_INITIALNOTIF            "initialNotification"
+#define CSUB_INITIALNOTIF_STATUS     "status"
+#define CSUB_INITIALNOTIF_ENTITIES   "entities"
+#define CSUB_INITIALNOTIF_SENT       "notifications"
 
 #define CASUB_EXPIRATION             "expiration"
 #define CASUB_REFERENCE              "reference"
@@ -135,4 +140,10 @@
 #define STATUS_ACTIVE        "active"
 #define STATUS_INACTIVE      "inactive"
 
+#define INITIALNOTIF_PENDING    "pending"
+#define INITIALNOTIF_RUNNING    "running"
+#define INITIALNOTIF_DONE       "done"
+#define INITIALNOTIF_CANCELLED  "cancelled"
+#define INITIALNOTIF_FAILED     "failed"
+
 #endif  // SRC_LIB_MONGOBACKEND_DBCONSTANTS_H_
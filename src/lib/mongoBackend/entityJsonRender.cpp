@@ -0,0 +1,762 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#include <string.h>
+
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "common/string.h"
+#include "common/JsonHelper.h"
+#include "rest/uriParamNames.h"
+#include "ngsi/Metadata.h"
+#include "orionTypes/OrionValueType.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/dbFieldEncoding.h"
+#include "mongoBackend/safeMongo.h"
+#include "mongoBackend/entityJsonRender.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::BSONObj;
+using mongo::BSONElement;
+
+
+
+/* ****************************************************************************
+*
+* AttrSlot -
+*
+* An attribute of the entity document, as ContextElementResponse would hold it
+*/
+typedef struct AttrSlot
+{
+  std::string  name;
+  std::string  mdId;
+  BSONObj      attr;
+  bool         taken;
+} AttrSlot;
+
+
+
+/* ****************************************************************************
+*
+* RenderItem -
+*
+* An attribute to render: either an attribute of the document or one of the special
+* dateCreated/dateModified attributes (slotP is NULL in that case)
+*/
+typedef struct RenderItem
+{
+  const AttrSlot*  slotP;
+  const char*      name;
+  double           date;
+} RenderItem;
+
+
+
+/* ****************************************************************************
+*
+* entityJsonRenderSetup -
+*/
+bool entityJsonRenderSetup
+(
+  std::map<std::string, bool>&         uriParamOptions,
+  std::map<std::string, std::string>&  uriParam,
+  EntityJsonRender*                    paramsP
+)
+{
+  if      (uriParamOptions[OPT_KEY_VALUES]    == true)  { paramsP->renderFormat = NGSI_V2_KEYVALUES;  }
+  else if (uriParamOptions[OPT_VALUES]        == true)  { paramsP->renderFormat = NGSI_V2_VALUES;     }
+  else if (uriParamOptions[OPT_UNIQUE_VALUES] == true)  { return false;                               }
+  else                                                  { paramsP->renderFormat = NGSI_V2_NORMALIZED; }
+
+  paramsP->attrsFilter.clear();
+  paramsP->metadataFilter.clear();
+
+  if (uriParam[URI_PARAM_ATTRS] != "")
+  {
+    stringSplit(uriParam[URI_PARAM_ATTRS], ',', paramsP->attrsFilter);
+  }
+
+  if (uriParam[URI_PARAM_METADATA] != "")
+  {
+    stringSplit(uriParam[URI_PARAM_METADATA], ',', paramsP->metadataFilter);
+  }
+
+  paramsP->dateCreated  = uriParamOptions[DATE_CREATED];
+  paramsP->dateModified = uriParamOptions[DATE_MODIFIED];
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* inFilter -
+*/
+static bool inFilter(const std::vector<std::string>& filter, const std::string& name)
+{
+  return std::find(filter.begin(), filter.end(), name) != filter.end();
+}
+
+
+
+/* ****************************************************************************
+*
+* metadataMatch -
+*
+* Same as MetadataVector::matchFilter()
+*/
+static bool metadataMatch(const std::vector<std::string>& metadataFilter, const std::string& mdName)
+{
+  if ((metadataFilter.size() == 0) || inFilter(metadataFilter, NGSI_MD_ALL))
+  {
+    return true;
+  }
+
+  return inFilter(metadataFilter, mdName);
+}
+
+
+
+/* ****************************************************************************
+*
+* compoundToJson -
+*
+* Same output as the CompoundValueNode built by compoundObjectResponse() and
+* compoundVectorResponse(), but elements of unknown BSON type make the transcoding fail
+* instead of being skipped.
+*/
+static bool compoundToJson(const BSONElement& be, std::string* outP)
+{
+  switch (be.type())
+  {
+  case mongo::String:
+    *outP += toJsonString(be.String());
+    return true;
+
+  case mongo::Bool:
+    *outP += be.Bool()? "true" : "false";
+    return true;
+
+  case mongo::NumberDouble:
+    *outP += double2string(be.Number());
+    return true;
+
+  case mongo::jstNULL:
+    *outP += "null";
+    return true;
+
+  case mongo::Object:
+  case mongo::Array:
+    break;
+
+  default:
+    return false;
+  }
+
+  bool     isObject = (be.type() == mongo::Object);
+  bool     first    = true;
+  BSONObj  obj      = be.embeddedObject();
+
+  *outP += isObject? '{' : '[';
+
+  for (BSONObj::iterator i = obj.begin(); i.more();)
+  {
+    BSONElement e = i.next();
+
+    if (!first)
+    {
+      *outP += ',';
+    }
+    first = false;
+
+    if (isObject)
+    {
+      *outP += toJsonString(dbDotDecode(e.fieldName())) + ':';
+    }
+
+    if (!compoundToJson(e, outP))
+    {
+      return false;
+    }
+  }
+
+  *outP += isObject? '}' : ']';
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* attrValueToJson -
+*
+* Value of an attribute of the document and the default type to use in case the
+* attribute has no type, as ContextAttribute::toJson() and toJsonValue() would do
+*/
+static bool attrValueToJson
+(
+  const BSONObj&      attr,
+  const std::string&  type,
+  const char**        defTypeP,
+  std::string*        valueP
+)
+{
+  if (!attr.hasField(ENT_ATTRS_VALUE))
+  {
+    *defTypeP = defaultType(orion::ValueTypeString);
+    *valueP   = "\"\"";
+    return true;
+  }
+
+  BSONElement value = attr.getField(ENT_ATTRS_VALUE);
+
+  switch (value.type())
+  {
+  case mongo::String:
+    *defTypeP = defaultType(orion::ValueTypeString);
+    *valueP   = toJsonString(value.String());
+    return true;
+
+  case mongo::NumberDouble:
+  case mongo::NumberInt:
+    *defTypeP = defaultType(orion::ValueTypeNumber);
+    if ((type == DATE_TYPE) || (type == DATE_TYPE_ALT))
+    {
+      *valueP = toJsonString(isodate2str(value.Number()));
+    }
+    else
+    {
+      *valueP = double2string(value.Number());
+    }
+    return true;
+
+  case mongo::Bool:
+    *defTypeP = defaultType(orion::ValueTypeBoolean);
+    *valueP   = value.Bool()? "true" : "false";
+    return true;
+
+  case mongo::jstNULL:
+    *defTypeP = defaultType(orion::ValueTypeNull);
+    *valueP   = "null";
+    return true;
+
+  case mongo::Object:
+    *defTypeP = defaultType(orion::ValueTypeObject);
+    return compoundToJson(value, valueP);
+
+  case mongo::Array:
+    *defTypeP = defaultType(orion::ValueTypeVector);
+    return compoundToJson(value, valueP);
+
+  default:
+    return false;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* mdToJson -
+*
+* Same as Metadata::toJson() for the Metadata built from the DB
+*/
+static bool mdToJson(const BSONObj& md, std::string* outP)
+{
+  std::string  type     = md.hasField(ENT_ATTRS_MD_TYPE)? getStringFieldF(md, ENT_ATTRS_MD_TYPE) : "";
+  BSONElement  value    = md.getField(ENT_ATTRS_MD_VALUE);
+  const char*  defType  = NULL;
+  std::string  valueJson;
+  JsonHelper   jh;
+
+  switch (value.type())
+  {
+  case mongo::String:
+    defType   = defaultType(orion::ValueTypeString);
+    valueJson = toJsonString(value.String());
+    break;
+
+  case mongo::NumberDouble:
+    defType   = defaultType(orion::ValueTypeNumber);
+    if ((type == DATE_TYPE) || (type == DATE_TYPE_ALT))
+    {
+      valueJson = toJsonString(isodate2str((long long) value.Number()));
+    }
+    else
+    {
+      valueJson = double2string(value.Number());
+    }
+    break;
+
+  case mongo::Bool:
+    defType   = defaultType(orion::ValueTypeBoolean);
+    valueJson = value.Bool()? "true" : "false";
+    break;
+
+  case mongo::jstNULL:
+    defType   = defaultType(orion::ValueTypeNull);
+    valueJson = "null";
+    break;
+
+  case mongo::Object:
+  case mongo::Array:
+    defType = defaultType((value.type() == mongo::Object)? orion::ValueTypeObject : orion::ValueTypeVector);
+    if (!compoundToJson(value, &valueJson))
+    {
+      return false;
+    }
+    break;
+
+  default:
+    // Includes NumberInt, not supported by the Metadata constructor
+    return false;
+  }
+
+  jh.addString("type", (type != "")? type : defType);
+  jh.addRaw("value", valueJson);
+
+  *outP = jh.str();
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* dateMdToJson -
+*/
+static std::string dateMdToJson(double date)
+{
+  JsonHelper jh;
+
+  jh.addString("type", DATE_TYPE);
+  jh.addDate("value", date);
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* metadataToJson -
+*
+* Metadata of an attribute of the document: ID metadata, custom metadata (in
+* the order given by the DB field names) and dateCreated/dateModified, if requested
+*/
+static bool metadataToJson
+(
+  const AttrSlot&                  slot,
+  const std::vector<std::string>&  metadataFilter,
+  std::string*                     outP
+)
+{
+  JsonHelper jh;
+
+  if ((slot.mdId != "") && metadataMatch(metadataFilter, NGSI_MD_ID))
+  {
+    JsonHelper idJh;
+
+    idJh.addString("type", "string");
+    idJh.addString("value", slot.mdId);
+    jh.addRaw(NGSI_MD_ID, idJh.str());
+  }
+
+  if (slot.attr.hasField(ENT_ATTRS_MD))
+  {
+    BSONObj                mds = getObjectFieldF(slot.attr, ENT_ATTRS_MD);
+    std::set<std::string>  mdsSet;
+
+    mds.getFieldNames(mdsSet);
+    for (std::set<std::string>::iterator i = mdsSet.begin(); i != mdsSet.end(); ++i)
+    {
+      std::string  mdName = dbDotDecode(*i);
+      std::string  mdJson;
+
+      if (!mdToJson(getObjectFieldF(mds, *i), &mdJson))
+      {
+        return false;
+      }
+
+      if ((mdName == "value") || (mdName == "type") || !metadataMatch(metadataFilter, mdName))
+      {
+        continue;
+      }
+
+      jh.addRaw(mdName, mdJson);
+    }
+  }
+
+  if (slot.attr.hasField(ENT_ATTRS_CREATION_DATE) && inFilter(metadataFilter, NGSI_MD_DATECREATED))
+  {
+    double creDate = (double) getIntOrLongFieldAsLongF(slot.attr, ENT_ATTRS_CREATION_DATE);
+
+    if (creDate != 0)
+    {
+      jh.addRaw(NGSI_MD_DATECREATED, dateMdToJson(creDate));
+    }
+  }
+
+  if (slot.attr.hasField(ENT_ATTRS_MODIFICATION_DATE) && inFilter(metadataFilter, NGSI_MD_DATEMODIFIED))
+  {
+    double modDate = (double) getIntOrLongFieldAsLongF(slot.attr, ENT_ATTRS_MODIFICATION_DATE);
+
+    if (modDate != 0)
+    {
+      jh.addRaw(NGSI_MD_DATEMODIFIED, dateMdToJson(modDate));
+    }
+  }
+
+  *outP = jh.str();
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* itemToJson -
+*
+* Normalized rendering of an attribute (or just the value, if 'valueOnly' is set)
+*/
+static bool itemToJson
+(
+  const RenderItem&                item,
+  const std::vector<std::string>&  metadataFilter,
+  bool                             valueOnly,
+  std::string*                     outP
+)
+{
+  std::string  type;
+  std::string  value;
+  std::string  metadata = "{}";
+  const char*  defType  = NULL;
+
+  if (item.slotP == NULL)
+  {
+    type  = DATE_TYPE;
+    value = toJsonString(isodate2str(item.date));
+  }
+  else
+  {
+    type = getStringFieldF(item.slotP->attr, ENT_ATTRS_TYPE);
+
+    if (!attrValueToJson(item.slotP->attr, type, &defType, &value))
+    {
+      return false;
+    }
+
+    if (!valueOnly && !metadataToJson(*item.slotP, metadataFilter, &metadata))
+    {
+      return false;
+    }
+  }
+
+  if (valueOnly)
+  {
+    *outP = value;
+    return true;
+  }
+
+  JsonHelper jh;
+
+  jh.addString("type", (type != "")? type : defType);
+  jh.addRaw("value", value);
+  jh.addRaw("metadata", metadata);
+
+  *outP = jh.str();
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* slotLookup -
+*
+* First attribute with the given name not already taken
+*/
+static AttrSlot* slotLookup(std::vector<AttrSlot>& slots, const std::string& name)
+{
+  for (unsigned int ix = 0; ix < slots.size(); ++ix)
+  {
+    if (!slots[ix].taken && (slots[ix].name == name))
+    {
+      return &slots[ix];
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* dateItem -
+*/
+static RenderItem dateItem(const char* name, double date)
+{
+  RenderItem item;
+
+  item.slotP = NULL;
+  item.name  = name;
+  item.date  = date;
+
+  return item;
+}
+
+
+
+/* ****************************************************************************
+*
+* slotItem -
+*/
+static RenderItem slotItem(AttrSlot* slotP)
+{
+  RenderItem item;
+
+  slotP->taken = true;
+
+  item.slotP = slotP;
+  item.name  = slotP->name.c_str();
+  item.date  = 0;
+
+  return item;
+}
+
+
+
+/* ****************************************************************************
+*
+* filterAttributes -
+*
+* Same selection and ordering of attributes as Entity::filterAttributes()
+*/
+static void filterAttributes
+(
+  std::vector<AttrSlot>&    slots,
+  const EntityJsonRender&   params,
+  double                    creDate,
+  double                    modDate,
+  std::vector<RenderItem>*  itemsP
+)
+{
+  const std::vector<std::string>&  attrsFilter       = params.attrsFilter;
+  bool                             dateCreatedAdded  = false;
+  bool                             dateModifiedAdded = false;
+
+  if ((attrsFilter.size() == 0) || inFilter(attrsFilter, ALL_ATTRS))
+  {
+    for (unsigned int ix = 0; ix < slots.size(); ++ix)
+    {
+      itemsP->push_back(slotItem(&slots[ix]));
+    }
+
+    if ((creDate != 0) && inFilter(attrsFilter, DATE_CREATED))
+    {
+      itemsP->push_back(dateItem(DATE_CREATED, creDate));
+      dateCreatedAdded = true;
+    }
+
+    if ((modDate != 0) && inFilter(attrsFilter, DATE_MODIFIED))
+    {
+      itemsP->push_back(dateItem(DATE_MODIFIED, modDate));
+      dateModifiedAdded = true;
+    }
+  }
+  else
+  {
+    for (unsigned int ix = 0; ix < attrsFilter.size(); ++ix)
+    {
+      const std::string& attrName = attrsFilter[ix];
+
+      if ((creDate != 0) && (attrName == DATE_CREATED) && (slotLookup(slots, DATE_CREATED) == NULL))
+      {
+        itemsP->push_back(dateItem(DATE_CREATED, creDate));
+        dateCreatedAdded = true;
+      }
+      else if ((modDate != 0) && (attrName == DATE_MODIFIED) && (slotLookup(slots, DATE_MODIFIED) == NULL))
+      {
+        itemsP->push_back(dateItem(DATE_MODIFIED, modDate));
+        dateModifiedAdded = true;
+      }
+      else
+      {
+        AttrSlot* slotP = slotLookup(slots, attrName);
+
+        if (slotP != NULL)
+        {
+          itemsP->push_back(slotItem(slotP));
+        }
+      }
+    }
+  }
+
+  // Legacy support for options=dateCreated and options=dateModified
+  if (params.dateCreated && !dateCreatedAdded && (creDate != 0))
+  {
+    itemsP->push_back(dateItem(DATE_CREATED, creDate));
+  }
+
+  if (params.dateModified && !dateModifiedAdded && (modDate != 0))
+  {
+    itemsP->push_back(dateItem(DATE_MODIFIED, modDate));
+  }
+
+  // Removing dateExpires if not explicitly included in the filter
+  if (!inFilter(attrsFilter, DATE_EXPIRES))
+  {
+    for (unsigned int ix = 0; ix < itemsP->size(); ++ix)
+    {
+      if (strcmp((*itemsP)[ix].name, DATE_EXPIRES) == 0)
+      {
+        itemsP->erase(itemsP->begin() + ix);
+        break;
+      }
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* entityDocToJson -
+*/
+bool entityDocToJson
+(
+  const BSONObj&           doc,
+  const EntityJsonRender&  params,
+  std::string*             jsonP
+)
+{
+  BSONObj      id         = getFieldF(doc, "_id").embeddedObject();
+  std::string  entityId   = getStringFieldF(id, ENT_ENTITY_ID);
+  std::string  entityType = id.hasField(ENT_ENTITY_TYPE)? getStringFieldF(id, ENT_ENTITY_TYPE) : "";
+  double       creDate    = 0;
+  double       modDate    = 0;
+
+  if (doc.hasField(ENT_CREATION_DATE))
+  {
+    creDate = (double) getIntOrLongFieldAsLongF(doc, ENT_CREATION_DATE);
+  }
+
+  if (doc.hasField(ENT_MODIFICATION_DATE))
+  {
+    modDate = (double) getIntOrLongFieldAsLongF(doc, ENT_MODIFICATION_DATE);
+  }
+
+  //
+  // Attributes, in the order given by the (encoded) names in the DB, as the
+  // ContextElementResponse constructor does
+  //
+  BSONObj                attrs = getObjectFieldF(doc, ENT_ATTRS);
+  std::set<std::string>  attrNames;
+  std::vector<AttrSlot>  slots;
+
+  attrs.getFieldNames(attrNames);
+  slots.reserve(attrNames.size());
+
+  for (std::set<std::string>::iterator i = attrNames.begin(); i != attrNames.end(); ++i)
+  {
+    AttrSlot slot;
+
+    slot.name  = dbDotDecode(basePart(*i));
+    slot.mdId  = idPart(*i);
+    slot.attr  = getObjectFieldF(attrs, *i);
+    slot.taken = false;
+
+    slots.push_back(slot);
+  }
+
+  std::vector<RenderItem> items;
+
+  filterAttributes(slots, params, creDate, modDate, &items);
+
+  //
+  // Rendering
+  //
+  bool         valueOnly = (params.renderFormat != NGSI_V2_NORMALIZED);
+  std::string  itemJson;
+
+  if (params.renderFormat == NGSI_V2_VALUES)
+  {
+    std::string out = "[";
+
+    for (unsigned int ix = 0; ix < items.size(); ++ix)
+    {
+      if (!itemToJson(items[ix], params.metadataFilter, true, &itemJson))
+      {
+        return false;
+      }
+
+      if (ix != 0)
+      {
+        out += ',';
+      }
+      out += itemJson;
+    }
+
+    *jsonP = out + ']';
+    return true;
+  }
+
+  JsonHelper jh;
+
+  jh.addString("id", entityId);
+  jh.addString("type", (entityType != "")? entityType : DEFAULT_ENTITY_TYPE);
+
+  for (unsigned int ix = 0; ix < items.size(); ++ix)
+  {
+    if (!itemToJson(items[ix], params.metadataFilter, valueOnly, &itemJson))
+    {
+      return false;
+    }
+
+    jh.addRaw(items[ix].name, itemJson);
+  }
+
+  *jsonP = jh.str();
+
+  return true;
+}
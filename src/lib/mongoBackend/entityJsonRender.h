@@ -0,0 +1,89 @@
+#ifndef SRC_LIB_MONGOBACKEND_ENTITYJSONRENDER_H_
+#define SRC_LIB_MONGOBACKEND_ENTITYJSONRENDER_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+#include "mongo/client/dbclient.h"
+
+#include "common/RenderFormat.h"
+
+
+
+/* ****************************************************************************
+*
+* EntityJsonRender -
+*
+* The rendering parameters of a GET /v2/entities request (format, 'attrs' and 'metadata'
+* URI params and the legacy dateCreated/dateModified options), so the entity documents
+* retrieved from the DB can be rendered directly to NGSIv2 JSON by entityDocToJson()
+*/
+typedef struct EntityJsonRender
+{
+  RenderFormat              renderFormat;
+  std::vector<std::string>  attrsFilter;
+  std::vector<std::string>  metadataFilter;
+  bool                      dateCreated;
+  bool                      dateModified;
+} EntityJsonRender;
+
+
+
+/* ****************************************************************************
+*
+* entityJsonRenderSetup -
+*
+* Fills the rendering parameters from the URI params and options of the request.
+* Returns false if the format is not supported by entityDocToJson() (options=unique).
+*/
+extern bool entityJsonRenderSetup
+(
+  std::map<std::string, bool>&         uriParamOptions,
+  std::map<std::string, std::string>&  uriParam,
+  EntityJsonRender*                    paramsP
+);
+
+
+
+/* ****************************************************************************
+*
+* entityDocToJson -
+*
+* Renders an entity document as Entity::render() would do with the ContextElementResponse
+* built from it, without building the object model. Returns false if the document contains
+* something not supported by the transcoder (e.g. a value with an unexpected BSON type),
+* so the caller has to use the regular path for that entity.
+*/
+extern bool entityDocToJson
+(
+  const mongo::BSONObj&    doc,
+  const EntityJsonRender&  params,
+  std::string*             jsonP
+);
+
+#endif  // SRC_LIB_MONGOBACKEND_ENTITYJSONRENDER_H_
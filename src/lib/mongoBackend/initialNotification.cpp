@@ -0,0 +1,689 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <queue>
+
+#include "mongo/client/dbclient.h"
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/globals.h"
+#include "common/sem.h"
+#include "ngsi10/NotifyContextRequest.h"
+#include "cache/subCache.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/safeMongo.h"
+#include "mongoBackend/initialNotification.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* InitialNotificationJob -
+*
+* The job owns copies of everything it needs, as it outlives the request that created it.
+* The mutex protects 'cancelled' and serializes it with the sending of notifications and
+* the writing of the progress in DB.
+*/
+class InitialNotificationJob
+{
+ public:
+  std::string               subId;
+  EntityIdVector            enV;
+  StringList                attrL;
+  std::vector<std::string>  metadataV;
+  ConditionValueList        condValues;
+  ngsiv2::HttpInfo          httpInfo;
+  RenderFormat              renderFormat;
+  std::string               tenant;
+  std::string               xauthToken;
+  std::vector<std::string>  servicePathV;
+  Restriction               res;
+  std::string               fiwareCorrelator;
+  std::vector<std::string>  attrsOrder;
+  bool                      blacklist;
+
+  pthread_mutex_t           mutex;
+  bool                      cancelled;
+  long long                 entities;
+  long long                 notifications;
+
+  InitialNotificationJob()
+  {
+    pthread_mutex_init(&mutex, NULL);
+    cancelled     = false;
+    entities      = 0;
+    notifications = 0;
+  }
+
+  ~InitialNotificationJob()
+  {
+    enV.release();
+    res.release();
+    pthread_mutex_destroy(&mutex);
+  }
+};
+
+
+
+/* ****************************************************************************
+*
+* Job queue and lists -
+*
+* heldJobs are the jobs waiting for their subscription to be written in DB, activeJobs
+* the queued and running ones (a cancelled job stays in activeJobs until its worker is
+* done with it).
+*/
+static unsigned int                         chunkSize  = 0;
+static std::queue<InitialNotificationJob*>  jobQueue;
+static std::list<InitialNotificationJob*>   heldJobs;
+static std::list<InitialNotificationJob*>   activeJobs;
+static pthread_mutex_t                      jobsMutex  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t                       jobsQueued = PTHREAD_COND_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* progressWrite -
+*
+* To be called with the job mutex taken. If a notification has just been sent, the
+* notification counters of the subscription are also updated (as for any other
+* notification).
+*/
+static void progressWrite(InitialNotificationJob* jobP, const char* status, bool notified)
+{
+  std::string     err;
+  BSONObjBuilder  set;
+
+  set.append(CSUB_INITIALNOTIF, BSON(CSUB_INITIALNOTIF_STATUS   << status         <<
+                                     CSUB_INITIALNOTIF_ENTITIES << jobP->entities <<
+                                     CSUB_INITIALNOTIF_SENT     << jobP->notifications));
+
+  if (notified)
+  {
+    long long now = getCurrentTime();
+
+    set.append(CSUB_LASTNOTIFICATION, now);
+
+    cacheSemTake(__FUNCTION__, "initial notification lastNotification");
+
+    CachedSubscription* cSubP = subCacheItemLookup(jobP->tenant.c_str(), jobP->subId.c_str());
+
+    if ((cSubP != NULL) && (cSubP->lastNotificationTime < now))
+    {
+      cSubP->lastNotificationTime = now;
+    }
+
+    cacheSemGive(__FUNCTION__, "initial notification lastNotification");
+  }
+
+  BSONObj update = notified? BSON("$set" << set.obj() << "$inc" << BSON(CSUB_COUNT << 1)) : BSON("$set" << set.obj());
+
+  collectionUpdate(getSubscribeContextCollectionName(jobP->tenant), BSON("_id" << OID(jobP->subId)), update, false, &err);
+}
+
+
+
+/* ****************************************************************************
+*
+* jobEnd - write the final status of the job (unless it has been cancelled)
+*/
+static void jobEnd(InitialNotificationJob* jobP, const char* status)
+{
+  pthread_mutex_lock(&jobP->mutex);
+
+  if (!jobP->cancelled)
+  {
+    progressWrite(jobP, status, false);
+  }
+
+  pthread_mutex_unlock(&jobP->mutex);
+
+  LM_T(LmtNotifier, ("initial notification of subscription %s %s: %lld entities in %lld notifications",
+                     jobP->subId.c_str(), status, jobP->entities, jobP->notifications));
+}
+
+
+
+/* ****************************************************************************
+*
+* jobCancelled -
+*/
+static bool jobCancelled(InitialNotificationJob* jobP)
+{
+  bool cancelled;
+
+  pthread_mutex_lock(&jobP->mutex);
+  cancelled = jobP->cancelled;
+  pthread_mutex_unlock(&jobP->mutex);
+
+  return cancelled;
+}
+
+
+
+/* ****************************************************************************
+*
+* subscriptionActive -
+*
+* The subscription could have been deactivated or removed through other broker. In the
+* second case the job ends silently.
+*/
+static bool subscriptionActive(InitialNotificationJob* jobP, bool* removedP)
+{
+  std::string  err;
+  BSONObj      sub;
+
+  *removedP = false;
+
+  if (!collectionFindOne(getSubscribeContextCollectionName(jobP->tenant), BSON("_id" << OID(jobP->subId)), &sub, &err))
+  {
+    // Let the entities query decide
+    return true;
+  }
+
+  if (sub.isEmpty())
+  {
+    *removedP = true;
+    return false;
+  }
+
+  return !sub.hasField(CSUB_STATUS) || (getStringFieldF(sub, CSUB_STATUS) == STATUS_ACTIVE);
+}
+
+
+
+/* ****************************************************************************
+*
+* condValuesMatch -
+*
+* Same condition checked by the synchronous initial notification (some of the matching
+* entities has some of the condition attributes), but solved with a single entity query
+*/
+static bool condValuesMatch(InitialNotificationJob* jobP, std::string* errP)
+{
+  ContextElementResponseVector  cerV;
+  StringList                    condAttrL;
+  StringList                    metadataList;
+  bool                          match;
+
+  if (jobP->condValues.size() == 0)
+  {
+    return true;
+  }
+
+  condAttrL.fill(jobP->condValues.vec);
+
+  if (!entitiesQuery(jobP->enV, condAttrL, metadataList, jobP->res, &cerV, errP, false, jobP->tenant, jobP->servicePathV, 0, 1))
+  {
+    cerV.release();
+    return false;
+  }
+
+  match = isCondValueInContextElementResponse(&jobP->condValues, &cerV);
+  cerV.release();
+
+  return match;
+}
+
+
+
+/* ****************************************************************************
+*
+* jobRun -
+*
+* The entities are walked with keyset pagination (see entitiesQuery()), so each page
+* costs the same whatever its depth is and just one page is in memory at a time.
+*/
+static void jobRun(InitialNotificationJob* jobP)
+{
+  std::string  err;
+  std::string  pageCursor;
+  StringList   emptyList;
+  StringList   metadataList;
+  bool         removed;
+
+  metadataList.fill(jobP->metadataV);
+
+  pthread_mutex_lock(&jobP->mutex);
+
+  if (jobP->cancelled)
+  {
+    pthread_mutex_unlock(&jobP->mutex);
+    return;
+  }
+
+  progressWrite(jobP, INITIALNOTIF_RUNNING, false);
+  pthread_mutex_unlock(&jobP->mutex);
+
+  if (!condValuesMatch(jobP, &err))
+  {
+    jobEnd(jobP, (err == "")? INITIALNOTIF_DONE : INITIALNOTIF_FAILED);
+    return;
+  }
+
+  do
+  {
+    ContextElementResponseVector  rawCerV;
+    NotifyContextRequest          ncr;
+    std::string                   nextPageCursor;
+
+    // No need to query anything once the job has been cancelled
+    if (jobCancelled(jobP))
+    {
+      return;
+    }
+
+    if (!subscriptionActive(jobP, &removed))
+    {
+      if (!removed)
+      {
+        jobEnd(jobP, INITIALNOTIF_CANCELLED);
+      }
+
+      return;
+    }
+
+    if (!entitiesQuery(jobP->enV,
+                       jobP->blacklist? emptyList : jobP->attrL,
+                       metadataList,
+                       jobP->res,
+                       &rawCerV,
+                       &err,
+                       true,
+                       jobP->tenant,
+                       jobP->servicePathV,
+                       0,
+                       chunkSize,
+                       NULL,
+                       NULL,
+                       "",
+                       V1,
+                       pageCursor,
+                       &nextPageCursor))
+    {
+      LM_E(("Runtime Error (initial notification of subscription %s: %s)", jobP->subId.c_str(), err.c_str()));
+      rawCerV.release();
+      jobEnd(jobP, INITIALNOTIF_FAILED);
+
+      return;
+    }
+
+    for (unsigned int ix = 0; ix < rawCerV.size(); ++ix)
+    {
+      rawCerV[ix]->contextElement.filterAttributes(jobP->attrsOrder, jobP->blacklist);
+    }
+
+    pruneContextElements(rawCerV, &ncr.contextElementResponseVector);
+    rawCerV.release();
+
+    if (ncr.contextElementResponseVector.size() > 0)
+    {
+      ncr.subscriptionId.set(jobP->subId);
+      ncr.originator.set("localhost");
+
+      pthread_mutex_lock(&jobP->mutex);
+
+      if (jobP->cancelled)
+      {
+        pthread_mutex_unlock(&jobP->mutex);
+        ncr.contextElementResponseVector.release();
+
+        return;
+      }
+
+      getNotifier()->sendNotifyContextRequest(&ncr,
+                                              jobP->httpInfo,
+                                              jobP->tenant,
+                                              jobP->xauthToken,
+                                              jobP->fiwareCorrelator,
+                                              jobP->renderFormat,
+                                              jobP->metadataV);
+
+      jobP->entities      += ncr.contextElementResponseVector.size();
+      jobP->notifications += 1;
+
+      progressWrite(jobP, INITIALNOTIF_RUNNING, true);
+      pthread_mutex_unlock(&jobP->mutex);
+    }
+
+    ncr.contextElementResponseVector.release();
+    pageCursor = nextPageCursor;
+  } while (pageCursor != "");
+
+  jobEnd(jobP, INITIALNOTIF_DONE);
+}
+
+
+
+/* ****************************************************************************
+*
+* jobWorker -
+*/
+static void* jobWorker(void* vP)
+{
+  while (true)
+  {
+    pthread_mutex_lock(&jobsMutex);
+
+    while (jobQueue.empty())
+    {
+      pthread_cond_wait(&jobsQueued, &jobsMutex);
+    }
+
+    InitialNotificationJob* jobP = jobQueue.front();
+
+    jobQueue.pop();
+    pthread_mutex_unlock(&jobsMutex);
+
+    jobRun(jobP);
+
+    pthread_mutex_lock(&jobsMutex);
+    activeJobs.remove(jobP);
+    pthread_mutex_unlock(&jobsMutex);
+
+    delete jobP;
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationInit -
+*/
+void initialNotificationInit(unsigned int _chunkSize)
+{
+  static bool workersStarted = false;
+
+  chunkSize = _chunkSize;
+
+  if ((chunkSize == 0) || workersStarted)
+  {
+    return;
+  }
+
+  workersStarted = true;
+
+  for (unsigned int ix = 0; ix < INITIAL_NOTIF_WORKERS; ++ix)
+  {
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, jobWorker, NULL) != 0)
+    {
+      LM_X(1, ("Fatal Error (error creating initial notification thread: %s)", strerror(errno)));
+    }
+
+    pthread_detach(tid);
+  }
+
+  LM_T(LmtNotifier, ("background initial notifications, chunk size %d", chunkSize));
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationBackground -
+*/
+bool initialNotificationBackground(void)
+{
+  return chunkSize > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobAdd -
+*/
+bool initialNotificationJobAdd
+(
+  const std::string&               subId,
+  const EntityIdVector&            enV,
+  const StringList&                attrL,
+  const std::vector<std::string>&  metadataV,
+  const ConditionValueList&        condValues,
+  const ngsiv2::HttpInfo&          httpInfo,
+  RenderFormat                     renderFormat,
+  const std::string&               tenant,
+  const std::string&               xauthToken,
+  const std::vector<std::string>&  servicePathV,
+  const Restriction&               res,
+  const std::string&               fiwareCorrelator,
+  const std::vector<std::string>&  attrsOrder,
+  bool                             blacklist
+)
+{
+  InitialNotificationJob* jobP = new InitialNotificationJob();
+
+  for (unsigned int ix = 0; ix < res.scopeVector.size(); ++ix)
+  {
+    std::string  err;
+    Scope*       scopeP = res.scopeVector[ix]->clone(&err);
+
+    if (scopeP == NULL)
+    {
+      LM_E(("Runtime Error (cannot copy scope of subscription %s: %s)", subId.c_str(), err.c_str()));
+      delete jobP;
+
+      return false;
+    }
+
+    jobP->res.scopeVector.push_back(scopeP);
+  }
+
+  for (unsigned int ix = 0; ix < enV.size(); ++ix)
+  {
+    jobP->enV.push_back(new EntityId(enV[ix]));
+  }
+
+  jobP->subId            = subId;
+  jobP->attrL.fill(attrL.stringV);
+  jobP->metadataV        = metadataV;
+  jobP->condValues.vec   = condValues.vec;
+  jobP->httpInfo         = httpInfo;
+  jobP->renderFormat     = renderFormat;
+  jobP->tenant           = tenant;
+  jobP->xauthToken       = xauthToken;
+  jobP->servicePathV     = servicePathV;
+  jobP->fiwareCorrelator = fiwareCorrelator;
+  jobP->attrsOrder       = attrsOrder;
+  jobP->blacklist        = blacklist;
+
+  pthread_mutex_lock(&jobsMutex);
+  heldJobs.push_back(jobP);
+  pthread_mutex_unlock(&jobsMutex);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobHeld -
+*/
+bool initialNotificationJobHeld(const std::string& subId)
+{
+  bool held = false;
+
+  pthread_mutex_lock(&jobsMutex);
+
+  for (std::list<InitialNotificationJob*>::iterator it = heldJobs.begin(); it != heldJobs.end(); ++it)
+  {
+    if ((*it)->subId == subId)
+    {
+      held = true;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&jobsMutex);
+
+  return held;
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobsStart -
+*/
+void initialNotificationJobsStart(const std::string& subId, bool start)
+{
+  std::vector<InitialNotificationJob*>  discardedV;
+
+  pthread_mutex_lock(&jobsMutex);
+
+  std::list<InitialNotificationJob*>::iterator it = heldJobs.begin();
+
+  while (it != heldJobs.end())
+  {
+    InitialNotificationJob* jobP = *it;
+
+    if (jobP->subId != subId)
+    {
+      ++it;
+      continue;
+    }
+
+    it = heldJobs.erase(it);
+
+    if (start)
+    {
+      activeJobs.push_back(jobP);
+      jobQueue.push(jobP);
+      pthread_cond_signal(&jobsQueued);
+    }
+    else
+    {
+      discardedV.push_back(jobP);
+    }
+  }
+
+  pthread_mutex_unlock(&jobsMutex);
+
+  for (unsigned int ix = 0; ix < discardedV.size(); ++ix)
+  {
+    delete discardedV[ix];
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationCancel -
+*/
+bool initialNotificationCancel(const std::string& subId, long long* entitiesP, long long* notificationsP)
+{
+  bool found = false;
+
+  *entitiesP      = 0;
+  *notificationsP = 0;
+
+  pthread_mutex_lock(&jobsMutex);
+
+  for (std::list<InitialNotificationJob*>::iterator it = activeJobs.begin(); it != activeJobs.end(); ++it)
+  {
+    InitialNotificationJob* jobP = *it;
+
+    if (jobP->subId != subId)
+    {
+      continue;
+    }
+
+    pthread_mutex_lock(&jobP->mutex);
+
+    if (!jobP->cancelled)
+    {
+      jobP->cancelled  = true;
+      found            = true;
+      *entitiesP      += jobP->entities;
+      *notificationsP += jobP->notifications;
+    }
+
+    pthread_mutex_unlock(&jobP->mutex);
+  }
+
+  pthread_mutex_unlock(&jobsMutex);
+
+  return found;
+}
+
+
+
+#ifdef UNIT_TEST
+/* ****************************************************************************
+*
+* initialNotificationJobsIdle - no job is queued nor running
+*/
+bool initialNotificationJobsIdle(void)
+{
+  bool idle;
+
+  pthread_mutex_lock(&jobsMutex);
+  idle = jobQueue.empty() && activeJobs.empty();
+  pthread_mutex_unlock(&jobsMutex);
+
+  return idle;
+}
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobsLocked -
+*
+* The job list is only kept locked while initialNotificationCancel() waits for a job
+* which is sending a notification, so a notifier mock can use this to know that the
+* cancellation has reached the job.
+*/
+bool initialNotificationJobsLocked(void)
+{
+  if (pthread_mutex_trylock(&jobsMutex) != 0)
+  {
+    return true;
+  }
+
+  pthread_mutex_unlock(&jobsMutex);
+
+  return false;
+}
+#endif
@@ -0,0 +1,139 @@
+#ifndef SRC_LIB_MONGOBACKEND_INITIALNOTIFICATION_H_
+#define SRC_LIB_MONGOBACKEND_INITIALNOTIFICATION_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "apiTypesV2/HttpInfo.h"
+#include "common/RenderFormat.h"
+#include "ngsi/EntityIdVector.h"
+#include "ngsi/StringList.h"
+#include "ngsi/ConditionValueList.h"
+#include "ngsi/Restriction.h"
+
+
+
+/* ****************************************************************************
+*
+* INITIAL_NOTIF_WORKERS - number of threads running initial notification jobs
+*/
+#define INITIAL_NOTIF_WORKERS  2
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationInit -
+*
+* With a chunk size greater than zero, initial notifications are not sent from the
+* thread serving the subscription request, but by a background job that pages through
+* the matching entities and sends a notification for each page of chunkSize entities.
+* Zero keeps the synchronous initial notification. The worker threads are started by the
+* first call with a chunk size greater than zero.
+*/
+extern void initialNotificationInit(unsigned int chunkSize);
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationBackground -
+*/
+extern bool initialNotificationBackground(void);
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobAdd -
+*
+* Creates the job for the initial notification of a subscription, copying all the
+* arguments. The job is held until initialNotificationJobsStart() is called, once the
+* subscription has been written in DB.
+*
+* Returns false (and no job is created) if the restriction cannot be copied, so the
+* caller has to send the initial notification synchronously.
+*/
+extern bool initialNotificationJobAdd
+(
+  const std::string&               subId,
+  const EntityIdVector&            enV,
+  const StringList&                attrL,
+  const std::vector<std::string>&  metadataV,
+  const ConditionValueList&        condValues,
+  const ngsiv2::HttpInfo&          httpInfo,
+  RenderFormat                     renderFormat,
+  const std::string&               tenant,
+  const std::string&               xauthToken,
+  const std::vector<std::string>&  servicePathV,
+  const Restriction&               res,
+  const std::string&               fiwareCorrelator,
+  const std::vector<std::string>&  attrsOrder,
+  bool                             blacklist
+);
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobHeld - is there any held job for the subscription?
+*/
+extern bool initialNotificationJobHeld(const std::string& subId);
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationJobsStart -
+*
+* Queues the held jobs of the subscription (or discards them if start is false, i.e.
+* the subscription could not be written in DB).
+*/
+extern void initialNotificationJobsStart(const std::string& subId, bool start);
+
+
+
+/* ****************************************************************************
+*
+* initialNotificationCancel -
+*
+* Cancels the queued or running jobs of the subscription in this broker, returning
+* their progress. Once it returns, the cancelled jobs don't send any other notification
+* nor write the subscription in DB.
+*
+* Returns false if there was no job to cancel.
+*/
+extern bool initialNotificationCancel(const std::string& subId, long long* entitiesP, long long* notificationsP);
+
+
+
+#ifdef UNIT_TEST
+extern bool initialNotificationJobsIdle(void);
+extern bool initialNotificationJobsLocked(void);
+#endif
+
+#endif  // SRC_LIB_MONGOBACKEND_INITIALNOTIFICATION_H_
@@ -39,6 +39,7 @@
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/MongoCommonSubscription.h"
 #include "mongoBackend/dbConstants.h"
+#include "mongoBackend/initialNotification.h"
 #include "mongoBackend/mongoCreateSubscription.h"
 
 
@@ -193,6 +194,11 @@ std::string mongoCreateSubscription
     setCount(1, &b);
   }
 
+  if (initialNotificationJobHeld(subId))
+  {
+    setInitialNotification(INITIALNOTIF_PENDING, 0, 0, &b);
+  }
+
   setExpression(sub, &b);
   setFormat(sub, &b);
 
@@ -203,12 +209,14 @@ std::string mongoCreateSubscription
 
   if (!collectionInsert(getSubscribeContextCollectionName(tenant), doc, &err))
   {
+    initialNotificationJobsStart(subId, false);
     reqSemGive(__FUNCTION__, "ngsiv2 create subscription request", reqSemTaken);
     oe->fill(SccReceiverInternalError, err);
 
     return "";
   }
 
+  initialNotificationJobsStart(subId, true);
   reqSemGive(__FUNCTION__, "ngsiv2 create subscription request", reqSemTaken);
 
   return subId;
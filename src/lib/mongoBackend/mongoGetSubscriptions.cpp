@@ -42,6 +42,8 @@
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/dbConstants.h"
 #include "mongoBackend/mongoGetSubscriptions.h"
+#include "mongoBackend/pageCursor.h"
+#include "rest/uriParamNames.h"
 
 
 
@@ -51,6 +53,7 @@
 */
 using mongo::BSONObj;
 using mongo::BSONElement;
+using mongo::BSONObjBuilder;
 using mongo::DBClientCursor;
 using mongo::DBClientBase;
 using mongo::Query;
@@ -170,6 +173,16 @@ static void setNotification(Subscription* subP, const BSONObj& r, const std::str
   nP->lastFailure       = r.hasField(CSUB_LASTFAILURE)?      getIntOrLongFieldAsLongF(r, CSUB_LASTFAILURE)      : -1;
   nP->lastSuccess       = r.hasField(CSUB_LASTSUCCESS)?      getIntOrLongFieldAsLongF(r, CSUB_LASTSUCCESS)      : -1;
 
+  // Background initial notification progress
+  if (r.hasField(CSUB_INITIALNOTIF))
+  {
+    BSONObj initialNotification = getObjectFieldF(r, CSUB_INITIALNOTIF);
+
+    nP->initialStatus        = getStringFieldF(initialNotification, CSUB_INITIALNOTIF_STATUS);
+    nP->initialEntities      = getIntOrLongFieldAsLongF(initialNotification, CSUB_INITIALNOTIF_ENTITIES);
+    nP->initialNotifications = getIntOrLongFieldAsLongF(initialNotification, CSUB_INITIALNOTIF_SENT);
+  }
+
   // Attributes format
   subP->attrsFormat = r.hasField(CSUB_FORMAT)? stringToRenderFormat(getStringFieldF(r, CSUB_FORMAT)) : NGSI_V1_LEGACY;
 
@@ -257,10 +270,21 @@ void mongoListSubscriptions
   const std::string&                   servicePath,  // FIXME P4: vector of strings and not just a single string? See #3100
   int                                  limit,
   int                                  offset,
-  long long*                           count
+  long long*                           count,
+  std::string*                         nextCursorP
 )
 {
-  bool  reqSemTaken = false;
+  bool     reqSemTaken = false;
+  BSONObj  cursorKey;
+
+  if ((nextCursorP != NULL) && (uriParam[URI_PARAM_CURSOR] != ""))
+  {
+    if (!pageCursorDecode(uriParam[URI_PARAM_CURSOR], &cursorKey) || (cursorKey.getField("i").type() != mongo::jstOID))
+    {
+      *oe = OrionError(SccBadRequest, ERROR_DESC_BAD_REQUEST_INVALID_CURSOR, ERROR_BAD_REQUEST);
+      return;
+    }
+  }
 
   reqSemTake(__FUNCTION__, "Mongo List Subscriptions", SemReadOp, &reqSemTaken);
 
@@ -272,12 +296,33 @@ void mongoListSubscriptions
    */
   std::auto_ptr<DBClientCursor>  cursor;
   std::string                    err;
+  BSONObj                        filter;
   Query                          q;
 
   // FIXME P6: This here is a bug ... See #3099 for more info
   if (!servicePath.empty() && (servicePath != "/#"))
   {
-    q = Query(BSON(CSUB_SERVICE_PATH << servicePath));
+    filter = BSON(CSUB_SERVICE_PATH << servicePath);
+    q      = Query(filter);
+  }
+
+  //
+  // Keyset pagination: the page starts after the _id in the cursor, so it is solved
+  // with a range scan on the _id index whatever the page depth is
+  //
+  if ((nextCursorP != NULL) && (!cursorKey.isEmpty()))
+  {
+    BSONObjBuilder  range;
+
+    range.appendElements(filter);
+    range.append("_id", BSON("$gt" << cursorKey.getField("i").OID()));
+
+    q = Query(range.obj());
+  }
+
+  if (nextCursorP != NULL)
+  {
+    offset = 0;
   }
 
   q.sort(BSON("_id" << 1));
@@ -291,7 +336,8 @@ void mongoListSubscriptions
                              offset,
                              &cursor,
                              count,
-                             &err))
+                             &err,
+                             (nextCursorP != NULL)? &filter : NULL))
   {
     releaseMongoConnection(connection);
     TIME_STAT_MONGO_READ_WAIT_STOP();
@@ -303,6 +349,7 @@ void mongoListSubscriptions
 
   /* Process query result */
   unsigned int docs = 0;
+  BSONObj      lastKey;
 
   while (moreSafe(cursor))
   {
@@ -326,9 +373,20 @@ void mongoListSubscriptions
     setNotification(&s, r, tenant);
 
     subs->push_back(s);
+
+    if (nextCursorP != NULL)
+    {
+      lastKey = BSON("i" << getFieldF(r, "_id").OID());
+    }
   }
 
   releaseMongoConnection(connection);
+
+  if (nextCursorP != NULL)
+  {
+    // A full page means that there could be more subscriptions after it
+    *nextCursorP = ((limit > 0) && (docs == (unsigned int) limit))? pageCursorEncode(lastKey) : "";
+  }
   reqSemGive(__FUNCTION__, "Mongo List Subscriptions", reqSemTaken);
 
   *oe = OrionError(SccOk);
@@ -37,6 +37,10 @@
 /* ****************************************************************************
 *
 * mongoListSubscriptions -
+*
+* If nextCursorP is not NULL, keyset pagination is used instead of offset, starting after the
+* cursor in uriParam[URI_PARAM_CURSOR] (if any). The cursor for the next page is returned in
+* nextCursorP (empty if there are no more pages).
 */
 extern void mongoListSubscriptions
 (
@@ -47,7 +51,8 @@ extern void mongoListSubscriptions
   const std::string&                   servicePath,
   int                                  limit,
   int                                  offset,
-  long long*                           count
+  long long*                           count,
+  std::string*                         nextCursorP = NULL
 );
 
 
@@ -303,6 +303,12 @@ static void processGenericEntities
 *
 *   This replaces the 'uriParams[URI_PARAM_PAGINATION_DETAILS]' way of passing this information.
 *   The old method was one-way, using the new method 
+*
+*   If nextCursorP is non-NULL, keyset pagination is used (starting at the cursor in
+*   uriParams[URI_PARAM_CURSOR], if any) and the cursor for the next page is returned in it.
+*   If jsonRenderP is non-NULL, the entities are rendered to NGSIv2 JSON directly from the DB
+*   documents (in ContextElementResponse::renderedJson) as long as no registration could
+*   provide attributes for them. Otherwise it is ignored.
 */
 HttpStatusCode mongoQueryContext
 (
@@ -313,7 +319,9 @@ HttpStatusCode mongoQueryContext
   std::map<std::string, std::string>&  uriParams,
   std::map<std::string, bool>&         options,
   long long*                           countP,
-  ApiVersion                           apiVersion
+  ApiVersion                           apiVersion,
+  std::string*                         nextCursorP,
+  const EntityJsonRender*              jsonRenderP
 )
 {
   int         offset         = atoi(uriParams[URI_PARAM_PAGINATION_OFFSET].c_str());
@@ -362,6 +370,33 @@ HttpStatusCode mongoQueryContext
   }
 
   reqSemTake(__FUNCTION__, "ngsi10 query request", SemReadOp, &reqSemTaken);
+
+  //
+  // Direct rendering from the DB documents is only possible if no CPr can be involved. A query
+  // for registrations without attributes matches any registration the lookups below could find,
+  // so if it returns nothing these lookups are skipped altogether
+  //
+  ContextRegistrationResponseVector crrV;
+  StringList                        attrNullList;
+  bool                              noRegistrations = false;
+
+  if ((jsonRenderP != NULL) &&
+      (requestP->metadataList.size() == 0) &&
+      ((requestP->attributeList.size() == 0) || requestP->attributeList.lookup(ALL_ATTRS)))
+  {
+    if (registrationsQuery(requestP->entityIdVector, attrNullList, &crrV, &err, tenant, servicePathV, 0, 0, false))
+    {
+      noRegistrations = (crrV.size() == 0);
+    }
+
+    crrV.release();
+  }
+
+  if (!noRegistrations)
+  {
+    jsonRenderP = NULL;
+  }
+
   ok = entitiesQuery(requestP->entityIdVector,
                      requestP->attributeList,
                      requestP->metadataList,
@@ -376,7 +411,10 @@ HttpStatusCode mongoQueryContext
                      &limitReached,
                      countP,
                      sortOrderList,
-                     apiVersion);
+                     apiVersion,
+                     uriParams[URI_PARAM_CURSOR],
+                     nextCursorP,
+                     jsonRenderP);
 
   if (!ok)
   {
@@ -387,10 +425,8 @@ HttpStatusCode mongoQueryContext
     return SccOk;
   }
 
-  ContextRegistrationResponseVector crrV;
-
   /* In the case of empty response, if only generic processing is needed */
-  if (rawCerV.size() == 0)
+  if ((rawCerV.size() == 0) && !noRegistrations)
   {
     if (registrationsQuery(requestP->entityIdVector, requestP->attributeList, &crrV, &err, tenant, servicePathV, 0, 0, false))
     {
@@ -404,7 +440,7 @@ HttpStatusCode mongoQueryContext
   }
 
   /* First CPr lookup (in the case some CER is not found): looking in E-A registrations */
-  if (someContextElementNotFound(rawCerV))
+  if (!noRegistrations && someContextElementNotFound(rawCerV))
   {
     if (registrationsQuery(requestP->entityIdVector, requestP->attributeList, &crrV, &err, tenant, servicePathV, 0, 0, false))
     {
@@ -419,9 +455,7 @@ HttpStatusCode mongoQueryContext
   }
 
   /* Second CPr lookup (in the case some element stills not being found): looking in E-<null> registrations */
-  StringList attrNullList;
-
-  if (someContextElementNotFound(rawCerV))
+  if (!noRegistrations && someContextElementNotFound(rawCerV))
   {
     if (registrationsQuery(requestP->entityIdVector, attrNullList, &crrV, &err, tenant, servicePathV, 0, 0, false))
     {
@@ -438,7 +472,7 @@ HttpStatusCode mongoQueryContext
    * the list need to be completed. Note that in the case of having this request someContextElementNotFound() is always false
    * so we efficient not invoking registrationQuery() too much times
    */
-  if (requestP->attributeList.size() == 0)
+  if (!noRegistrations && (requestP->attributeList.size() == 0))
   {
     if (registrationsQuery(requestP->entityIdVector, requestP->attributeList, &crrV, &err, tenant, servicePathV, 0, 0, false))
     {
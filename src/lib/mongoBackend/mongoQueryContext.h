@@ -33,6 +33,7 @@
 #include "ngsi10/QueryContextRequest.h"
 #include "ngsi10/QueryContextResponse.h"
 #include "rest/StringFilter.h"
+#include "mongoBackend/entityJsonRender.h"
 
 
 
@@ -49,7 +50,9 @@ extern HttpStatusCode mongoQueryContext
   std::map<std::string, std::string>&   uriParams,
   std::map<std::string, bool>&          options,
   long long*                            countP        = NULL,
-  ApiVersion                            apiVersion    = V1
+  ApiVersion                            apiVersion    = V1,
+  std::string*                          nextCursorP   = NULL,
+  const EntityJsonRender*               jsonRenderP   = NULL
 );
 
 #endif  // SRC_LIB_MONGOBACKEND_MONGOQUERYCONTEXT_H_
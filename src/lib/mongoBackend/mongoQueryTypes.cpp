@@ -68,19 +68,19 @@ static void getAttributeTypes
 )
 {
   std::string  idType         = std::string("_id.")    + ENT_ENTITY_TYPE;
-  std::string  idServicePath  = std::string("_id.")    + ENT_SERVICE_PATH;
+  std::string  idServicePath  = entityServicePathField();
   BSONObj      query;
 
   if (entityType == "")
   {
     query = BSON("$or"         << BSON_ARRAY(BSON(idType << entityType) << BSON(idType << BSON("$exists" << false)) ) <<
-                 idServicePath << fillQueryServicePath(servicePathV) <<
+                 idServicePath << fillQueryEntityServicePath(servicePathV) <<
                  ENT_ATTRNAMES << attrName);
   }
   else
   {
     query = BSON(idType        << entityType <<
-                 idServicePath << fillQueryServicePath(servicePathV) <<
+                 idServicePath << fillQueryEntityServicePath(servicePathV) <<
                  ENT_ATTRNAMES << attrName);
   }
 
@@ -158,10 +158,10 @@ static long long countEntities
 )
 {
   std::string    idType        = std::string("_id.") + ENT_ENTITY_TYPE;
-  std::string    idServicePath = std::string("_id.") + ENT_SERVICE_PATH;
+  std::string    idServicePath = entityServicePathField();
 
   BSONObj query = BSON(idType        << entityType <<
-                       idServicePath << fillQueryServicePath(servicePathV));
+                       idServicePath << fillQueryEntityServicePath(servicePathV));
 
   std::string         err;
   unsigned long long  c;
@@ -214,16 +214,16 @@ HttpStatusCode mongoEntityTypesValues
    */
 
   BSONObj result;
-  BSONObj spQuery = fillQueryServicePath(servicePathV);
+  BSONObj spQuery = fillQueryEntityServicePath(servicePathV);
   BSONObj cmd     = BSON("aggregate" << COL_ENTITIES <<
                          "pipeline"  << BSON_ARRAY(
-                           BSON("$match" << BSON(C_ID_SERVICEPATH << spQuery)) <<
+                           BSON("$match" << BSON(entityServicePathField() << spQuery)) <<
                            BSON("$group" << BSON("_id" << CS_ID_ENTITY)) <<
                            BSON("$sort"  << BSON("_id" << 1))));
 
   std::string err;
 
-  if (!runCollectionCommand(composeDatabaseName(tenant), cmd, &result, &err))
+  if (!runCollectionCommand(getDatabaseName(tenant), cmd, &result, &err))
   {
     responseP->statusCode.fill(SccReceiverInternalError, err);
     reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
@@ -371,7 +371,7 @@ HttpStatusCode mongoEntityTypes
 
   BSONObj cmd = BSON("aggregate" << COL_ENTITIES <<
                      "pipeline" << BSON_ARRAY(
-                                              BSON("$match" << BSON(C_ID_SERVICEPATH << fillQueryServicePath(servicePathV))) <<
+                                              BSON("$match" << BSON(entityServicePathField() << fillQueryEntityServicePath(servicePathV))) <<
                                               BSON("$project" << BSON("_id" << 1 << ENT_ATTRNAMES << 1)) <<
                                               projection << BSON("$unwind" << S_ATTRNAMES) <<
                                               BSON("$group" << BSON("_id"   << CS_ID_ENTITY <<
@@ -380,7 +380,7 @@ HttpStatusCode mongoEntityTypes
 
   std::string err;
 
-  if (!runCollectionCommand(composeDatabaseName(tenant), cmd, &result, &err))
+  if (!runCollectionCommand(getDatabaseName(tenant), cmd, &result, &err))
   {
     responseP->statusCode.fill(SccReceiverInternalError, err);
     reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
@@ -601,7 +601,7 @@ HttpStatusCode mongoAttributesForEntityType
     BSON("aggregate" << COL_ENTITIES <<
          "pipeline" << BSON_ARRAY(
            BSON("$match" << BSON(C_ID_ENTITY << entityType <<
-                                 C_ID_SERVICEPATH << fillQueryServicePath(servicePathV))) <<
+                                 entityServicePathField() << fillQueryEntityServicePath(servicePathV))) <<
            BSON("$project" << BSON("_id" << 1 << ENT_ATTRNAMES << 1)) <<
            BSON("$unwind" << S_ATTRNAMES) <<
            BSON("$group" << BSON("_id" << CS_ID_ENTITY << "attrs" << BSON("$addToSet" << S_ATTRNAMES))) <<
@@ -610,7 +610,7 @@ HttpStatusCode mongoAttributesForEntityType
            BSON("$sort" << BSON("_id" << 1))));
 
   std::string err;
-  if (!runCollectionCommand(composeDatabaseName(tenant), cmd, &result, &err))
+  if (!runCollectionCommand(getDatabaseName(tenant), cmd, &result, &err))
   {
     responseP->statusCode.fill(SccReceiverInternalError, err);
     reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
@@ -36,6 +36,7 @@
 #include "rest/OrionError.h"
 #include "rest/HttpStatusCode.h"
 #include "apiTypesV2/Registration.h"
+#include "cache/regCache.h"
 #include "mongoBackend/dbConstants.h"
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/MongoGlobal.h"
@@ -205,13 +206,18 @@ void mongoRegistrationCreate
   mongo::BSONObj  doc = bob.obj();
   std::string     err;
 
-  if (!collectionInsert(getRegistrationsCollectionName(tenant), doc, &err))
+  bool ok = collectionInsert(getRegistrationsCollectionName(tenant), doc, &err);
+
+  if (!ok)
   {
+    regCacheTenantRefresh(tenant);
     reqSemGive(__FUNCTION__, "Mongo Create Registration", reqSemTaken);
     oeP->fill(SccReceiverInternalError, err);
     return;
   }
 
+  regCacheItemUpsert(tenant, doc);
+
   reqSemGive(__FUNCTION__, "Mongo Create Registration", reqSemTaken);
 
   oeP->fill(SccOk, "");
@@ -36,6 +36,7 @@
 #include "rest/OrionError.h"
 #include "rest/HttpStatusCode.h"
 #include "apiTypesV2/Registration.h"
+#include "cache/regCache.h"
 #include "mongoBackend/dbConstants.h"
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/MongoGlobal.h"
@@ -122,6 +123,7 @@ void mongoRegistrationDelete
     if (!collectionRemove(getRegistrationsCollectionName(tenant), q, &err))
     {
       releaseMongoConnection(connection);
+      regCacheTenantRefresh(tenant);
       LM_E(("Runtime Error (exception in collectionRemove(): %s - query: %s", err.c_str(), q.toString().c_str()));
       reqSemGive(__FUNCTION__, "Mongo Delete Registration", reqSemTaken);
       oeP->fill(SccReceiverInternalError, std::string("exception in collectionRemove(): ") + err.c_str());
@@ -139,6 +141,9 @@ void mongoRegistrationDelete
   }
 
   releaseMongoConnection(connection);
+
+  regCacheItemRemove(tenant, oid);
+
   reqSemGive(__FUNCTION__, "Mongo Delete Registration", reqSemTaken);
 
   oeP->fill(SccNoContent, "");
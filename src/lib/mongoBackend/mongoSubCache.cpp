@@ -37,6 +37,7 @@
 #include "common/RenderFormat.h"
 #include "alarmMgr/alarmMgr.h"
 #include "rest/StringFilter.h"
+#include "rest/Verb.h"
 #include "cache/subCache.h"
 
 #include "mongoBackend/MongoGlobal.h"
@@ -52,6 +53,8 @@
 * USING
 */
 using mongo::BSONObj;
+using mongo::BSONObjBuilder;
+using mongo::BSONArrayBuilder;
 using mongo::BSONElement;
 using mongo::DBClientCursor;
 using mongo::DBClientBase;
@@ -73,8 +76,9 @@ using mongo::OID;
 *
 * Note that the 'count' of the inserted subscription is set to ZERO.
 *
+* The subscription is inserted in the given partition, not in the cache (see subCacheRefresh()).
 */
-int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
+int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub, SubCachePartition* partP)
 {
   //
   // 01. Check validity of subP parameter
@@ -236,13 +240,114 @@ int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
   setStringVectorF(sub, CSUB_CONDITIONS, &(cSubP->notifyConditionV));
 
 
-  subCacheItemInsert(cSubP);
+  subCachePartitionInsert(partP, cSubP);
 
   return 0;
 }
 
 
 
+/* ****************************************************************************
+*
+* mongoSubCacheItemToBson -
+*
+* Inverse of mongoSubCacheItemInsert(tenant, sub, partP): the csubs document (with
+* the fields the cache uses) of a cached subscription. Used by the cache snapshot
+* (see cache/subCacheSnapshot.h).
+*/
+BSONObj mongoSubCacheItemToBson(const CachedSubscription* cSubP)
+{
+  BSONObjBuilder    bob;
+  BSONArrayBuilder  entities;
+
+  bob.append("_id", OID(cSubP->subscriptionId));
+  bob.append(CSUB_SERVICE_PATH, cSubP->servicePath);
+  bob.append(CSUB_FORMAT, renderFormatToString(cSubP->renderFormat, false, true));
+  bob.append(CSUB_THROTTLING, (long long) cSubP->throttling);
+  bob.append(CSUB_EXPIRATION, (long long) cSubP->expirationTime);
+  bob.append(CSUB_STATUS, cSubP->status);
+  bob.append(CSUB_BLACKLIST, cSubP->blacklist);
+
+  // -1 stands for 'not in DB'
+  if (cSubP->lastNotificationTime != -1)
+  {
+    bob.append(CSUB_LASTNOTIFICATION, (long long) cSubP->lastNotificationTime);
+  }
+
+  if (cSubP->lastFailure != -1)
+  {
+    bob.append(CSUB_LASTFAILURE, (long long) cSubP->lastFailure);
+  }
+
+  if (cSubP->lastSuccess != -1)
+  {
+    bob.append(CSUB_LASTSUCCESS, (long long) cSubP->lastSuccess);
+  }
+
+  //
+  // httpInfo
+  //
+  const ngsiv2::HttpInfo& httpInfo = cSubP->httpInfo;
+
+  bob.append(CSUB_REFERENCE, httpInfo.url);
+  bob.append(CSUB_CUSTOM, httpInfo.custom);
+
+  if (httpInfo.custom)
+  {
+    BSONObjBuilder  qs;
+    BSONObjBuilder  headers;
+
+    for (std::map<std::string, std::string>::const_iterator it = httpInfo.qs.begin(); it != httpInfo.qs.end(); ++it)
+    {
+      qs.append(it->first, it->second);
+    }
+
+    for (std::map<std::string, std::string>::const_iterator it = httpInfo.headers.begin(); it != httpInfo.headers.end(); ++it)
+    {
+      headers.append(it->first, it->second);
+    }
+
+    bob.append(CSUB_PAYLOAD, httpInfo.payload);
+    bob.append(CSUB_QS, qs.obj());
+    bob.append(CSUB_HEADERS, headers.obj());
+
+    if (httpInfo.verb != NOVERB)
+    {
+      bob.append(CSUB_METHOD, verbName(httpInfo.verb));
+    }
+  }
+
+  //
+  // expression
+  //
+  bob.append(CSUB_EXPR, BSON(CSUB_EXPR_Q      << cSubP->expression.q        <<
+                             CSUB_EXPR_MQ     << cSubP->expression.mq       <<
+                             CSUB_EXPR_GEOM   << cSubP->expression.geometry <<
+                             CSUB_EXPR_COORDS << cSubP->expression.coords   <<
+                             CSUB_EXPR_GEOREL << cSubP->expression.georel));
+
+  //
+  // entities, attributes and conditions
+  //
+  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  {
+    const EntityInfo* eiP = cSubP->entityIdInfos[ix];
+
+    entities.append(BSON(CSUB_ENTITY_ID            << eiP->entityId                        <<
+                         CSUB_ENTITY_ISPATTERN     << (eiP->isPattern? "true" : "false")  <<
+                         CSUB_ENTITY_TYPE          << eiP->entityType                      <<
+                         CSUB_ENTITY_ISTYPEPATTERN << eiP->isTypePattern));
+  }
+
+  bob.append(CSUB_ENTITIES, entities.arr());
+  bob.append(CSUB_ATTRS, cSubP->attributes);
+  bob.append(CSUB_CONDITIONS, cSubP->notifyConditionV);
+
+  return bob.obj();
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCacheItemInsert -
@@ -437,9 +542,9 @@ int mongoSubCacheItemInsert
 *
 * mongoSubCacheRefresh -
 *
-* 1. Empty cache
-* 2. Lookup all subscriptions in the database
-* 3. Insert them again in the cache (with fresh data from database)
+* Lookup all subscriptions in the database and insert them in the partition (with
+* fresh data from database). It doesn't touch the cache, so it can be run for several
+* databases at the same time.
 *
 * NOTE
 *   The query for the database ONLY extracts the interesting subscriptions:
@@ -447,7 +552,7 @@ int mongoSubCacheItemInsert
 *
 *   I.e. the subscriptions is for ONCHANGE.
 */
-void mongoSubCacheRefresh(const std::string& database)
+void mongoSubCacheRefresh(const std::string& database, SubCachePartition* partP)
 {
   LM_T(LmtSubCache, ("Refreshing subscription cache for DB '%s'", database.c_str()));
 
@@ -480,7 +585,7 @@ void mongoSubCacheRefresh(const std::string& database)
       continue;
     }
 
-    int r = mongoSubCacheItemInsert(tenant.c_str(), sub);
+    int r = mongoSubCacheItemInsert(tenant.c_str(), sub, partP);
     if (r == 0)
     {
       ++subNo;
@@ -33,6 +33,7 @@
 #include "mongo/client/dbclient.h"
 #include "common/RenderFormat.h"
 #include "rest/StringFilter.h"
+#include "cache/subCache.h"
 
 
 
@@ -40,7 +41,7 @@
 *
 * mongoSubCacheItemInsert - 
 */
-extern int mongoSubCacheItemInsert(const char* tenant, const mongo::BSONObj& sub);
+extern int mongoSubCacheItemInsert(const char* tenant, const mongo::BSONObj& sub, SubCachePartition* partP);
 
 
 
@@ -71,11 +72,19 @@ extern int mongoSubCacheItemInsert
 
 
 
+/* ****************************************************************************
+*
+* mongoSubCacheItemToBson - csubs document of a cached subscription
+*/
+extern mongo::BSONObj mongoSubCacheItemToBson(const CachedSubscription* cSubP);
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCacheRefresh - 
 */
-extern void mongoSubCacheRefresh(const std::string& database);
+extern void mongoSubCacheRefresh(const std::string& database, SubCachePartition* partP);
 
 
 
@@ -34,6 +34,7 @@
 #include "mongoBackend/mongoSubscribeContextAvailability.h"
 #include "mongoBackend/connectionOperations.h"
 #include "mongoBackend/dbConstants.h"
+#include "cache/casubCache.h"
 #include "ngsi9/SubscribeContextAvailabilityRequest.h"
 #include "ngsi9/SubscribeContextAvailabilityResponse.h"
 #include "rest/uriParamNames.h"
@@ -126,7 +127,11 @@ HttpStatusCode mongoSubscribeContextAvailability
 
   /* Insert document in database */
   std::string err;
-  if (!collectionInsert(getSubscribeContextAvailabilityCollectionName(tenant), sub.obj(), &err))
+  bool        ok = collectionInsert(getSubscribeContextAvailabilityCollectionName(tenant), sub.obj(), &err);
+
+  casubCacheTenantRefresh(tenant);
+
+  if (!ok)
   {
     reqSemGive(__FUNCTION__, "ngsi9 subscribe request (mongo db exception)", reqSemTaken);
     responseP->errorCode.fill(SccReceiverInternalError, err);
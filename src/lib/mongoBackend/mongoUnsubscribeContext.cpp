@@ -34,6 +34,7 @@
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
 #include "mongoBackend/mongoUnsubscribeContext.h"
+#include "mongoBackend/initialNotification.h"
 #include "mongoBackend/safeMongo.h"
 #include "cache/subCache.h"
 #include "ngsi10/UnsubscribeContextRequest.h"
@@ -147,6 +148,12 @@ HttpStatusCode mongoUnsubscribeContext
     return SccOk;
   }
 
+  // Stop its background initial notification, if any is in progress
+  long long  entities;
+  long long  notifications;
+
+  initialNotificationCancel(requestP->subscriptionId.get(), &entities, &notifications);
+
   //
   // Removing subscription from mongo subscription cache
   //
@@ -27,6 +27,7 @@
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 #include "alarmMgr/alarmMgr.h"
+#include "cache/casubCache.h"
 #include "common/sem.h"
 #include "ngsi9/UnsubscribeContextAvailabilityRequest.h"
 #include "ngsi9/UnsubscribeContextAvailabilityResponse.h"
@@ -117,7 +118,11 @@ HttpStatusCode mongoUnsubscribeContextAvailability
   //
 
   std::string colName = getSubscribeContextAvailabilityCollectionName(tenant);
-  if (!collectionRemove(colName, BSON("_id" << OID(requestP->subscriptionId.get())), &err))
+  bool        ok      = collectionRemove(colName, BSON("_id" << OID(requestP->subscriptionId.get())), &err);
+
+  casubCacheTenantRefresh(tenant);
+
+  if (!ok)
   {
     reqSemGive(__FUNCTION__, "ngsi9 unsubscribe request (mongo db exception)", reqSemTaken);
     responseP->statusCode.fill(SccReceiverInternalError, err);
@@ -80,6 +80,18 @@ HttpStatusCode mongoUpdateContext
   }
   else
   {
+    //
+    // In batch updates, the notifications are grouped by subscription and sent once all
+    // the entities have been processed
+    //
+    NotificationBatch   batch;
+    NotificationBatch*  batchP = NULL;
+
+    if ((requestP->contextElementVector.size() > 1) && notificationBatchEnabled())
+    {
+      batchP = &batch;
+    }
+
     /* Process each ContextElement */
     for (unsigned int ix = 0; ix < requestP->contextElementVector.size(); ++ix)
     {
@@ -93,7 +105,13 @@ HttpStatusCode mongoUpdateContext
                             fiwareCorrelator,
                             ngsiV2AttrsFormat,
                             apiVersion,
-                            ngsiv2Flavour);
+                            ngsiv2Flavour,
+                            batchP);
+    }
+
+    if (batchP != NULL)
+    {
+      notificationBatchFlush(batchP, tenant, xauthToken, fiwareCorrelator);
     }
 
     /* Note that although individual processContextElements() invocations return ConnectionError, this
@@ -31,6 +31,7 @@
 #include "common/MimeType.h"
 #include "common/sem.h"
 #include "alarmMgr/alarmMgr.h"
+#include "cache/casubCache.h"
 
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
@@ -189,8 +190,11 @@ HttpStatusCode mongoUpdateContextAvailabilitySubscription
 
   std::string  colName = getSubscribeContextAvailabilityCollectionName(tenant);
   BSONObj      bson    = BSON("_id" << OID(requestP->subscriptionId.get()));
+  bool         ok      = collectionUpdate(colName, bson, newSub.obj(), false, &err);
 
-  if (!collectionUpdate(colName, bson, newSub.obj(), false, &err))
+  casubCacheTenantRefresh(tenant);
+
+  if (!ok)
   {
     reqSemGive(__FUNCTION__, "ngsi9 update subscription request (mongo db exception)", reqSemTaken);
     responseP->errorCode.fill(SccReceiverInternalError, err);
@@ -40,6 +40,7 @@
 #include "mongoBackend/dbConstants.h"
 #include "mongoBackend/safeMongo.h"
 #include "mongoBackend/mongoSubCache.h"
+#include "mongoBackend/initialNotification.h"
 #include "mongoBackend/mongoUpdateSubscription.h"
 
 
@@ -577,6 +578,41 @@ static long long setLastSuccess(const BSONObj& subOrig, CachedSubscription* subC
 
 
 
+/* ****************************************************************************
+*
+* setInitialNotification -
+*
+* A new subject or the deactivation of the subscription cancels the background initial
+* notification of the subscription, if any is in progress in this broker (a new one
+* may have been created by setCondsAndInitialNotify())
+*/
+static void setInitialNotification(const SubscriptionUpdate& subUp, const BSONObj& subOrig, BSONObjBuilder* b)
+{
+  long long  entities      = 0;
+  long long  notifications = 0;
+  bool       cancelled     = false;
+
+  if (subUp.subjectProvided || (subUp.statusProvided && (subUp.status == STATUS_INACTIVE)))
+  {
+    cancelled = initialNotificationCancel(subUp.id, &entities, &notifications);
+  }
+
+  if (initialNotificationJobHeld(subUp.id))
+  {
+    setInitialNotification(INITIALNOTIF_PENDING, 0, 0, b);
+  }
+  else if (cancelled)
+  {
+    setInitialNotification(INITIALNOTIF_CANCELLED, entities, notifications, b);
+  }
+  else if (subOrig.hasField(CSUB_INITIALNOTIF))
+  {
+    b->append(CSUB_INITIALNOTIF, getObjectFieldF(subOrig, CSUB_INITIALNOTIF));
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * setExpression -
@@ -948,6 +984,7 @@ std::string mongoUpdateSubscription
 
   lastFailure = setLastFailure(subOrig, subCacheP, &b);
   lastSuccess = setLastSuccess(subOrig, subCacheP, &b);
+  setInitialNotification(subUp, subOrig, &b);
 
   setExpression(subUp, subOrig, &b);
   setFormat(subUp, subOrig, &b);
@@ -960,6 +997,7 @@ std::string mongoUpdateSubscription
 
   if (!collectionUpdate(colName, bson, doc, false, &err))
   {
+    initialNotificationJobsStart(subUp.id, false);
     reqSemGive(__FUNCTION__, "ngsiv2 update subscription request (mongo db exception)", reqSemTaken);
     oe->fill(SccReceiverInternalError, err);
 
@@ -972,6 +1010,7 @@ std::string mongoUpdateSubscription
     updateInCache(doc, subUp, tenant, lastNotification, lastFailure, lastSuccess);
   }
 
+  initialNotificationJobsStart(subUp.id, true);
   reqSemGive(__FUNCTION__, "ngsiv2 update subscription request", reqSemTaken);
 
   return subUp.id;
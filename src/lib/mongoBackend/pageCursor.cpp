@@ -0,0 +1,148 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "mongo/client/dbclient.h"
+
+#include "mongoBackend/pageCursor.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::BSONObj;
+
+
+
+/* ****************************************************************************
+*
+* PAGE_CURSOR_MAX_SIZE -
+*
+* Maximum size of the BSON object in a cursor. Entity ids, types and service paths are
+* already limited in length, so this is enough for any legitimate cursor.
+*/
+#define PAGE_CURSOR_MAX_SIZE  4096
+
+
+
+/* ****************************************************************************
+*
+* hexValue -
+*/
+static int hexValue(char c)
+{
+  if ((c >= '0') && (c <= '9'))
+  {
+    return c - '0';
+  }
+  else if ((c >= 'a') && (c <= 'f'))
+  {
+    return c - 'a' + 10;
+  }
+
+  return -1;
+}
+
+
+
+/* ****************************************************************************
+*
+* pageCursorEncode -
+*/
+std::string pageCursorEncode(const BSONObj& key)
+{
+  static const char  hexDigits[] = "0123456789abcdef";
+  const char*        data        = key.objdata();
+  int                size        = key.objsize();
+  std::string        token;
+
+  token.reserve(size * 2);
+
+  for (int ix = 0; ix < size; ++ix)
+  {
+    unsigned char c = (unsigned char) data[ix];
+
+    token += hexDigits[c >> 4];
+    token += hexDigits[c & 0x0F];
+  }
+
+  return token;
+}
+
+
+
+/* ****************************************************************************
+*
+* pageCursorDecode -
+*/
+bool pageCursorDecode(const std::string& token, BSONObj* keyP)
+{
+  unsigned int size = token.size() / 2;
+
+  // The smallest BSON object (the empty one) takes 5 bytes
+  if ((token.size() % 2 != 0) || (size < 5) || (size > PAGE_CURSOR_MAX_SIZE))
+  {
+    return false;
+  }
+
+  char buf[PAGE_CURSOR_MAX_SIZE];
+
+  for (unsigned int ix = 0; ix < size; ++ix)
+  {
+    int hi = hexValue(token[ix * 2]);
+    int lo = hexValue(token[ix * 2 + 1]);
+
+    if ((hi < 0) || (lo < 0))
+    {
+      return false;
+    }
+
+    buf[ix] = (char) ((hi << 4) | lo);
+  }
+
+  // BSON size prefix is a little endian int32 that has to match the decoded size
+  unsigned int bsonSize = ((unsigned char) buf[0])         |
+                          ((unsigned char) buf[1] << 8)    |
+                          ((unsigned char) buf[2] << 16)   |
+                          ((unsigned int) ((unsigned char) buf[3]) << 24);
+
+  if ((bsonSize != size) || (buf[size - 1] != 0))
+  {
+    return false;
+  }
+
+  BSONObj key(buf);
+
+  if (!key.valid())
+  {
+    return false;
+  }
+
+  *keyP = key.getOwned();
+
+  return true;
+}
@@ -0,0 +1,53 @@
+#ifndef SRC_LIB_MONGOBACKEND_PAGECURSOR_H_
+#define SRC_LIB_MONGOBACKEND_PAGECURSOR_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "mongo/client/dbclient.h"
+
+
+
+/* ****************************************************************************
+*
+* pageCursorEncode -
+*
+* Pagination cursors are opaque to the client. Internally they are the BSON object
+* holding the sort key of the last document returned (plus its _id), hex encoded.
+*/
+extern std::string pageCursorEncode(const mongo::BSONObj& key);
+
+
+
+/* ****************************************************************************
+*
+* pageCursorDecode -
+*
+* Returns false if the token is not a well formed cursor
+*/
+extern bool pageCursorDecode(const std::string& token, mongo::BSONObj* keyP);
+
+#endif  // SRC_LIB_MONGOBACKEND_PAGECURSOR_H_
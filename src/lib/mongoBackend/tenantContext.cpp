@@ -0,0 +1,156 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <pthread.h>
+
+#include <string>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/StringHashTable.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/tenantContext.h"
+
+
+
+/* ****************************************************************************
+*
+* Tenant registry -
+*
+* Readers look the tenants up without any lock (see StringHashTable). The mutex is taken
+* to create a context or to compose its names again.
+*/
+static StringHashTable<TenantContext, &TenantContext::tenant, TENANT_REGISTRY_SIZE>  tenantRegistry;
+static pthread_mutex_t                                                              tenantRegistryMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int                                                                 namesGeneration     = 1;
+
+
+
+/* ****************************************************************************
+*
+* namesCompose -
+*
+* To be called with tenantRegistryMutex taken. As the names have changed, the indexes
+* have to be ensured again.
+*/
+static void namesCompose(TenantContext* tcP)
+{
+  tcP->entityIndexesEnsured    = false;
+  tcP->dbName                  = composeDatabaseName(tcP->tenant);
+  tcP->entitiesCollection      = composeCollectionName(tcP->tenant, ColEntities);
+  tcP->registrationsCollection = composeCollectionName(tcP->tenant, ColRegistrations);
+  tcP->csubsCollection         = composeCollectionName(tcP->tenant, ColCsubs);
+  tcP->casubsCollection        = composeCollectionName(tcP->tenant, ColCasubs);
+
+  __sync_synchronize();
+  tcP->namesGeneration = namesGeneration;
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantContextCreate -
+*
+* To be called with tenantRegistryMutex taken
+*/
+static TenantContext* tenantContextCreate(const std::string& tenant, unsigned int hash)
+{
+  TenantContext* tcP = new TenantContext();
+
+  tcP->tenant = tenant;
+  namesCompose(tcP);
+
+  LM_T(LmtMongo, ("new tenant context for tenant '%s'", tenant.c_str()));
+
+  tenantRegistry.insert(tcP, hash);
+
+  return tcP;
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantContextGet -
+*/
+TenantContext* tenantContextGet(const std::string& tenant)
+{
+  unsigned int    hash = stringHash(tenant);
+  TenantContext*  tcP  = tenantRegistry.lookup(tenant, hash);
+
+  if ((tcP != NULL) && (tcP->namesGeneration == namesGeneration))
+  {
+    return tcP;
+  }
+
+  pthread_mutex_lock(&tenantRegistryMutex);
+
+  if (tcP == NULL)
+  {
+    // Look again, some other thread could have created it in the meanwhile
+    if ((tcP = tenantRegistry.find(tenant, hash)) == NULL)
+    {
+      tcP = tenantContextCreate(tenant, hash);
+    }
+  }
+
+  if (tcP->namesGeneration != namesGeneration)
+  {
+    namesCompose(tcP);
+  }
+
+  pthread_mutex_unlock(&tenantRegistryMutex);
+
+  return tcP;
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantContextNamesReset -
+*/
+void tenantContextNamesReset(void)
+{
+  __sync_fetch_and_add(&namesGeneration, 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* tenantContextCount -
+*/
+unsigned int tenantContextCount(void)
+{
+  pthread_mutex_lock(&tenantRegistryMutex);
+
+  unsigned int count = tenantRegistry.items();
+
+  pthread_mutex_unlock(&tenantRegistryMutex);
+
+  return count;
+}
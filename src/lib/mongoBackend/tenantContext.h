@@ -0,0 +1,104 @@
+#ifndef SRC_LIB_MONGOBACKEND_TENANTCONTEXT_H_
+#define SRC_LIB_MONGOBACKEND_TENANTCONTEXT_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* TENANT_REGISTRY_SIZE -
+*
+* Number of slots of the lock-free part of the tenant registry (must be a power of two).
+* The registry is filled up to 3/4 of this size. Tenants beyond that are still kept, in an
+* overflow map which lookup needs a mutex.
+*/
+#define TENANT_REGISTRY_SIZE  4096
+
+
+
+/* ****************************************************************************
+*
+* TenantContext -
+*
+* Long-lived per-tenant state, created the first time a tenant is used and never freed,
+* so pointers to it can be kept without any lock. Per-tenant state that has to be accessed
+* in the request path (caches, counters, etc.) is to be added here.
+*
+* Fields:
+*   tenant                  tenant name ("" for the default tenant)
+*   namesGeneration         generation of the DB and collection names below (see tenantContextNamesReset)
+*   dbName                  database of the tenant
+*   entitiesCollection      entities collection full name (i.e. "db.collection")
+*   registrationsCollection registrations collection full name
+*   csubsCollection         context subscriptions collection full name
+*   casubsCollection        context availability subscriptions collection full name
+*   entityIndexesEnsured    true once the indexes of the entities collection have been created
+*/
+typedef struct TenantContext
+{
+  std::string   tenant;
+  volatile int  namesGeneration;
+  std::string   dbName;
+  std::string   entitiesCollection;
+  std::string   registrationsCollection;
+  std::string   csubsCollection;
+  std::string   casubsCollection;
+  volatile int  entityIndexesEnsured;
+} TenantContext;
+
+
+
+/* ****************************************************************************
+*
+* tenantContextGet -
+*
+* Returns the context of a tenant, creating it if it doesn't exist yet. The lookup of an
+* existing context takes no lock.
+*/
+extern TenantContext* tenantContextGet(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* tenantContextNamesReset -
+*
+* To be called when the DB prefix or the collection names change (only done at startup or
+* in unit tests), so the names kept in the contexts are composed again.
+*/
+extern void tenantContextNamesReset(void);
+
+
+
+/* ****************************************************************************
+*
+* tenantContextCount -
+*/
+extern unsigned int tenantContextCount(void);
+
+#endif  // SRC_LIB_MONGOBACKEND_TENANTCONTEXT_H_
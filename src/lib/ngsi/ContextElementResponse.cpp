@@ -81,6 +81,7 @@ ContextElementResponse::ContextElementResponse(ContextElementResponse* cerP)
 
   contextElement.fill(cerP->contextElement);
   statusCode.fill(cerP->statusCode);
+  renderedJson = cerP->renderedJson;
 }
 
 
@@ -459,6 +460,7 @@ void ContextElementResponse::fill(ContextElementResponse* cerP)
 {
   contextElement.fill(cerP->contextElement);
   statusCode.fill(cerP->statusCode);
+  renderedJson = cerP->renderedJson;
 }
 
 
@@ -56,6 +56,9 @@ typedef struct ContextElementResponse
   bool             prune;                      // operational attribute used internally by the queryContext logic for not deleting entities that were
                                                // without attributes in the Orion DB
 
+  std::string      renderedJson;               // NGSIv2 rendering of the entity, when it is transcoded directly from the DB
+                                               // document (see entityDocToJson()). contextElement holds only the entity id in that case
+
   ContextElementResponse();
   ContextElementResponse(EntityId* eP, ContextAttribute* aP);
   ContextElementResponse(ContextElementResponse* cerP);
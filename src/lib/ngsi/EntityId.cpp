@@ -23,7 +23,6 @@
 * Author: Ken Zangelin
 */
 #include <string>
-#include <regex.h>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
@@ -31,6 +30,7 @@
 #include "common/globals.h"
 #include "ngsi/EntityId.h"
 #include "common/tag.h"
+#include "common/regexCache.h"
 
 
 
@@ -157,12 +157,10 @@ std::string EntityId::check(RequestType requestType)
 
   if (isTrue(isPattern))
   {
-    regex_t re;
-    if ((id.find('\0') != std::string::npos) || (regcomp(&re, id.c_str(), REG_EXTENDED) != 0))
+    if ((id.find('\0') != std::string::npos) || (!regexCacheValid(id)))
     {
       return "invalid regex for entity id pattern";
     }
-    regfree(&re);  // If regcomp fails it frees up itself (see glibc sources for details)
   }
   return "OK";
 }
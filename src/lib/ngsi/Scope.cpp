@@ -609,6 +609,56 @@ void Scope::release(void)
 
 
 
+/* ****************************************************************************
+*
+* Scope::clone -
+*
+* Deep copy, i.e. the clone owns its points and string filters. Returns NULL (and
+* sets errorStringP) if some of the string filters cannot be copied.
+*/
+Scope* Scope::clone(std::string* errorStringP)
+{
+  Scope* scopeP = new Scope(type, value, oper);
+
+  scopeP->areaType = areaType;
+  scopeP->circle   = circle;
+  scopeP->point    = point;
+  scopeP->box      = box;
+  scopeP->georel   = georel;
+
+  for (unsigned int ix = 0; ix < polygon.vertexList.size(); ++ix)
+  {
+    scopeP->polygon.vertexAdd(new orion::Point(*polygon.vertexList[ix]));
+  }
+
+  for (unsigned int ix = 0; ix < line.pointList.size(); ++ix)
+  {
+    scopeP->line.pointAdd(new orion::Point(*line.pointList[ix]));
+  }
+
+  if (stringFilterP != NULL)
+  {
+    scopeP->stringFilterP = stringFilterP->clone(errorStringP);
+  }
+
+  if (mdStringFilterP != NULL)
+  {
+    scopeP->mdStringFilterP = mdStringFilterP->clone(errorStringP);
+  }
+
+  if (((stringFilterP != NULL) && (scopeP->stringFilterP == NULL)) || ((mdStringFilterP != NULL) && (scopeP->mdStringFilterP == NULL)))
+  {
+    scopeP->release();
+    delete scopeP;
+
+    return NULL;
+  }
+
+  return scopeP;
+}
+
+
+
 /* ****************************************************************************
 *
 * Scope::areaTypeSet -
@@ -84,6 +84,7 @@ typedef struct Scope
 
   std::string  render(bool notLastInVector);
   void         release(void);
+  Scope*       clone(std::string* errorStringP);
 
   std::string  check(void);
   void         areaTypeSet(const std::string& areaTypeString);
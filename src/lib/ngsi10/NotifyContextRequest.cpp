@@ -34,6 +34,16 @@
 
 
 
+/* ****************************************************************************
+*
+* NotifyContextRequest::NotifyContextRequest -
+*/
+NotifyContextRequest::NotifyContextRequest(): renderedDataP(NULL)
+{
+}
+
+
+
 /* ****************************************************************************
 *
 * NotifyContextRequest::render -
@@ -86,7 +96,14 @@ std::string NotifyContextRequest::toJson
   out += ",";
   out += JSON_STR("data") + ":[";
 
-  out += contextElementResponseVector.toJson(renderFormat, metadataFilter);
+  if (renderedDataP != NULL)
+  {
+    out += *renderedDataP;
+  }
+  else
+  {
+    out += contextElementResponseVector.toJson(renderFormat, metadataFilter);
+  }
   out += "]";
   out += "}";
 
@@ -45,6 +45,11 @@ typedef struct NotifyContextRequest
   Originator                    originator;                    // Mandatory
   ContextElementResponseVector  contextElementResponseVector;  // Optional
 
+  const std::string*            renderedDataP;                 // If not NULL, NGSIv2 rendering of contextElementResponseVector
+                                                               // to be used by toJson(), shared by several notifications
+
+  NotifyContextRequest();
+
   std::string   render( bool asJsonObject);
   std::string   toJson(RenderFormat                     renderFormat,
                        const std::vector<std::string>&  metadataFilter);
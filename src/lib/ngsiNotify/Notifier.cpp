@@ -193,6 +193,20 @@ static std::vector<SenderThreadParams*>* buildSenderParamsCustom
 
   paramsV = new std::vector<SenderThreadParams*>;
 
+  //
+  // Subscriptions coming from the subscription cache have their templates already
+  // parsed. Otherwise, they are parsed here, once for all the context elements
+  //
+  ngsiv2::HttpInfo         localHttpInfo;
+  const ngsiv2::HttpInfo*  templatesP = &httpInfo;
+
+  if (httpInfo.templatesParsed == false)
+  {
+    localHttpInfo = httpInfo;
+    localHttpInfo.templatesParse();
+    templatesP    = &localHttpInfo;
+  }
+
   for (unsigned ix = 0; ix < cv.size(); ix++)
   {
     Verb                                verb    = httpInfo.verb;
@@ -218,9 +232,9 @@ static std::vector<SenderThreadParams*>* buildSenderParamsCustom
     //
     // 2. URL
     //
-    if (macroSubstitute(&url, httpInfo.url, ce) == false)
+    if (templatesP->urlTemplate.render(ce, &url) == false)
     {
-      // Warning already logged in macroSubstitute()
+      // Warning already logged in MacroTemplate::render()
       return paramsV;  // empty vector
     }
 
@@ -252,9 +266,9 @@ static std::vector<SenderThreadParams*>* buildSenderParamsCustom
     }
     else
     {
-      if (macroSubstitute(&payload, httpInfo.payload, ce) == false)
+      if (templatesP->payloadTemplate.render(ce, &payload) == false)
       {
-        // Warning already logged in macroSubstitute()
+        // Warning already logged in MacroTemplate::render()
         return paramsV;  // empty vector
       }
 
@@ -269,14 +283,14 @@ static std::vector<SenderThreadParams*>* buildSenderParamsCustom
     //
     // 4. URI Params (Query Strings)
     //
-    for (std::map<std::string, std::string>::const_iterator it = httpInfo.qs.begin(); it != httpInfo.qs.end(); ++it)
+    for (unsigned int jx = 0; jx < templatesP->qsTemplates.size(); ++jx)
     {
-      std::string key   = it->first;
-      std::string value = it->second;
+      std::string key;
+      std::string value;
 
-      if ((macroSubstitute(&key, it->first, ce) == false) || (macroSubstitute(&value, it->second, ce) == false))
+      if ((templatesP->qsTemplates[jx].first.render(ce, &key) == false) || (templatesP->qsTemplates[jx].second.render(ce, &value) == false))
       {
-        // Warning already logged in macroSubstitute()
+        // Warning already logged in MacroTemplate::render()
         return paramsV;  // empty vector
       }
 
@@ -292,14 +306,14 @@ static std::vector<SenderThreadParams*>* buildSenderParamsCustom
     //
     // 5. HTTP Headers
     //
-    for (std::map<std::string, std::string>::const_iterator it = httpInfo.headers.begin(); it != httpInfo.headers.end(); ++it)
+    for (unsigned int jx = 0; jx < templatesP->headersTemplates.size(); ++jx)
     {
-      std::string key   = it->first;
-      std::string value = it->second;
+      std::string key;
+      std::string value;
 
-      if ((macroSubstitute(&key, it->first, ce) == false) || (macroSubstitute(&value, it->second, ce) == false))
+      if ((templatesP->headersTemplates[jx].first.render(ce, &key) == false) || (templatesP->headersTemplates[jx].second.render(ce, &value) == false))
       {
-        // Warning already logged in macroSubstitute()
+        // Warning already logged in MacroTemplate::render()
         return paramsV;  // empty vector
       }
 
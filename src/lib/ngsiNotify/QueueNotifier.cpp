@@ -22,6 +22,11 @@
 *
 * Author: Orion dev team
 */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
@@ -30,6 +35,7 @@
 #include "alarmMgr/alarmMgr.h"
 
 #include "ngsiNotify/QueueStatistics.h"
+#include "ngsiNotify/notificationSpool.h"
 #include "ngsiNotify/QueueNotifier.h"
 
 
@@ -38,9 +44,190 @@
 *
 * QueueNotifier::Notifier -
 */
-QueueNotifier::QueueNotifier(size_t queueSize, int numThreads): queue(queueSize), workers(&queue, numThreads)
+QueueNotifier::QueueNotifier(size_t queueSize, int numThreads, NotifQueueFairness _fairness):
+  queue(queueSize),
+  workers(&queue, numThreads),
+  fairness(_fairness)
 {
   LM_T(LmtNotifier,("Setting up queue and threads for notifications"));
+
+  if (fairness != NqfNone)
+  {
+    QueueStatistics::tenantsEnable();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* QueueNotifier::tenantsConfigure -
+*
+* The spec is a comma separated list of 'tenant:weight[:limit]' items, where tenant
+* may be NOTIF_QUEUE_DEFAULT_TENANT (the default tenant) or '*' (the tenants not in the
+* list). A limit of 0 (or no limit) means the size of the queue.
+*/
+bool QueueNotifier::tenantsConfigure(const std::string& spec, std::string* errorP)
+{
+  std::vector<std::string> items;
+
+  stringSplit(spec, ',', items);
+
+  for (unsigned int ix = 0; ix < items.size(); ++ix)
+  {
+    std::vector<std::string>  fields;
+    int                       n = stringSplit(items[ix], ':', fields);
+    char*                     end;
+
+    if ((n < 2) || (n > 3) || (fields[0].empty()))
+    {
+      *errorP = "invalid item '" + items[ix] + "', expected tenant:weight[:limit]";
+      return false;
+    }
+
+    unsigned long weight = strtoul(fields[1].c_str(), &end, 10);
+
+    if ((*end != 0) || (fields[1].empty()) || (weight == 0) || (weight > 1000))
+    {
+      *errorP = "invalid weight in '" + items[ix] + "' (1 to 1000)";
+      return false;
+    }
+
+    unsigned long limit = 0;
+
+    if (n == 3)
+    {
+      limit = strtoul(fields[2].c_str(), &end, 10);
+
+      if ((*end != 0) || (fields[2].empty()))
+      {
+        *errorP = "invalid limit in '" + items[ix] + "'";
+        return false;
+      }
+    }
+
+    std::string tenant = (fields[0] == NOTIF_QUEUE_DEFAULT_TENANT)? "" : fields[0];
+
+    queue.configSet(tenant, weight, limit);
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* QueueNotifier::subQueueOf - the sub-queue (key and group) of a queue entry
+*/
+void QueueNotifier::subQueueOf
+(
+  const std::string&                       tenant,
+  const std::vector<SenderThreadParams*>&  paramsV,
+  std::string*                             keyP,
+  std::string*                             groupP
+)
+{
+  if (fairness == NqfNone)
+  {
+    *keyP   = "";
+    *groupP = "";
+    return;
+  }
+
+  *groupP = tenant;
+
+  if ((fairness == NqfSubscription) && (!paramsV.empty()))
+  {
+    *keyP = tenant + "/" + paramsV[0]->subscriptionId;
+  }
+  else
+  {
+    *keyP = tenant;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* QueueNotifier::spoolDrain -
+*
+* Moves the notifications of the spool to the queue, one entry of each tenant at a time,
+* in order for each tenant. The queue is not waited for: a tenant whose group has no room
+* is left for the next round, so it doesn't hold back the rest of tenants. An entry is
+* removed from the spool once it is in the queue, so in the case of a crash it could be
+* sent again after the restart (but never lost).
+*/
+void* QueueNotifier::spoolDrain(void* vP)
+{
+  QueueNotifier* notifierP = (QueueNotifier*) vP;
+
+  for (;;)
+  {
+    std::vector<std::string>  tenants;
+    bool                      moved    = false;
+    bool                      progress = true;
+
+    notifSpoolTenants(&tenants);
+
+    std::vector<bool> done(tenants.size(), false);
+
+    while (progress)
+    {
+      progress = false;
+
+      for (unsigned int ix = 0; ix < tenants.size(); ++ix)
+      {
+        if (done[ix])
+        {
+          continue;
+        }
+
+        std::vector<SenderThreadParams*>* paramsV = notifSpoolNext(tenants[ix]);
+
+        if (paramsV == NULL)
+        {
+          done[ix] = true;
+          continue;
+        }
+
+        size_t       notificationsNum = paramsV->size();
+        std::string  key;
+        std::string  group;
+
+        notifierP->subQueueOf(tenants[ix], *paramsV, &key, &group);
+
+        if (!notifierP->queue.try_push(key, group, paramsV, (notificationsNum == 0)? 1 : notificationsNum))
+        {
+          // No room for the tenant, its entry stays in the spool
+          for (unsigned int nx = 0; nx < notificationsNum; nx++)
+          {
+            delete (*paramsV)[nx];
+          }
+          delete paramsV;
+
+          done[ix] = true;
+          continue;
+        }
+
+        QueueStatistics::incIn(notificationsNum);
+        QueueStatistics::incTenantIn(tenants[ix], notificationsNum);
+
+        notifSpoolCommit(tenants[ix]);
+
+        progress = true;
+        moved    = true;
+      }
+    }
+
+    if (!moved)
+    {
+      usleep(NOTIF_SPOOL_RETRY_INTERVAL * 1000);
+    }
+  }
+
+  return NULL;
 }
 
 
@@ -51,6 +238,20 @@ QueueNotifier::QueueNotifier(size_t queueSize, int numThreads): queue(queueSize)
 */
 int QueueNotifier::start()
 {
+  if (notifSpoolEnabled())
+  {
+    pthread_t  tid;
+    int        rc = pthread_create(&tid, NULL, spoolDrain, this);
+
+    if (rc != 0)
+    {
+      LM_E(("Internal Error (pthread_create: %s)", strerror(errno)));
+      return rc;
+    }
+
+    pthread_detach(tid);
+  }
+
   return workers.start();
 }
 
@@ -85,19 +286,54 @@ void QueueNotifier::sendNotifyContextRequest
     clock_gettime(CLOCK_REALTIME, &(((*paramsV)[ix])->timeStamp));
   }
 
-  bool enqueued = queue.try_push(paramsV);
-  if (!enqueued)
+  //
+  // The sub-queue of the notification: the cost of the entry is its number of notifications
+  //
+  std::string key;
+  std::string group;
+
+  subQueueOf(tenant, *paramsV, &key, &group);
+
+  //
+  // With the spool in use, new notifications of a tenant go to the spool while it has pending
+  // ones of that tenant, so they are sent in order. Otherwise, the spool is used only when
+  // there is no room in the queue for the tenant.
+  //
+  bool spooled  = false;
+  bool enqueued = false;
+
+  if (notifSpoolEnabled() && notifSpoolTenantPending(tenant))
   {
-    QueueStatistics::incReject(notificationsNum);
-    LM_E(("Runtime Error (notification queue is full)"));
-    for (unsigned ix = 0; ix < paramsV->size(); ix++)
+    spooled = notifSpoolWrite(*paramsV);
+  }
+  else
+  {
+    enqueued = queue.try_push(key, group, paramsV, (notificationsNum == 0)? 1 : notificationsNum);
+
+    if ((!enqueued) && (notifSpoolEnabled()))
     {
-      delete (*paramsV)[ix];
+      spooled = notifSpoolWrite(*paramsV);
     }
-    delete paramsV;
+  }
+
+  if (enqueued)
+  {
+    QueueStatistics::incIn(notificationsNum);
+    QueueStatistics::incTenantIn(tenant, notificationsNum);
 
     return;
   }
 
-  QueueStatistics::incIn(notificationsNum);
+  if (!spooled)
+  {
+    QueueStatistics::incReject(notificationsNum);
+    QueueStatistics::incTenantReject(tenant, notificationsNum);
+    LM_E(("Runtime Error (notification queue is full)"));
+  }
+
+  for (unsigned ix = 0; ix < paramsV->size(); ix++)
+  {
+    delete (*paramsV)[ix];
+  }
+  delete paramsV;
 }
@@ -28,7 +28,7 @@
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
-#include "common/SyncQOverflow.h"
+#include "common/SyncQFair.h"
 #include "common/RenderFormat.h"
 #include "ngsiNotify/Notifier.h"
 #include "ngsiNotify/senderThread.h"
@@ -39,6 +39,21 @@
 #define DEFAULT_NOTIF_QS 100
 // default number of threads
 #define DEFAULT_NOTIF_TN 10
+// milliseconds the spool drain waits when no entry of the spool fits in the queue
+#define NOTIF_SPOOL_RETRY_INTERVAL 10
+
+
+
+/* ****************************************************************************
+*
+* NotifQueueFairness - sub-queues of the notification queue
+*/
+typedef enum NotifQueueFairness
+{
+  NqfNone,          // a single FIFO queue
+  NqfTenant,        // a sub-queue per tenant
+  NqfSubscription   // a sub-queue per subscription (the weight and limit are the ones of its tenant)
+} NotifQueueFairness;
 
 
 
@@ -49,7 +64,7 @@
 class QueueNotifier : public Notifier
 {
 public:
-  QueueNotifier(size_t queueSize, int numThreads);
+  QueueNotifier(size_t queueSize, int numThreads, NotifQueueFairness _fairness = NqfNone);
 
   void sendNotifyContextRequest(NotifyContextRequest*            ncr,
                                 const ngsiv2::HttpInfo&          httpInfo,
@@ -59,10 +74,15 @@ public:
                                 RenderFormat                     renderFormat,
                                 const std::vector<std::string>&  metadataFilter);
   int start();
+  bool tenantsConfigure(const std::string& spec, std::string* errorP);
 
 private:
- SyncQOverflow<std::vector<SenderThreadParams*>*>  queue;
- QueueWorkers                        workers;
+ void subQueueOf(const std::string& tenant, const std::vector<SenderThreadParams*>& paramsV, std::string* keyP, std::string* groupP);
+ static void* spoolDrain(void* vP);
+
+ SyncQFair<std::vector<SenderThreadParams*>*>  queue;
+ QueueWorkers                                  workers;
+ NotifQueueFairness                            fairness;
 
 };
 
@@ -41,6 +41,10 @@ boost::mutex QueueStatistics::mtxTimeInQ;
 struct timespec QueueStatistics::timeInQ;
 size_t QueueStatistics::queueSize;
 
+bool                                        QueueStatistics::tenantCounters = false;
+boost::mutex                                QueueStatistics::mtxTenants;
+std::map<std::string, QueueTenantCounters>  QueueStatistics::tenants;
+
 /* ****************************************************************************
 *
 * getIn -
@@ -166,6 +170,74 @@ size_t QueueStatistics::getQSize()
   return  queueSize;
 }
 
+/* ****************************************************************************
+*
+* tenantsEnable -
+*/
+void QueueStatistics::tenantsEnable()
+{
+  tenantCounters = true;
+}
+
+/* ****************************************************************************
+*
+* tenantsEnabled -
+*/
+bool QueueStatistics::tenantsEnabled()
+{
+  return tenantCounters;
+}
+
+/* ****************************************************************************
+*
+* incTenantIn -
+*/
+void QueueStatistics::incTenantIn(const std::string& tenant, int n)
+{
+  if (tenantCounters)
+  {
+    boost::mutex::scoped_lock lock(mtxTenants);
+    tenants[tenant.empty()? NOTIF_QUEUE_DEFAULT_TENANT : tenant].in += n;
+  }
+}
+
+/* ****************************************************************************
+*
+* incTenantOut -
+*/
+void QueueStatistics::incTenantOut(const std::string& tenant, int n)
+{
+  if (tenantCounters)
+  {
+    boost::mutex::scoped_lock lock(mtxTenants);
+    tenants[tenant.empty()? NOTIF_QUEUE_DEFAULT_TENANT : tenant].out += n;
+  }
+}
+
+/* ****************************************************************************
+*
+* incTenantReject -
+*/
+void QueueStatistics::incTenantReject(const std::string& tenant, int n)
+{
+  if (tenantCounters)
+  {
+    boost::mutex::scoped_lock lock(mtxTenants);
+    tenants[tenant.empty()? NOTIF_QUEUE_DEFAULT_TENANT : tenant].reject += n;
+  }
+}
+
+/* ****************************************************************************
+*
+* getTenants -
+*/
+void QueueStatistics::getTenants(std::map<std::string, QueueTenantCounters>* tenantsP)
+{
+  boost::mutex::scoped_lock lock(mtxTenants);
+
+  *tenantsP = tenants;
+}
+
 /* ****************************************************************************
 *
 * reset() -
@@ -178,6 +250,11 @@ void QueueStatistics::reset()
   __sync_fetch_and_and(&noOfNotificationsQueueSentOK, 0);
   __sync_fetch_and_and(&noOfNotificationsQueueSentError, 0);
 
+  {
+    boost::mutex::scoped_lock lock(mtxTenants);
+    tenants.clear();
+  }
+
   boost::mutex::scoped_lock lock(mtxTimeInQ);
   timeInQ.tv_sec = 0;
   timeInQ.tv_nsec = 0;
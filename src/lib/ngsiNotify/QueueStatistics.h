@@ -32,8 +32,32 @@
 // A newer version of boost (>=1.53.0) or c++11 could provide better
 // alternatives to this implementation
 
+#include <string>
+#include <map>
+
 #include "boost/thread/mutex.hpp"
 
+
+// name of the default tenant in the per tenant statistics (and in -notifQueueTenants)
+#define NOTIF_QUEUE_DEFAULT_TENANT "default-service"
+
+
+
+/* ****************************************************************************
+*
+* QueueTenantCounters - notifications of a tenant in the queue
+*/
+typedef struct QueueTenantCounters
+{
+  long long in;
+  long long out;
+  long long reject;
+
+  QueueTenantCounters(): in(0), out(0), reject(0) {}
+} QueueTenantCounters;
+
+
+
 class QueueStatistics
 {
 public:
@@ -117,6 +141,42 @@ public:
   */
   static size_t getQSize();
 
+  /* ****************************************************************************
+  *
+  * tenantsEnable - per tenant counters (only when the queue is fair among tenants)
+  */
+  static void tenantsEnable();
+
+  /* ****************************************************************************
+  *
+  * tenantsEnabled -
+  */
+  static bool tenantsEnabled();
+
+  /* ****************************************************************************
+  *
+  * incTenantIn -
+  */
+  static void incTenantIn(const std::string& tenant, int n=1);
+
+  /* ****************************************************************************
+  *
+  * incTenantOut -
+  */
+  static void incTenantOut(const std::string& tenant, int n=1);
+
+  /* ****************************************************************************
+  *
+  * incTenantReject -
+  */
+  static void incTenantReject(const std::string& tenant, int n=1);
+
+  /* ****************************************************************************
+  *
+  * getTenants -
+  */
+  static void getTenants(std::map<std::string, QueueTenantCounters>* tenantsP);
+
   /* ****************************************************************************
   *
   * reset() -
@@ -136,6 +196,10 @@ private:
    static struct timespec timeInQ;
    static size_t          queueSize;
 
+   static bool                                        tenantCounters;
+   static boost::mutex                                mtxTenants;
+   static std::map<std::string, QueueTenantCounters>  tenants;
+
 };
 
 #endif  // SRC_LIB_NGSINOTIFY_QUEUESTATISTICS_H_
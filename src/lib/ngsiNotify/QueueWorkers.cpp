@@ -37,6 +37,7 @@
 #include "rest/httpRequestSend.h"
 #include "ngsiNotify/QueueStatistics.h"
 #include "ngsiNotify/QueueWorkers.h"
+#include "ngsiNotify/destinationHealth.h"
 
 
 
@@ -77,8 +78,8 @@ int QueueWorkers::start()
 */
 static void* workerFunc(void* pSyncQ)
 {
-  SyncQOverflow<std::vector<SenderThreadParams*>*>*  queue = (SyncQOverflow<std::vector<SenderThreadParams*>*> *) pSyncQ;
-  CURL*                                              curl;
+  SyncQFair<std::vector<SenderThreadParams*>*>*  queue = (SyncQFair<std::vector<SenderThreadParams*>*> *) pSyncQ;
+  CURL*                                          curl;
 
   // Initialize curl context
   curl = curl_easy_init();
@@ -93,6 +94,11 @@ static void* workerFunc(void* pSyncQ)
   {
     std::vector<SenderThreadParams*>* paramsV = queue->pop();
 
+    if (!paramsV->empty())
+    {
+      QueueStatistics::incTenantOut((*paramsV)[0]->tenant, paramsV->size());
+    }
+
     for (unsigned ix = 0; ix < paramsV->size(); ix++)
     {
       struct timespec     now;
@@ -126,26 +132,43 @@ static void* workerFunc(void* pSyncQ)
       }
       else // we'll send the notification
       {
-        std::string  out;
-        int          r;
-
-        r =  httpRequestSendWithCurl(curl,
-                                     params->ip,
-                                     params->port,
-                                     params->protocol,
-                                     params->verb,
-                                     params->tenant,
-                                     params->servicePath,
-                                     params->xauthToken,
-                                     params->resource,
-                                     params->content_type,
-                                     params->content,
-                                     params->fiwareCorrelator,
-                                     params->renderFormat,
-                                     true,
-                                     NOTIFICATION_WAIT_MODE,
-                                     &out,
-                                     params->extraHeaders);
+        std::string         out;
+        int                 r;
+        DestinationHealth*  dhP = destinationHealthGet(params->ip, params->port);
+
+        if ((dhP != NULL) && (destinationAdmit(dhP) == false))
+        {
+          // Fast fail (open circuit or in-flight limit reached): the worker is not blocked by the destination
+          LM_T(LmtNotifier, ("notification to %s:%d not sent: destination unhealthy", params->ip.c_str(), params->port));
+          r = -1;
+        }
+        else
+        {
+          long long start = (dhP != NULL)? destinationClock() : 0;
+
+          r = httpRequestSendWithCurl(curl,
+                                      params->ip,
+                                      params->port,
+                                      params->protocol,
+                                      params->verb,
+                                      params->tenant,
+                                      params->servicePath,
+                                      params->xauthToken,
+                                      params->resource,
+                                      params->content_type,
+                                      params->content,
+                                      params->fiwareCorrelator,
+                                      params->renderFormat,
+                                      true,
+                                      NOTIFICATION_WAIT_MODE,
+                                      &out,
+                                      params->extraHeaders);
+
+          if (dhP != NULL)
+          {
+            destinationDone(dhP, r == 0, destinationClock() - start);
+          }
+        }
 
         //
         // FIXME: ok and error counter should be incremented in the other notification modes (generalizing the concept, i.e.
@@ -0,0 +1,447 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/JsonHelper.h"
+#include "common/limits.h"
+#include "common/StringHashTable.h"
+#include "ngsiNotify/destinationHealth.h"
+
+
+
+/* ****************************************************************************
+*
+* Configuration -
+*/
+static unsigned int  breakerThreshold = 0;
+static int           maxInFlight      = 0;
+
+
+
+/* ****************************************************************************
+*
+* Destination table -
+*
+* The lookup of a known destination needs no lock (see StringHashTable). The mutex is
+* taken to create a destination or to walk the table.
+*/
+static StringHashTable<DestinationHealth, &DestinationHealth::destination, DESTINATION_TABLE_SIZE>  destinationTable;
+static pthread_mutex_t                                                                             destinationMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthInit -
+*/
+void destinationHealthInit(unsigned int _breakerThreshold, unsigned int _maxInFlight)
+{
+  breakerThreshold = _breakerThreshold;
+  maxInFlight      = (int) _maxInFlight;
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthActive -
+*/
+bool destinationHealthActive(void)
+{
+  return (breakerThreshold > 0) || (maxInFlight > 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationClock -
+*/
+long long destinationClock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationCreate -
+*
+* To be called with destinationMutex taken
+*/
+static DestinationHealth* destinationCreate(const std::string& destination, unsigned int hash)
+{
+  DestinationHealth* dhP = new DestinationHealth();
+
+  dhP->destination         = destination;
+  dhP->state               = BreakerClosed;
+  dhP->consecutiveFailures = 0;
+  dhP->backoff             = DESTINATION_BACKOFF_MIN;
+  dhP->retryAt             = 0;
+  dhP->inFlight            = 0;
+  dhP->limit               = maxInFlight;
+  dhP->minLatency          = 0;
+  dhP->latencySamples      = 0;
+  dhP->failures            = 0;
+  dhP->fastFails           = 0;
+  dhP->limited             = 0;
+  dhP->opens               = 0;
+
+  LM_T(LmtNotifier, ("new notification destination '%s'", destination.c_str()));
+
+  destinationTable.insert(dhP, hash);
+
+  return dhP;
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthGet -
+*/
+DestinationHealth* destinationHealthGet(const std::string& host, int port)
+{
+  if (!destinationHealthActive())
+  {
+    return NULL;
+  }
+
+  char portV[STRING_SIZE_FOR_INT];
+
+  snprintf(portV, sizeof(portV), "%d", port);
+
+  std::string         destination = host + ":" + portV;
+  unsigned int        hash        = stringHash(destination);
+  DestinationHealth*  dhP         = destinationTable.lookup(destination, hash);
+
+  if (dhP != NULL)
+  {
+    return dhP;
+  }
+
+  pthread_mutex_lock(&destinationMutex);
+
+  // Look again, some other thread could have created it in the meanwhile
+  if ((dhP = destinationTable.find(destination, hash)) == NULL)
+  {
+    dhP = destinationCreate(destination, hash);
+  }
+
+  pthread_mutex_unlock(&destinationMutex);
+
+  return dhP;
+}
+
+
+
+/* ****************************************************************************
+*
+* breakerOpen -
+*
+* Opens the circuit of a destination, if it is still in state 'from'. Only the thread
+* that makes the transition doubles the backoff for the next time.
+*/
+static void breakerOpen(DestinationHealth* dhP, int from)
+{
+  int backoff = dhP->backoff;
+
+  dhP->retryAt = destinationClock() + (long long) backoff * 1000;
+
+  if (__sync_bool_compare_and_swap(&dhP->state, from, BreakerOpen))
+  {
+    dhP->backoff = (backoff * 2 > DESTINATION_BACKOFF_MAX)? DESTINATION_BACKOFF_MAX : backoff * 2;
+    __sync_fetch_and_add(&dhP->opens, 1);
+
+    LM_W(("Opening notification circuit %s: %d consecutive failures, next try in %d ms",
+          dhP->destination.c_str(), (int) dhP->consecutiveFailures, backoff));
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* limitDecrease - multiplicative decrease (by 1/4) of the in-flight limit, down to 1
+*/
+static void limitDecrease(DestinationHealth* dhP)
+{
+  int limit    = dhP->limit;
+  int newLimit = limit - limit / 4;
+
+  if (newLimit == limit)
+  {
+    newLimit = limit - 1;
+  }
+
+  if (newLimit >= 1)
+  {
+    __sync_bool_compare_and_swap(&dhP->limit, limit, newLimit);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* limitAdapt -
+*
+* Latency based AIMD: a notification clearly slower than the baseline (the minimum latency
+* seen in the current window) means the receiver is queueing, so the limit goes down.
+* Otherwise, the limit grows by one, up to maxInFlight.
+*/
+static void limitAdapt(DestinationHealth* dhP, long long latency)
+{
+  if (__sync_add_and_fetch(&dhP->latencySamples, 1) >= DESTINATION_LATENCY_WINDOW)
+  {
+    // New window, starting with the current latency as baseline
+    dhP->latencySamples = 0;
+    dhP->minLatency     = latency;
+    return;
+  }
+
+  long long minLatency = dhP->minLatency;
+
+  if ((minLatency == 0) || (latency < minLatency))
+  {
+    dhP->minLatency = latency;
+    minLatency      = latency;
+  }
+
+  if (latency > 2 * minLatency + DESTINATION_LATENCY_TOLERANCE)
+  {
+    limitDecrease(dhP);
+  }
+  else
+  {
+    int limit = dhP->limit;
+
+    if (limit < maxInFlight)
+    {
+      __sync_bool_compare_and_swap(&dhP->limit, limit, limit + 1);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationAdmit -
+*
+* While a circuit is open, every notification fails fast, until the backoff time has
+* passed. Then, the first notification moves the circuit to half-open and goes through
+* as probe (the rest keep failing fast until the probe is done).
+*/
+bool destinationAdmit(DestinationHealth* dhP)
+{
+  bool probe = false;
+
+  if (breakerThreshold > 0)
+  {
+    int state = dhP->state;
+
+    if (state == BreakerOpen)
+    {
+      if ((destinationClock() < dhP->retryAt) || (__sync_bool_compare_and_swap(&dhP->state, BreakerOpen, BreakerHalfOpen) == false))
+      {
+        __sync_fetch_and_add(&dhP->fastFails, 1);
+        return false;
+      }
+
+      LM_T(LmtNotifier, ("circuit half-open for destination '%s'", dhP->destination.c_str()));
+      probe = true;
+    }
+    else if (state == BreakerHalfOpen)
+    {
+      __sync_fetch_and_add(&dhP->fastFails, 1);
+      return false;
+    }
+  }
+
+  int inFlight = __sync_add_and_fetch(&dhP->inFlight, 1);
+
+  if ((maxInFlight > 0) && (inFlight > dhP->limit))
+  {
+    __sync_sub_and_fetch(&dhP->inFlight, 1);
+    __sync_fetch_and_add(&dhP->limited, 1);
+
+    if (probe)
+    {
+      // The probe has not been sent: back to open, to probe again with the next notification
+      __sync_bool_compare_and_swap(&dhP->state, BreakerHalfOpen, BreakerOpen);
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationDone -
+*/
+void destinationDone(DestinationHealth* dhP, bool ok, long long latency)
+{
+  __sync_sub_and_fetch(&dhP->inFlight, 1);
+
+  if (ok)
+  {
+    if (dhP->consecutiveFailures != 0)
+    {
+      dhP->consecutiveFailures = 0;
+    }
+
+    if ((breakerThreshold > 0) && (dhP->state != BreakerClosed))
+    {
+      dhP->backoff = DESTINATION_BACKOFF_MIN;
+      dhP->state   = BreakerClosed;
+
+      LM_W(("Closing notification circuit %s", dhP->destination.c_str()));
+    }
+
+    if (maxInFlight > 0)
+    {
+      limitAdapt(dhP, latency);
+    }
+
+    return;
+  }
+
+  int failures = __sync_add_and_fetch(&dhP->consecutiveFailures, 1);
+
+  __sync_fetch_and_add(&dhP->failures, 1);
+
+  if (maxInFlight > 0)
+  {
+    limitDecrease(dhP);
+  }
+
+  if (breakerThreshold > 0)
+  {
+    int state = dhP->state;
+
+    if (state == BreakerHalfOpen)
+    {
+      breakerOpen(dhP, BreakerHalfOpen);
+    }
+    else if ((state == BreakerClosed) && ((unsigned int) failures >= breakerThreshold))
+    {
+      breakerOpen(dhP, BreakerClosed);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationRender -
+*/
+static std::string destinationRender(DestinationHealth* dhP)
+{
+  JsonHelper   jh;
+  int          state = dhP->state;
+
+  if (breakerThreshold > 0)
+  {
+    jh.addString("state", (state == BreakerOpen)? "open" : (state == BreakerHalfOpen)? "halfOpen" : "closed");
+    jh.addNumber("opens",     (long long) dhP->opens);
+    jh.addNumber("fastFails", (long long) dhP->fastFails);
+  }
+
+  jh.addNumber("failures", (long long) dhP->failures);
+  jh.addNumber("inFlight", (long long) dhP->inFlight);
+
+  if (maxInFlight > 0)
+  {
+    jh.addNumber("limit",   (long long) dhP->limit);
+    jh.addNumber("limited", (long long) dhP->limited);
+  }
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthRender -
+*/
+std::string destinationHealthRender(void)
+{
+  JsonHelper                        jh;
+  std::vector<DestinationHealth*>   destinationV;
+
+  pthread_mutex_lock(&destinationMutex);
+  destinationTable.all(&destinationV);
+  pthread_mutex_unlock(&destinationMutex);
+
+  for (unsigned int ix = 0; ix < destinationV.size(); ++ix)
+  {
+    jh.addRaw(destinationV[ix]->destination, destinationRender(destinationV[ix]));
+  }
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthReset -
+*/
+void destinationHealthReset(void)
+{
+  std::vector<DestinationHealth*> destinationV;
+
+  pthread_mutex_lock(&destinationMutex);
+  destinationTable.all(&destinationV);
+  pthread_mutex_unlock(&destinationMutex);
+
+  for (unsigned int ix = 0; ix < destinationV.size(); ++ix)
+  {
+    destinationV[ix]->failures  = 0;
+    destinationV[ix]->fastFails = 0;
+    destinationV[ix]->limited   = 0;
+    destinationV[ix]->opens     = 0;
+  }
+}
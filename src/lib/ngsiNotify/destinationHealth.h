@@ -0,0 +1,207 @@
+#ifndef SRC_LIB_NGSINOTIFY_DESTINATIONHEALTH_H_
+#define SRC_LIB_NGSINOTIFY_DESTINATIONHEALTH_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+
+
+/* ****************************************************************************
+*
+* DESTINATION_TABLE_SIZE -
+*
+* Number of slots of the lock-free part of the destination table (must be a power of two).
+* As in any StringHashTable, destinations beyond 3/4 of this size go to an overflow map
+* which lookup needs a mutex.
+*/
+#define DESTINATION_TABLE_SIZE  4096
+
+
+
+/* ****************************************************************************
+*
+* Circuit breaker backoff -
+*
+* Time (in milliseconds) an open circuit waits before letting a probe notification
+* through. It is doubled each time the probe fails, up to DESTINATION_BACKOFF_MAX.
+*/
+#define DESTINATION_BACKOFF_MIN      1000
+#define DESTINATION_BACKOFF_MAX      (5 * 60 * 1000)
+
+
+
+/* ****************************************************************************
+*
+* DESTINATION_LATENCY_WINDOW -
+*
+* Number of latency samples after which the baseline (minimum) latency of a destination
+* is recalculated, so the in-flight limit follows changes in the receiver or the network.
+*/
+#define DESTINATION_LATENCY_WINDOW   1000
+
+
+
+/* ****************************************************************************
+*
+* DESTINATION_LATENCY_TOLERANCE -
+*
+* A notification slower than twice the baseline latency plus this tolerance (in
+* microseconds) reduces the in-flight limit of its destination. Faster ones raise it.
+*/
+#define DESTINATION_LATENCY_TOLERANCE  5000
+
+
+
+/* ****************************************************************************
+*
+* BreakerState -
+*/
+typedef enum BreakerState
+{
+  BreakerClosed   = 0,
+  BreakerOpen     = 1,
+  BreakerHalfOpen = 2
+} BreakerState;
+
+
+
+/* ****************************************************************************
+*
+* DestinationHealth -
+*
+* Per-destination (host:port) state of the outgoing notifications. Created the first
+* time a destination is used and never freed. All the fields are accessed with atomic
+* operations, so no lock is needed to send a notification.
+*
+* Fields:
+*   destination          "host:port"
+*   state                BreakerState of the circuit
+*   consecutiveFailures  failures since the last successful notification
+*   backoff              time (ms) the circuit will stay open the next time it opens
+*   retryAt              monotonic time (us) after which an open circuit lets a probe through
+*   inFlight             notifications being sent right now
+*   limit                current in-flight limit, adapted to the observed latency
+*   minLatency           baseline latency (us) of the current window
+*   latencySamples       samples taken in the current window
+*   failures             failed notifications (counter)
+*   fastFails            notifications not sent due to open circuit (counter)
+*   limited              notifications not sent due to the in-flight limit (counter)
+*   opens                times the circuit has been opened (counter)
+*/
+typedef struct DestinationHealth
+{
+  std::string         destination;
+  volatile int        state;
+  volatile int        consecutiveFailures;
+  volatile int        backoff;
+  volatile long long  retryAt;
+  volatile int        inFlight;
+  volatile int        limit;
+  volatile long long  minLatency;
+  volatile int        latencySamples;
+  volatile int        failures;
+  volatile int        fastFails;
+  volatile int        limited;
+  volatile int        opens;
+} DestinationHealth;
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthInit -
+*
+* breakerThreshold: consecutive failures that open the circuit of a destination (0: no circuit breaker)
+* maxInFlight:      upper bound of the adaptive in-flight limit of a destination (0: no limit)
+*
+* If both are zero, destinationHealthGet() always returns NULL and nothing is tracked.
+*/
+extern void destinationHealthInit(unsigned int breakerThreshold, unsigned int maxInFlight);
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthActive -
+*/
+extern bool destinationHealthActive(void);
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthGet -
+*/
+extern DestinationHealth* destinationHealthGet(const std::string& host, int port);
+
+
+
+/* ****************************************************************************
+*
+* destinationAdmit -
+*
+* To be called before sending a notification. Returns false if the notification must not
+* be sent (circuit open or in-flight limit reached), in which case it has to be considered
+* failed and destinationDone() must NOT be called.
+*/
+extern bool destinationAdmit(DestinationHealth* dhP);
+
+
+
+/* ****************************************************************************
+*
+* destinationDone -
+*
+* To be called after a notification admitted by destinationAdmit() has been sent,
+* with its result and latency (in microseconds)
+*/
+extern void destinationDone(DestinationHealth* dhP, bool ok, long long latency);
+
+
+
+/* ****************************************************************************
+*
+* destinationClock - monotonic time in microseconds
+*/
+extern long long destinationClock(void);
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthRender - JSON object with the state of each destination, for /statistics
+*/
+extern std::string destinationHealthRender(void);
+
+
+
+/* ****************************************************************************
+*
+* destinationHealthReset - reset the counters (not the state) of all destinations
+*/
+extern void destinationHealthReset(void);
+
+#endif  // SRC_LIB_NGSINOTIFY_DESTINATIONHEALTH_H_
@@ -0,0 +1,1076 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "ngsiNotify/notificationSpool.h"
+
+
+
+/* ****************************************************************************
+*
+* NOTIF_SPOOL_MAGIC and NOTIF_SPOOL_VERSION -
+*
+* The version must be increased whenever the format of the segments (headers or
+* records) changes, so that segments of older versions are not replayed.
+*/
+#define NOTIF_SPOOL_MAGIC    "ORIONSPL"
+#define NOTIF_SPOOL_VERSION  2
+
+
+
+/* ****************************************************************************
+*
+* SegmentHeader -
+*
+* Each segment is a file of NOTIF_SPOOL_SEGMENT_SIZE bytes, mapped in memory, with this
+* header followed by the records. A free segment (all zeros) has seq 0. As the spool is
+* local, integers are written in the byte order of the host.
+*/
+typedef struct SegmentHeader
+{
+  char      magic[8];
+  uint32_t  version;
+  uint32_t  reserved;
+  uint64_t  seq;          // order of the segment in the spool
+} SegmentHeader;
+
+
+
+/* ****************************************************************************
+*
+* RecordHeader -
+*
+* A record is a queue entry (see entrySerialize()). The length is written after the
+* payload and the checksum, so a record is never seen before it is complete. A zero
+* length marks the end of the records of the segment.
+*
+* Records are taken from the spool in order for each tenant, but not in the spool as a
+* whole, so each one is marked when taken (the checksum covers just the payload).
+*/
+typedef struct RecordHeader
+{
+  uint32_t  length;     // of the payload
+  uint32_t  checksum;   // CRC32 of the payload
+  uint32_t  taken;      // non zero once taken from the spool
+} RecordHeader;
+
+
+
+/* ****************************************************************************
+*
+* Segment -
+*/
+typedef struct Segment
+{
+  std::string     path;
+  char*           mapP;
+  SegmentHeader*  headerP;
+  size_t          writeOffset;
+  long long       pending;    // records not yet taken from the spool
+  bool            dirty;      // modified since the last msync()
+} Segment;
+
+
+
+/* ****************************************************************************
+*
+* RecordLocation -
+*/
+typedef struct RecordLocation
+{
+  Segment*  segP;
+  size_t    offset;
+} RecordLocation;
+
+
+
+/* ****************************************************************************
+*
+* Spool state -
+*
+* The segments in use go from the oldest to the newest (the one being written). A segment
+* is reused once all its records have been taken, and the pending records of each tenant
+* are indexed in tenantRecords (oldest first). All the state is protected by spoolMutex.
+*/
+static bool                  spoolEnabled      = false;
+static std::string           spoolDir;
+static unsigned int          maxSegments       = 0;
+static std::deque<Segment*>  activeSegments;
+static std::vector<Segment*> freeSegments;
+static uint64_t              lastSeq           = 0;
+static long long             pendingRecords    = 0;
+static NotifSpoolStatistics  spoolStats;
+
+static std::map<std::string, std::deque<RecordLocation> >  tenantRecords;
+static pthread_mutex_t       spoolMutex        = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t        spoolCond         = PTHREAD_COND_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* putU32, putI64 and putString -
+*/
+static void putU32(std::string* outP, uint32_t n)
+{
+  outP->append((const char*) &n, sizeof(n));
+}
+
+static void putI64(std::string* outP, int64_t n)
+{
+  outP->append((const char*) &n, sizeof(n));
+}
+
+static void putString(std::string* outP, const std::string& s)
+{
+  putU32(outP, s.size());
+  outP->append(s);
+}
+
+
+
+/* ****************************************************************************
+*
+* RecordReader -
+*/
+typedef struct RecordReader
+{
+  const char*  p;
+  size_t       left;
+  bool         ok;
+
+  RecordReader(const char* _p, size_t _left): p(_p), left(_left), ok(true) {}
+
+  const char* take(size_t n)
+  {
+    if ((!ok) || (n > left))
+    {
+      ok = false;
+      return NULL;
+    }
+
+    const char* r = p;
+
+    p    += n;
+    left -= n;
+
+    return r;
+  }
+
+  uint32_t u32(void)
+  {
+    uint32_t     n  = 0;
+    const char*  pP = take(sizeof(n));
+
+    if (pP != NULL)
+    {
+      memcpy(&n, pP, sizeof(n));
+    }
+
+    return n;
+  }
+
+  int64_t i64(void)
+  {
+    int64_t      n  = 0;
+    const char*  pP = take(sizeof(n));
+
+    if (pP != NULL)
+    {
+      memcpy(&n, pP, sizeof(n));
+    }
+
+    return n;
+  }
+
+  std::string string(void)
+  {
+    uint32_t     len = u32();
+    const char*  pP  = take(len);
+
+    return (pP == NULL)? "" : std::string(pP, len);
+  }
+} RecordReader;
+
+
+
+/* ****************************************************************************
+*
+* entrySerialize - the record payload of a queue entry
+*
+* The first field is the number of notifications of the entry.
+*/
+static void entrySerialize(const std::vector<SenderThreadParams*>& paramsV, std::string* outP)
+{
+  putU32(outP, paramsV.size());
+
+  for (unsigned int ix = 0; ix < paramsV.size(); ++ix)
+  {
+    const SenderThreadParams* paramsP = paramsV[ix];
+
+    putString(outP, paramsP->ip);
+    putU32(outP, paramsP->port);
+    putString(outP, paramsP->protocol);
+    putString(outP, paramsP->verb);
+    putString(outP, paramsP->tenant);
+    putString(outP, paramsP->servicePath);
+    putString(outP, paramsP->xauthToken);
+    putString(outP, paramsP->resource);
+    putString(outP, paramsP->content_type);
+    putString(outP, paramsP->content);
+    putString(outP, paramsP->transactionId);
+    putU32(outP, paramsP->mimeType);
+    putString(outP, paramsP->renderFormat);
+    putString(outP, paramsP->fiwareCorrelator);
+    putI64(outP, paramsP->timeStamp.tv_sec);
+    putI64(outP, paramsP->timeStamp.tv_nsec);
+    putString(outP, paramsP->subscriptionId);
+    putU32(outP, paramsP->registration? 1 : 0);
+
+    putU32(outP, paramsP->extraHeaders.size());
+    for (std::map<std::string, std::string>::const_iterator it = paramsP->extraHeaders.begin(); it != paramsP->extraHeaders.end(); ++it)
+    {
+      putString(outP, it->first);
+      putString(outP, it->second);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* entryDeserialize -
+*
+* Returns NULL if the payload is not a valid entry.
+*/
+static std::vector<SenderThreadParams*>* entryDeserialize(const char* payload, size_t len)
+{
+  RecordReader                       reader(payload, len);
+  uint32_t                           notifications = reader.u32();
+  std::vector<SenderThreadParams*>*  paramsV       = new std::vector<SenderThreadParams*>();
+
+  for (unsigned int ix = 0; (ix < notifications) && (reader.ok); ++ix)
+  {
+    SenderThreadParams* paramsP = new SenderThreadParams();
+
+    paramsP->ip               = reader.string();
+    paramsP->port             = reader.u32();
+    paramsP->protocol         = reader.string();
+    paramsP->verb             = reader.string();
+    paramsP->tenant           = reader.string();
+    paramsP->servicePath      = reader.string();
+    paramsP->xauthToken       = reader.string();
+    paramsP->resource         = reader.string();
+    paramsP->content_type     = reader.string();
+    paramsP->content          = reader.string();
+
+    std::string transactionId = reader.string();
+    strncpy(paramsP->transactionId, transactionId.c_str(), sizeof(paramsP->transactionId) - 1);
+    paramsP->transactionId[sizeof(paramsP->transactionId) - 1] = 0;
+
+    paramsP->mimeType           = (MimeType) reader.u32();
+    paramsP->renderFormat       = reader.string();
+    paramsP->fiwareCorrelator   = reader.string();
+    paramsP->timeStamp.tv_sec   = reader.i64();
+    paramsP->timeStamp.tv_nsec  = reader.i64();
+    paramsP->subscriptionId     = reader.string();
+    paramsP->registration       = (reader.u32() != 0);
+
+    uint32_t headers = reader.u32();
+    for (unsigned int hx = 0; (hx < headers) && (reader.ok); ++hx)
+    {
+      std::string name = reader.string();
+
+      paramsP->extraHeaders[name] = reader.string();
+    }
+
+    paramsV->push_back(paramsP);
+  }
+
+  if ((!reader.ok) || (reader.left != 0))
+  {
+    for (unsigned int ix = 0; ix < paramsV->size(); ++ix)
+    {
+      delete (*paramsV)[ix];
+    }
+    delete paramsV;
+
+    return NULL;
+  }
+
+  return paramsV;
+}
+
+
+
+/* ****************************************************************************
+*
+* recordTenant - the tenant of a record payload (the one of its notifications)
+*/
+static std::string recordTenant(const char* payload, size_t len)
+{
+  RecordReader reader(payload, len);
+
+  if (reader.u32() == 0)
+  {
+    return "";
+  }
+
+  reader.string();  // ip
+  reader.u32();     // port
+  reader.string();  // protocol
+  reader.string();  // verb
+
+  return reader.string();
+}
+
+
+
+/* ****************************************************************************
+*
+* recordAt - the record at the given offset of a segment
+*
+* Returns the length of the payload, 0 if there is no valid record.
+*/
+static uint32_t recordAt(const Segment* segP, size_t offset, const char** payloadP)
+{
+  RecordHeader rh;
+
+  if (offset + sizeof(rh) > NOTIF_SPOOL_SEGMENT_SIZE)
+  {
+    return 0;
+  }
+
+  memcpy(&rh, segP->mapP + offset, sizeof(rh));
+
+  if ((rh.length == 0) || (offset + sizeof(rh) + rh.length > NOTIF_SPOOL_SEGMENT_SIZE))
+  {
+    return 0;
+  }
+
+  *payloadP = segP->mapP + offset + sizeof(rh);
+
+  if (crc32(crc32(0L, Z_NULL, 0), (const Bytef*) *payloadP, rh.length) != rh.checksum)
+  {
+    LM_E(("Runtime Error (corrupt record in notification spool segment %s at offset %lu)", segP->path.c_str(), offset));
+    return 0;
+  }
+
+  return rh.length;
+}
+
+
+
+/* ****************************************************************************
+*
+* segmentMap -
+*/
+static Segment* segmentMap(const std::string& path)
+{
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+
+  if (fd == -1)
+  {
+    LM_E(("Runtime Error (cannot open notification spool segment %s: %s)", path.c_str(), strerror(errno)));
+    return NULL;
+  }
+
+  struct stat st;
+
+  if ((fstat(fd, &st) != 0) || ((st.st_size != NOTIF_SPOOL_SEGMENT_SIZE) && (ftruncate(fd, NOTIF_SPOOL_SEGMENT_SIZE) != 0)))
+  {
+    LM_E(("Runtime Error (cannot size notification spool segment %s: %s)", path.c_str(), strerror(errno)));
+    close(fd);
+    return NULL;
+  }
+
+  void* mapP = mmap(NULL, NOTIF_SPOOL_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (mapP == MAP_FAILED)
+  {
+    LM_E(("Runtime Error (cannot map notification spool segment %s: %s)", path.c_str(), strerror(errno)));
+    return NULL;
+  }
+
+  Segment* segP = new Segment();
+
+  segP->path        = path;
+  segP->mapP        = (char*) mapP;
+  segP->headerP     = (SegmentHeader*) mapP;
+  segP->writeOffset = NOTIF_SPOOL_SEGMENT_SIZE;
+  segP->pending     = 0;
+  segP->dirty       = false;
+
+  return segP;
+}
+
+
+
+/* ****************************************************************************
+*
+* segmentClear - make a segment free, zeroing the part that has been used
+*/
+static void segmentClear(Segment* segP)
+{
+  size_t used = segP->writeOffset + sizeof(RecordHeader);
+
+  memset(segP->mapP, 0, (used > NOTIF_SPOOL_SEGMENT_SIZE)? NOTIF_SPOOL_SEGMENT_SIZE : used);
+
+  segP->writeOffset = NOTIF_SPOOL_SEGMENT_SIZE;
+  segP->pending     = 0;
+  segP->dirty       = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* segmentNew - start a new segment, reusing a free one if possible
+*
+* Returns NULL if the disk budget is exhausted.
+*/
+static Segment* segmentNew(void)
+{
+  Segment* segP = NULL;
+
+  if ((!activeSegments.empty()) && (activeSegments.back()->pending == 0))
+  {
+    // The segment being written, with all its records already taken
+    segP = activeSegments.back();
+    activeSegments.pop_back();
+    segmentClear(segP);
+  }
+  else if (!freeSegments.empty())
+  {
+    segP = freeSegments.back();
+    freeSegments.pop_back();
+  }
+  else if (activeSegments.size() < maxSegments)
+  {
+    // Look for a file name not in use
+    for (unsigned int ix = 0; ix < maxSegments; ++ix)
+    {
+      char        name[64];
+      struct stat st;
+
+      snprintf(name, sizeof(name), "/notif-%u.spool", ix);
+
+      std::string path = spoolDir + name;
+
+      if (stat(path.c_str(), &st) != 0)
+      {
+        segP = segmentMap(path);
+        break;
+      }
+    }
+  }
+
+  if (segP == NULL)
+  {
+    return NULL;
+  }
+
+  memcpy(segP->headerP->magic, NOTIF_SPOOL_MAGIC, sizeof(segP->headerP->magic));
+  segP->headerP->version    = NOTIF_SPOOL_VERSION;
+  segP->headerP->seq        = ++lastSeq;
+  segP->writeOffset         = sizeof(SegmentHeader);
+  segP->pending             = 0;
+  segP->dirty               = true;
+
+  activeSegments.push_back(segP);
+
+  return segP;
+}
+
+
+
+/* ****************************************************************************
+*
+* segmentRecycle - move a segment (already sent) to the free ones
+*
+* Called with the mutex taken, that is released while the segment is cleared.
+*/
+static void segmentRecycle(Segment* segP)
+{
+  activeSegments.erase(std::find(activeSegments.begin(), activeSegments.end(), segP));
+
+  pthread_mutex_unlock(&spoolMutex);
+  segmentClear(segP);
+  pthread_mutex_lock(&spoolMutex);
+
+  freeSegments.push_back(segP);
+}
+
+
+
+/* ****************************************************************************
+*
+* segmentScan - find the records pending to be sent of a segment of a previous run
+*
+* Segments are scanned from the oldest, so the records of each tenant are indexed in order.
+*/
+static void segmentScan(Segment* segP)
+{
+  size_t offset = sizeof(SegmentHeader);
+
+  for (;;)
+  {
+    const char*     payload;
+    uint32_t        len = recordAt(segP, offset, &payload);
+    uint32_t        notifications;
+    RecordHeader    rh;
+
+    if ((len == 0) || (len < sizeof(notifications)))
+    {
+      break;
+    }
+
+    memcpy(&rh, segP->mapP + offset, sizeof(rh));
+
+    if (rh.taken == 0)
+    {
+      RecordLocation location;
+
+      location.segP   = segP;
+      location.offset = offset;
+
+      tenantRecords[recordTenant(payload, len)].push_back(location);
+
+      memcpy(&notifications, payload, sizeof(notifications));
+
+      segP->pending              += 1;
+      spoolStats.pending         += notifications;
+    }
+
+    offset += sizeof(RecordHeader) + len;
+  }
+
+  segP->writeOffset = offset;
+}
+
+
+
+/* ****************************************************************************
+*
+* segmentSeqLess -
+*/
+static bool segmentSeqLess(const Segment* s1, const Segment* s2)
+{
+  return s1->headerP->seq < s2->headerP->seq;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolInit -
+*/
+bool notifSpoolInit(const std::string& dir, unsigned long long budget, std::string* errorP)
+{
+  if ((mkdir(dir.c_str(), 0700) != 0) && (errno != EEXIST))
+  {
+    *errorP = std::string("cannot create directory ") + dir + ": " + strerror(errno);
+    return false;
+  }
+
+  DIR* dirP = opendir(dir.c_str());
+
+  if (dirP == NULL)
+  {
+    *errorP = std::string("cannot open directory ") + dir + ": " + strerror(errno);
+    return false;
+  }
+
+  spoolDir    = dir;
+  maxSegments = budget / NOTIF_SPOOL_SEGMENT_SIZE;
+
+  if (maxSegments < 2)
+  {
+    maxSegments = 2;
+  }
+
+  memset(&spoolStats, 0, sizeof(spoolStats));
+
+  //
+  // Segments of a previous run
+  //
+  std::vector<Segment*>  segments;
+  struct dirent*         entryP;
+
+  while ((entryP = readdir(dirP)) != NULL)
+  {
+    unsigned int  ix;
+    char          end;
+
+    if (sscanf(entryP->d_name, "notif-%u.spool%c", &ix, &end) != 1)
+    {
+      continue;
+    }
+
+    Segment* segP = segmentMap(dir + "/" + entryP->d_name);
+
+    if (segP != NULL)
+    {
+      segments.push_back(segP);
+    }
+  }
+
+  closedir(dirP);
+
+  std::sort(segments.begin(), segments.end(), segmentSeqLess);
+
+  for (unsigned int ix = 0; ix < segments.size(); ++ix)
+  {
+    Segment*        segP    = segments[ix];
+    SegmentHeader*  headerP = segP->headerP;
+
+    if ((memcmp(headerP->magic, NOTIF_SPOOL_MAGIC, sizeof(headerP->magic)) == 0) && (headerP->version == NOTIF_SPOOL_VERSION) && (headerP->seq != 0))
+    {
+      segmentScan(segP);
+      lastSeq = headerP->seq;
+    }
+
+    if (segP->pending == 0)
+    {
+      segmentClear(segP);
+      freeSegments.push_back(segP);
+      continue;
+    }
+
+    // Only the newest segment is written from now on
+    if (!activeSegments.empty())
+    {
+      activeSegments.back()->writeOffset = NOTIF_SPOOL_SEGMENT_SIZE;
+    }
+
+    activeSegments.push_back(segP);
+    pendingRecords += segP->pending;
+  }
+
+  // Leftovers of a previous run beyond the disk budget (the segments in use are kept)
+  while ((!freeSegments.empty()) && (activeSegments.size() + freeSegments.size() > maxSegments))
+  {
+    Segment* segP = freeSegments.back();
+
+    freeSegments.pop_back();
+    munmap(segP->mapP, NOTIF_SPOOL_SEGMENT_SIZE);
+    unlink(segP->path.c_str());
+    delete segP;
+  }
+
+  // The rest of the newest segment could have garbage of an incomplete record
+  if (!activeSegments.empty())
+  {
+    Segment* segP = activeSegments.back();
+
+    memset(segP->mapP + segP->writeOffset, 0, NOTIF_SPOOL_SEGMENT_SIZE - segP->writeOffset);
+  }
+
+  spoolEnabled = true;
+
+  if (pendingRecords > 0)
+  {
+    LM_I(("Notification spool: %lld notifications pending from a previous run", spoolStats.pending));
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* spoolFlusher -
+*
+* msync() of the segments modified since the last time, so that request threads never
+* wait for the disk.
+*/
+static void* spoolFlusher(void* vP)
+{
+  for (;;)
+  {
+    std::vector<char*> maps;
+
+    usleep(NOTIF_SPOOL_SYNC_INTERVAL * 1000);
+
+    pthread_mutex_lock(&spoolMutex);
+
+    for (unsigned int ix = 0; ix < activeSegments.size(); ++ix)
+    {
+      if (activeSegments[ix]->dirty)
+      {
+        maps.push_back(activeSegments[ix]->mapP);
+        activeSegments[ix]->dirty = false;
+      }
+    }
+
+    pthread_mutex_unlock(&spoolMutex);
+
+    for (unsigned int ix = 0; ix < maps.size(); ++ix)
+    {
+      msync(maps[ix], NOTIF_SPOOL_SEGMENT_SIZE, MS_SYNC);
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolStart -
+*/
+int notifSpoolStart(void)
+{
+  pthread_t  tid;
+  int        rc = pthread_create(&tid, NULL, spoolFlusher, NULL);
+
+  if (rc != 0)
+  {
+    LM_E(("Internal Error (pthread_create: %s)", strerror(errno)));
+    return rc;
+  }
+
+  pthread_detach(tid);
+
+  return 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolRelease -
+*/
+void notifSpoolRelease(void)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  for (unsigned int ix = 0; ix < activeSegments.size(); ++ix)
+  {
+    munmap(activeSegments[ix]->mapP, NOTIF_SPOOL_SEGMENT_SIZE);
+    delete activeSegments[ix];
+  }
+
+  for (unsigned int ix = 0; ix < freeSegments.size(); ++ix)
+  {
+    munmap(freeSegments[ix]->mapP, NOTIF_SPOOL_SEGMENT_SIZE);
+    delete freeSegments[ix];
+  }
+
+  activeSegments.clear();
+  freeSegments.clear();
+  tenantRecords.clear();
+
+  spoolEnabled   = false;
+  lastSeq        = 0;
+  pendingRecords = 0;
+
+  pthread_mutex_unlock(&spoolMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolEnabled -
+*/
+bool notifSpoolEnabled(void)
+{
+  return spoolEnabled;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolPending -
+*/
+bool notifSpoolPending(void)
+{
+  return __sync_fetch_and_add(&pendingRecords, 0) > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolTenantPending -
+*/
+bool notifSpoolTenantPending(const std::string& tenant)
+{
+  if (!notifSpoolPending())
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&spoolMutex);
+
+  bool pending = (tenantRecords.find(tenant) != tenantRecords.end());
+
+  pthread_mutex_unlock(&spoolMutex);
+
+  return pending;
+}
+
+
+/* ****************************************************************************
+*
+* notifSpoolWrite -
+*/
+bool notifSpoolWrite(const std::vector<SenderThreadParams*>& paramsV)
+{
+  std::string   payload;
+  RecordHeader  rh;
+
+  entrySerialize(paramsV, &payload);
+
+  rh.length   = payload.size();
+  rh.checksum = crc32(crc32(0L, Z_NULL, 0), (const Bytef*) payload.data(), payload.size());
+
+  pthread_mutex_lock(&spoolMutex);
+
+  Segment* segP = activeSegments.empty()? NULL : activeSegments.back();
+
+  // Room for the record and the end mark (a zero length) after it
+  if ((segP == NULL) || (segP->writeOffset + 2 * sizeof(rh) + payload.size() > NOTIF_SPOOL_SEGMENT_SIZE))
+  {
+    segP = (sizeof(SegmentHeader) + 2 * sizeof(rh) + payload.size() > NOTIF_SPOOL_SEGMENT_SIZE)? NULL : segmentNew();
+  }
+
+  if (segP == NULL)
+  {
+    spoolStats.reject += paramsV.size();
+    pthread_mutex_unlock(&spoolMutex);
+
+    return false;
+  }
+
+  char*           recordP = segP->mapP + segP->writeOffset;
+  RecordLocation  location;
+
+  rh.taken = 0;
+
+  memcpy(recordP + sizeof(rh), payload.data(), payload.size());
+  memcpy(recordP + sizeof(rh.length), &rh.checksum, sizeof(rh) - sizeof(rh.length));
+  __sync_synchronize();
+  memcpy(recordP, &rh.length, sizeof(rh.length));
+
+  location.segP   = segP;
+  location.offset = segP->writeOffset;
+  tenantRecords[paramsV.empty()? "" : paramsV[0]->tenant].push_back(location);
+
+  segP->writeOffset += sizeof(rh) + payload.size();
+  segP->pending     += 1;
+  segP->dirty        = true;
+
+  pendingRecords     += 1;
+  spoolStats.in      += paramsV.size();
+  spoolStats.pending += paramsV.size();
+
+  pthread_cond_signal(&spoolCond);
+  pthread_mutex_unlock(&spoolMutex);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* recordTake - remove the oldest record of a tenant from the spool
+*
+* Called with the mutex taken (that may be released, see segmentRecycle()). Returns the
+* number of notifications of the record.
+*/
+static long long recordTake(const std::string& tenant)
+{
+  std::map<std::string, std::deque<RecordLocation> >::iterator  it       = tenantRecords.find(tenant);
+  RecordLocation                                                 location = it->second.front();
+  Segment*                                                       segP     = location.segP;
+  RecordHeader                                                   rh;
+  uint32_t                                                       notifications = 0;
+
+  it->second.pop_front();
+  if (it->second.empty())
+  {
+    tenantRecords.erase(it);
+  }
+
+  memcpy(&rh, segP->mapP + location.offset, sizeof(rh));
+
+  if (rh.length >= sizeof(notifications))
+  {
+    memcpy(&notifications, segP->mapP + location.offset + sizeof(rh), sizeof(notifications));
+  }
+
+  rh.taken = 1;
+  memcpy(segP->mapP + location.offset + sizeof(rh.length) + sizeof(rh.checksum), &rh.taken, sizeof(rh.taken));
+
+  segP->pending  -= 1;
+  segP->dirty     = true;
+  pendingRecords -= 1;
+
+  // A segment already sent is reused as soon as possible, so it is available for new records
+  if ((segP->pending == 0) && (segP != activeSegments.back()))
+  {
+    segmentRecycle(segP);
+  }
+
+  return notifications;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolTenants -
+*/
+void notifSpoolTenants(std::vector<std::string>* tenantsP)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  while (pendingRecords == 0)
+  {
+    pthread_cond_wait(&spoolCond, &spoolMutex);
+  }
+
+  for (std::map<std::string, std::deque<RecordLocation> >::const_iterator it = tenantRecords.begin(); it != tenantRecords.end(); ++it)
+  {
+    tenantsP->push_back(it->first);
+  }
+
+  pthread_mutex_unlock(&spoolMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolNext -
+*/
+std::vector<SenderThreadParams*>* notifSpoolNext(const std::string& tenant)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  while (tenantRecords.find(tenant) != tenantRecords.end())
+  {
+    RecordLocation  location = tenantRecords[tenant].front();
+    const char*     payload;
+    uint32_t        len      = recordAt(location.segP, location.offset, &payload);
+
+    std::vector<SenderThreadParams*>* paramsV = (len == 0)? NULL : entryDeserialize(payload, len);
+
+    if (paramsV == NULL)
+    {
+      LM_E(("Runtime Error (invalid record in notification spool segment %s at offset %lu)", location.segP->path.c_str(), location.offset));
+
+      spoolStats.pending -= recordTake(tenant);
+      continue;
+    }
+
+    pthread_mutex_unlock(&spoolMutex);
+
+    return paramsV;
+  }
+
+  pthread_mutex_unlock(&spoolMutex);
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolCommit -
+*/
+void notifSpoolCommit(const std::string& tenant)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  long long notifications = recordTake(tenant);
+
+  spoolStats.out      += notifications;
+  spoolStats.pending  -= notifications;
+
+  pthread_mutex_unlock(&spoolMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolStatisticsGet -
+*/
+void notifSpoolStatisticsGet(NotifSpoolStatistics* statsP)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  *statsP          = spoolStats;
+  statsP->segments = activeSegments.size() + freeSegments.size();
+
+  pthread_mutex_unlock(&spoolMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolStatisticsReset -
+*/
+void notifSpoolStatisticsReset(void)
+{
+  pthread_mutex_lock(&spoolMutex);
+
+  spoolStats.in     = 0;
+  spoolStats.out    = 0;
+  spoolStats.reject = 0;
+
+  pthread_mutex_unlock(&spoolMutex);
+}
@@ -0,0 +1,177 @@
+#ifndef SRC_LIB_NGSINOTIFY_NOTIFICATIONSPOOL_H_
+#define SRC_LIB_NGSINOTIFY_NOTIFICATIONSPOOL_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "ngsiNotify/senderThread.h"
+
+
+
+/* ****************************************************************************
+*
+* NOTIF_SPOOL_SEGMENT_SIZE -
+*
+* Size of each spool segment file (a notification bigger than this can't be spooled).
+* The disk budget of the spool is rounded down to a number of segments (at least two).
+*/
+#define NOTIF_SPOOL_SEGMENT_SIZE  (16 * 1024 * 1024)
+
+
+
+/* ****************************************************************************
+*
+* NOTIF_SPOOL_SYNC_INTERVAL -
+*
+* Milliseconds between msync() calls of the spool flusher thread. Spooled notifications
+* survive a crash of the broker anyway (they are in the page cache), this only bounds
+* what is lost if the host crashes.
+*/
+#define NOTIF_SPOOL_SYNC_INTERVAL  1000
+
+
+
+/* ****************************************************************************
+*
+* NotifSpoolStatistics -
+*/
+typedef struct NotifSpoolStatistics
+{
+  long long     in;        // notifications spooled
+  long long     out;       // notifications taken from the spool
+  long long     reject;    // notifications not spooled (disk budget exhausted)
+  long long     pending;   // notifications in the spool
+  unsigned int  segments;  // segment files (in use or ready to be reused)
+} NotifSpoolStatistics;
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolInit -
+*
+* Opens (creating it if needed) the spool in the given directory, with a disk budget
+* of the given number of bytes. The notifications left in the spool by a previous run
+* are pending to be sent.
+*/
+extern bool notifSpoolInit(const std::string& dir, unsigned long long budget, std::string* errorP);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolStart - start the flusher thread
+*/
+extern int notifSpoolStart(void);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolRelease -
+*/
+extern void notifSpoolRelease(void);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolEnabled -
+*/
+extern bool notifSpoolEnabled(void);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolPending - true if there are notifications in the spool
+*/
+extern bool notifSpoolPending(void);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolWrite - append the notifications of a queue entry to the spool
+*
+* The entry belongs to the tenant of its notifications. Returns false if it doesn't fit in the disk budget. It never waits for the disk.
+*/
+extern bool notifSpoolWrite(const std::vector<SenderThreadParams*>& paramsV);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolTenantPending - true if there are notifications of the tenant in the spool
+*/
+extern bool notifSpoolTenantPending(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolTenants - the tenants with notifications in the spool
+*
+* Waits until there is some.
+*/
+extern void notifSpoolTenants(std::vector<std::string>* tenantsP);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolNext - the oldest queue entry of a tenant in the spool
+*
+* NULL if there is none. It remains in the spool until notifSpoolCommit() is called, so
+* only one thread may take entries from the spool. The entries of a tenant are taken in
+* order, regardless of the ones of other tenants.
+*/
+extern std::vector<SenderThreadParams*>* notifSpoolNext(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolCommit - remove the entry returned by notifSpoolNext() from the spool
+*/
+extern void notifSpoolCommit(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* notifSpoolStatisticsGet -
+*/
+extern void notifSpoolStatisticsGet(NotifSpoolStatistics* statsP);
+
+/* ****************************************************************************
+*
+* notifSpoolStatisticsReset - reset of the counters (pending and segments are kept)
+*/
+extern void notifSpoolStatisticsReset(void);
+
+#endif  // SRC_LIB_NGSINOTIFY_NOTIFICATIONSPOOL_H_
@@ -28,6 +28,7 @@
 #include "alarmMgr/alarmMgr.h"
 #include "rest/httpRequestSend.h"
 #include "ngsiNotify/senderThread.h"
+#include "ngsiNotify/destinationHealth.h"
 #include "cache/subCache.h"
 
 
@@ -63,25 +64,41 @@ void* startSenderThread(void* p)
 
     if (!simulatedNotification)
     {
-      std::string  out;
-      int          r;
-
-      r = httpRequestSend(params->ip,
-                          params->port,
-                          params->protocol,
-                          params->verb,
-                          params->tenant,
-                          params->servicePath,
-                          params->xauthToken,
-                          params->resource,
-                          params->content_type,
-                          params->content,
-                          params->fiwareCorrelator,
-                          params->renderFormat,
-                          true,
-                          NOTIFICATION_WAIT_MODE,
-                          &out,
-                          params->extraHeaders);
+      std::string         out;
+      int                 r;
+      DestinationHealth*  dhP = destinationHealthGet(params->ip, params->port);
+
+      if ((dhP != NULL) && (destinationAdmit(dhP) == false))
+      {
+        LM_T(LmtNotifier, ("notification to %s:%d not sent: destination unhealthy", params->ip.c_str(), params->port));
+        r = -1;
+      }
+      else
+      {
+        long long start = (dhP != NULL)? destinationClock() : 0;
+
+        r = httpRequestSend(params->ip,
+                            params->port,
+                            params->protocol,
+                            params->verb,
+                            params->tenant,
+                            params->servicePath,
+                            params->xauthToken,
+                            params->resource,
+                            params->content_type,
+                            params->content,
+                            params->fiwareCorrelator,
+                            params->renderFormat,
+                            true,
+                            NOTIFICATION_WAIT_MODE,
+                            &out,
+                            params->extraHeaders);
+
+        if (dhP != NULL)
+        {
+          destinationDone(dhP, r == 0, destinationClock() - start);
+        }
+      }
 
       if (r == 0)
       {
@@ -28,58 +28,75 @@
 #include "logMsg/traceLevels.h"
 
 #include "common/globals.h"
+#include "common/charScan.h"
 #include "parse/forbiddenChars.h"
 
 
 
 /* ****************************************************************************
 *
-* commonForbidden
+* COMMON_FORBIDDEN - chars forbidden in any field checked
 */
-inline static bool commonForbidden(char c)
+#define COMMON_FORBIDDEN  "<>\"'=;()"
+
+
+
+/* ****************************************************************************
+*
+* idForbiddenClass -
+*
+* Chars forbidden in ids (also in types, attribute names, etc.): the common ones plus
+* '?', '/', '#', '&', space, control chars and bytes >= 127
+*/
+static CharClass idForbiddenClass(void)
 {
-  switch (c)
-  {
-  case '<':
-  case '>':
-  case '"':
-  case '\'':
-  case '=':
-  case ';':
-  case '(':
-  case ')':
-    return true;
-  }
-  return false;
+  CharClass cc(COMMON_FORBIDDEN "?/#&");
+
+  cc.addRange(0, 32);
+  cc.addRange(127, 255);
+
+  return cc;
 }
 
 
 
 /* ****************************************************************************
 *
-* forbiddenChars - 
+* Forbidden character classes -
 */
-bool forbiddenChars(const char* s, const char* exceptions)
+static const CharClass  commonForbidden(COMMON_FORBIDDEN);
+static const CharClass  idForbidden = idForbiddenClass();
+
+
+
+/* ****************************************************************************
+*
+* forbiddenFind -
+*
+* Looks for the forbidden chars of the class not in the exceptions. As exceptions are
+* few (if any), the class is scanned as is and the exceptions are checked only for the
+* chars found.
+*/
+static bool forbiddenFind(const CharClass& cc, const char* s, const char* exceptions)
 {
-  if (s == (void*) 0)
-  {
-    return false;
-  }
+  size_t len = strlen(s);
+  size_t ix  = 0;
 
-  while (*s != 0)
+  while (ix < len)
   {
-    if ((exceptions != NULL) && (strchr(exceptions, *s) != NULL))
+    ix += charClassFind(cc, s + ix, len - ix);
+
+    if (ix == len)
     {
-      ++s;
-      continue;
+      return false;
     }
 
-    if (commonForbidden(*s))
+    if ((exceptions == NULL) || (strchr(exceptions, s[ix]) == NULL))
     {
       return true;
     }
 
-    ++s;
+    ++ix;
   }
 
   return false;
@@ -87,6 +104,22 @@ bool forbiddenChars(const char* s, const char* exceptions)
 
 
 
+/* ****************************************************************************
+*
+* forbiddenChars - 
+*/
+bool forbiddenChars(const char* s, const char* exceptions)
+{
+  if (s == (void*) 0)
+  {
+    return false;
+  }
+
+  return forbiddenFind(commonForbidden, s, exceptions);
+}
+
+
+
 /* ****************************************************************************
 *
 * forbiddenIdChars -
@@ -114,38 +147,7 @@ bool forbiddenIdCharsV2(const char* s, const char* exceptions)
     return false;
   }
 
-  while (*s != 0)
-  {
-    if ((exceptions != NULL) && (strchr(exceptions, *s) != NULL))
-    {
-      ++s;
-      continue;
-    }
-
-    if (*s >= 127 || *s <= 32)
-    {
-      return true;
-    }
-
-    switch (*s)
-    {
-    case '?':
-    case '/':
-    case '#':
-    case '&':
-      return true;
-    }
-
-    // Plus common set of forbidden chars
-    if(commonForbidden(*s))
-    {
-      return true;
-    }
-
-    ++s;
-  }
-
-  return false;
+  return forbiddenFind(idForbidden, s, exceptions);
 }
 
 
@@ -48,7 +48,8 @@ static const char* validOptions[] =
   OPT_DATE_CREATED,
   OPT_DATE_MODIFIED,
   OPT_NO_ATTR_DETAIL,
-  OPT_UPSERT
+  OPT_UPSERT,
+  OPT_CURSOR
 };
 
 
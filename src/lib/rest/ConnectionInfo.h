@@ -42,6 +42,7 @@
 #include "rest/mhd.h"
 #include "rest/Verb.h"
 #include "rest/HttpHeaders.h"
+#include "rest/requestContext.h"
 
 
 
@@ -51,6 +52,7 @@
 */
 struct ParseData;
 struct RestService;
+struct RequestWorkerContext;
 
 
 
@@ -70,6 +72,7 @@ public:
     restServiceP           (NULL),
     payload                (NULL),
     payloadSize            (0),
+    payloadCapacity        (0),
     callNo                 (1),
     parseDataP             (NULL),
     port                   (0),
@@ -78,7 +81,9 @@ public:
     inCompoundValue        (false),
     compoundValueP         (NULL),
     compoundValueRoot      (NULL),
-    httpStatusCode         (SccOk)
+    httpStatusCode         (SccOk),
+    workerContextP         (NULL),
+    contextP               (NULL)
   {
   }
 
@@ -91,6 +96,7 @@ public:
     restServiceP           (NULL),
     payload                (NULL),
     payloadSize            (0),
+    payloadCapacity        (0),
     callNo                 (1),
     parseDataP             (NULL),
     port                   (0),
@@ -99,7 +105,9 @@ public:
     inCompoundValue        (false),
     compoundValueP         (NULL),
     compoundValueRoot      (NULL),
-    httpStatusCode         (SccOk)
+    httpStatusCode         (SccOk),
+    workerContextP         (NULL),
+    contextP               (NULL)
   {
   }
 
@@ -115,6 +123,7 @@ public:
     restServiceP           (NULL),
     payload                (NULL),
     payloadSize            (0),
+    payloadCapacity        (0),
     callNo                 (1),
     parseDataP             (NULL),
     port                   (0),
@@ -123,7 +132,9 @@ public:
     inCompoundValue        (false),
     compoundValueP         (NULL),
     compoundValueRoot      (NULL),
-    httpStatusCode         (SccOk)
+    httpStatusCode         (SccOk),
+    workerContextP         (NULL),
+    contextP               (NULL)
   {
 
     if      (_method == "POST")    verb = POST;
@@ -140,6 +151,9 @@ public:
     if (compoundValueRoot != NULL)
       delete compoundValueRoot;
 
+    if (contextP != NULL)
+      delete contextP;
+
     servicePathV.clear();
     httpHeaders.release();
   }
@@ -159,6 +173,7 @@ public:
   HttpHeaders                httpHeaders;
   char*                      payload;
   int                        payloadSize;
+  int                        payloadCapacity;  // Bytes available in payload (without the zero-termination)
   std::string                answer;
   int                        callNo;
   ParseData*                 parseDataP;
@@ -185,6 +200,12 @@ public:
 
   // Timing
   struct timespec           reqStartTime;
+
+  // Set when the request is served by a request worker (see rest/requestWorkers.h)
+  RequestWorkerContext*     workerContextP;
+
+  // Set when the MHD threads are shared by many connections (see rest/requestContext.h)
+  RequestContext*           contextP;
 };
 
 
@@ -37,6 +37,7 @@
 * HTTP Headers -
 */
 #define HTTP_ACCEPT                        "Accept"
+#define HTTP_ACCEPT_ENCODING               "Accept-Encoding"
 #define HTTP_ALLOW                         "Allow"
 #define HTTP_ACCESS_CONTROL_ALLOW_ORIGIN   "Access-Control-Allow-Origin"
 #define HTTP_ACCESS_CONTROL_ALLOW_HEADERS  "Access-Control-Allow-Headers"
@@ -44,6 +45,7 @@
 #define HTTP_ACCESS_CONTROL_MAX_AGE        "Access-Control-Max-Age"
 #define HTTP_ACCESS_CONTROL_EXPOSE_HEADERS "Access-Control-Expose-Headers"
 #define HTTP_CONNECTION                    "Connection"
+#define HTTP_CONTENT_ENCODING              "Content-Encoding"
 #define HTTP_CONTENT_LENGTH                "Content-Length"
 #define HTTP_CONTENT_TYPE                  "Content-Type"
 #define HTTP_EXPECT                        "Expect"
@@ -51,11 +53,14 @@
 #define HTTP_FIWARE_SERVICE                "Fiware-Service"
 #define HTTP_FIWARE_SERVICEPATH            "Fiware-Servicepath"
 #define HTTP_FIWARE_TOTAL_COUNT            "Fiware-Total-Count"
+#define HTTP_FIWARE_NEXT_CURSOR            "Fiware-Next-Cursor"
 #define HTTP_HOST                          "Host"
 #define HTTP_NGSIV2_ATTRSFORMAT            "Ngsiv2-AttrsFormat"
 #define HTTP_RESOURCE_LOCATION             "Location"
+#define HTTP_RETRY_AFTER                   "Retry-After"
 #define HTTP_ORIGIN                        "Origin"
 #define HTTP_USER_AGENT                    "User-Agent"
+#define HTTP_VARY                          "Vary"
 #define HTTP_X_AUTH_TOKEN                  "X-Auth-Token"
 #define HTTP_X_REAL_IP                     "X-Real-IP"
 #define HTTP_X_FORWARDED_FOR               "X-Forwarded-For"
@@ -74,7 +79,7 @@
 *
 * CORS Exposed Headers -
 */
-#define CORS_EXPOSED_HEADERS HTTP_FIWARE_CORRELATOR ", " HTTP_FIWARE_TOTAL_COUNT ", " HTTP_RESOURCE_LOCATION
+#define CORS_EXPOSED_HEADERS HTTP_FIWARE_CORRELATOR ", " HTTP_FIWARE_TOTAL_COUNT ", " HTTP_FIWARE_NEXT_CURSOR ", " HTTP_RESOURCE_LOCATION
 
 
 
@@ -124,6 +129,7 @@ typedef struct HttpHeaders
   std::string   userAgent;
   std::string   host;
   std::string   accept;
+  std::string   acceptEncoding;
   std::string   expect;
   std::string   contentType;
   std::string   origin;
@@ -46,6 +46,7 @@ std::string httpStatusCodeString(HttpStatusCode code)
   case SccRequestEntityTooLarge:             return "Request Entity Too Large";
   case SccUnsupportedMediaType:              return "Unsupported Media Type";
   case SccInvalidModification:               return "Invalid Modification";
+  case SccTooManyRequests:                   return "Too Many Requests";
   case SccSubscriptionIdNotFound:            return "subscriptionId does not correspond to an active subscription"; // FI-WARE
   case SccMissingParameter:                  return "parameter missing in the request";                             // FI-WARE
   case SccInvalidParameter:                  return "request parameter is invalid/not allowed";                     // FI-WARE
@@ -55,6 +56,7 @@ std::string httpStatusCodeString(HttpStatusCode code)
   case SccAttributeListRequired:             return "Attribute List required by the receiver";
   case SccReceiverInternalError:             return "Internal Server Error";
   case SccNotImplemented:                    return "Not Implemented";
+  case SccServiceUnavailable:                return "Service Unavailable";
   default:                                   return "Undefined";
   }
 }
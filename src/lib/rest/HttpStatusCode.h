@@ -48,6 +48,7 @@ typedef enum HttpStatusCode
   SccRequestEntityTooLarge  = 413,   // Request Entity Too Large - over 1Mb of payload
   SccUnsupportedMediaType   = 415,   // Unsupported Media Type (only support and application/json and -in some cases- text/plain)
   SccInvalidModification    = 422,   // InvalidModification (unprocessable entity)
+  SccTooManyRequests        = 429,   // Too Many Requests (rate limit of the service exceeded)
   SccSubscriptionIdNotFound = 470,   // The subscriptionId does not correspond to an active subscription
   SccMissingParameter       = 471,   // A parameter is missing in the request
   SccInvalidParameter       = 472,   // A parameter of the request is invalid/not allowed
@@ -56,7 +57,8 @@ typedef enum HttpStatusCode
   SccEntityTypeRequired     = 481,   // The EntityType is required by the receiver
   SccAttributeListRequired  = 482,   // The Attribute List is required by the receiver
   SccReceiverInternalError  = 500,   // An unknown error at the receiver has occurred
-  SccNotImplemented         = 501    // The given operation is not implemented
+  SccNotImplemented         = 501,   // The given operation is not implemented
+  SccServiceUnavailable     = 503    // Service Unavailable (request queue full)
 } HttpStatusCode;
 
 
@@ -32,6 +32,7 @@
 #include "common/limits.h"
 #include "common/globals.h"
 #include "common/statistics.h"
+#include "common/reqTrace.h"
 #include "common/string.h"
 #include "common/limits.h"
 #include "common/errorMessages.h"
@@ -455,6 +456,32 @@ static bool compCheck(int components, const std::vector<std::string>& compV)
 }
 
 
+/* ****************************************************************************
+*
+* routeLabel -
+*
+* Label used for per-route request tracing, e.g. "GET /v2/entities". Wildcard components
+* are kept as '*', so all the requests on the same route share the label.
+*/
+static std::string routeLabel(ConnectionInfo* ciP, const RestService* serviceP)
+{
+  std::string label = ciP->method + " ";
+
+  if (serviceP->components == 0)
+  {
+    return label + "*";
+  }
+
+  for (int ix = 0; ix < serviceP->components; ++ix)
+  {
+    label += "/" + serviceP->compV[ix];
+  }
+
+  return label;
+}
+
+
+
 /* ****************************************************************************
 *
 * compErrorDetect -
@@ -614,6 +641,12 @@ static std::string restService(ConnectionInfo* ciP, RestService* serviceV)
       continue;
     }
 
+    if (reqTrace.active)
+    {
+      reqTraceSpanAdd(RtpQueueWait, "dispatch", &reqTrace.start, NULL);
+      reqTraceRouteSet(routeLabel(ciP, &serviceV[ix]));
+    }
+
 
     //
     // If in restBadVerbV vector, no need to check the payload
@@ -627,7 +660,9 @@ static std::string restService(ConnectionInfo* ciP, RestService* serviceV)
       ciP->parseDataP = &parseData;
       metricsMgr.add(ciP->httpHeaders.tenant, spath, METRIC_TRANS_IN_REQ_SIZE, ciP->payloadSize);
       LM_T(LmtPayload, ("Parsing payload '%s'", ciP->payload));
+      REQ_TRACE_SPAN_START(parseStart);
       response = payloadParse(ciP, &parseData, &serviceV[ix], &jsonReqP, &jsonRelease, compV);
+      REQ_TRACE_SPAN_STOP(parseStart, RtpParse, "payload");
       LM_T(LmtParsedPayload, ("payloadParse returns '%s'", response.c_str()));
 
       if (response != "OK")
@@ -48,7 +48,7 @@ using namespace mongo;
 *
 * StringFilterItem::StringFilterItem -
 */
-StringFilterItem::StringFilterItem() : compiledPattern(false)
+StringFilterItem::StringFilterItem() : patternValue(NULL), compiledPattern(false)
 {
   numberList.clear();
   stringList.clear();
@@ -82,13 +82,8 @@ bool StringFilterItem::fill(StringFilterItem* sfiP, std::string* errorStringP)
 
   if (compiledPattern)
   {
-    //
-    // FIXME P4: not very optimized to recalculate the regex.
-    //
-    // We don't know of a better way to copy the regex from sfiP, and have a question out on SOF:
-    // http://stackoverflow.com/questions/36846426/best-way-of-cloning-compiled-regex-t-struct-in-c
-    //
-    if (regcomp(&patternValue, stringValue.c_str(), REG_EXTENDED) != 0)
+    // Same pattern, so the compiled regex is taken from the regex cache (no compilation is done)
+    if ((patternValue = regexCacheGet(stringValue)) == NULL)
     {
       *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
       return false;
@@ -111,7 +106,8 @@ StringFilterItem::~StringFilterItem()
 
   if (compiledPattern == true)
   {
-    regfree(&patternValue);  // If regcomp fails it frees up itself (see glibc sources for details)
+    regexCacheRelease(patternValue);
+    patternValue    = NULL;
     compiledPattern = false;
   }
 }
@@ -151,7 +147,7 @@ bool StringFilterItem::valueParse(char* s, std::string* errorStringP)
 
   if (op == SfopMatchPattern)
   {
-    if (regcomp(&patternValue, stringValue.c_str(), REG_EXTENDED) != 0)
+    if ((patternValue = regexCacheGet(stringValue)) == NULL)
     {
       *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
       return false;
@@ -683,7 +679,7 @@ bool StringFilterItem::parse(char* qItem, std::string* errorStringP, StringFilte
     // Can't call valueParse here, as the forced valueType 'SfvtString' will be knocked back to its 'default'.
     // So, instead we just perform the part of SfopMatchPattern of valueParse
     //
-    if (regcomp(&patternValue, stringValue.c_str(), REG_EXTENDED) != 0)
+    if ((patternValue = regexCacheGet(stringValue)) == NULL)
     {
       *errorStringP = std::string("error compiling filter regex: '") + stringValue + "'";
       return false;
@@ -1241,7 +1237,7 @@ MatchResult StringFilterItem::matchPattern(ContextAttribute* caP)
     return MrIncompatibleType;
   }
 
-  return (regexec(&patternValue, caP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
+  return regexCacheMatch(patternValue, caP->stringValue.c_str())? MrMatch : MrNoMatch;
 }
 
 
@@ -1258,7 +1254,7 @@ MatchResult StringFilterItem::matchPattern(orion::CompoundValueNode* cvP)
     return MrIncompatibleType;
   }
 
-  return (regexec(&patternValue, cvP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
+  return regexCacheMatch(patternValue, cvP->stringValue.c_str())? MrMatch : MrNoMatch;
 }
 
 
@@ -1293,7 +1289,7 @@ MatchResult StringFilterItem::matchPattern(Metadata* mdP)
     return MrIncompatibleType;
   }
 
-  return (regexec(&patternValue, mdP->stringValue.c_str(), 0, NULL, 0) == 0)? MrMatch : MrNoMatch;
+  return regexCacheMatch(patternValue, mdP->stringValue.c_str())? MrMatch : MrNoMatch;
 }
 
 
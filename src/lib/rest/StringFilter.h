@@ -27,10 +27,10 @@
 */
 #include <string>
 #include <vector>
-#include <regex.h>
 
 #include "mongo/client/dbclient.h"
 
+#include "common/regexCache.h"
 #include "parse/CompoundValueNode.h"
 
 
@@ -154,7 +154,7 @@ public:
   StringFilterValueType     valueType;
   double                    numberValue;
   std::string               stringValue;
-  regex_t                   patternValue;
+  CachedRegex*              patternValue;
   bool                      boolValue;
   std::vector<std::string>  stringList;
   std::vector<double>       numberList;
@@ -0,0 +1,433 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+
+#include <string>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "rest/compression.h"
+
+
+
+/* ****************************************************************************
+*
+* Configuration and counters -
+*/
+static unsigned int                 minSize                        = 0;
+static bool                         notifCompression               = false;
+static volatile unsigned long long  responses                      = 0;
+static volatile unsigned long long  responsesUncompressedBytes     = 0;
+static volatile unsigned long long  responsesCompressedBytes       = 0;
+static volatile unsigned long long  notifications                  = 0;
+static volatile unsigned long long  notificationsUncompressedBytes = 0;
+static volatile unsigned long long  notificationsCompressedBytes   = 0;
+
+
+
+/* ****************************************************************************
+*
+* Compressor -
+*
+* Per thread zlib streams, one per encoding (they differ in the header and trailer
+* written). Initialized the first time they are used and reset after each use.
+*/
+typedef struct Compressor
+{
+  z_stream  stream[3];
+  bool      initialized[3];
+} Compressor;
+
+static pthread_key_t   compressorKey;
+static pthread_once_t  compressorKeyOnce = PTHREAD_ONCE_INIT;
+
+
+
+/* ****************************************************************************
+*
+* compressorRelease -
+*
+* Destructor of the thread specific compressor, called at thread exit
+*/
+static void compressorRelease(void* p)
+{
+  Compressor* cP = (Compressor*) p;
+
+  for (int ix = 0; ix < 3; ++ix)
+  {
+    if (cP->initialized[ix])
+    {
+      deflateEnd(&cP->stream[ix]);
+    }
+  }
+
+  free(cP);
+}
+
+
+
+/* ****************************************************************************
+*
+* compressorKeyCreate -
+*/
+static void compressorKeyCreate(void)
+{
+  pthread_key_create(&compressorKey, compressorRelease);
+}
+
+
+
+/* ****************************************************************************
+*
+* compressorGet -
+*/
+static z_stream* compressorGet(ContentEncoding encoding)
+{
+  pthread_once(&compressorKeyOnce, compressorKeyCreate);
+
+  Compressor* cP = (Compressor*) pthread_getspecific(compressorKey);
+
+  if (cP == NULL)
+  {
+    cP = (Compressor*) calloc(1, sizeof(Compressor));
+    pthread_setspecific(compressorKey, cP);
+  }
+
+  z_stream* streamP = &cP->stream[encoding];
+
+  if (!cP->initialized[encoding])
+  {
+    // 15 is the zlib default window, +16 to write a gzip header and trailer instead of the zlib ones
+    int windowBits = (encoding == CeGzip)? 15 + 16 : 15;
+
+    if (deflateInit2(streamP, COMPRESSION_LEVEL, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      LM_E(("Runtime Error (deflateInit2 failed: %s)", (streamP->msg != NULL)? streamP->msg : "unknown error"));
+      return NULL;
+    }
+
+    cP->initialized[encoding] = true;
+  }
+  else
+  {
+    deflateReset(streamP);
+  }
+
+  return streamP;
+}
+
+
+
+/* ****************************************************************************
+*
+* compressionInit -
+*/
+void compressionInit(unsigned int _minSize, bool notifications)
+{
+  minSize          = _minSize;
+  notifCompression = notifications;
+}
+
+
+
+/* ****************************************************************************
+*
+* compressionActive -
+*/
+bool compressionActive(void)
+{
+  return minSize > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* compressionMinSizeGet -
+*/
+unsigned int compressionMinSizeGet(void)
+{
+  return minSize;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifCompressionActive -
+*/
+bool notifCompressionActive(void)
+{
+  return notifCompression;
+}
+
+
+
+/* ****************************************************************************
+*
+* contentEncodingParse -
+*/
+ContentEncoding contentEncodingParse(const std::string& contentEncoding)
+{
+  if (strcasecmp(contentEncoding.c_str(), "gzip") == 0)
+  {
+    return CeGzip;
+  }
+  else if (strcasecmp(contentEncoding.c_str(), "deflate") == 0)
+  {
+    return CeDeflate;
+  }
+
+  return CeIdentity;
+}
+
+
+
+/* ****************************************************************************
+*
+* contentEncodingName -
+*/
+const char* contentEncodingName(ContentEncoding encoding)
+{
+  switch (encoding)
+  {
+  case CeGzip:     return "gzip";
+  case CeDeflate:  return "deflate";
+  case CeIdentity: return "identity";
+  }
+
+  return "identity";
+}
+
+
+
+/* ****************************************************************************
+*
+* contentEncodingNegotiate -
+*
+* Accept-Encoding: <coding>[;q=<qvalue>], ...
+*
+* A coding with q=0 is not acceptable. '*' stands for any coding not explicitly listed.
+*/
+ContentEncoding contentEncodingNegotiate(const std::string& acceptEncoding)
+{
+  double       gzipQ     = -1;
+  double       deflateQ  = -1;
+  double       anyQ      = -1;
+  const char*  cP        = acceptEncoding.c_str();
+
+  while (*cP != 0)
+  {
+    // Skip separators and whitespace before the coding
+    while ((*cP == ' ') || (*cP == '\t') || (*cP == ','))
+    {
+      ++cP;
+    }
+
+    const char* codingStart = cP;
+
+    while ((*cP != 0) && (*cP != ',') && (*cP != ';') && (*cP != ' ') && (*cP != '\t'))
+    {
+      ++cP;
+    }
+
+    std::string  coding(codingStart, cP - codingStart);
+    double       q = 1;
+
+    // Parameters (only q is taken into account)
+    while ((*cP != 0) && (*cP != ','))
+    {
+      if (((*cP == 'q') || (*cP == 'Q')) && (cP[1] == '='))
+      {
+        q = atof(&cP[2]);
+      }
+
+      ++cP;
+    }
+
+    if (strcasecmp(coding.c_str(), "gzip") == 0)
+    {
+      gzipQ = q;
+    }
+    else if (strcasecmp(coding.c_str(), "deflate") == 0)
+    {
+      deflateQ = q;
+    }
+    else if (coding == "*")
+    {
+      anyQ = q;
+    }
+  }
+
+  gzipQ    = (gzipQ    < 0)? anyQ : gzipQ;
+  deflateQ = (deflateQ < 0)? anyQ : deflateQ;
+
+  if ((gzipQ > 0) && (gzipQ >= deflateQ))
+  {
+    return CeGzip;
+  }
+  else if (deflateQ > 0)
+  {
+    return CeDeflate;
+  }
+
+  return CeIdentity;
+}
+
+
+
+/* ****************************************************************************
+*
+* compressPayload -
+*/
+bool compressPayload
+(
+  ContentEncoding  encoding,
+  const char*      in,
+  unsigned int     inLen,
+  std::string*     outP,
+  bool             notification
+)
+{
+  if (encoding == CeIdentity)
+  {
+    return false;
+  }
+
+  z_stream* streamP = compressorGet(encoding);
+
+  if (streamP == NULL)
+  {
+    return false;
+  }
+
+  outP->resize(deflateBound(streamP, inLen));
+
+  streamP->next_in   = (Bytef*) in;
+  streamP->avail_in  = inLen;
+  streamP->next_out  = (Bytef*) &(*outP)[0];
+  streamP->avail_out = outP->size();
+
+  // The output buffer is big enough for the whole stream, so one call is enough
+  if (deflate(streamP, Z_FINISH) != Z_STREAM_END)
+  {
+    LM_E(("Runtime Error (deflate failed: %s)", (streamP->msg != NULL)? streamP->msg : "unknown error"));
+    outP->clear();
+    return false;
+  }
+
+  outP->resize(streamP->total_out);
+
+  if (notification)
+  {
+    __sync_fetch_and_add(&notifications, 1);
+    __sync_fetch_and_add(&notificationsUncompressedBytes, inLen);
+    __sync_fetch_and_add(&notificationsCompressedBytes, outP->size());
+  }
+  else
+  {
+    __sync_fetch_and_add(&responses, 1);
+    __sync_fetch_and_add(&responsesUncompressedBytes, inLen);
+    __sync_fetch_and_add(&responsesCompressedBytes, outP->size());
+  }
+
+  LM_T(LmtRest, ("%s: %u bytes compressed into %d", contentEncodingName(encoding), inLen, (int) outP->size()));
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationCompress -
+*/
+ContentEncoding notificationCompress
+(
+  const std::map<std::string, std::string>&  extraHeaders,
+  const std::string&                         content,
+  std::string*                               outP
+)
+{
+  if ((!notifCompression) || (content.empty()))
+  {
+    return CeIdentity;
+  }
+
+  for (std::map<std::string, std::string>::const_iterator it = extraHeaders.begin(); it != extraHeaders.end(); ++it)
+  {
+    if (strcasecmp(it->first.c_str(), "Content-Encoding") == 0)
+    {
+      ContentEncoding encoding = contentEncodingParse(it->second);
+
+      if ((encoding == CeIdentity) || (!compressPayload(encoding, content.c_str(), content.size(), outP, true)))
+      {
+        return CeIdentity;
+      }
+
+      return encoding;
+    }
+  }
+
+  return CeIdentity;
+}
+
+
+
+/* ****************************************************************************
+*
+* compressionStatisticsGet -
+*/
+void compressionStatisticsGet(CompressionStatistics* statsP)
+{
+  statsP->responses                      = __sync_fetch_and_add(&responses, 0);
+  statsP->responsesUncompressedBytes     = __sync_fetch_and_add(&responsesUncompressedBytes, 0);
+  statsP->responsesCompressedBytes       = __sync_fetch_and_add(&responsesCompressedBytes, 0);
+  statsP->notifications                  = __sync_fetch_and_add(&notifications, 0);
+  statsP->notificationsUncompressedBytes = __sync_fetch_and_add(&notificationsUncompressedBytes, 0);
+  statsP->notificationsCompressedBytes   = __sync_fetch_and_add(&notificationsCompressedBytes, 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* compressionStatisticsReset -
+*/
+void compressionStatisticsReset(void)
+{
+  __sync_lock_test_and_set(&responses, 0);
+  __sync_lock_test_and_set(&responsesUncompressedBytes, 0);
+  __sync_lock_test_and_set(&responsesCompressedBytes, 0);
+  __sync_lock_test_and_set(&notifications, 0);
+  __sync_lock_test_and_set(&notificationsUncompressedBytes, 0);
+  __sync_lock_test_and_set(&notificationsCompressedBytes, 0);
+}
@@ -0,0 +1,190 @@
+#ifndef SRC_LIB_REST_COMPRESSION_H_
+#define SRC_LIB_REST_COMPRESSION_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <map>
+
+
+
+/* ****************************************************************************
+*
+* COMPRESSION_LEVEL -
+*
+* zlib compression level. JSON compresses well even at the fastest level, and the
+* higher levels cost a lot more CPU for a few percent of size.
+*/
+#define COMPRESSION_LEVEL  1
+
+
+
+/* ****************************************************************************
+*
+* ContentEncoding -
+*/
+typedef enum ContentEncoding
+{
+  CeIdentity = 0,
+  CeGzip     = 1,
+  CeDeflate  = 2
+} ContentEncoding;
+
+
+
+/* ****************************************************************************
+*
+* CompressionStatistics -
+*/
+typedef struct CompressionStatistics
+{
+  unsigned long long  responses;
+  unsigned long long  responsesUncompressedBytes;
+  unsigned long long  responsesCompressedBytes;
+  unsigned long long  notifications;
+  unsigned long long  notificationsUncompressedBytes;
+  unsigned long long  notificationsCompressedBytes;
+} CompressionStatistics;
+
+
+
+/* ****************************************************************************
+*
+* compressionInit -
+*
+* Responses of at least minSize bytes are compressed if the client accepts it (a minSize
+* of zero disables it). Notifications are compressed if 'notifications' is set, see
+* notificationCompress().
+*/
+extern void compressionInit(unsigned int minSize, bool notifications);
+
+
+
+/* ****************************************************************************
+*
+* compressionActive -
+*/
+extern bool compressionActive(void);
+
+
+
+/* ****************************************************************************
+*
+* compressionMinSizeGet -
+*/
+extern unsigned int compressionMinSizeGet(void);
+
+
+
+/* ****************************************************************************
+*
+* notifCompressionActive -
+*/
+extern bool notifCompressionActive(void);
+
+
+
+/* ****************************************************************************
+*
+* contentEncodingNegotiate -
+*
+* Selects the encoding of a response from the value of the Accept-Encoding header of
+* the request (gzip preferred over deflate, unless the q-values say otherwise).
+*/
+extern ContentEncoding contentEncodingNegotiate(const std::string& acceptEncoding);
+
+
+
+/* ****************************************************************************
+*
+* contentEncodingParse -
+*
+* Encoding of a Content-Encoding header value (CeIdentity if not supported)
+*/
+extern ContentEncoding contentEncodingParse(const std::string& contentEncoding);
+
+
+
+/* ****************************************************************************
+*
+* contentEncodingName -
+*/
+extern const char* contentEncodingName(ContentEncoding encoding);
+
+
+
+/* ****************************************************************************
+*
+* compressPayload -
+*
+* Compresses 'in' into *outP. The zlib stream is kept by the calling thread and reused
+* by its next calls, so only its first call pays the zlib initialization.
+*
+* 'notification' selects the statistics counters to update. Returns false on zlib error.
+*/
+extern bool compressPayload
+(
+  ContentEncoding  encoding,
+  const char*      in,
+  unsigned int     inLen,
+  std::string*     outP,
+  bool             notification
+);
+
+
+
+/* ****************************************************************************
+*
+* notificationCompress -
+*
+* Compresses the payload of a notification into *outP, if notification compression is
+* enabled and the custom headers of its subscription include Content-Encoding (gzip or
+* deflate). Returns the encoding of the payload: with CeIdentity (payload not compressed)
+* the Content-Encoding header is not to be sent.
+*/
+extern ContentEncoding notificationCompress
+(
+  const std::map<std::string, std::string>&  extraHeaders,
+  const std::string&                         content,
+  std::string*                               outP
+);
+
+
+
+/* ****************************************************************************
+*
+* compressionStatisticsGet -
+*/
+extern void compressionStatisticsGet(CompressionStatistics* statsP);
+
+
+
+/* ****************************************************************************
+*
+* compressionStatisticsReset -
+*/
+extern void compressionStatisticsReset(void);
+
+#endif  // SRC_LIB_REST_COMPRESSION_H_
@@ -50,6 +50,7 @@
 #include "rest/ConnectionInfo.h"
 #include "rest/httpRequestSend.h"
 #include "rest/HttpHeaders.h"
+#include "rest/compression.h"
 #include "rest/rest.h"
 #include "serviceRoutines/versionTreat.h"
 
@@ -353,6 +354,14 @@ int httpRequestSendWithCurl
     return -6;
   }
 
+  //
+  // A receiver declaring a compressed payload (Content-Encoding in the custom headers of the
+  // subscription) gets it compressed, if notification compression is enabled
+  //
+  std::string         compressedContent;
+  ContentEncoding     encoding = notificationCompress(extraHeaders, content, &compressedContent);
+  const std::string*  bodyP    = (encoding == CeIdentity)? &content : &compressedContent;
+
 
 
   // Allocate to hold HTTP response
@@ -460,7 +469,7 @@ int httpRequestSendWithCurl
 
   // ----- Content-length
   std::stringstream contentLengthStringStream;
-  contentLengthStringStream << content.size();
+  contentLengthStringStream << bodyP->size();
   std::string contentLengthHeaderName  = HTTP_CONTENT_LENGTH;
   std::string contentLengthHeaderValue = contentLengthStringStream.str();
 
@@ -474,7 +483,7 @@ int httpRequestSendWithCurl
   // including HTTP headers etc, while 'payloadSize' is the size of just
   // the payload of the message.
   //
-  unsigned long long payloadSize = content.size();
+  unsigned long long payloadSize = bodyP->size();
   outgoingMsgSize += payloadSize;
 
 
@@ -483,6 +492,13 @@ int httpRequestSendWithCurl
 
   httpHeaderAdd(&headers, HTTP_CONTENT_TYPE, contentTypeHeaderValue, &outgoingMsgSize, extraHeaders, usedExtraHeaders);
 
+  // ----- Content-Encoding, only if the payload has been compressed
+  if (encoding != CeIdentity)
+  {
+    httpHeaderAdd(&headers, HTTP_CONTENT_ENCODING, contentEncodingName(encoding), &outgoingMsgSize, extraHeaders, usedExtraHeaders);
+  }
+  usedExtraHeaders["content-encoding"] = true;
+
   // Fiware-Correlator
   std::string correlationHeaderValue = fiwareCorrelation;
   httpHeaderAdd(&headers, HTTP_FIWARE_CORRELATOR, correlationHeaderValue, &outgoingMsgSize, extraHeaders, usedExtraHeaders);
@@ -535,8 +551,9 @@ int httpRequestSendWithCurl
   }
 
   // Contents
-  const char* payload = content.c_str();
+  const char* payload = bodyP->c_str();
   curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (u_int8_t*) payload);
+  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long) bodyP->size());  // Compressed payloads are binary
 
   // Set up URL
   std::string url;
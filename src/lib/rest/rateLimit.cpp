@@ -0,0 +1,923 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/JsonHelper.h"
+#include "common/StringHashTable.h"
+#include "metricsMgr/metricsMgr.h"
+#include "rest/rateLimit.h"
+
+
+
+/* ****************************************************************************
+*
+* RateLimit -
+*
+* A limit configured through the admin API, or the instance of a '*' limit for a given
+* service. Created the first time it is needed. Configured limits are never freed (removing
+* a limit just sets its interval to zero), while idle instances are evicted when the table
+* runs out of room for them (see rateLimitSweep()).
+*
+* The token bucket is implemented as a GCRA (generic cell rate algorithm), so its whole
+* state is a single value (tat) that is updated with a compare-and-swap.
+*
+* Fields:
+*   key          service, servicePath and class, separated by '|' ('@' prefix for instances)
+*   parentP      for instances, the '*' limit from which interval and tolerance are taken
+*   rate         requests per second (for rendering only)
+*   burst        requests allowed at once (for rendering only)
+*   interval     time (us) between requests at the configured rate, zero if removed
+*   tolerance    time (us) the requests can go ahead of the configured rate (burst * interval)
+*   tat          theoretical arrival time (monotonic us) of the next request
+*   accepted     requests admitted (counter)
+*   rejected     requests rejected with 429 (counter)
+*   published    accepted/rejected already added to the metrics (see rateLimitMetricsPublish())
+*/
+typedef struct RateLimit
+{
+  std::string                  key;
+  std::string                  service;
+  std::string                  servicePath;
+  RateLimitClass               rlClass;
+  RateLimit*                   parentP;
+  double                       rate;
+  unsigned int                 burst;
+  volatile long long           interval;
+  volatile long long           tolerance;
+  volatile long long           tat;
+  volatile unsigned long long  accepted;
+  volatile unsigned long long  rejected;
+  unsigned long long           publishedAccepted;
+  unsigned long long           publishedRejected;
+} RateLimit;
+
+
+
+/* ****************************************************************************
+*
+* Shapes -
+*
+* Bit (1 << shape) of rateLimitShapes is set if some limit of that shape exists, so the
+* lookups of the shapes not in use are skipped. Bits 0-3 are for regular limits (bit 0 for
+* servicePath, bit 1 for class), bits 4-7 are the same for '*' limits. No bit set means no
+* limit at all, i.e. rateLimitAdmit() returns right away.
+*/
+#define SHAPE_SERVICE_PATH  1
+#define SHAPE_CLASS         2
+#define SHAPE_ALL_SERVICES  4
+
+static volatile int rateLimitShapes = 0;
+
+// Lookup order, from the most specific shape to the least one
+static const int shapeOrder[] = { SHAPE_SERVICE_PATH | SHAPE_CLASS, SHAPE_SERVICE_PATH, SHAPE_CLASS, 0 };
+
+
+
+/* ****************************************************************************
+*
+* Rate limit table -
+*
+* Same open addressing scheme than the destination table (see destinationHealth.cpp):
+* slots go from NULL to a limit just once, with rateLimitMutex taken, so the lookup
+* needs no lock.
+*
+* Idle instances are evicted by building a new table without them, that replaces the
+* current one. The old table and the evicted instances are freed in the next sweep, at
+* least RATE_LIMIT_SWEEP_INTERVAL seconds later, when no lookup can be using them anymore.
+*/
+typedef RateLimit* volatile  RateLimitSlot;
+
+static RateLimitSlot                 rateLimitTableInitial[RATE_LIMIT_TABLE_SIZE];
+static RateLimitSlot* volatile       rateLimitTable      = rateLimitTableInitial;
+static unsigned int                  rateLimitTableItems = 0;
+static volatile unsigned int         rateLimitInstances  = 0;
+static volatile long long            rateLimitLastSweep  = 0;
+static bool                          rateLimitFullLogged = false;
+static RateLimitSlot*                retiredTable        = NULL;
+static std::vector<RateLimit*>       retiredLimits;
+static pthread_mutex_t               rateLimitMutex      = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* RATE_LIMIT_SWEEP_INTERVAL - minimum time (seconds) between evictions of idle instances
+*/
+#define RATE_LIMIT_SWEEP_INTERVAL  60
+
+
+
+/* ****************************************************************************
+*
+* RateLimitCounters - counters of an evicted instance, not yet added to the metrics
+*/
+typedef struct RateLimitCounters
+{
+  std::string         service;
+  std::string         servicePath;
+  unsigned long long  accepted;
+  unsigned long long  rejected;
+} RateLimitCounters;
+
+static std::vector<RateLimitCounters>  unpublishedCounters;
+
+
+
+/* ****************************************************************************
+*
+* rateLimitClock -
+*/
+static long long rateLimitClock(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitClassName -
+*/
+static const char* rateLimitClassName(RateLimitClass rlClass)
+{
+  switch (rlClass)
+  {
+  case RlcAny:    return "";
+  case RlcRead:   return "read";
+  case RlcWrite:  return "write";
+  case RlcBatch:  return "batch";
+  case RlcNone:   return "none";
+  }
+
+  return "";
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitClassParse -
+*/
+RateLimitClass rateLimitClassParse(const std::string& name)
+{
+  if (name == "")       return RlcAny;
+  if (name == "read")   return RlcRead;
+  if (name == "write")  return RlcWrite;
+  if (name == "batch")  return RlcBatch;
+
+  return RlcNone;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestClassGet -
+*/
+static RateLimitClass requestClassGet(ConnectionInfo* ciP)
+{
+  const char* url = ciP->url.c_str();
+
+  if ((ciP->apiVersion != V1) && (ciP->apiVersion != V2))
+  {
+    return RlcNone;
+  }
+
+  // Administrative requests with /v1 equivalence
+  if ((strncasecmp(url, "/log",        4)  == 0) ||
+      (strncasecmp(url, "/cache",      6)  == 0) ||
+      (strncasecmp(url, "/statistics", 11) == 0))
+  {
+    return RlcNone;
+  }
+
+  if (strncmp(url, "/v2/op/", 7) == 0)
+  {
+    return RlcBatch;
+  }
+
+  if ((ciP->verb == GET) || (ciP->verb == HEAD) || (ciP->verb == OPTIONS))
+  {
+    return RlcRead;
+  }
+
+  return RlcWrite;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitKey -
+*/
+static std::string rateLimitKey(const std::string& service, const std::string& servicePath, RateLimitClass rlClass)
+{
+  return service + '|' + servicePath + '|' + rateLimitClassName(rlClass);
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitLookup -
+*/
+static RateLimit* rateLimitLookup(const std::string& key, unsigned int hash)
+{
+  RateLimitSlot* table = rateLimitTable;
+
+  for (unsigned int probe = 0; probe < RATE_LIMIT_TABLE_SIZE; ++probe)
+  {
+    RateLimit* rlP = table[(hash + probe) & (RATE_LIMIT_TABLE_SIZE - 1)];
+
+    if (rlP == NULL)
+    {
+      return NULL;
+    }
+
+    if (rlP->key == key)
+    {
+      return rlP;
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitInsert -
+*
+* To be called with rateLimitMutex taken, with room in the table
+*/
+static void rateLimitInsert(RateLimitSlot* table, RateLimit* rlP, unsigned int hash)
+{
+  for (unsigned int probe = 0; probe < RATE_LIMIT_TABLE_SIZE; ++probe)
+  {
+    unsigned int slot = (hash + probe) & (RATE_LIMIT_TABLE_SIZE - 1);
+
+    if (table[slot] == NULL)
+    {
+      // The limit has to be complete before it is visible to readers
+      __sync_synchronize();
+      table[slot] = rlP;
+      break;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitCreate -
+*
+* To be called with rateLimitMutex taken. Returns NULL if the table is full or, for
+* instances (parentP not NULL), if there are RATE_LIMIT_INSTANCES_MAX of them already.
+*/
+static RateLimit* rateLimitCreate
+(
+  const std::string&  key,
+  unsigned int        hash,
+  const std::string&  service,
+  const std::string&  servicePath,
+  RateLimitClass      rlClass,
+  RateLimit*          parentP
+)
+{
+  if (rateLimitTableItems >= RATE_LIMIT_TABLE_SIZE / 4 * 3)
+  {
+    return NULL;
+  }
+
+  if ((parentP != NULL) && (rateLimitInstances >= RATE_LIMIT_INSTANCES_MAX))
+  {
+    return NULL;
+  }
+
+  RateLimit* rlP = new RateLimit();
+
+  rlP->key         = key;
+  rlP->service     = service;
+  rlP->servicePath = servicePath;
+  rlP->rlClass     = rlClass;
+  rlP->parentP     = parentP;
+  rlP->rate        = 0;
+  rlP->burst       = 0;
+  rlP->interval    = 0;
+  rlP->tolerance   = 0;
+  rlP->tat         = 0;
+  rlP->accepted    = 0;
+  rlP->rejected    = 0;
+
+  rlP->publishedAccepted = 0;
+  rlP->publishedRejected = 0;
+
+  rateLimitInsert(rateLimitTable, rlP, hash);
+  ++rateLimitTableItems;
+
+  if (parentP != NULL)
+  {
+    ++rateLimitInstances;
+  }
+
+  return rlP;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitSweep -
+*
+* Evicts the idle instances, i.e. the ones whose bucket is full again (so a new instance
+* would behave the same) or whose '*' limit has been removed. Their counters are kept
+* for the next rateLimitMetricsPublish(). Returns the number of instances evicted.
+*
+* To be called with rateLimitMutex taken
+*/
+static unsigned int rateLimitSweep(void)
+{
+  long long now = rateLimitClock();
+
+  rateLimitLastSweep = now;
+
+  // The table and instances retired in the previous sweep are not in use anymore
+  if (retiredTable != NULL)
+  {
+    free((void*) retiredTable);
+    retiredTable = NULL;
+  }
+
+  for (unsigned int ix = 0; ix < retiredLimits.size(); ++ix)
+  {
+    delete retiredLimits[ix];
+  }
+  retiredLimits.clear();
+
+  RateLimitSlot*  oldTable  = rateLimitTable;
+  RateLimitSlot*  newTable  = (RateLimitSlot*) calloc(RATE_LIMIT_TABLE_SIZE, sizeof(RateLimitSlot));
+  unsigned int    items     = 0;
+  unsigned int    instances = 0;
+
+  for (unsigned int slot = 0; slot < RATE_LIMIT_TABLE_SIZE; ++slot)
+  {
+    RateLimit* rlP = oldTable[slot];
+
+    if (rlP == NULL)
+    {
+      continue;
+    }
+
+    if ((rlP->parentP != NULL) && ((rlP->parentP->interval == 0) || (rlP->tat <= now)))
+    {
+      if ((rlP->accepted != rlP->publishedAccepted) || (rlP->rejected != rlP->publishedRejected))
+      {
+        RateLimitCounters counters;
+
+        counters.service     = rlP->service;
+        counters.servicePath = rlP->servicePath;
+        counters.accepted    = rlP->accepted - rlP->publishedAccepted;
+        counters.rejected    = rlP->rejected - rlP->publishedRejected;
+
+        // Bounded, in case the metrics are never read
+        if (unpublishedCounters.size() < RATE_LIMIT_TABLE_SIZE)
+        {
+          unpublishedCounters.push_back(counters);
+        }
+      }
+
+      retiredLimits.push_back(rlP);
+      continue;
+    }
+
+    rateLimitInsert(newTable, rlP, stringHash(rlP->key));
+
+    ++items;
+    if (rlP->parentP != NULL)
+    {
+      ++instances;
+    }
+  }
+
+  rateLimitTable      = newTable;
+  rateLimitTableItems = items;
+  rateLimitInstances  = instances;
+
+  if (oldTable != rateLimitTableInitial)
+  {
+    retiredTable = oldTable;
+  }
+
+  if (retiredLimits.size() > 0)
+  {
+    rateLimitFullLogged = false;
+  }
+
+  LM_T(LmtRest, ("rate limit table sweep: %d instances evicted, %d kept", retiredLimits.size(), instances));
+
+  return retiredLimits.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitInstanceGet -
+*
+* Instance of the '*' limit 'parentP' for a given service
+*/
+static RateLimit* rateLimitInstanceGet
+(
+  RateLimit*          parentP,
+  const std::string&  service,
+  const std::string&  servicePath,
+  RateLimitClass      rlClass
+)
+{
+  std::string   key  = '@' + rateLimitKey(service, servicePath, rlClass);
+  unsigned int  hash = stringHash(key);
+  RateLimit*    rlP  = rateLimitLookup(key, hash);
+
+  if (rlP != NULL)
+  {
+    return rlP;
+  }
+
+  //
+  // Without room for more instances (and not being time for a sweep) the service shares
+  // the bucket of the '*' limit with the rest of services in the same situation, so
+  // they are limited as a whole. This is checked without lock, as it may be the case of
+  // every request of a client sending random service names.
+  //
+  bool sweepDue = (rateLimitClock() - rateLimitLastSweep >= (long long) RATE_LIMIT_SWEEP_INTERVAL * 1000000);
+
+  if ((rateLimitInstances >= RATE_LIMIT_INSTANCES_MAX) && !sweepDue)
+  {
+    return parentP;
+  }
+
+  pthread_mutex_lock(&rateLimitMutex);
+
+  // Look again, some other thread could have created it in the meanwhile
+  if ((rlP = rateLimitLookup(key, hash)) == NULL)
+  {
+    rlP = rateLimitCreate(key, hash, service, servicePath, rlClass, parentP);
+
+    if ((rlP == NULL) && sweepDue && (rateLimitSweep() > 0))
+    {
+      rlP = rateLimitCreate(key, hash, service, servicePath, rlClass, parentP);
+    }
+
+    if (rlP == NULL)
+    {
+      if (!rateLimitFullLogged)
+      {
+        LM_W(("rate limit table full, services without room share the bucket of their '*' limit"));
+        rateLimitFullLogged = true;
+      }
+
+      rlP = parentP;
+    }
+  }
+
+  pthread_mutex_unlock(&rateLimitMutex);
+
+  return rlP;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitFind -
+*
+* Most specific limit in use for the request, NULL if none
+*/
+static RateLimit* rateLimitFind
+(
+  int                 shapes,
+  const std::string&  service,
+  const std::string&  servicePath,
+  RateLimitClass      rlClass
+)
+{
+  for (unsigned int ix = 0; ix < sizeof(shapeOrder) / sizeof(shapeOrder[0]); ++ix)
+  {
+    int shape = shapeOrder[ix];
+
+    if ((shapes & (1 << shape)) == 0)
+    {
+      continue;
+    }
+
+    std::string         sp   = (shape & SHAPE_SERVICE_PATH)? servicePath : "";
+    RateLimitClass      rlc  = (shape & SHAPE_CLASS)?        rlClass     : RlcAny;
+    std::string         key  = rateLimitKey(service, sp, rlc);
+    RateLimit*          rlP  = rateLimitLookup(key, stringHash(key));
+
+    if ((rlP != NULL) && (rlP->interval != 0))
+    {
+      return rlP;
+    }
+  }
+
+  for (unsigned int ix = 0; ix < sizeof(shapeOrder) / sizeof(shapeOrder[0]); ++ix)
+  {
+    int shape = shapeOrder[ix];
+
+    if ((shapes & (1 << (shape | SHAPE_ALL_SERVICES))) == 0)
+    {
+      continue;
+    }
+
+    std::string         sp   = (shape & SHAPE_SERVICE_PATH)? servicePath : "";
+    RateLimitClass      rlc  = (shape & SHAPE_CLASS)?        rlClass     : RlcAny;
+    std::string         key  = rateLimitKey("*", sp, rlc);
+    RateLimit*          rlP  = rateLimitLookup(key, stringHash(key));
+
+    if ((rlP != NULL) && (rlP->interval != 0))
+    {
+      return rateLimitInstanceGet(rlP, service, sp, rlc);
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitAdmit -
+*/
+bool rateLimitAdmit(ConnectionInfo* ciP, const std::string& servicePath, int* retryAfterP)
+{
+  int shapes = rateLimitShapes;
+
+  if (shapes == 0)
+  {
+    return true;
+  }
+
+  RateLimitClass rlClass = requestClassGet(ciP);
+
+  if (rlClass == RlcNone)
+  {
+    return true;
+  }
+
+  RateLimit* rlP = rateLimitFind(shapes, ciP->tenantFromHttpHeader, servicePath, rlClass);
+
+  if (rlP == NULL)
+  {
+    return true;
+  }
+
+  RateLimit*  configP   = (rlP->parentP != NULL)? rlP->parentP : rlP;
+  long long   interval  = configP->interval;
+  long long   tolerance = configP->tolerance;
+  long long   now       = rateLimitClock();
+  long long   tat;
+  long long   newTat;
+
+  if (interval == 0)  // Removed in the meanwhile
+  {
+    return true;
+  }
+
+  do
+  {
+    tat    = rlP->tat;
+    newTat = ((tat > now)? tat : now) + interval;
+
+    if (newTat - now > tolerance)
+    {
+      long long wait = newTat - now - tolerance;
+
+      *retryAfterP = (int) ((wait + 999999) / 1000000);
+
+      __sync_fetch_and_add(&rlP->rejected, 1);
+
+      LM_T(LmtRest, ("rate limit '%s' exceeded, retry after %d s", rlP->key.c_str(), *retryAfterP));
+      return false;
+    }
+  } while (!__sync_bool_compare_and_swap(&rlP->tat, tat, newTat));
+
+  __sync_fetch_and_add(&rlP->accepted, 1);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* shapesUpdate -
+*
+* To be called with rateLimitMutex taken
+*/
+static void shapesUpdate(void)
+{
+  int             shapes = 0;
+  RateLimitSlot*  table  = rateLimitTable;
+
+  for (unsigned int slot = 0; slot < RATE_LIMIT_TABLE_SIZE; ++slot)
+  {
+    RateLimit* rlP = table[slot];
+
+    if ((rlP == NULL) || (rlP->parentP != NULL) || (rlP->interval == 0))
+    {
+      continue;
+    }
+
+    int shape = 0;
+
+    if (rlP->servicePath != "")  shape |= SHAPE_SERVICE_PATH;
+    if (rlP->rlClass != RlcAny)  shape |= SHAPE_CLASS;
+    if (rlP->service == "*")     shape |= SHAPE_ALL_SERVICES;
+
+    shapes |= (1 << shape);
+  }
+
+  rateLimitShapes = shapes;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitSet -
+*/
+bool rateLimitSet
+(
+  const std::string&  service,
+  const std::string&  servicePath,
+  RateLimitClass      rlClass,
+  double              rate,
+  unsigned int        burst,
+  std::string*        detailsP
+)
+{
+  if ((rlClass == RlcNone) || (rate <= 0) || (rate > 1000000))
+  {
+    *detailsP = "invalid rate limit";
+    return false;
+  }
+
+  if (burst == 0)
+  {
+    burst = (rate < 1)? 1 : (unsigned int) (rate + 0.5);
+  }
+
+  std::string   key  = rateLimitKey(service, servicePath, rlClass);
+  unsigned int  hash = stringHash(key);
+  long long     interval;
+  RateLimit*    rlP;
+
+  interval = (long long) (1000000 / rate);
+
+  pthread_mutex_lock(&rateLimitMutex);
+
+  if ((rlP = rateLimitLookup(key, hash)) == NULL)
+  {
+    if ((rlP = rateLimitCreate(key, hash, service, servicePath, rlClass, NULL)) == NULL)
+    {
+      pthread_mutex_unlock(&rateLimitMutex);
+      *detailsP = "too many rate limits";
+      return false;
+    }
+  }
+
+  rlP->rate      = rate;
+  rlP->burst     = burst;
+  rlP->tolerance = interval * burst;
+  rlP->interval  = interval;
+
+  shapesUpdate();
+
+  pthread_mutex_unlock(&rateLimitMutex);
+
+  LM_T(LmtRest, ("rate limit '%s' set: %f requests/s, burst %u", key.c_str(), rate, burst));
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitRemove -
+*/
+bool rateLimitRemove(const std::string& service, const std::string& servicePath, RateLimitClass rlClass)
+{
+  std::string  key = rateLimitKey(service, servicePath, rlClass);
+  bool         found;
+
+  pthread_mutex_lock(&rateLimitMutex);
+
+  RateLimit* rlP = rateLimitLookup(key, stringHash(key));
+
+  found = (rlP != NULL) && (rlP->interval != 0);
+
+  if (found)
+  {
+    rlP->interval = 0;
+    shapesUpdate();
+  }
+
+  pthread_mutex_unlock(&rateLimitMutex);
+
+  return found;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitToJson -
+*/
+static std::string rateLimitToJson(RateLimit* rlP)
+{
+  JsonHelper  jh;
+  RateLimit*  configP = (rlP->parentP != NULL)? rlP->parentP : rlP;
+
+  jh.addString("service", rlP->service);
+
+  if (rlP->servicePath != "")
+  {
+    jh.addString("servicePath", rlP->servicePath);
+  }
+
+  if (rlP->rlClass != RlcAny)
+  {
+    jh.addString("class", rateLimitClassName(rlP->rlClass));
+  }
+
+  jh.addNumber("rate",     configP->rate);
+  jh.addNumber("burst",    (long long) configP->burst);
+  jh.addNumber("accepted", (long long) rlP->accepted);
+  jh.addNumber("rejected", (long long) rlP->rejected);
+
+  if (rlP->parentP != NULL)
+  {
+    jh.addBool("fromAllServices", true);
+  }
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitsToJson -
+*
+* Limits in use, including the per-service instances of the '*' limits
+*/
+std::string rateLimitsToJson(void)
+{
+  std::string  out   = "[";
+  bool         first = true;
+
+  pthread_mutex_lock(&rateLimitMutex);
+
+  RateLimitSlot* table = rateLimitTable;
+
+  for (unsigned int slot = 0; slot < RATE_LIMIT_TABLE_SIZE; ++slot)
+  {
+    RateLimit* rlP = table[slot];
+
+    if ((rlP == NULL) || (((rlP->parentP != NULL)? rlP->parentP : rlP)->interval == 0))
+    {
+      continue;
+    }
+
+    out  += (first? "" : ",") + rateLimitToJson(rlP);
+    first = false;
+  }
+
+  pthread_mutex_unlock(&rateLimitMutex);
+
+  return out + "]";
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitMetricsPublish -
+*/
+void rateLimitMetricsPublish(void)
+{
+  std::vector<RateLimitCounters> countersV;
+
+  pthread_mutex_lock(&rateLimitMutex);
+
+  countersV.swap(unpublishedCounters);
+
+  RateLimitSlot* table = rateLimitTable;
+
+  for (unsigned int slot = 0; slot < RATE_LIMIT_TABLE_SIZE; ++slot)
+  {
+    RateLimit* rlP = table[slot];
+
+    // The requests limited by the bucket of a '*' limit itself have no service to go to
+    if ((rlP == NULL) || (rlP->service == "*"))
+    {
+      continue;
+    }
+
+    unsigned long long accepted = rlP->accepted;
+    unsigned long long rejected = rlP->rejected;
+
+    if ((accepted != rlP->publishedAccepted) || (rejected != rlP->publishedRejected))
+    {
+      RateLimitCounters counters;
+
+      counters.service     = rlP->service;
+      counters.servicePath = rlP->servicePath;
+      counters.accepted    = accepted - rlP->publishedAccepted;
+      counters.rejected    = rejected - rlP->publishedRejected;
+
+      countersV.push_back(counters);
+
+      rlP->publishedAccepted = accepted;
+      rlP->publishedRejected = rejected;
+    }
+  }
+
+  pthread_mutex_unlock(&rateLimitMutex);
+
+  for (unsigned int ix = 0; ix < countersV.size(); ++ix)
+  {
+    RateLimitCounters* cP = &countersV[ix];
+
+    if (cP->accepted > 0)
+    {
+      metricsMgr.add(cP->service, cP->servicePath, METRIC_RATE_LIMIT_ACCEPTED, cP->accepted);
+    }
+
+    if (cP->rejected > 0)
+    {
+      metricsMgr.add(cP->service, cP->servicePath, METRIC_RATE_LIMIT_REJECTED, cP->rejected);
+    }
+  }
+}
+
+
+
+#ifdef UNIT_TEST
+/* ****************************************************************************
+*
+* rateLimitSweepForUnitTest -
+*/
+unsigned int rateLimitSweepForUnitTest(void)
+{
+  pthread_mutex_lock(&rateLimitMutex);
+
+  unsigned int evicted = rateLimitSweep();
+
+  pthread_mutex_unlock(&rateLimitMutex);
+
+  return evicted;
+}
+#endif
@@ -0,0 +1,162 @@
+#ifndef SRC_LIB_REST_RATELIMIT_H_
+#define SRC_LIB_REST_RATELIMIT_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "rest/ConnectionInfo.h"
+
+
+
+/* ****************************************************************************
+*
+* RATE_LIMIT_TABLE_SIZE -
+*
+* Number of slots of the rate limit table (must be a power of two). As in the destination
+* table (see ngsiNotify/destinationHealth.h), only 3/4 of the slots are used. There is no
+* overflow map: limits that don't fit are refused.
+*/
+#define RATE_LIMIT_TABLE_SIZE  4096
+
+
+
+/* ****************************************************************************
+*
+* RATE_LIMIT_INSTANCES_MAX -
+*
+* Maximum number of per-service instances of '*' limits, so they can't use up the room of
+* the configured limits. Idle instances are evicted to make room for new ones, at most once
+* a minute. While there is no room, the services without instance share the bucket of
+* the '*' limit.
+*/
+#define RATE_LIMIT_INSTANCES_MAX  (RATE_LIMIT_TABLE_SIZE / 2)
+
+
+
+/* ****************************************************************************
+*
+* RateLimitClass -
+*
+* Classes of routes a limit can be restricted to
+*/
+typedef enum RateLimitClass
+{
+  RlcAny   = 0,
+  RlcRead  = 1,
+  RlcWrite = 2,
+  RlcBatch = 3,
+  RlcNone  = 4    // Not subject to rate limiting (administrative requests)
+} RateLimitClass;
+
+
+
+/* ****************************************************************************
+*
+* rateLimitAdmit -
+*
+* Token bucket admission control of a request, to be called as soon as its headers have
+* been read, so a rejected request costs no payload reception. servicePath is the first
+* servicePath of the request. Returns false if the request exceeds the limit of its
+* service, in which case *retryAfterP is set to the number of seconds the client should
+* wait before retrying.
+*
+* The limit applied is the most specific one configured for the service of the request
+* (servicePath and class, servicePath, class, none of them). If the service has no limits
+* the same lookup is done with the '*' limits, which apply to every service separately.
+*
+* No lock is taken, unless a '*' limit is applied to a service for the first time.
+*/
+extern bool rateLimitAdmit(ConnectionInfo* ciP, const std::string& servicePath, int* retryAfterP);
+
+
+
+/* ****************************************************************************
+*
+* rateLimitSet -
+*
+* Creates or modifies a limit. An empty servicePath and RlcAny mean the limit applies to
+* all the service paths and classes of the service. Service "*" means every service.
+* A burst of zero means the number of requests of one second at the given rate.
+*
+* Returns false (with the reason in *detailsP) if the limit cannot be set.
+*/
+extern bool rateLimitSet
+(
+  const std::string&  service,
+  const std::string&  servicePath,
+  RateLimitClass      rlClass,
+  double              rate,
+  unsigned int        burst,
+  std::string*        detailsP
+);
+
+
+
+/* ****************************************************************************
+*
+* rateLimitRemove -
+*
+* Returns false if no such limit exists
+*/
+extern bool rateLimitRemove(const std::string& service, const std::string& servicePath, RateLimitClass rlClass);
+
+
+
+/* ****************************************************************************
+*
+* rateLimitClassParse -
+*
+* "" is RlcAny. Returns RlcNone for unknown class names.
+*/
+extern RateLimitClass rateLimitClassParse(const std::string& name);
+
+
+
+/* ****************************************************************************
+*
+* rateLimitsToJson -
+*/
+extern std::string rateLimitsToJson(void);
+
+
+
+/* ****************************************************************************
+*
+* rateLimitMetricsPublish -
+*
+* Adds the requests accepted and rejected by each limit since the last call to the
+* metrics of its service and servicePath. The counters are kept apart from the metrics
+* manager, so rateLimitAdmit() takes no lock. To be called before reading the metrics.
+*/
+extern void rateLimitMetricsPublish(void);
+
+
+
+#ifdef UNIT_TEST
+extern unsigned int rateLimitSweepForUnitTest(void);
+#endif
+
+#endif  // SRC_LIB_REST_RATELIMIT_H_
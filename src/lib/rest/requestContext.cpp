@@ -0,0 +1,70 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+
+#include "logMsg/logMsg.h"
+
+#include "common/reqTrace.h"
+#include "common/statistics.h"
+#include "alarmMgr/alarmMgr.h"
+#include "rest/requestContext.h"
+
+
+
+/* ****************************************************************************
+*
+* requestContextSave -
+*/
+void requestContextSave(RequestContext* rcP)
+{
+  strncpy(rcP->transactionId, transactionId, sizeof(rcP->transactionId) - 1);
+  strncpy(rcP->correlatorId,  correlatorId,  sizeof(rcP->correlatorId) - 1);
+  strncpy(rcP->service,       service,       sizeof(rcP->service) - 1);
+  strncpy(rcP->subService,    subService,    sizeof(rcP->subService) - 1);
+  strncpy(rcP->fromIp,        fromIp,        sizeof(rcP->fromIp) - 1);
+  strncpy(rcP->clientIp,      clientIp,      sizeof(rcP->clientIp) - 1);
+
+  memcpy(&rcP->reqTrace, &reqTrace,           sizeof(reqTrace));
+  memcpy(&rcP->timeStat, &threadLastTimeStat, sizeof(threadLastTimeStat));
+}
+
+
+
+/* ****************************************************************************
+*
+* requestContextRestore -
+*/
+void requestContextRestore(const RequestContext* rcP)
+{
+  strncpy(transactionId, rcP->transactionId, sizeof(rcP->transactionId));
+  strncpy(correlatorId,  rcP->correlatorId,  sizeof(rcP->correlatorId));
+  strncpy(service,       rcP->service,       sizeof(rcP->service));
+  strncpy(subService,    rcP->subService,    sizeof(rcP->subService));
+  strncpy(fromIp,        rcP->fromIp,        sizeof(rcP->fromIp));
+  strncpy(clientIp,      rcP->clientIp,      sizeof(rcP->clientIp));
+
+  memcpy(&reqTrace,           &rcP->reqTrace, sizeof(reqTrace));
+  memcpy(&threadLastTimeStat, &rcP->timeStat, sizeof(threadLastTimeStat));
+}
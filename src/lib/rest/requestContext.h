@@ -0,0 +1,72 @@
+#ifndef SRC_LIB_REST_REQUESTCONTEXT_H_
+#define SRC_LIB_REST_REQUESTCONTEXT_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "common/limits.h"
+#include "common/reqTrace.h"
+#include "common/statistics.h"
+
+
+
+/* ****************************************************************************
+*
+* RequestContext -
+*
+* The per thread state of a request (log transaction, request trace, timing statistics),
+* kept in its ConnectionInfo between the calls of MHD when the MHD threads are shared by
+* many connections (thread pool, request workers). In that case a thread interleaves the
+* calls of different requests, so the state is restored at the start of each call and
+* saved at its end. A request worker restores it from there too.
+*/
+struct RequestContext
+{
+  char      transactionId[64];
+  char      correlatorId[64];
+  char      service[SERVICE_NAME_MAX_LEN + 1];
+  char      subService[101];
+  char      fromIp[IP_LENGTH_MAX + 1];
+  char      clientIp[IP_LENGTH_MAX + 1];
+  ReqTrace  reqTrace;
+  TimeStat  timeStat;
+};
+
+
+
+/* ****************************************************************************
+*
+* requestContextSave - copy the thread variables of the request into *rcP
+*/
+extern void requestContextSave(RequestContext* rcP);
+
+
+
+/* ****************************************************************************
+*
+* requestContextRestore - set the thread variables of the request from *rcP
+*/
+extern void requestContextRestore(const RequestContext* rcP);
+
+#endif  // SRC_LIB_REST_REQUESTCONTEXT_H_
@@ -0,0 +1,288 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <queue>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/globals.h"
+#include "common/statistics.h"
+#include "rest/RestService.h"
+#include "rest/requestContext.h"
+#include "rest/requestWorkers.h"
+
+
+
+/* ****************************************************************************
+*
+* RequestWorkerContext -
+*
+* The response of a request served by a worker, until the MHD thread queues it. The per
+* thread state of the request travels in its RequestContext (ciP->contextP).
+*/
+struct RequestWorkerContext
+{
+  MHD_Response*   response;
+  HttpStatusCode  responseCode;
+};
+
+
+
+/* ****************************************************************************
+*
+* Worker pool and queue -
+*/
+static unsigned int                  workers          = 0;
+static unsigned int                  queueSize        = 0;
+static std::queue<ConnectionInfo*>   requestQueue;
+static pthread_mutex_t               queueMutex       = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t                queueNotEmpty    = PTHREAD_COND_INITIALIZER;
+static unsigned long long            servedRequests   = 0;
+static unsigned long long            rejectedRequests = 0;
+
+
+
+/* ****************************************************************************
+*
+* requestWorker -
+*/
+static void* requestWorker(void* vP)
+{
+  extern void delayedReleaseExecute(void);
+
+  while (true)
+  {
+    pthread_mutex_lock(&queueMutex);
+
+    while (requestQueue.empty())
+    {
+      pthread_cond_wait(&queueNotEmpty, &queueMutex);
+    }
+
+    ConnectionInfo* ciP = requestQueue.front();
+
+    requestQueue.pop();
+    pthread_mutex_unlock(&queueMutex);
+
+    requestContextRestore(ciP->contextP);
+
+    if (timingStatistics)
+    {
+      memset(&threadLastTimeStat, 0, sizeof(threadLastTimeStat));
+    }
+
+    orion::requestServe(ciP);
+
+    // Same as done by requestCompleted() when the request is served in the MHD thread,
+    // but here the response has already been rendered so it is safe to do it now
+    delayedReleaseExecute();
+
+    requestContextSave(ciP->contextP);
+    __sync_fetch_and_add(&servedRequests, 1);
+
+    //
+    // Note that ciP may be gone as soon as the connection is resumed, so this must
+    // be the last thing done with it
+    //
+    MHD_resume_connection(ciP->connection);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersInit -
+*/
+void requestWorkersInit(unsigned int _workers, unsigned int _queueSize)
+{
+  workers   = _workers;
+  queueSize = _queueSize;
+
+  for (unsigned int ix = 0; ix < workers; ++ix)
+  {
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, requestWorker, NULL) != 0)
+    {
+      LM_X(1, ("Fatal Error (error creating request worker thread: %s)", strerror(errno)));
+    }
+
+    pthread_detach(tid);
+  }
+
+  LM_T(LmtMhd, ("%d request workers started, queue size %d", workers, queueSize));
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersActive -
+*/
+bool requestWorkersActive(void)
+{
+  return workers > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersDispatch -
+*/
+bool requestWorkersDispatch(ConnectionInfo* ciP)
+{
+  pthread_mutex_lock(&queueMutex);
+
+  if (requestQueue.size() >= queueSize)
+  {
+    pthread_mutex_unlock(&queueMutex);
+    __sync_fetch_and_add(&rejectedRequests, 1);
+
+    return false;
+  }
+
+  ciP->workerContextP               = new RequestWorkerContext();
+  ciP->workerContextP->response     = NULL;
+  ciP->workerContextP->responseCode = SccNone;
+
+  // From now on, the worker owns the per thread state of the request (see connectionTreat)
+  requestContextSave(ciP->contextP);
+
+  //
+  // The connection is suspended with the queue mutex taken, so no worker can pick the
+  // request (and resume the connection) before it is actually suspended
+  //
+  MHD_suspend_connection(ciP->connection);
+  requestQueue.push(ciP);
+
+  pthread_cond_signal(&queueNotEmpty);
+  pthread_mutex_unlock(&queueMutex);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersResponseKeep -
+*/
+void requestWorkersResponseKeep(ConnectionInfo* ciP, MHD_Response* response)
+{
+  if (ciP->workerContextP->response != NULL)
+  {
+    MHD_destroy_response(response);
+    return;
+  }
+
+  ciP->workerContextP->response     = response;
+  ciP->workerContextP->responseCode = ciP->httpStatusCode;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersReply -
+*/
+void requestWorkersReply(ConnectionInfo* ciP)
+{
+  RequestWorkerContext* ctxP = ciP->workerContextP;
+
+  if (ctxP->response == NULL)
+  {
+    LM_E(("Runtime Error (no response for request served by request worker: %s %s)", ciP->method.c_str(), ciP->url.c_str()));
+    return;
+  }
+
+  MHD_queue_response(ciP->connection, ctxP->responseCode, ctxP->response);
+  MHD_destroy_response(ctxP->response);
+  ctxP->response = NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersRelease -
+*/
+void requestWorkersRelease(ConnectionInfo* ciP)
+{
+  RequestWorkerContext* ctxP = ciP->workerContextP;
+
+  if (ctxP == NULL)
+  {
+    return;
+  }
+
+  // Only in the case the connection was closed before sending the response
+  if (ctxP->response != NULL)
+  {
+    MHD_destroy_response(ctxP->response);
+  }
+
+  delete ctxP;
+  ciP->workerContextP = NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersStatisticsGet -
+*/
+void requestWorkersStatisticsGet(RequestWorkersStatistics* statsP)
+{
+  statsP->workers   = workers;
+  statsP->queueSize = queueSize;
+
+  pthread_mutex_lock(&queueMutex);
+  statsP->queued = requestQueue.size();
+  pthread_mutex_unlock(&queueMutex);
+
+  statsP->served   = __sync_fetch_and_add(&servedRequests, 0);
+  statsP->rejected = __sync_fetch_and_add(&rejectedRequests, 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersStatisticsReset -
+*/
+void requestWorkersStatisticsReset(void)
+{
+  __sync_lock_test_and_set(&servedRequests, 0);
+  __sync_lock_test_and_set(&rejectedRequests, 0);
+}
@@ -0,0 +1,144 @@
+#ifndef SRC_LIB_REST_REQUESTWORKERS_H_
+#define SRC_LIB_REST_REQUESTWORKERS_H_
+
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "rest/ConnectionInfo.h"
+#include "rest/mhd.h"
+
+
+
+/* ****************************************************************************
+*
+* REQUEST_WORKERS_RETRY_AFTER -
+*
+* Value (in seconds) of the Retry-After header in the 503 responses sent when the
+* request queue is full
+*/
+#define REQUEST_WORKERS_RETRY_AFTER  "1"
+
+
+
+/* ****************************************************************************
+*
+* RequestWorkersStatistics -
+*/
+typedef struct RequestWorkersStatistics
+{
+  unsigned int        workers;
+  unsigned int        queueSize;
+  unsigned int        queued;
+  unsigned long long  served;
+  unsigned long long  rejected;
+} RequestWorkersStatistics;
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersInit -
+*
+* With request workers, the MHD threads only do the I/O (reading the requests and
+* writing the responses). Once a request has been completely read, its connection is
+* suspended and the request is queued to be served by one of the workers, that resumes
+* the connection once the response is ready. This way the MHD threads never block on
+* DB operations and a few of them can handle a lot of (keep-alive) connections.
+*
+* A number of workers of zero disables the feature (requests are served in the MHD thread)
+*/
+extern void requestWorkersInit(unsigned int workers, unsigned int queueSize);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersActive -
+*/
+extern bool requestWorkersActive(void);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersDispatch -
+*
+* To be called from the MHD access handler once the request has been completely read.
+* Returns false (and the request is not queued) if the queue is full.
+*/
+extern bool requestWorkersDispatch(ConnectionInfo* ciP);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersResponseKeep -
+*
+* Used by restReply() for requests served by a worker, as responses cannot be queued
+* in a suspended connection. The first response is kept (as MHD_queue_response() would
+* do), any other one is destroyed.
+*/
+extern void requestWorkersResponseKeep(ConnectionInfo* ciP, MHD_Response* response);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersReply -
+*
+* To be called from the MHD access handler when it is invoked again for a request
+* that has been served by a worker (i.e. ciP->workerContextP != NULL), in order to
+* queue the response kept by requestWorkersResponseKeep()
+*/
+extern void requestWorkersReply(ConnectionInfo* ciP);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersRelease -
+*
+* To be called from the MHD request completed callback, once the per thread state of the
+* request has been restored (see rest/requestContext.h). It frees the worker context of
+* the request.
+*/
+extern void requestWorkersRelease(ConnectionInfo* ciP);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersStatisticsGet -
+*/
+extern void requestWorkersStatisticsGet(RequestWorkersStatistics* statsP);
+
+
+
+/* ****************************************************************************
+*
+* requestWorkersStatisticsReset -
+*/
+extern void requestWorkersStatisticsReset(void);
+
+#endif  // SRC_LIB_REST_REQUESTWORKERS_H_
@@ -43,6 +43,7 @@
 #include "common/defaultValues.h"
 #include "common/clockFunctions.h"
 #include "common/statistics.h"
+#include "common/reqTrace.h"
 #include "common/tag.h"
 #include "common/limits.h"                // SERVICE_NAME_MAX_LEN
 
@@ -58,6 +59,9 @@
 #include "rest/uriParamNames.h"
 #include "rest/restServiceLookup.h"
 #include "rest/rest.h"
+#include "rest/requestContext.h"
+#include "rest/requestWorkers.h"
+#include "rest/rateLimit.h"
 
 
 
@@ -84,6 +88,7 @@ __thread char                    clientIp[IP_LENGTH_MAX + 1];
 static unsigned int              connMemory;
 static unsigned int              maxConns;
 static unsigned int              threadPoolSize;
+static bool                      threadsShared         = false;
 static unsigned int              mhdConnectionTimeout  = 0;
 
 
@@ -225,9 +230,14 @@ static int uriArgumentGet(void* cbDataP, MHD_ValueKind kind, const char* ckey, c
       ciP->uriParamTypes.push_back(val);
     }
   }
-  else if ((key != URI_PARAM_Q)       &&
-           (key != URI_PARAM_MQ)      &&
-           (key != URI_PARAM_LEVEL))  // FIXME P1: possible more known options here ...
+  else if ((key != URI_PARAM_Q)             &&
+           (key != URI_PARAM_MQ)            &&
+           (key != URI_PARAM_LEVEL)         &&
+           (key != URI_PARAM_SERVICE)       &&
+           (key != URI_PARAM_SERVICE_PATH)  &&
+           (key != URI_PARAM_CLASS)         &&
+           (key != URI_PARAM_RATE)          &&
+           (key != URI_PARAM_BURST))  // FIXME P1: possible more known options here ...
   {
     LM_T(LmtUriParams, ("Received unrecognized URI parameter: '%s'", key.c_str()));
   }
@@ -509,6 +519,7 @@ static int httpHeaderGet(void* cbDataP, MHD_ValueKind kind, const char* ckey, co
     headerP->accept = value;
     acceptParse(ciP, value);  // Any errors are flagged in ciP->acceptHeaderError and taken care of later
   }
+  else if (strcasecmp(key.c_str(), HTTP_ACCEPT_ENCODING) == 0)   headerP->acceptEncoding = value;
   else if (strcasecmp(key.c_str(), HTTP_EXPECT) == 0)            headerP->expect         = value;
   else if (strcasecmp(key.c_str(), HTTP_CONNECTION) == 0)        headerP->connection     = value;
   else if (strcasecmp(key.c_str(), HTTP_CONTENT_TYPE) == 0)      headerP->contentType    = value;
@@ -556,6 +567,81 @@ static int httpHeaderGet(void* cbDataP, MHD_ValueKind kind, const char* ckey, co
 
 
 
+/* ****************************************************************************
+*
+* payloadAppend - accumulate a chunk of the payload of a request
+*
+* The thread variable "static_buffer" is used if the payload fits in it, unless ownBuffer
+* is set, which is the case when the chunks of several connections are read by the same
+* thread in interleaved fashion (request workers). Otherwise the connection gets a buffer
+* of its own, that grows as needed for requests without Content-Length (chunked).
+*
+* Returns false (and the chunk is dropped) if the payload would exceed PAYLOAD_MAX_SIZE.
+*/
+bool payloadAppend(ConnectionInfo* ciP, const char* data, int dataLen, bool ownBuffer)
+{
+  int needed = ciP->payloadSize + dataLen;
+
+  if (needed > PAYLOAD_MAX_SIZE)
+  {
+    return false;
+  }
+
+  if (ciP->payload == NULL)
+  {
+    int contentLength = ciP->httpHeaders.contentLength;
+
+    if (!ownBuffer && (contentLength <= STATIC_BUFFER_SIZE) && (needed <= STATIC_BUFFER_SIZE))
+    {
+      ciP->payload         = static_buffer;
+      ciP->payloadCapacity = STATIC_BUFFER_SIZE;
+    }
+    else
+    {
+      ciP->payloadCapacity = (contentLength > needed)? contentLength : needed;
+      ciP->payload         = (char*) malloc(ciP->payloadCapacity + 1);
+    }
+  }
+  else if (needed > ciP->payloadCapacity)
+  {
+    int capacity = ciP->payloadCapacity * 2;
+
+    if (capacity < needed)
+    {
+      capacity = needed;
+    }
+
+    if (capacity > PAYLOAD_MAX_SIZE)
+    {
+      capacity = PAYLOAD_MAX_SIZE;
+    }
+
+    if (ciP->payload == static_buffer)
+    {
+      char* payload = (char*) malloc(capacity + 1);
+
+      memcpy(payload, ciP->payload, ciP->payloadSize);
+      ciP->payload = payload;
+    }
+    else
+    {
+      ciP->payload = (char*) realloc(ciP->payload, capacity + 1);
+    }
+
+    ciP->payloadCapacity = capacity;
+  }
+
+  memcpy(&ciP->payload[ciP->payloadSize], data, dataLen);
+
+  // Add to the size of the accumulated read buffer and zero-terminate the payload
+  ciP->payloadSize += dataLen;
+  ciP->payload[ciP->payloadSize] = 0;
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * requestCompleted -
@@ -572,6 +658,13 @@ static void requestCompleted
   std::string      spath    = (ciP->servicePathV.size() > 0)? ciP->servicePathV[0] : "";
   struct timespec  reqEndTime;
 
+  if (ciP->contextP != NULL)
+  {
+    requestContextRestore(ciP->contextP);
+  }
+
+  requestWorkersRelease(ciP);
+
   if ((ciP->payload != NULL) && (ciP->payload != static_buffer))
   {
     free(ciP->payload);
@@ -579,6 +672,7 @@ static void requestCompleted
 
   *con_cls = NULL;
 
+  reqTraceEnd(ciP->httpStatusCode);
   lmTransactionEnd();  // Incoming REST request ends
 
   if (timingStatistics)
@@ -801,6 +895,48 @@ void firstServicePath(const char* servicePath, char* servicePath0, int servicePa
 
 
 
+/* ****************************************************************************
+*
+* rateLimitServicePath -
+*
+* First service path of the request, as servicePathSplit() will get it. Rate limits are
+* checked before the service path is split (and checked).
+*/
+static std::string rateLimitServicePath(ConnectionInfo* ciP)
+{
+  const std::string&  header   = ciP->httpHeaders.servicePath;
+  std::string         path     = header.substr(0, header.find(','));
+  std::string         stripped = wsStrip((char*) path.c_str());
+
+  while ((stripped.size() > 1) && (stripped[stripped.size() - 1] == '/'))
+  {
+    stripped.erase(stripped.size() - 1);
+  }
+
+  return stripped;
+}
+
+
+
+/* ****************************************************************************
+*
+* rateLimitReply -
+*/
+static void rateLimitReply(ConnectionInfo* ciP, int retryAfter)
+{
+  OrionError  oe(SccTooManyRequests, "rate limit exceeded, try again later", "TooManyRequests");
+  char        retryAfterV[STRING_SIZE_FOR_INT];
+
+  snprintf(retryAfterV, sizeof(retryAfterV), "%d", retryAfter);
+
+  ciP->httpStatusCode = oe.code;
+  ciP->httpHeader.push_back(HTTP_RETRY_AFTER);
+  ciP->httpHeaderValue.push_back(retryAfterV);
+  restReply(ciP, oe.smartRender(ciP->apiVersion));
+}
+
+
+
 /* ****************************************************************************
 *
 * isOriginAllowedForCORS - checks the Origin header of the request and returns
@@ -1136,9 +1272,8 @@ RestService restServiceForBadVerb;
 
 /* ****************************************************************************
 *
-* connectionTreat -
+* connectionCallTreat -
 *
-* This is the MHD_AccessHandlerCallback function for MHD_start_daemon
 * This function returns:
 * o MHD_YES  if the connection was handled successfully
 * o MHD_NO   if the socket must be closed due to a serious error
@@ -1154,7 +1289,7 @@ RestService restServiceForBadVerb;
 * Call 3: *con_cls != NULL  AND  *upload_data_size == 0
 */
 static int reqNo       = 1;
-static int connectionTreat
+static int connectionCallTreat
 (
    void*            cls,
    MHD_Connection*  connection,
@@ -1227,6 +1362,8 @@ static int connectionTreat
       memset(&threadLastTimeStat, 0, sizeof(threadLastTimeStat));
     }
 
+    reqTraceStart();
+
 
     //
     // ConnectionInfo
@@ -1245,6 +1382,11 @@ static int connectionTreat
       return MHD_NO;
     }
 
+    if (threadsShared)
+    {
+      ciP->contextP = new RequestContext();
+    }
+
 
     // Get API version
     // FIXME #3109-PR: this assignment will be removed in a subsequent PR, where the function apiVersionGet() is used instead
@@ -1357,6 +1499,17 @@ static int connectionTreat
 
     MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND, uriArgumentGet, ciP);
 
+    //
+    // Rate limits are checked as soon as the service headers are known, so the payload
+    // of a rejected request is not received (MHD discards it once the response is queued)
+    //
+    int retryAfter = 0;
+
+    if (!rateLimitAdmit(ciP, rateLimitServicePath(ciP), &retryAfter))
+    {
+      rateLimitReply(ciP, retryAfter);
+    }
+
     return MHD_YES;
   }
 
@@ -1382,49 +1535,54 @@ static int connectionTreat
     // See github issue:
     //   https://github.com/telefonicaid/fiware-orion/issues/2761
     //
-    if (ciP->httpHeaders.contentLength > PAYLOAD_MAX_SIZE)
+    if ((ciP->httpHeaders.contentLength > PAYLOAD_MAX_SIZE) || (ciP->httpStatusCode == SccTooManyRequests))
     {
       //
-      // Errors can't be returned yet, postpone ...
+      // Errors can't be returned yet, postpone ... (or the request has already been
+      // rejected by a rate limit)
       //
       *upload_data_size = 0;
       return MHD_YES;
     }
 
     //
-    // First call with payload - use the thread variable "static_buffer" if possible,
-    // otherwise allocate a bigger buffer
+    // Copy the chunk. With request workers, a single MHD thread reads the chunks of many
+    // connections, so the thread variable "static_buffer" cannot be used
     //
-    // FIXME P1: This could be done in "Part I" instead, saving an "if" for each "Part II" call
-    //           Once we *really* look to scratch some efficiency, this change should be made.
-    //
-    if (ciP->payloadSize == 0)  // First call with payload
+    LM_T(LmtPartialPayload, ("Got %d of payload of %d bytes", dataLen, ciP->httpHeaders.contentLength));
+
+    if (!payloadAppend(ciP, upload_data, (int) dataLen, requestWorkersActive()))
     {
-      if (ciP->httpHeaders.contentLength > STATIC_BUFFER_SIZE)
-      {
-        ciP->payload = (char*) malloc(ciP->httpHeaders.contentLength + 1);
-      }
-      else
+      //
+      // Request without Content-Length (chunked) bigger than PAYLOAD_MAX_SIZE: the rest of
+      // it is "eaten" and the size recorded, so the request is answered with 413 (see part 3)
+      //
+      if (ciP->httpHeaders.contentLength <= PAYLOAD_MAX_SIZE)
       {
-        ciP->payload = static_buffer;
+        ciP->httpHeaders.contentLength = PAYLOAD_MAX_SIZE + 1;
       }
     }
 
-    // Copy the chunk
-    LM_T(LmtPartialPayload, ("Got %d of payload of %d bytes", dataLen, ciP->httpHeaders.contentLength));
-    memcpy(&ciP->payload[ciP->payloadSize], upload_data, dataLen);
-
-    // Add to the size of the accumulated read buffer
-    ciP->payloadSize += *upload_data_size;
-
-    // Zero-terminate the payload
-    ciP->payload[ciP->payloadSize] = 0;
-
     // Acknowledge the data and return
     *upload_data_size = 0;
     return MHD_YES;
   }
 
+  //
+  // 3-0. Request already answered: rejected by a rate limit in the first call, or second
+  //      time here for a request served by a request worker (the response is ready)
+  //
+  if (ciP->httpStatusCode == SccTooManyRequests)
+  {
+    return MHD_YES;
+  }
+
+  if (ciP->workerContextP != NULL)
+  {
+    requestWorkersReply(ciP);
+    return MHD_YES;
+  }
+
   //
   // 3. Finally, serve the request (unless an error has occurred)
   //
@@ -1558,14 +1716,17 @@ static int connectionTreat
 
 
   //
-  // Requests of verb POST, PUT or PATCH are considered erroneous if no payload is present - with two exceptions.
+  // Requests of verb POST, PUT or PATCH are considered erroneous if no payload is present - with three exceptions.
   //
   // - Old log requests  (URL contains '/log/')
   // - New log requests  (URL is exactly '/admin/log')
+  // - Rate limit requests (URL is exactly '/admin/rateLimits')
   //
   if (((ciP->verb == POST) || (ciP->verb == PUT) || (ciP->verb == PATCH )) &&
       (ciP->httpHeaders.contentLength == 0) &&
-      ((strncasecmp(ciP->url.c_str(), "/log/", 5) != 0) && (strncasecmp(ciP->url.c_str(), "/admin/log", 10) != 0)))
+      ((strncasecmp(ciP->url.c_str(), "/log/", 5) != 0) &&
+       (strncasecmp(ciP->url.c_str(), "/admin/log", 10) != 0) &&
+       (strcmp(ciP->url.c_str(), "/admin/rateLimits") != 0)))
   {
     std::string errorMsg;
 
@@ -1579,16 +1740,73 @@ static int connectionTreat
     alarmMgr.badInput(clientIp, ciP->answer);
     restReply(ciP, ciP->answer);
   }
-  else
+  else if (!requestWorkersActive())
   {
     orion::requestServe(ciP);
   }
+  else if (!requestWorkersDispatch(ciP))
+  {
+    OrionError oe(SccServiceUnavailable, "too many requests waiting to be served, try again later", "ServiceUnavailable");
+
+    ciP->httpStatusCode = oe.code;
+    ciP->httpHeader.push_back(HTTP_RETRY_AFTER);
+    ciP->httpHeaderValue.push_back(REQUEST_WORKERS_RETRY_AFTER);
+    alarmMgr.badInput(clientIp, oe.details);
+    restReply(ciP, oe.smartRender(ciP->apiVersion));
+  }
 
   return MHD_YES;
 }
 
 
 
+/* ****************************************************************************
+*
+* connectionTreat -
+*
+* This is the MHD_AccessHandlerCallback function for MHD_start_daemon
+*
+* When the MHD threads are shared by many connections, the calls of different requests
+* are interleaved in the same thread, so the per thread state of the request is restored
+* from its ConnectionInfo before each call and saved after it.
+*/
+static int connectionTreat
+(
+   void*            cls,
+   MHD_Connection*  connection,
+   const char*      url,
+   const char*      method,
+   const char*      version,
+   const char*      upload_data,
+   size_t*          upload_data_size,
+   void**           con_cls
+)
+{
+  ConnectionInfo* ciP = (ConnectionInfo*) *con_cls;
+
+  if ((ciP != NULL) && (ciP->contextP != NULL))
+  {
+    requestContextRestore(ciP->contextP);
+  }
+
+  int r = connectionCallTreat(cls, connection, url, method, version, upload_data, upload_data_size, con_cls);
+
+  //
+  // In the first call, the ConnectionInfo has just been created. Once the request has
+  // been dispatched to a request worker, its state belongs to the worker
+  //
+  ciP = (ConnectionInfo*) *con_cls;
+
+  if ((ciP != NULL) && (ciP->contextP != NULL) && (ciP->workerContextP == NULL))
+  {
+    requestContextSave(ciP->contextP);
+  }
+
+  return r;
+}
+
+
+
 /* ****************************************************************************
 *
 * restStart -
@@ -1638,6 +1856,23 @@ static int restStart(IpVersion ipVersion, const char* httpsKey = NULL, const cha
 #endif
   }
 
+  //
+  // With request workers, connections are suspended while their request is served, so
+  // the MHD threads are used only for I/O. That needs the epoll internal mode, with a
+  // single thread if no pool size has been given
+  //
+  if (requestWorkersActive())
+  {
+#if defined(MHD_USE_EPOLL) || MHD_VERSION >= 0x00095100
+    serverMode = MHD_USE_SELECT_INTERNALLY | MHD_USE_EPOLL | MHD_USE_SUSPEND_RESUME;
+#else
+    serverMode = MHD_USE_SELECT_INTERNALLY | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_SUSPEND_RESUME;
+#endif
+  }
+
+  // With a thread pool or request workers, the MHD threads are shared by many connections
+  threadsShared = ((serverMode & MHD_USE_THREAD_PER_CONNECTION) == 0);
+
 
   if ((ipVersion == IPV4) || (ipVersion == IPDUAL))
   {
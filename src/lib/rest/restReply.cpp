@@ -53,6 +53,8 @@
 #include "rest/mhd.h"
 #include "rest/OrionError.h"
 #include "rest/restReply.h"
+#include "rest/requestWorkers.h"
+#include "rest/compression.h"
 
 #include "logMsg/traceLevels.h"
 
@@ -66,16 +68,38 @@ static int replyIx = 0;
 */
 void restReply(ConnectionInfo* ciP, const std::string& answer)
 {
-  MHD_Response*  response;
+  MHD_Response*    response;
 
-  uint64_t       answerLen = answer.length();
-  std::string    spath     = (ciP->servicePathV.size() > 0)? ciP->servicePathV[0] : "";
+  uint64_t         answerLen = answer.length();
+  std::string      spath     = (ciP->servicePathV.size() > 0)? ciP->servicePathV[0] : "";
+  bool             negotiate = compressionActive() && (answerLen >= compressionMinSizeGet());
+  ContentEncoding  encoding  = CeIdentity;
+  std::string      compressed;
 
   ++replyIx;
   LM_T(LmtServiceOutPayload, ("Response %d: responding with %d bytes, Status Code %d", replyIx, answerLen, ciP->httpStatusCode));
   LM_T(LmtServiceOutPayload, ("Response payload: '%s'", answer.c_str()));
 
-  response = MHD_create_response_from_buffer(answerLen, (void*) answer.c_str(), MHD_RESPMEM_MUST_COPY);
+  if (negotiate && (ciP->httpHeaders.acceptEncoding != ""))
+  {
+    encoding = contentEncodingNegotiate(ciP->httpHeaders.acceptEncoding);
+
+    if (!compressPayload(encoding, answer.c_str(), answerLen, &compressed, false))
+    {
+      encoding = CeIdentity;
+    }
+  }
+
+  if (encoding != CeIdentity)
+  {
+    answerLen = compressed.length();
+    response  = MHD_create_response_from_buffer(answerLen, (void*) compressed.c_str(), MHD_RESPMEM_MUST_COPY);
+  }
+  else
+  {
+    response = MHD_create_response_from_buffer(answerLen, (void*) answer.c_str(), MHD_RESPMEM_MUST_COPY);
+  }
+
   if (!response)
   {
     metricsMgr.add(ciP->httpHeaders.tenant, spath, METRIC_TRANS_IN_ERRORS, 1);
@@ -93,6 +117,17 @@ void restReply(ConnectionInfo* ciP, const std::string& answer)
     MHD_add_response_header(response, ciP->httpHeader[hIx].c_str(), ciP->httpHeaderValue[hIx].c_str());
   }
 
+  // The response depends on Accept-Encoding only if it was big enough to be compressed
+  if (negotiate)
+  {
+    MHD_add_response_header(response, HTTP_VARY, HTTP_ACCEPT_ENCODING);
+  }
+
+  if (encoding != CeIdentity)
+  {
+    MHD_add_response_header(response, HTTP_CONTENT_ENCODING, contentEncodingName(encoding));
+  }
+
   if (answer != "")
   {
     if (ciP->outMimeType == JSON)
@@ -148,6 +183,13 @@ void restReply(ConnectionInfo* ciP, const std::string& answer)
     }
   }
 
+  // A connection waiting for a request worker is suspended, so its response is queued later
+  if (ciP->workerContextP != NULL)
+  {
+    requestWorkersResponseKeep(ciP, response);
+    return;
+  }
+
   MHD_queue_response(ciP->connection, ciP->httpStatusCode, response);
   MHD_destroy_response(response);
 }
@@ -36,6 +36,7 @@
 #define URI_PARAM_PAGINATION_OFFSET       "offset"
 #define URI_PARAM_PAGINATION_LIMIT        "limit"
 #define URI_PARAM_PAGINATION_DETAILS      "details"
+#define URI_PARAM_CURSOR                  "cursor"
 #define URI_PARAM_COLLAPSE                "collapse"
 #define URI_PARAM_ENTITY_TYPE             SCOPE_VALUE_ENTITY_TYPE
 #define URI_PARAM_NOT_EXIST               "!exist"
@@ -53,6 +54,11 @@
 
 // URI parameters for 'admin' requests
 #define URI_PARAM_LEVEL                   "level"
+#define URI_PARAM_SERVICE                 "service"
+#define URI_PARAM_SERVICE_PATH            "servicePath"
+#define URI_PARAM_CLASS                   "class"
+#define URI_PARAM_RATE                    "rate"
+#define URI_PARAM_BURST                   "burst"
 
 
 
@@ -280,6 +280,8 @@ std::string postQueryContext
   QueryContextResponseVector  responseV;
   long long                   count = 0;
   long long*                  countP = NULL;
+  std::string                 nextCursor;
+  std::string*                nextCursorP = NULL;
 
   bool asJsonObject = (ciP->uriParam[URI_PARAM_ATTRIBUTE_FORMAT] == "object" && ciP->outMimeType == JSON);
 
@@ -301,6 +303,30 @@ std::string postQueryContext
     countP = &count;
   }
 
+  //
+  // Keyset pagination (only for GET /v2/entities, the service routine takes care of
+  // checking the URI params). The cursor for the next page is returned in the HTTP header
+  // Fiware-Next-Cursor.
+  //
+  if ((ciP->apiVersion == V2) && (ciP->verb == GET) && (ciP->uriParamOptions[OPT_CURSOR]))
+  {
+    nextCursorP = &nextCursor;
+  }
+
+  //
+  // GET /v2/entities responses may be rendered directly from the entity documents in the DB,
+  // skipping the object model (see entityDocToJson()). Entity::render() uses that rendering
+  // if present
+  //
+  EntityJsonRender   jsonRender;
+  EntityJsonRender*  jsonRenderP = NULL;
+
+  if ((ciP->apiVersion == V2) && (ciP->verb == GET) && (ciP->requestType == EntitiesRequest) &&
+      entityJsonRenderSetup(ciP->uriParamOptions, ciP->uriParam, &jsonRender))
+  {
+    jsonRenderP = &jsonRender;
+  }
+
 
 
   //
@@ -315,7 +341,9 @@ std::string postQueryContext
                                                       ciP->uriParam,
                                                       ciP->uriParamOptions,
                                                       countP,
-                                                      ciP->apiVersion));
+                                                      ciP->apiVersion,
+                                                      nextCursorP,
+                                                      jsonRenderP));
 
   if (qcrsP->errorCode.code == SccBadRequest)
   {
@@ -340,6 +368,12 @@ std::string postQueryContext
     ciP->httpHeaderValue.push_back(cV);
   }
 
+  if (nextCursor != "")
+  {
+    ciP->httpHeader.push_back(HTTP_FIWARE_NEXT_CURSOR);
+    ciP->httpHeaderValue.push_back(nextCursor);
+  }
+
 
 
   //
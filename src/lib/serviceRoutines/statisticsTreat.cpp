@@ -37,10 +37,15 @@
 #include "ngsi/ParseData.h"
 #include "rest/ConnectionInfo.h"
 #include "rest/rest.h"
+#include "rest/requestWorkers.h"
+#include "rest/compression.h"
 #include "serviceRoutines/statisticsTreat.h"
 #include "mongoBackend/mongoConnectionPool.h"
 #include "cache/subCache.h"
+#include "cache/entityCache.h"
 #include "ngsiNotify/QueueStatistics.h"
+#include "ngsiNotify/destinationHealth.h"
+#include "ngsiNotify/notificationSpool.h"
 #include "common/JsonHelper.h"
 
 
@@ -134,6 +139,10 @@ static void resetStatistics(void)
   noOfRegistrationsRequest                        = -1;
 
   QueueStatistics::reset();
+  destinationHealthReset();
+  notifSpoolStatisticsReset();
+  requestWorkersStatisticsReset();
+  compressionStatisticsReset();
 
   semTimeReqReset();
   semTimeTransReset();
@@ -280,6 +289,94 @@ std::string renderNotifQueueStats(void)
   jh.addNumber ("avgTimeInQueue", out==0 ? 0.0f : (timeInQ/out));
   jh.addNumber("size",           (long long)QueueStatistics::getQSize());
 
+  if (QueueStatistics::tenantsEnabled())
+  {
+    std::map<std::string, QueueTenantCounters>  tenants;
+    JsonHelper                                  tenantsJh;
+
+    QueueStatistics::getTenants(&tenants);
+
+    for (std::map<std::string, QueueTenantCounters>::const_iterator it = tenants.begin(); it != tenants.end(); ++it)
+    {
+      JsonHelper tenantJh;
+
+      tenantJh.addNumber("in",     it->second.in);
+      tenantJh.addNumber("out",    it->second.out);
+      tenantJh.addNumber("reject", it->second.reject);
+
+      tenantsJh.addRaw(it->first, tenantJh.str());
+    }
+
+    jh.addRaw("tenants", tenantsJh.str());
+  }
+
+  if (notifSpoolEnabled())
+  {
+    NotifSpoolStatistics  spool;
+    JsonHelper            spoolJh;
+
+    notifSpoolStatisticsGet(&spool);
+
+    spoolJh.addNumber("in",       spool.in);
+    spoolJh.addNumber("out",      spool.out);
+    spoolJh.addNumber("reject",   spool.reject);
+    spoolJh.addNumber("pending",  spool.pending);
+    spoolJh.addNumber("segments", (long long) spool.segments);
+
+    jh.addRaw("spool", spoolJh.str());
+  }
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* renderRequestWorkersStats -
+*/
+static std::string renderRequestWorkersStats(void)
+{
+  JsonHelper                jh;
+  RequestWorkersStatistics  rws;
+
+  requestWorkersStatisticsGet(&rws);
+
+  jh.addNumber("workers",   (long long) rws.workers);
+  jh.addNumber("queueSize", (long long) rws.queueSize);
+  jh.addNumber("queued",    (long long) rws.queued);
+  jh.addNumber("served",    (long long) rws.served);
+  jh.addNumber("rejected",  (long long) rws.rejected);
+
+  return jh.str();
+}
+
+
+
+/* ****************************************************************************
+*
+* renderCompressionStats -
+*/
+static std::string renderCompressionStats(void)
+{
+  JsonHelper             jh;
+  JsonHelper             responsesJh;
+  JsonHelper             notificationsJh;
+  CompressionStatistics  cs;
+
+  compressionStatisticsGet(&cs);
+
+  responsesJh.addNumber("count",             (long long) cs.responses);
+  responsesJh.addNumber("uncompressedBytes", (long long) cs.responsesUncompressedBytes);
+  responsesJh.addNumber("compressedBytes",   (long long) cs.responsesCompressedBytes);
+
+  notificationsJh.addNumber("count",             (long long) cs.notifications);
+  notificationsJh.addNumber("uncompressedBytes", (long long) cs.notificationsUncompressedBytes);
+  notificationsJh.addNumber("compressedBytes",   (long long) cs.notificationsCompressedBytes);
+
+  jh.addRaw("responses",     responsesJh.str());
+  jh.addRaw("notifications", notificationsJh.str());
+
   return jh.str();
 }
 
@@ -325,6 +422,18 @@ std::string statisticsTreat
   {
     js.addRaw("notifQueue", renderNotifQueueStats());
   }
+  if (destinationHealthActive())
+  {
+    js.addRaw("notifDestinations", destinationHealthRender());
+  }
+  if (requestWorkersActive())
+  {
+    js.addRaw("requestWorkers", renderRequestWorkersStats());
+  }
+  if (compressionActive() || notifCompressionActive())
+  {
+    js.addRaw("compression", renderCompressionStats());
+  }
 
   // Unconditional stats
   int now = getCurrentTime();
@@ -360,6 +469,7 @@ std::string statisticsCacheTreat
   if (ciP->method == "DELETE")
   {
     subCacheStatisticsReset("statisticsTreat::DELETE");
+    entityCacheStatisticsReset();
     js.addString("message", "All statistics counter reset");
     return js.str();
   }
@@ -385,6 +495,55 @@ std::string statisticsCacheTreat
   js.addNumber("updates", (long long)mscUpdates);
   js.addNumber("items", (long long)cacheItems);
 
+  //
+  // subscription cache load (only when loaded in parallel)
+  //
+  SubCacheLoadStatistics  scls;
+
+  subCacheLoadStatisticsGet(&scls);
+
+  if (scls.loaders > 1)
+  {
+    JsonHelper  jsLoad;
+    JsonHelper  jsLoadTimes;
+
+    for (unsigned int ix = 0; ix < scls.loadTimes.size(); ++ix)
+    {
+      jsLoadTimes.addNumber(scls.loadTimes[ix].first, scls.loadTimes[ix].second);
+    }
+
+    jsLoad.addNumber("loaders",           (long long) scls.loaders);
+    jsLoad.addNumber("databases",         (long long) scls.databases);
+    jsLoad.addNumber("loaded",            (long long) scls.loaded);
+    jsLoad.addNumber("duration",          scls.duration);
+    jsLoad.addRaw("databasesLoadTime",    jsLoadTimes.str());
+
+    js.addRaw("load", jsLoad.str());
+  }
+
+  //
+  // entity cache counters
+  //
+  if (entityCacheActive())
+  {
+    EntityCacheStatistics  ecs;
+    JsonHelper             jsEntities;
+
+    entityCacheStatisticsGet(&ecs);
+
+    jsEntities.addNumber("hits",          (long long) ecs.hits);
+    jsEntities.addNumber("misses",        (long long) ecs.misses);
+    jsEntities.addNumber("inserts",       (long long) ecs.inserts);
+    jsEntities.addNumber("updates",       (long long) ecs.updates);
+    jsEntities.addNumber("invalidations", (long long) ecs.invalidations);
+    jsEntities.addNumber("evictions",     (long long) ecs.evictions);
+    jsEntities.addNumber("expirations",   (long long) ecs.expirations);
+    jsEntities.addNumber("items",         (long long) ecs.items);
+    jsEntities.addNumber("size",          (long long) ecs.size);
+
+    js.addRaw("entities", jsEntities.str());
+  }
+
   ciP->httpStatusCode = SccOk;
   return js.str();
 }
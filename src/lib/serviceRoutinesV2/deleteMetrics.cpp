@@ -34,6 +34,7 @@
 #include "rest/ConnectionInfo.h"
 #include "rest/OrionError.h"
 #include "rest/rest.h"
+#include "rest/rateLimit.h"
 #include "serviceRoutinesV2/deleteMetrics.h"
 
 
@@ -59,6 +60,7 @@ std::string deleteMetrics
     return oe.toJson();
   }
 
+  rateLimitMetricsPublish();
   metricsMgr.reset();
 
   ciP->httpStatusCode = SccNoContent;
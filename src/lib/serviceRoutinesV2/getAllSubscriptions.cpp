@@ -29,6 +29,7 @@
 #include "common/clockFunctions.h"
 #include "common/JsonHelper.h"
 #include "common/string.h"
+#include "common/errorMessages.h"
 #include "apiTypesV2/Subscription.h"
 #include "mongoBackend/mongoGetSubscriptions.h"
 #include "ngsi/ParseData.h"
@@ -57,10 +58,33 @@ std::string getAllSubscriptions
 {
   std::vector<ngsiv2::Subscription> subs;
   OrionError                        oe;
-  long long                         count  = 0;
-  int                               offset = atoi(ciP->uriParam[URI_PARAM_PAGINATION_OFFSET].c_str());
-  int                               limit  = atoi(ciP->uriParam[URI_PARAM_PAGINATION_LIMIT].c_str());
+  long long                         count       = 0;
+  int                               offset      = atoi(ciP->uriParam[URI_PARAM_PAGINATION_OFFSET].c_str());
+  int                               limit       = atoi(ciP->uriParam[URI_PARAM_PAGINATION_LIMIT].c_str());
+  std::string                       nextCursor;
+  std::string*                      nextCursorP = NULL;
 
+  //
+  // Keyset pagination: 'cursor' URI param (next pages) or 'options=cursor' (first page)
+  //
+  if ((ciP->uriParam[URI_PARAM_CURSOR] != "") || (ciP->uriParamOptions[OPT_CURSOR]))
+  {
+    if (ciP->uriParam[URI_PARAM_PAGINATION_OFFSET] != DEFAULT_PAGINATION_OFFSET)
+    {
+      std::string out;
+
+      oe = OrionError(SccBadRequest, ERROR_DESC_BAD_REQUEST_CURSOR_NOT_ALLOWED, ERROR_BAD_REQUEST);
+
+      TIMED_RENDER(out = oe.toJson());
+      ciP->httpStatusCode = oe.code;
+
+      return out;
+    }
+
+    nextCursorP = &nextCursor;
+  }
+
+  // The count is only done if asked for, as it means an additional query to the DB
   TIMED_MONGO(mongoListSubscriptions(&subs,
                                      &oe,
                                      ciP->uriParam,
@@ -68,7 +92,8 @@ std::string getAllSubscriptions
                                      ciP->servicePathV[0],
                                      limit,
                                      offset,
-                                     &count));
+                                     ciP->uriParamOptions[OPT_COUNT]? &count : NULL,
+                                     nextCursorP));
 
   if (oe.code != SccOk)
   {
@@ -86,6 +111,12 @@ std::string getAllSubscriptions
     ciP->httpHeaderValue.push_back(double2string(count));
   }
 
+  if (nextCursor != "")
+  {
+    ciP->httpHeader.push_back(HTTP_FIWARE_NEXT_CURSOR);
+    ciP->httpHeaderValue.push_back(nextCursor);
+  }
+
   std::string out;
   TIMED_RENDER(out = vectorToJson(subs));
 
@@ -28,6 +28,7 @@
 #include "common/statistics.h"
 #include "common/clockFunctions.h"
 #include "common/string.h"
+#include "common/errorMessages.h"
 
 #include "rest/ConnectionInfo.h"
 #include "rest/OrionError.h"
@@ -35,6 +36,7 @@
 #include "rest/EntityTypeInfo.h"
 #include "ngsi/ParseData.h"
 #include "apiTypesV2/Entities.h"
+#include "mongoBackend/pageCursor.h"
 #include "serviceRoutinesV2/getEntities.h"
 #include "serviceRoutines/postQueryContext.h"
 #include "alarmMgr/alarmMgr.h"
@@ -53,6 +55,7 @@
 * URI parameters:
 *   - limit=NUMBER
 *   - offset=NUMBER
+*   - cursor=TOKEN
 *   - count=true/false
 *   - id
 *   - idPattern
@@ -63,7 +66,7 @@
 *   - georel
 *   - attrs
 *   - metadata
-*   - options=keyValues
+*   - options=keyValues,cursor
 *   - type=TYPE
 *   - type=TYPE1,TYPE2,...TYPEN
 *
@@ -140,6 +143,36 @@ std::string getEntities
     return answer;
   }
 
+  //
+  // Keyset pagination: 'cursor' URI param (next pages) or 'options=cursor' (first page).
+  // It cannot be combined with offset or orderBy, as the pages are ranges in creation order.
+  //
+  if ((ciP->uriParam[URI_PARAM_CURSOR] != "") || (ciP->uriParamOptions[OPT_CURSOR]))
+  {
+    mongo::BSONObj  cursorKey;
+
+    if ((ciP->uriParam[URI_PARAM_PAGINATION_OFFSET] != DEFAULT_PAGINATION_OFFSET) || (ciP->uriParam[URI_PARAM_SORTED] != ""))
+    {
+      OrionError oe(SccBadRequest, ERROR_DESC_BAD_REQUEST_CURSOR_NOT_ALLOWED, ERROR_BAD_REQUEST);
+
+      TIMED_RENDER(out = oe.toJson());
+      ciP->httpStatusCode = oe.code;
+      return out;
+    }
+
+    if ((ciP->uriParam[URI_PARAM_CURSOR] != "") &&
+        (!pageCursorDecode(ciP->uriParam[URI_PARAM_CURSOR], &cursorKey) || !cursorKey.hasField("c") || !cursorKey.hasField("i")))
+    {
+      OrionError oe(SccBadRequest, ERROR_DESC_BAD_REQUEST_INVALID_CURSOR, ERROR_BAD_REQUEST);
+
+      TIMED_RENDER(out = oe.toJson());
+      ciP->httpStatusCode = oe.code;
+      return out;
+    }
+
+    ciP->uriParamOptions[OPT_CURSOR] = true;
+  }
+
   //
   // Making sure geometry, georel and coords are not used individually
   //
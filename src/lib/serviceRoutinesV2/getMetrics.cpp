@@ -33,6 +33,7 @@
 #include "rest/ConnectionInfo.h"
 #include "rest/OrionError.h"
 #include "rest/rest.h"
+#include "rest/rateLimit.h"
 #include "metricsMgr/metricsMgr.h"
 #include "serviceRoutinesV2/getMetrics.h"
 
@@ -63,6 +64,8 @@ std::string getMetrics
     return oe.toJson();
   }
 
+  rateLimitMetricsPublish();
+
   bool         doReset  = (ciP->uriParam["reset"] == "true")? true : false;
   std::string  payload  = metricsMgr.toJson(doReset);
 
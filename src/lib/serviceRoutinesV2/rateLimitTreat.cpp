@@ -0,0 +1,227 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/string.h"
+#include "ngsi/ParseData.h"
+#include "rest/ConnectionInfo.h"
+#include "rest/OrionError.h"
+#include "rest/rateLimit.h"
+#include "rest/uriParamNames.h"
+#include "serviceRoutinesV2/rateLimitTreat.h"
+#include "alarmMgr/alarmMgr.h"
+
+
+
+/* ****************************************************************************
+*
+* rateLimitKeyGet -
+*
+* Gets (and checks) the URI parameters that identify a limit: service (mandatory),
+* servicePath and class
+*/
+static bool rateLimitKeyGet
+(
+  ConnectionInfo*  ciP,
+  std::string*     serviceP,
+  std::string*     servicePathP,
+  RateLimitClass*  rlClassP,
+  std::string*     detailsP
+)
+{
+  std::string service = ciP->uriParam[URI_PARAM_SERVICE];
+
+  if (service == "")
+  {
+    *detailsP = "service missing";
+    return false;
+  }
+
+  if (service != "*")
+  {
+    for (unsigned int ix = 0; ix < service.size(); ++ix)
+    {
+      if (!isalnum(service[ix]) && (service[ix] != '_'))
+      {
+        *detailsP = "bad character in service";
+        return false;
+      }
+
+      service[ix] = tolower(service[ix]);
+    }
+  }
+
+  *serviceP     = service;
+  *servicePathP = ciP->uriParam[URI_PARAM_SERVICE_PATH];
+  *rlClassP     = rateLimitClassParse(ciP->uriParam[URI_PARAM_CLASS]);
+
+  if ((*servicePathP != "") && ((*servicePathP)[0] != '/'))
+  {
+    *detailsP = "servicePath must start with /";
+    return false;
+  }
+
+  if (*rlClassP == RlcNone)
+  {
+    *detailsP = "class must be read, write or batch";
+    return false;
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* getRateLimits -
+*
+* GET /admin/rateLimits
+*/
+std::string getRateLimits
+(
+  ConnectionInfo*            ciP,
+  int                        components,
+  std::vector<std::string>&  compV,
+  ParseData*                 parseDataP
+)
+{
+  return rateLimitsToJson();
+}
+
+
+
+/* ****************************************************************************
+*
+* putRateLimit -
+*
+* PUT /admin/rateLimits
+*
+* URI parameters:
+*   - service (mandatory, '*' for every service)
+*   - servicePath
+*   - class (read, write or batch)
+*   - rate (mandatory, requests per second)
+*   - burst
+*/
+std::string putRateLimit
+(
+  ConnectionInfo*            ciP,
+  int                        components,
+  std::vector<std::string>&  compV,
+  ParseData*                 parseDataP
+)
+{
+  std::string     service;
+  std::string     servicePath;
+  RateLimitClass  rlClass;
+  std::string     details;
+  double          rate  = 0;
+  int             burst = 0;
+  std::string     burstString = ciP->uriParam[URI_PARAM_BURST];
+
+  bool ok = rateLimitKeyGet(ciP, &service, &servicePath, &rlClass, &details);
+
+  if (ok && (!str2double(ciP->uriParam[URI_PARAM_RATE].c_str(), &rate) || (rate <= 0)))
+  {
+    details = "rate must be a positive number";
+    ok      = false;
+  }
+
+  if (ok && (burstString != "") && (!isdigit(burstString[0]) || ((burst = atoi(burstString.c_str())) <= 0)))
+  {
+    details = "burst must be a positive integer";
+    ok      = false;
+  }
+
+  if (ok && rateLimitSet(service, servicePath, rlClass, rate, burst, &details))
+  {
+    ciP->httpStatusCode = SccNoContent;
+    return "";
+  }
+
+  OrionError oe(SccBadRequest, details);
+
+  ciP->httpStatusCode = SccBadRequest;
+  alarmMgr.badInput(clientIp, details);
+
+  return oe.toJson();
+}
+
+
+
+/* ****************************************************************************
+*
+* deleteRateLimit -
+*
+* DELETE /admin/rateLimits
+*
+* URI parameters:
+*   - service (mandatory)
+*   - servicePath
+*   - class
+*/
+std::string deleteRateLimit
+(
+  ConnectionInfo*            ciP,
+  int                        components,
+  std::vector<std::string>&  compV,
+  ParseData*                 parseDataP
+)
+{
+  std::string     service;
+  std::string     servicePath;
+  RateLimitClass  rlClass;
+  std::string     details;
+
+  if (!rateLimitKeyGet(ciP, &service, &servicePath, &rlClass, &details))
+  {
+    OrionError oe(SccBadRequest, details);
+
+    ciP->httpStatusCode = SccBadRequest;
+    alarmMgr.badInput(clientIp, details);
+
+    return oe.toJson();
+  }
+
+  if (!rateLimitRemove(service, servicePath, rlClass))
+  {
+    OrionError oe(SccContextElementNotFound, "No rate limit found", "NotFound");
+
+    ciP->httpStatusCode = SccContextElementNotFound;
+
+    return oe.toJson();
+  }
+
+  ciP->httpStatusCode = SccNoContent;
+  return "";
+}
@@ -0,0 +1,288 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/mongoRegisterContext.h"
+#include "ngsi/ContextRegistration.h"
+#include "ngsi/ContextRegistrationAttribute.h"
+#include "ngsi/EntityId.h"
+#include "ngsi9/RegisterContextRequest.h"
+#include "ngsi9/RegisterContextResponse.h"
+#include "ngsi9/NotifyContextAvailabilityRequest.h"
+#include "cache/casubCache.h"
+
+#include "unittests/testInit.h"
+#include "unittests/commonMocks.h"
+#include "unittests/unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::DBClientBase;
+using mongo::BSONObj;
+using mongo::BSONArray;
+using mongo::OID;
+using ::testing::_;
+using ::testing::Invoke;
+
+
+
+/* ****************************************************************************
+*
+* CasubRegistration - the entities (type T1 if not given) and attributes of a registration
+*/
+typedef struct CasubRegistration
+{
+  const char* ids[3];
+  const char* type;
+  const char* attrs[3];
+} CasubRegistration;
+
+
+
+/* ****************************************************************************
+*
+* registrations -
+*/
+static const CasubRegistration registrations[] =
+{
+  { { "E1", NULL },        "T1", { NULL } },
+  { { "E1", NULL },        "T1", { "A1", NULL } },
+  { { "E1", NULL },        "T1", { "A2", NULL } },
+  { { "E2", NULL },        "T1", { "A3", NULL } },
+  { { "E1", NULL },        "T2", { NULL } },
+  { { "E1", "E2", NULL },  "T1", { "A9", NULL } },
+  { { "F1", NULL },        "T1", { "A1", NULL } },
+  { { "X", NULL },         "T1", { NULL } }
+};
+
+
+
+/* ****************************************************************************
+*
+* notified - "<subscriptionId> <reference>" of each notification sent
+*/
+static std::vector<std::string> notified;
+
+static void notificationCollect
+(
+  NotifyContextAvailabilityRequest*  ncar,
+  const std::string&                 url,
+  const std::string&                 tenant,
+  const std::string&                 fiwareCorrelator,
+  RenderFormat                       renderFormat
+)
+{
+  notified.push_back(ncar->subscriptionId.get() + " " + url);
+}
+
+
+
+/* ****************************************************************************
+*
+* casub -
+*/
+static BSONObj casub(const char* oid, long long expiration, const BSONObj& entity, const BSONArray& attrs)
+{
+  return BSON("_id" << OID(oid) <<
+              "expiration" << expiration <<
+              "reference" << std::string("http://notify.me/") + oid <<
+              "entities" << BSON_ARRAY(entity) <<
+              "attrs" << attrs);
+}
+
+
+
+/* ****************************************************************************
+*
+* prepareDatabase -
+*
+* Exact and pattern entities, with and without attributes. The last one is expired.
+*/
+static void prepareDatabase(void)
+{
+  DBClientBase*  connection = getMongoConnection();
+  long long      future     = 1879048191;
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860001", future, BSON("id" << "E1" << "type" << "T1" << "isPattern" << "false"),
+                           BSONArray()));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860002", future, BSON("id" << "E1" << "type" << "T1" << "isPattern" << "false"),
+                           BSON_ARRAY("A1")));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860003", future, BSON("id" << "E1" << "type" << "T2" << "isPattern" << "false"),
+                           BSONArray()));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860004", future, BSON("id" << "E.*" << "type" << "T1" << "isPattern" << "true"),
+                           BSONArray()));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860005", future, BSON("id" << "E[0-9]" << "type" << "T1" << "isPattern" << "true"),
+                           BSON_ARRAY("A2")));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860006", future, BSON("id" << "F.*" << "type" << "T2" << "isPattern" << "true"),
+                           BSONArray()));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860007", future, BSON("id" << "E2" << "type" << "T1" << "isPattern" << "false"),
+                           BSON_ARRAY("A1" << "A3")));
+
+  connection->insert(SUBSCRIBECONTEXTAVAIL_COLL,
+                     casub("51307b66f481db11bf860008", 1000, BSON("id" << "E1" << "type" << "T1" << "isPattern" << "false"),
+                           BSONArray()));
+}
+
+
+
+/* ****************************************************************************
+*
+* registrationsRun -
+*
+* Each registration is done, and the subscriptions it triggers (sorted) pushed to resultV
+*/
+static void registrationsRun(std::vector<std::string>* resultV)
+{
+  for (unsigned int ix = 0; ix < sizeof(registrations) / sizeof(registrations[0]); ++ix)
+  {
+    const CasubRegistration&                    r = registrations[ix];
+    RegisterContextRequest                      req;
+    RegisterContextResponse                     res;
+    ContextRegistration                         cr;
+    std::vector<EntityId*>                      enV;
+    std::vector<ContextRegistrationAttribute*>  attrV;
+
+    for (unsigned int jx = 0; r.ids[jx] != NULL; ++jx)
+    {
+      enV.push_back(new EntityId(r.ids[jx], r.type, "false"));
+      cr.entityIdVector.push_back(enV.back());
+    }
+
+    for (unsigned int jx = 0; r.attrs[jx] != NULL; ++jx)
+    {
+      attrV.push_back(new ContextRegistrationAttribute(r.attrs[jx], "TA"));
+      cr.contextRegistrationAttributeVector.push_back(attrV.back());
+    }
+
+    cr.providingApplication.set("http://dummy.com");
+    req.contextRegistrationVector.push_back(&cr);
+    req.duration.set("PT1M");
+
+    notified.clear();
+
+    EXPECT_EQ(SccOk, mongoRegisterContext(&req, &res, uriParams));
+    EXPECT_EQ(SccOk, res.errorCode.code);
+
+    std::sort(notified.begin(), notified.end());
+
+    std::string result;
+
+    for (unsigned int jx = 0; jx < notified.size(); ++jx)
+    {
+      result += notified[jx] + "\n";
+    }
+
+    resultV->push_back(result);
+
+    for (unsigned int jx = 0; jx < enV.size(); ++jx)
+    {
+      delete enV[jx];
+    }
+
+    for (unsigned int jx = 0; jx < attrV.size(); ++jx)
+    {
+      delete attrV[jx];
+    }
+
+    cr.entityIdVector.vec.clear();
+    cr.contextRegistrationAttributeVector.vec.clear();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* sameAsDb -
+*
+* The availability subscriptions triggered by each registration are the same with and
+* without the cache: exact id/type, patterns, attribute clause and expiration
+*/
+TEST(casubCache, sameAsDb)
+{
+  std::vector<std::string> dbV;
+  std::vector<std::string> cacheV;
+
+  utInit(false);
+
+  NotifierMock* notifierMock = new NotifierMock();
+
+  EXPECT_CALL(*notifierMock, sendNotifyContextAvailabilityRequest(_, _, _, _, _))
+      .WillRepeatedly(Invoke(notificationCollect));
+  setNotifier(notifierMock);
+
+  prepareDatabase();
+
+  casubCacheRelease();
+  registrationsRun(&dbV);
+
+  casubCacheInit();
+  registrationsRun(&cacheV);
+  casubCacheRelease();
+
+  ASSERT_EQ(dbV.size(), cacheV.size());
+
+  for (unsigned int ix = 0; ix < dbV.size(); ++ix)
+  {
+    EXPECT_EQ(dbV[ix], cacheV[ix]) << "registration " << ix;
+  }
+
+  // Expected results, so the comparison is meaningful (the attributes of the subscriptions with
+  // pattern entities are not taken into account)
+  EXPECT_EQ("51307b66f481db11bf860001 http://notify.me/51307b66f481db11bf860001\n"
+            "51307b66f481db11bf860004 http://notify.me/51307b66f481db11bf860004\n"
+            "51307b66f481db11bf860005 http://notify.me/51307b66f481db11bf860005\n", dbV[0]);
+  EXPECT_EQ("51307b66f481db11bf860003 http://notify.me/51307b66f481db11bf860003\n", dbV[4]);
+  EXPECT_EQ("", dbV[7]);
+
+  utExit();
+  delete notifierMock;
+}
@@ -0,0 +1,184 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "gtest/gtest.h"
+
+#include "mongo/client/dbclient.h"
+
+#include "cache/entityCache.h"
+
+using mongo::BSONObj;
+
+
+
+/* ****************************************************************************
+*
+* entityDoc -
+*/
+static BSONObj entityDoc(const std::string& id, const std::string& a1Value)
+{
+  return BSON("_id"       << BSON("id" << id << "type" << "T" << "servicePath" << "/sp") <<
+              "attrNames" << BSON_ARRAY("A1" << "A2") <<
+              "attrs"     << BSON("A1" << BSON("type" << "Number" << "value" << a1Value) <<
+                                  "A2" << BSON("type" << "Text"   << "value" << "x")) <<
+              "creDate"   << 1000 <<
+              "modDate"   << 1000);
+}
+
+
+
+/* ****************************************************************************
+*
+* applyUpdate -
+*/
+TEST(entityCache, applyUpdate)
+{
+  BSONObj  doc    = entityDoc("E1", "1");
+  BSONObj  update = BSON("$set"      << BSON("attrs.A1" << BSON("type" << "Number" << "value" << "2") <<
+                                             "attrs.A3" << BSON("type" << "Text"   << "value" << "y") <<
+                                             "modDate"  << 2000) <<
+                         "$unset"    << BSON("attrs.A2" << 1) <<
+                         "$addToSet" << BSON("attrNames" << BSON("$each" << BSON_ARRAY("A1" << "A3"))) <<
+                         "$pullAll"  << BSON("attrNames" << BSON_ARRAY("A2")));
+  BSONObj  result;
+
+  EXPECT_TRUE(entityCacheApplyUpdate(doc, update, &result));
+
+  BSONObj expected = BSON("_id"       << BSON("id" << "E1" << "type" << "T" << "servicePath" << "/sp") <<
+                          "attrNames" << BSON_ARRAY("A1" << "A3") <<
+                          "attrs"     << BSON("A1" << BSON("type" << "Number" << "value" << "2") <<
+                                              "A3" << BSON("type" << "Text"   << "value" << "y")) <<
+                          "creDate"   << 1000 <<
+                          "modDate"   << 2000);
+
+  EXPECT_TRUE(expected.binaryEqual(result));
+}
+
+
+
+/* ****************************************************************************
+*
+* applyReplace -
+*/
+TEST(entityCache, applyReplace)
+{
+  BSONObj  doc    = entityDoc("E1", "1");
+  BSONObj  update = BSON("$set"   << BSON("attrs"          << BSON("B1" << BSON("type" << "Text" << "value" << "z")) <<
+                                          "attrNames"      << BSON_ARRAY("B1") <<
+                                          "modDate"        << 2000 <<
+                                          "lastCorrelator" << "c1") <<
+                         "$unset" << BSON("location" << 1 << "expDate" << 1));
+  BSONObj  result;
+
+  EXPECT_TRUE(entityCacheApplyUpdate(doc, update, &result));
+
+  BSONObj expected = BSON("_id"            << BSON("id" << "E1" << "type" << "T" << "servicePath" << "/sp") <<
+                          "attrNames"      << BSON_ARRAY("B1") <<
+                          "attrs"          << BSON("B1" << BSON("type" << "Text" << "value" << "z")) <<
+                          "creDate"        << 1000 <<
+                          "modDate"        << 2000 <<
+                          "lastCorrelator" << "c1");
+
+  EXPECT_TRUE(expected.binaryEqual(result));
+}
+
+
+
+/* ****************************************************************************
+*
+* applyUnsupported -
+*/
+TEST(entityCache, applyUnsupported)
+{
+  BSONObj  doc = entityDoc("E1", "1");
+  BSONObj  result;
+
+  EXPECT_FALSE(entityCacheApplyUpdate(doc, BSON("$inc" << BSON("modDate" << 1)), &result));
+  EXPECT_FALSE(entityCacheApplyUpdate(doc, BSON("$set" << BSON("attrs.A1.value" << "3")), &result));
+}
+
+
+
+/* ****************************************************************************
+*
+* lifecycle -
+*/
+TEST(entityCache, lifecycle)
+{
+  EntityCacheStatistics     stats;
+  BSONObj                   doc;
+  std::vector<std::string>  servicePathV;
+
+  entityCacheInit(2);
+
+  servicePathV.push_back("/sp");
+  EXPECT_TRUE(entityCacheKeyUsable("E1", false, "T", false, servicePathV));
+  EXPECT_FALSE(entityCacheKeyUsable("E1", false, "", false, servicePathV));
+  servicePathV[0] = "/sp/#";
+  EXPECT_FALSE(entityCacheKeyUsable("E1", false, "T", false, servicePathV));
+
+  // Miss, then fill
+  unsigned long long epoch = entityCacheEpoch("t1", "/sp", "E1", "T");
+
+  EXPECT_FALSE(entityCacheLookup("t1", "/sp", "E1", "T", &doc));
+  entityCacheFill("t1", entityDoc("E1", "1"), epoch);
+  EXPECT_TRUE(entityCacheLookup("t1", "/sp", "E1", "T", &doc));
+  EXPECT_FALSE(entityCacheLookup("t2", "/sp", "E1", "T", &doc));
+
+  // Write-through
+  BSONObj update = BSON("$set" << BSON("attrs.A1" << BSON("type" << "Number" << "value" << "2")));
+  BSONObj base   = doc;
+
+  entityCacheWrite("t1", base, update);
+  EXPECT_TRUE(entityCacheLookup("t1", "/sp", "E1", "T", &doc));
+  EXPECT_STREQ("2", doc.getObjectField("attrs").getObjectField("A1").getStringField("value"));
+
+  // Write computed from a stale base invalidates the entry
+  entityCacheWrite("t1", base, update);
+  EXPECT_FALSE(entityCacheLookup("t1", "/sp", "E1", "T", &doc));
+
+  // A fill racing with a write is discarded
+  epoch = entityCacheEpoch("t1", "/sp", "E1", "T");
+  entityCacheWrite("t1", entityDoc("E1", "1"), update);
+  entityCacheFill("t1", entityDoc("E1", "1"), epoch);
+  EXPECT_FALSE(entityCacheLookup("t1", "/sp", "E1", "T", &doc));
+
+  // Eviction
+  entityCacheFill("t1", entityDoc("E1", "1"), entityCacheEpoch("t1", "/sp", "E1", "T"));
+  entityCacheFill("t1", entityDoc("E2", "1"), entityCacheEpoch("t1", "/sp", "E2", "T"));
+  entityCacheFill("t1", entityDoc("E3", "1"), entityCacheEpoch("t1", "/sp", "E3", "T"));
+
+  entityCacheStatisticsGet(&stats);
+  EXPECT_EQ(2, stats.items);
+  EXPECT_EQ(1, stats.evictions);
+
+  // Remove
+  entityCacheRemove("t1", "/sp", "E3", "T");
+  EXPECT_FALSE(entityCacheLookup("t1", "/sp", "E3", "T", &doc));
+
+  entityCacheStatisticsReset();
+  entityCacheStatisticsGet(&stats);
+  EXPECT_EQ(0, stats.hits);
+  EXPECT_EQ(1, stats.items);
+}
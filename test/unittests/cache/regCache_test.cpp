@@ -0,0 +1,390 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/dbConstants.h"
+#include "ngsi/EntityIdVector.h"
+#include "ngsi/StringList.h"
+#include "ngsi/ContextRegistrationResponseVector.h"
+#include "cache/regCache.h"
+
+#include "unittests/testInit.h"
+#include "unittests/commonMocks.h"
+#include "unittests/unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::DBClientBase;
+using mongo::BSONObj;
+using mongo::OID;
+
+
+
+/* ****************************************************************************
+*
+* RegQuery - a lookup of registrationsQuery(), lists separated by commas
+*/
+typedef struct RegQuery
+{
+  const char* id;
+  const char* type;
+  const char* isPattern;
+  const char* attrs;
+  const char* servicePaths;
+} RegQuery;
+
+
+
+/* ****************************************************************************
+*
+* queries -
+*
+* Exact and patterned entities, with and without type, with and without attributes and
+* with the different kinds of service path scopes
+*/
+static const RegQuery queries[] =
+{
+  { "E1",   "T1", "false", "",      ""            },
+  { "E1",   "",   "false", "",      ""            },
+  { "E2",   "T2", "false", "A2",    ""            },
+  { "E1",   "T1", "false", "A4,A9", ""            },
+  { "E3",   "",   "false", "A1",    ""            },
+  { "E9",   "",   "false", "",      ""            },
+  { "E.*",  "T1", "true",  "",      ""            },
+  { "E.*",  "",   "true",  "",      ""            },
+  { "E[12]", "", "true",  "A3",    ""            },
+  { "E1",   "",   "false", "",      "/"           },
+  { "E1",   "",   "false", "",      "/A"          },
+  { "E1",   "",   "false", "",      "/A/#"        },
+  { "E1",   "",   "false", "",      "/#"          },
+  { "E1",   "",   "false", "",      "/A/B,/C"     },
+  { "E.*",  "",   "true",  "A1",    "/A/#,/"      },
+  { "E2",   "",   "false", "A2",    "/AB"         }
+};
+
+
+
+/* ****************************************************************************
+*
+* split -
+*/
+static std::vector<std::string> split(const std::string& s)
+{
+  std::vector<std::string>  v;
+  std::string::size_type    start = 0;
+
+  if (s.empty())
+  {
+    return v;
+  }
+
+  while (true)
+  {
+    std::string::size_type comma = s.find(',', start);
+
+    v.push_back(s.substr(start, (comma == std::string::npos)? std::string::npos : comma - start));
+
+    if (comma == std::string::npos)
+    {
+      return v;
+    }
+
+    start = comma + 1;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* queriesRun -
+*
+* The response of each query (count and rendered registrations) is pushed to resultV.
+* Each query is run twice, the second time with pagination, as registrationsQuery() does
+* it on the results of the cache.
+*/
+static void queriesRun(std::vector<std::string>* resultV)
+{
+  for (unsigned int ix = 0; ix < sizeof(queries) / sizeof(queries[0]); ++ix)
+  {
+    const RegQuery&           q = queries[ix];
+    EntityIdVector            enV;
+    StringList                attrL;
+    std::vector<std::string>  attrV = split(q.attrs);
+    std::vector<std::string>  servicePathV = split(q.servicePaths);
+
+    enV.push_back(new EntityId(q.id, q.type, q.isPattern));
+
+    for (unsigned int jx = 0; jx < attrV.size(); ++jx)
+    {
+      attrL.push_back(attrV[jx]);
+    }
+
+    if (servicePathV.empty())
+    {
+      servicePathV.push_back("");
+    }
+
+    for (int offset = 0; offset < 2; ++offset)
+    {
+      ContextRegistrationResponseVector  crrV;
+      std::string                        err;
+      long long                          count = -1;
+
+      EXPECT_TRUE(registrationsQuery(enV, attrL, &crrV, &err, "", servicePathV, offset, offset, true, &count));
+
+      char countS[32];
+
+      snprintf(countS, sizeof(countS), "%lld ", count);
+      resultV->push_back(countS + crrV.render(false));
+
+      crrV.release();
+    }
+
+    enV.release();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* registration -
+*/
+static BSONObj registration
+(
+  const char*     oid,
+  const char*     servicePath,
+  long long       expiration,
+  const BSONObj&  entities,
+  const BSONObj&  attrs,
+  const char*     providingApplication
+)
+{
+  mongo::BSONObjBuilder bob;
+
+  bob.append("_id", OID(oid));
+  bob.append("expiration", expiration);
+
+  if (servicePath != NULL)
+  {
+    bob.append("servicePath", servicePath);
+  }
+
+  bob.append("contextRegistration", BSON_ARRAY(BSON("providingApplication" << providingApplication <<
+                                                    "entities" << entities <<
+                                                    "attrs" << attrs)));
+
+  return bob.obj();
+}
+
+
+
+/* ****************************************************************************
+*
+* attr -
+*/
+static BSONObj attr(const char* name)
+{
+  return BSON("name" << name << "type" << "TA" << "isDomain" << "false");
+}
+
+
+
+/* ****************************************************************************
+*
+* prepareDatabase -
+*
+* Registrations inserted in an order other than the one of their _id, as the results are
+* sorted by _id. Reg4 is expired. Reg5 has no service path.
+*/
+static void prepareDatabase(void)
+{
+  DBClientBase* connection = getMongoConnection();
+
+  /* 1879048191 corresponds to year 2029 */
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860003", "/A/B", 1879048191,
+                                  BSON_ARRAY(BSON("id" << "E1" << "type" << "T1") << BSON("id" << "E2" << "type" << "T2")),
+                                  BSON_ARRAY(attr("A1") << attr("A3")),
+                                  "http://cr3.com"));
+
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860001", "/", 1879048191,
+                                  BSON_ARRAY(BSON("id" << "E1" << "type" << "T1")),
+                                  BSON_ARRAY(attr("A1") << attr("A4")),
+                                  "http://cr1.com"));
+
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860002", "/A", 1879048191,
+                                  BSON_ARRAY(BSON("id" << "E2" << "type" << "T2") << BSON("id" << "E3")),
+                                  BSON_ARRAY(attr("A2")),
+                                  "http://cr2.com"));
+
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860004", "/", 1000,
+                                  BSON_ARRAY(BSON("id" << "E1" << "type" << "T1")),
+                                  BSON_ARRAY(attr("A1")),
+                                  "http://cr4.com"));
+
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860005", NULL, 1879048191,
+                                  BSON_ARRAY(BSON("id" << "E1") << BSON("type" << "T1" << "id" << "E2")),
+                                  BSON_ARRAY(attr("A1") << attr("A2")),
+                                  "http://cr5.com"));
+
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860006", "/AB", 1879048191,
+                                  BSON_ARRAY(BSON("id" << "E2" << "type" << "T2")),
+                                  BSON_ARRAY(attr("A2")),
+                                  "http://cr6.com"));
+
+  connection->insert(REGISTRATIONS_COLL,
+                     registration("51307b66f481db11bf860007", "/C", 1879048191,
+                                  BSON_ARRAY(BSON("id" << "E1" << "type" << "T1")),
+                                  BSON_ARRAY(attr("A3")),
+                                  "http://cr7.com"));
+}
+
+
+
+/* ****************************************************************************
+*
+* resultsCompare -
+*/
+static void resultsCompare(const std::vector<std::string>& dbV, const std::vector<std::string>& cacheV)
+{
+  ASSERT_EQ(dbV.size(), cacheV.size());
+
+  for (unsigned int ix = 0; ix < dbV.size(); ++ix)
+  {
+    EXPECT_EQ(dbV[ix], cacheV[ix]) << "query " << ix / 2 << (((ix % 2) == 0)? "" : " (paginated)");
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* sameAsDb -
+*
+* The registrations found in the cache are the same (and in the same order) than the ones
+* found by the DB query
+*/
+TEST(regCache, sameAsDb)
+{
+  std::vector<std::string> dbV;
+  std::vector<std::string> cacheV;
+
+  utInit(false);
+
+  prepareDatabase();
+
+  regCacheRelease();
+  queriesRun(&dbV);
+
+  regCacheInit();
+  queriesRun(&cacheV);
+  regCacheRelease();
+
+  resultsCompare(dbV, cacheV);
+
+  // Not all of them empty, so the test is meaningful
+  EXPECT_NE(dbV[0], dbV[10]);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* incremental -
+*
+* The registrations created, updated and removed once the tenant is loaded are applied
+* to the cache without reloading it
+*/
+TEST(regCache, incremental)
+{
+  std::vector<std::string> dbV;
+  std::vector<std::string> cacheV;
+  std::vector<std::string> loadedV;
+
+  utInit(false);
+
+  prepareDatabase();
+
+  regCacheInit();
+  queriesRun(&loadedV);
+
+  DBClientBase* connection = getMongoConnection();
+
+  // New registration, with an _id before the existing ones
+  BSONObj reg = registration("51307b66f481db11bf860000", "/A/B", 1879048191,
+                             BSON_ARRAY(BSON("id" << "E1" << "type" << "T1")),
+                             BSON_ARRAY(attr("A9")),
+                             "http://cr8.com");
+
+  connection->insert(REGISTRATIONS_COLL, reg);
+  regCacheItemUpsert("", reg);
+
+  // Update changing entities, attributes and service path
+  reg = registration("51307b66f481db11bf860003", "/C", 1879048191,
+                     BSON_ARRAY(BSON("id" << "E3")),
+                     BSON_ARRAY(attr("A1")),
+                     "http://cr3.com");
+
+  connection->update(REGISTRATIONS_COLL, BSON("_id" << OID("51307b66f481db11bf860003")), reg);
+  regCacheItemUpsert("", reg);
+
+  // Removal
+  connection->remove(REGISTRATIONS_COLL, BSON("_id" << OID("51307b66f481db11bf860001")));
+  regCacheItemRemove("", OID("51307b66f481db11bf860001"));
+
+  queriesRun(&cacheV);
+  regCacheRelease();
+
+  queriesRun(&dbV);
+
+  resultsCompare(dbV, cacheV);
+
+  // The writes changed the results
+  EXPECT_NE(loadedV, cacheV);
+
+  utExit();
+}
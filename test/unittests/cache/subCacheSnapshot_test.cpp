@@ -0,0 +1,393 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "common/sem.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/mongoCreateSubscription.h"
+#include "cache/subCache.h"
+#include "cache/subCacheSnapshot.h"
+
+#include "unittests/testInit.h"
+#include "unittests/commonMocks.h"
+#include "unittests/unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using ngsiv2::Subscription;
+using ngsiv2::EntID;
+
+
+
+/* ****************************************************************************
+*
+* SNAPSHOT_PATH -
+*/
+#define SNAPSHOT_PATH  "/tmp/orionSubCacheSnapshot_test.snap"
+
+
+
+/* ****************************************************************************
+*
+* Offsets in the snapshot file, as in SubCacheSnapshotHeader (subCacheSnapshot.cpp) -
+*/
+#define VERSION_OFFSET   8
+#define CHECKSUM_OFFSET  32
+#define HEADER_SIZE      40
+
+
+
+/* ****************************************************************************
+*
+* subscriptionCreate -
+*/
+static std::string subscriptionCreate(void)
+{
+  extern bool   noCache;
+  OrionError    oe;
+  Subscription  sub;
+  EntID         en("E1", "", "T", "");
+
+  noCache = false;
+
+  sub.expires     = PERMANENT_EXPIRES_DATETIME;
+  sub.throttling  = -1;
+  sub.status      = "active";
+  sub.attrsFormat = NGSI_V2_NORMALIZED;
+
+  sub.subject.entities.push_back(en);
+  sub.notification.httpInfo.url    = "http://foo.bar";
+  sub.notification.httpInfo.custom = false;
+
+  std::string subId = mongoCreateSubscription(sub, &oe, "", servicePathVector, "", "");
+
+  EXPECT_EQ(SccNone, oe.code);
+
+  return subId;
+}
+
+
+
+/* ****************************************************************************
+*
+* fileRead -
+*/
+static std::string fileRead(void)
+{
+  std::string  content;
+  char         buf[4096];
+  size_t       nb;
+  FILE*        fP = fopen(SNAPSHOT_PATH, "r");
+
+  if (fP == NULL)
+  {
+    return "";
+  }
+
+  while ((nb = fread(buf, 1, sizeof(buf), fP)) > 0)
+  {
+    content.append(buf, nb);
+  }
+
+  fclose(fP);
+
+  return content;
+}
+
+
+
+/* ****************************************************************************
+*
+* fileWrite -
+*/
+static void fileWrite(const std::string& content)
+{
+  FILE* fP = fopen(SNAPSHOT_PATH, "w");
+
+  ASSERT_TRUE(fP != NULL);
+  ASSERT_EQ(content.size(), fwrite(content.data(), 1, content.size(), fP));
+
+  fclose(fP);
+}
+
+
+
+/* ****************************************************************************
+*
+* snapshotPrepare -
+*
+* A cache with one subscription (with a counter not yet synchronized with DB), written to
+* the snapshot file. Returns the id of the subscription.
+*/
+static std::string snapshotPrepare(void)
+{
+  unlink(SNAPSHOT_PATH);
+
+  subCacheInit();
+  subCacheSnapshotInit(SNAPSHOT_PATH, 0);
+
+  std::string          subId = subscriptionCreate();
+  CachedSubscription*  cSubP = subCacheItemLookup("", subId.c_str());
+
+  EXPECT_TRUE(cSubP != NULL);
+
+  if (cSubP != NULL)
+  {
+    cSubP->count = 7;
+  }
+
+  subCacheSnapshotWrite();
+
+  return subId;
+}
+
+
+
+/* ****************************************************************************
+*
+* loadRejected -
+*
+* The snapshot is not loaded, so the cache (with no subscriptions at that point) is left
+* as it is and the caller loads it from DB
+*/
+static void loadRejected(void)
+{
+  bool stale = true;
+
+  cacheSemTake(__FUNCTION__, "unit test");
+  subCacheDestroy();
+  cacheSemGive(__FUNCTION__, "unit test");
+
+  EXPECT_FALSE(subCacheSnapshotLoad(&stale));
+  EXPECT_FALSE(stale);
+  EXPECT_EQ(0, subCacheItems());
+}
+
+
+
+/* ****************************************************************************
+*
+* roundTrip -
+*
+* The subscriptions are loaded with the counters they had when the snapshot was written
+*/
+TEST(subCacheSnapshot, roundTrip)
+{
+  bool stale = true;
+
+  utInit(false);
+
+  std::string subId = snapshotPrepare();
+
+  cacheSemTake(__FUNCTION__, "unit test");
+  subCacheDestroy();
+  cacheSemGive(__FUNCTION__, "unit test");
+
+  EXPECT_EQ(0, subCacheItems());
+
+  ASSERT_TRUE(subCacheSnapshotLoad(&stale));
+  EXPECT_FALSE(stale);
+  EXPECT_EQ(1, subCacheItems());
+
+  CachedSubscription* cSubP = subCacheItemLookup("", subId.c_str());
+
+  ASSERT_TRUE(cSubP != NULL);
+  EXPECT_EQ(7, cSubP->count);
+  EXPECT_STREQ("http://foo.bar", cSubP->httpInfo.url.c_str());
+  ASSERT_EQ(1, cSubP->entityIdInfos.size());
+  EXPECT_EQ("E1", cSubP->entityIdInfos[0]->entityId);
+
+  subCacheSnapshotInit("", 0);
+  unlink(SNAPSHOT_PATH);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* badMagic -
+*/
+TEST(subCacheSnapshot, badMagic)
+{
+  utInit(false);
+
+  snapshotPrepare();
+
+  std::string content = fileRead();
+
+  ASSERT_LT(HEADER_SIZE, content.size());
+  content[0] = 'X';
+  fileWrite(content);
+
+  loadRejected();
+
+  subCacheSnapshotInit("", 0);
+  unlink(SNAPSHOT_PATH);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* oldVersion -
+*/
+TEST(subCacheSnapshot, oldVersion)
+{
+  uint32_t version = 0;
+
+  utInit(false);
+
+  snapshotPrepare();
+
+  std::string content = fileRead();
+
+  ASSERT_LT(HEADER_SIZE, content.size());
+  content.replace(VERSION_OFFSET, sizeof(version), (const char*) &version, sizeof(version));
+  fileWrite(content);
+
+  loadRejected();
+
+  subCacheSnapshotInit("", 0);
+  unlink(SNAPSHOT_PATH);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* checksumMismatch -
+*/
+TEST(subCacheSnapshot, checksumMismatch)
+{
+  utInit(false);
+
+  snapshotPrepare();
+
+  std::string content = fileRead();
+
+  ASSERT_LT(HEADER_SIZE, content.size());
+  content[CHECKSUM_OFFSET] ^= 0xFF;
+  fileWrite(content);
+
+  loadRejected();
+
+  // Same with the payload modified
+  content[CHECKSUM_OFFSET] ^= 0xFF;
+  content[content.size() - 2] ^= 0xFF;
+  fileWrite(content);
+
+  loadRejected();
+
+  subCacheSnapshotInit("", 0);
+  unlink(SNAPSHOT_PATH);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* truncatedPayload -
+*/
+TEST(subCacheSnapshot, truncatedPayload)
+{
+  utInit(false);
+
+  snapshotPrepare();
+
+  std::string content = fileRead();
+
+  ASSERT_LT(HEADER_SIZE, content.size());
+  fileWrite(content.substr(0, content.size() - 10));
+
+  loadRejected();
+
+  // Only part of the header
+  fileWrite(content.substr(0, HEADER_SIZE / 2));
+
+  loadRejected();
+
+  subCacheSnapshotInit("", 0);
+  unlink(SNAPSHOT_PATH);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* differentConfiguration -
+*
+* Snapshots taken with another database name or multitenancy setting are not loaded
+*/
+TEST(subCacheSnapshot, differentConfiguration)
+{
+  bool stale = false;
+
+  utInit(false);
+
+  std::string dbPrefix = getDbPrefix();
+
+  snapshotPrepare();
+
+  setDbPrefix(dbPrefix + "_other");
+  loadRejected();
+  setDbPrefix(dbPrefix);
+
+  setMultitenantForUnitTest(true);
+  loadRejected();
+  setMultitenantForUnitTest(false);
+
+  // Back to the configuration the snapshot was taken with
+  EXPECT_TRUE(subCacheSnapshotLoad(&stale));
+  EXPECT_EQ(1, subCacheItems());
+
+  subCacheSnapshotInit("", 0);
+  unlink(SNAPSHOT_PATH);
+
+  utExit();
+}
@@ -0,0 +1,417 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "common/sem.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/mongoCreateSubscription.h"
+#include "mongoBackend/mongoUpdateSubscription.h"
+#include "cache/subCache.h"
+
+#include "unittests/testInit.h"
+#include "unittests/commonMocks.h"
+#include "unittests/unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::DBClientBase;
+using mongo::BSONObj;
+using ngsiv2::Subscription;
+using ngsiv2::SubscriptionUpdate;
+using ngsiv2::EntID;
+using ::testing::_;
+using ::testing::Invoke;
+
+
+
+/* ****************************************************************************
+*
+* T0 - time at the start of each test
+*/
+#define T0  1360232700
+
+
+
+/* ****************************************************************************
+*
+* now - time returned by the timer mock, moved forward by the tests
+*/
+static int now = T0;
+
+static int nowGet(void)
+{
+  return now;
+}
+
+
+
+/* ****************************************************************************
+*
+* timerMockSet -
+*
+* To be called after utInit(), and before the cache is initialized, as the time of the
+* timers of the cache is set by subCacheInit()
+*/
+static TimerMock* timerMockSet(void)
+{
+  TimerMock* timerMock = new TimerMock();
+
+  now = T0;
+  ON_CALL(*timerMock, getCurrentTime()).WillByDefault(Invoke(nowGet));
+  setTimer(timerMock);
+
+  return timerMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* subscriptionCreate -
+*/
+static std::string subscriptionCreate(long long expires, long long throttling)
+{
+  extern bool   noCache;
+  OrionError    oe;
+  Subscription  sub;
+  EntID         en("E1", "", "T", "");
+
+  noCache = false;
+
+  sub.expires     = expires;
+  sub.throttling  = throttling;
+  sub.status      = "active";
+  sub.attrsFormat = NGSI_V2_NORMALIZED;
+
+  sub.subject.entities.push_back(en);
+  sub.notification.httpInfo.url    = "http://foo.bar";
+  sub.notification.httpInfo.custom = false;
+
+  std::string subId = mongoCreateSubscription(sub, &oe, "", servicePathVector, "", "");
+
+  EXPECT_EQ(SccNone, oe.code);
+
+  return subId;
+}
+
+
+
+/* ****************************************************************************
+*
+* matches - number of subscriptions of the cache matching an update of E1
+*/
+static int matches(void)
+{
+  std::vector<CachedSubscription*> subV;
+
+  subCacheMatch("", "", "E1", "T", "A", &subV);
+
+  return subV.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* expiry -
+*
+* The expiry timer moves the subscription to the expired list, where it is not matched
+*/
+TEST(subCache, expiry)
+{
+  utInit(false);
+
+  TimerMock* timerMock = timerMockSet();
+
+  subCacheInit();
+
+  std::string          subId = subscriptionCreate(T0 + 10, -1);
+  CachedSubscription*  cSubP = subCacheItemLookup("", subId.c_str());
+
+  ASSERT_TRUE(cSubP != NULL);
+  EXPECT_FALSE(cSubP->expired);
+  EXPECT_EQ(1, matches());
+
+  now = T0 + 10;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_FALSE(cSubP->expired);
+  EXPECT_EQ(1, matches());
+
+  now = T0 + 11;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_TRUE(cSubP->expired);
+  EXPECT_EQ(0, matches());
+
+  // Still in the cache, for the refresh and the GET operations
+  EXPECT_EQ(cSubP, subCacheItemLookup("", subId.c_str()));
+  EXPECT_EQ(1, subCacheItems());
+
+  utExit();
+  delete timerMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* rearmAfterUpdate -
+*
+* A PATCH extending the expiration of an expired subscription brings it back to the
+* active list, with its expiry timer armed again
+*/
+TEST(subCache, rearmAfterUpdate)
+{
+  OrionError          oe;
+  SubscriptionUpdate  subUp;
+
+  utInit(false);
+
+  TimerMock* timerMock = timerMockSet();
+
+  subCacheInit();
+
+  std::string subId = subscriptionCreate(T0 + 10, -1);
+
+  now = T0 + 11;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_EQ(0, matches());
+
+  subUp.id              = subId;
+  subUp.expires         = T0 + 100;
+  subUp.expiresProvided = true;
+
+  EXPECT_EQ(subId, mongoUpdateSubscription(subUp, &oe, "", servicePathVector, "", ""));
+
+  CachedSubscription* cSubP = subCacheItemLookup("", subId.c_str());
+
+  ASSERT_TRUE(cSubP != NULL);
+  EXPECT_FALSE(cSubP->expired);
+  EXPECT_EQ(T0 + 100, cSubP->expirationTime);
+  EXPECT_EQ(1, matches());
+
+  now = T0 + 50;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_EQ(1, matches());
+
+  now = T0 + 101;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_EQ(0, matches());
+
+  utExit();
+  delete timerMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* deferredNotification -
+*
+* With throttlingDeferred, the entities of the updates discarded by throttling are notified
+* (once) at the end of the window, with the x-auth-token of the last update discarded
+*/
+TEST(subCache, deferredNotification)
+{
+  utInit(false);
+
+  TimerMock*     timerMock    = timerMockSet();
+  NotifierMock*  notifierMock = new NotifierMock();
+
+  EXPECT_CALL(*notifierMock, sendNotifyContextRequest(_, _, "", "token2", "", NGSI_V2_NORMALIZED, _))
+      .Times(1);
+  setNotifier(notifierMock);
+
+  subCacheInit(false, 1, true);
+
+  std::string subId = subscriptionCreate(T0 + 1000, 5);
+
+  // The entity is created after the subscription, so there is no initial notification
+  BSONObj en = BSON("_id" << BSON("id" << "E1" << "type" << "T") <<
+                    "creDate" << T0 <<
+                    "attrNames" << BSON_ARRAY("A") <<
+                    "attrs" << BSON("A" << BSON("type" << "TA" << "value" << "val")));
+
+  getMongoConnection()->insert(ENTITIES_COLL, en);
+
+  // Two updates within the window of a notification sent at T0
+  CachedSubscription* cSubP = subCacheItemLookup("", subId.c_str());
+
+  ASSERT_TRUE(cSubP != NULL);
+
+  cacheSemTake(__FUNCTION__, "unit test");
+  cSubP->lastNotificationTime = T0;
+  subCacheItemDefer(cSubP, "E1", "T", "token1");
+  subCacheItemDefer(cSubP, "E1", "T", "token2");
+  cacheSemGive(__FUNCTION__, "unit test");
+
+  EXPECT_EQ(1, cSubP->deferredEntities.size());
+
+  now = T0 + 4;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_EQ(1, cSubP->deferredEntities.size());
+  EXPECT_EQ(0, cSubP->count);
+
+  now = T0 + 5;
+  subCacheTimersRunForUnitTest();
+
+  EXPECT_EQ(0, cSubP->deferredEntities.size());
+  EXPECT_EQ("", cSubP->deferredXauthToken);
+  EXPECT_EQ(T0 + 5, cSubP->lastNotificationTime);
+  EXPECT_EQ(1, cSubP->count);
+
+  // Nothing else to send
+  now = T0 + 20;
+  subCacheTimersRunForUnitTest();
+
+  utExit();
+  delete notifierMock;
+  delete timerMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* cacheOrder - "<tenant>/<subscriptionId>" of the subscriptions in the cache, in order
+*/
+static std::vector<std::string> cacheOrder(void)
+{
+  std::vector<std::string> orderV;
+
+  for (CachedSubscription* cSubP = subCacheHead(); cSubP != NULL; cSubP = subCacheItemNext(cSubP))
+  {
+    orderV.push_back(std::string((cSubP->tenant == NULL)? "" : cSubP->tenant) + "/" + cSubP->subscriptionId);
+  }
+
+  return orderV;
+}
+
+
+
+/* ****************************************************************************
+*
+* parallelLoad -
+*
+* With several loaders, the cache has the subscriptions of the tenant databases in the
+* same order than with a single loader, and the load statistics cover all the databases
+*/
+TEST(subCache, parallelLoad)
+{
+  const char*              tenants[] = { "t1", "t2", "t3", "t4" };
+  std::vector<std::string> singleV;
+  std::vector<std::string> parallelV;
+  SubCacheLoadStatistics   stats;
+
+  utInit(false);
+
+  setMultitenantForUnitTest(true);
+  subCacheInit(true, 1);
+
+  for (unsigned int ix = 0; ix < 4; ++ix)
+  {
+    OrionError    oe;
+    Subscription  sub;
+    EntID         en("E1", "", "T", "");
+
+    getMongoConnection()->dropCollection(getSubscribeContextCollectionName(tenants[ix]));
+
+    sub.expires     = T0 + 1000;
+    sub.status      = "active";
+    sub.attrsFormat = NGSI_V2_NORMALIZED;
+
+    sub.subject.entities.push_back(en);
+    sub.notification.httpInfo.url = "http://foo.bar";
+
+    // Two subscriptions per tenant
+    mongoCreateSubscription(sub, &oe, tenants[ix], servicePathVector, "", "");
+    EXPECT_EQ(SccNone, oe.code);
+    mongoCreateSubscription(sub, &oe, tenants[ix], servicePathVector, "", "");
+    EXPECT_EQ(SccNone, oe.code);
+  }
+
+  cacheSemTake(__FUNCTION__, "unit test");
+  subCacheRefresh();
+  cacheSemGive(__FUNCTION__, "unit test");
+
+  singleV = cacheOrder();
+
+  subCacheInit(true, 3);
+
+  cacheSemTake(__FUNCTION__, "unit test");
+  subCacheRefresh();
+  cacheSemGive(__FUNCTION__, "unit test");
+
+  parallelV = cacheOrder();
+  subCacheLoadStatisticsGet(&stats);
+
+  EXPECT_EQ(8, singleV.size());
+  EXPECT_EQ(singleV, parallelV);
+
+  // The default database plus (at least) the ones of the tenants of this test
+  EXPECT_EQ(3, stats.loaders);
+  EXPECT_LE(5, stats.databases);
+  EXPECT_EQ(stats.databases, stats.loaded);
+  ASSERT_EQ(stats.databases, stats.loadTimes.size());
+  EXPECT_EQ(getDbPrefix(), stats.loadTimes.back().first);
+
+  for (unsigned int ix = 0; ix < 4; ++ix)
+  {
+    std::string  db    = getDbPrefix() + "-" + tenants[ix];
+    bool         found = false;
+
+    for (unsigned int jx = 0; jx < stats.loadTimes.size(); ++jx)
+    {
+      if (stats.loadTimes[jx].first == db)
+      {
+        found = true;
+        EXPECT_LE(0, stats.loadTimes[jx].second);
+      }
+    }
+
+    EXPECT_TRUE(found) << db;
+    getMongoConnection()->dropCollection(getSubscribeContextCollectionName(tenants[ix]));
+  }
+
+  setMultitenantForUnitTest(false);
+
+  utExit();
+}
@@ -0,0 +1,305 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/charScan.h"
+#include "common/JsonHelper.h"
+#include "common/string.h"
+#include "parse/forbiddenChars.h"
+
+
+
+/* ****************************************************************************
+*
+* Reference implementations -
+*
+* The byte-at-a-time versions the kernels replaced (JSON escape with the \u00XX
+* conversion of the control chars done right)
+*/
+static bool refCommonForbidden(char c)
+{
+  return strchr("<>\"'=;()", c) != NULL;
+}
+
+static bool refForbiddenChars(const char* s, const char* exceptions)
+{
+  for (; *s != 0; ++s)
+  {
+    if ((exceptions != NULL) && (strchr(exceptions, *s) != NULL))
+    {
+      continue;
+    }
+
+    if (refCommonForbidden(*s))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool refForbiddenIdCharsV2(const char* s, const char* exceptions)
+{
+  for (; *s != 0; ++s)
+  {
+    if ((exceptions != NULL) && (strchr(exceptions, *s) != NULL))
+    {
+      continue;
+    }
+
+    unsigned char c = (unsigned char) *s;
+
+    if ((c >= 127) || (c <= 32) || (strchr("?/#&", c) != NULL) || refCommonForbidden(c))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool refOnlyWs(const char* s)
+{
+  for (; *s != 0; ++s)
+  {
+    if ((*s != ' ') && (*s != '\t') && (*s != '\n'))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool refServicePathOk(const char* s)
+{
+  for (; *s != 0; ++s)
+  {
+    if (!isalnum((unsigned char) *s) && (*s != '_') && (*s != '/'))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static std::string refJsonEscape(const std::string& s)
+{
+  std::string out;
+
+  for (unsigned int ix = 0; ix < s.size(); ++ix)
+  {
+    unsigned char  c = (unsigned char) s[ix];
+    char           u[8];
+
+    switch (c)
+    {
+    case '\\': out += "\\\\"; break;
+    case '"':  out += "\\\""; break;
+    case '\b': out += "\\b";  break;
+    case '\f': out += "\\f";  break;
+    case '\n': out += "\\n";  break;
+    case '\r': out += "\\r";  break;
+    case '\t': out += "\\t";  break;
+    default:
+      if (c <= 0x1F)
+      {
+        snprintf(u, sizeof(u), "\\u%04X", c);
+        out += u;
+      }
+      else
+      {
+        out += (char) c;
+      }
+    }
+  }
+
+  return out;
+}
+
+
+
+/* ****************************************************************************
+*
+* randomString -
+*
+* Mostly "normal" chars, so the vectorized loops run for a while before finding a
+* hit, with some special ones (also at the block boundaries, depending on the length)
+*/
+static std::string randomString(unsigned int maxLen)
+{
+  static const char  special[] = "<>\"'=;()?/#&_ \t\n\r\b\f\\\x01\x1f\x7f\x80\xc3\xff";
+  unsigned int       len       = rand() % (maxLen + 1);
+  std::string        s;
+
+  for (unsigned int ix = 0; ix < len; ++ix)
+  {
+    int r = rand() % 100;
+
+    if (r < 3)
+    {
+      s += special[rand() % (sizeof(special) - 1)];
+    }
+    else if (r < 6)
+    {
+      s += (char) (1 + rand() % 255);
+    }
+    else
+    {
+      s += (char) ('a' + rand() % 26);
+    }
+  }
+
+  return s;
+}
+
+
+
+/* ****************************************************************************
+*
+* fuzzEquivalence -
+*/
+TEST(charScan, fuzzEquivalence)
+{
+  const CharScanLevel  levels[]   = { CslScalar, CslSse2, CslSsse3, CslAvx2 };
+  const char*          exceptions[] = { NULL, "", "'", "=;", ";", "/#" };
+
+  srand(1);
+
+  for (unsigned int lIx = 0; lIx < sizeof(levels) / sizeof(levels[0]); ++lIx)
+  {
+    if (!charScanLevelSet(levels[lIx]))
+    {
+      continue;  // not supported by this CPU
+    }
+
+    for (unsigned int ix = 0; ix < 20000; ++ix)
+    {
+      std::string  s  = randomString((ix % 2 == 0)? 40 : 300);
+      const char*  eP = exceptions[ix % (sizeof(exceptions) / sizeof(exceptions[0]))];
+      std::string  ws = std::string(rand() % 70, ' ') + ((ix % 3 == 0)? "\t" : "x");
+
+      EXPECT_EQ(refForbiddenChars(s.c_str(), eP),     forbiddenChars(s.c_str(), eP))     << charScanLevelName();
+      EXPECT_EQ(refForbiddenIdCharsV2(s.c_str(), eP), forbiddenIdCharsV2(s.c_str(), eP)) << charScanLevelName();
+      EXPECT_EQ(refOnlyWs(ws.c_str()),                onlyWs(ws.c_str()))                << charScanLevelName();
+      EXPECT_EQ(refOnlyWs(s.c_str()),                 onlyWs(s.c_str()))                 << charScanLevelName();
+      EXPECT_EQ(refServicePathOk(s.c_str()),          servicePathCheck(s.c_str()) == "OK") << charScanLevelName();
+      EXPECT_EQ("\"" + refJsonEscape(s) + "\"",       toJsonString(s))                   << charScanLevelName();
+    }
+  }
+
+  charScanInit();
+}
+
+
+
+/* ****************************************************************************
+*
+* classFind -
+*/
+TEST(charScan, classFind)
+{
+  CharClass    cc("#");
+  std::string  s(100, 'a');
+
+  cc.addRange(0xF0, 0xFF);
+
+  EXPECT_EQ(100, charClassFind(cc, s.c_str(), s.size()));
+
+  s[70] = '#';
+  EXPECT_EQ(70, charClassFind(cc, s.c_str(), s.size()));
+  EXPECT_EQ(30, charClassFind(cc, s.c_str() + 40, 60));
+
+  s[33] = (char) 0xF5;
+  EXPECT_EQ(33, charClassFind(cc, s.c_str(), s.size()));
+
+  cc.invert();
+  EXPECT_EQ(0, charClassFind(cc, s.c_str(), s.size()));
+  EXPECT_EQ(3, charClassFind(cc, "###a", 4));
+}
+
+
+
+/* ****************************************************************************
+*
+* DISABLED_benchmark -
+*
+* Run with --gtest_also_run_disabled_tests --gtest_filter=charScan.*, it compares the
+* kernels on the rendering of long text attributes and the checks on their names
+*/
+TEST(charScan, DISABLED_benchmark)
+{
+  const CharScanLevel  levels[] = { CslScalar, CslSse2, CslSsse3, CslAvx2 };
+  std::string          text;
+
+  srand(1);
+
+  // A 4 KB text, with a quote every ~1 KB
+  while (text.size() < 4096)
+  {
+    text += "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor ";
+    if (text.size() % 1024 < 80)
+    {
+      text += '"';
+    }
+  }
+
+  for (unsigned int lIx = 0; lIx < sizeof(levels) / sizeof(levels[0]); ++lIx)
+  {
+    if (!charScanLevelSet(levels[lIx]))
+    {
+      continue;
+    }
+
+    struct timespec  start;
+    struct timespec  end;
+    size_t           total = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned int ix = 0; ix < 20000; ++ix)
+    {
+      total += toJsonString(text).size();
+      total += forbiddenChars(text.c_str(), "'");
+      total += forbiddenIdCharsV2("temperatureOfTheLivingRoomSensor_0001", NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%-8s %8.1f MB/s (%lu)\n", charScanLevelName(), (20000.0 * text.size() * 2) / secs / 1e6, (unsigned long) total);
+  }
+
+  charScanInit();
+}
@@ -0,0 +1,593 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/codec.h"
+#include "common/limits.h"
+#include "common/string.h"
+#include "common/globals.h"
+
+
+
+/* ****************************************************************************
+*
+* refDouble2string -
+*
+* The snprintf based implementation the codec replaced, with its fixes: no trailing dot
+* when the decimals round to zero and negative numbers close to an integer rounded
+* away from zero
+*/
+static std::string refDouble2string(double f)
+{
+  char       buf[STRING_SIZE_FOR_DOUBLE];
+  long long  intPart = (long long) f;
+  double     diff    = f - intPart;
+
+  diff = (diff < 0)? -diff : diff;
+
+  if (diff > 0.9999999998)
+  {
+    snprintf(buf, sizeof(buf), "%lld", (f < 0)? intPart - 1 : intPart + 1);
+  }
+  else if (diff < 0.000000001)
+  {
+    snprintf(buf, sizeof(buf), "%lld", intPart);
+  }
+  else
+  {
+    snprintf(buf, sizeof(buf), "%.9f", f);
+
+    char* last = &buf[strlen(buf) - 1];
+
+    while ((*last == '0') && (last != buf))
+    {
+      *last = 0;
+      --last;
+    }
+
+    if (*last == '.')
+    {
+      *last = 0;
+    }
+  }
+
+  return buf;
+}
+
+
+
+/* ****************************************************************************
+*
+* refTimezoneOffset - 
+*/
+static int refTimezoneOffset(const char* tz)
+{
+  if (strcmp(tz, "Z") == 0)
+  {
+    return 0;
+  }
+
+  if ((tz[0] != '+') && (tz[0] != '-'))
+  {
+    return -1;
+  }
+
+  int sign   = (tz[0] == '+')? 1 : -1;
+  int offset = -1;
+  int h;
+  int m;
+
+  if (sscanf(tz + 1, "%2d:%2d", &h, &m) == 2)
+  {
+    offset = h * 60 * 60 + m * 60;
+  }
+  else if (sscanf(tz + 1, "%2d%2d", &h, &m) == 2)
+  {
+    offset = h * 60 * 60 + m * 60;
+  }
+  else if (sscanf(tz + 1, "%2d", &h) == 1)
+  {
+    offset = h * 60 * 60;
+  }
+
+  if (offset == -1)
+  {
+    return -1;
+  }
+
+  return sign * offset;
+}
+
+
+
+/* ****************************************************************************
+*
+* refParse8601Time - the sscanf based implementation the codec replaced
+*/
+static int64_t refParse8601Time(const std::string& ss)
+{
+  int    y = 0;
+  int    M = 0;
+  int    d = 0;
+  int    h = 0;
+  int    m = 0;
+  float  s = 0;
+  char   tz[10];
+
+  if (ss.length() > 29)
+  {
+    return -1;
+  }
+
+  snprintf(tz, sizeof(tz), "%s", "Z");
+
+  bool validDate = ((sscanf(ss.c_str(), "%4d-%2d-%2dT%2d:%2d:%f%s", &y, &M, &d, &h, &m, &s, tz) >= 6)  ||
+                    (sscanf(ss.c_str(), "%4d-%2d-%2dT%2d%2d%f%s", &y, &M, &d, &h, &m, &s, tz) >= 6)    ||
+                    (sscanf(ss.c_str(), "%4d-%2d-%2dT%2d:%2d%s", &y, &M, &d, &h, &m, tz) >= 5)         ||
+                    (sscanf(ss.c_str(), "%4d-%2d-%2dT%2d%2d%s", &y, &M, &d, &h, &m, tz) >= 5)          ||
+                    (sscanf(ss.c_str(), "%4d-%2d-%2dT%2d%s", &y, &M, &d, &h, tz) >= 4)                 ||
+                    (sscanf(ss.c_str(), "%4d-%2d-%2d%s", &y, &M, &d, tz) == 3));
+
+  if (!validDate)
+  {
+    return -1;
+  }
+
+  int offset = refTimezoneOffset(tz);
+  if (offset == -1)
+  {
+    return -1;
+  }
+
+  struct tm time;
+  time.tm_year = y - 1900;
+  time.tm_mon  = M - 1;
+  time.tm_mday = d;
+  time.tm_hour = h;
+  time.tm_min  = m;
+  time.tm_sec  = (int)s;
+
+  return (int64_t) (timegm(&time) - offset);
+}
+
+
+
+/* ****************************************************************************
+*
+* randomDouble - doubles of very different magnitudes, many of them with few decimals
+*/
+static double randomDouble(void)
+{
+  double mantissa = (double) rand() / RAND_MAX;
+  int    kind     = rand() % 4;
+
+  if (kind == 0)
+  {
+    // a few decimals, as in the usual attributes (23.5, 0.125, -41.37 ...)
+    return (rand() % 2000000 - 1000000) / pow(10, rand() % 7);
+  }
+  else if (kind == 1)
+  {
+    // close to integers
+    return (rand() % 1000 - 500) + ((rand() % 2)? 1 : -1) * mantissa * pow(10, -(rand() % 12));
+  }
+
+  return ((rand() % 2)? 1 : -1) * mantissa * pow(10, rand() % 30 - 14);
+}
+
+
+
+/* ****************************************************************************
+*
+* randomBits - any finite double
+*/
+static double randomBits(void)
+{
+  uint64_t  u = 0;
+  double    d;
+
+  for (int ix = 0; ix < 4; ++ix)
+  {
+    u = (u << 16) ^ (uint64_t) (rand() & 0xFFFF);
+  }
+
+  memcpy(&d, &u, sizeof(d));
+
+  return isfinite(d)? d : 1.5;
+}
+
+
+
+/* ****************************************************************************
+*
+* decimal9 -
+*/
+TEST(codec, decimal9)
+{
+  srand(1);
+
+  for (int ix = 0; ix < 1000000; ++ix)
+  {
+    double f = randomDouble();
+
+    EXPECT_EQ(refDouble2string(f), double2string(f)) << "%.17g: " << f;
+  }
+
+  // printf rounds the exact binary value, ties to even
+  EXPECT_EQ("0.000976562", double2string(1.0 / 1024));
+  EXPECT_EQ("0.001953125", double2string(1.0 / 512));
+  EXPECT_EQ("-7.001953125", double2string(-7.0 - 1.0 / 512));
+  EXPECT_EQ("0.1", double2string(0.1));
+  EXPECT_EQ("12.34", double2string(12.34));
+  EXPECT_EQ("-0.5", double2string(-0.5));
+  EXPECT_EQ("0.000000001", double2string(0.000000001));
+
+  // integers
+  EXPECT_EQ("0", double2string(0.0));
+  EXPECT_EQ("0", double2string(-0.0));
+  EXPECT_EQ("17", double2string(17.0));
+  EXPECT_EQ("-17", double2string(-17.0));
+  EXPECT_EQ("4", double2string(3.99999999999));
+  EXPECT_EQ("-4", double2string(-3.99999999999));
+  EXPECT_EQ("9007199254740992", double2string(9007199254740992.0));
+  EXPECT_EQ("100000000000000000000", double2string(1e20));
+  EXPECT_EQ("-1e+300", double2string(-1e300));
+}
+
+
+
+/* ****************************************************************************
+*
+* shortest -
+*/
+TEST(codec, shortest)
+{
+  char buf[STRING_SIZE_FOR_DOUBLE];
+
+  srand(2);
+
+  for (int ix = 0; ix < 1000000; ++ix)
+  {
+    double f = (ix % 2 == 0)? randomBits() : randomDouble();
+    int    len = doubleFormatShortest(f, buf);
+
+    ASSERT_EQ(strlen(buf), (size_t) len);
+    EXPECT_EQ(f, strtod(buf, NULL)) << buf;
+  }
+
+  doubleFormatShortest(0.1, buf);
+  EXPECT_STREQ("0.1", buf);
+  doubleFormatShortest(0.1 + 0.2, buf);
+  EXPECT_STREQ("0.30000000000000004", buf);
+  doubleFormatShortest(-123.456, buf);
+  EXPECT_STREQ("-123.456", buf);
+  doubleFormatShortest(1e21, buf);
+  EXPECT_STREQ("1e+21", buf);
+  doubleFormatShortest(1.5e-7, buf);
+  EXPECT_STREQ("1.5e-7", buf);
+  doubleFormatShortest(0.000001, buf);
+  EXPECT_STREQ("0.000001", buf);
+  doubleFormatShortest(5e-324, buf);
+  EXPECT_STREQ("5e-324", buf);
+  doubleFormatShortest(1.7976931348623157e308, buf);
+  EXPECT_STREQ("1.7976931348623157e+308", buf);
+  doubleFormatShortest(-42, buf);
+  EXPECT_STREQ("-42", buf);
+
+  // double2string in shortest numbers mode
+  codecInit(true);
+  EXPECT_EQ("3.99999999999", double2string(3.99999999999));
+  EXPECT_EQ("0.123456789012", double2string(0.123456789012));
+  EXPECT_EQ("12", double2string(12.0));
+  codecInit(false);
+  EXPECT_EQ("0.123456789", double2string(0.123456789012));
+}
+
+
+
+/* ****************************************************************************
+*
+* significantDigits - of a number rendered by doubleFormatShortest()
+*/
+static int significantDigits(const char* s)
+{
+  std::string digits;
+
+  for (const char* p = s; (*p != 0) && (*p != 'e'); ++p)
+  {
+    if ((*p >= '0') && (*p <= '9'))
+    {
+      digits += *p;
+    }
+  }
+
+  size_t first = digits.find_first_not_of('0');
+  size_t last  = digits.find_last_not_of('0');
+
+  return (first == std::string::npos)? 0 : (int) (last - first + 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* shortestSearch - '%.*g' with the lowest precision parsing back to f
+*/
+static std::string shortestSearch(double f)
+{
+  char buf[STRING_SIZE_FOR_DOUBLE];
+
+  for (int precision = 1; precision < 17; ++precision)
+  {
+    snprintf(buf, sizeof(buf), "%.*g", precision, f);
+
+    if (strtod(buf, NULL) == f)
+    {
+      return buf;
+    }
+  }
+
+  snprintf(buf, sizeof(buf), "%.17g", f);
+  return buf;
+}
+
+
+
+/* ****************************************************************************
+*
+* shortestLength -
+*
+* doubleFormatShortest() has to give the same number (so, with the same digits) as
+* the shortest '%.{1..17}g' parsing back to the value
+*/
+TEST(codec, shortestLength)
+{
+  char buf[STRING_SIZE_FOR_DOUBLE];
+
+  srand(3);
+
+  for (int ix = 0; ix < 100000; ++ix)
+  {
+    double       f   = (ix % 2 == 0)? randomBits() : randomDouble();
+    std::string  ref = shortestSearch(f);
+
+    doubleFormatShortest(f, buf);
+
+    ASSERT_EQ(significantDigits(ref.c_str()), significantDigits(buf)) << buf << " vs " << ref;
+    EXPECT_EQ(strtod(ref.c_str(), NULL), strtod(buf, NULL)) << buf << " vs " << ref;
+  }
+
+  // Values Grisu alone doesn't render with the shortest digits
+  doubleFormatShortest(-2.419824069927155e+16, buf);
+  EXPECT_STREQ("-24198240699271550", buf);
+  doubleFormatShortest(1.220449460810058e+179, buf);
+  EXPECT_STREQ("1.220449460810058e+179", buf);
+  doubleFormatShortest(7.96584094361304e-157, buf);
+  EXPECT_STREQ("7.96584094361304e-157", buf);
+}
+
+
+
+/* ****************************************************************************
+*
+* parse -
+*/
+TEST(codec, parse)
+{
+  const char* special[] =
+  {
+    "0", "-0", "+0", "0.0", ".5", "-.5", "5.", "1e5", "1E+05", "1e-5", "1e", "1e+", "0x1A", "0x1p3",
+    "inf", "-Infinity", "nan", " 12", "12 ", "1.5x", "1..5", "123456789012345", "1234567890123456",
+    "0.000000000000000000001", "1e22", "1e23", "1e-22", "1e-23", "9007199254740993", "1e400", "1e-400",
+    "12.0a", "", "-", "+.", "e5", "0.1234567890123450000"
+  };
+
+  for (unsigned int ix = 0; ix < sizeof(special) / sizeof(special[0]); ++ix)
+  {
+    char*   end1;
+    char*   end2;
+    double  d1 = strtod(special[ix], &end1);
+    double  d2 = doubleParse(special[ix], &end2);
+
+    if (d1 != d1)
+    {
+      EXPECT_TRUE(d2 != d2) << special[ix];
+    }
+    else
+    {
+      EXPECT_EQ(0, memcmp(&d1, &d2, sizeof(d1))) << special[ix];
+    }
+
+    EXPECT_EQ(end1, end2) << special[ix];
+  }
+
+  srand(3);
+
+  for (int ix = 0; ix < 1000000; ++ix)
+  {
+    char    buf[64];
+    char*   end1;
+    char*   end2;
+    int     kind = ix % 3;
+
+    if (kind == 0)
+    {
+      snprintf(buf, sizeof(buf), "%.*f", rand() % 10, randomDouble());
+    }
+    else if (kind == 1)
+    {
+      snprintf(buf, sizeof(buf), "%.*e", rand() % 17, randomBits());
+    }
+    else
+    {
+      snprintf(buf, sizeof(buf), "%d.%de%d", rand() % 100000 - 50000, rand(), rand() % 60 - 30);
+    }
+
+    double d1 = strtod(buf, &end1);
+    double d2 = doubleParse(buf, &end2);
+
+    EXPECT_EQ(0, memcmp(&d1, &d2, sizeof(d1))) << buf;
+    EXPECT_EQ(end1, end2) << buf;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* isodateFormat -
+*/
+TEST(codec, isodateFormat)
+{
+  srand(4);
+
+  for (int ix = 0; ix < 1000000; ++ix)
+  {
+    // From year -9999 to 12000, many of them in the same day
+    long long  t = (ix % 2 == 0)? 1500000000LL + rand() % 200000 : ((long long) rand() * rand()) % 640000000000LL - 377000000000LL;
+    char       buffer[80];
+    time_t     rawtime = (time_t) t;
+    struct tm  tm;
+
+    gmtime_r(&rawtime, &tm);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S.00Z", &tm);
+
+    EXPECT_EQ(std::string(buffer), isodate2str(t)) << t;
+  }
+
+  EXPECT_EQ("1970-01-01T00:00:00.00Z", isodate2str(0));
+  EXPECT_EQ("1969-12-31T23:59:59.00Z", isodate2str(-1));
+  EXPECT_EQ("2016-02-29T12:00:00.00Z", isodate2str(1456747200));
+  EXPECT_EQ("1970-04-26T17:46:40.00Z", isodate2str(10000000));
+}
+
+
+
+/* ****************************************************************************
+*
+* isodateParse -
+*/
+TEST(codec, isodateParse)
+{
+  const char* times[] = { "", "T07", "T0721", "T072124", "T072124.238", "T07:21", "T07:21:24", "T07:21:24.5", "T07:21:24.", "T7", "T07:2", "T07:21:2456", "T07:21:24.9999999" };
+  const char* zones[] = { "", "Z", "+01", "-01", "+0130", "-01:30", "+1", "+01:3", "Z1", "z", "+", "-0", " " };
+  const char* dates[] = { "2017-06-17", "1969-12-31", "2016-02-29", "2017-13-01", "2017-00-10", "2017-02-31", "0001-01-01", "9999-12-31", "2017-6-17", "17-06-17", "2017/06/17", "2017-06-00" };
+
+  for (unsigned int dIx = 0; dIx < sizeof(dates) / sizeof(dates[0]); ++dIx)
+  {
+    for (unsigned int tIx = 0; tIx < sizeof(times) / sizeof(times[0]); ++tIx)
+    {
+      for (unsigned int zIx = 0; zIx < sizeof(zones) / sizeof(zones[0]); ++zIx)
+      {
+        std::string s = std::string(dates[dIx]) + times[tIx] + zones[zIx];
+
+        EXPECT_EQ(refParse8601Time(s), parse8601Time(s)) << s;
+      }
+    }
+  }
+
+  // Random dates and mutations of them
+  const char* alphabet = "0123456789-:T.Z+ ";
+
+  srand(5);
+
+  for (int ix = 0; ix < 500000; ++ix)
+  {
+    char s[40];
+
+    snprintf(s, sizeof(s), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+             rand() % 10000, rand() % 14, rand() % 33, rand() % 25, rand() % 61, rand() % 62, rand() % 1000);
+
+    for (int mutations = rand() % 4; mutations > 0; --mutations)
+    {
+      s[rand() % strlen(s)] = alphabet[rand() % strlen(alphabet)];
+    }
+
+    EXPECT_EQ(refParse8601Time(s), parse8601Time(s)) << s;
+  }
+
+  EXPECT_EQ(1497684084, parse8601Time("2017-06-17T07:21:24.238Z"));
+  EXPECT_EQ(1497684084 - 3600, parse8601Time("2017-06-17T07:21:24+01:00"));
+  EXPECT_EQ(-1, parse8601Time("2017-06-17T07:21:24.238+01:00:00"));
+}
+
+
+
+/* ****************************************************************************
+*
+* DISABLED_benchmark -
+*
+* Run with --gtest_also_run_disabled_tests --gtest_filter=codec.*, it compares the codec
+* with the snprintf/strtod/gmtime/sscanf based implementations
+*/
+TEST(codec, DISABLED_benchmark)
+{
+  const int         N = 1000000;
+  double            numbers[1000];
+  char              numberStrings[1000][32];
+  struct timespec   t0;
+  struct timespec   t1;
+  size_t            total = 0;
+
+  srand(6);
+
+  for (int ix = 0; ix < 1000; ++ix)
+  {
+    numbers[ix] = randomDouble();
+    snprintf(numberStrings[ix], sizeof(numberStrings[ix]), "%.*f", rand() % 6, numbers[ix]);
+  }
+
+#define BENCH(name, expr)                                                            \
+  clock_gettime(CLOCK_MONOTONIC, &t0);                                               \
+  for (int ix = 0; ix < N; ++ix) { expr; }                                           \
+  clock_gettime(CLOCK_MONOTONIC, &t1);                                               \
+  printf("%-24s %6.1f ns/op\n", name, ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / N)
+
+  BENCH("double2string (ref)", total += refDouble2string(numbers[ix % 1000]).size());
+  BENCH("double2string", total += double2string(numbers[ix % 1000]).size());
+  codecInit(true);
+  BENCH("double2string shortest", total += double2string(numbers[ix % 1000]).size());
+  codecInit(false);
+  BENCH("strtod", total += (size_t) strtod(numberStrings[ix % 1000], NULL));
+  BENCH("doubleParse", total += (size_t) doubleParse(numberStrings[ix % 1000], NULL));
+
+  BENCH("gmtime+strftime", char b[80]; time_t t = 1500000000 + ix / 10; strftime(b, sizeof(b), "%Y-%m-%dT%H:%M:%S.00Z", gmtime(&t)); total += b[0]);
+  BENCH("isodate2str", total += isodate2str(1500000000 + ix / 10).size());
+  BENCH("parse8601Time (ref)", total += refParse8601Time("2017-06-17T07:21:24.238Z"));
+  BENCH("parse8601Time", total += parse8601Time("2017-06-17T07:21:24.238Z"));
+
+#undef BENCH
+
+  EXPECT_NE(0, total);
+}
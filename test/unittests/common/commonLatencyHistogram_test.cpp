@@ -0,0 +1,96 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "gtest/gtest.h"
+
+#include "common/LatencyHistogram.h"
+
+
+
+/* ****************************************************************************
+*
+* buckets -
+*/
+TEST(LatencyHistogram, buckets)
+{
+  // Small values have their own bucket
+  for (unsigned long long value = 0; value < 64; ++value)
+  {
+    EXPECT_EQ(value, LatencyHistogram::highestEquivalentValue(LatencyHistogram::indexFor(value)));
+  }
+
+  // Indexes are monotonic and the relative error is bounded
+  unsigned int lastIndex = 0;
+
+  for (unsigned long long value = 1; value < 100000000ULL; value = value * 3 / 2 + 1)
+  {
+    unsigned int        index   = LatencyHistogram::indexFor(value);
+    unsigned long long  highest = LatencyHistogram::highestEquivalentValue(index);
+
+    EXPECT_GE(index, lastIndex);
+    EXPECT_GE(highest, value);
+    EXPECT_LE(highest - value, value / 32);
+
+    lastIndex = index;
+  }
+
+  // Huge values go to the last bucket
+  EXPECT_EQ(LATENCY_HISTOGRAM_BUCKETS - 1, LatencyHistogram::indexFor(0xFFFFFFFFFFFFFFFFULL));
+}
+
+
+
+/* ****************************************************************************
+*
+* percentiles -
+*/
+TEST(LatencyHistogram, percentiles)
+{
+  LatencyHistogram h;
+
+  EXPECT_EQ(0, h.count());
+  EXPECT_EQ(0, h.valueAtPercentile(50));
+
+  for (unsigned long long value = 1; value <= 10000; ++value)
+  {
+    h.record(value);
+  }
+
+  EXPECT_EQ(10000, h.count());
+  EXPECT_EQ(10000, h.max());
+  EXPECT_DOUBLE_EQ(5000.5, h.mean());
+
+  unsigned long long p50 = h.valueAtPercentile(50);
+  unsigned long long p99 = h.valueAtPercentile(99);
+
+  EXPECT_GE(p50, 5000);
+  EXPECT_LE(p50, 5000 + 5000 / 32);
+  EXPECT_GE(p99, 9900);
+  EXPECT_LE(p99, 10000);
+  EXPECT_EQ(10000, h.valueAtPercentile(100));
+
+  h.reset();
+  EXPECT_EQ(0, h.count());
+  EXPECT_EQ(0, h.max());
+}
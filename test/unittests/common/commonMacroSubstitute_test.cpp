@@ -158,3 +158,49 @@ TEST(commonMacroSubstitute, bufferTooBigAfterSubstitution)
 
   free(base);
 }
+
+
+
+/* ****************************************************************************
+*
+* templateRenderedTwice - a parsed template renders each context element it is given
+*/
+TEST(commonMacroSubstitute, templateRenderedTwice)
+{
+  ContextElement     ce1("E1", "T1", "false");
+  ContextElement     ce2("E2", "T2", "false");
+  ContextAttribute*  ca1P = new ContextAttribute("A1", "T1", "attr1");
+  ContextAttribute*  ca2P = new ContextAttribute("A1", "T1", 42.5);
+  std::string        result;
+
+  ce1.contextAttributeVector.push_back(ca1P);
+  ce2.contextAttributeVector.push_back(ca2P);
+
+  MacroTemplate  t("${id}${id}:${type}, A1=${A1}, A2=${x${y}!");
+
+  EXPECT_TRUE(t.valid);
+  EXPECT_EQ(9, t.segments.size());
+
+  EXPECT_TRUE(t.render(ce1, &result));
+  EXPECT_STREQ("E1E1:T1, A1=attr1, A2=!", result.c_str());
+
+  EXPECT_TRUE(t.render(ce2, &result));
+  EXPECT_STREQ("E2E2:T2, A1=42.5, A2=!", result.c_str());
+}
+
+
+
+/* ****************************************************************************
+*
+* templateSyntaxError -
+*/
+TEST(commonMacroSubstitute, templateSyntaxError)
+{
+  ContextElement  ce("E1", "T1", "false");
+  MacroTemplate   t("Entity ${id");
+  std::string     result = "previous";
+
+  EXPECT_FALSE(t.valid);
+  EXPECT_FALSE(t.render(ce, &result));
+  EXPECT_STREQ("", result.c_str());
+}
@@ -0,0 +1,130 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <regex.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "common/regexCache.h"
+
+
+
+/* ****************************************************************************
+*
+* differential -
+*
+* The result of regexCacheMatch() must be the same as the one of regexec()
+*/
+TEST(regexCache, differential)
+{
+  const char* patterns[] =
+  {
+    "E1", "^E1$", "^E", "1$", "^(E1|E2|Room_3)$", "E1|E2", "^Room|_old$", "^(E1|^E2)$",
+    "^E.*", "^Ro+m", "^Ro*m", "^Ro?m", "^R[o]om", "^Room_[0-9]+$", "^a\\.b$", "a\\|b",
+    "^(Room|Car)_[0-9]$", "^E(1|2)$", ".*", "^$", "a{2}", "^ab{0,1}c", "\\.", "^(E1)$",
+    "^\\$x", "x\\$$", "Room$|^Car|Bus", "(", "[", "a**", "^\\(E1\\)$"
+  };
+  const char* subjects[] =
+  {
+    "", "E", "E1", "E2", "E12", "xE1", "Room_3", "Room_33", "Room", "Rom", "Rm", "Rooom", "Car_1",
+    "Bus_old", "_old", "a.b", "axb", "a|b", "ab", "aa", "ac", "abc", "$x", "x$", "(E1)", "Car", "MyBus"
+  };
+
+  for (unsigned int px = 0; px < sizeof(patterns) / sizeof(patterns[0]); ++px)
+  {
+    regex_t       re;
+    bool          valid = (regcomp(&re, patterns[px], REG_EXTENDED) == 0);
+    CachedRegex*  crP   = regexCacheGet(patterns[px]);
+
+    EXPECT_EQ(valid, crP != NULL) << "pattern: " << patterns[px];
+
+    if (!valid)
+    {
+      continue;
+    }
+
+    for (unsigned int sx = 0; sx < sizeof(subjects) / sizeof(subjects[0]); ++sx)
+    {
+      bool expected = (regexec(&re, subjects[sx], 0, NULL, 0) == 0);
+
+      EXPECT_EQ(expected, regexCacheMatch(crP, subjects[sx])) << "pattern: " << patterns[px] << ", subject: " << subjects[sx];
+    }
+
+    regexCacheRelease(crP);
+    regfree(&re);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* sharing -
+*/
+TEST(regexCache, sharing)
+{
+  CachedRegex* cr1P = regexCacheGet("^shared_[0-9]+$");
+  CachedRegex* cr2P = regexCacheGet("^shared_[0-9]+$");
+  CachedRegex* cr3P = regexCacheGet("^shared_[0-9]+$", REG_EXTENDED | REG_ICASE);
+
+  EXPECT_TRUE(cr1P == cr2P);
+  EXPECT_TRUE(cr1P != cr3P);
+  EXPECT_TRUE(regexCacheMatch(cr3P, "SHARED_1"));
+  EXPECT_FALSE(regexCacheMatch(cr1P, "SHARED_1"));
+
+  regexCacheRelease(cr1P);
+  regexCacheRelease(cr2P);
+  regexCacheRelease(cr3P);
+
+  EXPECT_TRUE(regexCacheValid("^E[0-9]$"));
+  EXPECT_FALSE(regexCacheValid("^E[0-9$"));
+}
+
+
+
+/* ****************************************************************************
+*
+* bounded -
+*/
+TEST(regexCache, bounded)
+{
+  char          pattern[32];
+  CachedRegex*  heldP = regexCacheGet("^held$");
+
+  for (unsigned int ix = 0; ix < REGEX_CACHE_MAX_SIZE + 10; ++ix)
+  {
+    snprintf(pattern, sizeof(pattern), "^p%u[0-9]$", ix);
+    EXPECT_TRUE(regexCacheValid(pattern));
+  }
+
+  EXPECT_LE(regexCacheSize(), REGEX_CACHE_MAX_SIZE);
+
+  // A regular expression in use is not freed
+  EXPECT_TRUE(regexCacheMatch(heldP, "held"));
+  regexCacheRelease(heldP);
+}
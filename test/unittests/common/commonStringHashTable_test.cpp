@@ -0,0 +1,122 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "common/StringHashTable.h"
+
+
+
+/* ****************************************************************************
+*
+* Item -
+*/
+struct Item
+{
+  std::string  name;
+};
+
+
+
+/* ****************************************************************************
+*
+* lookup -
+*/
+TEST(StringHashTable, lookup)
+{
+  StringHashTable<Item, &Item::name, 8>  table;
+  Item                                   a;
+  Item                                   b;
+
+  a.name = "a";
+  b.name = "b";
+
+  EXPECT_EQ(NULL, table.lookup("a", stringHash("a")));
+
+  table.insert(&a, stringHash("a"));
+  table.insert(&b, stringHash("b"));
+
+  EXPECT_EQ(&a, table.lookup("a", stringHash("a")));
+  EXPECT_EQ(&b, table.find("b", stringHash("b")));
+  EXPECT_EQ(NULL, table.find("c", stringHash("c")));
+  EXPECT_EQ(2, table.items());
+}
+
+
+
+/* ****************************************************************************
+*
+* collisions - items with the same hash are found probing the next slots
+*/
+TEST(StringHashTable, collisions)
+{
+  StringHashTable<Item, &Item::name, 8>  table;
+  Item                                   items[3];
+
+  items[0].name = "x";
+  items[1].name = "y";
+  items[2].name = "z";
+
+  for (unsigned int ix = 0; ix < 3; ++ix)
+  {
+    table.insert(&items[ix], 7);
+  }
+
+  for (unsigned int ix = 0; ix < 3; ++ix)
+  {
+    EXPECT_EQ(&items[ix], table.lookup(items[ix].name, 7));
+  }
+
+  EXPECT_EQ(NULL, table.lookup("w", 7));
+}
+
+
+
+/* ****************************************************************************
+*
+* overflow - beyond 3/4 of the table the items are only found with find()
+*/
+TEST(StringHashTable, overflow)
+{
+  StringHashTable<Item, &Item::name, 8>  table;
+  Item                                   items[8];
+  std::vector<Item*>                     itemV;
+
+  for (unsigned int ix = 0; ix < 8; ++ix)
+  {
+    items[ix].name = std::string("item") + (char) ('0' + ix);
+    table.insert(&items[ix], stringHash(items[ix].name));
+  }
+
+  EXPECT_EQ(8, table.items());
+  EXPECT_EQ(NULL, table.lookup("item7", stringHash("item7")));
+  EXPECT_EQ(&items[7], table.find("item7", stringHash("item7")));
+  EXPECT_EQ(&items[0], table.lookup("item0", stringHash("item0")));
+
+  table.all(&itemV);
+  EXPECT_EQ(8, itemV.size());
+}
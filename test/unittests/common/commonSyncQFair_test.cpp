@@ -0,0 +1,159 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/SyncQFair.h"
+
+
+
+/* ****************************************************************************
+*
+* fifo - with a single key the queue works as SyncQOverflow
+*/
+TEST(SyncQFair, fifo)
+{
+  SyncQFair<int> q(3);
+
+  EXPECT_TRUE(q.try_push("", "", 1));
+  EXPECT_TRUE(q.try_push("", "", 2));
+  EXPECT_TRUE(q.try_push("", "", 3));
+  EXPECT_FALSE(q.try_push("", "", 4));
+  EXPECT_EQ(3, q.size());
+
+  EXPECT_EQ(1, q.pop());
+  EXPECT_EQ(2, q.pop());
+  EXPECT_EQ(3, q.pop());
+  EXPECT_EQ(0, q.size());
+  EXPECT_EQ(0, q.keys());
+}
+
+
+
+/* ****************************************************************************
+*
+* roundRobin - a burst of a key doesn't delay the other keys
+*/
+TEST(SyncQFair, roundRobin)
+{
+  SyncQFair<int> q(10);
+
+  for (int ix = 0; ix < 5; ++ix)
+  {
+    EXPECT_TRUE(q.try_push("a", "a", 10 + ix));
+  }
+
+  EXPECT_TRUE(q.try_push("b", "b", 20));
+  EXPECT_TRUE(q.try_push("b", "b", 21));
+  EXPECT_EQ(2, q.keys());
+
+  EXPECT_EQ(10, q.pop());
+  EXPECT_EQ(20, q.pop());
+  EXPECT_EQ(11, q.pop());
+  EXPECT_EQ(21, q.pop());
+  EXPECT_EQ(12, q.pop());
+  EXPECT_EQ(1, q.keys());
+}
+
+
+
+/* ****************************************************************************
+*
+* weights -
+*/
+TEST(SyncQFair, weights)
+{
+  SyncQFair<int> q(20);
+
+  q.configSet("a", 2, 0);
+
+  for (int ix = 0; ix < 6; ++ix)
+  {
+    EXPECT_TRUE(q.try_push("a", "a", 10 + ix));
+    EXPECT_TRUE(q.try_push("b", "b", 20 + ix));
+  }
+
+  int expected[] = { 10, 11, 20, 12, 13, 21, 14, 15, 22, 23, 24, 25 };
+
+  for (unsigned int ix = 0; ix < sizeof(expected) / sizeof(expected[0]); ++ix)
+  {
+    EXPECT_EQ(expected[ix], q.pop()) << "pop " << ix;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* cost - elements costing more than the quantum wait for their deficit
+*/
+TEST(SyncQFair, cost)
+{
+  SyncQFair<int> q(10);
+
+  EXPECT_TRUE(q.try_push("a", "a", 10, 3));
+  EXPECT_TRUE(q.try_push("a", "a", 11, 3));
+  EXPECT_TRUE(q.try_push("b", "b", 20));
+  EXPECT_TRUE(q.try_push("b", "b", 21));
+  EXPECT_TRUE(q.try_push("b", "b", 22));
+  EXPECT_TRUE(q.try_push("b", "b", 23));
+
+  EXPECT_EQ(20, q.pop());
+  EXPECT_EQ(21, q.pop());
+  EXPECT_EQ(10, q.pop());
+  EXPECT_EQ(22, q.pop());
+  EXPECT_EQ(23, q.pop());
+  EXPECT_EQ(11, q.pop());
+}
+
+
+
+/* ****************************************************************************
+*
+* limits - group limits, with the size of the queue as global limit
+*/
+TEST(SyncQFair, limits)
+{
+  SyncQFair<int> q(5);
+
+  q.configSet("*", 1, 2);
+  q.configSet("big", 1, 0);
+
+  // Two keys of the same group share its limit
+  EXPECT_TRUE(q.try_push("a/1", "a", 1));
+  EXPECT_TRUE(q.try_push("a/2", "a", 2));
+  EXPECT_FALSE(q.try_push("a/3", "a", 3));
+
+  EXPECT_TRUE(q.try_push("big", "big", 4));
+  EXPECT_TRUE(q.try_push("big", "big", 5));
+  EXPECT_TRUE(q.try_push("big", "big", 6));
+  EXPECT_FALSE(q.try_push("big", "big", 7));
+  EXPECT_FALSE(q.try_push("b", "b", 8));
+
+  EXPECT_EQ(1, q.pop());
+  EXPECT_TRUE(q.try_push("a/3", "a", 3));
+}
+
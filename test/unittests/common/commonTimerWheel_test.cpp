@@ -0,0 +1,141 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "common/TimerWheel.h"
+
+
+
+/* ****************************************************************************
+*
+* advanceTo - the ticks of the due timers when advancing the wheel up to now
+*/
+static std::vector<int64_t> advanceTo(TimerWheel* wheelP, int64_t now)
+{
+  std::vector<TimerWheelNode*>  due;
+  std::vector<int64_t>          whens;
+
+  wheelP->advance(now, &due);
+
+  for (unsigned int ix = 0; ix < due.size(); ++ix)
+  {
+    whens.push_back(due[ix]->when);
+  }
+
+  return whens;
+}
+
+
+
+/* ****************************************************************************
+*
+* levels - timers at every level are due at their tick, not before
+*/
+TEST(TimerWheel, levels)
+{
+  TimerWheel      wheel(1000);
+  TimerWheelNode  nodes[5];
+  int64_t         whens[5] = { 1001, 1063, 1064 + 64 * 10, 1000 + 64 * 64 * 5 + 7, 1000 + 64 * 64 * 64 * 3 + 1 };
+
+  for (int ix = 0; ix < 5; ++ix)
+  {
+    wheel.schedule(&nodes[ix], whens[ix]);
+  }
+
+  EXPECT_EQ(5, wheel.size());
+
+  for (int ix = 0; ix < 5; ++ix)
+  {
+    EXPECT_EQ(0, advanceTo(&wheel, whens[ix] - 1).size());
+
+    std::vector<int64_t> due = advanceTo(&wheel, whens[ix]);
+
+    ASSERT_EQ(1, due.size());
+    EXPECT_EQ(whens[ix], due[0]);
+    EXPECT_FALSE(wheel.scheduled(&nodes[ix]));
+  }
+
+  EXPECT_EQ(0, wheel.size());
+}
+
+
+
+/* ****************************************************************************
+*
+* pastAndFar - timers in the past are due at the next tick, the ones beyond the last
+* level are placed again until due
+*/
+TEST(TimerWheel, pastAndFar)
+{
+  TimerWheel      wheel(5000);
+  TimerWheelNode  past;
+  TimerWheelNode  far;
+  int64_t         farWhen = 5000 + ((int64_t) 1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) * 2 + 3;
+
+  wheel.schedule(&past, 10);
+  wheel.schedule(&far, farWhen);
+
+  EXPECT_EQ(1, advanceTo(&wheel, 5001).size());
+  EXPECT_EQ(0, advanceTo(&wheel, farWhen - 1).size());
+  EXPECT_EQ(1, advanceTo(&wheel, farWhen).size());
+}
+
+
+
+/* ****************************************************************************
+*
+* cancel - cancelled and re-scheduled timers
+*/
+TEST(TimerWheel, cancel)
+{
+  TimerWheel      wheel(0);
+  TimerWheelNode  n1;
+  TimerWheelNode  n2;
+
+  wheel.schedule(&n1, 10);
+  wheel.schedule(&n2, 20);
+  EXPECT_TRUE(wheel.scheduled(&n1));
+
+  wheel.cancel(&n1);
+  wheel.cancel(&n1);
+  EXPECT_FALSE(wheel.scheduled(&n1));
+  EXPECT_EQ(1, wheel.size());
+
+  // Re-scheduling moves the timer
+  wheel.schedule(&n2, 5);
+  EXPECT_EQ(1, wheel.size());
+
+  std::vector<int64_t> due = advanceTo(&wheel, 30);
+
+  ASSERT_EQ(1, due.size());
+  EXPECT_EQ(5, due[0]);
+
+  wheel.schedule(&n1, 100);
+  wheel.clear();
+  EXPECT_FALSE(wheel.scheduled(&n1));
+  EXPECT_EQ(0, advanceTo(&wheel, 200).size());
+}
@@ -0,0 +1,189 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+#include "gtest/gtest.h"
+
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "ngsi/StringList.h"
+#include "ngsi/ContextElementResponse.h"
+#include "apiTypesV2/Entity.h"
+#include "rest/uriParamNames.h"
+#include "mongoBackend/entityJsonRender.h"
+
+using mongo::BSONObj;
+using mongo::BSONNULL;
+
+
+
+/* ****************************************************************************
+*
+* entityDoc -
+*/
+static BSONObj entityDoc(void)
+{
+  return BSON("_id"       << BSON("id" << "E1" << "type" << "T" << "servicePath" << "/") <<
+              "attrNames" << BSON_ARRAY("A1" << "A2" << "A3" << "A4" << "dateModified" << "dateExpires") <<
+              "attrs"     << BSON("A2" << BSON("type" << "Text" << "value" << "a \"quoted\" text" <<
+                                               "md" << BSON("md=x" << BSON("type" << "Number" << "value" << 2.5) <<
+                                                            "when" << BSON("type" << "DateTime" << "value" << 1500000000.0)) <<
+                                               "creDate" << 1400000000 << "modDate" << 1500000000) <<
+                                  "A1" << BSON("type" << "Number" << "value" << 10.5) <<
+                                  "A3" << BSON("type" << "" <<
+                                               "value" << BSON("k=1" << BSON_ARRAY(1.0 << "x" << true << BSONNULL) <<
+                                                               "k2" << BSONObj())) <<
+                                  "A4()id1" << BSON("type" << "DateTime" << "value" << 1500000000.0) <<
+                                  "dateModified" << BSON("type" << "Text" << "value" << "user defined") <<
+                                  "dateExpires" << BSON("type" << "DateTime" << "value" << 1600000000.0)) <<
+              "creDate"   << 1400000000 <<
+              "modDate"   << 1500000000);
+}
+
+
+
+/* ****************************************************************************
+*
+* legacyRender -
+*
+* The entity rendered the regular way (ContextElementResponse and Entity objects)
+*/
+static std::string legacyRender
+(
+  const BSONObj&                       doc,
+  std::map<std::string, bool>&         options,
+  std::map<std::string, std::string>&  uriParam
+)
+{
+  StringList              attrL;
+  ContextElementResponse  cer(doc, attrL, true, V2);
+  ContextElement*         ceP = &cer.contextElement;
+  Entity                  entity;
+
+  entity.fill(ceP->entityId.id,
+              ceP->entityId.type,
+              ceP->entityId.isPattern,
+              &ceP->contextAttributeVector,
+              ceP->entityId.creDate,
+              ceP->entityId.modDate);
+
+  std::string out = entity.render(options, uriParam);
+
+  entity.release();
+  cer.release();
+
+  return out;
+}
+
+
+
+/* ****************************************************************************
+*
+* transcode -
+*/
+static std::string transcode
+(
+  const BSONObj&                       doc,
+  std::map<std::string, bool>&         options,
+  std::map<std::string, std::string>&  uriParam
+)
+{
+  EntityJsonRender  params;
+  std::string       out;
+
+  EXPECT_TRUE(entityJsonRenderSetup(options, uriParam, &params));
+  EXPECT_TRUE(entityDocToJson(doc, params, &out));
+
+  return out;
+}
+
+
+
+/* ****************************************************************************
+*
+* sameAsObjectModel -
+*/
+TEST(entityJsonRender, sameAsObjectModel)
+{
+  const char* combinations[][4] =
+  {
+    // options       attrs                                    metadata
+    { "",            "",                                      ""                          },
+    { "",            "A3,dateCreated,A1,dateModified,none",   ""                          },
+    { "",            "*,dateCreated,dateModified",            ""                          },
+    { "",            "A2,dateExpires",                        "md.x,dateCreated,ID"       },
+    { "",            "",                                      "*,dateModified"            },
+    { "keyValues",   "",                                      ""                          },
+    { "keyValues",   "A4,dateCreated",                        ""                          },
+    { "values",      "A1,A3,dateModified,dateCreated",        ""                          },
+    { "dateCreated", "",                                      ""                          },
+    { "dateCreated", "A1,dateCreated",                        ""                          }
+  };
+
+  BSONObj doc = entityDoc();
+
+  for (unsigned int ix = 0; ix < sizeof(combinations) / sizeof(combinations[0]); ++ix)
+  {
+    std::map<std::string, bool>         options;
+    std::map<std::string, std::string>  uriParam;
+
+    if (combinations[ix][0][0] != 0)
+    {
+      options[combinations[ix][0]] = true;
+    }
+    uriParam[URI_PARAM_ATTRS]    = combinations[ix][1];
+    uriParam[URI_PARAM_METADATA] = combinations[ix][2];
+
+    EXPECT_EQ(legacyRender(doc, options, uriParam), transcode(doc, options, uriParam)) << "combination " << ix;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* unsupported -
+*/
+TEST(entityJsonRender, unsupported)
+{
+  std::map<std::string, bool>         options;
+  std::map<std::string, std::string>  uriParam;
+  EntityJsonRender                    params;
+  std::string                         out;
+
+  EXPECT_TRUE(entityJsonRenderSetup(options, uriParam, &params));
+
+  // NumberLong values are not rendered by the object model either
+  BSONObj doc = BSON("_id"   << BSON("id" << "E1" << "type" << "T") <<
+                     "attrs" << BSON("A1" << BSON("type" << "Number" << "value" << (long long) 1)));
+
+  EXPECT_FALSE(entityDocToJson(doc, params, &out));
+
+  options[OPT_UNIQUE_VALUES] = true;
+  EXPECT_FALSE(entityJsonRenderSetup(options, uriParam, &params));
+}
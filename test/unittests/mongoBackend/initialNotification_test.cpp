@@ -0,0 +1,392 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "mongo/client/dbclient.h"
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+#include "common/globals.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/initialNotification.h"
+#include "mongoBackend/mongoCreateSubscription.h"
+#include "mongoBackend/mongoUpdateSubscription.h"
+#include "mongoBackend/mongoUnsubscribeContext.h"
+#include "ngsi10/UnsubscribeContextRequest.h"
+#include "ngsi10/UnsubscribeContextResponse.h"
+
+#include "unittests/testInit.h"
+#include "unittests/commonMocks.h"
+#include "unittests/unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::DBClientBase;
+using mongo::BSONObj;
+using ngsiv2::Subscription;
+using ngsiv2::SubscriptionUpdate;
+using ngsiv2::EntID;
+using ::testing::_;
+using ::testing::Invoke;
+
+
+
+/* ****************************************************************************
+*
+* CHUNK_SIZE - entities per notification in these tests
+*/
+#define CHUNK_SIZE  2
+
+
+
+/* ****************************************************************************
+*
+* jobsWait -
+*
+* There is a single DB connection in unit tests, so the test must not use the DB
+* until the job is over.
+*/
+static void jobsWait(void)
+{
+  for (int ix = 0; ix < 5000; ++ix)
+  {
+    if (initialNotificationJobsIdle())
+    {
+      return;
+    }
+
+    usleep(1000);
+  }
+
+  FAIL() << "initial notification job not finished";
+}
+
+
+
+/* ****************************************************************************
+*
+* prepareDatabase -
+*
+* Five entities matching the subscription, so the initial notification takes three
+* pages of CHUNK_SIZE entities.
+*/
+static void prepareDatabase(void)
+{
+  DBClientBase*  connection = getMongoConnection();
+  const char*    ids[]      = { "E1", "E2", "E3", "E4", "E5" };
+
+  for (int ix = 0; ix < 5; ++ix)
+  {
+    BSONObj en = BSON("_id" << BSON("id" << ids[ix] << "type" << "T") <<
+                      "creDate" << 1360232000 + ix <<
+                      "attrNames" << BSON_ARRAY("A") <<
+                      "attrs" << BSON("A" << BSON("type" << "TA" << "value" << "val")));
+
+    connection->insert(ENTITIES_COLL, en);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subscriptionCreate -
+*/
+static std::string subscriptionCreate(void)
+{
+  OrionError    oe;
+  Subscription  sub;
+  EntID         en("", "E.*", "T", "");
+
+  sub.expires     = 1360236300;
+  sub.status      = "active";
+  sub.attrsFormat = NGSI_V2_NORMALIZED;
+
+  sub.subject.entities.push_back(en);
+  sub.notification.httpInfo.url    = "http://foo.bar";
+  sub.notification.httpInfo.custom = false;
+
+  std::string subId = mongoCreateSubscription(sub, &oe, "", servicePathVector, "", "");
+
+  EXPECT_EQ(SccNone, oe.code);
+
+  return subId;
+}
+
+
+
+/* ****************************************************************************
+*
+* cancellationStart -
+*
+* Action of the notifier mock for the first notification of the job: it lets the test
+* thread go on with the cancellation and waits for it to reach the job, which is kept
+* in the middle of the sending until then.
+*/
+static volatile bool notificationSending = false;
+
+static void cancellationStart
+(
+  NotifyContextRequest*            ncr,
+  const ngsiv2::HttpInfo&          httpInfo,
+  const std::string&               tenant,
+  const std::string&               xauthToken,
+  const std::string&               fiwareCorrelator,
+  RenderFormat                     renderFormat,
+  const std::vector<std::string>&  metadataFilter
+)
+{
+  EXPECT_EQ(CHUNK_SIZE, ncr->contextElementResponseVector.size());
+
+  notificationSending = true;
+
+  for (int ix = 0; (ix < 5000) && !initialNotificationJobsLocked(); ++ix)
+  {
+    usleep(1000);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* notificationWait -
+*/
+static void notificationWait(void)
+{
+  for (int ix = 0; ix < 5000; ++ix)
+  {
+    if (notificationSending)
+    {
+      return;
+    }
+
+    usleep(1000);
+  }
+
+  FAIL() << "initial notification not sent";
+}
+
+
+
+/* ****************************************************************************
+*
+* paging -
+*
+* One notification per page, each one incrementing the count of the subscription
+*/
+TEST(initialNotification, paging)
+{
+  utInit(false);
+
+  NotifierMock* notifierMock = new NotifierMock();
+  EXPECT_CALL(*notifierMock, sendNotifyContextRequest(_, _, _, _, _, _, _))
+      .Times(3);
+  setNotifier(notifierMock);
+
+  initialNotificationInit(CHUNK_SIZE);
+  prepareDatabase();
+
+  std::string subId = subscriptionCreate();
+
+  jobsWait();
+  initialNotificationInit(0);
+
+  DBClientBase* connection = getMongoConnection();
+
+  ASSERT_EQ(1, connection->count(SUBSCRIBECONTEXT_COLL, BSONObj()));
+  BSONObj doc = connection->findOne(SUBSCRIBECONTEXT_COLL, BSONObj());
+
+  EXPECT_EQ(subId, doc.getField("_id").OID().toString());
+  EXPECT_EQ(3, doc.getIntField("count"));
+  EXPECT_EQ(1360232700, doc.getIntField("lastNotification"));
+
+  BSONObj initialNotification = doc.getField("initialNotification").embeddedObject();
+  EXPECT_STREQ("done", C_STR_FIELD(initialNotification, "status"));
+  EXPECT_EQ(5, initialNotification.getField("entities").numberLong());
+  EXPECT_EQ(3, initialNotification.getField("notifications").numberLong());
+
+  utExit();
+  delete notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* heldJobsDiscarded -
+*
+* The jobs of a subscription that could not be written in DB are never run
+*/
+TEST(initialNotification, heldJobsDiscarded)
+{
+  EntityIdVector            enV;
+  StringList                attrL;
+  std::vector<std::string>  metadataV;
+  ConditionValueList        condValues;
+  ngsiv2::HttpInfo          httpInfo;
+  Restriction               res;
+  std::vector<std::string>  attrsOrder;
+  long long                 entities;
+  long long                 notifications;
+
+  utInit(false);
+
+  NotifierMock* notifierMock = new NotifierMock();
+  EXPECT_CALL(*notifierMock, sendNotifyContextRequest(_, _, _, _, _, _, _))
+      .Times(0);
+  setNotifier(notifierMock);
+
+  initialNotificationInit(CHUNK_SIZE);
+  prepareDatabase();
+
+  enV.push_back(new EntityId("E.*", "T", "true"));
+  httpInfo.url = "http://foo.bar";
+
+  ASSERT_TRUE(initialNotificationJobAdd("5a8c2d4bd37a1bd1c1b2c3d4", enV, attrL, metadataV, condValues, httpInfo,
+                                        NGSI_V2_NORMALIZED, "", "", servicePathVector, res, "", attrsOrder, false));
+  EXPECT_TRUE(initialNotificationJobHeld("5a8c2d4bd37a1bd1c1b2c3d4"));
+
+  initialNotificationJobsStart("5a8c2d4bd37a1bd1c1b2c3d4", false);
+
+  EXPECT_FALSE(initialNotificationJobHeld("5a8c2d4bd37a1bd1c1b2c3d4"));
+  EXPECT_TRUE(initialNotificationJobsIdle());
+  EXPECT_FALSE(initialNotificationCancel("5a8c2d4bd37a1bd1c1b2c3d4", &entities, &notifications));
+  EXPECT_EQ(0, entities);
+  EXPECT_EQ(0, notifications);
+
+  initialNotificationInit(0);
+  enV.release();
+
+  utExit();
+  delete notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* cancelByUnsubscribe -
+*
+* The job is cancelled while sending its first page, so no other one is sent
+*/
+TEST(initialNotification, cancelByUnsubscribe)
+{
+  UnsubscribeContextRequest   req;
+  UnsubscribeContextResponse  res;
+
+  utInit(false);
+
+  NotifierMock* notifierMock = new NotifierMock();
+  EXPECT_CALL(*notifierMock, sendNotifyContextRequest(_, _, _, _, _, _, _))
+      .WillOnce(Invoke(cancellationStart));
+  setNotifier(notifierMock);
+
+  initialNotificationInit(CHUNK_SIZE);
+  prepareDatabase();
+
+  notificationSending = false;
+
+  std::string subId = subscriptionCreate();
+
+  notificationWait();
+
+  req.subscriptionId.set(subId);
+  EXPECT_EQ(SccOk, mongoUnsubscribeContext(&req, &res));
+  EXPECT_EQ(SccOk, res.statusCode.code);
+
+  jobsWait();
+  initialNotificationInit(0);
+
+  DBClientBase* connection = getMongoConnection();
+  EXPECT_EQ(0, connection->count(SUBSCRIBECONTEXT_COLL, BSONObj()));
+
+  utExit();
+  delete notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* cancelByUpdate -
+*
+* Deactivating the subscription cancels the job, keeping the progress it had
+*/
+TEST(initialNotification, cancelByUpdate)
+{
+  OrionError          oe;
+  SubscriptionUpdate  subUp;
+
+  utInit(false);
+
+  NotifierMock* notifierMock = new NotifierMock();
+  EXPECT_CALL(*notifierMock, sendNotifyContextRequest(_, _, _, _, _, _, _))
+      .WillOnce(Invoke(cancellationStart));
+  setNotifier(notifierMock);
+
+  initialNotificationInit(CHUNK_SIZE);
+  prepareDatabase();
+
+  notificationSending = false;
+
+  std::string subId = subscriptionCreate();
+
+  notificationWait();
+
+  subUp.id             = subId;
+  subUp.status         = "inactive";
+  subUp.statusProvided = true;
+
+  EXPECT_EQ(subId, mongoUpdateSubscription(subUp, &oe, "", servicePathVector, "", ""));
+
+  jobsWait();
+  initialNotificationInit(0);
+
+  DBClientBase* connection = getMongoConnection();
+
+  ASSERT_EQ(1, connection->count(SUBSCRIBECONTEXT_COLL, BSONObj()));
+  BSONObj doc = connection->findOne(SUBSCRIBECONTEXT_COLL, BSONObj());
+
+  EXPECT_STREQ("inactive", C_STR_FIELD(doc, "status"));
+
+  BSONObj initialNotification = doc.getField("initialNotification").embeddedObject();
+  EXPECT_STREQ("cancelled", C_STR_FIELD(initialNotification, "status"));
+  EXPECT_EQ(CHUNK_SIZE, initialNotification.getField("entities").numberLong());
+  EXPECT_EQ(1, initialNotification.getField("notifications").numberLong());
+
+  utExit();
+  delete notifierMock;
+}
@@ -35,6 +35,7 @@
 #include "orionTypes/OrionValueType.h"
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/mongoUpdateContext.h"
+#include "mongoBackend/MongoCommonUpdate.h"
 #include "mongoBackend/mongoQueryContext.h"
 #include "ngsi/EntityId.h"
 #include "ngsi/ContextElementResponse.h"
@@ -4675,6 +4676,257 @@ bool firstTimeTrue(void)
 
 
 
+/* ****************************************************************************
+*
+* updateWithoutReadBeforeWrite -
+*
+* The first update is solved without reading the entity (existing attributes, new values, no
+* subscriptions), the second one goes through the regular path (one of the values doesn't change
+* and another attribute doesn't exist). The outcome has to be the same in both cases.
+*
+* Note the entity cache is not enabled and a concrete service path is used, as in any NGSIv2
+* update request.
+*/
+TEST(mongoUpdateContextRequest, updateWithoutReadBeforeWrite)
+{
+  HttpStatusCode            ms;
+  UpdateContextRequest      req1;
+  UpdateContextResponse     res1;
+  UpdateContextRequest      req2;
+  UpdateContextResponse     res2;
+  std::vector<std::string>  servicePathV;
+  unsigned long long        updates0, fallbacks0;
+  unsigned long long        updates1, fallbacks1;
+  unsigned long long        updates2, fallbacks2;
+
+  utInit();
+
+  servicePathV.push_back("/");
+  updateFastPathCounters(&updates0, &fallbacks0);
+
+  /* Prepare database */
+  prepareDatabaseDifferentNativeTypes();
+
+  /* Forge the first request (from "inside" to "outside") */
+  ContextElement* ce1P = new ContextElement();
+  ce1P->entityId.fill("E1", "T1", "false");
+  ContextAttribute* ca1P = new ContextAttribute("A1", "T", "s2");
+  ContextAttribute* ca2P = new ContextAttribute("A3", "", true);
+  ce1P->contextAttributeVector.push_back(ca1P);
+  ce1P->contextAttributeVector.push_back(ca2P);
+  req1.contextElementVector.push_back(ce1P);
+  req1.updateActionType = ActionTypeUpdate;
+
+  /* Invoke the function in mongoBackend library */
+  ms = mongoUpdateContext(&req1, &res1, "", servicePathV, uriParams, "", "", "", V2);
+
+  /* Check response is as expected */
+  EXPECT_EQ(SccOk, ms);
+  EXPECT_EQ(SccNone, res1.oe.code);
+
+  ASSERT_EQ(1, res1.contextElementResponseVector.size());
+  EXPECT_EQ("E1", res1.contextElementResponseVector[0]->contextElement.entityId.id);
+  EXPECT_EQ("T1", res1.contextElementResponseVector[0]->contextElement.entityId.type);
+  ASSERT_EQ(2, res1.contextElementResponseVector[0]->contextElement.contextAttributeVector.size());
+  EXPECT_EQ("A1", res1.contextElementResponseVector[0]->contextElement.contextAttributeVector[0]->name);
+  EXPECT_EQ("A3", res1.contextElementResponseVector[0]->contextElement.contextAttributeVector[1]->name);
+  EXPECT_EQ(SccOk, res1.contextElementResponseVector[0]->statusCode.code);
+
+  /* Check the update was done in one round trip */
+  updateFastPathCounters(&updates1, &fallbacks1);
+  EXPECT_EQ(updates0 + 1, updates1);
+  EXPECT_EQ(fallbacks0, fallbacks1);
+
+  /* Forge the second request */
+  ContextElement* ce2P = new ContextElement();
+  ce2P->entityId.fill("E1", "T1", "false");
+  ContextAttribute* ca3P = new ContextAttribute("A2", "T", 42.0);
+  ContextAttribute* ca4P = new ContextAttribute("A7", "T", "x");
+  ce2P->contextAttributeVector.push_back(ca3P);
+  ce2P->contextAttributeVector.push_back(ca4P);
+  req2.contextElementVector.push_back(ce2P);
+  req2.updateActionType = ActionTypeUpdate;
+
+  ms = mongoUpdateContext(&req2, &res2, "", servicePathV, uriParams, "", "", "", V2);
+
+  EXPECT_EQ(SccOk, ms);
+  EXPECT_EQ(SccContextElementNotFound, res2.oe.code);
+  EXPECT_EQ(ERROR_DESC_NOT_FOUND_ATTRIBUTE, res2.oe.details);
+
+  /* Check the $exists condition made the update fall back to the regular path */
+  updateFastPathCounters(&updates2, &fallbacks2);
+  EXPECT_EQ(updates1, updates2);
+  EXPECT_EQ(fallbacks1 + 1, fallbacks2);
+
+  /* Check that every involved collection at MongoDB is as expected */
+  DBClientBase* connection = getMongoConnection();
+
+  /* entities collection */
+  BSONObj ent, attrs;
+  ASSERT_EQ(1, connection->count(ENTITIES_COLL, BSONObj()));
+
+  ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E1" << "_id.type" << "T1"));
+  EXPECT_EQ(1360232700, ent.getIntField("modDate"));
+  EXPECT_STREQ("", C_STR_FIELD(ent, "lastCorrelator"));
+  attrs = ent.getField("attrs").embeddedObject();
+  ASSERT_EQ(6, attrs.nFields());
+  BSONObj a1 = attrs.getField("A1").embeddedObject();
+  BSONObj a2 = attrs.getField("A2").embeddedObject();
+  BSONObj a3 = attrs.getField("A3").embeddedObject();
+  BSONObj a4 = attrs.getField("A4").embeddedObject();
+  EXPECT_STREQ("T", C_STR_FIELD(a1, "type"));
+  EXPECT_STREQ("s2", C_STR_FIELD(a1, "value"));
+  EXPECT_EQ(1360232700, a1.getIntField("modDate"));
+  EXPECT_EQ(0, a1.getField("mdNames").Array().size());
+  EXPECT_FALSE(a1.hasField("md"));
+  EXPECT_EQ(42, a2.getField("value").Number());
+  EXPECT_FALSE(a2.hasField("modDate"));
+  EXPECT_STREQ("T", C_STR_FIELD(a3, "type"));
+  EXPECT_TRUE(a3.getBoolField("value"));
+  EXPECT_EQ(1360232700, a3.getIntField("modDate"));
+  EXPECT_FALSE(a4.hasField("modDate"));
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* updateWithoutReadBeforeWriteUnchangedValue -
+*
+* One of the values doesn't change, so the $ne condition of the single round-trip update
+* doesn't hold and the regular path is used, which updates only the other attribute.
+*/
+TEST(mongoUpdateContextRequest, updateWithoutReadBeforeWriteUnchangedValue)
+{
+  HttpStatusCode            ms;
+  UpdateContextRequest      req;
+  UpdateContextResponse     res;
+  std::vector<std::string>  servicePathV;
+  unsigned long long        updates0, fallbacks0;
+  unsigned long long        updates1, fallbacks1;
+
+  utInit();
+
+  /* Prepare database */
+  prepareDatabaseDifferentNativeTypes();
+
+  servicePathV.push_back("/");
+  updateFastPathCounters(&updates0, &fallbacks0);
+
+  /* Forge the request (from "inside" to "outside") */
+  ContextElement* ceP = new ContextElement();
+  ceP->entityId.fill("E1", "T1", "false");
+  ContextAttribute* ca1P = new ContextAttribute("A1", "T", "s");
+  ContextAttribute* ca2P = new ContextAttribute("A2", "T", 43.0);
+  ceP->contextAttributeVector.push_back(ca1P);
+  ceP->contextAttributeVector.push_back(ca2P);
+  req.contextElementVector.push_back(ceP);
+  req.updateActionType = ActionTypeUpdate;
+
+  /* Invoke the function in mongoBackend library */
+  ms = mongoUpdateContext(&req, &res, "", servicePathV, uriParams, "", "", "", V2);
+
+  /* Check response is as expected */
+  EXPECT_EQ(SccOk, ms);
+  EXPECT_EQ(SccNone, res.oe.code);
+  ASSERT_EQ(1, res.contextElementResponseVector.size());
+  EXPECT_EQ(SccOk, res.contextElementResponseVector[0]->statusCode.code);
+
+  updateFastPathCounters(&updates1, &fallbacks1);
+  EXPECT_EQ(updates0, updates1);
+  EXPECT_EQ(fallbacks0 + 1, fallbacks1);
+
+  /* Check that every involved collection at MongoDB is as expected */
+  DBClientBase* connection = getMongoConnection();
+
+  BSONObj ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E1" << "_id.type" << "T1"));
+  BSONObj attrs = ent.getField("attrs").embeddedObject();
+  BSONObj a1 = attrs.getField("A1").embeddedObject();
+  BSONObj a2 = attrs.getField("A2").embeddedObject();
+  EXPECT_STREQ("s", C_STR_FIELD(a1, "value"));
+  EXPECT_FALSE(a1.hasField("modDate"));
+  EXPECT_EQ(43, a2.getField("value").Number());
+  EXPECT_EQ(1360232700, a2.getIntField("modDate"));
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* updateWithoutReadBeforeWriteLocation -
+*
+* The updated attribute holds the entity location, so the $nin condition of the single
+* round-trip update doesn't hold and the regular path is used. Being a non geo attribute in
+* NGSIv2, the location of the entity is removed.
+*/
+TEST(mongoUpdateContextRequest, updateWithoutReadBeforeWriteLocation)
+{
+  HttpStatusCode            ms;
+  UpdateContextRequest      req;
+  UpdateContextResponse     res;
+  std::vector<std::string>  servicePathV;
+  unsigned long long        updates0, fallbacks0;
+  unsigned long long        updates1, fallbacks1;
+
+  utInit();
+
+  /* Prepare database */
+  setupDatabase();
+
+  DBClientBase* connection = getMongoConnection();
+
+  BSONObj en1 = BSON("_id" << BSON("id" << "E1" << "type" << "T1") <<
+                     "attrNames" << BSON_ARRAY("A1" << "A2") <<
+                     "attrs" << BSON(
+                       "A1" << BSON("type" << "geo:point" << "value" << "3, 2") <<
+                       "A2" << BSON("type" << "T" << "value" << "s")) <<
+                     "location" << BSON("attrName" << "A1" <<
+                                        "coords" << BSON("type" << "Point" <<
+                                                         "coordinates" << BSON_ARRAY(2.0 << 3.0))));
+
+  connection->insert(ENTITIES_COLL, en1);
+
+  servicePathV.push_back("/");
+  updateFastPathCounters(&updates0, &fallbacks0);
+
+  /* Forge the request (from "inside" to "outside") */
+  ContextElement* ceP = new ContextElement();
+  ceP->entityId.fill("E1", "T1", "false");
+  ContextAttribute* caP = new ContextAttribute("A1", "T", "nowhere");
+  ceP->contextAttributeVector.push_back(caP);
+  req.contextElementVector.push_back(ceP);
+  req.updateActionType = ActionTypeUpdate;
+
+  /* Invoke the function in mongoBackend library */
+  ms = mongoUpdateContext(&req, &res, "", servicePathV, uriParams, "", "", "", V2);
+
+  /* Check response is as expected */
+  EXPECT_EQ(SccOk, ms);
+  EXPECT_EQ(SccNone, res.oe.code);
+  ASSERT_EQ(1, res.contextElementResponseVector.size());
+  EXPECT_EQ(SccOk, res.contextElementResponseVector[0]->statusCode.code);
+
+  updateFastPathCounters(&updates1, &fallbacks1);
+  EXPECT_EQ(updates0, updates1);
+  EXPECT_EQ(fallbacks0 + 1, fallbacks1);
+
+  /* Check that every involved collection at MongoDB is as expected */
+  BSONObj ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E1" << "_id.type" << "T1"));
+  BSONObj attrs = ent.getField("attrs").embeddedObject();
+  BSONObj a1 = attrs.getField("A1").embeddedObject();
+  EXPECT_STREQ("T", C_STR_FIELD(a1, "type"));
+  EXPECT_STREQ("nowhere", C_STR_FIELD(a1, "value"));
+  EXPECT_FALSE(ent.hasField("location"));
+
+  utExit();
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoDbUpdateFail -
@@ -0,0 +1,355 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "mongo/client/dbclient.h"
+
+#include "common/globals.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/MongoCommonUpdate.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/mongoCreateSubscription.h"
+#include "mongoBackend/mongoUpdateContext.h"
+#include "ngsi10/UpdateContextRequest.h"
+#include "ngsi10/UpdateContextResponse.h"
+#include "cache/subCache.h"
+
+#include "unittests/testInit.h"
+#include "unittests/commonMocks.h"
+#include "unittests/unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* USING
+*/
+using mongo::DBClientBase;
+using mongo::BSONObj;
+using ngsiv2::Subscription;
+using ngsiv2::EntID;
+using ::testing::_;
+using ::testing::Invoke;
+
+
+
+/* ****************************************************************************
+*
+* ENTITIES - number of entities in the batch updates of these tests
+*/
+#define ENTITIES  3
+
+
+
+/* ****************************************************************************
+*
+* notifications - number of entities of each notification sent, by url
+*/
+static std::map<std::string, std::vector<unsigned int> > notifications;
+
+static void notificationCollect
+(
+  NotifyContextRequest*            ncr,
+  const ngsiv2::HttpInfo&          httpInfo,
+  const std::string&               tenant,
+  const std::string&               xauthToken,
+  const std::string&               fiwareCorrelator,
+  RenderFormat                     renderFormat,
+  const std::vector<std::string>&  metadataFilter
+)
+{
+  notifications[httpInfo.url].push_back(ncr->contextElementResponseVector.size());
+}
+
+
+
+/* ****************************************************************************
+*
+* subscriptionCreate -
+*
+* Subscription to all the entities of type T, notified to url
+*/
+static std::string subscriptionCreate
+(
+  const std::string&  url,
+  RenderFormat        attrsFormat,
+  bool                custom,
+  long long           throttling
+)
+{
+  extern bool   noCache;
+  OrionError    oe;
+  Subscription  sub;
+  EntID         en("", "E.*", "T", "");
+
+  noCache = false;
+
+  sub.expires     = 1879048191;
+  sub.throttling  = throttling;
+  sub.status      = "active";
+  sub.attrsFormat = attrsFormat;
+
+  sub.subject.entities.push_back(en);
+  sub.notification.httpInfo.url    = url;
+  sub.notification.httpInfo.custom = custom;
+
+  std::string subId = mongoCreateSubscription(sub, &oe, "", servicePathVector, "", "");
+
+  EXPECT_EQ(SccNone, oe.code);
+
+  return subId;
+}
+
+
+
+/* ****************************************************************************
+*
+* prepareDatabase -
+*
+* The entities are created after the subscriptions, so there is no initial notification
+*/
+static void prepareDatabase(void)
+{
+  DBClientBase* connection = getMongoConnection();
+
+  for (int ix = 0; ix < ENTITIES; ++ix)
+  {
+    std::string id = std::string("E") + (char) ('1' + ix);
+
+    BSONObj en = BSON("_id" << BSON("id" << id << "type" << "T") <<
+                      "attrNames" << BSON_ARRAY("A") <<
+                      "attrs" << BSON("A" << BSON("type" << "TA" << "value" << "old")));
+
+    connection->insert(ENTITIES_COLL, en);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* batchUpdate - update of the A attribute of all the entities
+*/
+static void batchUpdate(void)
+{
+  UpdateContextRequest   req;
+  UpdateContextResponse  res;
+
+  for (int ix = 0; ix < ENTITIES; ++ix)
+  {
+    ContextElement* ceP = new ContextElement();
+
+    ceP->entityId.fill(std::string("E") + (char) ('1' + ix), "T", "false");
+    ceP->contextAttributeVector.push_back(new ContextAttribute("A", "TA", "new"));
+    req.contextElementVector.push_back(ceP);
+  }
+
+  req.updateActionType = ActionTypeUpdate;
+
+  notifications.clear();
+
+  EXPECT_EQ(SccOk, mongoUpdateContext(&req, &res, "", servicePathVector, uriParams, "", "", ""));
+  EXPECT_EQ(ENTITIES, res.contextElementResponseVector.size());
+
+  req.release();
+  res.release();
+}
+
+
+
+/* ****************************************************************************
+*
+* countGet - count of a cached subscription
+*/
+static long long countGet(const std::string& subId)
+{
+  CachedSubscription* cSubP = subCacheItemLookup("", subId.c_str());
+
+  return (cSubP == NULL)? -1 : cSubP->count;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifierMockSet -
+*/
+static NotifierMock* notifierMockSet(void)
+{
+  NotifierMock* notifierMock = new NotifierMock();
+
+  EXPECT_CALL(*notifierMock, sendNotifyContextRequest(_, _, _, _, _, _, _))
+      .WillRepeatedly(Invoke(notificationCollect));
+  setNotifier(notifierMock);
+
+  return notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* onePerSubscription -
+*
+* A single notification with all the entities of the request, counted once
+*/
+TEST(notificationBatch, onePerSubscription)
+{
+  utInit(false);
+
+  NotifierMock* notifierMock = notifierMockSet();
+
+  subCacheInit();
+  notificationBatchInit(1024 * 1024);
+
+  std::string subId = subscriptionCreate("http://notify1.me", NGSI_V2_NORMALIZED, false, -1);
+
+  prepareDatabase();
+  batchUpdate();
+
+  ASSERT_EQ(1, notifications["http://notify1.me"].size());
+  EXPECT_EQ(ENTITIES, notifications["http://notify1.me"][0]);
+  EXPECT_EQ(1, countGet(subId));
+
+  notificationBatchInit(0);
+
+  utExit();
+  delete notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* splitAtSizeLimit -
+*
+* With a maximum size smaller than a rendered entity, each notification has a single
+* entity, and count is incremented by the number of notifications sent
+*/
+TEST(notificationBatch, splitAtSizeLimit)
+{
+  utInit(false);
+
+  NotifierMock* notifierMock = notifierMockSet();
+
+  subCacheInit();
+  notificationBatchInit(1);
+
+  std::string subId = subscriptionCreate("http://notify1.me", NGSI_V2_NORMALIZED, false, -1);
+
+  prepareDatabase();
+  batchUpdate();
+
+  ASSERT_EQ(ENTITIES, notifications["http://notify1.me"].size());
+
+  for (unsigned int ix = 0; ix < ENTITIES; ++ix)
+  {
+    EXPECT_EQ(1, notifications["http://notify1.me"][ix]);
+  }
+
+  EXPECT_EQ(ENTITIES, countGet(subId));
+
+  notificationBatchInit(0);
+
+  utExit();
+  delete notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* throttlingSingleNotification -
+*
+* A subscription with throttling gets only the first notification of a split batch
+*/
+TEST(notificationBatch, throttlingSingleNotification)
+{
+  utInit(false);
+
+  NotifierMock* notifierMock = notifierMockSet();
+
+  subCacheInit();
+  notificationBatchInit(1);
+
+  std::string subId = subscriptionCreate("http://notify1.me", NGSI_V2_NORMALIZED, false, 10);
+
+  prepareDatabase();
+  batchUpdate();
+
+  ASSERT_EQ(1, notifications["http://notify1.me"].size());
+  EXPECT_EQ(1, notifications["http://notify1.me"][0]);
+  EXPECT_EQ(1, countGet(subId));
+
+  notificationBatchInit(0);
+
+  utExit();
+  delete notifierMock;
+}
+
+
+
+/* ****************************************************************************
+*
+* customAndV1PerEntity -
+*
+* Custom notifications and notifications in NGSIv1 format are not grouped
+*/
+TEST(notificationBatch, customAndV1PerEntity)
+{
+  utInit(false);
+
+  NotifierMock* notifierMock = notifierMockSet();
+
+  subCacheInit();
+  notificationBatchInit(1024 * 1024);
+
+  std::string subId1 = subscriptionCreate("http://notify1.me", NGSI_V2_NORMALIZED, false, -1);
+  std::string subId2 = subscriptionCreate("http://notify2.me", NGSI_V2_NORMALIZED, true,  -1);
+  std::string subId3 = subscriptionCreate("http://notify3.me", NGSI_V1_LEGACY,     false, -1);
+
+  prepareDatabase();
+  batchUpdate();
+
+  ASSERT_EQ(1, notifications["http://notify1.me"].size());
+  EXPECT_EQ(ENTITIES, notifications["http://notify1.me"][0]);
+  EXPECT_EQ(1, countGet(subId1));
+
+  ASSERT_EQ(ENTITIES, notifications["http://notify2.me"].size());
+  EXPECT_EQ(ENTITIES, countGet(subId2));
+
+  ASSERT_EQ(ENTITIES, notifications["http://notify3.me"].size());
+  EXPECT_EQ(1, notifications["http://notify3.me"][0]);
+  EXPECT_EQ(ENTITIES, countGet(subId3));
+
+  notificationBatchInit(0);
+
+  utExit();
+  delete notifierMock;
+}
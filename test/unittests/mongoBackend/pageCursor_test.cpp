@@ -0,0 +1,67 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "gtest/gtest.h"
+
+#include "mongo/client/dbclient.h"
+
+#include "mongoBackend/pageCursor.h"
+
+using mongo::BSONObj;
+
+
+
+/* ****************************************************************************
+*
+* roundTrip -
+*/
+TEST(pageCursor, roundTrip)
+{
+  BSONObj      key   = BSON("c" << 1500000000 << "i" << BSON("id" << "E1" << "type" << "T" << "servicePath" << "/"));
+  std::string  token = pageCursorEncode(key);
+  BSONObj      decoded;
+
+  EXPECT_EQ(key.objsize() * 2, (int) token.size());
+  EXPECT_TRUE(pageCursorDecode(token, &decoded));
+  EXPECT_TRUE(key.binaryEqual(decoded));
+}
+
+
+
+/* ****************************************************************************
+*
+* invalid -
+*/
+TEST(pageCursor, invalid)
+{
+  BSONObj      decoded;
+  std::string  token = pageCursorEncode(BSON("i" << "x"));
+
+  EXPECT_FALSE(pageCursorDecode("", &decoded));
+  EXPECT_FALSE(pageCursorDecode("05000000", &decoded));             // too short
+  EXPECT_FALSE(pageCursorDecode("zz00000000", &decoded));           // not hex
+  EXPECT_FALSE(pageCursorDecode(token.substr(1), &decoded));        // odd length
+  EXPECT_FALSE(pageCursorDecode(token.substr(2) + "00", &decoded)); // wrong size prefix
+  EXPECT_FALSE(pageCursorDecode("0600000000", &decoded));           // size not matching
+}
@@ -0,0 +1,74 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mongo/client/dbclient.h"
+
+#include "mongoBackend/MongoGlobal.h"
+
+using mongo::BSONObj;
+using mongo::BSONArray;
+
+
+
+/* ****************************************************************************
+*
+* scopes -
+*/
+TEST(servicePathScopes, scopes)
+{
+  EXPECT_TRUE(BSON_ARRAY("/#" << "/").binaryEqual(servicePathScopes("/")));
+  EXPECT_TRUE(BSON_ARRAY("/#" << "/").binaryEqual(servicePathScopes("")));
+  EXPECT_TRUE(BSON_ARRAY("/#" << "/a/#" << "/a").binaryEqual(servicePathScopes("/a")));
+  EXPECT_TRUE(BSON_ARRAY("/#" << "/a/#" << "/a/b/#" << "/a/b/c/#" << "/a/b/c").binaryEqual(servicePathScopes("/a/b/c")));
+}
+
+
+
+/* ****************************************************************************
+*
+* query -
+*/
+TEST(servicePathScopes, query)
+{
+  std::vector<std::string> servicePathV;
+
+  servicePathV.push_back("");
+
+  setServicePathIndex(true);
+  EXPECT_STREQ("spScopes", entityServicePathField());
+  EXPECT_TRUE(BSON("$in" << BSON_ARRAY("/#")).binaryEqual(fillQueryEntityServicePath(servicePathV)));
+
+  servicePathV[0] = "/a/#";
+  servicePathV.push_back("/b");
+  EXPECT_TRUE(BSON("$in" << BSON_ARRAY("/a/#" << "/b")).binaryEqual(fillQueryEntityServicePath(servicePathV)));
+
+  setServicePathIndex(false);
+  EXPECT_STREQ("_id.servicePath", entityServicePathField());
+  EXPECT_TRUE(fillQueryServicePath(servicePathV).binaryEqual(fillQueryEntityServicePath(servicePathV)));
+}
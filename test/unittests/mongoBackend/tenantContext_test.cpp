@@ -0,0 +1,92 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/tenantContext.h"
+
+
+
+/* ****************************************************************************
+*
+* lookup -
+*/
+TEST(tenantContext, lookup)
+{
+  setDbPrefix("utest");
+  setEntitiesCollectionName("entities");
+
+  TenantContext* t1P = tenantContextGet("t1");
+  TenantContext* t2P = tenantContextGet("t2");
+
+  EXPECT_TRUE(t1P == tenantContextGet("t1"));
+  EXPECT_TRUE(t1P != t2P);
+  EXPECT_EQ("t1", t1P->tenant);
+  EXPECT_EQ(composeDatabaseName("t1"), t1P->dbName);
+  EXPECT_EQ(composeCollectionName("t1", ColEntities), t1P->entitiesCollection);
+
+  // Names are composed again after a change
+  t1P->entityIndexesEnsured = true;
+  setEntitiesCollectionName("entities2");
+
+  EXPECT_TRUE(t1P == tenantContextGet("t1"));
+  EXPECT_EQ(composeDatabaseName("t1") + ".entities2", t1P->entitiesCollection);
+  EXPECT_FALSE(t1P->entityIndexesEnsured);
+
+  setEntitiesCollectionName("entities");
+}
+
+
+
+/* ****************************************************************************
+*
+* overflow -
+*/
+TEST(tenantContext, overflow)
+{
+  char tenant[32];
+
+  for (unsigned int ix = 0; ix < TENANT_REGISTRY_SIZE; ++ix)
+  {
+    snprintf(tenant, sizeof(tenant), "overflow%u", ix);
+    tenantContextGet(tenant);
+  }
+
+  EXPECT_GE(tenantContextCount(), (unsigned int) TENANT_REGISTRY_SIZE);
+
+  // Tenants in the lock-free table and in the overflow map are found the same way
+  for (unsigned int ix = 0; ix < TENANT_REGISTRY_SIZE; ++ix)
+  {
+    snprintf(tenant, sizeof(tenant), "overflow%u", ix);
+
+    TenantContext* tcP = tenantContextGet(tenant);
+
+    EXPECT_EQ(tenant, tcP->tenant);
+  }
+}
@@ -86,3 +86,55 @@ TEST(Scope, check)
 
   utExit();
 }
+
+
+
+/* ****************************************************************************
+*
+* clone - the clone must not share points nor string filters with the original
+*/
+TEST(Scope, clone)
+{
+  Scope         geoScope(FIWARE_LOCATION_V2, "");
+  Scope         qScope(SCOPE_TYPE_SIMPLE_QUERY, "temperature>20");
+  Scope*        cloneP;
+  std::string   err;
+
+  utInit();
+
+  EXPECT_EQ(0, geoScope.fill(V2, "polygon", "0,0;0,10;10,10;0,0", "coveredBy", &err));
+
+  cloneP = geoScope.clone(&err);
+  ASSERT_TRUE(cloneP != NULL);
+  EXPECT_EQ(orion::PolygonType, cloneP->areaType);
+  ASSERT_EQ(geoScope.polygon.vertexList.size(), cloneP->polygon.vertexList.size());
+
+  for (unsigned int ix = 0; ix < cloneP->polygon.vertexList.size(); ++ix)
+  {
+    EXPECT_NE(geoScope.polygon.vertexList[ix], cloneP->polygon.vertexList[ix]);
+    EXPECT_EQ(geoScope.polygon.vertexList[ix]->latitude(), cloneP->polygon.vertexList[ix]->latitude());
+    EXPECT_EQ(geoScope.polygon.vertexList[ix]->longitude(), cloneP->polygon.vertexList[ix]->longitude());
+  }
+
+  cloneP->release();
+  delete cloneP;
+
+  qScope.stringFilterP = new StringFilter(SftQ);
+  EXPECT_TRUE(qScope.stringFilterP->parse(qScope.value.c_str(), &err));
+
+  cloneP = qScope.clone(&err);
+  ASSERT_TRUE(cloneP != NULL);
+  EXPECT_EQ(SCOPE_TYPE_SIMPLE_QUERY, cloneP->type);
+  ASSERT_TRUE(cloneP->stringFilterP != NULL);
+  EXPECT_NE(qScope.stringFilterP, cloneP->stringFilterP);
+  EXPECT_EQ(qScope.stringFilterP->filters.size(), cloneP->stringFilterP->filters.size());
+  EXPECT_TRUE(cloneP->mdStringFilterP == NULL);
+
+  cloneP->release();
+  delete cloneP;
+
+  geoScope.release();
+  qScope.release();
+
+  utExit();
+}
@@ -176,3 +176,40 @@ TEST(NotifyContextRequest, json_render)
 
   utExit();
 }
+
+
+
+/* ****************************************************************************
+*
+* toJson_renderedData -
+*/
+TEST(NotifyContextRequest, toJson_renderedData)
+{
+  NotifyContextRequest      ncr;
+  ContextElementResponse*   cerP = new ContextElementResponse();
+  std::vector<std::string>  metadataFilter;
+  std::string               data;
+
+  utInit();
+
+  ncr.subscriptionId.set("012345678901234567890123");
+  cerP->contextElement.entityId.fill("E01", "EType", "false");
+  cerP->contextElement.contextAttributeVector.push_back(new ContextAttribute("A1", "Number", 42.0));
+  ncr.contextElementResponseVector.push_back(cerP);
+
+  std::string rendered = ncr.toJson(NGSI_V2_KEYVALUES, metadataFilter);
+
+  EXPECT_EQ("{\"subscriptionId\":\"012345678901234567890123\",\"data\":[{\"id\":\"E01\",\"type\":\"EType\",\"A1\":42}]}", rendered);
+
+  // Rendering shared with another notification, used as is
+  data              = cerP->toJson(NGSI_V2_KEYVALUES, metadataFilter);
+  ncr.renderedDataP = &data;
+  ncr.subscriptionId.set("123456789012345678901234");
+
+  EXPECT_EQ("{\"subscriptionId\":\"123456789012345678901234\",\"data\":[{\"id\":\"E01\",\"type\":\"EType\",\"A1\":42}]}",
+            ncr.toJson(NGSI_V2_KEYVALUES, metadataFilter));
+
+  ncr.release();
+
+  utExit();
+}
@@ -0,0 +1,137 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "gtest/gtest.h"
+
+#include "ngsiNotify/destinationHealth.h"
+
+
+
+/* ****************************************************************************
+*
+* disabled -
+*/
+TEST(destinationHealth, disabled)
+{
+  destinationHealthInit(0, 0);
+
+  EXPECT_FALSE(destinationHealthActive());
+  EXPECT_TRUE(destinationHealthGet("localhost", 9997) == NULL);
+}
+
+
+
+/* ****************************************************************************
+*
+* circuitBreaker -
+*/
+TEST(destinationHealth, circuitBreaker)
+{
+  destinationHealthInit(2, 0);
+
+  DestinationHealth* dhP = destinationHealthGet("breaker", 9997);
+
+  ASSERT_TRUE(dhP != NULL);
+  EXPECT_EQ(dhP, destinationHealthGet("breaker", 9997));
+  EXPECT_NE(dhP, destinationHealthGet("breaker", 9998));
+
+  // Two consecutive failures open the circuit
+  EXPECT_TRUE(destinationAdmit(dhP));
+  destinationDone(dhP, false, 0);
+  EXPECT_EQ(BreakerClosed, dhP->state);
+  EXPECT_TRUE(destinationAdmit(dhP));
+  destinationDone(dhP, false, 0);
+  EXPECT_EQ(BreakerOpen, dhP->state);
+  EXPECT_EQ(1, dhP->opens);
+
+  // Fast fail while open
+  EXPECT_FALSE(destinationAdmit(dhP));
+  EXPECT_EQ(1, dhP->fastFails);
+
+  // Backoff time elapsed: one probe, the rest fail fast. The probe fails and the backoff doubles
+  dhP->retryAt = 0;
+  EXPECT_TRUE(destinationAdmit(dhP));
+  EXPECT_EQ(BreakerHalfOpen, dhP->state);
+  EXPECT_FALSE(destinationAdmit(dhP));
+  EXPECT_EQ(2, dhP->fastFails);
+  destinationDone(dhP, false, 0);
+  EXPECT_EQ(BreakerOpen, dhP->state);
+  EXPECT_EQ(4 * DESTINATION_BACKOFF_MIN, dhP->backoff);
+
+  // Successful probe closes the circuit
+  dhP->retryAt = 0;
+  EXPECT_TRUE(destinationAdmit(dhP));
+  destinationDone(dhP, true, 1000);
+  EXPECT_EQ(BreakerClosed, dhP->state);
+  EXPECT_EQ(DESTINATION_BACKOFF_MIN, dhP->backoff);
+  EXPECT_EQ(0, dhP->consecutiveFailures);
+  EXPECT_EQ(0, dhP->inFlight);
+
+  destinationHealthReset();
+  EXPECT_EQ(0, dhP->fastFails);
+  EXPECT_EQ(0, dhP->failures);
+
+  destinationHealthInit(0, 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* inFlightLimit -
+*/
+TEST(destinationHealth, inFlightLimit)
+{
+  destinationHealthInit(0, 2);
+
+  DestinationHealth* dhP = destinationHealthGet("limit", 9997);
+
+  ASSERT_TRUE(dhP != NULL);
+  EXPECT_EQ(2, dhP->limit);
+
+  EXPECT_TRUE(destinationAdmit(dhP));
+  EXPECT_TRUE(destinationAdmit(dhP));
+  EXPECT_FALSE(destinationAdmit(dhP));
+  EXPECT_EQ(1, dhP->limited);
+
+  destinationDone(dhP, true, 1000);
+  destinationDone(dhP, true, 1000);
+  EXPECT_EQ(0, dhP->inFlight);
+  EXPECT_EQ(2, dhP->limit);
+
+  // Failures decrease the limit, fast notifications increase it again
+  EXPECT_TRUE(destinationAdmit(dhP));
+  destinationDone(dhP, false, 0);
+  EXPECT_EQ(1, dhP->limit);
+  EXPECT_TRUE(destinationAdmit(dhP));
+  destinationDone(dhP, true, 1000);
+  EXPECT_EQ(2, dhP->limit);
+
+  // A notification much slower than the baseline decreases it
+  EXPECT_TRUE(destinationAdmit(dhP));
+  destinationDone(dhP, true, 100000);
+  EXPECT_EQ(1, dhP->limit);
+
+  destinationHealthInit(0, 0);
+}
@@ -0,0 +1,331 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ngsiNotify/senderThread.h"
+#include "ngsiNotify/notificationSpool.h"
+
+
+
+/* ****************************************************************************
+*
+* entryNew - queue entry of n notifications
+*/
+static std::vector<SenderThreadParams*>* entryNew(int n, const std::string& content, const std::string& tenant = "t1")
+{
+  std::vector<SenderThreadParams*>* paramsV = new std::vector<SenderThreadParams*>();
+
+  for (int ix = 0; ix < n; ++ix)
+  {
+    SenderThreadParams* paramsP = new SenderThreadParams();
+
+    paramsP->ip                  = "localhost";
+    paramsP->port                = 9997;
+    paramsP->verb                = "POST";
+    paramsP->tenant              = tenant;
+    paramsP->resource            = "/notify";
+    paramsP->content             = content;
+    paramsP->mimeType            = JSON;
+    paramsP->subscriptionId      = "5a0c6a7c8f1f8d5b5a5a5a5a";
+    paramsP->registration        = false;
+    paramsP->timeStamp.tv_sec    = 1;
+    paramsP->timeStamp.tv_nsec   = 2;
+    paramsP->extraHeaders["h1"]  = "v1";
+    snprintf(paramsP->transactionId, sizeof(paramsP->transactionId), "tx-%d", ix);
+
+    paramsV->push_back(paramsP);
+  }
+
+  return paramsV;
+}
+
+
+
+/* ****************************************************************************
+*
+* entryDelete -
+*/
+static void entryDelete(std::vector<SenderThreadParams*>* paramsV)
+{
+  for (unsigned int ix = 0; ix < paramsV->size(); ++ix)
+  {
+    delete (*paramsV)[ix];
+  }
+
+  delete paramsV;
+}
+
+
+
+/* ****************************************************************************
+*
+* spoolDir - a new temporary directory
+*/
+static std::string spoolDir(void)
+{
+  char dir[] = "/tmp/notifSpoolTest.XXXXXX";
+
+  EXPECT_TRUE(mkdtemp(dir) != NULL);
+
+  return dir;
+}
+
+
+
+/* ****************************************************************************
+*
+* roundtrip - entries come out of the spool in order and unchanged
+*/
+TEST(notificationSpool, roundtrip)
+{
+  std::string  dir = spoolDir();
+  std::string  error;
+
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+  EXPECT_TRUE(notifSpoolEnabled());
+  EXPECT_FALSE(notifSpoolPending());
+
+  for (int ix = 1; ix <= 3; ++ix)
+  {
+    std::vector<SenderThreadParams*>* paramsV = entryNew(ix, std::string(ix, 'x'));
+
+    EXPECT_TRUE(notifSpoolWrite(*paramsV));
+    entryDelete(paramsV);
+  }
+
+  EXPECT_TRUE(notifSpoolPending());
+
+  for (int ix = 1; ix <= 3; ++ix)
+  {
+    std::vector<SenderThreadParams*>* paramsV = notifSpoolNext("t1");
+
+    ASSERT_EQ(ix, (int) paramsV->size());
+    EXPECT_EQ(std::string(ix, 'x'),           (*paramsV)[0]->content);
+    EXPECT_EQ("localhost",                    (*paramsV)[0]->ip);
+    EXPECT_EQ(9997,                           (*paramsV)[0]->port);
+    EXPECT_EQ("5a0c6a7c8f1f8d5b5a5a5a5a",     (*paramsV)[0]->subscriptionId);
+    EXPECT_EQ("v1",                           (*paramsV)[0]->extraHeaders["h1"]);
+    EXPECT_STREQ("tx-0",                      (*paramsV)[0]->transactionId);
+    EXPECT_EQ(2,                              (*paramsV)[0]->timeStamp.tv_nsec);
+
+    notifSpoolCommit("t1");
+    entryDelete(paramsV);
+  }
+
+  NotifSpoolStatistics stats;
+
+  notifSpoolStatisticsGet(&stats);
+
+  EXPECT_FALSE(notifSpoolPending());
+  EXPECT_EQ(6, stats.in);
+  EXPECT_EQ(6, stats.out);
+  EXPECT_EQ(0, stats.pending);
+
+  notifSpoolRelease();
+}
+
+
+
+/* ****************************************************************************
+*
+* replay - entries not taken from the spool are there after a restart
+*/
+TEST(notificationSpool, replay)
+{
+  std::string                        dir = spoolDir();
+  std::string                        error;
+  std::vector<SenderThreadParams*>*  paramsV;
+
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+
+  for (int ix = 1; ix <= 3; ++ix)
+  {
+    paramsV = entryNew(1, std::string(ix, 'x'));
+    EXPECT_TRUE(notifSpoolWrite(*paramsV));
+    entryDelete(paramsV);
+  }
+
+  paramsV = notifSpoolNext("t1");
+  notifSpoolCommit("t1");
+  entryDelete(paramsV);
+
+  notifSpoolRelease();
+
+  // Restart
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+  EXPECT_TRUE(notifSpoolPending());
+
+  paramsV = notifSpoolNext("t1");
+  EXPECT_EQ("xx", (*paramsV)[0]->content);
+  notifSpoolCommit("t1");
+  entryDelete(paramsV);
+
+  paramsV = notifSpoolNext("t1");
+  EXPECT_EQ("xxx", (*paramsV)[0]->content);
+  notifSpoolCommit("t1");
+  entryDelete(paramsV);
+
+  EXPECT_FALSE(notifSpoolPending());
+
+  // New entries go on after the replayed ones
+  paramsV = entryNew(1, "new");
+  EXPECT_TRUE(notifSpoolWrite(*paramsV));
+  entryDelete(paramsV);
+
+  notifSpoolRelease();
+
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+
+  paramsV = notifSpoolNext("t1");
+  EXPECT_EQ("new", (*paramsV)[0]->content);
+  notifSpoolCommit("t1");
+  entryDelete(paramsV);
+
+  notifSpoolRelease();
+}
+
+
+
+/* ****************************************************************************
+*
+* budget - entries are rejected when the disk budget is exhausted
+*/
+TEST(notificationSpool, budget)
+{
+  std::string                        dir = spoolDir();
+  std::string                        error;
+  std::vector<SenderThreadParams*>*  paramsV = entryNew(1, std::string(1024 * 1024, 'x'));
+  int                                written = 0;
+
+  // The minimum budget is two segments
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+
+  while (notifSpoolWrite(*paramsV))
+  {
+    ++written;
+  }
+
+  EXPECT_EQ(2 * (NOTIF_SPOOL_SEGMENT_SIZE / (1024 * 1024) - 1), written);
+
+  // Once the first segment is sent, it is reused
+  for (unsigned int ix = 0; ix < NOTIF_SPOOL_SEGMENT_SIZE / (1024 * 1024) - 1; ++ix)
+  {
+    entryDelete(notifSpoolNext("t1"));
+    notifSpoolCommit("t1");
+  }
+
+  EXPECT_TRUE(notifSpoolWrite(*paramsV));
+
+  NotifSpoolStatistics stats;
+
+  notifSpoolStatisticsGet(&stats);
+
+  EXPECT_EQ(1, stats.reject);
+  EXPECT_EQ(2, stats.segments);
+
+  entryDelete(paramsV);
+  notifSpoolRelease();
+}
+
+
+
+/* ****************************************************************************
+*
+* tenants - the entries of each tenant are taken in order, regardless of other tenants
+*/
+TEST(notificationSpool, tenants)
+{
+  std::string                        dir = spoolDir();
+  std::string                        error;
+  std::vector<SenderThreadParams*>*  paramsV;
+  std::vector<std::string>           tenants;
+
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+
+  const char* writes[][2] = { { "t1", "a" }, { "t2", "b" }, { "t1", "c" }, { "t2", "d" } };
+
+  for (unsigned int ix = 0; ix < sizeof(writes) / sizeof(writes[0]); ++ix)
+  {
+    paramsV = entryNew(1, writes[ix][1], writes[ix][0]);
+    EXPECT_TRUE(notifSpoolWrite(*paramsV));
+    entryDelete(paramsV);
+  }
+
+  notifSpoolTenants(&tenants);
+  ASSERT_EQ(2, (int) tenants.size());
+  EXPECT_TRUE(notifSpoolTenantPending("t1"));
+  EXPECT_FALSE(notifSpoolTenantPending("t3"));
+  EXPECT_TRUE(notifSpoolNext("t3") == NULL);
+
+  // The first entry of t1 is left in the spool (e.g. its group of the queue is full)
+  paramsV = notifSpoolNext("t1");
+  EXPECT_EQ("a", (*paramsV)[0]->content);
+  entryDelete(paramsV);
+
+  paramsV = notifSpoolNext("t2");
+  EXPECT_EQ("b", (*paramsV)[0]->content);
+  notifSpoolCommit("t2");
+  entryDelete(paramsV);
+
+  paramsV = notifSpoolNext("t2");
+  EXPECT_EQ("d", (*paramsV)[0]->content);
+  notifSpoolCommit("t2");
+  entryDelete(paramsV);
+
+  EXPECT_FALSE(notifSpoolTenantPending("t2"));
+  EXPECT_TRUE(notifSpoolNext("t2") == NULL);
+
+  // Entries taken out of order are not replayed after a restart
+  notifSpoolRelease();
+  ASSERT_TRUE(notifSpoolInit(dir, 0, &error));
+
+  EXPECT_FALSE(notifSpoolTenantPending("t2"));
+
+  paramsV = notifSpoolNext("t1");
+  EXPECT_EQ("a", (*paramsV)[0]->content);
+  notifSpoolCommit("t1");
+  entryDelete(paramsV);
+
+  paramsV = notifSpoolNext("t1");
+  EXPECT_EQ("c", (*paramsV)[0]->content);
+  notifSpoolCommit("t1");
+  entryDelete(paramsV);
+
+  NotifSpoolStatistics stats;
+
+  notifSpoolStatisticsGet(&stats);
+
+  EXPECT_FALSE(notifSpoolPending());
+  EXPECT_EQ(0, stats.pending);
+
+  notifSpoolRelease();
+}
@@ -0,0 +1,147 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+#include <zlib.h>
+
+#include <string>
+#include <map>
+
+#include "gtest/gtest.h"
+
+#include "rest/compression.h"
+
+
+
+/* ****************************************************************************
+*
+* negotiate -
+*/
+TEST(compression, negotiate)
+{
+  EXPECT_EQ(CeIdentity, contentEncodingNegotiate(""));
+  EXPECT_EQ(CeIdentity, contentEncodingNegotiate("identity"));
+  EXPECT_EQ(CeIdentity, contentEncodingNegotiate("br"));
+  EXPECT_EQ(CeGzip,     contentEncodingNegotiate("gzip"));
+  EXPECT_EQ(CeGzip,     contentEncodingNegotiate("gzip, deflate, br"));
+  EXPECT_EQ(CeGzip,     contentEncodingNegotiate("*"));
+  EXPECT_EQ(CeDeflate,  contentEncodingNegotiate("deflate"));
+  EXPECT_EQ(CeDeflate,  contentEncodingNegotiate("gzip;q=0.5, deflate"));
+  EXPECT_EQ(CeDeflate,  contentEncodingNegotiate("GZIP; q=0, *"));
+  EXPECT_EQ(CeIdentity, contentEncodingNegotiate("gzip;q=0, deflate;q=0.0"));
+
+  EXPECT_EQ(CeGzip,     contentEncodingParse("gzip"));
+  EXPECT_EQ(CeDeflate,  contentEncodingParse("Deflate"));
+  EXPECT_EQ(CeIdentity, contentEncodingParse("zstd"));
+}
+
+
+
+/* ****************************************************************************
+*
+* roundTrip -
+*
+* Compresses twice with the same (reused) stream and checks the result inflates back
+*/
+TEST(compression, roundTrip)
+{
+  std::string            in;
+  std::string            out;
+  CompressionStatistics  cs;
+
+  for (int ix = 0; ix < 1000; ++ix)
+  {
+    in += "{\"id\":\"Room1\",\"type\":\"Room\",\"temperature\":{\"value\":23,\"type\":\"Number\"}},";
+  }
+
+  compressionStatisticsReset();
+
+  for (int round = 0; round < 2; ++round)
+  {
+    EXPECT_TRUE(compressPayload(CeGzip, in.c_str(), in.size(), &out, false));
+    EXPECT_LT(out.size(), in.size() / 10);
+    EXPECT_EQ((char) 0x1f, out[0]);  // gzip magic number
+    EXPECT_EQ((char) 0x8b, out[1]);
+
+    z_stream     stream;
+    std::string  inflated(in.size(), 0);
+
+    memset(&stream, 0, sizeof(stream));
+    EXPECT_EQ(Z_OK, inflateInit2(&stream, 15 + 16));
+
+    stream.next_in   = (Bytef*) out.c_str();
+    stream.avail_in  = out.size();
+    stream.next_out  = (Bytef*) &inflated[0];
+    stream.avail_out = inflated.size();
+
+    EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+    EXPECT_EQ(in, inflated);
+    inflateEnd(&stream);
+  }
+
+  EXPECT_TRUE(compressPayload(CeDeflate, in.c_str(), in.size(), &out, true));
+  EXPECT_FALSE(compressPayload(CeIdentity, in.c_str(), in.size(), &out, true));
+
+  compressionStatisticsGet(&cs);
+  EXPECT_EQ(2, cs.responses);
+  EXPECT_EQ(2 * in.size(), cs.responsesUncompressedBytes);
+  EXPECT_EQ(1, cs.notifications);
+}
+
+
+
+/* ****************************************************************************
+*
+* notification -
+*
+* The payload of a notification is compressed (and so sent with Content-Encoding) only
+* with notification compression enabled, whatever the compression of responses
+*/
+TEST(compression, notification)
+{
+  std::map<std::string, std::string>  headers;
+  std::string                         content(1000, 'x');
+  std::string                         out;
+
+  headers["Content-Encoding"] = "gzip";
+
+  compressionInit(1, false);
+  EXPECT_EQ(CeIdentity, notificationCompress(headers, content, &out));
+  EXPECT_EQ("", out);
+
+  compressionInit(0, true);
+  EXPECT_EQ(CeGzip, notificationCompress(headers, content, &out));
+  EXPECT_EQ((char) 0x1f, out[0]);
+  EXPECT_EQ((char) 0x8b, out[1]);
+
+  // Not declared by the subscription, or not supported
+  std::map<std::string, std::string> noHeaders;
+
+  EXPECT_EQ(CeIdentity, notificationCompress(noHeaders, content, &out));
+
+  headers["Content-Encoding"] = "br";
+  EXPECT_EQ(CeIdentity, notificationCompress(headers, content, &out));
+
+  compressionInit(0, false);
+}
@@ -0,0 +1,165 @@
+/*
+*
+* Copyright 2018 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "rest/ConnectionInfo.h"
+#include "rest/rateLimit.h"
+
+
+
+/* ****************************************************************************
+*
+* admit -
+*/
+static bool admit(const char* method, const char* url, const char* service, int* retryAfterP)
+{
+  ConnectionInfo ci(url, method, "1.1");
+
+  ci.apiVersion           = (strncmp(url, "/v2/", 4) == 0)? V2 : ADMIN_API;
+  ci.tenantFromHttpHeader = service;
+
+  return rateLimitAdmit(&ci, "/", retryAfterP);
+}
+
+
+
+/* ****************************************************************************
+*
+* burstAndClasses -
+*/
+TEST(rateLimit, burstAndClasses)
+{
+  std::string  details;
+  int          retryAfter = 0;
+
+  // Very low rate, so no token is regained during the test
+  EXPECT_TRUE(rateLimitSet("s1", "", RlcAny, 0.01, 2, &details));
+  EXPECT_TRUE(rateLimitSet("s1", "", RlcRead, 0.01, 1, &details));
+
+  EXPECT_TRUE(admit("POST", "/v2/entities", "s1", &retryAfter));
+  EXPECT_TRUE(admit("POST", "/v2/entities", "s1", &retryAfter));
+  EXPECT_FALSE(admit("POST", "/v2/entities", "s1", &retryAfter));
+  EXPECT_EQ(100, retryAfter);
+
+  // Reads have their own bucket, other services and admin requests are not limited
+  EXPECT_TRUE(admit("GET", "/v2/entities", "s1", &retryAfter));
+  EXPECT_FALSE(admit("GET", "/v2/entities", "s1", &retryAfter));
+  EXPECT_TRUE(admit("POST", "/v2/entities", "s2", &retryAfter));
+  EXPECT_TRUE(admit("GET", "/admin/metrics", "s1", &retryAfter));
+
+  EXPECT_TRUE(rateLimitRemove("s1", "", RlcAny));
+  EXPECT_TRUE(rateLimitRemove("s1", "", RlcRead));
+  EXPECT_FALSE(rateLimitRemove("s1", "", RlcRead));
+  EXPECT_TRUE(admit("POST", "/v2/entities", "s1", &retryAfter));
+}
+
+
+
+/* ****************************************************************************
+*
+* allServices -
+*/
+TEST(rateLimit, allServices)
+{
+  std::string  details;
+  int          retryAfter = 0;
+
+  EXPECT_FALSE(rateLimitSet("*", "", RlcBatch, 0, 1, &details));
+  EXPECT_TRUE(rateLimitSet("*", "", RlcBatch, 0.01, 1, &details));
+
+  // Each service gets its own bucket
+  EXPECT_TRUE(admit("POST", "/v2/op/update", "s3", &retryAfter));
+  EXPECT_FALSE(admit("POST", "/v2/op/update", "s3", &retryAfter));
+  EXPECT_TRUE(admit("POST", "/v2/op/update", "s4", &retryAfter));
+  EXPECT_TRUE(admit("POST", "/v2/entities", "s3", &retryAfter));
+
+  // An explicit limit of the service takes precedence
+  EXPECT_TRUE(rateLimitSet("s3", "", RlcAny, 1000, 10, &details));
+  EXPECT_TRUE(admit("POST", "/v2/op/update", "s3", &retryAfter));
+
+  std::string json = rateLimitsToJson();
+
+  EXPECT_NE(std::string::npos, json.find("\"service\":\"s4\",\"class\":\"batch\""));
+  EXPECT_NE(std::string::npos, json.find("\"fromAllServices\":true"));
+
+  EXPECT_TRUE(rateLimitRemove("*", "", RlcBatch));
+  EXPECT_TRUE(rateLimitRemove("s3", "", RlcAny));
+  EXPECT_EQ("[]", rateLimitsToJson());
+}
+
+
+
+/* ****************************************************************************
+*
+* overCapacity -
+*/
+TEST(rateLimit, overCapacity)
+{
+  std::string  details;
+  int          retryAfter = 0;
+  int          admitted   = 0;
+  int          rejected   = 0;
+  char         service[32];
+
+  EXPECT_TRUE(rateLimitSet("*", "", RlcWrite, 0.01, 1, &details));
+
+  // More services than instances: the ones without room share the bucket of the '*' limit
+  for (int ix = 0; ix < RATE_LIMIT_INSTANCES_MAX + 10; ++ix)
+  {
+    snprintf(service, sizeof(service), "oc%d", ix);
+
+    if (admit("POST", "/v2/entities", service, &retryAfter))
+    {
+      ++admitted;
+    }
+    else
+    {
+      ++rejected;
+    }
+  }
+
+  EXPECT_LE(admitted, RATE_LIMIT_INSTANCES_MAX + 1);
+  EXPECT_GE(rejected, 9);
+  EXPECT_FALSE(admit("POST", "/v2/entities", "oc0", &retryAfter));
+
+  // Once the limit is removed its instances are idle, and evicted
+  EXPECT_TRUE(rateLimitRemove("*", "", RlcWrite));
+  EXPECT_GE(rateLimitSweepForUnitTest(), (unsigned int) RATE_LIMIT_INSTANCES_MAX);
+
+  // So new services get their own bucket again
+  EXPECT_TRUE(rateLimitSet("*", "", RlcWrite, 0.01, 1, &details));
+  EXPECT_TRUE(admit("POST", "/v2/entities", "oc0", &retryAfter));
+  EXPECT_FALSE(admit("POST", "/v2/entities", "oc0", &retryAfter));
+  EXPECT_TRUE(admit("POST", "/v2/entities", "oc1", &retryAfter));
+
+  EXPECT_TRUE(rateLimitRemove("*", "", RlcWrite));
+  rateLimitSweepForUnitTest();
+  EXPECT_EQ("[]", rateLimitsToJson());
+}
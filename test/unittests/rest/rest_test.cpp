@@ -22,8 +22,14 @@
 *
 * Author: Ken Zangelin
 */
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
+#include "common/limits.h"
 #include "rest/ConnectionInfo.h"
 
 #include "unittests/unittest.h"
@@ -32,6 +38,7 @@
 
 extern int servicePathCheck(ConnectionInfo* ciP, const char* path);
 extern int servicePathSplit(ConnectionInfo* ciP);
+extern bool payloadAppend(ConnectionInfo* ciP, const char* data, int dataLen, bool ownBuffer);
 
 
 
@@ -140,3 +147,69 @@ TEST(rest, servicePathSplit)
   EXPECT_EQ(137, ci5.answer.size());
   LM_M(("---- 5 -----"));
 }
+
+
+
+/* ****************************************************************************
+*
+* rest.payloadAppendInterleaved -
+*
+* Two chunked requests (no Content-Length) read by the same thread, their chunks interleaved,
+* as it happens with request workers. Each one has to end up with its own payload.
+*/
+TEST(rest, payloadAppendInterleaved)
+{
+  ConnectionInfo  ci1;
+  ConnectionInfo  ci2;
+  std::string     big(STATIC_BUFFER_SIZE, 'x');
+
+  ci1.httpHeaders.contentLength = 0;
+  ci2.httpHeaders.contentLength = 0;
+
+  EXPECT_TRUE(payloadAppend(&ci1, "{\"id\":", 6, true));
+  EXPECT_TRUE(payloadAppend(&ci2, "[1,", 3, true));
+  EXPECT_TRUE(payloadAppend(&ci1, "\"E1\"}", 5, true));
+  EXPECT_TRUE(payloadAppend(&ci2, big.c_str(), big.size(), true));
+  EXPECT_TRUE(payloadAppend(&ci2, "2]", 2, true));
+
+  EXPECT_STREQ("{\"id\":\"E1\"}", ci1.payload);
+  EXPECT_EQ(11, ci1.payloadSize);
+  EXPECT_EQ(STATIC_BUFFER_SIZE + 5, ci2.payloadSize);
+  EXPECT_EQ(0, strncmp(ci2.payload, "[1,xxx", 6));
+  EXPECT_STREQ("x2]", &ci2.payload[ci2.payloadSize - 3]);
+
+  free(ci1.payload);
+  free(ci2.payload);
+}
+
+
+
+/* ****************************************************************************
+*
+* rest.payloadAppendStaticBuffer -
+*
+* Without own buffer, small payloads use the static buffer of the thread, and move to an
+* allocated buffer if they don't fit in it. Payloads bigger than PAYLOAD_MAX_SIZE are rejected.
+*/
+TEST(rest, payloadAppendStaticBuffer)
+{
+  ConnectionInfo  ci;
+  std::string     big(STATIC_BUFFER_SIZE, 'x');
+  std::string     huge(PAYLOAD_MAX_SIZE, 'y');
+  char*           staticBuffer;
+
+  ci.httpHeaders.contentLength = 0;
+
+  EXPECT_TRUE(payloadAppend(&ci, "ab", 2, false));
+  staticBuffer = ci.payload;
+  EXPECT_TRUE(payloadAppend(&ci, big.c_str(), big.size(), false));
+
+  EXPECT_TRUE(ci.payload != staticBuffer);
+  EXPECT_EQ(STATIC_BUFFER_SIZE + 2, ci.payloadSize);
+  EXPECT_EQ(0, strncmp(ci.payload, "abxx", 4));
+
+  EXPECT_FALSE(payloadAppend(&ci, huge.c_str(), huge.size(), false));
+  EXPECT_EQ(STATIC_BUFFER_SIZE + 2, ci.payloadSize);
+
+  free(ci.payload);
+}